@@ -163,6 +163,13 @@ print ()
 print ('static void')
 print ('_output_dotted_circle (hb_buffer_t *buffer)')
 print ('{')
+print ('  /* Most text needs no dotted circle, so the output buffer is only started')
+print ('   * once one is due; everything before idx is kept in place. */')
+print ('  if (!buffer->have_output)')
+print ('  {')
+print ('    buffer->clear_output ();')
+print ('    buffer->out_len = buffer->idx;')
+print ('  }')
 print ('  hb_glyph_info_t &dottedcircle = buffer->output_glyph (0x25CCu);')
 print ('  _hb_glyph_info_reset_continuation (&dottedcircle);')
 print ('}')
@@ -187,7 +194,6 @@ print ('   *')
 print ('   * https://github.com/harfbuzz/harfbuzz/issues/1019')
 print ('   */')
 print ('  bool processed = false;')
-print ('  buffer->clear_output ();')
 print ('  unsigned int count = buffer->len;')
 print ('  switch ((unsigned) buffer->props.script)')
 print ('  {')
@@ -210,8 +216,14 @@ print ('      break;')
 print ('  }')
 print ('  if (processed)')
 print ('  {')
-print ('    if (buffer->idx < count)')
-print ('      buffer->next_glyph ();')
+print ('    if (buffer->have_output)')
+print ('    {')
+print ('      if (buffer->idx < count)')
+print ('\tbuffer->next_glyph ();')
+print ('      buffer->swap_buffers ();')
+print ('    }')
+print ('    else')
+print ('      buffer->idx = 0;')
 print ('  }')
 print ('}')
 
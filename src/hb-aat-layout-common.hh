@@ -54,6 +54,13 @@ struct LookupFormat0
     return &arrayZ[glyph_id];
   }
 
+  template <typename set_t>
+  void collect_glyphs (set_t *glyphs, unsigned int num_glyphs) const
+  {
+    if (num_glyphs)
+      glyphs->add_range (0, num_glyphs - 1);
+  }
+
   bool sanitize (hb_sanitize_context_t *c) const
   {
     TRACE_SANITIZE (this);
@@ -112,6 +119,14 @@ struct LookupFormat2
     return v ? &v->value : nullptr;
   }
 
+  template <typename set_t>
+  void collect_glyphs (set_t *glyphs) const
+  {
+    unsigned int count = segments.get_length ();
+    for (unsigned int i = 0; i < count; i++)
+      glyphs->add_range (segments[i].first, segments[i].last);
+  }
+
   bool sanitize (hb_sanitize_context_t *c) const
   {
     TRACE_SANITIZE (this);
@@ -183,6 +198,14 @@ struct LookupFormat4
     return v ? v->get_value (glyph_id, this) : nullptr;
   }
 
+  template <typename set_t>
+  void collect_glyphs (set_t *glyphs) const
+  {
+    unsigned int count = segments.get_length ();
+    for (unsigned int i = 0; i < count; i++)
+      glyphs->add_range (segments[i].first, segments[i].last);
+  }
+
   bool sanitize (hb_sanitize_context_t *c) const
   {
     TRACE_SANITIZE (this);
@@ -240,6 +263,14 @@ struct LookupFormat6
     return v ? &v->value : nullptr;
   }
 
+  template <typename set_t>
+  void collect_glyphs (set_t *glyphs) const
+  {
+    unsigned int count = entries.get_length ();
+    for (unsigned int i = 0; i < count; i++)
+      glyphs->add (entries[i].glyph);
+  }
+
   bool sanitize (hb_sanitize_context_t *c) const
   {
     TRACE_SANITIZE (this);
@@ -271,6 +302,13 @@ struct LookupFormat8
 	   &valueArrayZ[glyph_id - firstGlyph] : nullptr;
   }
 
+  template <typename set_t>
+  void collect_glyphs (set_t *glyphs) const
+  {
+    if (glyphCount)
+      glyphs->add_range (firstGlyph, firstGlyph + glyphCount - 1);
+  }
+
   bool sanitize (hb_sanitize_context_t *c) const
   {
     TRACE_SANITIZE (this);
@@ -315,6 +353,13 @@ struct LookupFormat10
     return v;
   }
 
+  template <typename set_t>
+  void collect_glyphs (set_t *glyphs) const
+  {
+    if (glyphCount)
+      glyphs->add_range (firstGlyph, firstGlyph + glyphCount - 1);
+  }
+
   bool sanitize (hb_sanitize_context_t *c) const
   {
     TRACE_SANITIZE (this);
@@ -370,6 +415,21 @@ struct Lookup
     return v ? *v : outOfRange;
   }
 
+  /* Adds every glyph the lookup may have a value for. */
+  template <typename set_t>
+  void collect_glyphs (set_t *glyphs, unsigned int num_glyphs) const
+  {
+    switch (u.format) {
+    case 0: u.format0.collect_glyphs (glyphs, num_glyphs); return;
+    case 2: u.format2.collect_glyphs (glyphs); return;
+    case 4: u.format4.collect_glyphs (glyphs); return;
+    case 6: u.format6.collect_glyphs (glyphs); return;
+    case 8: u.format8.collect_glyphs (glyphs); return;
+    case 10: u.format10.collect_glyphs (glyphs); return;
+    default:return;
+    }
+  }
+
   bool sanitize (hb_sanitize_context_t *c) const
   {
     TRACE_SANITIZE (this);
@@ -508,6 +568,35 @@ struct StateTable
     return (this+classTable).get_class (glyph_id, num_glyphs, 1);
   }
 
+  const ClassType &get_class_table () const
+  { return this+classTable; }
+
+  /* Adds the glyphs that may have a class of their own.  Others are
+   * CLASS_OUT_OF_BOUNDS. */
+  template <typename set_t>
+  void collect_glyphs (set_t *glyphs, unsigned int num_glyphs) const
+  { (this+classTable).collect_glyphs (glyphs, num_glyphs); }
+
+  /* Whether, on end-of-text, out-of-bounds and deleted glyphs, the machine
+   * stays in the start state doing nothing; is_idle() tells if an entry
+   * does nothing.  If so, a buffer that has no glyph collect_glyphs() adds
+   * goes through untouched. */
+  bool is_idle_outside_class_table (bool (*is_idle) (const Entry<Extra> &)) const
+  {
+    static const unsigned int classes[] = {CLASS_END_OF_TEXT,
+					   CLASS_OUT_OF_BOUNDS,
+					   CLASS_DELETED_GLYPH};
+    for (unsigned int i = 0; i < ARRAY_LENGTH (classes); i++)
+    {
+      /* The driver stops at classes the table does not have. */
+      const Entry<Extra> *entry = get_entryZ (STATE_START_OF_TEXT, classes[i]);
+      if (entry &&
+	  (new_state (entry->newState) != STATE_START_OF_TEXT || !is_idle (*entry)))
+	return false;
+    }
+    return true;
+  }
+
   const Entry<Extra> *get_entries () const
   { return (this+entryTable).arrayZ; }
 
@@ -654,6 +743,12 @@ struct ClassTable
   {
     return get_class (glyph_id, outOfRange);
   }
+  template <typename set_t>
+  void collect_glyphs (set_t *glyphs, unsigned int num_glyphs HB_UNUSED) const
+  {
+    if (classArray.len)
+      glyphs->add_range (firstGlyph, firstGlyph + classArray.len - 1);
+  }
   bool sanitize (hb_sanitize_context_t *c) const
   {
     TRACE_SANITIZE (this);
@@ -728,15 +823,206 @@ struct ExtendedTypes
   }
 };
 
+/*
+ * Lookup cache
+ *
+ * Lookups are searched glyph by glyph.  The tables applied while shaping
+ * keep dense, native, glyph-indexed copies of the values of their subtables'
+ * lookups instead, built the first time each subtable is applied, up to a
+ * budget of HB_AAT_LOOKUP_CACHE_MAX_BYTES per table.
+ */
+
+#ifndef HB_AAT_LOOKUP_CACHE_MAX_BYTES
+#define HB_AAT_LOOKUP_CACHE_MAX_BYTES (1u << 20)
+#endif
+
+struct lookup_cache_t
+{
+  enum { SLOTS_PER_SUBTABLE = 2 };
+
+  void init (unsigned int num_glyphs_, unsigned int num_subtables)
+  {
+    num_glyphs = num_glyphs_;
+    num_slots = 0;
+    slots = nullptr;
+    bytes_left.set_relaxed (HB_AAT_LOOKUP_CACHE_MAX_BYTES);
+    if (unlikely (hb_unsigned_mul_overflows (num_subtables, SLOTS_PER_SUBTABLE)))
+      return;
+    slots = (hb_atomic_ptr_t<void> *) calloc (num_subtables * SLOTS_PER_SUBTABLE, sizeof (slots[0]));
+    if (likely (slots))
+      num_slots = num_subtables * SLOTS_PER_SUBTABLE;
+  }
+  void fini ()
+  {
+    for (unsigned int i = 0; i < num_slots; i++)
+      free (slots[i].get ());
+    free (slots);
+  }
+
+  unsigned int get_memory_usage () const
+  {
+    return num_slots * sizeof (slots[0]) +
+	   HB_AAT_LOOKUP_CACHE_MAX_BYTES - bytes_left.get ();
+  }
+
+  /* Returns the values of lookup slot, indexed by glyph; computes them with
+   * get_value (glyph) the first time.  Returns nullptr if out of budget. */
+  template <typename V, typename Getter>
+  const V *get (unsigned int slot, const Getter &get_value) const
+  {
+    if (unlikely (slot >= num_slots || !num_glyphs)) return nullptr;
+
+  retry:
+    V *v = (V *) slots[slot].get ();
+    if (likely (v)) return v;
+
+    unsigned int size = num_glyphs * sizeof (V);
+    if (bytes_left.get () < (int) size) return nullptr;
+    v = (V *) malloc (size);
+    if (unlikely (!v)) return nullptr;
+    for (unsigned int i = 0; i < num_glyphs; i++)
+      v[i] = get_value (i);
+
+    if (unlikely (!slots[slot].cmpexch (nullptr, v)))
+    {
+      free (v);
+      goto retry;
+    }
+    hb_atomic_int_impl_add (&bytes_left.v, -(int) size);
+    return v;
+  }
+
+  unsigned int get_num_glyphs () const { return num_glyphs; }
+
+  private:
+  unsigned int num_glyphs;
+  unsigned int num_slots;
+  hb_atomic_ptr_t<void> *slots;
+  mutable hb_atomic_int_t bytes_left;
+};
+
+/* Getters for lookup_cache_t::get(). */
+template <typename Table>
+struct lookup_class_getter_t
+{
+  lookup_class_getter_t (const Table &table_, unsigned int num_glyphs_,
+			 unsigned int outOfRange_) :
+    table (table_), num_glyphs (num_glyphs_), outOfRange (outOfRange_) {}
+
+  unsigned int operator () (hb_codepoint_t glyph_id) const
+  { return table.get_class (glyph_id, num_glyphs, outOfRange); }
+
+  const Table &table;
+  unsigned int num_glyphs;
+  unsigned int outOfRange;
+};
+template <typename Table>
+struct lookup_value_getter_t
+{
+  lookup_value_getter_t (const Table &table_, unsigned int num_glyphs_) :
+    table (table_), num_glyphs (num_glyphs_) {}
+
+  unsigned int operator () (hb_codepoint_t glyph_id) const
+  { return table.get_value_or_null (glyph_id, num_glyphs); }
+
+  const Table &table;
+  unsigned int num_glyphs;
+};
+
+
+struct ankr;
+
+struct hb_aat_apply_context_t :
+       hb_dispatch_context_t<hb_aat_apply_context_t, bool, HB_DEBUG_APPLY>
+{
+  const char *get_name () { return "APPLY"; }
+  template <typename T>
+  return_t dispatch (const T &obj) { return obj.apply (this); }
+  static return_t default_return_value () { return false; }
+  bool stop_sublookup_iteration (return_t r) const { return r; }
+
+  const hb_ot_shape_plan_t *plan;
+  hb_font_t *font;
+  hb_face_t *face;
+  hb_buffer_t *buffer;
+  hb_sanitize_context_t sanitizer;
+  const ankr *ankr_table;
+  const char *ankr_end;
+  const lookup_cache_t *lookup_cache;
+  const hb_vector_t<bool> *checked_subtables;
+  const hb_vector_t<hb_map_t *> *pair_maps;
+  hb_set_digest_t buffer_digest; /* Of the glyphs in buffer, if valid. */
+  bool buffer_digest_valid;
+
+  /* For debug tracing, and to find the subtable's cached lookups. */
+  unsigned int lookup_index;
+  unsigned int debug_depth;
+
+  HB_INTERNAL hb_aat_apply_context_t (const hb_ot_shape_plan_t *plan_,
+				      hb_font_t *font_,
+				      hb_buffer_t *buffer_,
+				      hb_blob_t *blob = const_cast<hb_blob_t *> (&Null(hb_blob_t)));
+
+  HB_INTERNAL ~hb_aat_apply_context_t ();
+
+  HB_INTERNAL void set_ankr_table (const AAT::ankr *ankr_table_, const char *ankr_end_);
+
+  void set_lookup_cache (const lookup_cache_t *lookup_cache_) { lookup_cache = lookup_cache_; }
+  /* Values of lookup n of the current subtable, as with
+   * lookup_cache_t::get(); nullptr if the table has no lookup cache. */
+  template <typename V, typename Getter>
+  const V *get_cached_lookup (unsigned int n, const Getter &get_value) const
+  {
+    if (!lookup_cache) return nullptr;
+    return lookup_cache->get<V> (lookup_index * lookup_cache_t::SLOTS_PER_SUBTABLE + n,
+				 get_value);
+  }
+
+  void set_checked_subtables (const hb_vector_t<bool> *checked_subtables_)
+  { checked_subtables = checked_subtables_; }
+  /* Whether the action data of the current subtable is known to be in
+   * range, such that its driver need not check it with sanitizer. */
+  bool subtable_actions_checked () const
+  {
+    return checked_subtables &&
+	   lookup_index < checked_subtables->length &&
+	   (*checked_subtables)[lookup_index];
+  }
+
+  void set_pair_maps (const hb_vector_t<hb_map_t *> *pair_maps_)
+  { pair_maps = pair_maps_; }
+  /* Map of the kerning pairs of the current subtable, or nullptr. */
+  const hb_map_t *get_pair_map () const
+  {
+    return pair_maps && lookup_index < pair_maps->length ?
+	   (*pair_maps)[lookup_index] : nullptr;
+  }
+
+  void set_lookup_index (unsigned int i) { lookup_index = i; }
+};
+
+
 template <typename Types, typename EntryData>
 struct StateTableDriver
 {
   StateTableDriver (const StateTable<Types, EntryData> &machine_,
-		    hb_buffer_t *buffer_,
-		    hb_face_t *face_) :
+		    hb_aat_apply_context_t *c) :
 	      machine (machine_),
-	      buffer (buffer_),
-	      num_glyphs (face_->get_num_glyphs ()) {}
+	      buffer (c->buffer),
+	      num_glyphs (c->face->get_num_glyphs ()),
+	      classes (c->get_cached_lookup<uint16_t> (0, class_getter_t (machine.get_class_table (),
+									     num_glyphs,
+									     StateTable<Types, EntryData>::CLASS_OUT_OF_BOUNDS))) {}
+
+  typedef typename StateTable<Types, EntryData>::ClassType ClassType;
+  typedef lookup_class_getter_t<ClassType> class_getter_t;
+
+  unsigned int get_class (hb_codepoint_t glyph_id) const
+  {
+    if (classes && glyph_id < num_glyphs)
+      return classes[glyph_id];
+    return machine.get_class (glyph_id, num_glyphs);
+  }
 
   template <typename context_t>
   void drive (context_t *c)
@@ -748,8 +1034,11 @@ struct StateTableDriver
     bool last_was_dont_advance = false;
     for (buffer->idx = 0; buffer->successful;)
     {
+      if (unlikely (!buffer->charge_ops (1)))
+	break;
+
       unsigned int klass = buffer->idx < buffer->len ?
-			   machine.get_class (buffer->info[buffer->idx].codepoint, num_glyphs) :
+			   get_class (buffer->info[buffer->idx].codepoint) :
 			   (unsigned) StateTable<Types, EntryData>::CLASS_END_OF_TEXT;
       DEBUG_MSG (APPLY, nullptr, "c%u at %u", klass, buffer->idx);
       const Entry<EntryData> *entry = machine.get_entryZ (state, klass);
@@ -805,43 +1094,10 @@ struct StateTableDriver
   const StateTable<Types, EntryData> &machine;
   hb_buffer_t *buffer;
   unsigned int num_glyphs;
+  const uint16_t *classes;
 };
 
 
-struct ankr;
-
-struct hb_aat_apply_context_t :
-       hb_dispatch_context_t<hb_aat_apply_context_t, bool, HB_DEBUG_APPLY>
-{
-  const char *get_name () { return "APPLY"; }
-  template <typename T>
-  return_t dispatch (const T &obj) { return obj.apply (this); }
-  static return_t default_return_value () { return false; }
-  bool stop_sublookup_iteration (return_t r) const { return r; }
-
-  const hb_ot_shape_plan_t *plan;
-  hb_font_t *font;
-  hb_face_t *face;
-  hb_buffer_t *buffer;
-  hb_sanitize_context_t sanitizer;
-  const ankr *ankr_table;
-  const char *ankr_end;
-
-  /* Unused. For debug tracing only. */
-  unsigned int lookup_index;
-  unsigned int debug_depth;
-
-  HB_INTERNAL hb_aat_apply_context_t (const hb_ot_shape_plan_t *plan_,
-				      hb_font_t *font_,
-				      hb_buffer_t *buffer_,
-				      hb_blob_t *blob = const_cast<hb_blob_t *> (&Null(hb_blob_t)));
-
-  HB_INTERNAL ~hb_aat_apply_context_t ();
-
-  HB_INTERNAL void set_ankr_table (const AAT::ankr *ankr_table_, const char *ankr_end_);
-
-  void set_lookup_index (unsigned int i) { lookup_index = i; }
-};
 
 
 } /* namespace AAT */
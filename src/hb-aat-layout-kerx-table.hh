@@ -29,6 +29,7 @@
 #define HB_AAT_LAYOUT_KERX_TABLE_HH
 
 #include "hb-kern.hh"
+#include "hb-map.hh"
 #include "hb-aat-layout-ankr-table.hh"
 
 /*
@@ -67,6 +68,7 @@ struct hb_glyph_pair_t
 struct KernPair
 {
   int get_kerning () const { return value; }
+  hb_codepoint_t get_key () const { return (left << 16) | right; }
 
   int cmp (const hb_glyph_pair_t &o) const
   {
@@ -93,13 +95,54 @@ template <typename KernSubTableHeader>
 struct KerxSubTableFormat0
 {
   int get_kerning (hb_codepoint_t left, hb_codepoint_t right,
-		   hb_aat_apply_context_t *c = nullptr) const
+		   hb_aat_apply_context_t *c = nullptr,
+		   const hb_map_t *pair_map = nullptr) const
   {
-    hb_glyph_pair_t pair = {left, right};
-    int v = pairs.bsearch (pair).get_kerning ();
+    int v = 0;
+    if (pair_map)
+    {
+      if (likely ((left | right) <= 0xFFFFu))
+      {
+	hb_codepoint_t u = pair_map->get ((left << 16) | right);
+	if (u != HB_MAP_VALUE_INVALID)
+	  v = (int16_t) u;
+      }
+    }
+    else
+    {
+      hb_glyph_pair_t pair = {left, right};
+      v = pairs.bsearch (pair).get_kerning ();
+    }
     return kerxTupleKern (v, header.tuple_count (), this, c);
   }
 
+  /* Returns a map from left << 16 | right to the kerning value, as unsigned
+   * 16-bit, to look pairs up in instead of the binary search; nullptr if
+   * the pairs are not strictly sorted, since the search could miss some. */
+  hb_map_t *create_pair_map () const
+  {
+    hb_map_t *map = hb_map_create ();
+    unsigned int count = pairs.len;
+    if (unlikely (!map->alloc (count)))
+      goto fail;
+    for (unsigned int i = 0; i < count; i++)
+    {
+      hb_codepoint_t key = pairs[i].get_key ();
+      if (unlikely ((i && key <= pairs[i - 1].get_key ()) ||
+		    key == HB_MAP_VALUE_INVALID))
+	goto fail;
+      map->set (key, (uint16_t) pairs[i].get_kerning ());
+    }
+    map->freeze ();
+    if (unlikely (map->in_error ()))
+      goto fail;
+    return map;
+
+  fail:
+    hb_map_destroy (map);
+    return nullptr;
+  }
+
   bool apply (hb_aat_apply_context_t *c) const
   {
     TRACE_APPLY (this);
@@ -121,13 +164,15 @@ struct KerxSubTableFormat0
   {
     const KerxSubTableFormat0 &table;
     hb_aat_apply_context_t *c;
+    const hb_map_t *pair_map;
 
     accelerator_t (const KerxSubTableFormat0 &table_,
 		   hb_aat_apply_context_t *c_) :
-		     table (table_), c (c_) {}
+		     table (table_), c (c_),
+		     pair_map (c_->get_pair_map ()) {}
 
     int get_kerning (hb_codepoint_t left, hb_codepoint_t right) const
-    { return table.get_kerning (left, right, c); }
+    { return table.get_kerning (left, right, c, pair_map); }
   };
 
 
@@ -215,6 +260,7 @@ struct KerxSubTableFormat1
     {
       DontAdvance	= Format1EntryT::DontAdvance,
     };
+    enum { StackSize = 8 };
 
     driver_context_t (const KerxSubTableFormat1 *table_,
 		      hb_aat_apply_context_t *c_) :
@@ -225,7 +271,8 @@ struct KerxSubTableFormat1
 	 * other subtables in kerx.  Discovered via testing. */
 	kernAction (&table->machine + table->kernAction),
 	depth (0),
-	crossStream (table->header.coverage & table->header.CrossStream) {}
+	crossStream (table->header.coverage & table->header.CrossStream),
+	actions_checked (c->subtable_actions_checked ()) {}
 
     bool is_actionable (StateTableDriver<Types, EntryData> *driver HB_UNUSED,
 			const Entry<EntryData> *entry)
@@ -256,7 +303,8 @@ struct KerxSubTableFormat1
 	unsigned int kern_idx = Format1EntryT::kernActionIndex (entry);
 	kern_idx = Types::byteOffsetToIndex (kern_idx, &table->machine, kernAction.arrayZ);
 	const FWORD *actions = &kernAction[kern_idx];
-	if (!c->sanitizer.check_array (actions, depth, tuple_count))
+	if (!actions_checked &&
+	    !c->sanitizer.check_array (actions, depth, tuple_count))
 	{
 	  depth = 0;
 	  return false;
@@ -342,9 +390,10 @@ struct KerxSubTableFormat1
     hb_aat_apply_context_t *c;
     const KerxSubTableFormat1 *table;
     const UnsizedArrayOf<FWORD> &kernAction;
-    unsigned int stack[8];
+    unsigned int stack[StackSize];
     unsigned int depth;
     bool crossStream;
+    bool actions_checked;
   };
 
   bool apply (hb_aat_apply_context_t *c) const
@@ -357,12 +406,35 @@ struct KerxSubTableFormat1
 
     driver_context_t dc (this, c);
 
-    StateTableDriver<Types, EntryData> driver (machine, c->buffer, c->font->face);
+    StateTableDriver<Types, EntryData> driver (machine, c);
     driver.drive (&dc);
 
     return_trace (true);
   }
 
+  /* Whether the kerning values of every action of the machine are in range,
+   * even with a full stack; if so, transitions need not check them. */
+  bool check_actions (hb_sanitize_context_t *c) const
+  {
+    unsigned int num_entries;
+    if (unlikely (!machine.sanitize (c, &num_entries))) return false;
+
+    const UnsizedArrayOf<FWORD> &kernActionZ = &machine + kernAction;
+    unsigned int tuple_count = MAX (1u, header.tuple_count ());
+    const Entry<EntryData> *entries = machine.get_entries ();
+    for (unsigned int i = 0; i < num_entries; i++)
+    {
+      if (!Format1EntryT::performAction (&entries[i]))
+	continue;
+      unsigned int kern_idx = Format1EntryT::kernActionIndex (&entries[i]);
+      kern_idx = Types::byteOffsetToIndex (kern_idx, &machine, kernActionZ.arrayZ);
+      if (!c->check_array (&kernActionZ[kern_idx],
+			   (unsigned int) driver_context_t::StackSize, tuple_count))
+	return false;
+    }
+    return true;
+  }
+
   bool sanitize (hb_sanitize_context_t *c) const
   {
     TRACE_SANITIZE (this);
@@ -391,7 +463,12 @@ struct KerxSubTableFormat2
     unsigned int num_glyphs = c->sanitizer.get_num_glyphs ();
     unsigned int l = (this+leftClassTable).get_class (left, num_glyphs, 0);
     unsigned int r = (this+rightClassTable).get_class (right, num_glyphs, 0);
+    return get_class_kerning (l, r, c);
+  }
 
+  int get_class_kerning (unsigned int l, unsigned int r,
+			 hb_aat_apply_context_t *c) const
+  {
     const UnsizedArrayOf<FWORD> &arrayZ = this+array;
     unsigned int kern_idx = l + r;
     kern_idx = Types::offsetToIndex (kern_idx, this, &arrayZ);
@@ -420,15 +497,28 @@ struct KerxSubTableFormat2
 
   struct accelerator_t
   {
+    typedef lookup_class_getter_t<typename Types::ClassTypeWide> class_getter_t;
+
     const KerxSubTableFormat2 &table;
     hb_aat_apply_context_t *c;
+    unsigned int num_glyphs;
+    const uint16_t *left_classes;
+    const uint16_t *right_classes;
 
     accelerator_t (const KerxSubTableFormat2 &table_,
 		   hb_aat_apply_context_t *c_) :
-		     table (table_), c (c_) {}
+		     table (table_), c (c_),
+		     num_glyphs (c->sanitizer.get_num_glyphs ()),
+		     left_classes (c->get_cached_lookup<uint16_t> (0, class_getter_t (&table+table.leftClassTable, num_glyphs, 0))),
+		     right_classes (c->get_cached_lookup<uint16_t> (1, class_getter_t (&table+table.rightClassTable, num_glyphs, 0))) {}
 
     int get_kerning (hb_codepoint_t left, hb_codepoint_t right) const
-    { return table.get_kerning (left, right, c); }
+    {
+      if (unlikely (!left_classes || !right_classes ||
+		    left >= num_glyphs || right >= num_glyphs))
+	return table.get_kerning (left, right, c);
+      return table.get_class_kerning (left_classes[left], right_classes[right], c);
+    }
   };
 
   bool sanitize (hb_sanitize_context_t *c) const
@@ -494,6 +584,7 @@ struct KerxSubTableFormat4
 	c (c_),
 	action_type ((table->flags & ActionType) >> 30),
 	ankrData ((HBUINT16 *) ((const char *) &table->machine + (table->flags & Offset))),
+	actions_checked (c->subtable_actions_checked ()),
 	mark_set (false),
 	mark (0) {}
 
@@ -516,7 +607,7 @@ struct KerxSubTableFormat4
 	  {
 	    /* indexed into glyph outline. */
 	    const HBUINT16 *data = &ankrData[entry->data.ankrActionIndex];
-	    if (!c->sanitizer.check_array (data, 2))
+	    if (!actions_checked && !c->sanitizer.check_array (data, 2))
 	      return false;
 	    HB_UNUSED unsigned int markControlPoint = *data++;
 	    HB_UNUSED unsigned int currControlPoint = *data++;
@@ -543,7 +634,7 @@ struct KerxSubTableFormat4
 	  {
 	   /* Indexed into 'ankr' table. */
 	    const HBUINT16 *data = &ankrData[entry->data.ankrActionIndex];
-	    if (!c->sanitizer.check_array (data, 2))
+	    if (!actions_checked && !c->sanitizer.check_array (data, 2))
 	      return false;
 	    unsigned int markAnchorPoint = *data++;
 	    unsigned int currAnchorPoint = *data++;
@@ -564,7 +655,7 @@ struct KerxSubTableFormat4
 	  case 2: /* Control Point Coordinate Actions. */
 	  {
 	    const FWORD *data = (const FWORD *) &ankrData[entry->data.ankrActionIndex];
-	    if (!c->sanitizer.check_array (data, 4))
+	    if (!actions_checked && !c->sanitizer.check_array (data, 4))
 	      return false;
 	    int markX = *data++;
 	    int markY = *data++;
@@ -594,6 +685,7 @@ struct KerxSubTableFormat4
     hb_aat_apply_context_t *c;
     unsigned int action_type;
     const HBUINT16 *ankrData;
+    bool actions_checked;
     bool mark_set;
     unsigned int mark;
   };
@@ -604,12 +696,32 @@ struct KerxSubTableFormat4
 
     driver_context_t dc (this, c);
 
-    StateTableDriver<Types, EntryData> driver (machine, c->buffer, c->font->face);
+    StateTableDriver<Types, EntryData> driver (machine, c);
     driver.drive (&dc);
 
     return_trace (true);
   }
 
+  /* Whether the data of every action of the machine is in range; if so,
+   * transitions need not check it. */
+  bool check_actions (hb_sanitize_context_t *c) const
+  {
+    unsigned int num_entries;
+    if (unlikely (!machine.sanitize (c, &num_entries))) return false;
+
+    unsigned int action_type = (flags & driver_context_t::ActionType) >> 30;
+    unsigned int action_size = action_type == 2 ? 4 : 2;
+    const HBUINT16 *ankrData = (const HBUINT16 *) ((const char *) &machine + (flags & driver_context_t::Offset));
+    const Entry<EntryData> *entries = machine.get_entries ();
+    for (unsigned int i = 0; i < num_entries; i++)
+    {
+      unsigned int index = entries[i].data.ankrActionIndex;
+      if (index != 0xFFFF && !c->check_array (&ankrData[index], action_size))
+	return false;
+    }
+    return true;
+  }
+
   bool sanitize (hb_sanitize_context_t *c) const
   {
     TRACE_SANITIZE (this);
@@ -640,11 +752,22 @@ struct KerxSubTableFormat6
 			  hb_aat_apply_context_t *c) const
   {
     unsigned int num_glyphs = c->sanitizer.get_num_glyphs ();
+    if (is_long ())
+      return get_index_kerning ((this+u.l.rowIndexTable).get_value_or_null (left, num_glyphs),
+				(this+u.l.columnIndexTable).get_value_or_null (right, num_glyphs),
+				c);
+    else
+      return get_index_kerning ((this+u.s.rowIndexTable).get_value_or_null (left, num_glyphs),
+				(this+u.s.columnIndexTable).get_value_or_null (right, num_glyphs),
+				c);
+  }
+
+  int get_index_kerning (unsigned int l, unsigned int r,
+			 hb_aat_apply_context_t *c) const
+  {
     if (is_long ())
     {
       const typename U::Long &t = u.l;
-      unsigned int l = (this+t.rowIndexTable).get_value_or_null (left, num_glyphs);
-      unsigned int r = (this+t.columnIndexTable).get_value_or_null (right, num_glyphs);
       unsigned int offset = l + r;
       if (unlikely (offset < l)) return 0; /* Addition overflow. */
       if (unlikely (hb_unsigned_mul_overflows (offset, sizeof (FWORD32)))) return 0;
@@ -655,8 +778,6 @@ struct KerxSubTableFormat6
     else
     {
       const typename U::Short &t = u.s;
-      unsigned int l = (this+t.rowIndexTable).get_value_or_null (left, num_glyphs);
-      unsigned int r = (this+t.columnIndexTable).get_value_or_null (right, num_glyphs);
       unsigned int offset = l + r;
       const FWORD *v = &StructAtOffset<FWORD> (&(this+t.array), offset * sizeof (FWORD));
       if (unlikely (!v->sanitize (&c->sanitizer))) return 0;
@@ -703,13 +824,34 @@ struct KerxSubTableFormat6
   {
     const KerxSubTableFormat6 &table;
     hb_aat_apply_context_t *c;
+    unsigned int num_glyphs;
+    const uint32_t *rows;
+    const uint32_t *columns;
 
     accelerator_t (const KerxSubTableFormat6 &table_,
 		   hb_aat_apply_context_t *c_) :
-		     table (table_), c (c_) {}
+		     table (table_), c (c_),
+		     num_glyphs (c->sanitizer.get_num_glyphs ()),
+		     rows (get_indices (0, table.u.l.rowIndexTable, table.u.s.rowIndexTable)),
+		     columns (get_indices (1, table.u.l.columnIndexTable, table.u.s.columnIndexTable)) {}
+
+    const uint32_t *get_indices (unsigned int n,
+				 const LOffsetTo<Lookup<HBUINT32>, false> &long_lookup,
+				 const LOffsetTo<Lookup<HBUINT16>, false> &short_lookup) const
+    {
+      if (table.is_long ())
+	return c->get_cached_lookup<uint32_t> (n, lookup_value_getter_t<Lookup<HBUINT32> > (&table+long_lookup, num_glyphs));
+      else
+	return c->get_cached_lookup<uint32_t> (n, lookup_value_getter_t<Lookup<HBUINT16> > (&table+short_lookup, num_glyphs));
+    }
 
     int get_kerning (hb_codepoint_t left, hb_codepoint_t right) const
-    { return table.get_kerning (left, right, c); }
+    {
+      if (unlikely (!rows || !columns ||
+		    left >= num_glyphs || right >= num_glyphs))
+	return table.get_kerning (left, right, c);
+      return table.get_index_kerning (rows[left], columns[right], c);
+    }
   };
 
   protected:
@@ -795,6 +937,17 @@ struct KerxSubTable
     }
   }
 
+  /* Whether the state machine action data is all in range, as checked
+   * by check_actions() of the format; false for other formats. */
+  bool check_actions (hb_sanitize_context_t *c) const
+  {
+    switch (get_type ()) {
+    case 1:	return u.format1.check_actions (c);
+    case 4:	return u.format4.check_actions (c);
+    default:	return false;
+    }
+  }
+
   bool sanitize (hb_sanitize_context_t *c) const
   {
     TRACE_SANITIZE (this);
@@ -878,6 +1031,21 @@ struct KerxTable
     return v;
   }
 
+  /* Pushes to maps, for each subtable, the pair map of format 0 ones, as
+   * from create_pair_map(), or nullptr. */
+  void collect_pair_maps (hb_vector_t<hb_map_t *> *maps) const
+  {
+    typedef typename T::SubTable SubTable;
+
+    const SubTable *st = &thiz()->firstSubTable;
+    unsigned int count = thiz()->tableCount;
+    for (unsigned int i = 0; i < count; i++)
+    {
+      maps->push (st->get_type () == 0 ? st->u.format0.create_pair_map () : nullptr);
+      st = &StructAfter<SubTable> (*st);
+    }
+  }
+
   bool apply (AAT::hb_aat_apply_context_t *c) const
   {
     typedef typename T::SubTable SubTable;
@@ -990,6 +1158,81 @@ struct kerx : KerxTable<kerx>
 
   bool has_data () const { return version; }
 
+  struct accelerator_t
+  {
+    void init (hb_face_t *face)
+    {
+      table = hb_sanitize_context_t ().reference_table<kerx> (face);
+      lookup_cache.init (face->get_num_glyphs (), table->tableCount);
+      check_actions (face);
+      pair_maps.init ();
+      table->collect_pair_maps (&pair_maps);
+    }
+    void fini ()
+    {
+      lookup_cache.fini ();
+      checked_subtables.fini ();
+      for (unsigned int i = 0; i < pair_maps.length; i++)
+	hb_map_destroy (pair_maps[i]);
+      pair_maps.fini ();
+      table.destroy ();
+    }
+
+    unsigned int get_memory_usage () const
+    {
+      unsigned int size = lookup_cache.get_memory_usage () +
+			  checked_subtables.get_allocated_size () +
+			  pair_maps.get_allocated_size ();
+      for (unsigned int i = 0; i < pair_maps.length; i++)
+	if (pair_maps[i])
+	  size += sizeof (*pair_maps[i]) + pair_maps[i]->get_memory_usage ();
+      return size;
+    }
+
+    bool has_data () const { return table->has_data (); }
+    hb_blob_t *get_blob () const { return table.get_blob (); }
+
+    bool apply (hb_aat_apply_context_t *c) const
+    {
+      c->set_lookup_cache (&lookup_cache);
+      c->set_checked_subtables (&checked_subtables);
+      c->set_pair_maps (&pair_maps);
+      return table->apply (c);
+    }
+
+    private:
+    /* Checks, once, the action data of the state-machine subtables, the
+     * same way apply() would, so their drivers can skip it per action. */
+    void check_actions (hb_face_t *face)
+    {
+      checked_subtables.init ();
+      if (!table->has_data ()) return;
+
+      hb_sanitize_context_t c;
+      c.init (table.get_blob ());
+      c.set_num_glyphs (face->get_num_glyphs ());
+      c.start_processing ();
+      c.set_max_ops (HB_SANITIZE_MAX_OPS_MAX);
+
+      const SubTable *st = &table->firstSubTable;
+      unsigned int count = table->tableCount;
+      for (unsigned int i = 0; i < count; i++)
+      {
+	/* Same object range as in apply(). */
+	hb_sanitize_with_object_t with (&c, i < count - 1 ? st : (const SubTable *) nullptr);
+	checked_subtables.push (st->check_actions (&c));
+	st = &StructAfter<SubTable> (*st);
+      }
+
+      c.end_processing ();
+    }
+
+    hb_blob_ptr_t<kerx> table;
+    lookup_cache_t lookup_cache;
+    hb_vector_t<bool> checked_subtables;
+    hb_vector_t<hb_map_t *> pair_maps;
+  };
+
   protected:
   HBUINT16	version;	/* The version number of the extended kerning table
 				 * (currently 2, 3, or 4). */
@@ -1004,6 +1247,9 @@ struct kerx : KerxTable<kerx>
 };
 
 
+struct kerx_accelerator_t : kerx::accelerator_t {};
+
+
 } /* namespace AAT */
 
 
@@ -169,12 +169,23 @@ struct RearrangementSubtable
 
     driver_context_t dc (this);
 
-    StateTableDriver<Types, EntryData> driver (machine, c->buffer, c->face);
+    StateTableDriver<Types, EntryData> driver (machine, c);
     driver.drive (&dc);
 
     return_trace (dc.ret);
   }
 
+  static bool is_idle_entry (const Entry<EntryData> &entry)
+  { return !entry.flags; }
+  template <typename set_t>
+  void collect_glyphs (set_t *glyphs, unsigned int num_glyphs) const
+  {
+    if (machine.is_idle_outside_class_table (is_idle_entry))
+      machine.collect_glyphs (glyphs, num_glyphs);
+    else
+      glyphs->add_range (0, HB_SET_VALUE_INVALID - 1);
+  }
+
   bool sanitize (hb_sanitize_context_t *c) const
   {
     TRACE_SANITIZE (this);
@@ -317,12 +328,24 @@ struct ContextualSubtable
 
     driver_context_t dc (this, c);
 
-    StateTableDriver<Types, EntryData> driver (machine, c->buffer, c->face);
+    StateTableDriver<Types, EntryData> driver (machine, c);
     driver.drive (&dc);
 
     return_trace (dc.ret);
   }
 
+  static bool is_idle_entry (const Entry<EntryData> &entry)
+  { return Types::extended && !entry.flags &&
+	   entry.data.markIndex == 0xFFFF && entry.data.currentIndex == 0xFFFF; }
+  template <typename set_t>
+  void collect_glyphs (set_t *glyphs, unsigned int num_glyphs) const
+  {
+    if (machine.is_idle_outside_class_table (is_idle_entry))
+      machine.collect_glyphs (glyphs, num_glyphs);
+    else
+      glyphs->add_range (0, HB_SET_VALUE_INVALID - 1);
+  }
+
   bool sanitize (hb_sanitize_context_t *c) const
   {
     TRACE_SANITIZE (this);
@@ -573,12 +596,23 @@ struct LigatureSubtable
 
     driver_context_t dc (this, c);
 
-    StateTableDriver<Types, EntryData> driver (machine, c->buffer, c->face);
+    StateTableDriver<Types, EntryData> driver (machine, c);
     driver.drive (&dc);
 
     return_trace (dc.ret);
   }
 
+  static bool is_idle_entry (const Entry<EntryData> &entry)
+  { return !entry.flags; }
+  template <typename set_t>
+  void collect_glyphs (set_t *glyphs, unsigned int num_glyphs) const
+  {
+    if (machine.is_idle_outside_class_table (is_idle_entry))
+      machine.collect_glyphs (glyphs, num_glyphs);
+    else
+      glyphs->add_range (0, HB_SET_VALUE_INVALID - 1);
+  }
+
   bool sanitize (hb_sanitize_context_t *c) const
   {
     TRACE_SANITIZE (this);
@@ -625,6 +659,10 @@ struct NoncontextualSubtable
     return_trace (ret);
   }
 
+  template <typename set_t>
+  void collect_glyphs (set_t *glyphs, unsigned int num_glyphs) const
+  { substitute.collect_glyphs (glyphs, num_glyphs); }
+
   bool sanitize (hb_sanitize_context_t *c) const
   {
     TRACE_SANITIZE (this);
@@ -815,12 +853,24 @@ struct InsertionSubtable
 
     driver_context_t dc (this, c);
 
-    StateTableDriver<Types, EntryData> driver (machine, c->buffer, c->face);
+    StateTableDriver<Types, EntryData> driver (machine, c);
     driver.drive (&dc);
 
     return_trace (dc.ret);
   }
 
+  static bool is_idle_entry (const Entry<EntryData> &entry)
+  { return !entry.flags &&
+	   entry.data.currentInsertIndex == 0xFFFF && entry.data.markedInsertIndex == 0xFFFF; }
+  template <typename set_t>
+  void collect_glyphs (set_t *glyphs, unsigned int num_glyphs) const
+  {
+    if (machine.is_idle_outside_class_table (is_idle_entry))
+      machine.collect_glyphs (glyphs, num_glyphs);
+    else
+      glyphs->add_range (0, HB_SET_VALUE_INVALID - 1);
+  }
+
   bool sanitize (hb_sanitize_context_t *c) const
   {
     TRACE_SANITIZE (this);
@@ -918,6 +968,21 @@ struct ChainSubtable
     return_trace (dispatch (c));
   }
 
+  /* Adds the glyphs that applying the subtable may start from; a buffer
+   * with none of them is left alone. */
+  template <typename set_t>
+  void collect_glyphs (set_t *glyphs, unsigned int num_glyphs) const
+  {
+    switch (get_type ()) {
+    case Rearrangement:	u.rearrangement.collect_glyphs (glyphs, num_glyphs); return;
+    case Contextual:	u.contextual.collect_glyphs (glyphs, num_glyphs); return;
+    case Ligature:	u.ligature.collect_glyphs (glyphs, num_glyphs); return;
+    case Noncontextual:	u.noncontextual.collect_glyphs (glyphs, num_glyphs); return;
+    case Insertion:	u.insertion.collect_glyphs (glyphs, num_glyphs); return;
+    default:		return;
+    }
+  }
+
   bool sanitize (hb_sanitize_context_t *c) const
   {
     TRACE_SANITIZE (this);
@@ -979,9 +1044,28 @@ struct Chain
     return flags;
   }
 
+  /* Pushes, for each subtable, the digest of glyphs it may act on to
+   * map->subtable_digests; empty if flags disable the subtable. */
+  void collect_subtable_digests (hb_mask_t flags,
+				 unsigned int num_glyphs,
+				 hb_aat_map_t *map) const
+  {
+    const ChainSubtable<Types> *subtable = &StructAfter<ChainSubtable<Types> > (featureZ.as_array (featureCount));
+    unsigned int count = subtableCount;
+    for (unsigned int i = 0; i < count; i++)
+    {
+      hb_set_digest_t *digest = map->subtable_digests.push ();
+      digest->init ();
+      if (subtable->subFeatureFlags & flags)
+	subtable->collect_glyphs (digest, num_glyphs);
+      subtable = &StructAfter<ChainSubtable<Types> > (*subtable);
+    }
+  }
+
   void apply (hb_aat_apply_context_t *c,
 		     hb_mask_t flags) const
   {
+    const hb_vector_t<hb_set_digest_t> &digests = c->plan->aat_map.subtable_digests;
     const ChainSubtable<Types> *subtable = &StructAfter<ChainSubtable<Types> > (featureZ.as_array (featureCount));
     unsigned int count = subtableCount;
     for (unsigned int i = 0; i < count; i++)
@@ -991,6 +1075,18 @@ struct Chain
       if (!(subtable->subFeatureFlags & flags))
         goto skip;
 
+      if (c->lookup_index < digests.length &&
+	  !digests[c->lookup_index].is_full ())
+      {
+	if (!c->buffer_digest_valid)
+	{
+	  c->buffer_digest = c->buffer->digest ();
+	  c->buffer_digest_valid = true;
+	}
+	if (!c->buffer_digest.may_have (digests[c->lookup_index]))
+	  goto skip;
+      }
+
       if (!(subtable->get_coverage() & ChainSubtable<Types>::AllDirections) &&
 	  HB_DIRECTION_IS_VERTICAL (c->buffer->props.direction) !=
 	  bool (subtable->get_coverage() & ChainSubtable<Types>::Vertical))
@@ -1031,13 +1127,20 @@ struct Chain
       if (!c->buffer->message (c->font, "start chain subtable %d", c->lookup_index))
         goto skip;
 
-      if (reverse)
-        c->buffer->reverse ();
+      {
+	uint64_t start = c->buffer->trace_start ();
+
+	if (reverse)
+	  c->buffer->reverse ();
+
+	subtable->apply (c);
+	c->buffer_digest_valid = false;
 
-      subtable->apply (c);
+	if (reverse)
+	  c->buffer->reverse ();
 
-      if (reverse)
-        c->buffer->reverse ();
+	c->buffer->trace (c->font, HB_BUFFER_TRACE_EVENT_MORX_SUBTABLE, c->lookup_index, start);
+      }
 
       (void) c->buffer->message (c->font, "end chain subtable %d", c->lookup_index);
 
@@ -1050,6 +1153,7 @@ struct Chain
   }
 
   unsigned int get_size () const { return length; }
+  unsigned int get_subtable_count () const { return subtableCount; }
 
   bool sanitize (hb_sanitize_context_t *c, unsigned int version HB_UNUSED) const
   {
@@ -1103,19 +1207,36 @@ struct mortmorx
   void compile_flags (const hb_aat_map_builder_t *mapper,
 		      hb_aat_map_t *map) const
   {
+    unsigned int num_glyphs = mapper->face->get_num_glyphs ();
     const Chain<Types> *chain = &firstChain;
     unsigned int count = chainCount;
     for (unsigned int i = 0; i < count; i++)
     {
-      map->chain_flags.push (chain->compile_flags (mapper));
+      hb_mask_t flags = chain->compile_flags (mapper);
+      map->chain_flags.push (flags);
+      chain->collect_subtable_digests (flags, num_glyphs, map);
       chain = &StructAfter<Chain<Types> > (*chain);
     }
   }
 
+  unsigned int get_subtable_count () const
+  {
+    unsigned int total = 0;
+    const Chain<Types> *chain = &firstChain;
+    unsigned int count = chainCount;
+    for (unsigned int i = 0; i < count; i++)
+    {
+      total += chain->get_subtable_count ();
+      chain = &StructAfter<Chain<Types> > (*chain);
+    }
+    return total;
+  }
+
   void apply (hb_aat_apply_context_t *c) const
   {
     if (unlikely (!c->buffer->successful)) return;
     c->set_lookup_index (0);
+    c->buffer_digest_valid = false;
     const Chain<Types> *chain = &firstChain;
     unsigned int count = chainCount;
     for (unsigned int i = 0; i < count; i++)
@@ -1159,12 +1280,48 @@ struct mortmorx
 struct morx : mortmorx<ExtendedTypes>
 {
   enum { tableTag = HB_AAT_TAG_morx };
+
+  struct accelerator_t
+  {
+    void init (hb_face_t *face)
+    {
+      table = hb_sanitize_context_t ().reference_table<morx> (face);
+      lookup_cache.init (face->get_num_glyphs (), table->get_subtable_count ());
+    }
+    void fini ()
+    {
+      lookup_cache.fini ();
+      table.destroy ();
+    }
+
+    unsigned int get_memory_usage () const
+    { return lookup_cache.get_memory_usage (); }
+
+    bool has_data () const { return table->has_data (); }
+    hb_blob_t *get_blob () const { return table.get_blob (); }
+
+    void compile_flags (const hb_aat_map_builder_t *mapper,
+			hb_aat_map_t *map) const
+    { table->compile_flags (mapper, map); }
+
+    void apply (hb_aat_apply_context_t *c) const
+    {
+      c->set_lookup_cache (&lookup_cache);
+      table->apply (c);
+    }
+
+    private:
+    hb_blob_ptr_t<morx> table;
+    lookup_cache_t lookup_cache;
+  };
 };
 struct mort : mortmorx<ObsoleteTypes>
 {
   enum { tableTag = HB_AAT_TAG_mort };
 };
 
+struct morx_accelerator_t : morx::accelerator_t {};
+
 
 } /* namespace AAT */
 
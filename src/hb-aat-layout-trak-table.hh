@@ -164,6 +164,22 @@ struct trak
 
   bool has_data () const { return version.to_int (); }
 
+  /* Returns the tracking at the font's ptem, in font units; remembers it
+   * on the font, for later runs. */
+  int get_tracking (hb_font_t *font, bool horizontal) const
+  {
+    hb_atomic_int_t &cached = font->tracking_cache[horizontal ? 0 : 1];
+    int v = cached.get_relaxed ();
+    if (likely (v))
+      return (v - 1) / 2;
+
+    const TrackData &trackData = this+(horizontal ? horizData : vertData);
+    int tracking = trackData.get_tracking (this, font->ptem);
+    if (likely (-0x10000000 < tracking && tracking < 0x10000000))
+      cached.set_relaxed (tracking * 2 + 1);
+    return tracking;
+  }
+
   bool apply (hb_aat_apply_context_t *c) const
   {
     TRACE_APPLY (this);
@@ -177,8 +193,7 @@ struct trak
     hb_buffer_t *buffer = c->buffer;
     if (HB_DIRECTION_IS_HORIZONTAL (buffer->props.direction))
     {
-      const TrackData &trackData = this+horizData;
-      int tracking = trackData.get_tracking (this, ptem);
+      int tracking = get_tracking (c->font, true);
       hb_position_t offset_to_add = c->font->em_scalef_x (tracking / 2);
       hb_position_t advance_to_add = c->font->em_scalef_x (tracking);
       foreach_grapheme (buffer, start, end)
@@ -190,8 +205,7 @@ struct trak
     }
     else
     {
-      const TrackData &trackData = this+vertData;
-      int tracking = trackData.get_tracking (this, ptem);
+      int tracking = get_tracking (c->font, false);
       hb_position_t offset_to_add = c->font->em_scalef_y (tracking / 2);
       hb_position_t advance_to_add = c->font->em_scalef_y (tracking);
       foreach_grapheme (buffer, start, end)
@@ -158,9 +158,14 @@ AAT::hb_aat_apply_context_t::hb_aat_apply_context_t (const hb_ot_shape_plan_t *p
 						       sanitizer (),
 						       ankr_table (&Null(AAT::ankr)),
 						       ankr_end (nullptr),
+						       lookup_cache (nullptr),
+						       checked_subtables (nullptr),
+						       pair_maps (nullptr),
+						       buffer_digest_valid (false),
 						       lookup_index (0),
 						       debug_depth (0)
 {
+  buffer_digest.init ();
   sanitizer.init (blob);
   sanitizer.set_num_glyphs (face->get_num_glyphs ());
   sanitizer.start_processing ();
@@ -184,11 +189,12 @@ AAT::hb_aat_apply_context_t::set_ankr_table (const AAT::ankr *ankr_table_,
  */
 
 
+#ifndef HB_NO_AAT
 void
 hb_aat_layout_compile_map (const hb_aat_map_builder_t *mapper,
 			   hb_aat_map_t *map)
 {
-  const AAT::morx& morx = *mapper->face->table.morx;
+  const AAT::morx_accelerator_t& morx = *mapper->face->table.morx;
   if (morx.has_data ())
   {
     morx.compile_flags (mapper, map);
@@ -202,6 +208,7 @@ hb_aat_layout_compile_map (const hb_aat_map_builder_t *mapper,
     return;
   }
 }
+#endif
 
 
 /*
@@ -212,22 +219,26 @@ hb_aat_layout_compile_map (const hb_aat_map_builder_t *mapper,
  * Since: 2.3.0
  */
 hb_bool_t
-hb_aat_layout_has_substitution (hb_face_t *face)
+hb_aat_layout_has_substitution (hb_face_t *face HB_UNUSED)
 {
+#ifdef HB_NO_AAT
+  return false;
+#else
   return face->table.morx->has_data () ||
 	 face->table.mort->has_data ();
+#endif
 }
 
+#ifndef HB_NO_AAT
 void
 hb_aat_layout_substitute (const hb_ot_shape_plan_t *plan,
 			  hb_font_t *font,
 			  hb_buffer_t *buffer)
 {
-  hb_blob_t *morx_blob = font->face->table.morx.get_blob ();
-  const AAT::morx& morx = *morx_blob->as<AAT::morx> ();
+  const AAT::morx_accelerator_t& morx = *font->face->table.morx;
   if (morx.has_data ())
   {
-    AAT::hb_aat_apply_context_t c (plan, font, buffer, morx_blob);
+    AAT::hb_aat_apply_context_t c (plan, font, buffer, morx.get_blob ());
     morx.apply (&c);
     return;
   }
@@ -242,17 +253,6 @@ hb_aat_layout_substitute (const hb_ot_shape_plan_t *plan,
   }
 }
 
-void
-hb_aat_layout_zero_width_deleted_glyphs (hb_buffer_t *buffer)
-{
-  unsigned int count = buffer->len;
-  hb_glyph_info_t *info = buffer->info;
-  hb_glyph_position_t *pos = buffer->pos;
-  for (unsigned int i = 0; i < count; i++)
-    if (unlikely (info[i].codepoint == AAT::DELETED_GLYPH))
-      pos[i].x_advance = pos[i].y_advance = pos[i].x_offset = pos[i].y_offset = 0;
-}
-
 static bool
 is_deleted_glyph (const hb_glyph_info_t *info)
 {
@@ -264,6 +264,7 @@ hb_aat_layout_remove_deleted_glyphs (hb_buffer_t *buffer)
 {
   hb_ot_layout_delete_glyphs_inplace (buffer, is_deleted_glyph);
 }
+#endif
 
 /*
  * hb_aat_layout_has_positioning:
@@ -273,26 +274,31 @@ hb_aat_layout_remove_deleted_glyphs (hb_buffer_t *buffer)
  * Since: 2.3.0
  */
 hb_bool_t
-hb_aat_layout_has_positioning (hb_face_t *face)
+hb_aat_layout_has_positioning (hb_face_t *face HB_UNUSED)
 {
+#ifdef HB_NO_AAT
+  return false;
+#else
   return face->table.kerx->has_data ();
+#endif
 }
 
+#ifndef HB_NO_AAT
 void
 hb_aat_layout_position (const hb_ot_shape_plan_t *plan,
 			hb_font_t *font,
 			hb_buffer_t *buffer)
 {
-  hb_blob_t *kerx_blob = font->face->table.kerx.get_blob ();
-  const AAT::kerx& kerx = *kerx_blob->as<AAT::kerx> ();
+  const AAT::kerx_accelerator_t& kerx = *font->face->table.kerx;
 
   hb_blob_t *ankr_blob = font->face->table.ankr.get_blob ();;
   const AAT::ankr& ankr = *font->face->table.ankr;
 
-  AAT::hb_aat_apply_context_t c (plan, font, buffer, kerx_blob);
+  AAT::hb_aat_apply_context_t c (plan, font, buffer, kerx.get_blob ());
   c.set_ankr_table (&ankr, ankr_blob->data + ankr_blob->length);
   kerx.apply (&c);
 }
+#endif
 
 
 /*
@@ -303,11 +309,16 @@ hb_aat_layout_position (const hb_ot_shape_plan_t *plan,
  * Since: 2.3.0
  */
 hb_bool_t
-hb_aat_layout_has_tracking (hb_face_t *face)
+hb_aat_layout_has_tracking (hb_face_t *face HB_UNUSED)
 {
+#ifdef HB_NO_AAT
+  return false;
+#else
   return face->table.trak->has_data ();
+#endif
 }
 
+#ifndef HB_NO_AAT
 void
 hb_aat_layout_track (const hb_ot_shape_plan_t *plan,
 		     hb_font_t *font,
@@ -318,6 +329,7 @@ hb_aat_layout_track (const hb_ot_shape_plan_t *plan,
   AAT::hb_aat_apply_context_t c (plan, font, buffer);
   trak.apply (&c);
 }
+#endif
 
 
 hb_language_t
@@ -51,7 +51,7 @@ void hb_aat_map_builder_t::add_feature (hb_tag_t tag,
 }
 
 void
-hb_aat_map_builder_t::compile (hb_aat_map_t  &m)
+hb_aat_map_builder_t::compile (hb_aat_map_t  &m HB_UNUSED)
 {
   /* Sort features and merge duplicates */
   if (features.length)
@@ -64,5 +64,7 @@ hb_aat_map_builder_t::compile (hb_aat_map_t  &m)
     features.shrink (j + 1);
   }
 
+#ifndef HB_NO_AAT
   hb_aat_layout_compile_map (this, &m);
+#endif
 }
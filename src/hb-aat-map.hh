@@ -28,6 +28,7 @@
 #define HB_AAT_MAP_HH
 
 #include "hb.hh"
+#include "hb-set-digest.hh"
 
 
 struct hb_aat_map_t
@@ -40,11 +41,21 @@ struct hb_aat_map_t
   {
     memset (this, 0, sizeof (*this));
     chain_flags.init ();
+    subtable_digests.init ();
   }
-  void fini () { chain_flags.fini (); }
+  void fini ()
+  {
+    chain_flags.fini ();
+    subtable_digests.fini ();
+  }
+
+  unsigned int get_memory_usage () const
+  { return chain_flags.get_allocated_size () + subtable_digests.get_allocated_size (); }
 
   public:
   hb_vector_t<hb_mask_t> chain_flags;
+  /* Per subtable, of all chains: glyphs it may act on, given chain_flags. */
+  hb_vector_t<hb_set_digest_t> subtable_digests;
 };
 
 struct hb_aat_map_builder_t
@@ -0,0 +1,137 @@
+/*
+ * Copyright © 2018  Google, Inc.
+ *
+ *  This is part of HarfBuzz, a text shaping library.
+ *
+ * Permission is hereby granted, without written agreement and without
+ * license or royalty fees, to use, copy, modify, and distribute this
+ * software and its documentation for any purpose, provided that the
+ * above copyright notice and the following two paragraphs appear in
+ * all copies of this software.
+ *
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE TO ANY PARTY FOR
+ * DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES
+ * ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION, EVEN
+ * IF THE COPYRIGHT HOLDER HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * THE COPYRIGHT HOLDER SPECIFICALLY DISCLAIMS ANY WARRANTIES, INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER IS
+ * ON AN "AS IS" BASIS, AND THE COPYRIGHT HOLDER HAS NO OBLIGATION TO
+ * PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+ */
+
+#ifndef HB_ARENA_HH
+#define HB_ARENA_HH
+
+#include "hb.hh"
+
+
+/*
+ * hb_arena_t
+ *
+ * Bump allocator for short-lived temporaries.  Memory is handed out
+ * from a chain of blocks and only released, all at once, by fini ().
+ * Not thread-safe.
+ */
+
+#ifndef HB_ARENA_BLOCK_SIZE
+#define HB_ARENA_BLOCK_SIZE 16384
+#endif
+
+struct hb_arena_t
+{
+  HB_NO_COPY_ASSIGN (hb_arena_t);
+  hb_arena_t ()  { init (); }
+  ~hb_arena_t () { fini (); }
+
+  void init ()
+  {
+    blocks = nullptr;
+    head = tail = nullptr;
+  }
+
+  void fini ()
+  {
+    while (blocks)
+    {
+      block_t *next = blocks->next;
+      free (blocks);
+      blocks = next;
+    }
+    init ();
+  }
+
+  /* Returns zeroed memory, aligned for any fundamental type, or nullptr
+   * on allocation failure. */
+  void *alloc (unsigned int size)
+  {
+    size = (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+    if (unlikely ((unsigned int) (tail - head) < size))
+    {
+      if (unlikely (size > HB_ARENA_BLOCK_SIZE))
+	return alloc_block (size);
+      if (unlikely (!new_block ()))
+	return nullptr;
+    }
+    void *p = head;
+    head += size;
+    return p;
+  }
+
+  template <typename Type>
+  Type *alloc_array (unsigned int count)
+  {
+    if (unlikely (hb_unsigned_mul_overflows (count, sizeof (Type)) ||
+		  count * sizeof (Type) > (unsigned int) -1 - ALIGNMENT))
+      return nullptr;
+    return (Type *) alloc (count * sizeof (Type));
+  }
+
+  private:
+  enum { ALIGNMENT = 16 };
+
+  struct block_t
+  {
+    block_t *next;
+    /* Pad the header so that the data following it is aligned. */
+    char padding[ALIGNMENT - sizeof (block_t *)];
+  };
+
+  /* A block holding just one allocation; chained behind the current
+   * block so that bumping continues where it was. */
+  void *alloc_block (unsigned int size)
+  {
+    block_t *block = (block_t *) calloc (1, sizeof (block_t) + size);
+    if (unlikely (!block))
+      return nullptr;
+    if (blocks)
+    {
+      block->next = blocks->next;
+      blocks->next = block;
+    }
+    else
+      blocks = block;
+    return block + 1;
+  }
+
+  bool new_block ()
+  {
+    block_t *block = (block_t *) calloc (1, sizeof (block_t) + HB_ARENA_BLOCK_SIZE);
+    if (unlikely (!block))
+      return false;
+    block->next = blocks;
+    blocks = block;
+    head = (char *) (block + 1);
+    tail = head + HB_ARENA_BLOCK_SIZE;
+    return true;
+  }
+
+  block_t *blocks;
+  char *head;
+  char *tail;
+};
+
+
+#endif /* HB_ARENA_HH */
@@ -420,6 +420,40 @@ hb_blob_t::try_make_writable_inplace_unix ()
 #endif
 }
 
+void
+hb_blob_t::prefetch (unsigned int offset, unsigned int length) const
+{
+#if defined(HAVE_SYS_MMAN_H) && defined(HAVE_MADVISE) && defined(MADV_WILLNEED)
+  if (offset >= this->length)
+    return;
+  length = MIN (length, this->length - offset);
+  if (!length)
+    return;
+
+  uintptr_t pagesize = -1;
+#if defined(HAVE_SYSCONF) && defined(_SC_PAGE_SIZE)
+  pagesize = (uintptr_t) sysconf (_SC_PAGE_SIZE);
+#elif defined(HAVE_SYSCONF) && defined(_SC_PAGESIZE)
+  pagesize = (uintptr_t) sysconf (_SC_PAGESIZE);
+#elif defined(HAVE_GETPAGESIZE)
+  pagesize = (uintptr_t) getpagesize ();
+#endif
+  if (unlikely (!pagesize || (uintptr_t) -1L == pagesize))
+    return;
+
+  /* For memory that is not file-backed this just fails or does nothing,
+   * so there's no need to tell the two apart. */
+  uintptr_t mask = ~(pagesize-1);
+  const char *addr = (const char *) (((uintptr_t) this->data + offset) & mask);
+  const char *end = (const char *) (((uintptr_t) this->data + offset + length + pagesize-1) & mask);
+  DEBUG_MSG_FUNC (BLOB, this,
+		  "calling madvise on [%p..%p] (%lu bytes)",
+		  addr, end, (unsigned long) (end - addr));
+  if (-1 == madvise ((void *) addr, end - addr, MADV_WILLNEED))
+    DEBUG_MSG_FUNC (BLOB, this, "madvise failed: %s", strerror (errno));
+#endif
+}
+
 bool
 hb_blob_t::try_make_writable_inplace ()
 {
@@ -483,6 +517,7 @@ hb_blob_t::try_make_writable ()
 
 #ifdef _WIN32
 # include <windows.h>
+# include <io.h>
 #else
 # ifndef O_BINARY
 #  define O_BINARY 0
@@ -520,6 +555,103 @@ _hb_mapped_file_destroy (void *file_)
 }
 #endif
 
+#if defined(HAVE_MMAP) && !defined(HB_NO_MMAP)
+/* Maps up to length bytes of fd starting at offset.  Returns nullptr if
+ * the file cannot be mapped, for the caller to fall back to reading it. */
+static hb_blob_t *
+_hb_blob_map_fd (int fd, unsigned int offset, unsigned int length)
+{
+  struct stat st;
+  if (unlikely (fstat (fd, &st) == -1 || !S_ISREG (st.st_mode))) return nullptr;
+
+  unsigned long long size = (unsigned long long) st.st_size;
+  if (offset >= size) return hb_blob_get_empty ();
+  if (length > size - offset) length = size - offset;
+
+  uintptr_t pagesize = (uintptr_t) -1;
+#if defined(HAVE_SYSCONF) && defined(_SC_PAGE_SIZE)
+  pagesize = (uintptr_t) sysconf (_SC_PAGE_SIZE);
+#elif defined(HAVE_SYSCONF) && defined(_SC_PAGESIZE)
+  pagesize = (uintptr_t) sysconf (_SC_PAGESIZE);
+#elif defined(HAVE_GETPAGESIZE)
+  pagesize = (uintptr_t) getpagesize ();
+#endif
+  /* Without a page size, only whole files can be mapped. */
+  if (unlikely (!pagesize || (uintptr_t) -1 == pagesize))
+    pagesize = offset ? 0 : 1;
+  if (unlikely (!pagesize)) return nullptr;
+
+  hb_mapped_file_t *file = (hb_mapped_file_t *) calloc (1, sizeof (hb_mapped_file_t));
+  if (unlikely (!file)) return nullptr;
+
+  /* mmap() wants a page-aligned offset. */
+  unsigned int delta = offset % pagesize;
+  file->length = (unsigned long) delta + length;
+  file->contents = (char *) mmap (nullptr, file->length, PROT_READ,
+				  MAP_PRIVATE | MAP_NORESERVE, fd, offset - delta);
+  if (unlikely (file->contents == MAP_FAILED))
+  {
+    free (file);
+    return nullptr;
+  }
+
+  return hb_blob_create (file->contents + delta, length,
+			 HB_MEMORY_MODE_READONLY_MAY_MAKE_WRITABLE, (void *) file,
+			 (hb_destroy_func_t) _hb_mapped_file_destroy);
+}
+
+#elif defined(_WIN32) && !defined(HB_NO_MMAP)
+/* Maps up to length bytes of fd starting at offset.  Returns nullptr if
+ * the file cannot be mapped, for the caller to fall back to reading it. */
+static hb_blob_t *
+_hb_blob_map_handle (HANDLE fd, unsigned int offset, unsigned int length)
+{
+  LARGE_INTEGER file_size;
+  if (unlikely (!GetFileSizeEx (fd, &file_size))) return nullptr;
+
+  unsigned long long size = (unsigned long long) file_size.QuadPart;
+  if (offset >= size) return hb_blob_get_empty ();
+  if (length > size - offset) length = size - offset;
+
+  /* MapViewOfFile() wants an offset aligned to the allocation granularity. */
+  SYSTEM_INFO info;
+  GetSystemInfo (&info);
+  unsigned int delta = info.dwAllocationGranularity ? offset % info.dwAllocationGranularity : 0;
+
+  hb_mapped_file_t *file = (hb_mapped_file_t *) calloc (1, sizeof (hb_mapped_file_t));
+  if (unlikely (!file)) return nullptr;
+  file->length = (unsigned long) delta + length;
+
+#if defined(WINAPI_FAMILY) && (WINAPI_FAMILY==WINAPI_FAMILY_PC_APP || WINAPI_FAMILY==WINAPI_FAMILY_PHONE_APP)
+  file->mapping = CreateFileMappingFromApp (fd, nullptr, PAGE_READONLY, 0, nullptr);
+#else
+  file->mapping = CreateFileMapping (fd, nullptr, PAGE_READONLY, 0, 0, nullptr);
+#endif
+  if (unlikely (file->mapping == nullptr)) goto fail;
+
+#if defined(WINAPI_FAMILY) && (WINAPI_FAMILY==WINAPI_FAMILY_PC_APP || WINAPI_FAMILY==WINAPI_FAMILY_PHONE_APP)
+  file->contents = (char *) MapViewOfFileFromApp (file->mapping, FILE_MAP_READ,
+						  offset - delta, file->length);
+#else
+  file->contents = (char *) MapViewOfFile (file->mapping, FILE_MAP_READ,
+					   0, offset - delta, file->length);
+#endif
+  if (unlikely (file->contents == nullptr))
+  {
+    CloseHandle (file->mapping);
+    goto fail;
+  }
+
+  return hb_blob_create (file->contents + delta, length,
+			 HB_MEMORY_MODE_READONLY_MAY_MAKE_WRITABLE, (void *) file,
+			 (hb_destroy_func_t) _hb_mapped_file_destroy);
+
+fail:
+  free (file);
+  return nullptr;
+}
+#endif
+
 /**
  * hb_blob_create_from_file:
  * @file_name: font filename.
@@ -534,36 +666,15 @@ hb_blob_create_from_file (const char *file_name)
   /* Adopted from glib's gmappedfile.c with Matthias Clasen and
      Allison Lortie permission but changed a lot to suit our need. */
 #if defined(HAVE_MMAP) && !defined(HB_NO_MMAP)
-  hb_mapped_file_t *file = (hb_mapped_file_t *) calloc (1, sizeof (hb_mapped_file_t));
-  if (unlikely (!file)) return hb_blob_get_empty ();
-
   int fd = open (file_name, O_RDONLY | O_BINARY, 0);
-  if (unlikely (fd == -1)) goto fail_without_close;
-
-  struct stat st;
-  if (unlikely (fstat (fd, &st) == -1)) goto fail;
-
-  file->length = (unsigned long) st.st_size;
-  file->contents = (char *) mmap (nullptr, file->length, PROT_READ,
-				  MAP_PRIVATE | MAP_NORESERVE, fd, 0);
-
-  if (unlikely (file->contents == MAP_FAILED)) goto fail;
-
-  close (fd);
-
-  return hb_blob_create (file->contents, file->length,
-			 HB_MEMORY_MODE_READONLY_MAY_MAKE_WRITABLE, (void *) file,
-			 (hb_destroy_func_t) _hb_mapped_file_destroy);
-
-fail:
-  close (fd);
-fail_without_close:
-  free (file);
+  if (likely (fd != -1))
+  {
+    hb_blob_t *blob = _hb_blob_map_fd (fd, 0, (unsigned int) -1);
+    close (fd);
+    if (blob) return blob;
+  }
 
 #elif defined(_WIN32) && !defined(HB_NO_MMAP)
-  hb_mapped_file_t *file = (hb_mapped_file_t *) calloc (1, sizeof (hb_mapped_file_t));
-  if (unlikely (!file)) return hb_blob_get_empty ();
-
   HANDLE fd;
   unsigned int size = strlen (file_name) + 1;
   wchar_t * wchar_file_name = (wchar_t *) malloc (sizeof (wchar_t) * size);
@@ -588,37 +699,13 @@ fail_without_close:
 #endif
   free (wchar_file_name);
 
-  if (unlikely (fd == INVALID_HANDLE_VALUE)) goto fail_without_close;
-
-#if defined(WINAPI_FAMILY) && (WINAPI_FAMILY==WINAPI_FAMILY_PC_APP || WINAPI_FAMILY==WINAPI_FAMILY_PHONE_APP)
+  if (likely (fd != INVALID_HANDLE_VALUE))
   {
-    LARGE_INTEGER length;
-    GetFileSizeEx (fd, &length);
-    file->length = length.LowPart;
-    file->mapping = CreateFileMappingFromApp (fd, nullptr, PAGE_READONLY, length.QuadPart, nullptr);
+    hb_blob_t *blob = _hb_blob_map_handle (fd, 0, (unsigned int) -1);
+    CloseHandle (fd);
+    if (blob) return blob;
   }
-#else
-  file->length = (unsigned long) GetFileSize (fd, nullptr);
-  file->mapping = CreateFileMapping (fd, nullptr, PAGE_READONLY, 0, 0, nullptr);
-#endif
-  if (unlikely (file->mapping == nullptr)) goto fail;
-
-#if defined(WINAPI_FAMILY) && (WINAPI_FAMILY==WINAPI_FAMILY_PC_APP || WINAPI_FAMILY==WINAPI_FAMILY_PHONE_APP)
-  file->contents = (char *) MapViewOfFileFromApp (file->mapping, FILE_MAP_READ, 0, 0);
-#else
-  file->contents = (char *) MapViewOfFile (file->mapping, FILE_MAP_READ, 0, 0, 0);
-#endif
-  if (unlikely (file->contents == nullptr)) goto fail;
-
-  CloseHandle (fd);
-  return hb_blob_create (file->contents, file->length,
-			 HB_MEMORY_MODE_READONLY_MAY_MAKE_WRITABLE, (void *) file,
-			 (hb_destroy_func_t) _hb_mapped_file_destroy);
-
-fail:
-  CloseHandle (fd);
 fail_without_close:
-  free (file);
 
 #endif
 
@@ -664,3 +751,87 @@ fread_fail_without_close:
   free (data);
   return hb_blob_get_empty ();
 }
+
+/* Reads up to length bytes of fd starting at offset, or from the current
+ * position for offset 0 if fd cannot seek. */
+static hb_blob_t *
+_hb_blob_read_fd (int fd, unsigned int offset, unsigned int length)
+{
+#if defined(HAVE_UNISTD_H) || defined(_WIN32)
+  if (unlikely (lseek (fd, offset, SEEK_SET) < 0 && offset)) return hb_blob_get_empty ();
+
+  unsigned long len = 0, allocated = BUFSIZ * 16;
+  if (allocated > length) allocated = length;
+  if (unlikely (!allocated)) return hb_blob_get_empty ();
+  char *data = (char *) malloc (allocated);
+  if (unlikely (data == nullptr)) return hb_blob_get_empty ();
+
+  while (len < length)
+  {
+    if (len == allocated)
+    {
+      allocated = allocated * 2 < length ? allocated * 2 : length;
+      /* Same limit as the file reader above. */
+      if (unlikely (allocated > (2 << 28))) goto fail;
+      char *new_data = (char *) realloc (data, allocated);
+      if (unlikely (new_data == nullptr)) goto fail;
+      data = new_data;
+    }
+
+    long addition = (long) read (fd, data + len, allocated - len);
+#ifdef EINTR // armcc doesn't have it
+    if (unlikely (addition < 0 && errno == EINTR)) continue;
+#endif
+    if (unlikely (addition < 0)) goto fail;
+    if (!addition) break;
+
+    len += addition;
+  }
+
+  return hb_blob_create (data, len, HB_MEMORY_MODE_WRITABLE, data,
+			 (hb_destroy_func_t) free);
+
+fail:
+  free (data);
+#endif
+  return hb_blob_get_empty ();
+}
+
+/**
+ * hb_blob_create_from_fd:
+ * @fd: a file descriptor open for reading.
+ * @offset: where the contents start in the file, in bytes.
+ * @length: maximum length of the contents, in bytes; -1 for up to the end of the file.
+ *
+ * Creates a blob with part of an open file, such as a font embedded in a
+ * larger archive.  Regular files are memory-mapped where possible rather
+ * than copied.  Otherwise the range is read, which moves the file position;
+ * for files that cannot seek, such as pipes, @offset must be 0 and reading
+ * starts at the current position.
+ *
+ * @fd is not closed, and does not need to stay open once this returns.
+ *
+ * Returns: A hb_blob_t pointer with the contents of the range, which may be
+ * shorter than @length at the end of the file.  The empty blob on failure.
+ *
+ * Since: REPLACEME
+ **/
+hb_blob_t *
+hb_blob_create_from_fd (int          fd,
+			unsigned int offset,
+			unsigned int length)
+{
+#if defined(HAVE_MMAP) && !defined(HB_NO_MMAP)
+  hb_blob_t *blob = _hb_blob_map_fd (fd, offset, length);
+  if (blob) return blob;
+#elif defined(_WIN32) && !defined(HB_NO_MMAP)
+  HANDLE handle = (HANDLE) _get_osfhandle (fd);
+  if (handle != INVALID_HANDLE_VALUE)
+  {
+    hb_blob_t *blob = _hb_blob_map_handle (handle, offset, length);
+    if (blob) return blob;
+  }
+#endif
+
+  return _hb_blob_read_fd (fd, offset, length);
+}
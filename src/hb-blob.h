@@ -126,6 +126,11 @@ hb_blob_get_data_writable (hb_blob_t *blob, unsigned int *length);
 HB_EXTERN hb_blob_t *
 hb_blob_create_from_file (const char *file_name);
 
+HB_EXTERN hb_blob_t *
+hb_blob_create_from_fd (int          fd,
+			unsigned int offset,
+			unsigned int length);
+
 HB_END_DECLS
 
 #endif /* HB_BLOB_H */
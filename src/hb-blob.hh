@@ -53,6 +53,8 @@ struct hb_blob_t
   HB_INTERNAL bool try_make_writable ();
   HB_INTERNAL bool try_make_writable_inplace ();
   HB_INTERNAL bool try_make_writable_inplace_unix ();
+  /* Hints that length bytes of data from offset will be read soon. */
+  HB_INTERNAL void prefetch (unsigned int offset, unsigned int length) const;
 
   template <typename Type>
   const Type* as () const
@@ -30,6 +30,7 @@
 static const char *serialize_formats[] = {
   "text",
   "json",
+  "binary",
   nullptr
 };
 
@@ -89,182 +90,541 @@ hb_buffer_serialize_format_to_string (hb_buffer_serialize_format_t format)
   {
     case HB_BUFFER_SERIALIZE_FORMAT_TEXT:	return serialize_formats[0];
     case HB_BUFFER_SERIALIZE_FORMAT_JSON:	return serialize_formats[1];
+    case HB_BUFFER_SERIALIZE_FORMAT_BINARY:	return serialize_formats[2];
     default:
     case HB_BUFFER_SERIALIZE_FORMAT_INVALID:	return nullptr;
   }
 }
 
-static unsigned int
-_hb_buffer_serialize_glyphs_json (hb_buffer_t *buffer,
-				  unsigned int start,
-				  unsigned int end,
-				  char *buf,
-				  unsigned int buf_size,
-				  unsigned int *buf_consumed,
-				  hb_font_t *font,
-				  hb_buffer_serialize_flags_t flags)
+/*
+ * Serializing a glyph used to be a handful of snprintf() calls and a
+ * glyph-name lookup through the font funcs; for tools that serialize
+ * every buffer they shape, that dominated.  Format numbers by hand and
+ * remember the names of recently seen glyphs instead.
+ */
+
+static inline char *
+_hb_serialize_uint (char *p, unsigned int v)
 {
-  hb_glyph_info_t *info = hb_buffer_get_glyph_infos (buffer, nullptr);
-  hb_glyph_position_t *pos = (flags & HB_BUFFER_SERIALIZE_FLAG_NO_POSITIONS) ?
-			     nullptr : hb_buffer_get_glyph_positions (buffer, nullptr);
+  char tmp[10];
+  unsigned int n = 0;
+  do
+  {
+    tmp[n++] = '0' + v % 10;
+    v /= 10;
+  } while (v);
+  while (n)
+    *p++ = tmp[--n];
+  return p;
+}
 
-  *buf_consumed = 0;
-  hb_position_t x = 0, y = 0;
-  for (unsigned int i = start; i < end; i++)
+static inline char *
+_hb_serialize_int (char *p, int v)
+{
+  unsigned int u = v;
+  if (v < 0)
   {
-    char b[1024];
-    char *p = b;
+    *p++ = '-';
+    u = 0u - u;
+  }
+  return _hb_serialize_uint (p, u);
+}
 
-    /* In the following code, we know b is large enough that no overflow can happen. */
+static inline char *
+_hb_serialize_hex (char *p, unsigned int v)
+{
+  char tmp[8];
+  unsigned int n = 0;
+  do
+  {
+    tmp[n++] = "0123456789ABCDEF"[v & 0xF];
+    v >>= 4;
+  } while (v);
+  while (n)
+    *p++ = tmp[--n];
+  return p;
+}
 
-#define APPEND(s) HB_STMT_START { strcpy (p, s); p += strlen (s); } HB_STMT_END
+#define APPEND(s) HB_STMT_START { memcpy (p, s, sizeof (s) - 1); p += sizeof (s) - 1; } HB_STMT_END
 
-    if (i)
-      *p++ = ',';
+/* Direct-mapped cache of glyph names, for one serialize call. */
+struct hb_serialize_name_cache_t
+{
+  enum { SIZE = 64, MAX_LEN = 63 };
 
-    *p++ = '{';
+  void init (void)
+  {
+    for (unsigned int i = 0; i < SIZE; i++)
+      glyphs[i] = HB_SET_VALUE_INVALID;
+  }
 
-    APPEND ("\"g\":");
-    if (!(flags & HB_BUFFER_SERIALIZE_FLAG_NO_GLYPH_NAMES))
+  /* Returns the name of glyph, NUL-terminated, and its length. */
+  const char *get (hb_font_t *font, hb_codepoint_t glyph, unsigned int *len)
+  {
+    unsigned int i = glyph % SIZE;
+    if (likely (glyphs[i] == glyph && glyph != HB_SET_VALUE_INVALID))
     {
-      char g[128];
-      hb_font_glyph_to_string (font, info[i].codepoint, g, sizeof (g));
-      *p++ = '"';
-      for (char *q = g; *q; q++) {
-        if (*q == '"')
-	  *p++ = '\\';
-	*p++ = *q;
-      }
-      *p++ = '"';
+      *len = lens[i];
+      return names[i];
     }
-    else
-      p += MAX (0, snprintf (p, ARRAY_LENGTH (b) - (p - b), "%u", info[i].codepoint));
 
-    if (!(flags & HB_BUFFER_SERIALIZE_FLAG_NO_CLUSTERS)) {
-      p += MAX (0, snprintf (p, ARRAY_LENGTH (b) - (p - b), ",\"cl\":%u", info[i].cluster));
+    hb_font_glyph_to_string (font, glyph, scratch, sizeof (scratch));
+    unsigned int l = strlen (scratch);
+    *len = l;
+    if (l > MAX_LEN)
+      return scratch;
+    glyphs[i] = glyph;
+    lens[i] = l;
+    memcpy (names[i], scratch, l + 1);
+    return names[i];
+  }
+
+  private:
+  hb_codepoint_t glyphs[SIZE];
+  unsigned char lens[SIZE];
+  char names[SIZE][MAX_LEN + 1];
+  char scratch[128];
+};
+
+/* Longest output of either formatter below for one glyph, with room to spare. */
+#define HB_SERIALIZE_GLYPH_MAX_LEN 1024
+
+static char *
+_hb_buffer_serialize_glyph_json (char *p,
+				 unsigned int i,
+				 const hb_glyph_info_t &info,
+				 const hb_glyph_position_t *pos,
+				 hb_position_t x,
+				 hb_position_t y,
+				 hb_font_t *font,
+				 hb_buffer_serialize_flags_t flags,
+				 hb_serialize_name_cache_t *names)
+{
+  if (i)
+    *p++ = ',';
+
+  *p++ = '{';
+
+  APPEND ("\"g\":");
+  if (!(flags & HB_BUFFER_SERIALIZE_FLAG_NO_GLYPH_NAMES))
+  {
+    unsigned int len;
+    const char *g = names->get (font, info.codepoint, &len);
+    *p++ = '"';
+    for (const char *q = g; *q; q++) {
+      if (*q == '"')
+	*p++ = '\\';
+      *p++ = *q;
     }
+    *p++ = '"';
+  }
+  else
+    p = _hb_serialize_uint (p, info.codepoint);
 
-    if (!(flags & HB_BUFFER_SERIALIZE_FLAG_NO_POSITIONS))
+  if (!(flags & HB_BUFFER_SERIALIZE_FLAG_NO_CLUSTERS)) {
+    APPEND (",\"cl\":");
+    p = _hb_serialize_uint (p, info.cluster);
+  }
+
+  if (!(flags & HB_BUFFER_SERIALIZE_FLAG_NO_POSITIONS))
+  {
+    APPEND (",\"dx\":");
+    p = _hb_serialize_int (p, x+pos->x_offset);
+    APPEND (",\"dy\":");
+    p = _hb_serialize_int (p, y+pos->y_offset);
+    if (!(flags & HB_BUFFER_SERIALIZE_FLAG_NO_ADVANCES))
     {
-      p += MAX (0, snprintf (p, ARRAY_LENGTH (b) - (p - b), ",\"dx\":%d,\"dy\":%d",
-			     x+pos[i].x_offset, y+pos[i].y_offset));
-      if (!(flags & HB_BUFFER_SERIALIZE_FLAG_NO_ADVANCES))
-	p += MAX (0, snprintf (p, ARRAY_LENGTH (b) - (p - b), ",\"ax\":%d,\"ay\":%d",
-			       pos[i].x_advance, pos[i].y_advance));
+      APPEND (",\"ax\":");
+      p = _hb_serialize_int (p, pos->x_advance);
+      APPEND (",\"ay\":");
+      p = _hb_serialize_int (p, pos->y_advance);
     }
+  }
 
-    if (flags & HB_BUFFER_SERIALIZE_FLAG_GLYPH_FLAGS)
+  if (flags & HB_BUFFER_SERIALIZE_FLAG_GLYPH_FLAGS)
+  {
+    if (info.mask & HB_GLYPH_FLAG_DEFINED)
     {
-      if (info[i].mask & HB_GLYPH_FLAG_DEFINED)
-	p += MAX (0, snprintf (p, ARRAY_LENGTH (b) - (p - b), ",\"fl\":%u", info[i].mask & HB_GLYPH_FLAG_DEFINED));
+      APPEND (",\"fl\":");
+      p = _hb_serialize_uint (p, info.mask & HB_GLYPH_FLAG_DEFINED);
     }
+  }
+
+  if (flags & HB_BUFFER_SERIALIZE_FLAG_GLYPH_EXTENTS)
+  {
+    hb_glyph_extents_t extents;
+    hb_font_get_glyph_extents(font, info.codepoint, &extents);
+    APPEND (",\"xb\":");
+    p = _hb_serialize_int (p, extents.x_bearing);
+    APPEND (",\"yb\":");
+    p = _hb_serialize_int (p, extents.y_bearing);
+    APPEND (",\"w\":");
+    p = _hb_serialize_int (p, extents.width);
+    APPEND (",\"h\":");
+    p = _hb_serialize_int (p, extents.height);
+  }
+
+  *p++ = '}';
+
+  return p;
+}
+
+static char *
+_hb_buffer_serialize_glyph_text (char *p,
+				 unsigned int i,
+				 const hb_glyph_info_t &info,
+				 const hb_glyph_position_t *pos,
+				 hb_position_t x,
+				 hb_position_t y,
+				 hb_font_t *font,
+				 hb_buffer_serialize_flags_t flags,
+				 hb_serialize_name_cache_t *names)
+{
+  if (i)
+    *p++ = '|';
+
+  if (!(flags & HB_BUFFER_SERIALIZE_FLAG_NO_GLYPH_NAMES))
+  {
+    unsigned int len;
+    const char *g = names->get (font, info.codepoint, &len);
+    memcpy (p, g, len);
+    p += len;
+  }
+  else
+    p = _hb_serialize_uint (p, info.codepoint);
+
+  if (!(flags & HB_BUFFER_SERIALIZE_FLAG_NO_CLUSTERS)) {
+    *p++ = '=';
+    p = _hb_serialize_uint (p, info.cluster);
+  }
 
-    if (flags & HB_BUFFER_SERIALIZE_FLAG_GLYPH_EXTENTS)
+  if (!(flags & HB_BUFFER_SERIALIZE_FLAG_NO_POSITIONS))
+  {
+    if (x+pos->x_offset || y+pos->y_offset)
     {
-      hb_glyph_extents_t extents;
-      hb_font_get_glyph_extents(font, info[i].codepoint, &extents);
-      p += MAX (0, snprintf (p, ARRAY_LENGTH (b) - (p - b), ",\"xb\":%d,\"yb\":%d",
-		extents.x_bearing, extents.y_bearing));
-      p += MAX (0, snprintf (p, ARRAY_LENGTH (b) - (p - b), ",\"w\":%d,\"h\":%d",
-		extents.width, extents.height));
+      *p++ = '@';
+      p = _hb_serialize_int (p, x+pos->x_offset);
+      *p++ = ',';
+      p = _hb_serialize_int (p, y+pos->y_offset);
     }
 
-    *p++ = '}';
-
-    unsigned int l = p - b;
-    if (buf_size > l)
+    if (!(flags & HB_BUFFER_SERIALIZE_FLAG_NO_ADVANCES))
     {
-      memcpy (buf, b, l);
-      buf += l;
-      buf_size -= l;
-      *buf_consumed += l;
-      *buf = '\0';
-    } else
-      return i - start;
+      *p++ = '+';
+      p = _hb_serialize_int (p, pos->x_advance);
+      if (pos->y_advance)
+      {
+	*p++ = ',';
+	p = _hb_serialize_int (p, pos->y_advance);
+      }
+    }
+  }
 
-    if (pos && (flags & HB_BUFFER_SERIALIZE_FLAG_NO_ADVANCES))
+  if (flags & HB_BUFFER_SERIALIZE_FLAG_GLYPH_FLAGS)
+  {
+    if (info.mask & HB_GLYPH_FLAG_DEFINED)
     {
-      x += pos[i].x_advance;
-      y += pos[i].y_advance;
+      *p++ = '#';
+      p = _hb_serialize_hex (p, info.mask & HB_GLYPH_FLAG_DEFINED);
     }
   }
 
-  return end - start;
+  if (flags & HB_BUFFER_SERIALIZE_FLAG_GLYPH_EXTENTS)
+  {
+    hb_glyph_extents_t extents;
+    hb_font_get_glyph_extents(font, info.codepoint, &extents);
+    *p++ = '<';
+    p = _hb_serialize_int (p, extents.x_bearing);
+    *p++ = ',';
+    p = _hb_serialize_int (p, extents.y_bearing);
+    *p++ = ',';
+    p = _hb_serialize_int (p, extents.width);
+    *p++ = ',';
+    p = _hb_serialize_int (p, extents.height);
+    *p++ = '>';
+  }
+
+  return p;
+}
+
+#undef APPEND
+
+static bool
+_hb_serialize_grow (char **buf, unsigned int *buf_size, unsigned int needed)
+{
+  if (likely (needed <= *buf_size))
+    return true;
+
+  unsigned int new_size = *buf_size;
+  while (new_size < needed)
+  {
+    if (unlikely (new_size >= (unsigned int) -1 / 2))
+      return false;
+    new_size = MAX (2 * new_size, 256u);
+  }
+  char *new_buf = (char *) realloc (*buf, new_size);
+  if (unlikely (!new_buf))
+    return false;
+  *buf = new_buf;
+  *buf_size = new_size;
+  return true;
+}
+
+/*
+ * Binary format.
+ *
+ * Each serialize call writes one record: an 8-byte header, then the glyphs.
+ * The header is "HB", the format version, a byte of HB_BINARY_FIELD_* bits
+ * saying which fields follow for each glyph, and the glyph count as a
+ * little-endian uint32.  Signed numbers are zigzag-encoded varints.  Per
+ * glyph:
+ *
+ * - glyph index, as a delta from the previous glyph's in the record;
+ * - with CLUSTERS, cluster, as a delta from the previous glyph's;
+ * - with OFFSETS, ADVANCES or FLAGS, a byte of HB_BINARY_GLYPH_* bits, then
+ *   - with OFFSETS and HAS_OFFSETS, x_offset and y_offset;
+ *   - with ADVANCES, x_advance, then with HAS_Y_ADVANCE, y_advance.
+ *
+ * The glyph flags go in the high bits of the glyph byte.
+ */
+
+#define HB_BINARY_VERSION 1
+#define HB_BINARY_HEADER_SIZE 8
+#define HB_BINARY_GLYPH_MAX_LEN (7 * 5 + 1)
+
+enum {
+  HB_BINARY_FIELD_CLUSTERS	= 0x01u,
+  HB_BINARY_FIELD_OFFSETS	= 0x02u,
+  HB_BINARY_FIELD_ADVANCES	= 0x04u,
+  HB_BINARY_FIELD_FLAGS		= 0x08u,
+  HB_BINARY_FIELD_ALL		= 0x0Fu
+};
+
+enum {
+  HB_BINARY_GLYPH_HAS_OFFSETS	= 0x01u,
+  HB_BINARY_GLYPH_HAS_Y_ADVANCE	= 0x02u,
+  HB_BINARY_GLYPH_FLAGS_SHIFT	= 4
+};
+
+static_assert ((HB_GLYPH_FLAG_DEFINED << HB_BINARY_GLYPH_FLAGS_SHIFT) <= 0xFFu, "");
+
+static inline char *
+_hb_serialize_varint (char *p, uint32_t v)
+{
+  while (v >= 0x80u)
+  {
+    *p++ = (char) (v | 0x80u);
+    v >>= 7;
+  }
+  *p++ = (char) v;
+  return p;
+}
+
+static inline char *
+_hb_serialize_zigzag (char *p, int32_t v)
+{
+  return _hb_serialize_varint (p, ((uint32_t) v << 1) ^ (uint32_t) (v >> 31));
 }
 
 static unsigned int
-_hb_buffer_serialize_glyphs_text (hb_buffer_t *buffer,
-				  unsigned int start,
-				  unsigned int end,
-				  char *buf,
-				  unsigned int buf_size,
-				  unsigned int *buf_consumed,
-				  hb_font_t *font,
-				  hb_buffer_serialize_flags_t flags)
+_hb_buffer_serialize_glyphs_binary (hb_buffer_t *buffer,
+				    unsigned int start,
+				    unsigned int end,
+				    char **buf,
+				    unsigned int *buf_size,
+				    unsigned int *buf_len,
+				    bool grow,
+				    hb_buffer_serialize_flags_t flags)
 {
   hb_glyph_info_t *info = hb_buffer_get_glyph_infos (buffer, nullptr);
   hb_glyph_position_t *pos = (flags & HB_BUFFER_SERIALIZE_FLAG_NO_POSITIONS) ?
 			     nullptr : hb_buffer_get_glyph_positions (buffer, nullptr);
 
-  *buf_consumed = 0;
+  unsigned int fields = 0;
+  if (!(flags & HB_BUFFER_SERIALIZE_FLAG_NO_CLUSTERS))
+    fields |= HB_BINARY_FIELD_CLUSTERS;
+  if (pos)
+  {
+    fields |= HB_BINARY_FIELD_OFFSETS;
+    if (!(flags & HB_BUFFER_SERIALIZE_FLAG_NO_ADVANCES))
+      fields |= HB_BINARY_FIELD_ADVANCES;
+  }
+  if (flags & HB_BUFFER_SERIALIZE_FLAG_GLYPH_FLAGS)
+    fields |= HB_BINARY_FIELD_FLAGS;
+
+  unsigned int header = *buf_len;
+  if (grow)
+  {
+    if (unlikely (!_hb_serialize_grow (buf, buf_size, header + HB_BINARY_HEADER_SIZE + 1)))
+      return 0;
+  }
+  else if (*buf_size - header <= HB_BINARY_HEADER_SIZE)
+    return 0;
+  *buf_len += HB_BINARY_HEADER_SIZE;
+
+  hb_codepoint_t prev_glyph = 0;
+  uint32_t prev_cluster = 0;
   hb_position_t x = 0, y = 0;
-  for (unsigned int i = start; i < end; i++)
+  unsigned int i;
+  for (i = start; i < end; i++)
   {
-    char b[1024];
-    char *p = b;
+    if (grow &&
+	unlikely (!_hb_serialize_grow (buf, buf_size,
+				       *buf_len + HB_BINARY_GLYPH_MAX_LEN + 1)))
+      break;
 
-    /* In the following code, we know b is large enough that no overflow can happen. */
+    char b[HB_BINARY_GLYPH_MAX_LEN];
+    char *p = b;
 
-    if (i)
-      *p++ = '|';
+    p = _hb_serialize_zigzag (p, (int32_t) (info[i].codepoint - prev_glyph));
+    prev_glyph = info[i].codepoint;
 
-    if (!(flags & HB_BUFFER_SERIALIZE_FLAG_NO_GLYPH_NAMES))
+    if (fields & HB_BINARY_FIELD_CLUSTERS)
     {
-      hb_font_glyph_to_string (font, info[i].codepoint, p, 128);
-      p += strlen (p);
-    }
-    else
-      p += MAX (0, snprintf (p, ARRAY_LENGTH (b) - (p - b), "%u", info[i].codepoint));
-
-    if (!(flags & HB_BUFFER_SERIALIZE_FLAG_NO_CLUSTERS)) {
-      p += MAX (0, snprintf (p, ARRAY_LENGTH (b) - (p - b), "=%u", info[i].cluster));
+      p = _hb_serialize_zigzag (p, (int32_t) (info[i].cluster - prev_cluster));
+      prev_cluster = info[i].cluster;
     }
 
-    if (!(flags & HB_BUFFER_SERIALIZE_FLAG_NO_POSITIONS))
+    if (fields & (HB_BINARY_FIELD_OFFSETS | HB_BINARY_FIELD_FLAGS))
     {
-      if (x+pos[i].x_offset || y+pos[i].y_offset)
-	p += MAX (0, snprintf (p, ARRAY_LENGTH (b) - (p - b), "@%d,%d", x+pos[i].x_offset, y+pos[i].y_offset));
+      hb_position_t x_offset = 0, y_offset = 0;
+      unsigned int glyph_bits = 0;
+      if (pos)
+      {
+	x_offset = x + pos[i].x_offset;
+	y_offset = y + pos[i].y_offset;
+	if (x_offset || y_offset)
+	  glyph_bits |= HB_BINARY_GLYPH_HAS_OFFSETS;
+	if ((fields & HB_BINARY_FIELD_ADVANCES) && pos[i].y_advance)
+	  glyph_bits |= HB_BINARY_GLYPH_HAS_Y_ADVANCE;
+      }
+      if (fields & HB_BINARY_FIELD_FLAGS)
+	glyph_bits |= (info[i].mask & HB_GLYPH_FLAG_DEFINED) << HB_BINARY_GLYPH_FLAGS_SHIFT;
+      *p++ = (char) glyph_bits;
 
-      if (!(flags & HB_BUFFER_SERIALIZE_FLAG_NO_ADVANCES))
+      if (glyph_bits & HB_BINARY_GLYPH_HAS_OFFSETS)
+      {
+	p = _hb_serialize_zigzag (p, x_offset);
+	p = _hb_serialize_zigzag (p, y_offset);
+      }
+      if (fields & HB_BINARY_FIELD_ADVANCES)
       {
-	*p++ = '+';
-	p += MAX (0, snprintf (p, ARRAY_LENGTH (b) - (p - b), "%d", pos[i].x_advance));
-	if (pos[i].y_advance)
-	  p += MAX (0, snprintf (p, ARRAY_LENGTH (b) - (p - b), ",%d", pos[i].y_advance));
+	p = _hb_serialize_zigzag (p, pos[i].x_advance);
+	if (glyph_bits & HB_BINARY_GLYPH_HAS_Y_ADVANCE)
+	  p = _hb_serialize_zigzag (p, pos[i].y_advance);
       }
     }
 
-    if (flags & HB_BUFFER_SERIALIZE_FLAG_GLYPH_FLAGS)
-    {
-      if (info[i].mask & HB_GLYPH_FLAG_DEFINED)
-	p += MAX (0, snprintf (p, ARRAY_LENGTH (b) - (p - b), "#%X", info[i].mask &HB_GLYPH_FLAG_DEFINED));
-    }
+    unsigned int l = p - b;
+    if (*buf_size - *buf_len <= l)
+      break;
+    memcpy (*buf + *buf_len, b, l);
+    *buf_len += l;
 
-    if (flags & HB_BUFFER_SERIALIZE_FLAG_GLYPH_EXTENTS)
+    if (pos && (flags & HB_BUFFER_SERIALIZE_FLAG_NO_ADVANCES))
     {
-      hb_glyph_extents_t extents;
-      hb_font_get_glyph_extents(font, info[i].codepoint, &extents);
-      p += MAX (0, snprintf (p, ARRAY_LENGTH (b) - (p - b), "<%d,%d,%d,%d>", extents.x_bearing, extents.y_bearing, extents.width, extents.height));
+      x += pos[i].x_advance;
+      y += pos[i].y_advance;
     }
+  }
 
-    unsigned int l = p - b;
-    if (buf_size > l)
+  unsigned int count = i - start;
+  if (unlikely (!count))
+  {
+    /* Not even one glyph fit; don't leave an empty record behind. */
+    *buf_len = header;
+    if (*buf_size > header)
+      (*buf)[header] = '\0';
+    return 0;
+  }
+
+  uint8_t *h = (uint8_t *) *buf + header;
+  h[0] = 'H';
+  h[1] = 'B';
+  h[2] = HB_BINARY_VERSION;
+  h[3] = fields;
+  h[4] = count;
+  h[5] = count >> 8;
+  h[6] = count >> 16;
+  h[7] = count >> 24;
+  (*buf)[*buf_len] = '\0';
+
+  return count;
+}
+
+/* Serializes glyphs from start to end at *buf + *buf_len.  If grow, *buf is
+ * reallocated as needed; otherwise stops at the first glyph that does not
+ * fit.  Returns the number of glyphs serialized. */
+static unsigned int
+_hb_buffer_serialize_glyphs (hb_buffer_t *buffer,
+			     unsigned int start,
+			     unsigned int end,
+			     char **buf,
+			     unsigned int *buf_size,
+			     unsigned int *buf_len,
+			     bool grow,
+			     hb_font_t *font,
+			     hb_buffer_serialize_format_t format,
+			     hb_buffer_serialize_flags_t flags)
+{
+  char *(*serialize_glyph) (char *, unsigned int,
+			    const hb_glyph_info_t &, const hb_glyph_position_t *,
+			    hb_position_t, hb_position_t,
+			    hb_font_t *, hb_buffer_serialize_flags_t,
+			    hb_serialize_name_cache_t *);
+  switch (format)
+  {
+    case HB_BUFFER_SERIALIZE_FORMAT_TEXT:
+      serialize_glyph = _hb_buffer_serialize_glyph_text;
+      break;
+
+    case HB_BUFFER_SERIALIZE_FORMAT_JSON:
+      serialize_glyph = _hb_buffer_serialize_glyph_json;
+      break;
+
+    case HB_BUFFER_SERIALIZE_FORMAT_BINARY:
+      return _hb_buffer_serialize_glyphs_binary (buffer, start, end,
+						 buf, buf_size, buf_len, grow,
+						 flags);
+
+    default:
+    case HB_BUFFER_SERIALIZE_FORMAT_INVALID:
+      return 0;
+  }
+
+  hb_glyph_info_t *info = hb_buffer_get_glyph_infos (buffer, nullptr);
+  hb_glyph_position_t *pos = (flags & HB_BUFFER_SERIALIZE_FLAG_NO_POSITIONS) ?
+			     nullptr : hb_buffer_get_glyph_positions (buffer, nullptr);
+
+  hb_serialize_name_cache_t names;
+  if (!(flags & HB_BUFFER_SERIALIZE_FLAG_NO_GLYPH_NAMES))
+    names.init ();
+
+  hb_position_t x = 0, y = 0;
+  for (unsigned int i = start; i < end; i++)
+  {
+    if (grow &&
+	unlikely (!_hb_serialize_grow (buf, buf_size,
+				       *buf_len + HB_SERIALIZE_GLYPH_MAX_LEN + 1)))
+      return i - start;
+
+    /* With enough room, write in place; otherwise go through b, to find
+     * out whether the glyph fits. */
+    char b[HB_SERIALIZE_GLYPH_MAX_LEN];
+    char *out = *buf + *buf_len;
+    unsigned int room = *buf_size - *buf_len;
+    char *p0 = room > sizeof (b) ? out : b;
+
+    char *p = serialize_glyph (p0, i, info[i], pos ? &pos[i] : nullptr, x, y,
+			       font, flags, &names);
+
+    unsigned int l = p - p0;
+    if (room > l)
     {
-      memcpy (buf, b, l);
-      buf += l;
-      buf_size -= l;
-      *buf_consumed += l;
-      *buf = '\0';
+      if (p0 == b)
+	memcpy (out, b, l);
+      out[l] = '\0';
+      *buf_len += l;
     } else
       return i - start;
 
@@ -319,6 +679,14 @@ _hb_buffer_serialize_glyphs_text (hb_buffer_t *buffer,
  * ## json
  * TODO.
  *
+ * ## binary
+ * A compact, versioned binary format, for passing shaped buffers between
+ * processes.  Each call writes one self-contained record, holding glyph
+ * indices, and clusters, positions and glyph flags as selected by @flags;
+ * glyph names and extents are never included.  The output may contain NUL
+ * bytes, so use @buf_consumed.  Records can be concatenated and read back
+ * with one hb_buffer_deserialize_glyphs() call.
+ *
  * Return value:
  * The number of serialized items.
  *
@@ -356,23 +724,70 @@ hb_buffer_serialize_glyphs (hb_buffer_t *buffer,
   if (!font)
     font = hb_font_get_empty ();
 
-  switch (format)
-  {
-    case HB_BUFFER_SERIALIZE_FORMAT_TEXT:
-      return _hb_buffer_serialize_glyphs_text (buffer, start, end,
-					       buf, buf_size, buf_consumed,
-					       font, flags);
+  return _hb_buffer_serialize_glyphs (buffer, start, end,
+				      &buf, &buf_size, buf_consumed, false,
+				      font, format, flags);
+}
 
-    case HB_BUFFER_SERIALIZE_FORMAT_JSON:
-      return _hb_buffer_serialize_glyphs_json (buffer, start, end,
-					       buf, buf_size, buf_consumed,
-					       font, flags);
+/**
+ * hb_buffer_serialize_glyphs_grow:
+ * @buffer: an #hb_buffer_t buffer.
+ * @start: the first item in @buffer to serialize.
+ * @end: the last item in @buffer to serialize.
+ * @buf: (inout): output string, %NULL or allocated with hb_malloc(); it is
+ *       reallocated with hb_realloc() as needed.  Free it with hb_free().
+ * @buf_size: (inout): the allocated size of @buf.
+ * @buf_len: (inout): number of bytes already in @buf, which are kept;
+ *           set to the length of the output, not counting the terminating
+ *           NUL.
+ * @font: (allow-none): the #hb_font_t used to shape this buffer, needed to
+ *        read glyph names and extents. If %NULL, and empty font will be used.
+ * @format: the #hb_buffer_serialize_format_t to use for formatting the output.
+ * @flags: the #hb_buffer_serialize_flags_t that control what glyph properties
+ *         to serialize.
+ *
+ * Like hb_buffer_serialize_glyphs(), but appends all the items from @start to
+ * @end to @buf in one call, growing it as needed, instead of stopping when it
+ * is full.  Reusing the same @buf across calls avoids most allocations.
+ *
+ * Return value: false if @format is invalid or memory could not be
+ * allocated; the glyphs serialized so far are left in @buf.
+ *
+ * Since: REPLACEME
+ **/
+hb_bool_t
+hb_buffer_serialize_glyphs_grow (hb_buffer_t *buffer,
+				 unsigned int start,
+				 unsigned int end,
+				 char **buf,
+				 unsigned int *buf_size,
+				 unsigned int *buf_len,
+				 hb_font_t *font,
+				 hb_buffer_serialize_format_t format,
+				 hb_buffer_serialize_flags_t flags)
+{
+  assert (start <= end && end <= buffer->len);
 
-    default:
-    case HB_BUFFER_SERIALIZE_FORMAT_INVALID:
-      return 0;
+  if (unlikely (*buf_len > *buf_size ||
+		!hb_buffer_serialize_format_to_string (format)))
+    return false;
 
-  }
+  if (unlikely (!_hb_serialize_grow (buf, buf_size, *buf_len + 1)))
+    return false;
+  (*buf)[*buf_len] = '\0';
+
+  assert ((!buffer->len && buffer->content_type == HB_BUFFER_CONTENT_TYPE_INVALID) ||
+	  buffer->content_type == HB_BUFFER_CONTENT_TYPE_GLYPHS);
+
+  if (!buffer->have_positions)
+    flags |= HB_BUFFER_SERIALIZE_FLAG_NO_POSITIONS;
+
+  if (!font)
+    font = hb_font_get_empty ();
+
+  return _hb_buffer_serialize_glyphs (buffer, start, end,
+				      buf, buf_size, buf_len, true,
+				      font, format, flags) == end - start;
 }
 
 
@@ -421,11 +836,127 @@ parse_int (const char *pp, const char *end, int32_t *pv)
 #include "hb-buffer-deserialize-json.hh"
 #include "hb-buffer-deserialize-text.hh"
 
+static inline bool
+_hb_deserialize_varint (const uint8_t **pp, const uint8_t *pe, uint32_t *pv)
+{
+  const uint8_t *p = *pp;
+  uint32_t v = 0;
+  for (unsigned int shift = 0; shift < 35; shift += 7)
+  {
+    if (unlikely (p == pe))
+      return false;
+    uint8_t c = *p++;
+    v |= (uint32_t) (c & 0x7Fu) << shift;
+    if (!(c & 0x80u))
+    {
+      *pp = p;
+      *pv = v;
+      return true;
+    }
+  }
+  return false;
+}
+
+static inline bool
+_hb_deserialize_zigzag (const uint8_t **pp, const uint8_t *pe, int32_t *pv)
+{
+  uint32_t v;
+  if (unlikely (!_hb_deserialize_varint (pp, pe, &v)))
+    return false;
+  *pv = (int32_t) ((v >> 1) ^ (0u - (v & 1u)));
+  return true;
+}
+
+static hb_bool_t
+_hb_buffer_deserialize_glyphs_binary (hb_buffer_t *buffer,
+				      const char *buf,
+				      unsigned int buf_len,
+				      const char **end_ptr)
+{
+  const uint8_t *p = (const uint8_t *) buf, *pe = p + buf_len;
+
+  /* Ensure we have positions. */
+  (void) hb_buffer_get_glyph_positions (buffer, nullptr);
+
+  while (p < pe)
+  {
+    if (unlikely (pe - p < HB_BINARY_HEADER_SIZE ||
+		  p[0] != 'H' || p[1] != 'B' ||
+		  p[2] != HB_BINARY_VERSION ||
+		  (p[3] & ~HB_BINARY_FIELD_ALL)))
+      return false;
+    unsigned int fields = p[3];
+    unsigned int count = p[4] | (p[5] << 8) | (p[6] << 16) | ((unsigned int) p[7] << 24);
+    p += HB_BINARY_HEADER_SIZE;
+
+    /* Every glyph takes at least a byte. */
+    if (unlikely (count > (unsigned int) (pe - p)))
+      return false;
+
+    hb_codepoint_t glyph = 0;
+    uint32_t cluster = 0;
+    for (unsigned int i = 0; i < count; i++)
+    {
+      hb_glyph_info_t info;
+      hb_glyph_position_t pos;
+      memset (&info, 0, sizeof (info));
+      memset (&pos , 0, sizeof (pos ));
+      int32_t v;
+
+      if (unlikely (!_hb_deserialize_zigzag (&p, pe, &v)))
+	return false;
+      glyph += (uint32_t) v;
+      info.codepoint = glyph;
+
+      if (fields & HB_BINARY_FIELD_CLUSTERS)
+      {
+	if (unlikely (!_hb_deserialize_zigzag (&p, pe, &v)))
+	  return false;
+	cluster += (uint32_t) v;
+	info.cluster = cluster;
+      }
+
+      if (fields & (HB_BINARY_FIELD_OFFSETS | HB_BINARY_FIELD_FLAGS))
+      {
+	if (unlikely (p == pe))
+	  return false;
+	unsigned int glyph_bits = *p++;
+	info.mask = (glyph_bits >> HB_BINARY_GLYPH_FLAGS_SHIFT) & HB_GLYPH_FLAG_DEFINED;
+
+	if (glyph_bits & HB_BINARY_GLYPH_HAS_OFFSETS)
+	{
+	  if (unlikely (!_hb_deserialize_zigzag (&p, pe, &pos.x_offset) ||
+			!_hb_deserialize_zigzag (&p, pe, &pos.y_offset)))
+	    return false;
+	}
+	if (fields & HB_BINARY_FIELD_ADVANCES)
+	{
+	  if (unlikely (!_hb_deserialize_zigzag (&p, pe, &pos.x_advance)))
+	    return false;
+	  if ((glyph_bits & HB_BINARY_GLYPH_HAS_Y_ADVANCE) &&
+	      unlikely (!_hb_deserialize_zigzag (&p, pe, &pos.y_advance)))
+	    return false;
+	}
+      }
+
+      buffer->add_info (info);
+      if (unlikely (!buffer->successful))
+	return false;
+      buffer->pos[buffer->len - 1] = pos;
+    }
+
+    *end_ptr = (const char *) p;
+  }
+
+  return true;
+}
+
 /**
  * hb_buffer_deserialize_glyphs:
  * @buffer: an #hb_buffer_t buffer.
  * @buf: (array length=buf_len):
- * @buf_len:
+ * @buf_len: length of @buf, or -1 if it is NUL-terminated; binary input
+ *           must give its length.
  * @end_ptr: (out):
  * @font:
  * @format:
@@ -453,7 +984,12 @@ hb_buffer_deserialize_glyphs (hb_buffer_t *buffer,
 	  buffer->content_type == HB_BUFFER_CONTENT_TYPE_GLYPHS);
 
   if (buf_len == -1)
+  {
+    /* Binary records may contain NUL bytes. */
+    if (unlikely (format == HB_BUFFER_SERIALIZE_FORMAT_BINARY))
+      return false;
     buf_len = strlen (buf);
+  }
 
   if (!buf_len)
   {
@@ -478,6 +1014,10 @@ hb_buffer_deserialize_glyphs (hb_buffer_t *buffer,
 						 buf, buf_len, end_ptr,
 						 font);
 
+    case HB_BUFFER_SERIALIZE_FORMAT_BINARY:
+      return _hb_buffer_deserialize_glyphs_binary (buffer,
+						   buf, buf_len, end_ptr);
+
     default:
     case HB_BUFFER_SERIALIZE_FORMAT_INVALID:
       return false;
@@ -30,6 +30,12 @@
 #include "hb-buffer.hh"
 #include "hb-utf.hh"
 
+#ifdef _WIN32
+# include <windows.h>
+#elif defined(HAVE_CLOCK_GETTIME)
+# include <time.h>
+#endif
+
 
 /**
  * SECTION: hb-buffer
@@ -155,6 +161,38 @@ done:
   return likely (successful);
 }
 
+void
+hb_buffer_t::shrink_to_fit ()
+{
+  if (unlikely (hb_object_is_immutable (this) || have_output))
+    return;
+
+  /* ensure() wants room for one more than is asked for. */
+  unsigned int new_allocated = len ? len + 1 : 0;
+  if (new_allocated >= allocated)
+    return;
+
+  if (!new_allocated)
+  {
+    free (info);
+    free (pos);
+    info = out_info = nullptr;
+    pos = nullptr;
+    allocated = 0;
+    return;
+  }
+
+  /* If realloc() fails to shrink, the old, larger, array stays. */
+  hb_glyph_position_t *new_pos = (hb_glyph_position_t *) realloc (pos, new_allocated * sizeof (pos[0]));
+  if (likely (new_pos))
+    pos = new_pos;
+  hb_glyph_info_t *new_info = (hb_glyph_info_t *) realloc (info, new_allocated * sizeof (info[0]));
+  if (likely (new_info))
+    info = new_info;
+  out_info = info;
+  allocated = new_allocated;
+}
+
 bool
 hb_buffer_t::make_room_for (unsigned int num_in,
 			    unsigned int num_out)
@@ -225,6 +263,7 @@ hb_buffer_t::reset ()
   flags = HB_BUFFER_FLAG_DEFAULT;
   replacement = HB_BUFFER_REPLACEMENT_CODEPOINT_DEFAULT;
   invisible = 0;
+  max_ops_budget = 0;
 
   clear ();
 }
@@ -250,6 +289,8 @@ hb_buffer_t::clear ()
   out_info = info;
 
   serial = 0;
+  ops_used = 0;
+  ops_exhausted = false;
 
   memset (context, 0, sizeof context);
   memset (context_len, 0, sizeof context_len);
@@ -526,18 +567,27 @@ hb_buffer_t::merge_clusters_impl (unsigned int start,
   for (unsigned int i = start + 1; i < end; i++)
     cluster = MIN<unsigned int> (cluster, info[i].cluster);
 
+  /* Glyphs sharing an end's cluster only change if that isn't already the
+   * merged one.  Skipping the scan otherwise keeps merges inside one long
+   * cluster, as when a client gives all text the same cluster, from
+   * walking it on every ligature. */
+
   /* Extend end */
-  while (end < len && info[end - 1].cluster == info[end].cluster)
-    end++;
+  if (info[end - 1].cluster != cluster)
+    while (end < len && info[end - 1].cluster == info[end].cluster)
+      end++;
 
   /* Extend start */
-  while (idx < start && info[start - 1].cluster == info[start].cluster)
-    start--;
+  if (info[start].cluster != cluster)
+  {
+    while (idx < start && info[start - 1].cluster == info[start].cluster)
+      start--;
 
-  /* If we hit the start of buffer, continue in out-buffer. */
-  if (idx == start)
-    for (unsigned int i = out_len; i && out_info[i - 1].cluster == info[start].cluster; i--)
-      set_cluster (out_info[i - 1], cluster);
+    /* If we hit the start of buffer, continue in out-buffer. */
+    if (idx == start)
+      for (unsigned int i = out_len; i && out_info[i - 1].cluster == info[start].cluster; i--)
+	set_cluster (out_info[i - 1], cluster);
+  }
 
   for (unsigned int i = start; i < end; i++)
     set_cluster (info[i], cluster);
@@ -557,18 +607,25 @@ hb_buffer_t::merge_out_clusters (unsigned int start,
   for (unsigned int i = start + 1; i < end; i++)
     cluster = MIN<unsigned int> (cluster, out_info[i].cluster);
 
+  /* As in merge_clusters_impl(), only extend past ends not already in
+   * the merged cluster. */
+
   /* Extend start */
-  while (start && out_info[start - 1].cluster == out_info[start].cluster)
-    start--;
+  if (out_info[start].cluster != cluster)
+    while (start && out_info[start - 1].cluster == out_info[start].cluster)
+      start--;
 
   /* Extend end */
-  while (end < out_len && out_info[end - 1].cluster == out_info[end].cluster)
-    end++;
+  if (out_info[end - 1].cluster != cluster)
+  {
+    while (end < out_len && out_info[end - 1].cluster == out_info[end].cluster)
+      end++;
 
-  /* If we hit the end of out-buffer, continue in buffer. */
-  if (end == out_len)
-    for (unsigned int i = idx; i < len && info[i].cluster == out_info[end - 1].cluster; i++)
-      set_cluster (info[i], cluster);
+    /* If we hit the end of out-buffer, continue in buffer. */
+    if (end == out_len)
+      for (unsigned int i = idx; i < len && info[i].cluster == out_info[end - 1].cluster; i++)
+	set_cluster (info[i], cluster);
+  }
 
   for (unsigned int i = start; i < end; i++)
     set_cluster (out_info[i], cluster);
@@ -683,6 +740,9 @@ DEFINE_NULL_INSTANCE (hb_buffer_t) =
   HB_BUFFER_SCRATCH_FLAG_DEFAULT,
   HB_BUFFER_MAX_LEN_DEFAULT,
   HB_BUFFER_MAX_OPS_DEFAULT,
+  0, /* max_ops_budget */
+  0, /* ops_used */
+  false, /* ops_exhausted */
 
   HB_BUFFER_CONTENT_TYPE_INVALID,
   HB_SEGMENT_PROPERTIES_DEFAULT,
@@ -778,6 +838,8 @@ hb_buffer_destroy (hb_buffer_t *buffer)
   free (buffer->pos);
   if (buffer->message_destroy)
     buffer->message_destroy (buffer->message_data);
+  if (buffer->trace_destroy)
+    buffer->trace_destroy (buffer->trace_data);
 
   free (buffer);
 }
@@ -1220,6 +1282,74 @@ hb_buffer_get_invisible_glyph (hb_buffer_t    *buffer)
   return buffer->invisible;
 }
 
+/**
+ * hb_buffer_set_max_ops:
+ * @buffer: an #hb_buffer_t.
+ * @max_ops: the operation budget of each shaping, or zero for none.
+ *
+ * Bounds the work of shaping @buffer, whatever the font.  Each
+ * recursion into a nested lookup, lookup applied to the buffer and
+ * transition of an AAT state machine costs one operation.  Once
+ * @max_ops are spent, the remaining lookups and state machines are
+ * skipped, so shaping still returns glyphs, just not fully shaped ones;
+ * hb_buffer_get_ops_used() tells whether that happened.
+ *
+ * Without a budget (the default), shaping is only bounded by a limit
+ * proportional to the length of the buffer, which only recursion and
+ * AAT loops draw on.  A budget lower than that lowers it.
+ *
+ * Since: REPLACEME
+ **/
+void
+hb_buffer_set_max_ops (hb_buffer_t  *buffer,
+		       unsigned int  max_ops)
+{
+  if (unlikely (hb_object_is_immutable (buffer)))
+    return;
+
+  buffer->max_ops_budget = max_ops;
+}
+
+/**
+ * hb_buffer_get_max_ops:
+ * @buffer: an #hb_buffer_t.
+ *
+ * See hb_buffer_set_max_ops().
+ *
+ * Return value:
+ * The @buffer operation budget, or zero if it has none.
+ *
+ * Since: REPLACEME
+ **/
+unsigned int
+hb_buffer_get_max_ops (hb_buffer_t  *buffer)
+{
+  return buffer->max_ops_budget;
+}
+
+/**
+ * hb_buffer_get_ops_used:
+ * @buffer: an #hb_buffer_t.
+ * @exhausted: (out) (allow-none): whether shaping ran out of operations
+ *             and skipped some of its work.
+ *
+ * Fetches the number of operations the last shaping of @buffer spent;
+ * see hb_buffer_set_max_ops() for what they are.  When @buffer has no
+ * budget, only recursion and AAT loops are counted.
+ *
+ * Return value:
+ * The number of operations spent.
+ *
+ * Since: REPLACEME
+ **/
+unsigned int
+hb_buffer_get_ops_used (hb_buffer_t *buffer,
+			hb_bool_t   *exhausted /* OUT */)
+{
+  if (exhausted) *exhausted = buffer->ops_exhausted;
+  return buffer->ops_used;
+}
+
 
 /**
  * hb_buffer_reset:
@@ -1269,6 +1399,21 @@ hb_buffer_pre_allocate (hb_buffer_t *buffer, unsigned int size)
   return buffer->ensure (size);
 }
 
+/**
+ * hb_buffer_shrink_to_fit:
+ * @buffer: an #hb_buffer_t.
+ *
+ * Frees the memory @buffer holds beyond what its current contents need.
+ * Call hb_buffer_clear_contents() first to free all of it.
+ *
+ * Since: REPLACEME
+ **/
+void
+hb_buffer_shrink_to_fit (hb_buffer_t *buffer)
+{
+  buffer->shrink_to_fit ();
+}
+
 /**
  * hb_buffer_allocation_successful:
  * @buffer: an #hb_buffer_t.
@@ -1423,6 +1568,169 @@ hb_buffer_get_glyph_positions (hb_buffer_t  *buffer,
   return (hb_glyph_position_t *) buffer->pos;
 }
 
+static inline void
+_hb_buffer_column_store (uint32_t *p, uint32_t v) { *p = v; }
+static inline void
+_hb_buffer_column_store (uint16_t *p, uint32_t v) { *p = MIN (v, 0xFFFFu); }
+static inline void
+_hb_buffer_column_store (int32_t *p, int32_t v) { *p = v; }
+static inline void
+_hb_buffer_column_store (int16_t *p, int32_t v) { *p = MAX (-0x8000, MIN (v, 0x7FFF)); }
+
+template <typename Type, typename Record, typename Field>
+static void
+_hb_buffer_get_column (Type *data, unsigned int stride,
+		       const Record *records, Field Record::*field, Field mask,
+		       unsigned int count)
+{
+  if (!stride)
+    stride = sizeof (Type);
+  for (unsigned int i = 0; i < count; i++)
+  {
+    _hb_buffer_column_store (data, records[i].*field & mask);
+    data = &StructAtOffset<Type> (data, stride);
+  }
+}
+
+/**
+ * hb_buffer_get_columns:
+ * @buffer: an #hb_buffer_t.
+ * @start: index of the first glyph to copy.
+ * @end: index one past the last glyph to copy; -1 for the end of @buffer.
+ * @columns: (array length=num_columns): the arrays to fill.
+ * @num_columns: number of entries in @columns.
+ *
+ * Copies fields of the glyph infos and positions of @buffer into separate,
+ * caller-allocated arrays, one per entry of @columns, optionally narrowing
+ * them to 16 bits.  Each array must have room for @end - @start values.
+ * Positions read as zero if @buffer has none.
+ *
+ * Return value: number of glyphs copied.
+ *
+ * Since: REPLACEME
+ **/
+unsigned int
+hb_buffer_get_columns (hb_buffer_t              *buffer,
+		       unsigned int              start,
+		       unsigned int              end,
+		       const hb_buffer_column_t *columns,
+		       unsigned int              num_columns)
+{
+  end = MIN (end, buffer->len);
+  if (unlikely (start >= end))
+    return 0;
+  unsigned int count = end - start;
+
+  if (!buffer->have_positions)
+    buffer->clear_positions ();
+
+  const hb_glyph_info_t *info = buffer->info + start;
+  const hb_glyph_position_t *pos = buffer->pos + start;
+  for (unsigned int i = 0; i < num_columns; i++)
+  {
+    const hb_buffer_column_t &c = columns[i];
+    bool wide = c.type == HB_BUFFER_COLUMN_TYPE_32;
+    uint32_t all = (uint32_t) -1;
+#define HB_BUFFER_INFO_COLUMN(f, mask) \
+    if (wide) _hb_buffer_get_column ((uint32_t *) c.data, c.stride, info, &hb_glyph_info_t::f, (uint32_t) (mask), count); \
+    else      _hb_buffer_get_column ((uint16_t *) c.data, c.stride, info, &hb_glyph_info_t::f, (uint32_t) (mask), count)
+#define HB_BUFFER_POS_COLUMN(f) \
+    if (wide) _hb_buffer_get_column ((int32_t *) c.data, c.stride, pos, &hb_glyph_position_t::f, (int32_t) -1, count); \
+    else      _hb_buffer_get_column ((int16_t *) c.data, c.stride, pos, &hb_glyph_position_t::f, (int32_t) -1, count)
+    switch (c.field)
+    {
+      case HB_BUFFER_COLUMN_FIELD_CODEPOINT:	HB_BUFFER_INFO_COLUMN (codepoint, all); break;
+      case HB_BUFFER_COLUMN_FIELD_CLUSTER:	HB_BUFFER_INFO_COLUMN (cluster, all); break;
+      case HB_BUFFER_COLUMN_FIELD_GLYPH_FLAGS:	HB_BUFFER_INFO_COLUMN (mask, HB_GLYPH_FLAG_DEFINED); break;
+      case HB_BUFFER_COLUMN_FIELD_X_ADVANCE:	HB_BUFFER_POS_COLUMN (x_advance); break;
+      case HB_BUFFER_COLUMN_FIELD_Y_ADVANCE:	HB_BUFFER_POS_COLUMN (y_advance); break;
+      case HB_BUFFER_COLUMN_FIELD_X_OFFSET:	HB_BUFFER_POS_COLUMN (x_offset); break;
+      case HB_BUFFER_COLUMN_FIELD_Y_OFFSET:	HB_BUFFER_POS_COLUMN (y_offset); break;
+      default: break;
+    }
+#undef HB_BUFFER_POS_COLUMN
+#undef HB_BUFFER_INFO_COLUMN
+  }
+
+  return count;
+}
+
+/**
+ * hb_buffer_get_cluster_map:
+ * @buffer: an #hb_buffer_t, after shaping.
+ * @text_length: length of the text the cluster values of @buffer index
+ *               into, in the units of those values.
+ * @text_glyph_starts: (out) (optional) (array length=text_length): for each
+ *                     text position, the index of the first glyph of its
+ *                     cluster, in @buffer order.
+ * @text_glyph_ends: (out) (optional) (array length=text_length): for each
+ *                   text position, one past the index of the last glyph of
+ *                   its cluster.
+ * @glyph_text_ends: (out) (optional): for each glyph of @buffer, the text
+ *                   position one past the end of its cluster; its
+ *                   #hb_glyph_info_t.cluster is the start.
+ *
+ * Maps text positions to the glyphs shaped from them and back, in one pass
+ * over @buffer, for hit-testing, caret placement and selection.  A cluster
+ * runs from its cluster value up to the next cluster value in logical
+ * order, which is the reverse of @buffer order for right-to-left and
+ * bottom-to-top text, or to @text_length for the last one.  Text positions
+ * before the first cluster map to an empty range at -1.
+ *
+ * The ranges are exact for the monotone cluster levels; with
+ * %HB_BUFFER_CLUSTER_LEVEL_CHARACTERS, glyphs reordered before a cluster
+ * of lower value are taken to cover their own position only.
+ *
+ * Return value: the number of glyphs in @buffer, which @glyph_text_ends
+ * must have room for.
+ *
+ * Since: REPLACEME
+ **/
+unsigned int
+hb_buffer_get_cluster_map (hb_buffer_t  *buffer,
+			   unsigned int  text_length,
+			   unsigned int *text_glyph_starts, /* OUT */
+			   unsigned int *text_glyph_ends,   /* OUT */
+			   unsigned int *glyph_text_ends    /* OUT */)
+{
+  unsigned int count = buffer->len;
+  const hb_glyph_info_t *info = buffer->info;
+  bool backward = HB_DIRECTION_IS_BACKWARD (buffer->props.direction);
+
+  for (unsigned int t = 0; t < text_length; t++)
+  {
+    if (text_glyph_starts) text_glyph_starts[t] = (unsigned int) -1;
+    if (text_glyph_ends) text_glyph_ends[t] = (unsigned int) -1;
+  }
+
+  /* Runs of glyphs of the same cluster, in logical order. */
+  unsigned int i = 0;
+  while (i < count)
+  {
+    uint32_t cluster = info[backward ? count - 1 - i : i].cluster;
+    unsigned int j = i + 1;
+    while (j < count && info[backward ? count - 1 - j : j].cluster == cluster)
+      j++;
+    uint32_t next = j < count ? info[backward ? count - 1 - j : j].cluster : text_length;
+    uint32_t end = next > cluster ? next : cluster + 1;
+
+    unsigned int start_glyph = backward ? count - j : i;
+    unsigned int end_glyph = backward ? count - i : j;
+    if (glyph_text_ends)
+      for (unsigned int g = start_glyph; g < end_glyph; g++)
+	glyph_text_ends[g] = end;
+    for (uint32_t t = cluster; t < MIN (end, text_length); t++)
+    {
+      if (text_glyph_starts) text_glyph_starts[t] = start_glyph;
+      if (text_glyph_ends) text_glyph_ends[t] = end_glyph;
+    }
+
+    i = j;
+  }
+
+  return count;
+}
+
 /**
  * hb_glyph_info_get_glyph_flags:
  * @info: a #hb_glyph_info_t.
@@ -1521,6 +1829,187 @@ hb_buffer_guess_segment_properties (hb_buffer_t *buffer)
   buffer->guess_segment_properties ();
 }
 
+/* Paired brackets seen in the current segment, for them to take the
+ * script of their opening bracket. */
+#ifndef HB_BUFFER_SEGMENT_MAX_BRACKETS
+#define HB_BUFFER_SEGMENT_MAX_BRACKETS 64
+#endif
+
+static inline bool
+_hb_buffer_script_is_real (hb_script_t script)
+{
+  return script != HB_SCRIPT_COMMON &&
+	 script != HB_SCRIPT_INHERITED &&
+	 script != HB_SCRIPT_UNKNOWN;
+}
+
+/**
+ * hb_buffer_get_segments:
+ * @buffer: an #hb_buffer_t with Unicode contents.
+ * @levels: (array) (nullable): the bidi embedding level of each character
+ *          in @buffer, or %NULL.
+ * @font_func: (scope call) (nullable): callback choosing a font for each
+ *             character, or %NULL.
+ * @user_data: data passed to @font_func.
+ * @start_offset: the index of the first segment to return.
+ * @segment_count: (inout) (optional): on input, the length of @segments; on
+ *                 output, the number of segments written.
+ * @segments: (out caller-allocates) (array length=segment_count): the
+ *            segments found.
+ *
+ * Splits the contents of @buffer into runs that have a single script,
+ * direction and font, in one pass over the buffer.
+ *
+ * Scripts come from the buffer's Unicode functions.  Characters with
+ * script %HB_SCRIPT_COMMON, %HB_SCRIPT_INHERITED or %HB_SCRIPT_UNKNOWN
+ * take the script of the run they are in, or of the first run if they
+ * lead the buffer.  Closing brackets take the script of their opening
+ * bracket.
+ *
+ * If @levels is given, segments also break where the level changes and
+ * take their direction from its parity.  Otherwise the buffer direction
+ * is used if set, or else the horizontal direction of each segment's
+ * script.
+ *
+ * If @font_func is given, segments also break where the font it returns
+ * changes.  Marks and other %HB_SCRIPT_INHERITED characters keep the font
+ * of the preceding character without consulting @font_func.
+ *
+ * Return value: the total number of segments.
+ *
+ * Since: REPLACEME
+ **/
+unsigned int
+hb_buffer_get_segments (hb_buffer_t                   *buffer,
+			const uint8_t                 *levels,
+			hb_buffer_segment_font_func_t  font_func,
+			void                          *user_data,
+			unsigned int                   start_offset,
+			unsigned int                  *segment_count /* IN/OUT */,
+			hb_buffer_segment_t           *segments /* OUT */)
+{
+  unsigned int max_segments = segment_count ? *segment_count : 0;
+  unsigned int total = 0, written = 0;
+  if (segment_count)
+    *segment_count = 0;
+
+  if (unlikely (buffer->content_type != HB_BUFFER_CONTENT_TYPE_UNICODE || !buffer->len))
+    return 0;
+
+  hb_unicode_funcs_t *unicode = buffer->unicode;
+  const hb_glyph_info_t *info = buffer->info;
+  unsigned int count = buffer->len;
+
+  struct bracket_t
+  {
+    hb_codepoint_t close;
+    hb_script_t script;
+  } brackets[HB_BUFFER_SEGMENT_MAX_BRACKETS];
+  unsigned int num_brackets = 0;
+
+  hb_buffer_segment_t seg = hb_buffer_segment_t ();
+  seg.script = HB_SCRIPT_COMMON;
+  uint8_t level = levels ? levels[0] : 0;
+
+  for (unsigned int i = 0; i < count; i++)
+  {
+    hb_codepoint_t u = info[i].codepoint;
+    hb_script_t script = unicode->script (u);
+    hb_unicode_general_category_t gen_cat = unicode->general_category (u);
+
+    if (gen_cat == HB_UNICODE_GENERAL_CATEGORY_CLOSE_PUNCTUATION)
+    {
+      for (unsigned int j = num_brackets; j; j--)
+	if (brackets[j - 1].close == u)
+	{
+	  if (_hb_buffer_script_is_real (brackets[j - 1].script))
+	    script = brackets[j - 1].script;
+	  num_brackets = j - 1;
+	  break;
+	}
+    }
+
+    bool is_real = _hb_buffer_script_is_real (script);
+    bool brk = i && is_real &&
+	       _hb_buffer_script_is_real (seg.script) && script != seg.script;
+
+    if (levels && levels[i] != level)
+      brk = true;
+
+    hb_font_t *font = seg.font;
+    if (font_func &&
+	(!i || (script != HB_SCRIPT_INHERITED &&
+		!HB_UNICODE_GENERAL_CATEGORY_IS_MARK (gen_cat))))
+    {
+      font = font_func (buffer, i, is_real || !i ? script : seg.script, user_data);
+      if (i && font != seg.font)
+	brk = true;
+    }
+
+    if (brk)
+    {
+      seg.end = i;
+      if (total >= start_offset && written < max_segments)
+	segments[written++] = seg;
+      total++;
+
+      seg.start = i;
+      if (is_real)
+	seg.script = script;
+      /* Open brackets from the previous segment cannot pair up
+       * across the break. */
+      num_brackets = 0;
+    }
+    else if (is_real && !_hb_buffer_script_is_real (seg.script))
+    {
+      /* First real script of the segment; brackets opened so far
+       * belong to it too. */
+      seg.script = script;
+      for (unsigned int j = 0; j < num_brackets; j++)
+	brackets[j].script = script;
+    }
+    seg.font = font;
+    if (levels)
+      level = levels[i];
+
+    if (gen_cat == HB_UNICODE_GENERAL_CATEGORY_OPEN_PUNCTUATION &&
+	num_brackets < ARRAY_LENGTH (brackets))
+    {
+      hb_codepoint_t close = unicode->mirroring (u);
+      if (close != u)
+      {
+	brackets[num_brackets].close = close;
+	brackets[num_brackets].script = is_real ? script : seg.script;
+	num_brackets++;
+      }
+    }
+  }
+  seg.end = count;
+  if (total >= start_offset && written < max_segments)
+    segments[written++] = seg;
+  total++;
+
+  /* Fill in directions. */
+  for (unsigned int i = 0; i < written; i++)
+  {
+    hb_buffer_segment_t *s = &segments[i];
+    if (levels)
+      s->direction = (levels[s->start] & 1) ? HB_DIRECTION_RTL : HB_DIRECTION_LTR;
+    else if (buffer->props.direction != HB_DIRECTION_INVALID)
+      s->direction = buffer->props.direction;
+    else
+    {
+      s->direction = hb_script_get_horizontal_direction (s->script);
+      if (s->direction == HB_DIRECTION_INVALID)
+	s->direction = HB_DIRECTION_LTR;
+    }
+  }
+
+  if (segment_count)
+    *segment_count = written;
+  return total;
+}
+
 template <typename utf_t>
 static inline void
 hb_buffer_add_utf (hb_buffer_t  *buffer,
@@ -1571,6 +2060,25 @@ hb_buffer_add_utf (hb_buffer_t  *buffer,
   const T *end = next + item_length;
   while (next < end)
   {
+    /* Runs of code units that stand for themselves, as in ASCII runs
+     * of UTF-8, are found a vector at a time and copied in directly. */
+    unsigned int run = utf_t::simple_length (next, end);
+    if (run && likely (buffer->ensure (buffer->len + run)))
+    {
+      hb_glyph_info_t *info = buffer->info + buffer->len;
+      unsigned int cluster = next - (const T *) text;
+      memset (info, 0, run * sizeof (info[0]));
+      for (unsigned int i = 0; i < run; i++)
+      {
+	info[i].codepoint = next[i];
+	info[i].cluster = cluster + i;
+      }
+      buffer->len += run;
+      next += run;
+      if (next == end)
+	break;
+    }
+
     hb_codepoint_t u;
     const T *old_next = next;
     next = utf_t::next (next, end, &u, replacement);
@@ -1731,6 +2239,50 @@ hb_buffer_add_codepoints (hb_buffer_t          *buffer,
 }
 
 
+/**
+ * hb_buffer_set_context:
+ * @buffer: an #hb_buffer_t.
+ * @pre_context: (array length=pre_context_length) (nullable): the code points
+ *               preceding the text of @buffer, in logical order.
+ * @pre_context_length: the number of code points in @pre_context.
+ * @post_context: (array length=post_context_length) (nullable): the code points
+ *                following the text of @buffer, in logical order.
+ * @post_context_length: the number of code points in @post_context.
+ *
+ * Sets the text surrounding the contents of @buffer, replacing any context
+ * installed by hb_buffer_add_codepoints() and friends.  This lets callers
+ * that keep a paragraph elsewhere pass just the run to the add functions,
+ * without building one array holding the run and its context.
+ *
+ * @pre_context ends right before the first character of @buffer, and
+ * @post_context starts right after the last one.  Only the few code points
+ * nearest to the run are consulted, so the spans can be arbitrarily long;
+ * they are not referenced after this call returns.
+ *
+ * Since the add functions reset the post-context, call this after adding
+ * the text.
+ *
+ * Since: REPLACEME
+ **/
+void
+hb_buffer_set_context (hb_buffer_t          *buffer,
+		       const hb_codepoint_t *pre_context,
+		       unsigned int          pre_context_length,
+		       const hb_codepoint_t *post_context,
+		       unsigned int          post_context_length)
+{
+  if (unlikely (hb_object_is_immutable (buffer)))
+    return;
+
+  buffer->clear_context (0);
+  while (pre_context_length && buffer->context_len[0] < buffer->CONTEXT_LENGTH)
+    buffer->context[0][buffer->context_len[0]++] = pre_context[--pre_context_length];
+
+  buffer->clear_context (1);
+  for (unsigned int i = 0; i < post_context_length && buffer->context_len[1] < buffer->CONTEXT_LENGTH; i++)
+    buffer->context[1][buffer->context_len[1]++] = post_context[i];
+}
+
 /**
  * hb_buffer_append:
  * @buffer: an #hb_buffer_t.
@@ -2030,3 +2582,228 @@ hb_buffer_t::message_impl (hb_font_t *font, const char *fmt, va_list ap)
   vsnprintf (buf, sizeof (buf),  fmt, ap);
   return (bool) this->message_func (this, font, buf, this->message_data);
 }
+
+/**
+ * hb_buffer_set_trace_func:
+ * @buffer: an #hb_buffer_t.
+ * @func: (closure user_data) (destroy destroy) (scope notified): the
+ *   function to call after each traced shaping step, or %NULL.
+ * @user_data: data to pass to @func.
+ * @destroy: function to call when @user_data is no longer needed.
+ *
+ * Sets a function to be called, during hb_shape(), after each of the
+ * steps listed in #hb_buffer_trace_event_t, with the time the step took.
+ * Unlike hb_buffer_set_message_func(), nothing is formatted, so this is
+ * cheap enough to leave on in production for attributing shaping time to
+ * fonts and lookups.  When no function is set, the cost is a branch per
+ * step.
+ *
+ * Since: REPLACEME
+ **/
+void
+hb_buffer_set_trace_func (hb_buffer_t *buffer,
+			  hb_buffer_trace_func_t func,
+			  void *user_data, hb_destroy_func_t destroy)
+{
+  if (unlikely (hb_object_is_immutable (buffer)))
+  {
+    if (destroy)
+      destroy (user_data);
+    return;
+  }
+
+  if (buffer->trace_destroy)
+    buffer->trace_destroy (buffer->trace_data);
+
+  if (func) {
+    buffer->trace_func = func;
+    buffer->trace_data = user_data;
+    buffer->trace_destroy = destroy;
+  } else {
+    buffer->trace_func = nullptr;
+    buffer->trace_data = nullptr;
+    buffer->trace_destroy = nullptr;
+  }
+}
+
+uint64_t
+hb_buffer_t::trace_now_ns ()
+{
+#if defined(_WIN32)
+  LARGE_INTEGER counter, frequency;
+  if (!QueryPerformanceCounter (&counter) || !QueryPerformanceFrequency (&frequency))
+    return 0;
+  return (uint64_t) (counter.QuadPart / frequency.QuadPart) * 1000000000ull +
+	 (uint64_t) (counter.QuadPart % frequency.QuadPart) * 1000000000ull / frequency.QuadPart;
+#elif defined(HAVE_CLOCK_GETTIME) && defined(CLOCK_MONOTONIC)
+  struct timespec ts;
+  if (clock_gettime (CLOCK_MONOTONIC, &ts))
+    return 0;
+  return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+#else
+  return 0;
+#endif
+}
+
+
+/*
+ * Buffer pools.
+ */
+
+struct hb_buffer_pool_t
+{
+  hb_object_header_t header;
+
+  hb_mutex_t lock;
+  hb_vector_t<hb_buffer_t *> buffers;
+  unsigned int max_buffers;
+};
+
+/**
+ * hb_buffer_pool_create: (Xconstructor)
+ * @max_buffers: most buffers to keep for reuse.
+ *
+ * Creates a pool that keeps up to @max_buffers released buffers, with
+ * their memory, to hand out again.  Buffers released beyond that are
+ * destroyed.  The pool may be used from several threads at once.
+ *
+ * Return value: (transfer full): a new pool.
+ *
+ * Since: REPLACEME
+ **/
+hb_buffer_pool_t *
+hb_buffer_pool_create (unsigned int max_buffers)
+{
+  hb_buffer_pool_t *pool;
+
+  if (!(pool = hb_object_create<hb_buffer_pool_t> ()))
+    return hb_buffer_pool_get_empty ();
+
+  pool->lock.init ();
+  pool->buffers.init ();
+  pool->max_buffers = max_buffers;
+
+  return pool;
+}
+
+/**
+ * hb_buffer_pool_get_empty:
+ *
+ * Return value: (transfer full): the empty pool, which keeps no buffers.
+ *
+ * Since: REPLACEME
+ **/
+hb_buffer_pool_t *
+hb_buffer_pool_get_empty ()
+{
+  return const_cast<hb_buffer_pool_t *> (&Null(hb_buffer_pool_t));
+}
+
+/**
+ * hb_buffer_pool_reference: (skip)
+ * @pool: a pool.
+ *
+ * Return value: (transfer full): @pool.
+ *
+ * Since: REPLACEME
+ **/
+hb_buffer_pool_t *
+hb_buffer_pool_reference (hb_buffer_pool_t *pool)
+{
+  return hb_object_reference (pool);
+}
+
+/**
+ * hb_buffer_pool_destroy: (skip)
+ * @pool: a pool.
+ *
+ * Drops a reference to @pool, destroying the buffers it keeps once the
+ * last reference is gone.
+ *
+ * Since: REPLACEME
+ **/
+void
+hb_buffer_pool_destroy (hb_buffer_pool_t *pool)
+{
+  if (!hb_object_destroy (pool)) return;
+
+  for (unsigned int i = 0; i < pool->buffers.length; i++)
+    hb_buffer_destroy (pool->buffers[i]);
+  pool->buffers.fini ();
+  pool->lock.fini ();
+
+  free (pool);
+}
+
+/**
+ * hb_buffer_pool_acquire:
+ * @pool: a pool.
+ *
+ * Takes a buffer from @pool, most recently released first, or creates one
+ * if @pool is empty.  The buffer is as if just created with
+ * hb_buffer_create(), except for the memory it may already hold and its
+ * user data.
+ *
+ * Return value: (transfer full): a buffer; give it back with
+ * hb_buffer_pool_release().
+ *
+ * Since: REPLACEME
+ **/
+hb_buffer_t *
+hb_buffer_pool_acquire (hb_buffer_pool_t *pool)
+{
+  if (likely (!hb_object_is_inert (pool)))
+  {
+    hb_lock_t l (pool->lock);
+    if (pool->buffers.length)
+    {
+      hb_buffer_t *buffer = pool->buffers[pool->buffers.length - 1];
+      pool->buffers.pop ();
+      return buffer;
+    }
+  }
+
+  return hb_buffer_create ();
+}
+
+/**
+ * hb_buffer_pool_release:
+ * @pool: a pool.
+ * @buffer: (transfer full): a buffer the caller is done with.
+ *
+ * Gives @buffer back to @pool for later reuse, taking over the caller's
+ * reference.  @buffer is reset, keeping its memory; it is destroyed
+ * instead if @pool is full.
+ *
+ * Since: REPLACEME
+ **/
+void
+hb_buffer_pool_release (hb_buffer_pool_t *pool,
+			hb_buffer_t      *buffer)
+{
+  if (unlikely (hb_object_is_immutable (buffer)))
+  {
+    hb_buffer_destroy (buffer);
+    return;
+  }
+
+  buffer->reset ();
+  hb_buffer_set_message_func (buffer, nullptr, nullptr, nullptr);
+  hb_buffer_set_trace_func (buffer, nullptr, nullptr, nullptr);
+
+  if (likely (!hb_object_is_inert (pool)))
+  {
+    hb_lock_t l (pool->lock);
+    if (pool->buffers.length < pool->max_buffers)
+    {
+      hb_buffer_t **slot = pool->buffers.push ();
+      if (likely (!pool->buffers.in_error ()))
+      {
+	*slot = buffer;
+	return;
+      }
+    }
+  }
+
+  hb_buffer_destroy (buffer);
+}
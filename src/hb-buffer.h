@@ -259,6 +259,59 @@ hb_buffer_get_segment_properties (hb_buffer_t *buffer,
 HB_EXTERN void
 hb_buffer_guess_segment_properties (hb_buffer_t *buffer);
 
+/**
+ * hb_buffer_segment_t:
+ * @start: the index of the first character of the segment in the buffer.
+ * @end: the index one past the last character of the segment.
+ * @script: the resolved #hb_script_t of the segment.
+ * @direction: the #hb_direction_t of the segment.
+ * @font: the font chosen for the segment, or %NULL if no font function
+ *        was given.
+ *
+ * A run of text that can be shaped in one go, as found by
+ * hb_buffer_get_segments().
+ *
+ * Since: REPLACEME
+ */
+typedef struct hb_buffer_segment_t {
+  unsigned int    start;
+  unsigned int    end;
+  hb_script_t     script;
+  hb_direction_t  direction;
+  hb_font_t      *font;
+  /*< private >*/
+  void           *reserved1;
+  void           *reserved2;
+} hb_buffer_segment_t;
+
+/**
+ * hb_buffer_segment_font_func_t:
+ * @buffer: the #hb_buffer_t being segmented.
+ * @index: the index of the character in @buffer.
+ * @script: the resolved script of the character.
+ * @user_data: user data passed to hb_buffer_get_segments().
+ *
+ * A callback choosing the font for a character, for font fallback.  The
+ * returned font is not referenced; it must outlive the segments.
+ *
+ * Return value: (transfer none): the font to use for the character at @index.
+ *
+ * Since: REPLACEME
+ */
+typedef hb_font_t * (*hb_buffer_segment_font_func_t) (hb_buffer_t  *buffer,
+						      unsigned int  index,
+						      hb_script_t   script,
+						      void         *user_data);
+
+HB_EXTERN unsigned int
+hb_buffer_get_segments (hb_buffer_t                   *buffer,
+			const uint8_t                 *levels,
+			hb_buffer_segment_font_func_t  font_func,
+			void                          *user_data,
+			unsigned int                   start_offset,
+			unsigned int                  *segment_count /* IN/OUT */,
+			hb_buffer_segment_t           *segments /* OUT */);
+
 
 /**
  * hb_buffer_flags_t:
@@ -351,6 +404,17 @@ hb_buffer_set_invisible_glyph (hb_buffer_t    *buffer,
 HB_EXTERN hb_codepoint_t
 hb_buffer_get_invisible_glyph (hb_buffer_t    *buffer);
 
+HB_EXTERN void
+hb_buffer_set_max_ops (hb_buffer_t  *buffer,
+		       unsigned int  max_ops);
+
+HB_EXTERN unsigned int
+hb_buffer_get_max_ops (hb_buffer_t  *buffer);
+
+HB_EXTERN unsigned int
+hb_buffer_get_ops_used (hb_buffer_t *buffer,
+			hb_bool_t   *exhausted /* OUT */);
+
 
 HB_EXTERN void
 hb_buffer_reset (hb_buffer_t *buffer);
@@ -362,6 +426,9 @@ HB_EXTERN hb_bool_t
 hb_buffer_pre_allocate (hb_buffer_t  *buffer,
 		        unsigned int  size);
 
+HB_EXTERN void
+hb_buffer_shrink_to_fit (hb_buffer_t *buffer);
+
 
 HB_EXTERN hb_bool_t
 hb_buffer_allocation_successful (hb_buffer_t  *buffer);
@@ -419,6 +486,13 @@ hb_buffer_add_codepoints (hb_buffer_t          *buffer,
 			  unsigned int          item_offset,
 			  int                   item_length);
 
+HB_EXTERN void
+hb_buffer_set_context (hb_buffer_t          *buffer,
+		       const hb_codepoint_t *pre_context,
+		       unsigned int          pre_context_length,
+		       const hb_codepoint_t *post_context,
+		       unsigned int          post_context_length);
+
 HB_EXTERN void
 hb_buffer_append (hb_buffer_t *buffer,
 		  hb_buffer_t *source,
@@ -442,6 +516,81 @@ HB_EXTERN hb_glyph_position_t *
 hb_buffer_get_glyph_positions (hb_buffer_t  *buffer,
                                unsigned int *length);
 
+/**
+ * hb_buffer_column_field_t:
+ * @HB_BUFFER_COLUMN_FIELD_CODEPOINT: #hb_glyph_info_t.codepoint, the glyph
+ *                                    index after shaping.
+ * @HB_BUFFER_COLUMN_FIELD_CLUSTER: #hb_glyph_info_t.cluster.
+ * @HB_BUFFER_COLUMN_FIELD_GLYPH_FLAGS: hb_glyph_info_get_glyph_flags().
+ * @HB_BUFFER_COLUMN_FIELD_X_ADVANCE: #hb_glyph_position_t.x_advance.
+ * @HB_BUFFER_COLUMN_FIELD_Y_ADVANCE: #hb_glyph_position_t.y_advance.
+ * @HB_BUFFER_COLUMN_FIELD_X_OFFSET: #hb_glyph_position_t.x_offset.
+ * @HB_BUFFER_COLUMN_FIELD_Y_OFFSET: #hb_glyph_position_t.y_offset.
+ *
+ * The glyph info or position field that an #hb_buffer_column_t receives.
+ *
+ * Since: REPLACEME
+ */
+typedef enum {
+  HB_BUFFER_COLUMN_FIELD_CODEPOINT,
+  HB_BUFFER_COLUMN_FIELD_CLUSTER,
+  HB_BUFFER_COLUMN_FIELD_GLYPH_FLAGS,
+  HB_BUFFER_COLUMN_FIELD_X_ADVANCE,
+  HB_BUFFER_COLUMN_FIELD_Y_ADVANCE,
+  HB_BUFFER_COLUMN_FIELD_X_OFFSET,
+  HB_BUFFER_COLUMN_FIELD_Y_OFFSET
+} hb_buffer_column_field_t;
+
+/**
+ * hb_buffer_column_type_t:
+ * @HB_BUFFER_COLUMN_TYPE_32: 32-bit values: uint32_t for the info fields,
+ *                            int32_t for the position ones.
+ * @HB_BUFFER_COLUMN_TYPE_16: 16-bit values: uint16_t for the info fields,
+ *                            int16_t for the position ones.  Values that
+ *                            do not fit are clamped.
+ *
+ * The type of the values an #hb_buffer_column_t receives.
+ *
+ * Since: REPLACEME
+ */
+typedef enum {
+  HB_BUFFER_COLUMN_TYPE_32,
+  HB_BUFFER_COLUMN_TYPE_16
+} hb_buffer_column_type_t;
+
+/**
+ * hb_buffer_column_t:
+ * @field: the field to copy.
+ * @type: the type of the values to write.
+ * @data: where to write the first value; must be aligned for @type.
+ * @stride: bytes from one value to the next, or zero for consecutive
+ *          values; must be a multiple of the size of @type.
+ *
+ * Describes a caller-provided array for hb_buffer_get_columns() to fill.
+ *
+ * Since: REPLACEME
+ */
+typedef struct hb_buffer_column_t {
+  hb_buffer_column_field_t  field;
+  hb_buffer_column_type_t   type;
+  void                     *data;
+  unsigned int              stride;
+} hb_buffer_column_t;
+
+HB_EXTERN unsigned int
+hb_buffer_get_columns (hb_buffer_t              *buffer,
+		       unsigned int              start,
+		       unsigned int              end,
+		       const hb_buffer_column_t *columns,
+		       unsigned int              num_columns);
+
+HB_EXTERN unsigned int
+hb_buffer_get_cluster_map (hb_buffer_t  *buffer,
+			   unsigned int  text_length,
+			   unsigned int *text_glyph_starts, /* OUT */
+			   unsigned int *text_glyph_ends,   /* OUT */
+			   unsigned int *glyph_text_ends    /* OUT */);
+
 
 HB_EXTERN void
 hb_buffer_normalize_glyphs (hb_buffer_t *buffer);
@@ -480,6 +629,7 @@ typedef enum { /*< flags >*/
  * hb_buffer_serialize_format_t:
  * @HB_BUFFER_SERIALIZE_FORMAT_TEXT: a human-readable, plain text format.
  * @HB_BUFFER_SERIALIZE_FORMAT_JSON: a machine-readable JSON format.
+ * @HB_BUFFER_SERIALIZE_FORMAT_BINARY: a compact binary format. Since: REPLACEME
  * @HB_BUFFER_SERIALIZE_FORMAT_INVALID: invalid format.
  *
  * The buffer serialization and de-serialization format used in
@@ -490,6 +640,7 @@ typedef enum { /*< flags >*/
 typedef enum {
   HB_BUFFER_SERIALIZE_FORMAT_TEXT	= HB_TAG('T','E','X','T'),
   HB_BUFFER_SERIALIZE_FORMAT_JSON	= HB_TAG('J','S','O','N'),
+  HB_BUFFER_SERIALIZE_FORMAT_BINARY	= HB_TAG('B','I','N','A'),
   HB_BUFFER_SERIALIZE_FORMAT_INVALID	= HB_TAG_NONE
 } hb_buffer_serialize_format_t;
 
@@ -513,6 +664,17 @@ hb_buffer_serialize_glyphs (hb_buffer_t *buffer,
 			    hb_buffer_serialize_format_t format,
 			    hb_buffer_serialize_flags_t flags);
 
+HB_EXTERN hb_bool_t
+hb_buffer_serialize_glyphs_grow (hb_buffer_t *buffer,
+				 unsigned int start,
+				 unsigned int end,
+				 char **buf,
+				 unsigned int *buf_size,
+				 unsigned int *buf_len,
+				 hb_font_t *font,
+				 hb_buffer_serialize_format_t format,
+				 hb_buffer_serialize_flags_t flags);
+
 HB_EXTERN hb_bool_t
 hb_buffer_deserialize_glyphs (hb_buffer_t *buffer,
 			      const char *buf,
@@ -575,6 +737,100 @@ hb_buffer_set_message_func (hb_buffer_t *buffer,
 			    hb_buffer_message_func_t func,
 			    void *user_data, hb_destroy_func_t destroy);
 
+/**
+ * hb_buffer_trace_event_t:
+ * @HB_BUFFER_TRACE_EVENT_NORMALIZE: Unicode normalization.  Index is zero.
+ * @HB_BUFFER_TRACE_EVENT_GSUB_LOOKUP: One GSUB lookup.  Index is the lookup index.
+ * @HB_BUFFER_TRACE_EVENT_GSUB_STAGE: All GSUB lookups of a stage of the shape
+ *   plan, not counting its pause function.  Index is the stage index.
+ * @HB_BUFFER_TRACE_EVENT_GSUB_PAUSE: The pause function ending a GSUB stage.
+ *   Index is the stage index.
+ * @HB_BUFFER_TRACE_EVENT_GPOS_LOOKUP: One GPOS lookup.  Index is the lookup index.
+ * @HB_BUFFER_TRACE_EVENT_GPOS_STAGE: All GPOS lookups of a stage of the shape
+ *   plan, not counting its pause function.  Index is the stage index.
+ * @HB_BUFFER_TRACE_EVENT_GPOS_PAUSE: The pause function ending a GPOS stage.
+ *   Index is the stage index.
+ * @HB_BUFFER_TRACE_EVENT_FALLBACK_POSITION: Fallback mark positioning or
+ *   fallback kerning.  Index is zero.
+ * @HB_BUFFER_TRACE_EVENT_MORX: The whole AAT morx table.  Index is zero.
+ * @HB_BUFFER_TRACE_EVENT_MORX_SUBTABLE: One AAT morx subtable.  Index counts
+ *   subtables across all chains of the table.
+ *
+ * Shaping steps reported to a #hb_buffer_trace_func_t.
+ *
+ * Since: REPLACEME
+ */
+typedef enum {
+  HB_BUFFER_TRACE_EVENT_NORMALIZE,
+  HB_BUFFER_TRACE_EVENT_GSUB_LOOKUP,
+  HB_BUFFER_TRACE_EVENT_GSUB_STAGE,
+  HB_BUFFER_TRACE_EVENT_GSUB_PAUSE,
+  HB_BUFFER_TRACE_EVENT_GPOS_LOOKUP,
+  HB_BUFFER_TRACE_EVENT_GPOS_STAGE,
+  HB_BUFFER_TRACE_EVENT_GPOS_PAUSE,
+  HB_BUFFER_TRACE_EVENT_FALLBACK_POSITION,
+  HB_BUFFER_TRACE_EVENT_MORX,
+  HB_BUFFER_TRACE_EVENT_MORX_SUBTABLE
+} hb_buffer_trace_event_t;
+
+/**
+ * hb_buffer_trace_func_t:
+ * @buffer: the #hb_buffer_t being shaped.
+ * @font: the #hb_font_t it is shaped with.
+ * @event: the step that just finished.
+ * @index: the lookup, stage or subtable index, as documented for @event.
+ * @elapsed_ns: wall-clock time the step took, in nanoseconds.  Zero if
+ *   the platform has no monotonic clock.
+ * @user_data: user data passed to hb_buffer_set_trace_func().
+ *
+ * Since: REPLACEME
+ */
+typedef void	(*hb_buffer_trace_func_t)	(hb_buffer_t             *buffer,
+						 hb_font_t               *font,
+						 hb_buffer_trace_event_t  event,
+						 unsigned int             index,
+						 uint64_t                 elapsed_ns,
+						 void                    *user_data);
+
+HB_EXTERN void
+hb_buffer_set_trace_func (hb_buffer_t *buffer,
+			  hb_buffer_trace_func_t func,
+			  void *user_data, hb_destroy_func_t destroy);
+
+
+/*
+ * Buffer pools.
+ */
+
+/**
+ * hb_buffer_pool_t:
+ *
+ * A thread-safe cache of buffers, for reusing them and the memory they
+ * hold across shaping requests.
+ *
+ * Since: REPLACEME
+ */
+typedef struct hb_buffer_pool_t hb_buffer_pool_t;
+
+HB_EXTERN hb_buffer_pool_t *
+hb_buffer_pool_create (unsigned int max_buffers);
+
+HB_EXTERN hb_buffer_pool_t *
+hb_buffer_pool_get_empty (void);
+
+HB_EXTERN hb_buffer_pool_t *
+hb_buffer_pool_reference (hb_buffer_pool_t *pool);
+
+HB_EXTERN void
+hb_buffer_pool_destroy (hb_buffer_pool_t *pool);
+
+HB_EXTERN hb_buffer_t *
+hb_buffer_pool_acquire (hb_buffer_pool_t *pool);
+
+HB_EXTERN void
+hb_buffer_pool_release (hb_buffer_pool_t *pool,
+			hb_buffer_t      *buffer);
+
 
 HB_END_DECLS
 
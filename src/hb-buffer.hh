@@ -32,6 +32,7 @@
 
 #include "hb.hh"
 #include "hb-unicode.hh"
+#include "hb-set-digest.hh"
 
 
 #ifndef HB_BUFFER_MAX_LEN_FACTOR
@@ -69,6 +70,8 @@ enum hb_buffer_scratch_flags_t {
   HB_BUFFER_SCRATCH_FLAG_HAS_GPOS_ATTACHMENT		= 0x00000008u,
   HB_BUFFER_SCRATCH_FLAG_HAS_UNSAFE_TO_BREAK		= 0x00000010u,
   HB_BUFFER_SCRATCH_FLAG_HAS_CGJ			= 0x00000020u,
+  /* Glyphs were chosen from advances; see hb_shape_reposition(). */
+  HB_BUFFER_SCRATCH_FLAG_HAS_SIZE_DEPENDENT_GLYPHS	= 0x00000040u,
 
   /* Reserved for complex shapers' internal use. */
   HB_BUFFER_SCRATCH_FLAG_COMPLEX0			= 0x01000000u,
@@ -96,6 +99,9 @@ struct hb_buffer_t
   hb_buffer_scratch_flags_t scratch_flags; /* Have space-fallback, etc. */
   unsigned int max_len; /* Maximum allowed len. */
   int max_ops; /* Maximum allowed operations. */
+  unsigned int max_ops_budget; /* Caller's cap on max_ops, or 0. */
+  unsigned int ops_used; /* By the last shaping. */
+  bool ops_exhausted; /* Whether the last shaping ran out of operations. */
 
   /* Buffer contents */
   hb_buffer_content_type_t content_type;
@@ -127,6 +133,9 @@ struct hb_buffer_t
   hb_buffer_message_func_t message_func;
   void *message_data;
   hb_destroy_func_t message_destroy;
+  hb_buffer_trace_func_t trace_func;
+  void *trace_data;
+  hb_destroy_func_t trace_destroy;
 
   /* Internal debugging. */
   /* The bits here reflect current allocations of the bytes in glyph_info_t's var1 and var2. */
@@ -208,6 +217,14 @@ struct hb_buffer_t
   HB_INTERNAL void clear_output ();
   HB_INTERNAL void clear_positions ();
 
+  hb_set_digest_t digest () const
+  {
+    hb_set_digest_t d;
+    d.init ();
+    d.add_array (&info[0].codepoint, len, sizeof (info[0]));
+    return d;
+  }
+
   HB_INTERNAL void replace_glyphs (unsigned int num_in,
 				   unsigned int num_out,
 				   const hb_codepoint_t *glyph_data);
@@ -330,6 +347,7 @@ struct hb_buffer_t
   HB_INTERNAL bool move_to (unsigned int i); /* i is output-buffer index. */
 
   HB_INTERNAL bool enlarge (unsigned int size);
+  HB_INTERNAL void shrink_to_fit ();
 
   bool ensure (unsigned int size)
   { return likely (!size || size < allocated) ? true : enlarge (size); }
@@ -347,6 +365,22 @@ struct hb_buffer_t
 
   HB_INTERNAL void sort (unsigned int start, unsigned int end, int(*compar)(const hb_glyph_info_t *, const hb_glyph_info_t *));
 
+  /* Charges count operations against the budget hb_buffer_set_max_ops()
+   * set, if any; false once it is used up.  Recursion and AAT DontAdvance
+   * loops draw on max_ops whether there is a budget or not. */
+  bool charge_ops (unsigned int count)
+  {
+    if (likely (!max_ops_budget))
+      return true;
+    if (max_ops <= 0)
+    {
+      ops_exhausted = true;
+      return false;
+    }
+    max_ops -= MIN (count, (unsigned int) max_ops);
+    return true;
+  }
+
   bool messaging () { return unlikely (message_func); }
   bool message (hb_font_t *font, const char *fmt, ...) HB_PRINTF_FUNC(3, 4)
   {
@@ -360,6 +394,19 @@ struct hb_buffer_t
   }
   HB_INTERNAL bool message_impl (hb_font_t *font, const char *fmt, va_list ap) HB_PRINTF_FUNC(3, 0);
 
+  /* Steps that may be traced take a timestamp with trace_start() and
+   * report it with trace() when done.  Both are a branch when no
+   * trace func is set. */
+  bool tracing () const { return unlikely (trace_func); }
+  uint64_t trace_start () const { return tracing () ? trace_now_ns () : 0; }
+  void trace (hb_font_t *font, hb_buffer_trace_event_t event,
+	      unsigned int index, uint64_t start_ns)
+  {
+    if (tracing ())
+      trace_func (this, font, event, index, trace_now_ns () - start_ns, trace_data);
+  }
+  HB_INTERNAL static uint64_t trace_now_ns ();
+
   static void
   set_cluster (hb_glyph_info_t &inf, unsigned int cluster, unsigned int mask = 0)
   {
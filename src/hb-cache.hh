@@ -75,6 +75,56 @@ struct hb_cache_t
 
 typedef hb_cache_t<21, 16, 8> hb_cmap_cache_t;
 typedef hb_cache_t<16, 24, 8> hb_advance_cache_t;
+typedef hb_cache_t<16, 16, 8> hb_v_origin_cache_t; /* Y origins, in font units. */
+
+
+/* Caches glyph extents, in font units.  Each of the four fields lives in
+ * its own cache word tagged with the glyph, so a lookup only hits if all
+ * four words were written for that glyph.  Only glyphs below 65536 with
+ * extents fitting in 16 bits are cached. */
+
+struct hb_extents_cache_t
+{
+  void init () { clear (); }
+  void fini () {}
+
+  void clear ()
+  {
+    for (unsigned int i = 0; i < ARRAY_LENGTH (fields); i++)
+      fields[i].clear ();
+  }
+
+  bool get (hb_codepoint_t glyph, hb_glyph_extents_t *extents) const
+  {
+    if (unlikely (glyph >> 16))
+      return false;
+    unsigned int v[ARRAY_LENGTH_CONST (fields)];
+    for (unsigned int i = 0; i < ARRAY_LENGTH (fields); i++)
+      if (!fields[i].get (glyph, &v[i]))
+	return false;
+    extents->x_bearing = (int16_t) v[0];
+    extents->y_bearing = (int16_t) v[1];
+    extents->width     = (int16_t) v[2];
+    extents->height    = (int16_t) v[3];
+    return true;
+  }
+
+  bool set (hb_codepoint_t glyph, const hb_glyph_extents_t *extents)
+  {
+    int v[ARRAY_LENGTH_CONST (fields)] = {extents->x_bearing, extents->y_bearing,
+					  extents->width, extents->height};
+    for (unsigned int i = 0; i < ARRAY_LENGTH (fields); i++)
+      if ((int16_t) v[i] != v[i])
+	return false; /* Overflows */
+    for (unsigned int i = 0; i < ARRAY_LENGTH (fields); i++)
+      if (unlikely (!fields[i].set (glyph, (uint16_t) v[i])))
+	return false;
+    return true;
+  }
+
+  private:
+  hb_cache_t<16, 16, 8> fields[4];
+};
 
 
 #endif /* HB_CACHE_HH */
@@ -387,7 +387,68 @@ struct byte_str_ref_t
 
 typedef hb_vector_t<byte_str_t> byte_str_array_t;
 
-/* stack */
+/* INDEXes with fewer entries than this are read directly; see
+ * index_accelerator_t. */
+#ifndef HB_CFF_INDEX_DECODE_MIN_COUNT
+#define HB_CFF_INDEX_DECODE_MIN_COUNT 16
+#endif
+
+/* A sanitized CFFIndex with its offsets decoded once into native integers,
+ * so that fetching an entry does not decode offSize-byte offsets again.
+ * Used for CharStrings and Subrs, which are hit for every glyph and every
+ * subroutine call. */
+template <typename INDEX>
+struct index_accelerator_t
+{
+  void init (const INDEX *index_)
+  {
+    index = index_;
+    data = nullptr;
+    offsets.init ();
+
+    unsigned int count = get_count ();
+    if (count < HB_CFF_INDEX_DECODE_MIN_COUNT)
+      return;
+    if (unlikely (!offsets.resize (count + 1)))
+    {
+      offsets.fini ();
+      return;
+    }
+    for (unsigned int i = 0; i <= count; i++)
+      offsets[i] = index->offset_at (i);
+    data = index->data_base ();
+  }
+
+  void fini () { offsets.fini (); }
+
+  /* index is null in the Null accelerator of a missing private dict. */
+  unsigned int get_count () const { return index ? (unsigned int) index->count : 0; }
+
+  byte_str_t operator [] (unsigned int i) const
+  {
+    if (unlikely (!index))
+      return Null(byte_str_t);
+    if (!offsets.length)
+      return (*index)[i];
+    if (unlikely (i >= offsets.length - 1))
+      return Null(byte_str_t);
+
+    /* Same as CFFIndex::length_at(). */
+    const uint32_t *p = offsets.arrayZ () + i;
+    unsigned int length = likely (p[1] >= p[0] && p[1] <= offsets[offsets.length - 1]) ? p[1] - p[0] : 0;
+    return byte_str_t (data + p[0] - 1, length);
+  }
+
+  unsigned int get_memory_usage () const { return offsets.get_allocated_size (); }
+
+  protected:
+  const INDEX *index;
+  const unsigned char *data;
+  hb_vector_t<uint32_t> offsets; /* Empty if not decoded. */
+};
+
+/* stack; held inline, so that interpreting a charstring does not
+ * allocate. */
 template <typename ELEM, int LIMIT>
 struct stack_t
 {
@@ -395,15 +456,14 @@ struct stack_t
   {
     error = false;
     count = 0;
-    elements.init ();
-    elements.resize (kSizeLimit);
-    for (unsigned int i = 0; i < elements.length; i++)
+    for (unsigned int i = 0; i < kSizeLimit; i++)
       elements[i].init ();
   }
 
   void fini ()
   {
-    elements.fini_deep ();
+    for (unsigned int i = 0; i < kSizeLimit; i++)
+      elements[i].fini ();
   }
 
   ELEM& operator [] (unsigned int i)
@@ -414,7 +474,7 @@ struct stack_t
 
   void push (const ELEM &v)
   {
-    if (likely (count < elements.length))
+    if (likely (count < kSizeLimit))
       elements[count++] = v;
     else
       set_error ();
@@ -422,7 +482,7 @@ struct stack_t
 
   ELEM &push ()
   {
-    if (likely (count < elements.length))
+    if (likely (count < kSizeLimit))
       return elements[count++];
     else
     {
@@ -463,7 +523,7 @@ struct stack_t
 
   void unpop ()
   {
-    if (likely (count < elements.length))
+    if (likely (count < kSizeLimit))
       count++;
     else
       set_error ();
@@ -471,7 +531,7 @@ struct stack_t
 
   void clear () { count = 0; }
 
-  bool in_error () const { return (error || elements.in_error ()); }
+  bool in_error () const { return error; }
   void set_error ()      { error = true; }
 
   unsigned int get_count () const { return count; }
@@ -482,7 +542,7 @@ struct stack_t
   protected:
   bool error;
   unsigned int count;
-  hb_vector_t<ELEM> elements;
+  ELEM elements[LIMIT];
 };
 
 /* argument stack */
@@ -539,7 +599,7 @@ struct arg_stack_t : stack_t<ARG, 513>
 
   hb_array_t<const ARG> get_subarray (unsigned int start) const
   {
-    return S::elements.sub_array (start);
+    return hb_array (S::elements).sub_array (start);
   }
 
   private:
@@ -581,6 +641,8 @@ struct parsed_values_t
   }
   void fini () { values.fini_deep (); }
 
+  unsigned int get_memory_usage () const { return values.get_allocated_size (); }
+
   void add_op (op_code_t op, const byte_str_ref_t& str_ref = byte_str_ref_t ())
   {
     VAL *val = values.push ();
@@ -62,7 +62,7 @@ struct call_stack_t : stack_t<call_context_t, kMaxCallLimit> {};
 template <typename SUBRS>
 struct biased_subrs_t
 {
-  void init (const SUBRS &subrs_)
+  void init (const index_accelerator_t<SUBRS> &subrs_)
   {
     subrs = &subrs_;
     unsigned int  nSubrs = get_count ();
@@ -76,12 +76,12 @@ struct biased_subrs_t
 
   void fini () {}
 
-  unsigned int get_count () const { return (subrs == nullptr)? 0: subrs->count; }
+  unsigned int get_count () const { return (subrs == nullptr)? 0: subrs->get_count (); }
   unsigned int get_bias () const { return bias; }
 
   byte_str_t operator [] (unsigned int index) const
   {
-    if (unlikely ((subrs == nullptr) || index >= subrs->count))
+    if (unlikely ((subrs == nullptr) || index >= subrs->get_count ()))
       return Null(byte_str_t);
     else
       return (*subrs)[index];
@@ -89,7 +89,7 @@ struct biased_subrs_t
 
   protected:
   unsigned int  bias;
-  const SUBRS   *subrs;
+  const index_accelerator_t<SUBRS> *subrs;
 };
 
 struct point_t
@@ -118,7 +118,9 @@ struct point_t
 template <typename ARG, typename SUBRS>
 struct cs_interp_env_t : interp_env_t<ARG>
 {
-  void init (const byte_str_t &str, const SUBRS &globalSubrs_, const SUBRS &localSubrs_)
+  void init (const byte_str_t &str,
+	     const index_accelerator_t<SUBRS> &globalSubrs_,
+	     const index_accelerator_t<SUBRS> &localSubrs_)
   {
     interp_env_t<ARG>::init (str);
 
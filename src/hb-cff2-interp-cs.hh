@@ -80,23 +80,26 @@ struct cff2_cs_interp_env_t : cs_interp_env_t<blend_arg_t, CFF2Subrs>
 {
   template <typename ACC>
   void init (const byte_str_t &str, ACC &acc, unsigned int fd,
-		    const int *coords_=nullptr, unsigned int num_coords_=0)
+		    const int *coords_=nullptr, unsigned int num_coords_=0,
+		    const hb_font_instance_t *instance_=nullptr)
   {
-    SUPER::init (str, *acc.globalSubrs, *acc.privateDicts[fd].localSubrs);
+    SUPER::init (str, acc.globalSubrsAccel, acc.privateDicts[fd].localSubrsAccel);
 
     coords = coords_;
     num_coords = num_coords_;
+    instance = instance_;
     varStore = acc.varStore;
     seen_blend = false;
     seen_vsindex_ = false;
-    scalars.init ();
+    scalars = hb_array_t<const float> ();
+    scalars_storage.init ();
     do_blend = (coords != nullptr) && num_coords && (varStore != &Null(CFF2VariationStore));
     set_ivs (acc.privateDicts[fd].ivs);
   }
 
   void fini ()
   {
-    scalars.fini ();
+    scalars_storage.fini ();
     SUPER::fini ();
   }
 
@@ -133,10 +136,18 @@ struct cff2_cs_interp_env_t : cs_interp_env_t<blend_arg_t, CFF2Subrs>
       region_count = varStore->varStore.get_region_index_count (get_ivs ());
       if (do_blend)
       {
-	scalars.resize (region_count);
-	varStore->varStore.get_scalars (get_ivs (),
-					(int *)coords, num_coords,
-					&scalars[0], region_count);
+	/* Shared by all glyphs at the font's coordinates. */
+	const float *shared = instance ? instance->get_cff2_scalars (varStore->varStore, get_ivs ()) : nullptr;
+	if (shared)
+	  scalars = hb_array (shared, region_count);
+	else
+	{
+	  scalars_storage.resize (region_count);
+	  varStore->varStore.get_scalars (get_ivs (),
+					  (int *)coords, num_coords,
+					  &scalars_storage[0], region_count);
+	  scalars = hb_array_t<const float> (scalars_storage.arrayZ (), scalars_storage.length);
+	}
       }
       seen_blend = true;
     }
@@ -169,11 +180,12 @@ struct cff2_cs_interp_env_t : cs_interp_env_t<blend_arg_t, CFF2Subrs>
     {
       if (likely (scalars.length == arg.deltas.length))
       {
+	const float *s = scalars.arrayZ;
+	const number_t *d = arg.deltas.arrayZ ();
+	unsigned int count = scalars.length;
 	double v = arg.to_real ();
-	for (unsigned int i = 0; i < scalars.length; i++)
-	{
-	  v += (double)scalars[i] * arg.deltas[i].to_real ();
-	}
+	for (unsigned int i = 0; i < count; i++)
+	  v += (double) s[i] * d[i].to_real ();
 	arg.set_real (v);
 	arg.deltas.resize (0);
       }
@@ -183,10 +195,12 @@ struct cff2_cs_interp_env_t : cs_interp_env_t<blend_arg_t, CFF2Subrs>
   protected:
   const int     *coords;
   unsigned int  num_coords;
+  const hb_font_instance_t *instance; /* At coords, if not nullptr. */
   const	 CFF2VariationStore *varStore;
   unsigned int  region_count;
   unsigned int  ivs;
-  hb_vector_t<float>  scalars;
+  hb_array_t<const float> scalars;
+  hb_vector_t<float>  scalars_storage; /* Backs scalars without instance. */
   bool	  do_blend;
   bool	  seen_vsindex_;
   bool	  seen_blend;
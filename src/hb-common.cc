@@ -71,6 +71,8 @@ _hb_options_init ()
 
       OPTION ("uniscribe-bug-compatible", uniscribe_bug_compatible);
       OPTION ("aat", aat);
+      OPTION ("lookup-glyph-index", lookup_glyph_index);
+      OPTION ("flat-layout-tables", flat_layout_tables);
 
 #undef OPTION
 
@@ -225,11 +227,11 @@ lang_equal (hb_language_t  v1,
   return *p1 == canon_map[*p2];
 }
 
-#if 0
+/* Hashes the canonical form of key, and sets *len to its length. */
 static unsigned int
-lang_hash (const void *key)
+lang_hash (const char *key, unsigned int *len)
 {
-  const unsigned char *p = key;
+  const unsigned char *p = (const unsigned char *) key;
   unsigned int h = 0;
   while (canon_map[*p])
     {
@@ -237,58 +239,66 @@ lang_hash (const void *key)
       p++;
     }
 
+  *len = p - (const unsigned char *) key;
   return h;
 }
-#endif
 
 
 struct hb_language_item_t {
 
   struct hb_language_item_t *next;
-  hb_language_t lang;
+  hb_language_t lang; /* The canonical string, right after the item. */
+  hb_atomic_ptr_t<void> ot_tags; /* See hb-ot-tag.cc; freed with free(). */
 
   bool operator == (const char *s) const
   { return lang_equal (lang, s); }
 
-  hb_language_item_t & operator = (const char *s) {
-    /* If a custom allocated is used calling strdup() pairs
-    badly with a call to the custom free() in fini() below.
-    Therefore don't call strdup(), implement its behavior.
-    */
-    size_t len = strlen(s) + 1;
-    lang = (hb_language_t) malloc(len);
-    if (likely (lang))
-    {
-      memcpy((unsigned char *) lang, s, len);
-      for (unsigned char *p = (unsigned char *) lang; *p; p++)
-	*p = canon_map[*p];
-    }
-
-    return *this;
+  static hb_language_item_t *create (const char *s, unsigned int len)
+  {
+    hb_language_item_t *item = (hb_language_item_t *) calloc (1, sizeof (hb_language_item_t) + len + 1);
+    if (unlikely (!item))
+      return nullptr;
+    unsigned char *p = (unsigned char *) (item + 1);
+    for (unsigned int i = 0; i < len; i++)
+      p[i] = canon_map[(unsigned char) s[i]];
+    p[len] = '\0';
+    item->lang = (hb_language_t) p;
+    return item;
   }
 
-  void fini () { free ((void *) lang); }
+  void destroy ()
+  {
+    free (ot_tags.get ());
+    free (this);
+  }
 };
 
 
-/* Thread-safe lock-free language list */
+/* Thread-safe lock-free language table: a fixed number of buckets, each a
+ * list new languages are prepended to. */
 
-static hb_atomic_ptr_t <hb_language_item_t> langs;
+#define HB_LANGUAGE_BUCKETS 64
+
+static hb_atomic_ptr_t <hb_language_item_t> langs[HB_LANGUAGE_BUCKETS];
 
 #if HB_USE_ATEXIT
+static hb_atomic_int_t langs_count;
+
 static void
 free_langs ()
 {
-retry:
-  hb_language_item_t *first_lang = langs;
-  if (unlikely (!langs.cmpexch (first_lang, nullptr)))
-    goto retry;
-
-  while (first_lang) {
-    hb_language_item_t *next = first_lang->next;
-    first_lang->fini ();
-    free (first_lang);
-    first_lang = next;
+  for (unsigned int i = 0; i < HB_LANGUAGE_BUCKETS; i++)
+  {
+  retry:
+    hb_language_item_t *first_lang = langs[i];
+    if (unlikely (!langs[i].cmpexch (first_lang, nullptr)))
+      goto retry;
+
+    while (first_lang) {
+      hb_language_item_t *next = first_lang->next;
+      first_lang->destroy ();
+      first_lang = next;
+    }
   }
 }
 #endif
@@ -296,40 +306,46 @@ retry:
 static hb_language_item_t *
 lang_find_or_insert (const char *key)
 {
+  unsigned int len;
+  hb_atomic_ptr_t <hb_language_item_t> &bucket = langs[lang_hash (key, &len) % HB_LANGUAGE_BUCKETS];
+  /* Starts with a character BCP 47 does not allow; nothing to intern. */
+  if (unlikely (!len))
+    return nullptr;
+
 retry:
-  hb_language_item_t *first_lang = langs;
+  hb_language_item_t *first_lang = bucket;
 
   for (hb_language_item_t *lang = first_lang; lang; lang = lang->next)
     if (*lang == key)
       return lang;
 
   /* Not found; allocate one. */
-  hb_language_item_t *lang = (hb_language_item_t *) calloc (1, sizeof (hb_language_item_t));
+  hb_language_item_t *lang = hb_language_item_t::create (key, len);
   if (unlikely (!lang))
     return nullptr;
   lang->next = first_lang;
-  *lang = key;
-  if (unlikely (!lang->lang))
-  {
-    free (lang);
-    return nullptr;
-  }
 
-  if (unlikely (!langs.cmpexch (first_lang, lang)))
+  if (unlikely (!bucket.cmpexch (first_lang, lang)))
   {
-    lang->fini ();
-    free (lang);
+    lang->destroy ();
     goto retry;
   }
 
 #if HB_USE_ATEXIT
-  if (!first_lang)
+  if (!langs_count.inc ())
     atexit (free_langs); /* First person registers atexit() callback. */
 #endif
 
   return lang;
 }
 
+/* Slot where hb-ot-tag.cc caches the OpenType tags of language. */
+hb_atomic_ptr_t<void> *
+_hb_language_get_ot_tags (hb_language_t language)
+{
+  return &((hb_language_item_t *) (void *) language - 1)->ot_tags;
+}
+
 
 /**
  * hb_language_from_string:
@@ -601,24 +617,76 @@ hb_user_data_array_t::set (hb_user_data_key_t *key,
   if (!key)
     return false;
 
-  if (replace) {
-    if (!data && !destroy) {
-      items.remove (key, lock);
-      return true;
+  bool remove = replace && !data && !destroy;
+
+  lock.lock ();
+  snapshot_t *current = snapshot.get_relaxed ();
+  hb_user_data_item_t *item = current ? current->find (key) : nullptr;
+  if (item && item->is_set () && !replace)
+  {
+    lock.unlock ();
+    return false;
+  }
+
+  if (item || remove)
+  {
+    hb_user_data_item_t old = {nullptr, HB_ATOMIC_PTR_INIT (nullptr), nullptr};
+    if (item)
+    {
+      old = *item;
+      item->data.set (data);
+      item->destroy = destroy;
     }
+    lock.unlock ();
+    old.fini ();
+    return true;
+  }
+
+  unsigned int count = (current ? current->count : 0) + 1;
+  unsigned int size = 4;
+  while (size < count * 2)
+    size <<= 1;
+  snapshot_t *next = (snapshot_t *) calloc (1, sizeof (snapshot_t) + (size - 1) * sizeof (hb_user_data_item_t));
+  if (unlikely (!next))
+  {
+    lock.unlock ();
+    return false;
+  }
+  next->mask = size - 1;
+  if (current)
+  {
+    for (unsigned int i = 0; i <= current->mask; i++)
+      if (current->items[i].key)
+	next->add (current->items[i]);
+    current->next = superseded;
+    superseded = current;
   }
-  hb_user_data_item_t item = {key, data, destroy};
-  bool ret = !!items.replace_or_insert (item, lock, (bool) replace);
+  hb_user_data_item_t new_item = {key, HB_ATOMIC_PTR_INIT (data), destroy};
+  next->add (new_item);
+  snapshot.cmpexch (current, next);
 
-  return ret;
+  lock.unlock ();
+  return true;
 }
 
-void *
-hb_user_data_array_t::get (hb_user_data_key_t *key)
+void
+hb_user_data_array_t::fini ()
 {
-  hb_user_data_item_t item = {nullptr, nullptr, nullptr};
-
-  return items.find (key, &item, lock) ? item.data : nullptr;
+  while (snapshot_t *current = snapshot.get_relaxed ())
+  {
+    snapshot.set_relaxed (nullptr);
+    for (unsigned int i = 0; i <= current->mask; i++)
+      if (current->items[i].key)
+	current->items[i].fini ();
+    free (current);
+  }
+  while (superseded)
+  {
+    snapshot_t *next = superseded->next;
+    free (superseded);
+    superseded = next;
+  }
+  lock.fini ();
 }
 
 
@@ -1129,3 +1197,173 @@ hb_variation_to_string (hb_variation_t *variation,
 #include "hb-static.cc"
 #define HB_NO_VISIBILITY 1
 #endif
+
+
+/*
+ * Allocator.
+ */
+
+/* From here on, malloc() and friends are the C library's (or the
+ * compile-time custom allocator's). */
+#ifdef HB_ALLOCATOR_FUNCS
+#undef malloc
+#undef calloc
+#undef realloc
+#undef free
+#endif
+
+struct hb_allocator_funcs_t
+{
+  hb_malloc_func_t  malloc_func;
+  hb_calloc_func_t  calloc_func;
+  hb_realloc_func_t realloc_func;
+  hb_free_func_t    free_func;
+  void             *user_data;
+};
+
+static hb_allocator_funcs_t static_allocator_funcs;
+static hb_atomic_ptr_t<hb_allocator_funcs_t> allocator_funcs;
+static hb_atomic_int_t allocator_used; /* Whether memory came from the default one. */
+
+static inline const hb_allocator_funcs_t *
+_hb_get_allocator_funcs ()
+{
+  const hb_allocator_funcs_t *funcs = allocator_funcs.get_relaxed ();
+  if (likely (!funcs) && unlikely (!allocator_used.get_relaxed ()))
+    allocator_used.set_relaxed (true);
+  return funcs;
+}
+
+/**
+ * hb_set_allocator_funcs:
+ * @malloc_func: replacement for malloc().
+ * @calloc_func: (nullable): replacement for calloc(); if %NULL, @malloc_func
+ *               is used and the memory cleared.
+ * @realloc_func: replacement for realloc().
+ * @free_func: replacement for free().
+ * @user_data: data to pass to the functions.
+ *
+ * Makes HarfBuzz allocate all its memory with the given functions instead
+ * of the C library's.  This must be called before any other HarfBuzz
+ * function, and before other threads may use HarfBuzz; the functions must
+ * keep working until the process exits, since HarfBuzz frees some static
+ * data at exit.  Memory may be freed from a different thread than the one
+ * that allocated it.
+ *
+ * Fails if HarfBuzz has already allocated memory, if allocator functions
+ * were already set, or if HarfBuzz was built with compile-time allocator
+ * replacements.
+ *
+ * Return value: whether the functions were installed.
+ *
+ * Since: REPLACEME
+ **/
+hb_bool_t
+hb_set_allocator_funcs (hb_malloc_func_t  malloc_func,
+			hb_calloc_func_t  calloc_func,
+			hb_realloc_func_t realloc_func,
+			hb_free_func_t    free_func,
+			void             *user_data)
+{
+#ifdef HB_ALLOCATOR_FUNCS
+  if (unlikely (!malloc_func || !realloc_func || !free_func ||
+		allocator_used.get () || allocator_funcs.get ()))
+    return false;
+
+  static_allocator_funcs.malloc_func = malloc_func;
+  static_allocator_funcs.calloc_func = calloc_func;
+  static_allocator_funcs.realloc_func = realloc_func;
+  static_allocator_funcs.free_func = free_func;
+  static_allocator_funcs.user_data = user_data;
+  return allocator_funcs.cmpexch (nullptr, &static_allocator_funcs);
+#else
+  return false;
+#endif
+}
+
+/**
+ * hb_malloc:
+ * @size: number of bytes to allocate.
+ *
+ * Allocates memory the way HarfBuzz does, with the functions set by
+ * hb_set_allocator_funcs() if any.  Memory handed to HarfBuzz to free, as
+ * with a free() destroy function, should come from here.
+ *
+ * Return value: the memory, or %NULL.
+ *
+ * Since: REPLACEME
+ **/
+void *
+hb_malloc (size_t size)
+{
+  const hb_allocator_funcs_t *funcs = _hb_get_allocator_funcs ();
+  if (likely (!funcs))
+    return malloc (size);
+  return funcs->malloc_func (size, funcs->user_data);
+}
+
+/**
+ * hb_calloc:
+ * @nmemb: number of elements to allocate.
+ * @size: size of each element, in bytes.
+ *
+ * Like hb_malloc(), allocating cleared memory for @nmemb elements.
+ *
+ * Return value: the memory, or %NULL.
+ *
+ * Since: REPLACEME
+ **/
+void *
+hb_calloc (size_t nmemb, size_t size)
+{
+  const hb_allocator_funcs_t *funcs = _hb_get_allocator_funcs ();
+  if (likely (!funcs))
+    return calloc (nmemb, size);
+  if (funcs->calloc_func)
+    return funcs->calloc_func (nmemb, size, funcs->user_data);
+
+  if (unlikely (size && nmemb > (size_t) -1 / size))
+    return nullptr;
+  void *p = funcs->malloc_func (nmemb * size, funcs->user_data);
+  if (likely (p))
+    memset (p, 0, nmemb * size);
+  return p;
+}
+
+/**
+ * hb_realloc:
+ * @ptr: (nullable): memory from hb_malloc(), hb_calloc() or hb_realloc().
+ * @size: new size, in bytes.
+ *
+ * Like hb_malloc(), resizing @ptr.
+ *
+ * Return value: the memory, or %NULL.
+ *
+ * Since: REPLACEME
+ **/
+void *
+hb_realloc (void *ptr, size_t size)
+{
+  const hb_allocator_funcs_t *funcs = _hb_get_allocator_funcs ();
+  if (likely (!funcs))
+    return realloc (ptr, size);
+  return funcs->realloc_func (ptr, size, funcs->user_data);
+}
+
+/**
+ * hb_free:
+ * @ptr: (nullable): memory from hb_malloc(), hb_calloc() or hb_realloc().
+ *
+ * Frees memory allocated the way HarfBuzz does.
+ *
+ * Since: REPLACEME
+ **/
+void
+hb_free (void *ptr)
+{
+  const hb_allocator_funcs_t *funcs = allocator_funcs.get_relaxed ();
+  if (likely (!funcs))
+    free (ptr);
+  else
+    funcs->free_func (ptr, funcs->user_data);
+}
@@ -66,6 +66,7 @@ typedef unsigned __int64 uint64_t;
 #else
 #  include <stdint.h>
 #endif
+#include <stddef.h>
 
 #if    __GNUC__ > 3 || (__GNUC__ == 3 && __GNUC_MINOR__ >= 1)
 #define HB_DEPRECATED __attribute__((__deprecated__))
@@ -493,6 +494,72 @@ typedef uint32_t hb_color_t;
 #define hb_color_get_blue(color)	(((color) >> 24) & 0xFF)
 
 
+/**
+ * hb_malloc_func_t:
+ * @size: number of bytes to allocate.
+ * @user_data: user data passed to hb_set_allocator_funcs().
+ *
+ * Replacement for malloc(); see hb_set_allocator_funcs().
+ *
+ * Since: REPLACEME
+ */
+typedef void * (*hb_malloc_func_t) (size_t size, void *user_data);
+
+/**
+ * hb_calloc_func_t:
+ * @nmemb: number of elements to allocate.
+ * @size: size of each element, in bytes.
+ * @user_data: user data passed to hb_set_allocator_funcs().
+ *
+ * Replacement for calloc(); see hb_set_allocator_funcs().
+ *
+ * Since: REPLACEME
+ */
+typedef void * (*hb_calloc_func_t) (size_t nmemb, size_t size, void *user_data);
+
+/**
+ * hb_realloc_func_t:
+ * @ptr: memory to resize, or %NULL.
+ * @size: new size, in bytes.
+ * @user_data: user data passed to hb_set_allocator_funcs().
+ *
+ * Replacement for realloc(); see hb_set_allocator_funcs().
+ *
+ * Since: REPLACEME
+ */
+typedef void * (*hb_realloc_func_t) (void *ptr, size_t size, void *user_data);
+
+/**
+ * hb_free_func_t:
+ * @ptr: memory to free, or %NULL.
+ * @user_data: user data passed to hb_set_allocator_funcs().
+ *
+ * Replacement for free(); see hb_set_allocator_funcs().
+ *
+ * Since: REPLACEME
+ */
+typedef void (*hb_free_func_t) (void *ptr, void *user_data);
+
+HB_EXTERN hb_bool_t
+hb_set_allocator_funcs (hb_malloc_func_t  malloc_func,
+			hb_calloc_func_t  calloc_func,
+			hb_realloc_func_t realloc_func,
+			hb_free_func_t    free_func,
+			void             *user_data);
+
+HB_EXTERN void *
+hb_malloc (size_t size);
+
+HB_EXTERN void *
+hb_calloc (size_t nmemb, size_t size);
+
+HB_EXTERN void *
+hb_realloc (void *ptr, size_t size);
+
+HB_EXTERN void
+hb_free (void *ptr);
+
+
 HB_END_DECLS
 
 #endif /* HB_COMMON_H */
@@ -0,0 +1,85 @@
+/*
+ * Copyright © 2019  Google, Inc.
+ *
+ *  This is part of HarfBuzz, a text shaping library.
+ *
+ * Permission is hereby granted, without written agreement and without
+ * license or royalty fees, to use, copy, modify, and distribute this
+ * software and its documentation for any purpose, provided that the
+ * above copyright notice and the following two paragraphs appear in
+ * all copies of this software.
+ *
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE TO ANY PARTY FOR
+ * DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES
+ * ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION, EVEN
+ * IF THE COPYRIGHT HOLDER HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * THE COPYRIGHT HOLDER SPECIFICALLY DISCLAIMS ANY WARRANTIES, INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER IS
+ * ON AN "AS IS" BASIS, AND THE COPYRIGHT HOLDER HAS NO OBLIGATION TO
+ * PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+ *
+ */
+
+#ifndef HB_CONFIG_HH
+#define HB_CONFIG_HH
+
+/*
+ * Subsystems that can be compiled out, for embedders that know they do not
+ * need them.  Define these in CPPFLAGS or config.h.  The public API stays
+ * the same; what a removed subsystem served behaves as for fonts lacking
+ * its tables.
+ *
+ * HB_NO_AAT:		morx/mort, kerx and trak; fonts are shaped with OpenType
+ *			layout, and the shaper no longer checks for them.
+ * HB_NO_CFF:		CFF and CFF2 glyph extents and names in the hb-ot
+ *			font functions.  hb-subset still handles CFF.
+ * HB_NO_SHAPER_ARABIC, HB_NO_SHAPER_HANGUL, HB_NO_SHAPER_HEBREW,
+ * HB_NO_SHAPER_INDIC, HB_NO_SHAPER_KHMER, HB_NO_SHAPER_MYANMAR,
+ * HB_NO_SHAPER_THAI, HB_NO_SHAPER_USE:
+ *			a complex shaper; its scripts get the default shaper.
+ *
+ * HB_LEAN defines all of the above.
+ */
+
+#ifdef HB_LEAN
+#ifndef HB_NO_AAT
+#define HB_NO_AAT
+#endif
+#ifndef HB_NO_CFF
+#define HB_NO_CFF
+#endif
+#ifndef HB_NO_SHAPER_ARABIC
+#define HB_NO_SHAPER_ARABIC
+#endif
+#ifndef HB_NO_SHAPER_HANGUL
+#define HB_NO_SHAPER_HANGUL
+#endif
+#ifndef HB_NO_SHAPER_HEBREW
+#define HB_NO_SHAPER_HEBREW
+#endif
+#ifndef HB_NO_SHAPER_INDIC
+#define HB_NO_SHAPER_INDIC
+#endif
+#ifndef HB_NO_SHAPER_KHMER
+#define HB_NO_SHAPER_KHMER
+#endif
+#ifndef HB_NO_SHAPER_MYANMAR
+#define HB_NO_SHAPER_MYANMAR
+#endif
+#ifndef HB_NO_SHAPER_THAI
+#define HB_NO_SHAPER_THAI
+#endif
+#ifndef HB_NO_SHAPER_USE
+#define HB_NO_SHAPER_USE
+#endif
+#endif
+
+/* The USE shaper builds on the Arabic one. */
+#if defined(HB_NO_SHAPER_ARABIC) && !defined(HB_NO_SHAPER_USE)
+#define HB_NO_SHAPER_USE
+#endif
+
+#endif /* HB_CONFIG_HH */
@@ -309,6 +309,46 @@ hb_coretext_face_get_cg_font (hb_face_t *face)
 }
 
 
+struct feature_record_t {
+  unsigned int feature;
+  unsigned int setting;
+};
+
+struct hb_coretext_font_data_t
+{
+  CTFontRef ct_font;
+
+  /* Copies of ct_font with AAT feature settings applied, for feature
+   * ranges, most recently used first.  Creating those is the slowest
+   * part of setting up features; see get_feature_font(). */
+  enum { MAX_FEATURE_FONTS = 8 };
+  enum { MAX_FEATURE_SETTINGS = 16 };
+  struct feature_font_t
+  {
+    CTFontRef font;
+    unsigned int num_settings;
+    feature_record_t settings[MAX_FEATURE_SETTINGS];
+  };
+  hb_mutex_t lock;
+  unsigned int num_feature_fonts;
+  feature_font_t feature_fonts[MAX_FEATURE_FONTS];
+};
+
+/* Takes ownership of ct_font. */
+static hb_coretext_font_data_t *
+font_data_create (CTFontRef ct_font)
+{
+  hb_coretext_font_data_t *data = (hb_coretext_font_data_t *) calloc (1, sizeof (hb_coretext_font_data_t));
+  if (unlikely (!data))
+  {
+    CFRelease (ct_font);
+    return nullptr;
+  }
+  data->ct_font = ct_font;
+  data->lock.init ();
+  return data;
+}
+
 hb_coretext_font_data_t *
 _hb_coretext_shaper_font_data_create (hb_font_t *font)
 {
@@ -325,13 +365,17 @@ _hb_coretext_shaper_font_data_create (hb_font_t *font)
     return nullptr;
   }
 
-  return (hb_coretext_font_data_t *) ct_font;
+  return font_data_create (ct_font);
 }
 
 void
 _hb_coretext_shaper_font_data_destroy (hb_coretext_font_data_t *data)
 {
-  CFRelease ((CTFontRef) data);
+  for (unsigned int i = 0; i < data->num_feature_fonts; i++)
+    CFRelease (data->feature_fonts[i].font);
+  data->lock.fini ();
+  CFRelease (data->ct_font);
+  free (data);
 }
 
 static const hb_coretext_font_data_t *
@@ -341,7 +385,7 @@ retry:
   const hb_coretext_font_data_t *data = font->data.coretext;
   if (unlikely (!data)) return nullptr;
 
-  if (fabs (CTFontGetSize((CTFontRef) data) - coretext_font_size_from_ptem (font->ptem)) > .5)
+  if (fabs (CTFontGetSize (data->ct_font) - coretext_font_size_from_ptem (font->ptem)) > .5)
   {
     /* XXX-MT-bug
      * Note that evaluating condition above can be dangerous if another thread
@@ -384,7 +428,9 @@ hb_coretext_font_create (CTFontRef ct_font)
   hb_font_set_ptem (font, coretext_font_size_to_ptem (CTFontGetSize(ct_font)));
 
   /* Let there be dragons here... */
-  font->data.coretext.cmpexch (nullptr, (hb_coretext_font_data_t *) CFRetain (ct_font));
+  hb_coretext_font_data_t *data = font_data_create ((CTFontRef) CFRetain (ct_font));
+  if (data && !font->data.coretext.cmpexch (nullptr, data))
+    _hb_coretext_shaper_font_data_destroy (data);
 
   return font;
 }
@@ -393,7 +439,7 @@ CTFontRef
 hb_coretext_font_get_ct_font (hb_font_t *font)
 {
   const hb_coretext_font_data_t *data = hb_coretext_font_data_sync (font);
-  return data ? (CTFontRef) data : nullptr;
+  return data ? data->ct_font : nullptr;
 }
 
 
@@ -401,11 +447,6 @@ hb_coretext_font_get_ct_font (hb_font_t *font)
  * shaper
  */
 
-struct feature_record_t {
-  unsigned int feature;
-  unsigned int setting;
-};
-
 struct active_feature_t {
   feature_record_t rec;
   unsigned int order;
@@ -443,6 +484,113 @@ struct range_record_t {
   unsigned int index_last;  /* == end - 1 */
 };
 
+static CTFontRef
+create_feature_font (CTFontRef ct_font,
+		     const hb_vector_t<active_feature_t> &active_features)
+{
+  CFMutableArrayRef features_array = CFArrayCreateMutable(kCFAllocatorDefault, 0, &kCFTypeArrayCallBacks);
+
+  /* TODO sort and resolve conflicting features? */
+  /* active_features.qsort (); */
+  for (unsigned int j = 0; j < active_features.length; j++)
+  {
+    CFStringRef keys[] = {
+      kCTFontFeatureTypeIdentifierKey,
+      kCTFontFeatureSelectorIdentifierKey
+    };
+    CFNumberRef values[] = {
+      CFNumberCreate (kCFAllocatorDefault, kCFNumberIntType, &active_features[j].rec.feature),
+      CFNumberCreate (kCFAllocatorDefault, kCFNumberIntType, &active_features[j].rec.setting)
+    };
+    static_assert ((ARRAY_LENGTH_CONST (keys) == ARRAY_LENGTH_CONST (values)), "");
+    CFDictionaryRef dict = CFDictionaryCreate (kCFAllocatorDefault,
+					       (const void **) keys,
+					       (const void **) values,
+					       ARRAY_LENGTH (keys),
+					       &kCFTypeDictionaryKeyCallBacks,
+					       &kCFTypeDictionaryValueCallBacks);
+    for (unsigned int i = 0; i < ARRAY_LENGTH (values); i++)
+      CFRelease (values[i]);
+
+    CFArrayAppendValue (features_array, dict);
+    CFRelease (dict);
+
+  }
+
+  CFDictionaryRef attributes = CFDictionaryCreate (kCFAllocatorDefault,
+						   (const void **) &kCTFontFeatureSettingsAttribute,
+						   (const void **) &features_array,
+						   1,
+						   &kCFTypeDictionaryKeyCallBacks,
+						   &kCFTypeDictionaryValueCallBacks);
+  CFRelease (features_array);
+
+  CTFontDescriptorRef font_desc = CTFontDescriptorCreateWithAttributes (attributes);
+  CFRelease (attributes);
+
+  CTFontRef font = CTFontCreateCopyWithAttributes (ct_font, 0.0, nullptr, font_desc);
+  CFRelease (font_desc);
+  return font;
+}
+
+static bool
+feature_font_matches (const hb_coretext_font_data_t::feature_font_t &entry,
+		      const hb_vector_t<active_feature_t> &active_features)
+{
+  if (entry.num_settings != active_features.length)
+    return false;
+  for (unsigned int i = 0; i < entry.num_settings; i++)
+    if (entry.settings[i].feature != active_features[i].rec.feature ||
+	entry.settings[i].setting != active_features[i].rec.setting)
+      return false;
+  return true;
+}
+
+/* Returns a new reference to a copy of the font's CTFont with
+ * active_features applied, from the font's cache if possible. */
+static CTFontRef
+get_feature_font (hb_coretext_font_data_t *data,
+		  const hb_vector_t<active_feature_t> &active_features)
+{
+  typedef hb_coretext_font_data_t::feature_font_t feature_font_t;
+
+  data->lock.lock ();
+  for (unsigned int i = 0; i < data->num_feature_fonts; i++)
+    if (feature_font_matches (data->feature_fonts[i], active_features))
+    {
+      feature_font_t hit = data->feature_fonts[i];
+      memmove (&data->feature_fonts[1], &data->feature_fonts[0],
+	       i * sizeof (data->feature_fonts[0]));
+      data->feature_fonts[0] = hit;
+      CFRetain (hit.font);
+      data->lock.unlock ();
+      return hit.font;
+    }
+  data->lock.unlock ();
+
+  CTFontRef font = create_feature_font (data->ct_font, active_features);
+  if (unlikely (!font) ||
+      active_features.length > hb_coretext_font_data_t::MAX_FEATURE_SETTINGS)
+    return font;
+
+  feature_font_t entry;
+  entry.font = (CTFontRef) CFRetain (font);
+  entry.num_settings = active_features.length;
+  for (unsigned int i = 0; i < entry.num_settings; i++)
+    entry.settings[i] = active_features[i].rec;
+
+  data->lock.lock ();
+  if (data->num_feature_fonts == hb_coretext_font_data_t::MAX_FEATURE_FONTS)
+    CFRelease (data->feature_fonts[--data->num_feature_fonts].font);
+  memmove (&data->feature_fonts[1], &data->feature_fonts[0],
+	   data->num_feature_fonts * sizeof (data->feature_fonts[0]));
+  data->feature_fonts[0] = entry;
+  data->num_feature_fonts++;
+  data->lock.unlock ();
+
+  return font;
+}
+
 
 hb_bool_t
 _hb_coretext_shape (hb_shape_plan_t    *shape_plan,
@@ -453,7 +601,8 @@ _hb_coretext_shape (hb_shape_plan_t    *shape_plan,
 {
   hb_face_t *face = font->face;
   CGFontRef cg_font = (CGFontRef) (const void *) face->data.coretext;
-  CTFontRef ct_font = (CTFontRef) hb_coretext_font_data_sync (font);
+  hb_coretext_font_data_t *font_data = const_cast<hb_coretext_font_data_t *> (hb_coretext_font_data_sync (font));
+  CTFontRef ct_font = font_data->ct_font;
 
   CGFloat ct_font_size = CTFontGetSize (ct_font);
   CGFloat x_mult = (CGFloat) font->x_scale / ct_font_size;
@@ -536,55 +685,9 @@ _hb_coretext_shape (hb_shape_plan_t    *shape_plan,
         /* Save a snapshot of active features and the range. */
 	range_record_t *range = range_records.push ();
 
-	if (active_features.length)
-	{
-	  CFMutableArrayRef features_array = CFArrayCreateMutable(kCFAllocatorDefault, 0, &kCFTypeArrayCallBacks);
-
-	  /* TODO sort and resolve conflicting features? */
-	  /* active_features.qsort (); */
-	  for (unsigned int j = 0; j < active_features.length; j++)
-	  {
-	    CFStringRef keys[] = {
-	      kCTFontFeatureTypeIdentifierKey,
-	      kCTFontFeatureSelectorIdentifierKey
-	    };
-	    CFNumberRef values[] = {
-	      CFNumberCreate (kCFAllocatorDefault, kCFNumberIntType, &active_features[j].rec.feature),
-	      CFNumberCreate (kCFAllocatorDefault, kCFNumberIntType, &active_features[j].rec.setting)
-	    };
-	    static_assert ((ARRAY_LENGTH_CONST (keys) == ARRAY_LENGTH_CONST (values)), "");
-	    CFDictionaryRef dict = CFDictionaryCreate (kCFAllocatorDefault,
-						       (const void **) keys,
-						       (const void **) values,
-						       ARRAY_LENGTH (keys),
-						       &kCFTypeDictionaryKeyCallBacks,
-						       &kCFTypeDictionaryValueCallBacks);
-	    for (unsigned int i = 0; i < ARRAY_LENGTH (values); i++)
-	      CFRelease (values[i]);
-
-	    CFArrayAppendValue (features_array, dict);
-	    CFRelease (dict);
-
-	  }
-
-	  CFDictionaryRef attributes = CFDictionaryCreate (kCFAllocatorDefault,
-							   (const void **) &kCTFontFeatureSettingsAttribute,
-							   (const void **) &features_array,
-							   1,
-							   &kCFTypeDictionaryKeyCallBacks,
-							   &kCFTypeDictionaryValueCallBacks);
-	  CFRelease (features_array);
-
-	  CTFontDescriptorRef font_desc = CTFontDescriptorCreateWithAttributes (attributes);
-	  CFRelease (attributes);
-
-	  range->font = CTFontCreateCopyWithAttributes (ct_font, 0.0, nullptr, font_desc);
-	  CFRelease (font_desc);
-	}
-	else
-	{
-	  range->font = nullptr;
-	}
+	range->font = active_features.length ?
+		      get_feature_font (font_data, active_features) :
+		      nullptr;
 
 	range->index_first = last_index;
 	range->index_last  = event->index - 1;
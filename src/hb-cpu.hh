@@ -0,0 +1,116 @@
+/*
+ * Copyright © 2019  Google, Inc.
+ *
+ *  This is part of HarfBuzz, a text shaping library.
+ *
+ * Permission is hereby granted, without written agreement and without
+ * license or royalty fees, to use, copy, modify, and distribute this
+ * software and its documentation for any purpose, provided that the
+ * above copyright notice and the following two paragraphs appear in
+ * all copies of this software.
+ *
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE TO ANY PARTY FOR
+ * DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES
+ * ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION, EVEN
+ * IF THE COPYRIGHT HOLDER HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * THE COPYRIGHT HOLDER SPECIFICALLY DISCLAIMS ANY WARRANTIES, INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER IS
+ * ON AN "AS IS" BASIS, AND THE COPYRIGHT HOLDER HAS NO OBLIGATION TO
+ * PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+ *
+ */
+
+#ifndef HB_CPU_HH
+#define HB_CPU_HH
+
+#include "hb.hh"
+
+
+/*
+ * Runtime CPU feature detection, for kernels wider than the SIMD baseline
+ * hb.hh compiles in.  Features are detected once, on first use.  Setting
+ * HB_CPU to one of none, sse2, sse4.2, avx2 or neon in the environment
+ * caps the detected ones at that level, so each version of a kernel can be
+ * tested on a machine that has better ones.  The cap does not reach the
+ * SSE2 / NEON code compiled in as baseline; define HB_NO_SIMD for that.
+ */
+
+#if !defined(HB_NO_SIMD) && (defined(__GNUC__) || defined(__clang__)) && \
+    (defined(__x86_64__) || defined(__i386__))
+/* Kernels for features past the baseline are built with
+ * __attribute__((target (...))). */
+#define HB_CPU_X86 1
+#include <immintrin.h>
+#endif
+
+enum hb_cpu_feature_t
+{
+  HB_CPU_INITIALIZED	= 1u << 0, /* So zero means not detected yet. */
+  HB_CPU_SSE2		= 1u << 1,
+  HB_CPU_SSE4_2		= 1u << 2,
+  HB_CPU_AVX2		= 1u << 3,
+  HB_CPU_NEON		= 1u << 4,
+};
+
+HB_INTERNAL void
+_hb_cpu_features_init ();
+
+extern HB_INTERNAL hb_atomic_int_t _hb_cpu_features;
+
+static inline unsigned int
+hb_cpu_features ()
+{
+  unsigned int features = _hb_cpu_features.get_relaxed ();
+  if (unlikely (!features))
+  {
+    _hb_cpu_features_init ();
+    features = _hb_cpu_features.get_relaxed ();
+  }
+  return features;
+}
+
+static inline bool
+hb_cpu_has (unsigned int features)
+{ return (hb_cpu_features () & features) == features; }
+
+
+/*
+ * A kernel with versions for several instruction sets.  versions lists
+ * them best first, ending with one that needs no features; get() returns
+ * the first the CPU can run, choosing on first call.  Meant to be static
+ * and constant-initialized:
+ *
+ *   static const hb_cpu_dispatch_t<func_t>::version_t versions[] = {...};
+ *   static hb_cpu_dispatch_t<func_t> kernel = {versions, HB_ATOMIC_INT_INIT (-1)};
+ */
+template <typename func_t>
+struct hb_cpu_dispatch_t
+{
+  struct version_t
+  {
+    unsigned int features; /* All needed. */
+    func_t func;
+  };
+
+  func_t get ()
+  {
+    int i = chosen.get_relaxed ();
+    if (unlikely (i < 0))
+    {
+      i = 0;
+      while (!hb_cpu_has (versions[i].features))
+	i++;
+      chosen.set_relaxed (i);
+    }
+    return versions[i].func;
+  }
+
+  const version_t *versions;
+  hb_atomic_int_t chosen; /* Index into versions, or -1. */
+};
+
+
+#endif /* HB_CPU_HH */
@@ -47,6 +47,8 @@ struct hb_options_t
   bool initialized : 1;
   bool uniscribe_bug_compatible : 1;
   bool aat : 1;
+  bool lookup_glyph_index : 1;
+  bool flat_layout_tables : 1;
 };
 
 union hb_options_union_t {
@@ -364,6 +366,10 @@ struct hb_no_trace_t {
 #define HB_DEBUG_DIRECTWRITE (HB_DEBUG+0)
 #endif
 
+#ifndef HB_DEBUG_DIGEST
+#define HB_DEBUG_DIGEST (HB_DEBUG+0)
+#endif
+
 #ifndef HB_DEBUG_FT
 #define HB_DEBUG_FT (HB_DEBUG+0)
 #endif
@@ -136,6 +136,7 @@ struct hb_directwrite_face_data_t
   IDWriteFontFileStream *fontFileStream;
   IDWriteFontFileLoader *fontFileLoader;
   IDWriteFontFace *fontFace;
+  IDWriteTextAnalyzer *analyzer;
   hb_blob_t *faceBlob;
 };
 
@@ -193,6 +194,8 @@ _hb_directwrite_shaper_face_data_create (hb_face_t *face)
   data->fontFileStream = fontFileStream;
   data->fontFileLoader = fontFileLoader;
   data->fontFace = fontFace;
+  data->analyzer = nullptr;
+  dwriteFactory->CreateTextAnalyzer (&data->analyzer);
   data->faceBlob = blob;
 
   return data;
@@ -201,6 +204,8 @@ _hb_directwrite_shaper_face_data_create (hb_face_t *face)
 void
 _hb_directwrite_shaper_face_data_destroy (hb_directwrite_face_data_t *data)
 {
+  if (data->analyzer)
+    data->analyzer->Release ();
   if (data->fontFace)
     data->fontFace->Release ();
   if (data->fontFile)
@@ -226,7 +231,73 @@ _hb_directwrite_shaper_face_data_destroy (hb_directwrite_face_data_t *data)
  * shaper font data
  */
 
-struct hb_directwrite_font_data_t {};
+/* Output arrays for GetGlyphs() and GetGlyphPlacements(), grown as
+ * needed and kept by the font between calls; see glyph_arrays_lease_t. */
+struct glyph_arrays_t
+{
+  void init ()
+  {
+    textAllocated = glyphsAllocated = 0;
+    clusterMap = nullptr;
+    textProperties = nullptr;
+    glyphIndices = nullptr;
+    glyphProperties = nullptr;
+    glyphAdvances = nullptr;
+    glyphOffsets = nullptr;
+  }
+  void fini ()
+  {
+    delete [] clusterMap;
+    delete [] textProperties;
+    free_glyphs ();
+  }
+
+  void ensure_text (uint32_t textLength)
+  {
+    if (textLength <= textAllocated) return;
+    delete [] clusterMap;
+    delete [] textProperties;
+    clusterMap = new uint16_t[textLength];
+    textProperties = new DWRITE_SHAPING_TEXT_PROPERTIES[textLength];
+    textAllocated = textLength;
+  }
+  /* Contents are lost. */
+  void ensure_glyphs (uint32_t glyphCount)
+  {
+    if (glyphCount <= glyphsAllocated) return;
+    free_glyphs ();
+    glyphIndices = new uint16_t[glyphCount];
+    glyphProperties = new DWRITE_SHAPING_GLYPH_PROPERTIES[glyphCount];
+    glyphAdvances = new float[glyphCount];
+    glyphOffsets = new DWRITE_GLYPH_OFFSET[glyphCount];
+    glyphsAllocated = glyphCount;
+  }
+
+  private:
+  void free_glyphs ()
+  {
+    delete [] glyphIndices;
+    delete [] glyphProperties;
+    delete [] glyphAdvances;
+    delete [] glyphOffsets;
+  }
+
+  public:
+  uint32_t textAllocated;
+  uint32_t glyphsAllocated;
+  uint16_t *clusterMap;
+  DWRITE_SHAPING_TEXT_PROPERTIES *textProperties;
+  uint16_t *glyphIndices;
+  DWRITE_SHAPING_GLYPH_PROPERTIES *glyphProperties;
+  float *glyphAdvances;
+  DWRITE_GLYPH_OFFSET *glyphOffsets;
+};
+
+struct hb_directwrite_font_data_t
+{
+  /* Free for the next shaping call to take; null while taken. */
+  hb_atomic_ptr_t<glyph_arrays_t> glyph_arrays;
+};
 
 hb_directwrite_font_data_t *
 _hb_directwrite_shaper_font_data_create (hb_font_t *font)
@@ -235,15 +306,53 @@ _hb_directwrite_shaper_font_data_create (hb_font_t *font)
   if (unlikely (!data))
     return nullptr;
 
+  data->glyph_arrays.init ();
+
   return data;
 }
 
 void
 _hb_directwrite_shaper_font_data_destroy (hb_directwrite_font_data_t *data)
 {
+  glyph_arrays_t *arrays = data->glyph_arrays.get ();
+  if (arrays)
+  {
+    arrays->fini ();
+    delete arrays;
+  }
   delete data;
 }
 
+/* Takes the font's glyph arrays for the duration of a shaping call,
+ * or fresh ones if another call has them, and hands them back. */
+struct glyph_arrays_lease_t
+{
+  glyph_arrays_lease_t (const hb_directwrite_font_data_t *font_data_) :
+    font_data (font_data_)
+  {
+    arrays = font_data->glyph_arrays.get ();
+    if (!arrays || !font_data->glyph_arrays.cmpexch (arrays, nullptr))
+    {
+      arrays = new glyph_arrays_t;
+      arrays->init ();
+    }
+  }
+  ~glyph_arrays_lease_t ()
+  {
+    if (!font_data->glyph_arrays.cmpexch (nullptr, arrays))
+    {
+      arrays->fini ();
+      delete arrays;
+    }
+  }
+
+  glyph_arrays_t *operator -> () const { return arrays; }
+
+  private:
+  const hb_directwrite_font_data_t *font_data;
+  glyph_arrays_t *arrays;
+};
+
 
 // Most of TextAnalysis is originally written by Bas Schouten for Mozilla project
 // but now is relicensed to MIT for HarfBuzz use
@@ -517,11 +626,10 @@ _hb_directwrite_shape_full (hb_shape_plan_t    *shape_plan,
   hb_face_t *face = font->face;
   const hb_directwrite_face_data_t *face_data = face->data.directwrite;
   const hb_directwrite_font_data_t *font_data = font->data.directwrite;
-  IDWriteFactory *dwriteFactory = face_data->dwriteFactory;
   IDWriteFontFace *fontFace = face_data->fontFace;
-
-  IDWriteTextAnalyzer* analyzer;
-  dwriteFactory->CreateTextAnalyzer (&analyzer);
+  IDWriteTextAnalyzer *analyzer = face_data->analyzer;
+  if (unlikely (!analyzer))
+    return false;
 
   unsigned int scratch_size;
   hb_buffer_t::scratch_buffer_t *scratch = buffer->get_scratch_buffer (&scratch_size);
@@ -594,7 +702,9 @@ _hb_directwrite_shape_full (hb_shape_plan_t    *shape_plan,
   if (FAILED (hr))
     FAIL ("Analyzer failed to generate results.");
 
-  uint32_t maxGlyphCount = 3 * textLength / 2 + 16;
+  glyph_arrays_lease_t arrays (font_data);
+  /* Arrays grown for earlier runs save GetGlyphs() retries. */
+  uint32_t maxGlyphCount = MAX (3 * textLength / 2 + 16, arrays->glyphsAllocated);
   uint32_t glyphCount;
   bool isRightToLeft = HB_DIRECTION_IS_BACKWARD (buffer->props.direction);
 
@@ -621,14 +731,13 @@ _hb_directwrite_shape_full (hb_shape_plan_t    *shape_plan,
   const uint32_t featureRangeLengths[] = { textLength };
   //
 
-  uint16_t* clusterMap;
-  clusterMap = new uint16_t[textLength];
-  DWRITE_SHAPING_TEXT_PROPERTIES* textProperties;
-  textProperties = new DWRITE_SHAPING_TEXT_PROPERTIES[textLength];
+  arrays->ensure_text (textLength);
+  uint16_t* clusterMap = arrays->clusterMap;
+  DWRITE_SHAPING_TEXT_PROPERTIES* textProperties = arrays->textProperties;
 retry_getglyphs:
-  uint16_t* glyphIndices = new uint16_t[maxGlyphCount];
-  DWRITE_SHAPING_GLYPH_PROPERTIES* glyphProperties;
-  glyphProperties = new DWRITE_SHAPING_GLYPH_PROPERTIES[maxGlyphCount];
+  arrays->ensure_glyphs (maxGlyphCount);
+  uint16_t* glyphIndices = arrays->glyphIndices;
+  DWRITE_SHAPING_GLYPH_PROPERTIES* glyphProperties = arrays->glyphProperties;
 
   hr = analyzer->GetGlyphs (textString, textLength, fontFace, false,
 			    isRightToLeft, &runHead->mScript, localeName,
@@ -638,9 +747,6 @@ retry_getglyphs:
 
   if (unlikely (hr == HRESULT_FROM_WIN32 (ERROR_INSUFFICIENT_BUFFER)))
   {
-    delete [] glyphIndices;
-    delete [] glyphProperties;
-
     maxGlyphCount *= 2;
 
     goto retry_getglyphs;
@@ -648,8 +754,8 @@ retry_getglyphs:
   if (FAILED (hr))
     FAIL ("Analyzer failed to get glyphs.");
 
-  float* glyphAdvances = new float[maxGlyphCount];
-  DWRITE_GLYPH_OFFSET* glyphOffsets = new DWRITE_GLYPH_OFFSET[maxGlyphCount];
+  float* glyphAdvances = arrays->glyphAdvances;
+  DWRITE_GLYPH_OFFSET* glyphOffsets = arrays->glyphOffsets;
 
   /* The -2 in the following is to compensate for possible
    * alignment needed after the WORD array.  sizeof (WORD) == 2. */
@@ -739,11 +845,6 @@ retry_getglyphs:
       if (FAILED (hr))
 	FAIL ("Analyzer failed to get justified glyphs.");
 
-      delete [] clusterMap;
-      delete [] glyphIndices;
-      delete [] glyphAdvances;
-      delete [] glyphOffsets;
-
       glyphCount = actualGlyphsCount;
       clusterMap = modifiedClusterMap;
       glyphIndices = modifiedGlyphIndices;
@@ -755,15 +856,14 @@ retry_getglyphs:
     }
     else
     {
-      delete [] glyphAdvances;
-      delete [] glyphOffsets;
-
       glyphAdvances = justifiedGlyphAdvances;
       glyphOffsets = justifiedGlyphOffsets;
     }
 
     delete [] justificationOpportunities;
   }
+  if (analyzer1)
+    analyzer1->Release ();
 
   /* Ok, we've got everything we need, now compose output buffer,
    * very, *very*, carefully! */
@@ -818,12 +918,15 @@ retry_getglyphs:
 
   if (isRightToLeft) hb_buffer_reverse (buffer);
 
-  delete [] clusterMap;
-  delete [] glyphIndices;
-  delete [] textProperties;
-  delete [] glyphProperties;
-  delete [] glyphAdvances;
-  delete [] glyphOffsets;
+  /* Justification may have replaced some of the leased arrays. */
+  if (clusterMap != arrays->clusterMap)
+    delete [] clusterMap;
+  if (glyphIndices != arrays->glyphIndices)
+    delete [] glyphIndices;
+  if (glyphAdvances != arrays->glyphAdvances)
+    delete [] glyphAdvances;
+  if (glyphOffsets != arrays->glyphOffsets)
+    delete [] glyphOffsets;
 
   if (num_features)
     delete [] typographic_features.features;
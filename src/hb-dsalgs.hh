@@ -394,6 +394,9 @@ hb_bsearch_r (const void *key, const void *base,
  *
  * 10 November 2018:
  * https://github.com/noporpoise/sort_r/issues/7
+ *
+ * Quicksort partitioning replaced with Lomuto's, as the original did not
+ * always partition correctly.
  */
 
 /* Isaac Turner 29 April 2014 Public Domain */
@@ -450,7 +453,7 @@ static inline void sort_r_simple(void *base, size_t nel, size_t w,
 
     /* Use median of first, middle and last items as pivot */
     char *x, *y, *xend, ch;
-    char *pl, *pm, *pr;
+    char *pl, *pr;
     char *last = b+w*(nel-1), *tmp;
     char *l[3];
     l[0] = b;
@@ -468,25 +471,21 @@ static inline void sort_r_simple(void *base, size_t nel, size_t w,
       ch = *x; *x = *y; *y = ch;
     }
 
-    pl = b;
-    pr = last;
-
-    while(pl < pr) {
-      pm = pl+((pr-pl+1)>>1);
-      for(; pl < pm; pl += w) {
-        if(sort_r_cmpswap(pl, pr, w, compar, arg)) {
-          pr -= w; /* pivot now at pl */
-          break;
-        }
-      }
-      pm = pl+((pr-pl)>>1);
-      for(; pm < pr; pr -= w) {
-        if(sort_r_cmpswap(pl, pr, w, compar, arg)) {
-          pl += w; /* pivot now at pr */
-          break;
-        }
+    /* Lomuto partition: everything below pl compares less than the pivot.
+     * The original partition loop here stepped by half the byte distance
+     * and could leave items on the wrong side. */
+    for(pl = pr = b; pr < last; pr += w) {
+      if(compar(pr, last, arg) < 0) {
+        if (pl != pr)
+          for(x = pl, y = pr, xend = x+w; x<xend; x++, y++) {
+            ch = *x; *x = *y; *y = ch;
+          }
+        pl += w;
       }
     }
+    for(x = pl, y = last, xend = x+w; x<xend && pl != last; x++, y++) {
+      ch = *x; *x = *y; *y = ch;
+    }
 
     sort_r_simple(b, (pl-b)/w, w, compar, arg);
     sort_r_simple(pl+w, (end-(pl+w))/w, w, compar, arg);
@@ -594,6 +593,18 @@ struct hb_vector_size_t
   hb_vector_size_t process (const hb_vector_size_t &o) const
   {
     hb_vector_size_t r;
+#ifdef HB_SIMD
+    if (0 == byte_size % sizeof (hb_simd_t))
+    {
+      for (unsigned int i = 0; i < byte_size; i += sizeof (hb_simd_t))
+      {
+	hb_simd_t a = simd_load (i), b = o.simd_load (i), c;
+	Op::process (c, a, b);
+	r.simd_store (i, c);
+      }
+      return r;
+    }
+#endif
 #if HB_VECTOR_SIZE
     if (HB_VECTOR_SIZE && 0 == (byte_size * 8) % HB_VECTOR_SIZE)
       for (unsigned int i = 0; i < ARRAY_LENGTH (u.vec); i++)
@@ -624,7 +635,73 @@ struct hb_vector_size_t
     return r;
   }
 
+  bool is_zero () const
+  {
+#ifdef HB_SIMD
+    if (0 == byte_size % sizeof (hb_simd_t))
+    {
+      hb_simd_t acc = simd_load (0);
+      for (unsigned int i = sizeof (hb_simd_t); i < byte_size; i += sizeof (hb_simd_t))
+	acc = acc | simd_load (i);
+#ifdef HB_SIMD_SSE2
+      return 0xFFFF == _mm_movemask_epi8 (_mm_cmpeq_epi8 (acc, _mm_setzero_si128 ()));
+#else
+      return !(vgetq_lane_u64 (acc, 0) | vgetq_lane_u64 (acc, 1));
+#endif
+    }
+#endif
+    for (unsigned int i = 0; i < ARRAY_LENGTH (u.v); i++)
+      if (u.v[i])
+	return false;
+    return true;
+  }
+
+  unsigned int get_population () const
+  {
+#ifdef HB_SIMD
+    if (0 == byte_size % sizeof (hb_simd_t))
+    {
+#ifdef HB_SIMD_SSE2
+      /* Per-byte bit counts, then summed with psadbw; see "HACKMEM 169". */
+      const __m128i m1 = _mm_set1_epi8 (0x55);
+      const __m128i m2 = _mm_set1_epi8 (0x33);
+      const __m128i m4 = _mm_set1_epi8 (0x0F);
+      __m128i sum = _mm_setzero_si128 ();
+      for (unsigned int i = 0; i < byte_size; i += sizeof (hb_simd_t))
+      {
+	__m128i x = simd_load (i);
+	x = _mm_sub_epi8 (x, _mm_and_si128 (_mm_srli_epi64 (x, 1), m1));
+	x = _mm_add_epi8 (_mm_and_si128 (x, m2), _mm_and_si128 (_mm_srli_epi64 (x, 2), m2));
+	x = _mm_and_si128 (_mm_add_epi8 (x, _mm_srli_epi64 (x, 4)), m4);
+	sum = _mm_add_epi64 (sum, _mm_sad_epu8 (x, _mm_setzero_si128 ()));
+      }
+      return _mm_cvtsi128_si32 (sum) + _mm_cvtsi128_si32 (_mm_unpackhi_epi64 (sum, sum));
+#else
+      uint64x2_t sum = vdupq_n_u64 (0);
+      for (unsigned int i = 0; i < byte_size; i += sizeof (hb_simd_t))
+	sum = vaddq_u64 (sum, vpaddlq_u32 (vpaddlq_u16 (vpaddlq_u8 (vcntq_u8 (vreinterpretq_u8_u64 (simd_load (i)))))));
+      return vgetq_lane_u64 (sum, 0) + vgetq_lane_u64 (sum, 1);
+#endif
+    }
+#endif
+    unsigned int pop = 0;
+    for (unsigned int i = 0; i < ARRAY_LENGTH (u.v); i++)
+      pop += hb_popcount (u.v[i]);
+    return pop;
+  }
+
   private:
+#ifdef HB_SIMD
+  hb_simd_t simd_load (unsigned int offset) const
+  {
+    hb_simd_t r;
+    memcpy (&r, (const char *) u.v + offset, sizeof (r));
+    return r;
+  }
+  void simd_store (unsigned int offset, const hb_simd_t &x)
+  { memcpy ((char *) u.v + offset, &x, sizeof (x)); }
+#endif
+
   static_assert (byte_size / sizeof (elt_t) * sizeof (elt_t) == byte_size, "");
   union {
     elt_t v[byte_size / sizeof (elt_t)];
@@ -30,9 +30,11 @@
 
 #include "hb-face.hh"
 #include "hb-blob.hh"
+#include "hb-map.hh"
 #include "hb-open-file.hh"
 #include "hb-ot-face.hh"
 #include "hb-ot-cmap-table.hh"
+#include "hb-ot-layout-common.hh"
 
 
 /**
@@ -125,6 +127,12 @@ hb_face_create_for_tables (hb_reference_table_func_t  reference_table_func,
 
   face->num_glyphs.set_relaxed (-1);
 
+  face->sanitize_cache = hb_sanitize_cache_get_empty ();
+
+  face->shape_plans.init (face);
+  face->instances.init ();
+  face->retired_lock.init ();
+
   face->data.init0 (face);
   face->table.init0 (face);
 
@@ -135,8 +143,66 @@ hb_face_create_for_tables (hb_reference_table_func_t  reference_table_func,
 typedef struct hb_face_for_data_closure_t {
   hb_blob_t *blob;
   unsigned int  index;
+
+  /* The face's table directory, found once, and a hash of its tags. */
+  const OT::OpenTypeFontFace *ot_face;
+  unsigned int  base_offset;
+  unsigned int  shift;		/* 32 minus log2 of the number of buckets. */
+  uint16_t     *buckets;	/* Table index plus one; zero if empty. */
 } hb_face_for_data_closure_t;
 
+static unsigned int
+_hb_face_for_data_bucket (const hb_face_for_data_closure_t *closure, hb_tag_t tag)
+{
+  return (tag * 2654435769u) >> closure->shift;
+}
+
+static void
+_hb_face_for_data_closure_index_tables (hb_face_for_data_closure_t *closure)
+{
+  unsigned int count = closure->ot_face->get_table_count ();
+  if (!count)
+    return;
+
+  /* At most half full. */
+  unsigned int bits = 3;
+  while ((1u << bits) < 2 * count)
+    bits++;
+  closure->shift = 32 - bits;
+  closure->buckets = (uint16_t *) calloc (1u << bits, sizeof (uint16_t));
+  if (unlikely (!closure->buckets))
+    return; /* Fall back to searching the directory. */
+
+  unsigned int mask = (1u << bits) - 1;
+  for (unsigned int i = 0; i < count; i++)
+  {
+    hb_tag_t tag = closure->ot_face->get_table (i).tag;
+    unsigned int b = _hb_face_for_data_bucket (closure, tag);
+    while (closure->buckets[b] && closure->ot_face->get_table (closure->buckets[b] - 1).tag != tag)
+      b = (b + 1) & mask;
+    if (!closure->buckets[b]) /* Keep the first of duplicate tags. */
+      closure->buckets[b] = i + 1;
+  }
+}
+
+static const OT::OpenTypeTable &
+_hb_face_for_data_closure_get_table (const hb_face_for_data_closure_t *closure, hb_tag_t tag)
+{
+  if (unlikely (!closure->buckets))
+    return closure->ot_face->get_table_by_tag (tag);
+
+  unsigned int mask = (1u << (32 - closure->shift)) - 1;
+  for (unsigned int b = _hb_face_for_data_bucket (closure, tag);
+       closure->buckets[b];
+       b = (b + 1) & mask)
+  {
+    const OT::OpenTypeTable &table = closure->ot_face->get_table (closure->buckets[b] - 1);
+    if (table.tag == tag)
+      return table;
+  }
+  return Null(OT::OpenTypeTable);
+}
+
 static hb_face_for_data_closure_t *
 _hb_face_for_data_closure_create (hb_blob_t *blob, unsigned int index)
 {
@@ -149,6 +215,10 @@ _hb_face_for_data_closure_create (hb_blob_t *blob, unsigned int index)
   closure->blob = blob;
   closure->index = index;
 
+  const OT::OpenTypeFontFile &ot_file = *blob->as<OT::OpenTypeFontFile> ();
+  closure->ot_face = &ot_file.get_face (index, &closure->base_offset);
+  _hb_face_for_data_closure_index_tables (closure);
+
   return closure;
 }
 
@@ -158,6 +228,7 @@ _hb_face_for_data_closure_destroy (void *data)
   hb_face_for_data_closure_t *closure = (hb_face_for_data_closure_t *) data;
 
   hb_blob_destroy (closure->blob);
+  free (closure->buckets);
   free (closure);
 }
 
@@ -169,17 +240,36 @@ _hb_face_for_data_reference_table (hb_face_t *face HB_UNUSED, hb_tag_t tag, void
   if (tag == HB_TAG_NONE)
     return hb_blob_reference (data->blob);
 
-  const OT::OpenTypeFontFile &ot_file = *data->blob->as<OT::OpenTypeFontFile> ();
-  unsigned int base_offset;
-  const OT::OpenTypeFontFace &ot_face = ot_file.get_face (data->index, &base_offset);
-
-  const OT::OpenTypeTable &table = ot_face.get_table_by_tag (tag);
+  const OT::OpenTypeTable &table = _hb_face_for_data_closure_get_table (data, tag);
 
-  hb_blob_t *blob = hb_blob_create_sub_blob (data->blob, base_offset + table.offset, table.length);
+  hb_blob_t *blob = hb_blob_create_sub_blob (data->blob, data->base_offset + table.offset, table.length);
 
   return blob;
 }
 
+/* Takes over a reference to blob, which must have been sanitized. */
+static hb_face_t *
+_hb_face_create_for_data (hb_blob_t *blob, unsigned int index)
+{
+  hb_face_t *face;
+
+  hb_face_for_data_closure_t *closure = _hb_face_for_data_closure_create (blob, index);
+
+  if (unlikely (!closure))
+  {
+    hb_blob_destroy (blob);
+    return hb_face_get_empty ();
+  }
+
+  face = hb_face_create_for_tables (_hb_face_for_data_reference_table,
+				    closure,
+				    _hb_face_for_data_closure_destroy);
+
+  face->index = index;
+
+  return face;
+}
+
 /**
  * hb_face_create: (Xconstructor)
  * @blob:
@@ -195,23 +285,10 @@ hb_face_t *
 hb_face_create (hb_blob_t    *blob,
 		unsigned int  index)
 {
-  hb_face_t *face;
-
   if (unlikely (!blob))
     blob = hb_blob_get_empty ();
 
-  hb_face_for_data_closure_t *closure = _hb_face_for_data_closure_create (hb_sanitize_context_t ().sanitize_blob<OT::OpenTypeFontFile> (hb_blob_reference (blob)), index);
-
-  if (unlikely (!closure))
-    return hb_face_get_empty ();
-
-  face = hb_face_create_for_tables (_hb_face_for_data_reference_table,
-				    closure,
-				    _hb_face_for_data_closure_destroy);
-
-  face->index = index;
-
-  return face;
+  return _hb_face_create_for_data (hb_sanitize_context_t ().sanitize_blob<OT::OpenTypeFontFile> (hb_blob_reference (blob)), index);
 }
 
 /**
@@ -259,16 +336,23 @@ hb_face_destroy (hb_face_t *face)
 {
   if (!hb_object_destroy (face)) return;
 
-  for (hb_face_t::plan_node_t *node = face->shape_plans; node; )
-  {
-    hb_face_t::plan_node_t *next = node->next;
-    hb_shape_plan_destroy (node->shape_plan);
-    free (node);
-    node = next;
-  }
+  face->shape_plans.fini ();
+  face->instances.fini ();
 
   face->data.fini ();
   face->table.fini ();
+  hb_blob_destroy (face->accelerators.get ());
+  hb_sanitize_cache_destroy (face->sanitize_cache);
+  hb_face_collection_destroy (face->collection);
+
+  for (hb_face_t::retired_t *r = face->retired.get (); r; )
+  {
+    hb_face_t::retired_t *next = r->next;
+    r->destroy (r->p);
+    free (r);
+    r = next;
+  }
+  face->retired_lock.fini ();
 
   if (face->destroy)
     face->destroy (face->user_data);
@@ -519,205 +603,1579 @@ hb_face_get_table_tags (const hb_face_t *face,
 
   hb_face_for_data_closure_t *data = (hb_face_for_data_closure_t *) face->user_data;
 
-  const OT::OpenTypeFontFile &ot_file = *data->blob->as<OT::OpenTypeFontFile> ();
-  const OT::OpenTypeFontFace &ot_face = ot_file.get_face (data->index);
-
-  return ot_face.get_table_tags (start_offset, table_count, table_tags);
+  return data->ot_face->get_table_tags (start_offset, table_count, table_tags);
 }
 
 
 /*
- * Character set.
- */
-
-
-/**
- * hb_face_collect_unicodes:
- * @face: font face.
- * @out: set to add Unicode characters covered by @face to.
- *
- * Since: 1.9.0
+ * Shape plan cache.
  */
-void
-hb_face_collect_unicodes (hb_face_t *face,
-			  hb_set_t  *out)
-{
-  face->table.cmap->collect_unicodes (out);
-}
 
 /**
- * hb_face_collect_variation_selectors:
- * @face: font face.
- * @out: set to add Variation Selector characters covered by @face to.
- *
+ * hb_face_set_shape_plan_cache_size:
+ * @face: a face.
+ * @max_plans: maximum number of shape plans to keep cached.
  *
+ * Sets the number of shape plans hb_shape_plan_create_cached2() keeps for
+ * @face.  When the cache is full, the least-recently-used plan is dropped.
+ * Zero disables caching.  The default is 64.
  *
- * Since: 1.9.0
- */
+ * Since: REPLACEME
+ **/
 void
-hb_face_collect_variation_selectors (hb_face_t *face,
-				     hb_set_t  *out)
+hb_face_set_shape_plan_cache_size (hb_face_t    *face,
+				   unsigned int  max_plans)
 {
-  face->table.cmap->collect_variation_selectors (out);
+  if (unlikely (hb_object_is_inert (face)))
+    return;
+
+  face->shape_plans.set_max_count (max_plans);
 }
 
 /**
- * hb_face_collect_variation_unicodes:
- * @face: font face.
- * @out: set to add Unicode characters for @variation_selector covered by @face to.
+ * hb_face_get_shape_plan_cache_stats:
+ * @face: a face.
+ * @hits: (out) (optional): number of lookups served from the cache.
+ * @misses: (out) (optional): number of lookups that created a new plan.
  *
+ * Retrieves shape plan cache statistics for @face.
  *
+ * Return value: number of shape plans currently cached.
  *
- * Since: 1.9.0
- */
-void
-hb_face_collect_variation_unicodes (hb_face_t *face,
-				    hb_codepoint_t variation_selector,
-				    hb_set_t  *out)
+ * Since: REPLACEME
+ **/
+unsigned int
+hb_face_get_shape_plan_cache_stats (hb_face_t    *face,
+				    unsigned int *hits,   /* OUT */
+				    unsigned int *misses  /* OUT */)
 {
-  face->table.cmap->collect_variation_unicodes (variation_selector, out);
-}
+  if (unlikely (hb_object_is_inert (face)))
+  {
+    if (hits) *hits = 0;
+    if (misses) *misses = 0;
+    return 0;
+  }
 
+  hb_lock_t l (face->shape_plans.lock);
+  if (hits) *hits = face->shape_plans.hits;
+  if (misses) *misses = face->shape_plans.misses;
+  return face->shape_plans.count;
+}
 
 
 /*
- * face-builder: A face that has add_table().
+ * Sanitizing.
  */
 
-struct hb_face_builder_data_t
+/* Tables are told apart by tag, length and the sanitizing parameters;
+ * those equal in all of these are compared byte by byte. */
+struct hb_sanitize_cache_entry_t
 {
-  struct table_entry_t
+  hb_sanitize_cache_entry_t *hash_next;
+  hb_sanitize_cache_entry_t *lru_prev, *lru_next;
+  unsigned int hash;
+  hb_tag_t tag;
+  unsigned int num_glyphs;
+  unsigned int max_ops_factor;
+  hb_blob_t *blob;			/* The table as first sanitized. */
+
+  bool matches (unsigned int hash_, hb_tag_t tag_, unsigned int num_glyphs_,
+		unsigned int max_ops_factor_, unsigned int length) const
   {
-    int cmp (hb_tag_t t) const
-    {
-      if (t < tag) return -1;
-      if (t > tag) return -1;
-      return 0;
-    }
+    return hash == hash_ && tag == tag_ && num_glyphs == num_glyphs_ &&
+	   max_ops_factor == max_ops_factor_ && blob->length == length;
+  }
+};
 
-    hb_tag_t   tag;
-    hb_blob_t *blob;
-  };
+struct hb_sanitize_cache_t
+{
+  hb_object_header_t header;
+
+  hb_mutex_t lock;
+  hb_sanitize_cache_entry_t **buckets;
+  unsigned int bucket_mask;
+  hb_sanitize_cache_entry_t lru; /* Sentinel; lru.lru_next is the newest. */
+  unsigned int num_entries;
+  unsigned int max_entries;
+  unsigned int hits;
+  unsigned int misses;
+
+  static unsigned int hash (hb_tag_t tag, unsigned int num_glyphs,
+			    unsigned int max_ops_factor, unsigned int length)
+  { return ((tag * 31 + num_glyphs) * 31 + max_ops_factor) * 31 + length; }
+
+  void unlink (hb_sanitize_cache_entry_t *entry)
+  {
+    hb_sanitize_cache_entry_t **slot = &buckets[entry->hash & bucket_mask];
+    while (*slot != entry)
+      slot = &(*slot)->hash_next;
+    *slot = entry->hash_next;
+    entry->lru_prev->lru_next = entry->lru_next;
+    entry->lru_next->lru_prev = entry->lru_prev;
+    num_entries--;
+  }
 
-  hb_vector_t<table_entry_t> tables;
+  void touch (hb_sanitize_cache_entry_t *entry)
+  {
+    entry->lru_prev->lru_next = entry->lru_next;
+    entry->lru_next->lru_prev = entry->lru_prev;
+    link_front (entry);
+  }
+
+  void link_front (hb_sanitize_cache_entry_t *entry)
+  {
+    entry->lru_prev = &lru;
+    entry->lru_next = lru.lru_next;
+    entry->lru_next->lru_prev = entry;
+    lru.lru_next = entry;
+  }
 };
 
-static hb_face_builder_data_t *
-_hb_face_builder_data_create ()
+static unsigned int
+_hb_face_sanitize_max_ops_factor (const hb_face_t *face)
 {
-  hb_face_builder_data_t *data = (hb_face_builder_data_t *) calloc (1, sizeof (hb_face_builder_data_t));
-  if (unlikely (!data))
-    return nullptr;
+  return face->sanitize_max_ops_factor ? face->sanitize_max_ops_factor : HB_SANITIZE_MAX_OPS_FACTOR;
+}
 
-  data->tables.init ();
+unsigned int
+_hb_face_get_sanitize_max_ops_factor (const hb_face_t *face)
+{
+  return _hb_face_sanitize_max_ops_factor (face);
+}
 
-  return data;
+void
+_hb_face_add_sanitize_ops (const hb_face_t *face, unsigned int ops)
+{
+  if (unlikely (hb_object_is_inert (face)))
+    return;
+  face->sanitize_ops.add ((int) ops);
 }
 
-static void
-_hb_face_builder_data_destroy (void *user_data)
+bool
+_hb_face_sanitize_cache_lookup (const hb_face_t *face,
+				hb_tag_t         tag,
+				unsigned int     num_glyphs,
+				hb_blob_t       *blob)
 {
-  hb_face_builder_data_t *data = (hb_face_builder_data_t *) user_data;
+  hb_sanitize_cache_t *cache = face->sanitize_cache;
+  if (likely (!cache || hb_object_is_inert (cache)) || !blob->length)
+    return false;
 
-  for (unsigned int i = 0; i < data->tables.length; i++)
-    hb_blob_destroy (data->tables[i].blob);
+  unsigned int max_ops_factor = _hb_face_sanitize_max_ops_factor (face);
+  unsigned int hash = hb_sanitize_cache_t::hash (tag, num_glyphs, max_ops_factor, blob->length);
 
-  data->tables.fini ();
+  /* The same bytes, say a font file shared by many faces, are a hit
+   * straight away; other candidates are compared outside the lock. */
+  hb_blob_t *candidate = nullptr;
+  {
+    hb_lock_t l (cache->lock);
+    for (hb_sanitize_cache_entry_t *entry = cache->buckets[hash & cache->bucket_mask];
+	 entry; entry = entry->hash_next)
+    {
+      if (!entry->matches (hash, tag, num_glyphs, max_ops_factor, blob->length))
+	continue;
+      if (entry->blob->data == blob->data)
+      {
+	cache->touch (entry);
+	cache->hits++;
+	hb_blob_destroy (candidate);
+	return true;
+      }
+      if (!candidate)
+	candidate = hb_blob_reference (entry->blob);
+    }
+  }
 
-  free (data);
+  bool same = candidate && 0 == memcmp (candidate->data, blob->data, blob->length);
+  hb_blob_destroy (candidate);
+
+  hb_lock_t l (cache->lock);
+  if (same)
+    cache->hits++;
+  else
+    cache->misses++;
+  return same;
 }
 
-static hb_blob_t *
-_hb_face_builder_data_reference_blob (hb_face_builder_data_t *data)
+void
+_hb_face_sanitize_cache_add (const hb_face_t *face,
+			     hb_tag_t         tag,
+			     unsigned int     num_glyphs,
+			     hb_blob_t       *blob)
 {
+  hb_sanitize_cache_t *cache = face->sanitize_cache;
+  if (likely (!cache || hb_object_is_inert (cache)) || !blob->length)
+    return;
 
-  unsigned int table_count = data->tables.length;
-  unsigned int face_length = table_count * 16 + 12;
-
-  for (unsigned int i = 0; i < table_count; i++)
-    face_length += hb_ceil_to_4 (hb_blob_get_length (data->tables[i].blob));
+  unsigned int max_ops_factor = _hb_face_sanitize_max_ops_factor (face);
+  unsigned int hash = hb_sanitize_cache_t::hash (tag, num_glyphs, max_ops_factor, blob->length);
 
-  char *buf = (char *) malloc (face_length);
-  if (unlikely (!buf))
-    return nullptr;
+  hb_sanitize_cache_entry_t *entry = (hb_sanitize_cache_entry_t *) calloc (1, sizeof (*entry));
+  if (unlikely (!entry))
+    return;
+  entry->hash = hash;
+  entry->tag = tag;
+  entry->num_glyphs = num_glyphs;
+  entry->max_ops_factor = max_ops_factor;
+  entry->blob = hb_blob_reference (blob);
 
-  hb_serialize_context_t c (buf, face_length);
-  c.propagate_error (data->tables);
-  OT::OpenTypeFontFile *f = c.start_serialize<OT::OpenTypeFontFile> ();
+  hb_sanitize_cache_entry_t *evicted = nullptr;
+  {
+    hb_lock_t l (cache->lock);
+
+    /* Another face may have added the same bytes meanwhile. */
+    for (hb_sanitize_cache_entry_t *e = cache->buckets[hash & cache->bucket_mask]; e; e = e->hash_next)
+      if (e->matches (hash, tag, num_glyphs, max_ops_factor, blob->length) &&
+	  e->blob->data == blob->data)
+      {
+	evicted = entry;
+	entry = nullptr;
+	break;
+      }
+
+    if (entry)
+    {
+      if (cache->num_entries == cache->max_entries)
+      {
+	evicted = cache->lru.lru_prev;
+	cache->unlink (evicted);
+      }
+      hb_sanitize_cache_entry_t **slot = &cache->buckets[hash & cache->bucket_mask];
+      entry->hash_next = *slot;
+      *slot = entry;
+      cache->link_front (entry);
+      cache->num_entries++;
+    }
+  }
 
-  bool is_cff = data->tables.lsearch (HB_TAG ('C','F','F',' ')) || data->tables.lsearch (HB_TAG ('C','F','F','2'));
-  hb_tag_t sfnt_tag = is_cff ? OT::OpenTypeFontFile::CFFTag : OT::OpenTypeFontFile::TrueTypeTag;
+  if (evicted)
+  {
+    hb_blob_destroy (evicted->blob);
+    free (evicted);
+  }
+}
 
-  bool ret = f->serialize_single (&c, sfnt_tag, data->tables.as_array ());
+/**
+ * hb_sanitize_cache_create: (Xconstructor)
+ * @max_tables: most tables to remember.
+ *
+ * Creates a cache of sanitized tables.  Faces set to use it with
+ * hb_face_set_sanitize_cache() skip sanitizing a table if the same bytes
+ * already passed, for a face with the same glyph count and sanitize
+ * budget.  Bytes at the same address, as when faces share a blob, are
+ * recognized right away; a copy elsewhere is compared in full, which is
+ * still much cheaper than sanitizing it.  Up to @max_tables tables are
+ * kept, evicting the least recently used.
+ *
+ * Each table kept holds a reference to its blob, and so to the font data
+ * it came from.
+ *
+ * Return value: (transfer full): a new cache.
+ *
+ * Since: REPLACEME
+ **/
+hb_sanitize_cache_t *
+hb_sanitize_cache_create (unsigned int max_tables)
+{
+  hb_sanitize_cache_t *cache;
 
-  c.end_serialize ();
+  if (!max_tables || !(cache = hb_object_create<hb_sanitize_cache_t> ()))
+    return hb_sanitize_cache_get_empty ();
 
-  if (unlikely (!ret))
+  unsigned int num_buckets = 1;
+  while (num_buckets < max_tables && num_buckets < 0x40000000u)
+    num_buckets <<= 1;
+  cache->buckets = (hb_sanitize_cache_entry_t **) calloc (num_buckets, sizeof (cache->buckets[0]));
+  if (unlikely (!cache->buckets))
   {
-    free (buf);
-    return nullptr;
+    free (cache);
+    return hb_sanitize_cache_get_empty ();
   }
 
-  return hb_blob_create (buf, face_length, HB_MEMORY_MODE_WRITABLE, buf, free);
+  cache->lock.init ();
+  cache->bucket_mask = num_buckets - 1;
+  cache->lru.lru_prev = cache->lru.lru_next = &cache->lru;
+  cache->max_entries = max_tables;
+
+  return cache;
 }
 
-static hb_blob_t *
-_hb_face_builder_reference_table (hb_face_t *face HB_UNUSED, hb_tag_t tag, void *user_data)
+/**
+ * hb_sanitize_cache_get_empty:
+ *
+ * Return value: (transfer full): the empty cache, which keeps nothing.
+ *
+ * Since: REPLACEME
+ **/
+hb_sanitize_cache_t *
+hb_sanitize_cache_get_empty ()
 {
-  hb_face_builder_data_t *data = (hb_face_builder_data_t *) user_data;
+  return const_cast<hb_sanitize_cache_t *> (&Null(hb_sanitize_cache_t));
+}
 
-  if (!tag)
-    return _hb_face_builder_data_reference_blob (data);
+/**
+ * hb_sanitize_cache_reference: (skip)
+ * @cache: a sanitize cache.
+ *
+ * Return value: (transfer full): @cache.
+ *
+ * Since: REPLACEME
+ **/
+hb_sanitize_cache_t *
+hb_sanitize_cache_reference (hb_sanitize_cache_t *cache)
+{
+  return hb_object_reference (cache);
+}
 
-  hb_face_builder_data_t::table_entry_t *entry = data->tables.lsearch (tag);
-  if (entry)
-    return hb_blob_reference (entry->blob);
+/**
+ * hb_sanitize_cache_destroy: (skip)
+ * @cache: a sanitize cache.
+ *
+ * Drops a reference to @cache, releasing the tables it keeps once the
+ * last reference is gone.
+ *
+ * Since: REPLACEME
+ **/
+void
+hb_sanitize_cache_destroy (hb_sanitize_cache_t *cache)
+{
+  if (!hb_object_destroy (cache)) return;
 
-  return nullptr;
-}
+  hb_sanitize_cache_entry_t *entry = cache->lru.lru_next;
+  while (entry != &cache->lru)
+  {
+    hb_sanitize_cache_entry_t *next = entry->lru_next;
+    hb_blob_destroy (entry->blob);
+    free (entry);
+    entry = next;
+  }
+  free (cache->buckets);
+  cache->lock.fini ();
 
+  free (cache);
+}
 
 /**
- * hb_face_builder_create:
+ * hb_sanitize_cache_get_stats:
+ * @cache: a sanitize cache.
+ * @hits: (out) (optional): number of tables found in @cache.
+ * @misses: (out) (optional): number of tables that had to be sanitized.
  *
- * Creates a #hb_face_t that can be used with hb_face_builder_add_table().
- * After tables are added to the face, it can be compiled to a binary
- * font file by calling hb_face_reference_blob().
+ * Reports how well @cache has been doing since it was created.
  *
- * Return value: (transfer full): New face.
+ * Return value: number of tables in @cache.
  *
- * Since: 1.9.0
+ * Since: REPLACEME
  **/
-hb_face_t *
-hb_face_builder_create ()
+unsigned int
+hb_sanitize_cache_get_stats (hb_sanitize_cache_t *cache,
+			     unsigned int        *hits,   /* OUT */
+			     unsigned int        *misses  /* OUT */)
 {
-  hb_face_builder_data_t *data = _hb_face_builder_data_create ();
-  if (unlikely (!data)) return hb_face_get_empty ();
+  if (unlikely (hb_object_is_inert (cache)))
+  {
+    if (hits) *hits = 0;
+    if (misses) *misses = 0;
+    return 0;
+  }
 
-  return hb_face_create_for_tables (_hb_face_builder_reference_table,
-				    data,
-				    _hb_face_builder_data_destroy);
+  hb_lock_t l (cache->lock);
+  if (hits) *hits = cache->hits;
+  if (misses) *misses = cache->misses;
+  return cache->num_entries;
 }
 
 /**
- * hb_face_builder_add_table:
+ * hb_face_set_sanitize_cache:
+ * @face: a face.
+ * @cache: a sanitize cache.
  *
- * Add table for @tag with data provided by @blob to the face.  @face must
- * be created using hb_face_builder_create().
+ * Makes @face look its tables up in @cache before sanitizing them, and
+ * add them to it after.  Only affects tables loaded afterwards.
  *
- * Since: 1.9.0
+ * Since: REPLACEME
  **/
-hb_bool_t
-hb_face_builder_add_table (hb_face_t *face, hb_tag_t tag, hb_blob_t *blob)
+void
+hb_face_set_sanitize_cache (hb_face_t           *face,
+			    hb_sanitize_cache_t *cache)
 {
-  if (unlikely (face->destroy != (hb_destroy_func_t) _hb_face_builder_data_destroy))
-    return false;
+  if (hb_object_is_immutable (face))
+    return;
 
-  hb_face_builder_data_t *data = (hb_face_builder_data_t *) face->user_data;
-  hb_face_builder_data_t::table_entry_t *entry = data->tables.push ();
+  if (!cache)
+    cache = hb_sanitize_cache_get_empty ();
+  hb_sanitize_cache_t *old = face->sanitize_cache;
+  face->sanitize_cache = hb_sanitize_cache_reference (cache);
+  hb_sanitize_cache_destroy (old);
+}
 
-  entry->tag = tag;
-  entry->blob = hb_blob_reference (blob);
+/**
+ * hb_face_set_sanitize_max_ops_factor:
+ * @face: a face.
+ * @factor: checks allowed per table byte, or zero for the default.
+ *
+ * Sets the budget for sanitizing each table of @face: at most @factor
+ * checks per byte of the table, but no fewer than 16384.  A table that
+ * runs out is rejected, which bounds the time spent on malicious fonts.
+ * The default factor is 8.  See hb_face_get_sanitize_ops() for what the
+ * tables loaded so far took.
+ *
+ * Since: REPLACEME
+ **/
+void
+hb_face_set_sanitize_max_ops_factor (hb_face_t    *face,
+				     unsigned int  factor)
+{
+  if (hb_object_is_immutable (face))
+    return;
+
+  face->sanitize_max_ops_factor = factor;
+}
+
+/**
+ * hb_face_get_sanitize_ops:
+ * @face: a face.
+ *
+ * Return value: the number of checks spent sanitizing the tables of
+ * @face loaded so far.  Tables found in a sanitize cache add nothing.
+ *
+ * Since: REPLACEME
+ **/
+unsigned int
+hb_face_get_sanitize_ops (const hb_face_t *face)
+{
+  return (unsigned int) face->sanitize_ops.get_relaxed ();
+}
+
+
+/*
+ * Collections.
+ */
+
+/* Precedes every accelerator of a face's hb_ot_face_t.  Those shared
+ * by the faces of a collection are listed in it, together with what
+ * they were built from. */
+struct hb_face_accelerator_header_t
+{
+  enum { MAX_TABLES = 3 };
+
+  hb_face_accelerator_header_t *next;	/* In the owner's list. */
+  hb_face_collection_t *owner;		/* nullptr if not shared. */
+  unsigned int ref_count;		/* Protected by the owner's lock. */
+
+  unsigned int order;			/* In hb_ot_face_t. */
+  unsigned int num_glyphs;
+  unsigned int upem;
+  unsigned int max_ops_factor;
+  struct { unsigned int offset, length; } tables[MAX_TABLES];
+
+  bool matches (const hb_face_accelerator_header_t &o) const
+  {
+    return order == o.order && num_glyphs == o.num_glyphs && upem == o.upem &&
+	   max_ops_factor == o.max_ops_factor &&
+	   0 == memcmp (tables, o.tables, sizeof (tables));
+  }
+};
+/* Keeps what follows suitably aligned. */
+#define HB_FACE_ACCELERATOR_HEADER_SIZE ((sizeof (hb_face_accelerator_header_t) + 15) & ~15)
+
+struct hb_face_collection_t
+{
+  hb_object_header_t header;
+
+  hb_blob_t *blob;			/* Sanitized. */
+  unsigned int face_count;
+  hb_sanitize_cache_t *sanitize_cache;	/* Shared by the faces created. */
+
+  hb_mutex_t lock;
+  hb_face_accelerator_header_t *accelerators; /* Shared by the faces created. */
+};
+
+/* The tables an accelerator is built from, if it only depends on those,
+ * the glyph count, the upem and the sanitizing budget; or zero. */
+static unsigned int
+_hb_face_accelerator_get_tables (unsigned int order, hb_tag_t *tags)
+{
+  switch (order)
+  {
+  case hb_ot_face_t::ORDER_OT_cmap:
+    tags[0] = HB_OT_TAG_cmap;
+    return 1;
+  case hb_ot_face_t::ORDER_OT_glyf:
+    tags[0] = HB_TAG ('h','e','a','d');
+    tags[1] = HB_TAG ('l','o','c','a');
+    tags[2] = HB_TAG ('g','l','y','f');
+    return 3;
+  case hb_ot_face_t::ORDER_OT_cff1:
+    tags[0] = HB_TAG ('C','F','F',' ');
+    return 1;
+  case hb_ot_face_t::ORDER_OT_cff2:
+    tags[0] = HB_TAG ('C','F','F','2');
+    return 1;
+  case hb_ot_face_t::ORDER_OT_GSUB:
+    /* GSUB::is_blacklisted() looks at these too. */
+    tags[0] = HB_OT_TAG_GSUB;
+    tags[1] = HB_TAG ('O','S','/','2');
+    tags[2] = HB_TAG ('m','o','r','x');
+    return 3;
+  case hb_ot_face_t::ORDER_OT_GPOS:
+    tags[0] = HB_OT_TAG_GPOS;
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+void *
+_hb_face_create_accelerator (hb_face_t                       *face,
+			     unsigned int                     order,
+			     unsigned int                     size,
+			     hb_face_accelerator_init_func_t  init,
+			     hb_face_accelerator_fini_func_t  fini)
+{
+  hb_face_accelerator_header_t *header = (hb_face_accelerator_header_t *) calloc (1, HB_FACE_ACCELERATOR_HEADER_SIZE + size);
+  if (unlikely (!header))
+    return nullptr;
+  void *p = (char *) header + HB_FACE_ACCELERATOR_HEADER_SIZE;
+
+  hb_face_collection_t *collection = face->collection;
+  hb_tag_t tags[hb_face_accelerator_header_t::MAX_TABLES];
+  unsigned int count;
+  /* Attached accelerators are the face's own. */
+  if (!collection || face->accelerators.get () ||
+      !(count = _hb_face_accelerator_get_tables (order, tags)))
+  {
+    init (p, face);
+    return p;
+  }
+
+  header->order = order;
+  header->num_glyphs = face->get_num_glyphs ();
+  header->upem = face->get_upem ();
+  header->max_ops_factor = _hb_face_sanitize_max_ops_factor (face);
+  const hb_face_for_data_closure_t *data = (const hb_face_for_data_closure_t *) face->user_data;
+  for (unsigned int i = 0; i < count; i++)
+  {
+    const OT::OpenTypeTable &table = _hb_face_for_data_closure_get_table (data, tags[i]);
+    if (table.length)
+    {
+      header->tables[i].offset = data->base_offset + table.offset;
+      header->tables[i].length = table.length;
+    }
+  }
+
+  hb_face_accelerator_header_t *found = nullptr;
+  {
+    hb_lock_t l (collection->lock);
+    for (found = collection->accelerators; found; found = found->next)
+      if (found->matches (*header))
+      {
+	found->ref_count++;
+	break;
+      }
+  }
+  if (found)
+  {
+    free (header);
+    return (char *) found + HB_FACE_ACCELERATOR_HEADER_SIZE;
+  }
+
+  init (p, face);
+
+  {
+    hb_lock_t l (collection->lock);
+    /* Another face may have built the same meanwhile. */
+    for (found = collection->accelerators; found; found = found->next)
+      if (found->matches (*header))
+      {
+	found->ref_count++;
+	break;
+      }
+    if (!found)
+    {
+      header->owner = collection;
+      header->ref_count = 1;
+      header->next = collection->accelerators;
+      collection->accelerators = header;
+    }
+  }
+  if (found)
+  {
+    fini (p);
+    free (header);
+    return (char *) found + HB_FACE_ACCELERATOR_HEADER_SIZE;
+  }
+  return p;
+}
+
+void
+_hb_face_destroy_accelerator (void                            *p,
+			      hb_face_accelerator_fini_func_t  fini)
+{
+  hb_face_accelerator_header_t *header = (hb_face_accelerator_header_t *) ((char *) p - HB_FACE_ACCELERATOR_HEADER_SIZE);
+  if (hb_face_collection_t *collection = header->owner)
+  {
+    hb_lock_t l (collection->lock);
+    if (--header->ref_count)
+      return;
+    hb_face_accelerator_header_t **slot = &collection->accelerators;
+    while (*slot != header)
+      slot = &(*slot)->next;
+    *slot = header->next;
+  }
+  fini (p);
+  free (header);
+}
+
+/**
+ * hb_face_collection_create: (Xconstructor)
+ * @blob: a font file.
+ *
+ * Parses @blob, which may hold a single face or a collection of them, in
+ * any of the formats hb_face_create() takes, so that its faces can then
+ * be created with hb_face_collection_create_face() without parsing it
+ * again.  Those faces sanitize each table found at the same place in
+ * @blob only once between them, so tables a collection shares between
+ * its faces, such as the outlines of an OpenType collection, are only
+ * checked for the first face loading them.
+ *
+ * Return value: (transfer full): the new collection.
+ *
+ * Since: REPLACEME
+ **/
+hb_face_collection_t *
+hb_face_collection_create (hb_blob_t *blob)
+{
+  hb_face_collection_t *collection;
+
+  if (unlikely (!blob))
+    blob = hb_blob_get_empty ();
+
+  if (!(collection = hb_object_create<hb_face_collection_t> ()))
+    return hb_face_collection_get_empty ();
+
+  collection->blob = hb_sanitize_context_t ().sanitize_blob<OT::OpenTypeFontFile> (hb_blob_reference (blob));
+  const OT::OpenTypeFontFile &ot = *collection->blob->as<OT::OpenTypeFontFile> ();
+  collection->face_count = ot.get_face_count ();
+
+  /* Room for every table of every face, so nothing is ever evicted. */
+  unsigned int num_tables = 0;
+  for (unsigned int i = 0; i < collection->face_count; i++)
+    num_tables += ot.get_face (i).get_table_count ();
+  collection->sanitize_cache = hb_sanitize_cache_create (num_tables);
+  collection->lock.init ();
+
+  return collection;
+}
+
+/**
+ * hb_face_collection_get_empty:
+ *
+ * Return value: (transfer full): the empty collection, which has no faces.
+ *
+ * Since: REPLACEME
+ **/
+hb_face_collection_t *
+hb_face_collection_get_empty ()
+{
+  return const_cast<hb_face_collection_t *> (&Null(hb_face_collection_t));
+}
+
+/**
+ * hb_face_collection_reference: (skip)
+ * @collection: a collection.
+ *
+ * Return value: (transfer full): @collection.
+ *
+ * Since: REPLACEME
+ **/
+hb_face_collection_t *
+hb_face_collection_reference (hb_face_collection_t *collection)
+{
+  return hb_object_reference (collection);
+}
+
+/**
+ * hb_face_collection_destroy: (skip)
+ * @collection: a collection.
+ *
+ * Drops a reference to @collection.  Faces created from it keep what
+ * they need of it.
+ *
+ * Since: REPLACEME
+ **/
+void
+hb_face_collection_destroy (hb_face_collection_t *collection)
+{
+  if (!hb_object_destroy (collection)) return;
+
+  hb_blob_destroy (collection->blob);
+  hb_sanitize_cache_destroy (collection->sanitize_cache);
+  collection->lock.fini ();
+
+  free (collection);
+}
+
+/**
+ * hb_face_collection_get_face_count:
+ * @collection: a collection.
+ *
+ * Return value: the number of faces in @collection, as hb_face_count()
+ * would return for its blob.
+ *
+ * Since: REPLACEME
+ **/
+unsigned int
+hb_face_collection_get_face_count (const hb_face_collection_t *collection)
+{
+  return collection->face_count;
+}
+
+/**
+ * hb_face_collection_create_face:
+ * @collection: a collection.
+ * @index: the index of the face within @collection.
+ *
+ * Creates the same face as hb_face_create() would with the blob of
+ * @collection, but without parsing the blob again, and with a sanitize
+ * cache shared with the other faces of @collection; see
+ * hb_face_set_sanitize_cache().
+ *
+ * Return value: (transfer full): the new face.
+ *
+ * Since: REPLACEME
+ **/
+hb_face_t *
+hb_face_collection_create_face (hb_face_collection_t *collection,
+				unsigned int          index)
+{
+  if (unlikely (hb_object_is_inert (collection)))
+    return hb_face_create (hb_blob_get_empty (), index);
+
+  hb_face_t *face = _hb_face_create_for_data (hb_blob_reference (collection->blob), index);
+  if (likely (!hb_object_is_inert (face)))
+    face->collection = hb_face_collection_reference (collection);
+  hb_face_set_sanitize_cache (face, collection->sanitize_cache);
+  return face;
+}
+
+
+/*
+ * Prefetching.
+ */
+
+/**
+ * hb_face_prefetch_tables:
+ * @face: a face.
+ * @tags: (array length=tags_count): tables of @face to prefetch.
+ * @tags_count: number of tags in @tags.
+ *
+ * Hints to the system that the tables @tags of @face will be read soon,
+ * so that their pages of a memory-mapped font file, such as one from
+ * hb_blob_create_from_file(), are read in ahead of the first access
+ * instead of one page fault at a time.  Tables missing from @face are
+ * skipped.  This does nothing for faces not made with hb_face_create(),
+ * or where the system offers no such hint.
+ *
+ * Since: REPLACEME
+ **/
+void
+hb_face_prefetch_tables (hb_face_t      *face,
+			 const hb_tag_t *tags,
+			 unsigned int    tags_count)
+{
+  if (face->reference_table_func != _hb_face_for_data_reference_table)
+    return;
+
+  const hb_face_for_data_closure_t *data = (const hb_face_for_data_closure_t *) face->user_data;
+  for (unsigned int i = 0; i < tags_count; i++)
+  {
+    const OT::OpenTypeTable &table = _hb_face_for_data_closure_get_table (data, tags[i]);
+    if (table.length)
+      data->blob->prefetch (data->base_offset + table.offset, table.length);
+  }
+}
+
+/**
+ * hb_face_set_prefetch_on_plan:
+ * @face: a face.
+ * @prefetch: whether to prefetch tables when creating shape plans.
+ *
+ * Sets whether creating a shape plan for @face first prefetches, as
+ * hb_face_prefetch_tables() does, the tables shaping with it will read:
+ * the character map, metrics, and the layout tables for its direction.
+ * This is off by default; it helps with large memory-mapped fonts whose
+ * pages are not yet resident.
+ *
+ * Since: REPLACEME
+ **/
+void
+hb_face_set_prefetch_on_plan (hb_face_t *face,
+			      hb_bool_t  prefetch)
+{
+  if (hb_object_is_immutable (face))
+    return;
+
+  face->prefetch_on_plan = prefetch;
+}
+
+
+/*
+ * Variation instances.
+ */
+
+float *
+hb_font_instance_t::get_scalars (store_t store,
+				 const OT::VariationStore &var_store) const
+{
+retry:
+  float *cache = scalars[store].get ();
+  if (unlikely (!cache))
+  {
+    cache = var_store.create_cache (coords, num_coords);
+    if (unlikely (!cache))
+      return nullptr;
+    if (unlikely (!scalars[store].cmpexch (nullptr, cache)))
+    {
+      OT::VariationStore::destroy_cache (cache);
+      goto retry;
+    }
+  }
+  return cache;
+}
+
+const float *
+hb_font_instance_t::get_cff2_scalars (const OT::VariationStore &var_store,
+				      unsigned int ivs) const
+{
+retry_table:
+  ivs_scalars_t *table = cff2_ivs_scalars.get ();
+  if (unlikely (!table))
+  {
+    unsigned int count = var_store.get_sub_table_count ();
+    if (!count)
+      return nullptr;
+    table = (ivs_scalars_t *) calloc (1, sizeof (ivs_scalars_t) + count * sizeof (table->scalars[0]));
+    if (unlikely (!table))
+      return nullptr;
+    table->count = count;
+    if (unlikely (!cff2_ivs_scalars.cmpexch (nullptr, table)))
+    {
+      ::free (table);
+      goto retry_table;
+    }
+  }
+  if (unlikely (ivs >= table->count))
+    return nullptr;
+
+retry:
+  float *ivs_scalars = table->scalars[ivs].get ();
+  if (unlikely (!ivs_scalars))
+  {
+    unsigned int count = var_store.get_region_index_count (ivs);
+    if (!count)
+      return nullptr;
+    ivs_scalars = (float *) malloc (count * sizeof (ivs_scalars[0]));
+    if (unlikely (!ivs_scalars))
+      return nullptr;
+    var_store.get_scalars (ivs, coords, num_coords, ivs_scalars, count,
+			   get_scalars (CFF2, var_store));
+    if (unlikely (!table->scalars[ivs].cmpexch (nullptr, ivs_scalars)))
+    {
+      ::free (ivs_scalars);
+      goto retry;
+    }
+  }
+  return ivs_scalars;
+}
+
+hb_advance_cache_t *
+hb_font_instance_t::get_advance_cache (bool vertical) const
+{
+  hb_atomic_ptr_t<hb_advance_cache_t> &slot = advances[vertical];
+retry:
+  hb_advance_cache_t *cache = slot.get ();
+  if (unlikely (!cache))
+  {
+    cache = (hb_advance_cache_t *) calloc (1, sizeof (hb_advance_cache_t));
+    if (unlikely (!cache))
+      return nullptr;
+    cache->init ();
+    if (unlikely (!slot.cmpexch (nullptr, cache)))
+    {
+      ::free (cache);
+      goto retry;
+    }
+  }
+  return cache;
+}
+
+void
+hb_face_t::instance_cache_t::destroy (hb_font_instance_t *instance)
+{
+  for (unsigned int i = 0; i < hb_font_instance_t::STORE_COUNT; i++)
+    OT::VariationStore::destroy_cache (instance->scalars[i].get ());
+  hb_font_instance_t::ivs_scalars_t *table = instance->cff2_ivs_scalars.get ();
+  if (table)
+  {
+    for (unsigned int i = 0; i < table->count; i++)
+      ::free (table->scalars[i].get ());
+    ::free (table);
+  }
+  for (unsigned int i = 0; i < ARRAY_LENGTH (instance->advances); i++)
+    ::free (instance->advances[i].get ());
+  ::free (instance->metrics.get ());
+  ::free (instance->coords);
+  ::free (instance);
+}
+
+void
+hb_face_t::instance_cache_t::fini ()
+{
+  /* Fonts hold a reference to their face, so all instances are idle. */
+  for (hb_font_instance_t *instance = list; instance; )
+  {
+    hb_font_instance_t *next = instance->next;
+    destroy (instance);
+    instance = next;
+  }
+  lock.fini ();
+}
+
+hb_font_instance_t *
+hb_face_t::instance_cache_t::acquire (const int *coords, unsigned int num_coords)
+{
+  {
+    hb_lock_t l (lock);
+    for (hb_font_instance_t **p = &list; *p; p = &(*p)->next)
+    {
+      hb_font_instance_t *instance = *p;
+      if (instance->num_coords == num_coords &&
+	  0 == memcmp (instance->coords, coords, num_coords * sizeof (coords[0])))
+      {
+	*p = instance->next;
+	instance->next = list;
+	list = instance;
+	instance->ref_count++;
+	return instance;
+      }
+    }
+  }
+
+  hb_font_instance_t *instance = (hb_font_instance_t *) calloc (1, sizeof (hb_font_instance_t));
+  if (unlikely (!instance))
+    return nullptr;
+  instance->coords = (int *) malloc (num_coords * sizeof (coords[0]));
+  if (unlikely (!instance->coords))
+  {
+    ::free (instance);
+    return nullptr;
+  }
+  memcpy (instance->coords, coords, num_coords * sizeof (coords[0]));
+  instance->num_coords = num_coords;
+  instance->ref_count = 1;
+
+  /* Another font may have added the same coordinates meanwhile; having
+   * two instances for them is harmless. */
+  hb_lock_t l (lock);
+  instance->next = list;
+  list = instance;
+  return instance;
+}
+
+void
+hb_face_t::instance_cache_t::release (hb_font_instance_t *instance)
+{
+  if (!instance)
+    return;
+
+  hb_font_instance_t *evicted = nullptr;
+  {
+    hb_lock_t l (lock);
+    if (--instance->ref_count)
+      return;
+
+    /* Keep the most-recently-used idle instances, in case a new font is
+     * created at the same coordinates. */
+    unsigned int idle = 0;
+    for (hb_font_instance_t **p = &list; *p; )
+    {
+      hb_font_instance_t *node = *p;
+      if (!node->ref_count && ++idle > HB_FACE_MAX_IDLE_INSTANCES)
+      {
+	*p = node->next;
+	node->next = evicted;
+	evicted = node;
+	continue;
+      }
+      p = &node->next;
+    }
+  }
+
+  while (evicted)
+  {
+    hb_font_instance_t *next = evicted->next;
+    destroy (evicted);
+    evicted = next;
+  }
+}
+
+
+/*
+ * Memory usage.
+ */
+
+/**
+ * hb_face_get_memory_usage:
+ * @face: a face.
+ * @start_offset: index of the first entry to retrieve.
+ * @entry_count: (inout) (optional): input length of @entries; output
+ *               number of entries written.
+ * @entries: (out caller-allocates) (array length=entry_count) (optional):
+ *           breakdown of the usage.
+ *
+ * Retrieves how much heap memory @face holds, broken down by the tables and
+ * lookup accelerators loaded so far, the face object itself, and its cached
+ * shape plans.  Table data is not counted unless HarfBuzz made its own copy;
+ * it belongs to the blob the face was created from.
+ *
+ * Return value: total heap memory held by @face, in bytes.
+ *
+ * Since: REPLACEME
+ **/
+unsigned int
+hb_face_get_memory_usage (hb_face_t              *face,
+			  unsigned int            start_offset,
+			  unsigned int           *entry_count, /* IN/OUT */
+			  hb_face_memory_usage_t *entries /* OUT */)
+{
+  hb_ot_face_memory_usage_t usage;
+  usage.entries = entries;
+  usage.start_offset = start_offset;
+  usage.max_entries = entries && entry_count ? *entry_count : 0;
+  usage.count = usage.total = 0;
+
+  if (likely (!hb_object_is_inert (face)))
+  {
+    hb_face_use_t use (face);
+
+    unsigned int face_bytes = sizeof (*face);
+    if (face->destroy == (hb_destroy_func_t) _hb_face_for_data_closure_destroy)
+    {
+      hb_face_for_data_closure_t *data = (hb_face_for_data_closure_t *) face->user_data;
+      face_bytes += sizeof (*data);
+      if (data->buckets)
+	face_bytes += (1u << (32 - data->shift)) * sizeof (data->buckets[0]);
+    }
+    usage.add (HB_TAG ('f','a','c','e'), face_bytes);
+
+    face->table.get_memory_usage (&usage);
+
+    unsigned int plan_bytes = 0;
+    {
+      hb_lock_t l (face->shape_plans.lock);
+      for (hb_face_t::plan_node_t *node = face->shape_plans.mru; node; node = node->lru_next)
+	plan_bytes += sizeof (*node) + hb_shape_plan_get_memory_usage (node->shape_plan);
+    }
+    usage.add (HB_TAG ('p','l','a','n'), plan_bytes);
+  }
+
+  if (entry_count)
+    *entry_count = usage.count > start_offset ?
+		   MIN (usage.count - start_offset, usage.max_entries) : 0;
+  return usage.total;
+}
+
+
+/*
+ * Character set.
+ */
+
+
+/**
+ * hb_face_collect_unicodes:
+ * @face: font face.
+ * @out: set to add Unicode characters covered by @face to.
+ *
+ * Since: 1.9.0
+ */
+void
+hb_face_collect_unicodes (hb_face_t *face,
+			  hb_set_t  *out)
+{
+  face->table.cmap->collect_unicodes (out);
+}
+
+/**
+ * hb_face_get_nominal_glyphs_coverage:
+ * @face: font face.
+ * @count: the number of code points in @unicodes.
+ * @unicodes: (array length=count): the code points to check.
+ * @coverage: (out caller-allocates) (array): a bitmap of (@count + 31) / 32
+ *            words; bit i % 32 of word i / 32 is set if @face maps
+ *            @unicodes[i] to a glyph, and cleared otherwise.
+ *
+ * Checks which of @unicodes @face has nominal glyphs for, as
+ * hb_font_get_nominal_glyph() would find with the default font functions,
+ * without collecting the whole character set of @face.  Faces that are
+ * asked about many code points answer from a compact bitmap of their BMP
+ * coverage, built on first need.
+ *
+ * Return value: the number of code points in @unicodes that @face covers.
+ *
+ * Since: REPLACEME
+ */
+unsigned int
+hb_face_get_nominal_glyphs_coverage (hb_face_t            *face,
+				     unsigned int          count,
+				     const hb_codepoint_t *unicodes,
+				     uint32_t             *coverage /* OUT */)
+{
+  hb_face_use_t use (face);
+  return face->table.cmap->get_coverage (count, unicodes, coverage);
+}
+
+struct hb_face_nominal_glyph_mapping_sink_t
+{
+  void add (hb_codepoint_t u, hb_codepoint_t gid)
+  {
+    if (mapping)
+      mapping->set (u, gid);
+    if (unicodes)
+      unicodes->add (u);
+  }
+
+  hb_map_t *mapping;
+  hb_set_t *unicodes;
+};
+
+/**
+ * hb_face_collect_nominal_glyph_mapping:
+ * @face: font face.
+ * @mapping: (optional): map to add each code point's nominal glyph to.
+ * @unicodes: (optional): set to add the mapped code points to.
+ *
+ * Collects every code point @face maps to a glyph, with the glyph, as
+ * hb_font_get_nominal_glyph() would find them with the default font
+ * functions.  The segments of cmap formats 4, 12 and 13 are walked
+ * directly, which is much faster than looking up the code points
+ * reported by hb_face_collect_unicodes() one by one.
+ *
+ * Since: REPLACEME
+ */
+void
+hb_face_collect_nominal_glyph_mapping (hb_face_t *face,
+				       hb_map_t  *mapping,
+				       hb_set_t  *unicodes)
+{
+  hb_face_use_t use (face);
+  hb_face_nominal_glyph_mapping_sink_t sink = {mapping, unicodes};
+  face->table.cmap->collect_mapping (sink);
+}
+
+/**
+ * hb_face_get_glyph_unicodes:
+ * @face: font face.
+ * @glyph: the glyph to look up.
+ * @start_offset: index of the first code point to retrieve.
+ * @unicodes_count: (inout) (optional): input length of @unicodes; output
+ *                  number of code points written.
+ * @unicodes: (out caller-allocates) (array length=unicodes_count) (optional):
+ *            code points that map to @glyph, in increasing order.
+ *
+ * Retrieves the code points @face maps to @glyph, the reverse of
+ * hb_font_get_nominal_glyph() with the default font functions.  The first
+ * call builds a reverse index of the cmap, which is kept with @face.
+ *
+ * Return value: total number of code points that map to @glyph.
+ *
+ * Since: REPLACEME
+ */
+unsigned int
+hb_face_get_glyph_unicodes (hb_face_t      *face,
+			    hb_codepoint_t  glyph,
+			    unsigned int    start_offset,
+			    unsigned int   *unicodes_count, /* IN/OUT */
+			    hb_codepoint_t *unicodes /* OUT */)
+{
+  hb_face_use_t use (face);
+  return face->table.cmap->get_glyph_unicodes (glyph, start_offset,
+					       unicodes_count, unicodes);
+}
+
+/**
+ * hb_face_collect_variation_selectors:
+ * @face: font face.
+ * @out: set to add Variation Selector characters covered by @face to.
+ *
+ *
+ *
+ * Since: 1.9.0
+ */
+void
+hb_face_collect_variation_selectors (hb_face_t *face,
+				     hb_set_t  *out)
+{
+  face->table.cmap->collect_variation_selectors (out);
+}
+
+/**
+ * hb_face_collect_variation_unicodes:
+ * @face: font face.
+ * @out: set to add Unicode characters for @variation_selector covered by @face to.
+ *
+ *
+ *
+ * Since: 1.9.0
+ */
+void
+hb_face_collect_variation_unicodes (hb_face_t *face,
+				    hb_codepoint_t variation_selector,
+				    hb_set_t  *out)
+{
+  face->table.cmap->collect_variation_unicodes (variation_selector, out);
+}
+
+
+
+/*
+ * face-builder: A face that has add_table().
+ */
+
+struct hb_face_builder_data_t
+{
+  struct table_entry_t
+  {
+    int cmp (hb_tag_t t) const
+    {
+      if (t < tag) return -1;
+      if (t > tag) return -1;
+      return 0;
+    }
+
+    hb_tag_t   tag;
+    hb_blob_t *blob;
+  };
+
+  hb_vector_t<table_entry_t> tables;
+
+  /* Compiled font, as a list of chunks pointing into the table blobs;
+   * built on demand and dropped whenever a table is added. */
+  hb_mutex_t lock;
+  char *directory;
+  OT::head *patched_head;
+  hb_vector_t<hb_face_builder_chunk_t> chunks;
+};
+
+static hb_face_builder_data_t *
+_hb_face_builder_data_create ()
+{
+  hb_face_builder_data_t *data = (hb_face_builder_data_t *) calloc (1, sizeof (hb_face_builder_data_t));
+  if (unlikely (!data))
+    return nullptr;
+
+  data->tables.init ();
+  data->lock.init ();
+  data->chunks.init ();
+
+  return data;
+}
+
+static void
+_hb_face_builder_data_clear_chunks (hb_face_builder_data_t *data)
+{
+  free (data->directory);
+  data->directory = nullptr;
+  free (data->patched_head);
+  data->patched_head = nullptr;
+  data->chunks.resize (0);
+}
+
+static void
+_hb_face_builder_data_destroy (void *user_data)
+{
+  hb_face_builder_data_t *data = (hb_face_builder_data_t *) user_data;
+
+  for (unsigned int i = 0; i < data->tables.length; i++)
+    hb_blob_destroy (data->tables[i].blob);
+
+  _hb_face_builder_data_clear_chunks (data);
+
+  data->tables.fini ();
+  data->chunks.fini ();
+  data->lock.fini ();
+
+  free (data);
+}
+
+/* Must be called with data->lock held. */
+static bool
+_hb_face_builder_data_ensure_chunks (hb_face_builder_data_t *data)
+{
+  if (data->chunks.length)
+    return true;
+
+  unsigned int table_count = data->tables.length;
+  unsigned int directory_length = table_count * 16 + 12;
+
+  data->directory = (char *) malloc (directory_length);
+  if (unlikely (!data->directory))
+    return false;
+
+  hb_face_builder_data_t::table_entry_t *head_entry = data->tables.lsearch (HB_OT_TAG_head);
+  if (head_entry && hb_blob_get_length (head_entry->blob) >= OT::head::static_size)
+  {
+    unsigned int head_length = hb_blob_get_length (head_entry->blob);
+    data->patched_head = (OT::head *) malloc (head_length);
+    if (unlikely (!data->patched_head))
+    {
+      _hb_face_builder_data_clear_chunks (data);
+      return false;
+    }
+    memcpy (data->patched_head, hb_blob_get_data (head_entry->blob, nullptr), head_length);
+  }
+
+  hb_serialize_context_t c (data->directory, directory_length);
+  c.propagate_error (data->tables);
+  OT::OpenTypeFontFile *f = c.start_serialize<OT::OpenTypeFontFile> ();
+
+  bool is_cff = data->tables.lsearch (HB_TAG ('C','F','F',' ')) || data->tables.lsearch (HB_TAG ('C','F','F','2'));
+  hb_tag_t sfnt_tag = is_cff ? OT::OpenTypeFontFile::CFFTag : OT::OpenTypeFontFile::TrueTypeTag;
+
+  bool ret = f->serialize_single (&c, sfnt_tag, data->tables.as_array (), data->patched_head);
+
+  c.end_serialize ();
+
+  if (unlikely (!ret))
+  {
+    _hb_face_builder_data_clear_chunks (data);
+    return false;
+  }
+
+  static const char padding[3] = {0};
+  hb_face_builder_chunk_t *chunk = data->chunks.push ();
+  chunk->data = data->directory;
+  chunk->length = directory_length;
+  for (unsigned int i = 0; i < table_count; i++)
+  {
+    unsigned int length;
+    const char *table = hb_blob_get_data (data->tables[i].blob, &length);
+    if (!length)
+      continue;
+    if (&data->tables[i] == head_entry && data->patched_head)
+      table = (const char *) data->patched_head;
+
+    chunk = data->chunks.push ();
+    chunk->data = table;
+    chunk->length = length;
+
+    if (length & 3)
+    {
+      chunk = data->chunks.push ();
+      chunk->data = padding;
+      chunk->length = 4 - (length & 3);
+    }
+  }
+
+  if (unlikely (data->chunks.in_error ()))
+  {
+    _hb_face_builder_data_clear_chunks (data);
+    return false;
+  }
+
+  return true;
+}
+
+static hb_blob_t *
+_hb_face_builder_data_reference_blob (hb_face_builder_data_t *data)
+{
+  hb_lock_t lock (data->lock);
+
+  if (unlikely (!_hb_face_builder_data_ensure_chunks (data)))
+    return nullptr;
+
+  unsigned int face_length = 0;
+  for (unsigned int i = 0; i < data->chunks.length; i++)
+    face_length += data->chunks[i].length;
+
+  char *buf = (char *) malloc (face_length);
+  if (unlikely (!buf))
+    return nullptr;
+
+  char *p = buf;
+  for (unsigned int i = 0; i < data->chunks.length; i++)
+  {
+    memcpy (p, data->chunks[i].data, data->chunks[i].length);
+    p += data->chunks[i].length;
+  }
+
+  return hb_blob_create (buf, face_length, HB_MEMORY_MODE_WRITABLE, buf, free);
+}
+
+static hb_blob_t *
+_hb_face_builder_reference_table (hb_face_t *face HB_UNUSED, hb_tag_t tag, void *user_data)
+{
+  hb_face_builder_data_t *data = (hb_face_builder_data_t *) user_data;
+
+  if (!tag)
+    return _hb_face_builder_data_reference_blob (data);
+
+  hb_face_builder_data_t::table_entry_t *entry = data->tables.lsearch (tag);
+  if (entry)
+    return hb_blob_reference (entry->blob);
+
+  return nullptr;
+}
+
+
+/**
+ * hb_face_builder_create:
+ *
+ * Creates a #hb_face_t that can be used with hb_face_builder_add_table().
+ * After tables are added to the face, it can be compiled to a binary
+ * font file by calling hb_face_reference_blob().
+ *
+ * Return value: (transfer full): New face.
+ *
+ * Since: 1.9.0
+ **/
+hb_face_t *
+hb_face_builder_create ()
+{
+  hb_face_builder_data_t *data = _hb_face_builder_data_create ();
+  if (unlikely (!data)) return hb_face_get_empty ();
+
+  return hb_face_create_for_tables (_hb_face_builder_reference_table,
+				    data,
+				    _hb_face_builder_data_destroy);
+}
+
+/**
+ * hb_face_builder_add_table:
+ *
+ * Add table for @tag with data provided by @blob to the face.  @face must
+ * be created using hb_face_builder_create().
+ *
+ * Since: 1.9.0
+ **/
+hb_bool_t
+hb_face_builder_add_table (hb_face_t *face, hb_tag_t tag, hb_blob_t *blob)
+{
+  if (unlikely (face->destroy != (hb_destroy_func_t) _hb_face_builder_data_destroy))
+    return false;
+
+  hb_face_builder_data_t *data = (hb_face_builder_data_t *) face->user_data;
+  hb_lock_t lock (data->lock);
+  _hb_face_builder_data_clear_chunks (data);
+
+  hb_face_builder_data_t::table_entry_t *entry = data->tables.push ();
+
+  entry->tag = tag;
+  entry->blob = hb_blob_reference (blob);
+
+  return true;
+}
+
+/**
+ * hb_face_builder_get_chunks:
+ * @face: a builder face.
+ * @start_offset: index of the first chunk to return.
+ * @chunk_count: (inout): maximum number of chunks to return; set to the
+ *   number of chunks returned.
+ * @chunks: (out) (array length=chunk_count): chunks of the compiled font.
+ *
+ * Compiles @face, like hb_face_reference_blob() does, but instead of
+ * copying the tables into one contiguous blob returns the font as a list
+ * of chunks, to be written back to back, e.g. with writev().  Tables
+ * are not copied: the chunks point into the blobs passed to
+ * hb_face_builder_add_table(), and stay valid until another table is
+ * added or @face is destroyed.
+ *
+ * Return value: total number of chunks, or zero if @face is not a
+ * builder face or compiling it failed.
+ *
+ * Since: REPLACEME
+ **/
+unsigned int
+hb_face_builder_get_chunks (hb_face_t               *face,
+			    unsigned int             start_offset,
+			    unsigned int            *chunk_count, /* IN/OUT */
+			    hb_face_builder_chunk_t *chunks /* OUT */)
+{
+  if (unlikely (face->destroy != (hb_destroy_func_t) _hb_face_builder_data_destroy))
+  {
+    if (chunk_count)
+      *chunk_count = 0;
+    return 0;
+  }
+
+  hb_face_builder_data_t *data = (hb_face_builder_data_t *) face->user_data;
+  hb_lock_t lock (data->lock);
+
+  if (unlikely (!_hb_face_builder_data_ensure_chunks (data)))
+  {
+    if (chunk_count)
+      *chunk_count = 0;
+    return 0;
+  }
+
+  unsigned int total = data->chunks.length;
+  if (chunk_count)
+  {
+    unsigned int count = start_offset < total ? total - start_offset : 0;
+    count = MIN (count, *chunk_count);
+    for (unsigned int i = 0; i < count; i++)
+      chunks[i] = data->chunks[start_offset + i];
+    *chunk_count = count;
+  }
+  return total;
+}
 
+/**
+ * hb_face_builder_write:
+ * @face: a builder face.
+ * @write_func: (scope call): callback to write the font with.
+ * @user_data: data to pass to @write_func.
+ *
+ * Compiles @face and streams the font file through @write_func, one
+ * chunk at a time; see hb_face_builder_get_chunks().  The table
+ * directory is written first, then each table, without assembling the
+ * whole font in memory.  @write_func must not add tables to @face.
+ *
+ * Return value: true if the whole font was written.
+ *
+ * Since: REPLACEME
+ **/
+hb_bool_t
+hb_face_builder_write (hb_face_t                    *face,
+		       hb_face_builder_write_func_t  write_func,
+		       void                         *user_data)
+{
+  hb_face_builder_chunk_t chunks[32];
+  unsigned int offset = 0, count;
+  do {
+    count = ARRAY_LENGTH (chunks);
+    if (!hb_face_builder_get_chunks (face, offset, &count, chunks))
+      return false;
+    for (unsigned int i = 0; i < count; i++)
+      if (!write_func (chunks[i].data, chunks[i].length, user_data))
+	return false;
+    offset += count;
+  } while (count == ARRAY_LENGTH (chunks));
   return true;
 }
+
+/* Adds all tables of builder face @source to builder face @face,
+ * in the order they were added to @source. */
+bool
+_hb_face_builder_add_tables_from (hb_face_t *face, hb_face_t *source)
+{
+  if (unlikely (source->destroy != (hb_destroy_func_t) _hb_face_builder_data_destroy))
+    return false;
+
+  const hb_face_builder_data_t *data = (const hb_face_builder_data_t *) source->user_data;
+  bool ret = true;
+  for (unsigned int i = 0; i < data->tables.length; i++)
+    ret = hb_face_builder_add_table (face, data->tables[i].tag, data->tables[i].blob) && ret;
+  return ret;
+}
@@ -34,6 +34,7 @@
 #include "hb-common.h"
 #include "hb-blob.h"
 #include "hb-set.h"
+#include "hb-map.h"
 
 HB_BEGIN_DECLS
 
@@ -122,6 +123,185 @@ hb_face_get_table_tags (const hb_face_t *face,
 			hb_tag_t     *table_tags /* OUT */);
 
 
+/*
+ * Shape plan cache.
+ */
+
+HB_EXTERN void
+hb_face_set_shape_plan_cache_size (hb_face_t    *face,
+				   unsigned int  max_plans);
+
+HB_EXTERN unsigned int
+hb_face_get_shape_plan_cache_stats (hb_face_t    *face,
+				    unsigned int *hits,   /* OUT */
+				    unsigned int *misses  /* OUT */);
+
+
+/*
+ * Sanitizing.
+ */
+
+/**
+ * hb_sanitize_cache_t:
+ *
+ * A thread-safe record of tables that passed sanitizing, shared by any
+ * number of faces, so that the same table bytes are only checked once.
+ *
+ * Since: REPLACEME
+ */
+typedef struct hb_sanitize_cache_t hb_sanitize_cache_t;
+
+HB_EXTERN hb_sanitize_cache_t *
+hb_sanitize_cache_create (unsigned int max_tables);
+
+HB_EXTERN hb_sanitize_cache_t *
+hb_sanitize_cache_get_empty (void);
+
+HB_EXTERN hb_sanitize_cache_t *
+hb_sanitize_cache_reference (hb_sanitize_cache_t *cache);
+
+HB_EXTERN void
+hb_sanitize_cache_destroy (hb_sanitize_cache_t *cache);
+
+HB_EXTERN unsigned int
+hb_sanitize_cache_get_stats (hb_sanitize_cache_t *cache,
+			     unsigned int        *hits,   /* OUT */
+			     unsigned int        *misses  /* OUT */);
+
+HB_EXTERN void
+hb_face_set_sanitize_cache (hb_face_t           *face,
+			    hb_sanitize_cache_t *cache);
+
+HB_EXTERN void
+hb_face_set_sanitize_max_ops_factor (hb_face_t    *face,
+				     unsigned int  factor);
+
+HB_EXTERN unsigned int
+hb_face_get_sanitize_ops (const hb_face_t *face);
+
+
+/*
+ * Collections.
+ */
+
+/**
+ * hb_face_collection_t:
+ *
+ * A font file, such as a TrueType or OpenType collection, parsed once
+ * for creating any number of its faces.  The faces share the tables
+ * found at the same place in the file.
+ *
+ * Since: REPLACEME
+ */
+typedef struct hb_face_collection_t hb_face_collection_t;
+
+HB_EXTERN hb_face_collection_t *
+hb_face_collection_create (hb_blob_t *blob);
+
+HB_EXTERN hb_face_collection_t *
+hb_face_collection_get_empty (void);
+
+HB_EXTERN hb_face_collection_t *
+hb_face_collection_reference (hb_face_collection_t *collection);
+
+HB_EXTERN void
+hb_face_collection_destroy (hb_face_collection_t *collection);
+
+HB_EXTERN unsigned int
+hb_face_collection_get_face_count (const hb_face_collection_t *collection);
+
+HB_EXTERN hb_face_t *
+hb_face_collection_create_face (hb_face_collection_t *collection,
+				unsigned int          index);
+
+
+/*
+ * Memory usage.
+ */
+
+/**
+ * hb_face_memory_usage_t:
+ * @tag: the table the memory belongs to, or one of `face` for the face
+ *       object itself and `plan` for its shape plan cache.
+ * @bytes: heap memory held, in bytes.
+ *
+ * One entry of the breakdown returned by hb_face_get_memory_usage().
+ *
+ * Since: REPLACEME
+ */
+typedef struct hb_face_memory_usage_t
+{
+  hb_tag_t     tag;
+  unsigned int bytes;
+} hb_face_memory_usage_t;
+
+HB_EXTERN unsigned int
+hb_face_get_memory_usage (hb_face_t              *face,
+			  unsigned int            start_offset,
+			  unsigned int           *entry_count, /* IN/OUT */
+			  hb_face_memory_usage_t *entries /* OUT */);
+
+
+/*
+ * Serialized accelerators.
+ */
+
+HB_EXTERN hb_blob_t *
+hb_face_serialize_accelerators (hb_face_t *face);
+
+HB_EXTERN hb_bool_t
+hb_face_attach_accelerators (hb_face_t *face,
+			     hb_blob_t *blob);
+
+
+/*
+ * Prewarming and trimming.
+ */
+
+/**
+ * hb_face_prewarm_flags_t:
+ * @HB_FACE_PREWARM_CMAP: the character map.
+ * @HB_FACE_PREWARM_METRICS: horizontal and vertical metrics.
+ * @HB_FACE_PREWARM_OUTLINES: glyph outlines, from glyf, CFF or CFF2, for
+ *                            extents.
+ * @HB_FACE_PREWARM_LAYOUT: GDEF, GSUB and GPOS, with their lookup
+ *                          accelerators.
+ * @HB_FACE_PREWARM_NAMES: glyph names and the name table.
+ * @HB_FACE_PREWARM_COLOR: color bitmap and SVG glyphs.
+ * @HB_FACE_PREWARM_ALL: all of the above.
+ *
+ * Parts of a face for hb_face_prewarm() to load, or hb_face_trim() to unload.
+ *
+ * Since: REPLACEME
+ */
+typedef enum { /*< flags >*/
+  HB_FACE_PREWARM_CMAP		= 0x00000001u,
+  HB_FACE_PREWARM_METRICS	= 0x00000002u,
+  HB_FACE_PREWARM_OUTLINES	= 0x00000004u,
+  HB_FACE_PREWARM_LAYOUT	= 0x00000008u,
+  HB_FACE_PREWARM_NAMES		= 0x00000010u,
+  HB_FACE_PREWARM_COLOR		= 0x00000020u,
+  HB_FACE_PREWARM_ALL		= 0xFFFFFFFFu
+} hb_face_prewarm_flags_t;
+
+HB_EXTERN void
+hb_face_prewarm (hb_face_t               *face,
+		 hb_face_prewarm_flags_t  flags);
+
+HB_EXTERN void
+hb_face_trim (hb_face_t               *face,
+	      hb_face_prewarm_flags_t  flags);
+
+HB_EXTERN void
+hb_face_prefetch_tables (hb_face_t     *face,
+			 const hb_tag_t *tags,
+			 unsigned int    tags_count);
+
+HB_EXTERN void
+hb_face_set_prefetch_on_plan (hb_face_t *face,
+			      hb_bool_t  prefetch);
+
+
 /*
  * Character set.
  */
@@ -130,6 +310,24 @@ HB_EXTERN void
 hb_face_collect_unicodes (hb_face_t *face,
 			  hb_set_t  *out);
 
+HB_EXTERN unsigned int
+hb_face_get_nominal_glyphs_coverage (hb_face_t            *face,
+				     unsigned int          count,
+				     const hb_codepoint_t *unicodes,
+				     uint32_t             *coverage);
+
+HB_EXTERN void
+hb_face_collect_nominal_glyph_mapping (hb_face_t *face,
+				       hb_map_t  *mapping,
+				       hb_set_t  *unicodes);
+
+HB_EXTERN unsigned int
+hb_face_get_glyph_unicodes (hb_face_t      *face,
+			    hb_codepoint_t  glyph,
+			    unsigned int    start_offset,
+			    unsigned int   *unicodes_count, /* IN/OUT */
+			    hb_codepoint_t *unicodes /* OUT */);
+
 HB_EXTERN void
 hb_face_collect_variation_selectors (hb_face_t *face,
 				     hb_set_t  *out);
@@ -152,6 +350,48 @@ hb_face_builder_add_table (hb_face_t *face,
 			   hb_tag_t   tag,
 			   hb_blob_t *blob);
 
+/**
+ * hb_face_builder_chunk_t:
+ * @data: start of the chunk.
+ * @length: length of the chunk, in bytes.
+ *
+ * A contiguous piece of a font file compiled by a builder face.
+ *
+ * Since: REPLACEME
+ */
+typedef struct hb_face_builder_chunk_t
+{
+  const char   *data;
+  unsigned int  length;
+} hb_face_builder_chunk_t;
+
+HB_EXTERN unsigned int
+hb_face_builder_get_chunks (hb_face_t               *face,
+			    unsigned int             start_offset,
+			    unsigned int            *chunk_count, /* IN/OUT */
+			    hb_face_builder_chunk_t *chunks /* OUT */);
+
+/**
+ * hb_face_builder_write_func_t:
+ * @data: bytes to write.
+ * @length: number of bytes to write.
+ * @user_data: user data passed to hb_face_builder_write().
+ *
+ * Callback for hb_face_builder_write().
+ *
+ * Return value: false to stop writing.
+ *
+ * Since: REPLACEME
+ */
+typedef hb_bool_t (*hb_face_builder_write_func_t) (const char   *data,
+						     unsigned int  length,
+						     void         *user_data);
+
+HB_EXTERN hb_bool_t
+hb_face_builder_write (hb_face_t                    *face,
+		       hb_face_builder_write_func_t  write_func,
+		       void                         *user_data);
+
 
 HB_END_DECLS
 
@@ -31,6 +31,7 @@
 
 #include "hb.hh"
 
+#include "hb-cache.hh"
 #include "hb-shaper.hh"
 #include "hb-shape-plan.hh"
 #include "hb-ot-face.hh"
@@ -40,10 +41,90 @@
  * hb_face_t
  */
 
+/* Default number of shape plans cached per face;
+ * see hb_face_set_shape_plan_cache_size(). */
+#ifndef HB_SHAPE_PLAN_CACHE_MAX_PLANS
+#define HB_SHAPE_PLAN_CACHE_MAX_PLANS 64
+#endif
+
+/* Number of variation instances a face keeps around after the last font
+ * using them is destroyed or moves to other coordinates. */
+#ifndef HB_FACE_MAX_IDLE_INSTANCES
+#define HB_FACE_MAX_IDLE_INSTANCES 4
+#endif
+
 #define HB_SHAPER_IMPLEMENT(shaper) HB_SHAPER_DATA_INSTANTIATE_SHAPERS(shaper, face);
 #include "hb-shaper-list.hh"
 #undef HB_SHAPER_IMPLEMENT
 
+namespace OT { struct VariationStore; }
+
+/* Font-wide metrics, in font units, with any MVAR deltas applied; see
+ * hb_ot_font_get_metrics(). */
+struct hb_font_metrics_t
+{
+  enum metric_t
+  {
+    ASCENDER,
+    DESCENDER,
+    LINE_GAP,
+    VERTICAL_ASCENDER,
+    VERTICAL_DESCENDER,
+    VERTICAL_LINE_GAP,
+    X_HEIGHT,
+    CAP_HEIGHT,
+    UNDERLINE_SIZE,
+    UNDERLINE_OFFSET,
+    STRIKEOUT_SIZE,
+    STRIKEOUT_OFFSET,
+    COUNT
+  };
+
+  int values[COUNT];
+};
+
+/* A set of normalized variation coordinates, together with the region
+ * scalars of the face's item variation stores evaluated at them, and the
+ * glyph advances and font-wide metrics found at them.  Shared, through
+ * hb_face_t::instances, by all fonts of a face that are set to the same
+ * coordinates. */
+struct hb_font_instance_t
+{
+  enum store_t { HVAR, VVAR, GDEF, CFF2, STORE_COUNT };
+
+  /* Returns a region scalar cache for var_store, which must be the store
+   * identified by store, fully evaluated at coords; or nullptr if the store
+   * has no regions or on allocation failure.  The cache is never written
+   * to by VariationStore::get_delta(), so it is safe to share. */
+  HB_INTERNAL float *get_scalars (store_t store,
+				  const OT::VariationStore &var_store) const;
+
+  /* Returns the scalars of the regions VarData ivs of the CFF2 store
+   * references, in order, evaluated at coords; or nullptr if it has
+   * none or on allocation failure. */
+  HB_INTERNAL const float *get_cff2_scalars (const OT::VariationStore &var_store,
+					     unsigned int ivs) const;
+
+  /* Returns the cache of horizontal or vertical glyph advances, in font
+   * units, at coords; or nullptr on allocation failure. */
+  HB_INTERNAL hb_advance_cache_t *get_advance_cache (bool vertical) const;
+
+  struct ivs_scalars_t
+  {
+    unsigned int count;
+    hb_atomic_ptr_t<float> scalars[VAR];
+  };
+
+  hb_font_instance_t *next;	/* Next in the face's list, most-recently-used first. */
+  unsigned int ref_count;	/* Protected by the face's instance lock. */
+  unsigned int num_coords;
+  int *coords;
+  mutable hb_atomic_ptr_t<float> scalars[STORE_COUNT];
+  mutable hb_atomic_ptr_t<ivs_scalars_t> cff2_ivs_scalars;
+  mutable hb_atomic_ptr_t<hb_advance_cache_t> advances[2];
+  mutable hb_atomic_ptr_t<hb_font_metrics_t> metrics; /* Filled in by hb-ot-font. */
+};
+
 struct hb_face_t
 {
   hb_object_header_t header;
@@ -58,14 +139,105 @@ struct hb_face_t
 
   hb_shaper_object_dataset_t<hb_face_t> data;/* Various shaper data. */
   hb_ot_face_t table;			/* All the face's tables. */
+  hb_atomic_ptr_t<hb_blob_t> accelerators; /* See hb_face_attach_accelerators(). */
+
+  hb_sanitize_cache_t *sanitize_cache;	/* See hb_face_set_sanitize_cache(). */
+  unsigned int sanitize_max_ops_factor;	/* Zero for the default. */
+  mutable hb_atomic_int_t sanitize_ops;	/* Spent sanitizing tables so far. */
+  mutable hb_atomic_int_t plan_blob_hash; /* See hb-shape-plan.cc; zero until computed. */
+  bool prefetch_on_plan;		/* See hb_face_set_prefetch_on_plan(). */
+  hb_face_collection_t *collection;	/* Made by hb_face_collection_create_face(), or nullptr. */
+
+  /* Accelerators detached by hb_face_trim(), and shape plans evicted from
+   * the cache, freed once no call that may be using them is in progress;
+   * see hb_face_use_t. */
+  struct retired_t
+  {
+    retired_t *next;
+    void *p;
+    void (*destroy) (void *p);
+  };
 
   /* Cache */
   struct plan_node_t
   {
+    retired_t retired;			/* Must be first; used once evicted. */
     hb_shape_plan_t *shape_plan;
-    plan_node_t *next;
+    unsigned int hash;
+    plan_node_t *next;			/* Next in hash bucket. */
+    plan_node_t *lru_prev, *lru_next;	/* Most-recently-used first. */
   };
-  hb_atomic_ptr_t<plan_node_t> shape_plans;
+  struct plan_cache_t
+  {
+    enum { BUCKETS = 32 };
+
+    void init (hb_face_t *face_)
+    {
+      face = face_;
+      lock.init ();
+      memset (buckets, 0, sizeof (buckets));
+      mru = lru = nullptr;
+      count = 0;
+      max_count = HB_SHAPE_PLAN_CACHE_MAX_PLANS;
+      hits = misses = 0;
+    }
+    HB_INTERNAL void fini ();
+
+    /* All of these take the lock. */
+    HB_INTERNAL hb_shape_plan_t *find (const hb_shape_plan_key_t *key);
+    /* Same, without taking a reference: the plan stays valid while the
+     * caller holds a hb_face_use_t on the face. */
+    HB_INTERNAL hb_shape_plan_t *find_borrowed (const hb_shape_plan_key_t *key);
+    HB_INTERNAL hb_shape_plan_t *insert (hb_shape_plan_t *shape_plan);
+    HB_INTERNAL void set_max_count (unsigned int max_count_);
+
+    hb_face_t *face;
+    hb_mutex_t lock;
+    plan_node_t *buckets[BUCKETS];
+    plan_node_t *mru, *lru;
+    unsigned int count;
+    unsigned int max_count;
+    unsigned int hits;
+    unsigned int misses;
+
+    private:
+    HB_INTERNAL plan_node_t *lookup (const hb_shape_plan_key_t *key, unsigned int hash);
+    HB_INTERNAL hb_shape_plan_t *touch (const hb_shape_plan_key_t *key);
+    HB_INTERNAL void lru_unlink (plan_node_t *node);
+    HB_INTERNAL void lru_push_front (plan_node_t *node);
+    HB_INTERNAL void evict ();
+  };
+  plan_cache_t shape_plans;
+
+  struct instance_cache_t
+  {
+    void init ()
+    {
+      lock.init ();
+      list = nullptr;
+    }
+    HB_INTERNAL void fini ();
+
+    /* Return an instance for coords, reusing one any font of the face
+     * is already using where possible.  Returns nullptr on allocation
+     * failure.  Must be released with release(). */
+    HB_INTERNAL hb_font_instance_t *acquire (const int *coords, unsigned int num_coords);
+    HB_INTERNAL void release (hb_font_instance_t *instance);
+
+    hb_mutex_t lock;
+    hb_font_instance_t *list;
+
+    private:
+    static void destroy (hb_font_instance_t *instance);
+  };
+  instance_cache_t instances;
+
+  mutable hb_atomic_int_t users;
+  mutable hb_mutex_t retired_lock;
+  mutable hb_atomic_ptr_t<retired_t> retired;
+
+  HB_INTERNAL void retire (retired_t *r);
+  HB_INTERNAL void reclaim () const;
 
   hb_blob_t *reference_table (hb_tag_t tag) const
   {
@@ -99,11 +271,33 @@ struct hb_face_t
     return ret;
   }
 
-  private:
+  /* Not pure, unlike get_upem (); hb_face_prewarm() calls it for its effect. */
   HB_INTERNAL unsigned int load_upem () const;
+  private:
   HB_INTERNAL unsigned int load_num_glyphs () const;
 };
 DECLARE_NULL_INSTANCE (hb_face_t);
 
+/* Held by calls that use accelerators hb_face_trim() may detach, so
+ * that those are not freed from under them.  The table set of the Null
+ * face has no face, hence the nullptr check. */
+struct hb_face_use_t
+{
+  hb_face_use_t (const hb_face_t *face_) :
+    face (!face_ || hb_object_is_inert (face_) ? nullptr : face_)
+  { if (face) face->users.inc (); }
+  ~hb_face_use_t ()
+  {
+    if (face && face->users.dec () == 1 && unlikely (face->retired.get ()))
+      face->reclaim ();
+  }
+
+  private:
+  const hb_face_t *face;
+};
+
+HB_INTERNAL bool
+_hb_face_builder_add_tables_from (hb_face_t *face, hb_face_t *source);
+
 
 #endif /* HB_FACE_HH */
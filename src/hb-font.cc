@@ -51,6 +51,39 @@
  * hb_font_funcs_t
  */
 
+#define HB_FONT_FUNC_INDEX(name) \
+  (offsetof (hb_font_funcs_t::get_t::get_funcs_t, name) / sizeof (((hb_font_funcs_t *) nullptr)->get.array[0]))
+
+/* A sub-font that sets neither the single nor the batch variant of a
+ * callback delegates it to its parent, which may delegate it further.
+ * This finds the first ancestor that does not, so that the call goes there
+ * directly instead of through each font in between; the result is then
+ * rescaled over the whole array, once for each font in between whose
+ * scale differs from its parent's. */
+struct hb_font_delegation_t
+{
+  enum { MAX_DEPTH = 8 };
+
+  hb_font_delegation_t (hb_font_t *font, unsigned int single, unsigned int batch) :
+    length (0)
+  {
+    hb_font_t *f = font;
+    do
+    {
+      chain[length++] = f;
+      f = f->parent;
+    } while (length < MAX_DEPTH && f->parent &&
+	     !f->has_func_set (single) && !f->has_func_set (batch));
+    root = f;
+  }
+
+  hb_font_t *root;
+  /* The font and its ancestors below root; rescale results for them
+   * outermost first, like the nested calls this replaces would. */
+  hb_font_t *chain[MAX_DEPTH];
+  unsigned int length;
+};
+
 static hb_bool_t
 hb_font_get_font_h_extents_nil (hb_font_t *font HB_UNUSED,
 				void *font_data HB_UNUSED,
@@ -120,7 +153,8 @@ hb_font_get_nominal_glyph_default (hb_font_t *font,
   {
     return font->get_nominal_glyphs (1, &unicode, 0, glyph, 0);
   }
-  return font->parent->get_nominal_glyph (unicode, glyph);
+  hb_font_delegation_t d (font, HB_FONT_FUNC_INDEX (nominal_glyph), HB_FONT_FUNC_INDEX (nominal_glyphs));
+  return d.root->get_nominal_glyph (unicode, glyph);
 }
 
 #define hb_font_get_nominal_glyphs_nil hb_font_get_nominal_glyphs_default
@@ -147,9 +181,10 @@ hb_font_get_nominal_glyphs_default (hb_font_t *font,
     return count;
   }
 
-  return font->parent->get_nominal_glyphs (count,
-					   first_unicode, unicode_stride,
-					   first_glyph, glyph_stride);
+  hb_font_delegation_t d (font, HB_FONT_FUNC_INDEX (nominal_glyph), HB_FONT_FUNC_INDEX (nominal_glyphs));
+  return d.root->get_nominal_glyphs (count,
+				     first_unicode, unicode_stride,
+				     first_glyph, glyph_stride);
 }
 
 static hb_bool_t
@@ -195,7 +230,11 @@ hb_font_get_glyph_h_advance_default (hb_font_t *font,
     font->get_glyph_h_advances (1, &glyph, 0, &ret, 0);
     return ret;
   }
-  return font->parent_scale_x_distance (font->parent->get_glyph_h_advance (glyph));
+  hb_font_delegation_t d (font, HB_FONT_FUNC_INDEX (glyph_h_advance), HB_FONT_FUNC_INDEX (glyph_h_advances));
+  hb_position_t ret = d.root->get_glyph_h_advance (glyph);
+  for (unsigned int l = d.length; l--;)
+    ret = d.chain[l]->parent_scale_x_distance (ret);
+  return ret;
 }
 
 static hb_position_t
@@ -219,7 +258,11 @@ hb_font_get_glyph_v_advance_default (hb_font_t *font,
     font->get_glyph_v_advances (1, &glyph, 0, &ret, 0);
     return ret;
   }
-  return font->parent_scale_y_distance (font->parent->get_glyph_v_advance (glyph));
+  hb_font_delegation_t d (font, HB_FONT_FUNC_INDEX (glyph_v_advance), HB_FONT_FUNC_INDEX (glyph_v_advances));
+  hb_position_t ret = d.root->get_glyph_v_advance (glyph);
+  for (unsigned int l = d.length; l--;)
+    ret = d.chain[l]->parent_scale_y_distance (ret);
+  return ret;
 }
 
 #define hb_font_get_glyph_h_advances_nil hb_font_get_glyph_h_advances_default
@@ -244,13 +287,21 @@ hb_font_get_glyph_h_advances_default (hb_font_t* font,
     return;
   }
 
-  font->parent->get_glyph_h_advances (count,
-				      first_glyph, glyph_stride,
-				      first_advance, advance_stride);
-  for (unsigned int i = 0; i < count; i++)
+  hb_font_delegation_t d (font, HB_FONT_FUNC_INDEX (glyph_h_advance), HB_FONT_FUNC_INDEX (glyph_h_advances));
+  d.root->get_glyph_h_advances (count,
+				   first_glyph, glyph_stride,
+				   first_advance, advance_stride);
+  for (unsigned int l = d.length; l--;)
   {
-    *first_advance = font->parent_scale_x_distance (*first_advance);
-    first_advance = &StructAtOffset<hb_position_t> (first_advance, advance_stride);
+    hb_font_t *f = d.chain[l];
+    if (f->x_scale == f->parent->x_scale)
+      continue;
+    hb_position_t *advance = first_advance;
+    for (unsigned int i = 0; i < count; i++)
+    {
+      *advance = f->parent_scale_x_distance (*advance);
+      advance = &StructAtOffset<hb_position_t> (advance, advance_stride);
+    }
   }
 }
 
@@ -276,13 +327,21 @@ hb_font_get_glyph_v_advances_default (hb_font_t* font,
     return;
   }
 
-  font->parent->get_glyph_v_advances (count,
-				      first_glyph, glyph_stride,
-				      first_advance, advance_stride);
-  for (unsigned int i = 0; i < count; i++)
+  hb_font_delegation_t d (font, HB_FONT_FUNC_INDEX (glyph_v_advance), HB_FONT_FUNC_INDEX (glyph_v_advances));
+  d.root->get_glyph_v_advances (count,
+				   first_glyph, glyph_stride,
+				   first_advance, advance_stride);
+  for (unsigned int l = d.length; l--;)
   {
-    *first_advance = font->parent_scale_y_distance (*first_advance);
-    first_advance = &StructAtOffset<hb_position_t> (first_advance, advance_stride);
+    hb_font_t *f = d.chain[l];
+    if (f->y_scale == f->parent->y_scale)
+      continue;
+    hb_position_t *advance = first_advance;
+    for (unsigned int i = 0; i < count; i++)
+    {
+      *advance = f->parent_scale_y_distance (*advance);
+      advance = &StructAtOffset<hb_position_t> (advance, advance_stride);
+    }
   }
 }
 
@@ -330,12 +389,62 @@ hb_font_get_glyph_v_origin_default (hb_font_t *font,
 				    hb_position_t *y,
 				    void *user_data HB_UNUSED)
 {
+  if (font->has_glyph_v_origins_func_set ())
+    return font->get_glyph_v_origins (1, &glyph, 0, x, 0, y, 0);
   hb_bool_t ret = font->parent->get_glyph_v_origin (glyph, x, y);
   if (ret)
     font->parent_scale_position (x, y);
   return ret;
 }
 
+#define hb_font_get_glyph_v_origins_nil hb_font_get_glyph_v_origins_default
+static hb_bool_t
+hb_font_get_glyph_v_origins_default (hb_font_t *font,
+				     void *font_data HB_UNUSED,
+				     unsigned int count,
+				     const hb_codepoint_t *first_glyph,
+				     unsigned int glyph_stride,
+				     hb_position_t *first_x,
+				     unsigned int x_stride,
+				     hb_position_t *first_y,
+				     unsigned int y_stride,
+				     void *user_data HB_UNUSED)
+{
+  hb_bool_t ret = true;
+  if (font->has_glyph_v_origin_func_set ())
+  {
+    for (unsigned int i = 0; i < count; i++)
+    {
+      ret &= font->get_glyph_v_origin (*first_glyph, first_x, first_y);
+      first_glyph = &StructAtOffset<hb_codepoint_t> (first_glyph, glyph_stride);
+      first_x = &StructAtOffset<hb_position_t> (first_x, x_stride);
+      first_y = &StructAtOffset<hb_position_t> (first_y, y_stride);
+    }
+    return ret;
+  }
+
+  hb_font_delegation_t d (font, HB_FONT_FUNC_INDEX (glyph_v_origin), HB_FONT_FUNC_INDEX (glyph_v_origins));
+  ret = d.root->get_glyph_v_origins (count,
+				     first_glyph, glyph_stride,
+				     first_x, x_stride,
+				     first_y, y_stride);
+  if (ret)
+    for (unsigned int l = d.length; l--;)
+    {
+      hb_font_t *f = d.chain[l];
+      if (f->x_scale == f->parent->x_scale && f->y_scale == f->parent->y_scale)
+	continue;
+      hb_position_t *x = first_x, *y = first_y;
+      for (unsigned int i = 0; i < count; i++)
+      {
+	f->parent_scale_position (x, y);
+	x = &StructAtOffset<hb_position_t> (x, x_stride);
+	y = &StructAtOffset<hb_position_t> (y, y_stride);
+      }
+    }
+  return ret;
+}
+
 static hb_position_t
 hb_font_get_glyph_h_kerning_nil (hb_font_t *font HB_UNUSED,
 				 void *font_data HB_UNUSED,
@@ -391,14 +500,62 @@ hb_font_get_glyph_extents_default (hb_font_t *font,
 				   hb_glyph_extents_t *extents,
 				   void *user_data HB_UNUSED)
 {
-  hb_bool_t ret = font->parent->get_glyph_extents (glyph, extents);
-  if (ret) {
-    font->parent_scale_position (&extents->x_bearing, &extents->y_bearing);
-    font->parent_scale_distance (&extents->width, &extents->height);
-  }
+  if (font->has_glyph_extents_batch_func_set ())
+    return font->get_glyph_extents_batch (1, &glyph, 0, extents, 0);
+  hb_font_delegation_t d (font, HB_FONT_FUNC_INDEX (glyph_extents), HB_FONT_FUNC_INDEX (glyph_extents_batch));
+  hb_bool_t ret = d.root->get_glyph_extents (glyph, extents);
+  if (ret)
+    for (unsigned int l = d.length; l--;)
+    {
+      d.chain[l]->parent_scale_position (&extents->x_bearing, &extents->y_bearing);
+      d.chain[l]->parent_scale_distance (&extents->width, &extents->height);
+    }
   return ret;
 }
 
+#define hb_font_get_glyph_extents_batch_nil hb_font_get_glyph_extents_batch_default
+static unsigned int
+hb_font_get_glyph_extents_batch_default (hb_font_t *font,
+					 void *font_data HB_UNUSED,
+					 unsigned int count,
+					 const hb_codepoint_t *first_glyph,
+					 unsigned int glyph_stride,
+					 hb_glyph_extents_t *first_extents,
+					 unsigned int extents_stride,
+					 void *user_data HB_UNUSED)
+{
+  unsigned int found = 0;
+  if (font->has_glyph_extents_func_set ())
+  {
+    for (unsigned int i = 0; i < count; i++)
+    {
+      found += font->get_glyph_extents (*first_glyph, first_extents);
+      first_glyph = &StructAtOffset<hb_codepoint_t> (first_glyph, glyph_stride);
+      first_extents = &StructAtOffset<hb_glyph_extents_t> (first_extents, extents_stride);
+    }
+    return found;
+  }
+
+  hb_font_delegation_t d (font, HB_FONT_FUNC_INDEX (glyph_extents), HB_FONT_FUNC_INDEX (glyph_extents_batch));
+  found = d.root->get_glyph_extents_batch (count,
+					   first_glyph, glyph_stride,
+					   first_extents, extents_stride);
+  for (unsigned int l = d.length; l--;)
+  {
+    hb_font_t *f = d.chain[l];
+    if (f->x_scale == f->parent->x_scale && f->y_scale == f->parent->y_scale)
+      continue;
+    hb_glyph_extents_t *extents = first_extents;
+    for (unsigned int i = 0; i < count; i++)
+    {
+      f->parent_scale_position (&extents->x_bearing, &extents->y_bearing);
+      f->parent_scale_distance (&extents->width, &extents->height);
+      extents = &StructAtOffset<hb_glyph_extents_t> (extents, extents_stride);
+    }
+  }
+  return found;
+}
+
 static hb_bool_t
 hb_font_get_glyph_contour_point_nil (hb_font_t *font HB_UNUSED,
 				     void *font_data HB_UNUSED,
@@ -925,6 +1082,40 @@ hb_font_get_glyph_v_origin (hb_font_t *font,
   return font->get_glyph_v_origin (glyph, x, y);
 }
 
+/**
+ * hb_font_get_glyph_v_origins:
+ * @font: a font.
+ * @count: number of glyphs.
+ * @first_glyph: the first glyph to fetch the origin of.
+ * @glyph_stride: distance in bytes between consecutive glyphs.
+ * @first_x: (out): where to store the first glyph's origin X.
+ * @x_stride: distance in bytes between consecutive X values.
+ * @first_y: (out): where to store the first glyph's origin Y.
+ * @y_stride: distance in bytes between consecutive Y values.
+ *
+ * Fetches the vertical origins of @count glyphs in one call, as
+ * hb_font_get_glyph_v_origin() would for each.
+ *
+ * Return value: true if the origins of all glyphs were found.
+ *
+ * Since: REPLACEME
+ **/
+hb_bool_t
+hb_font_get_glyph_v_origins (hb_font_t *font,
+			     unsigned int count,
+			     const hb_codepoint_t *first_glyph,
+			     unsigned int glyph_stride,
+			     hb_position_t *first_x,
+			     unsigned int x_stride,
+			     hb_position_t *first_y,
+			     unsigned int y_stride)
+{
+  return font->get_glyph_v_origins (count,
+				    first_glyph, glyph_stride,
+				    first_x, x_stride,
+				    first_y, y_stride);
+}
+
 /**
  * hb_font_get_glyph_h_kerning:
  * @font: a font.
@@ -985,6 +1176,35 @@ hb_font_get_glyph_extents (hb_font_t *font,
   return font->get_glyph_extents (glyph, extents);
 }
 
+/**
+ * hb_font_get_glyph_extents_batch:
+ * @font: a font.
+ * @count: number of glyphs.
+ * @first_glyph: the first glyph to fetch extents for.
+ * @glyph_stride: distance in bytes between consecutive glyphs.
+ * @first_extents: (out): where to store the first glyph's extents.
+ * @extents_stride: distance in bytes between consecutive extents.
+ *
+ * Fetches the extents of @count glyphs in one call.  Extents of glyphs
+ * that have none are set to zero.
+ *
+ * Return value: number of glyphs whose extents were found.
+ *
+ * Since: REPLACEME
+ **/
+unsigned int
+hb_font_get_glyph_extents_batch (hb_font_t *font,
+				 unsigned int count,
+				 const hb_codepoint_t *first_glyph,
+				 unsigned int glyph_stride,
+				 hb_glyph_extents_t *first_extents,
+				 unsigned int extents_stride)
+{
+  return font->get_glyph_extents_batch (count,
+					first_glyph, glyph_stride,
+					first_extents, extents_stride);
+}
+
 /**
  * hb_font_get_glyph_contour_point:
  * @font: a font.
@@ -1305,6 +1525,10 @@ DEFINE_NULL_INSTANCE (hb_font_t) =
 
   0, /* num_coords */
   nullptr, /* coords */
+  0, /* serial_coords */
+  nullptr, /* instance */
+  HB_ATOMIC_INT_INIT (0), /* variations_serial */
+  {HB_ATOMIC_INT_INIT (0), HB_ATOMIC_INT_INIT (0)}, /* variations_index */
 
   const_cast<hb_font_funcs_t *> (&_hb_Null_hb_font_funcs_t),
 
@@ -1328,6 +1552,7 @@ _hb_font_create (hb_face_t *face)
   font->klass = hb_font_funcs_get_empty ();
   font->data.init0 (font);
   font->x_scale = font->y_scale = hb_face_get_upem (face);
+  font->mults_changed ();
 
   return font;
 }
@@ -1381,6 +1606,7 @@ hb_font_create_sub_font (hb_font_t *parent)
   font->x_ppem = parent->x_ppem;
   font->y_ppem = parent->y_ppem;
   font->ptem = parent->ptem;
+  font->mults_changed ();
 
   font->num_coords = parent->num_coords;
   if (!font->num_coords)
@@ -1394,10 +1620,83 @@ hb_font_create_sub_font (hb_font_t *parent)
     else
       memcpy (font->coords, parent->coords, size);
   }
+  font->update_instance ();
 
   return font;
 }
 
+/**
+ * hb_font_create_snapshot:
+ * @font: a font.
+ *
+ * Creates an immutable copy of @font, as it is now: same face, font
+ * functions, scale, ppem, point size and variation coordinates, with an
+ * immutable copy of its parent.  Unlike @font itself, which may be changed
+ * at any time, the copy can be used from any number of threads at once
+ * without locking.  It shares with @font, and with all other fonts of the
+ * face at the same variation coordinates, the data cached for those, such
+ * as evaluated variation regions and glyph advances.
+ *
+ * If @font is immutable already, it is returned itself; so snapshotting a
+ * snapshot, for example once per thread, costs nothing.
+ *
+ * With the built-in OpenType font functions, the copy gets font data of
+ * its own.  Other font functions are called with the data of @font, and
+ * must then be safe to call from multiple threads; @font is kept alive
+ * while the copy is, and font data it is given later does not affect the
+ * copy.
+ *
+ * Return value: (transfer full): an immutable font like @font.
+ *
+ * Since: REPLACEME
+ **/
+hb_font_t *
+hb_font_create_snapshot (hb_font_t *font)
+{
+  if (unlikely (!font))
+    font = hb_font_get_empty ();
+  if (hb_object_is_immutable (font))
+    return hb_font_reference (font);
+
+  hb_font_t *snapshot = _hb_font_create (font->face);
+  if (unlikely (hb_object_is_immutable (snapshot)))
+    return snapshot;
+
+  hb_font_destroy (snapshot->parent);
+  snapshot->parent = hb_font_create_snapshot (font->parent);
+
+  snapshot->x_scale = font->x_scale;
+  snapshot->y_scale = font->y_scale;
+  snapshot->x_ppem = font->x_ppem;
+  snapshot->y_ppem = font->y_ppem;
+  snapshot->ptem = font->ptem;
+  snapshot->mults_changed ();
+
+  if (font->num_coords)
+  {
+    unsigned int size = font->num_coords * sizeof (font->coords[0]);
+    snapshot->coords = (int *) malloc (size);
+    if (unlikely (!snapshot->coords))
+    {
+      hb_font_destroy (snapshot);
+      return hb_font_get_empty ();
+    }
+    memcpy (snapshot->coords, font->coords, size);
+    snapshot->num_coords = font->num_coords;
+  }
+  snapshot->update_instance ();
+
+  if (!_hb_ot_font_set_funcs_like (snapshot, font))
+  {
+    hb_font_set_funcs (snapshot, font->klass, font->user_data, nullptr);
+    snapshot->funcs_source = hb_font_reference (font);
+    font->funcs_shared = true;
+  }
+
+  hb_font_make_immutable (snapshot);
+  return snapshot;
+}
+
 /**
  * hb_font_get_empty:
  *
@@ -1446,6 +1745,17 @@ hb_font_destroy (hb_font_t *font)
 
   if (font->destroy)
     font->destroy (font->user_data);
+  while (font->retired_funcs_data)
+  {
+    hb_font_t::retired_funcs_data_t *next = font->retired_funcs_data->next;
+    font->retired_funcs_data->destroy (font->retired_funcs_data->user_data);
+    free (font->retired_funcs_data);
+    font->retired_funcs_data = next;
+  }
+  hb_font_destroy (font->funcs_source);
+
+  font->release_instance ();
+  _hb_ot_layout_lig_caret_cache_destroy (font->lig_carets.get ());
 
   hb_font_destroy (font->parent);
   hb_face_destroy (font->face);
@@ -1597,7 +1907,12 @@ hb_font_set_face (hb_font_t *font,
 
   hb_face_t *old = font->face;
 
+  font->release_instance ();
   font->face = hb_face_reference (face);
+  font->reset_tracking_cache ();
+  font->update_instance ();
+  font->mults_changed ();
+  font->variations_serial.set (0); /* Feature variations are per face. */
 
   hb_face_destroy (old);
 }
@@ -1619,6 +1934,32 @@ hb_font_get_face (hb_font_t *font)
 }
 
 
+/* Snapshots may still be using the data; see hb_font_create_snapshot(). */
+static void
+_hb_font_release_funcs_data (hb_font_t *font)
+{
+  if (!font->destroy)
+    return;
+
+  if (font->funcs_shared)
+  {
+    hb_font_t::retired_funcs_data_t *retired = (hb_font_t::retired_funcs_data_t *)
+      malloc (sizeof (hb_font_t::retired_funcs_data_t));
+    /* On allocation failure leak it, rather than free it from under them. */
+    if (likely (retired))
+    {
+      retired->next = font->retired_funcs_data;
+      retired->user_data = font->user_data;
+      retired->destroy = font->destroy;
+      font->retired_funcs_data = retired;
+    }
+    font->funcs_shared = false;
+    return;
+  }
+
+  font->destroy (font->user_data);
+}
+
 /**
  * hb_font_set_funcs:
  * @font: a font.
@@ -1643,8 +1984,7 @@ hb_font_set_funcs (hb_font_t         *font,
     return;
   }
 
-  if (font->destroy)
-    font->destroy (font->user_data);
+  _hb_font_release_funcs_data (font);
 
   if (!klass)
     klass = hb_font_funcs_get_empty ();
@@ -1679,8 +2019,7 @@ hb_font_set_funcs_data (hb_font_t         *font,
     return;
   }
 
-  if (font->destroy)
-    font->destroy (font->user_data);
+  _hb_font_release_funcs_data (font);
 
   font->user_data = font_data;
   font->destroy = destroy;
@@ -1707,6 +2046,7 @@ hb_font_set_scale (hb_font_t *font,
 
   font->x_scale = x_scale;
   font->y_scale = y_scale;
+  font->mults_changed ();
 }
 
 /**
@@ -1787,6 +2127,7 @@ hb_font_set_ptem (hb_font_t *font, float ptem)
     return;
 
   font->ptem = ptem;
+  font->reset_tracking_cache ();
 }
 
 /**
@@ -1818,6 +2159,16 @@ _hb_font_adopt_var_coords_normalized (hb_font_t *font,
 
   font->coords = coords;
   font->num_coords = coords_length;
+  font->serial_coords++;
+  font->update_instance ();
+}
+
+void
+hb_font_t::update_instance ()
+{
+  release_instance ();
+  if (num_coords && !hb_object_is_inert (face))
+    instance = face->instances.acquire (coords, num_coords);
 }
 
 /**
@@ -1914,6 +2265,31 @@ hb_font_get_var_coords_normalized (hb_font_t *font,
 }
 
 
+/**
+ * hb_font_get_memory_usage:
+ * @font: a font.
+ *
+ * Retrieves how much heap memory @font holds: the font object, its
+ * variation coordinates, and the caches of the OpenType font functions if
+ * @font uses them.  The face and parent font are not included; see
+ * hb_face_get_memory_usage() for the former.
+ *
+ * Return value: heap memory held by @font, in bytes.
+ *
+ * Since: REPLACEME
+ **/
+unsigned int
+hb_font_get_memory_usage (hb_font_t *font)
+{
+  if (unlikely (hb_object_is_inert (font)))
+    return 0;
+
+  return sizeof (*font) +
+	 font->num_coords * sizeof (font->coords[0]) +
+	 _hb_ot_font_get_memory_usage (font);
+}
+
+
 /*
  * Deprecated get_glyph_func():
  */
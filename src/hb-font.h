@@ -156,12 +156,29 @@ typedef hb_bool_t (*hb_font_get_glyph_origin_func_t) (hb_font_t *font, void *fon
 						      void *user_data);
 typedef hb_font_get_glyph_origin_func_t hb_font_get_glyph_h_origin_func_t;
 typedef hb_font_get_glyph_origin_func_t hb_font_get_glyph_v_origin_func_t;
+typedef hb_bool_t (*hb_font_get_glyph_origins_func_t) (hb_font_t *font, void *font_data,
+						       unsigned int count,
+						       const hb_codepoint_t *first_glyph,
+						       unsigned int glyph_stride,
+						       hb_position_t *first_x,
+						       unsigned int x_stride,
+						       hb_position_t *first_y,
+						       unsigned int y_stride,
+						       void *user_data);
+typedef hb_font_get_glyph_origins_func_t hb_font_get_glyph_v_origins_func_t;
 
 
 typedef hb_bool_t (*hb_font_get_glyph_extents_func_t) (hb_font_t *font, void *font_data,
 						       hb_codepoint_t glyph,
 						       hb_glyph_extents_t *extents,
 						       void *user_data);
+typedef unsigned int (*hb_font_get_glyph_extents_batch_func_t) (hb_font_t *font, void *font_data,
+								unsigned int count,
+								const hb_codepoint_t *first_glyph,
+								unsigned int glyph_stride,
+								hb_glyph_extents_t *first_extents,
+								unsigned int extents_stride,
+								void *user_data);
 typedef hb_bool_t (*hb_font_get_glyph_contour_point_func_t) (hb_font_t *font, void *font_data,
 							     hb_codepoint_t glyph, unsigned int point_index,
 							     hb_position_t *x, hb_position_t *y,
@@ -356,6 +373,22 @@ hb_font_funcs_set_glyph_v_origin_func (hb_font_funcs_t *ffuncs,
 				       hb_font_get_glyph_v_origin_func_t func,
 				       void *user_data, hb_destroy_func_t destroy);
 
+/**
+ * hb_font_funcs_set_glyph_v_origins_func:
+ * @ffuncs: font functions.
+ * @func: (closure user_data) (destroy destroy) (scope notified):
+ * @user_data:
+ * @destroy:
+ *
+ * 
+ *
+ * Since: REPLACEME
+ **/
+HB_EXTERN void
+hb_font_funcs_set_glyph_v_origins_func (hb_font_funcs_t *ffuncs,
+					hb_font_get_glyph_v_origins_func_t func,
+					void *user_data, hb_destroy_func_t destroy);
+
 /**
  * hb_font_funcs_set_glyph_extents_func:
  * @ffuncs: font functions.
@@ -372,6 +405,22 @@ hb_font_funcs_set_glyph_extents_func (hb_font_funcs_t *ffuncs,
 				      hb_font_get_glyph_extents_func_t func,
 				      void *user_data, hb_destroy_func_t destroy);
 
+/**
+ * hb_font_funcs_set_glyph_extents_batch_func:
+ * @ffuncs: font functions.
+ * @func: (closure user_data) (destroy destroy) (scope notified):
+ * @user_data:
+ * @destroy:
+ *
+ * 
+ *
+ * Since: REPLACEME
+ **/
+HB_EXTERN void
+hb_font_funcs_set_glyph_extents_batch_func (hb_font_funcs_t *ffuncs,
+					    hb_font_get_glyph_extents_batch_func_t func,
+					    void *user_data, hb_destroy_func_t destroy);
+
 /**
  * hb_font_funcs_set_glyph_contour_point_func:
  * @ffuncs: font functions.
@@ -468,12 +517,29 @@ HB_EXTERN hb_bool_t
 hb_font_get_glyph_v_origin (hb_font_t *font,
 			    hb_codepoint_t glyph,
 			    hb_position_t *x, hb_position_t *y);
+HB_EXTERN hb_bool_t
+hb_font_get_glyph_v_origins (hb_font_t *font,
+			     unsigned int count,
+			     const hb_codepoint_t *first_glyph,
+			     unsigned int glyph_stride,
+			     hb_position_t *first_x,
+			     unsigned int x_stride,
+			     hb_position_t *first_y,
+			     unsigned int y_stride);
 
 HB_EXTERN hb_bool_t
 hb_font_get_glyph_extents (hb_font_t *font,
 			   hb_codepoint_t glyph,
 			   hb_glyph_extents_t *extents);
 
+HB_EXTERN unsigned int
+hb_font_get_glyph_extents_batch (hb_font_t *font,
+				 unsigned int count,
+				 const hb_codepoint_t *first_glyph,
+				 unsigned int glyph_stride,
+				 hb_glyph_extents_t *first_extents,
+				 unsigned int extents_stride);
+
 HB_EXTERN hb_bool_t
 hb_font_get_glyph_contour_point (hb_font_t *font,
 				 hb_codepoint_t glyph, unsigned int point_index,
@@ -567,6 +633,9 @@ hb_font_create (hb_face_t *face);
 HB_EXTERN hb_font_t *
 hb_font_create_sub_font (hb_font_t *parent);
 
+HB_EXTERN hb_font_t *
+hb_font_create_snapshot (hb_font_t *font);
+
 HB_EXTERN hb_font_t *
 hb_font_get_empty (void);
 
@@ -674,6 +743,9 @@ HB_EXTERN const int *
 hb_font_get_var_coords_normalized (hb_font_t *font,
 				   unsigned int *length);
 
+HB_EXTERN unsigned int
+hb_font_get_memory_usage (hb_font_t *font);
+
 HB_END_DECLS
 
 #endif /* HB_FONT_H */
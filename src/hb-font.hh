@@ -51,9 +51,11 @@
   HB_FONT_FUNC_IMPLEMENT (glyph_v_advances) \
   HB_FONT_FUNC_IMPLEMENT (glyph_h_origin) \
   HB_FONT_FUNC_IMPLEMENT (glyph_v_origin) \
+  HB_FONT_FUNC_IMPLEMENT (glyph_v_origins) \
   HB_FONT_FUNC_IMPLEMENT (glyph_h_kerning) \
   HB_FONT_FUNC_IMPLEMENT (glyph_v_kerning) \
   HB_FONT_FUNC_IMPLEMENT (glyph_extents) \
+  HB_FONT_FUNC_IMPLEMENT (glyph_extents_batch) \
   HB_FONT_FUNC_IMPLEMENT (glyph_contour_point) \
   HB_FONT_FUNC_IMPLEMENT (glyph_name) \
   HB_FONT_FUNC_IMPLEMENT (glyph_from_name) \
@@ -100,6 +102,9 @@ DECLARE_NULL_INSTANCE (hb_font_funcs_t);
 #include "hb-shaper-list.hh"
 #undef HB_SHAPER_IMPLEMENT
 
+struct hb_ot_lig_caret_cache_t;
+HB_INTERNAL void _hb_ot_layout_lig_caret_cache_destroy (hb_ot_lig_caret_cache_t *cache);
+
 struct hb_font_t
 {
   hb_object_header_t header;
@@ -118,25 +123,167 @@ struct hb_font_t
   /* Font variation coordinates. */
   unsigned int num_coords;
   int *coords;
+  unsigned int serial_coords; /* Bumped every time coords change. */
+  hb_font_instance_t *instance; /* Shared with other fonts of face at coords. */
+  /* The GSUB/GPOS feature variations coords select, valid if
+   * variations_serial is serial_coords + 1; see _hb_shape_plan_get_cached(). */
+  mutable hb_atomic_int_t variations_serial;
+  mutable hb_atomic_int_t variations_index[2];
 
   hb_font_funcs_t   *klass;
   void              *user_data;
   hb_destroy_func_t  destroy;
 
+  /* Snapshots of fonts with other than our own funcs share their data;
+   * see hb_font_create_snapshot().  The font they share it with is kept
+   * alive, and keeps data it replaces until destroyed itself. */
+  struct retired_funcs_data_t
+  {
+    retired_funcs_data_t *next;
+    void *user_data;
+    hb_destroy_func_t destroy;
+  };
+  hb_font_t *funcs_source;		/* In a snapshot. */
+  bool funcs_shared;			/* In the font snapshots share with. */
+  retired_funcs_data_t *retired_funcs_data;
+
+  /* em_scale() by a fixed scale: |scale| / upem split into a whole part
+   * and a remainder, the latter divided through the fixed-point
+   * reciprocal of upem and nudged to the exact quotient.  Rounds exactly
+   * like em_scale().  Zero-initialized (as in the Null font) it defers to
+   * em_scale(); see mults_changed(). */
+  struct em_mult_t
+  {
+    void init (int scale_, unsigned int upem_)
+    {
+      scale = scale_;
+      upem = upem_;
+      negative = scale < 0;
+      if (unlikely (!upem || upem > 0xFFFFu))
+      {
+	recip = 0;
+	return;
+      }
+      unsigned int mag = negative ? 0u - (unsigned int) scale : (unsigned int) scale;
+      whole = mag / upem;
+      rem = mag % upem;
+      recip = ((uint64_t) 1 << 32) / upem;
+    }
+
+    bool is_identity () const { return recip && !rem && whole == 1 && !negative; }
+
+    hb_position_t apply (const hb_font_t *font, int16_t v) const
+    {
+      if (unlikely (!recip))
+	return font->em_scale (v, scale);
+      unsigned int a = v < 0 ? 0u - (unsigned int) v : (unsigned int) v;
+      uint64_t q = (uint64_t) a * whole;
+      if (rem)
+      {
+	/* n < 2^31 as a < 2^16 and rem < upem < 2^16; the estimate is at
+	 * most one short. */
+	uint32_t n = a * rem + upem / 2;
+	uint32_t d = (uint32_t) ((n * recip) >> 32);
+	if (n - d * upem >= upem) d++;
+	q += d;
+      }
+      return (hb_position_t) ((v < 0) != negative ? -(int64_t) q : (int64_t) q);
+    }
+
+    /* Scales count values, each first truncated to int16_t as with
+     * em_scale(), in place. */
+    void apply (const hb_font_t *font,
+		unsigned int count, hb_position_t *first, unsigned int stride) const
+    {
+      if (is_identity ())
+      {
+	for (unsigned int i = 0; i < count; i++)
+	{
+	  *first = (int16_t) *first;
+	  first = &StructAtOffset<hb_position_t> (first, stride);
+	}
+	return;
+      }
+      if (recip && !rem)
+      {
+	int64_t m = negative ? -(int64_t) whole : (int64_t) whole;
+	for (unsigned int i = 0; i < count; i++)
+	{
+	  *first = (hb_position_t) ((int16_t) *first * m);
+	  first = &StructAtOffset<hb_position_t> (first, stride);
+	}
+	return;
+      }
+      for (unsigned int i = 0; i < count; i++)
+      {
+	*first = apply (font, (int16_t) *first);
+	first = &StructAtOffset<hb_position_t> (first, stride);
+      }
+    }
+
+    int scale;
+    unsigned int upem;
+    bool negative;
+    unsigned int whole;
+    unsigned int rem;
+    uint64_t recip;	/* 2^32 / upem, or zero if not set up. */
+  };
+  em_mult_t x_mult;
+  em_mult_t y_mult;
+
   hb_shaper_object_dataset_t<hb_font_t> data; /* Various shaper data. */
 
+  /* AAT tracking at ptem, horizontal and vertical, in font units; stored as
+   * twice the value plus one, zero if not known yet.  See AAT::trak. */
+  hb_atomic_int_t tracking_cache[2];
+
+  /* Ligature carets found so far; see hb_ot_layout_get_ligature_carets(). */
+  mutable hb_atomic_ptr_t<hb_ot_lig_caret_cache_t> lig_carets;
+
+  /* Returns the region scalar cache for var_store at the font's
+   * coordinates, or nullptr; see hb_font_instance_t::get_scalars(). */
+  float *get_var_store_cache (hb_font_instance_t::store_t store,
+			      const OT::VariationStore &var_store) const
+  { return instance ? instance->get_scalars (store, var_store) : nullptr; }
+
+  HB_INTERNAL void update_instance ();
+  void release_instance ()
+  {
+    face->instances.release (instance);
+    instance = nullptr;
+  }
+
+  void reset_tracking_cache ()
+  {
+    tracking_cache[0].set_relaxed (0);
+    tracking_cache[1].set_relaxed (0);
+  }
+
 
   /* Convert from font-space to user-space */
   int dir_scale (hb_direction_t direction)
   { return HB_DIRECTION_IS_VERTICAL(direction) ? y_scale : x_scale; }
-  hb_position_t em_scale_x (int16_t v) { return em_scale (v, x_scale); }
-  hb_position_t em_scale_y (int16_t v) { return em_scale (v, y_scale); }
+  hb_position_t em_scale_x (int16_t v) { return x_mult.apply (this, v); }
+  hb_position_t em_scale_y (int16_t v) { return y_mult.apply (this, v); }
+  /* In place, for values in font units, as with em_scale_x(). */
+  void em_scale_x (unsigned int count, hb_position_t *first, unsigned int stride)
+  { x_mult.apply (this, count, first, stride); }
+  void em_scale_y (unsigned int count, hb_position_t *first, unsigned int stride)
+  { y_mult.apply (this, count, first, stride); }
   hb_position_t em_scalef_x (float v) { return em_scalef (v, this->x_scale); }
   hb_position_t em_scalef_y (float v) { return em_scalef (v, this->y_scale); }
   float em_fscale_x (int16_t v) { return em_fscale (v, x_scale); }
   float em_fscale_y (int16_t v) { return em_fscale (v, y_scale); }
   hb_position_t em_scale_dir (int16_t v, hb_direction_t direction)
-  { return em_scale (v, dir_scale (direction)); }
+  { return HB_DIRECTION_IS_VERTICAL(direction) ? em_scale_y (v) : em_scale_x (v); }
+
+  /* Must be called whenever the scale or face changes. */
+  void mults_changed ()
+  {
+    unsigned int upem = face->get_upem ();
+    x_mult.init (x_scale, upem);
+    y_mult.init (y_scale, upem);
+  }
 
   /* Convert from parent-font user-space to our user-space */
   hb_position_t parent_scale_x_distance (hb_position_t v)
@@ -300,6 +447,28 @@ struct hb_font_t
 					glyph, x, y,
 					klass->user_data.glyph_v_origin);
   }
+  hb_bool_t get_glyph_v_origins (unsigned int count,
+				 const hb_codepoint_t *first_glyph,
+				 unsigned int glyph_stride,
+				 hb_position_t *first_x,
+				 unsigned int x_stride,
+				 hb_position_t *first_y,
+				 unsigned int y_stride)
+  {
+    hb_position_t *x = first_x, *y = first_y;
+    for (unsigned int i = 0; i < count; i++)
+    {
+      *x = *y = 0;
+      x = &StructAtOffset<hb_position_t> (x, x_stride);
+      y = &StructAtOffset<hb_position_t> (y, y_stride);
+    }
+    return klass->get.f.glyph_v_origins (this, user_data,
+					 count,
+					 first_glyph, glyph_stride,
+					 first_x, x_stride,
+					 first_y, y_stride,
+					 klass->user_data.glyph_v_origins);
+  }
 
   hb_position_t get_glyph_h_kerning (hb_codepoint_t left_glyph,
 				     hb_codepoint_t right_glyph)
@@ -326,6 +495,24 @@ struct hb_font_t
 				       extents,
 				       klass->user_data.glyph_extents);
   }
+  unsigned int get_glyph_extents_batch (unsigned int count,
+					const hb_codepoint_t *first_glyph,
+					unsigned int glyph_stride,
+					hb_glyph_extents_t *first_extents,
+					unsigned int extents_stride)
+  {
+    hb_glyph_extents_t *extents = first_extents;
+    for (unsigned int i = 0; i < count; i++)
+    {
+      memset (extents, 0, sizeof (*extents));
+      extents = &StructAtOffset<hb_glyph_extents_t> (extents, extents_stride);
+    }
+    return klass->get.f.glyph_extents_batch (this, user_data,
+					     count,
+					     first_glyph, glyph_stride,
+					     first_extents, extents_stride,
+					     klass->user_data.glyph_extents_batch);
+  }
 
   hb_bool_t get_glyph_contour_point (hb_codepoint_t glyph, unsigned int point_index,
 					    hb_position_t *x, hb_position_t *y)
@@ -446,6 +633,30 @@ struct hb_font_t
     }
   }
 
+  /* Like get_glyph_v_origin_with_fallback(), for count glyphs; the
+   * fallback is only worked out, per glyph, if the batch call fails. */
+  void get_glyph_v_origins_with_fallback (unsigned int count,
+					  const hb_codepoint_t *first_glyph,
+					  unsigned int glyph_stride,
+					  hb_position_t *first_x,
+					  unsigned int x_stride,
+					  hb_position_t *first_y,
+					  unsigned int y_stride)
+  {
+    if (get_glyph_v_origins (count,
+			     first_glyph, glyph_stride,
+			     first_x, x_stride,
+			     first_y, y_stride))
+      return;
+    for (unsigned int i = 0; i < count; i++)
+    {
+      get_glyph_v_origin_with_fallback (*first_glyph, first_x, first_y);
+      first_glyph = &StructAtOffset<const hb_codepoint_t> (first_glyph, glyph_stride);
+      first_x = &StructAtOffset<hb_position_t> (first_x, x_stride);
+      first_y = &StructAtOffset<hb_position_t> (first_y, y_stride);
+    }
+  }
+
   void get_glyph_origin_for_direction (hb_codepoint_t glyph,
 				       hb_direction_t direction,
 				       hb_position_t *x, hb_position_t *y)
@@ -599,7 +810,7 @@ struct hb_font_t
     return false;
   }
 
-  hb_position_t em_scale (int16_t v, int scale)
+  hb_position_t em_scale (int16_t v, int scale) const
   {
     int upem = face->get_upem ();
     int64_t scaled = v * (int64_t) scale;
@@ -613,5 +824,15 @@ struct hb_font_t
 };
 DECLARE_NULL_INSTANCE (hb_font_t);
 
+/* Heap memory held by the font data of a font using the OpenType font
+ * functions, or zero for other fonts. */
+HB_INTERNAL unsigned int
+_hb_ot_font_get_memory_usage (const hb_font_t *font);
+
+/* Sets font to use the OpenType font functions, configured as in other,
+ * if other uses them; returns false otherwise. */
+HB_INTERNAL bool
+_hb_ot_font_set_funcs_like (hb_font_t *font, const hb_font_t *other);
+
 
 #endif /* HB_FONT_HH */
@@ -34,6 +34,9 @@
 #include "hb-font.hh"
 #include "hb-machinery.hh"
 #include "hb-cache.hh"
+#include "hb-ot-face.hh"
+#include "hb-ot-cmap-table.hh"
+#include "hb-ot-hmtx-table.hh"
 
 #include FT_ADVANCES_H
 #include FT_MULTIPLE_MASTERS_H
@@ -69,6 +72,12 @@
  */
 
 
+/* Longest run of consecutive glyph ids whose advances are fetched with
+ * one FT_Get_Advances() call. */
+#ifndef HB_FT_ADVANCES_RUN_MAX
+#define HB_FT_ADVANCES_RUN_MAX 32
+#endif
+
 struct hb_ft_font_t
 {
   mutable hb_mutex_t lock;
@@ -76,9 +85,19 @@ struct hb_ft_font_t
   int load_flags;
   bool symbol; /* Whether selected cmap is symbol cmap. */
   bool unref; /* Whether to destroy ft_face when done. */
+  bool ot_metrics; /* Whether to read cmap and unhinted advances from OT tables. */
 
   mutable hb_atomic_int_t cached_x_scale;
   mutable hb_advance_cache_t advance_cache;
+
+  /* Only used with ot_metrics. */
+  mutable hb_cmap_cache_t cmap_cache;
+
+  /* These read the hb_face_t's own cmap, hmtx and vmtx accelerators, which
+   * are safe to use from multiple threads, so don't need the lock.  Hinted
+   * advances can only come from FreeType. */
+  bool use_ot_cmap () const { return ot_metrics; }
+  bool use_ot_advances () const { return ot_metrics && (load_flags & FT_LOAD_NO_HINTING); }
 };
 
 static hb_ft_font_t *
@@ -98,6 +117,7 @@ _hb_ft_font_create (FT_Face ft_face, bool symbol, bool unref)
 
   ft_font->cached_x_scale.set (0);
   ft_font->advance_cache.init ();
+  ft_font->cmap_cache.init ();
 
   return ft_font;
 }
@@ -114,6 +134,7 @@ _hb_ft_font_destroy (void *data)
   hb_ft_font_t *ft_font = (hb_ft_font_t *) data;
 
   ft_font->advance_cache.fini ();
+  ft_font->cmap_cache.fini ();
 
   if (ft_font->unref)
     _hb_ft_face_destroy (ft_font->ft_face);
@@ -166,6 +187,74 @@ hb_ft_font_get_load_flags (hb_font_t *font)
   return ft_font->load_flags;
 }
 
+/**
+ * hb_ft_font_set_ot_metrics:
+ * @font: #hb_font_t to work upon
+ * @ot_metrics: whether to bypass FreeType for cmap and advance lookups
+ *
+ * Makes @font map characters to glyphs and, as long as its load flags
+ * include FT_LOAD_NO_HINTING, fetch glyph advances from the face's own
+ * cmap, hmtx and vmtx tables instead of calling into FreeType.  These
+ * lookups don't take the lock that serializes access to the FT_Face, so
+ * several threads can shape with one font without contending on it.
+ * Other callbacks, and advances with hinting load flags, still go through
+ * FreeType.
+ *
+ * Advances computed this way can differ from FreeType's by rounding.  Has
+ * no effect unless the FT_Face's selected charmap is a Unicode or symbol
+ * one.
+ *
+ * Since: REPLACEME
+ **/
+void
+hb_ft_font_set_ot_metrics (hb_font_t *font, hb_bool_t ot_metrics)
+{
+  if (hb_object_is_immutable (font))
+    return;
+
+  if (font->destroy != (hb_destroy_func_t) _hb_ft_font_destroy)
+    return;
+
+  hb_ft_font_t *ft_font = (hb_ft_font_t *) font->user_data;
+  FT_Face ft_face = ft_font->ft_face;
+
+  if (ot_metrics)
+  {
+    if (!ft_face->charmap ||
+	(ft_face->charmap->encoding != FT_ENCODING_UNICODE &&
+	 ft_face->charmap->encoding != FT_ENCODING_MS_SYMBOL))
+      return;
+
+    /* Load the tables now: for faces made with hb_ft_face_create(), that
+     * goes through the FT_Face, which must not happen outside the lock. */
+    hb_lock_t lock (ft_font->lock);
+    font->face->table.cmap.get ();
+    font->face->table.hmtx.get ();
+    font->face->table.vmtx.get ();
+  }
+
+  ft_font->ot_metrics = ot_metrics;
+}
+
+/**
+ * hb_ft_font_get_ot_metrics:
+ * @font: #hb_font_t to work upon
+ *
+ * Return value: whether hb_ft_font_set_ot_metrics() is in effect on @font.
+ *
+ * Since: REPLACEME
+ **/
+hb_bool_t
+hb_ft_font_get_ot_metrics (hb_font_t *font)
+{
+  if (font->destroy != (hb_destroy_func_t) _hb_ft_font_destroy)
+    return false;
+
+  const hb_ft_font_t *ft_font = (const hb_ft_font_t *) font->user_data;
+
+  return ft_font->ot_metrics;
+}
+
 FT_Face
 hb_ft_font_get_face (hb_font_t *font)
 {
@@ -180,13 +269,16 @@ hb_ft_font_get_face (hb_font_t *font)
 
 
 static hb_bool_t
-hb_ft_get_nominal_glyph (hb_font_t *font HB_UNUSED,
+hb_ft_get_nominal_glyph (hb_font_t *font,
 			 void *font_data,
 			 hb_codepoint_t unicode,
 			 hb_codepoint_t *glyph,
 			 void *user_data HB_UNUSED)
 {
   const hb_ft_font_t *ft_font = (const hb_ft_font_t *) font_data;
+  if (ft_font->use_ot_cmap ())
+    return font->face->table.cmap->get_nominal_glyph (unicode, glyph, &ft_font->cmap_cache);
+
   hb_lock_t lock (ft_font->lock);
   unsigned int g = FT_Get_Char_Index (ft_font->ft_face, unicode);
 
@@ -212,7 +304,7 @@ hb_ft_get_nominal_glyph (hb_font_t *font HB_UNUSED,
 }
 
 static unsigned int
-hb_ft_get_nominal_glyphs (hb_font_t *font HB_UNUSED,
+hb_ft_get_nominal_glyphs (hb_font_t *font,
 			  void *font_data,
 			  unsigned int count,
 			  const hb_codepoint_t *first_unicode,
@@ -222,6 +314,12 @@ hb_ft_get_nominal_glyphs (hb_font_t *font HB_UNUSED,
 			  void *user_data HB_UNUSED)
 {
   const hb_ft_font_t *ft_font = (const hb_ft_font_t *) font_data;
+  if (ft_font->use_ot_cmap ())
+    return font->face->table.cmap->get_nominal_glyphs (count,
+							first_unicode, unicode_stride,
+							first_glyph, glyph_stride,
+							&ft_font->cmap_cache);
+
   hb_lock_t lock (ft_font->lock);
   unsigned int done;
   for (done = 0;
@@ -238,7 +336,7 @@ hb_ft_get_nominal_glyphs (hb_font_t *font HB_UNUSED,
 
 
 static hb_bool_t
-hb_ft_get_variation_glyph (hb_font_t *font HB_UNUSED,
+hb_ft_get_variation_glyph (hb_font_t *font,
 			   void *font_data,
 			   hb_codepoint_t unicode,
 			   hb_codepoint_t variation_selector,
@@ -246,6 +344,10 @@ hb_ft_get_variation_glyph (hb_font_t *font HB_UNUSED,
 			   void *user_data HB_UNUSED)
 {
   const hb_ft_font_t *ft_font = (const hb_ft_font_t *) font_data;
+  if (ft_font->use_ot_cmap ())
+    return font->face->table.cmap->get_variation_glyph (unicode, variation_selector,
+							 glyph, &ft_font->cmap_cache);
+
   hb_lock_t lock (ft_font->lock);
   unsigned int g = FT_Face_GetCharVariantIndex (ft_font->ft_face, unicode, variation_selector);
 
@@ -266,6 +368,19 @@ hb_ft_get_glyph_h_advances (hb_font_t* font, void* font_data,
 			    void *user_data HB_UNUSED)
 {
   const hb_ft_font_t *ft_font = (const hb_ft_font_t *) font_data;
+  /* Without the table, FreeType synthesizes advances; leave that to it. */
+  if (ft_font->use_ot_advances () && font->face->table.hmtx->has_data ())
+  {
+    const OT::hmtx_accelerator_t &hmtx = *font->face->table.hmtx;
+    for (unsigned int i = 0; i < count; i++)
+    {
+      *first_advance = font->em_scale_x (hmtx.get_advance (*first_glyph, font));
+      first_glyph = &StructAtOffset<hb_codepoint_t> (first_glyph, glyph_stride);
+      first_advance = &StructAtOffset<hb_position_t> (first_advance, advance_stride);
+    }
+    return;
+  }
+
   hb_lock_t lock (ft_font->lock);
   FT_Face ft_face = ft_font->ft_face;
   int load_flags = ft_font->load_flags;
@@ -277,45 +392,87 @@ hb_ft_get_glyph_h_advances (hb_font_t* font, void* font_data,
     ft_font->cached_x_scale.set (font->x_scale);
   }
 
-  for (unsigned int i = 0; i < count; i++)
+  FT_Fixed run[HB_FT_ADVANCES_RUN_MAX];
+  for (unsigned int i = 0; i < count;)
   {
-    FT_Fixed v = 0;
     hb_codepoint_t glyph = *first_glyph;
 
     unsigned int cv;
     if (ft_font->advance_cache.get (glyph, &cv))
-      v = cv;
-    else
     {
-      FT_Get_Advance (ft_face, glyph, load_flags, &v);
-      ft_font->advance_cache.set (glyph, v);
+      FT_Fixed v = cv;
+      *first_advance = (v * mult + (1<<9)) >> 10;
+      first_glyph = &StructAtOffset<hb_codepoint_t> (first_glyph, glyph_stride);
+      first_advance = &StructAtOffset<hb_position_t> (first_advance, advance_stride);
+      i++;
+      continue;
     }
 
-    *first_advance = (v * mult + (1<<9)) >> 10;
-    first_glyph = &StructAtOffset<hb_codepoint_t> (first_glyph, glyph_stride);
-    first_advance = &StructAtOffset<hb_position_t> (first_advance, advance_stride);
+    /* Fetch the run of consecutive glyph ids starting here in one call. */
+    unsigned int n = 1;
+    const hb_codepoint_t *next = &StructAtOffset<hb_codepoint_t> (first_glyph, glyph_stride);
+    while (n < count - i && n < ARRAY_LENGTH (run) && *next == glyph + n)
+    {
+      next = &StructAtOffset<hb_codepoint_t> (next, glyph_stride);
+      n++;
+    }
+    if (unlikely (FT_Get_Advances (ft_face, glyph, n, load_flags, run)))
+      /* Some glyph in the run is out of range; do them one by one. */
+      for (unsigned int j = 0; j < n; j++)
+      {
+	run[j] = 0;
+	FT_Get_Advance (ft_face, glyph + j, load_flags, &run[j]);
+      }
+
+    for (unsigned int j = 0; j < n; j++)
+    {
+      ft_font->advance_cache.set (glyph + j, run[j]);
+      *first_advance = (run[j] * mult + (1<<9)) >> 10;
+      first_glyph = &StructAtOffset<hb_codepoint_t> (first_glyph, glyph_stride);
+      first_advance = &StructAtOffset<hb_position_t> (first_advance, advance_stride);
+    }
+    i += n;
   }
 }
 
-static hb_position_t
-hb_ft_get_glyph_v_advance (hb_font_t *font,
-			   void *font_data,
-			   hb_codepoint_t glyph,
-			   void *user_data HB_UNUSED)
+static void
+hb_ft_get_glyph_v_advances (hb_font_t* font, void* font_data,
+			    unsigned count,
+			    const hb_codepoint_t *first_glyph,
+			    unsigned glyph_stride,
+			    hb_position_t *first_advance,
+			    unsigned advance_stride,
+			    void *user_data HB_UNUSED)
 {
   const hb_ft_font_t *ft_font = (const hb_ft_font_t *) font_data;
-  hb_lock_t lock (ft_font->lock);
-  FT_Fixed v;
+  if (ft_font->use_ot_advances () && font->face->table.vmtx->has_data ())
+  {
+    const OT::vmtx_accelerator_t &vmtx = *font->face->table.vmtx;
+    for (unsigned int i = 0; i < count; i++)
+    {
+      *first_advance = font->em_scale_y (-(int) vmtx.get_advance (*first_glyph, font));
+      first_glyph = &StructAtOffset<hb_codepoint_t> (first_glyph, glyph_stride);
+      first_advance = &StructAtOffset<hb_position_t> (first_advance, advance_stride);
+    }
+    return;
+  }
 
-  if (unlikely (FT_Get_Advance (ft_font->ft_face, glyph, ft_font->load_flags | FT_LOAD_VERTICAL_LAYOUT, &v)))
-    return 0;
+  hb_lock_t lock (ft_font->lock);
+  FT_Face ft_face = ft_font->ft_face;
+  int load_flags = ft_font->load_flags | FT_LOAD_VERTICAL_LAYOUT;
+  int mult = font->y_scale < 0 ? -1 : +1;
 
-  if (font->y_scale < 0)
-    v = -v;
+  for (unsigned int i = 0; i < count; i++)
+  {
+    FT_Fixed v = 0;
+    FT_Get_Advance (ft_face, *first_glyph, load_flags, &v);
 
-  /* Note: FreeType's vertical metrics grows downward while other FreeType coordinates
-   * have a Y growing upward.  Hence the extra negation. */
-  return (-v + (1<<9)) >> 10;
+    /* Note: FreeType's vertical metrics grows downward while other FreeType coordinates
+     * have a Y growing upward.  Hence the extra negation. */
+    *first_advance = (-v * mult + (1<<9)) >> 10;
+    first_glyph = &StructAtOffset<hb_codepoint_t> (first_glyph, glyph_stride);
+    first_advance = &StructAtOffset<hb_position_t> (first_advance, advance_stride);
+  }
 }
 
 static hb_bool_t
@@ -346,15 +503,12 @@ hb_ft_get_glyph_v_origin (hb_font_t *font,
   return true;
 }
 
-static hb_bool_t
-hb_ft_get_glyph_extents (hb_font_t *font,
-			 void *font_data,
-			 hb_codepoint_t glyph,
-			 hb_glyph_extents_t *extents,
-			 void *user_data HB_UNUSED)
+static inline bool
+_hb_ft_get_glyph_extents (hb_font_t *font,
+			  const hb_ft_font_t *ft_font,
+			  hb_codepoint_t glyph,
+			  hb_glyph_extents_t *extents)
 {
-  const hb_ft_font_t *ft_font = (const hb_ft_font_t *) font_data;
-  hb_lock_t lock (ft_font->lock);
   FT_Face ft_face = ft_font->ft_face;
 
   if (unlikely (FT_Load_Glyph (ft_face, glyph, ft_font->load_flags)))
@@ -377,6 +531,41 @@ hb_ft_get_glyph_extents (hb_font_t *font,
   return true;
 }
 
+static hb_bool_t
+hb_ft_get_glyph_extents (hb_font_t *font,
+			 void *font_data,
+			 hb_codepoint_t glyph,
+			 hb_glyph_extents_t *extents,
+			 void *user_data HB_UNUSED)
+{
+  const hb_ft_font_t *ft_font = (const hb_ft_font_t *) font_data;
+  hb_lock_t lock (ft_font->lock);
+  return _hb_ft_get_glyph_extents (font, ft_font, glyph, extents);
+}
+
+static unsigned int
+hb_ft_get_glyph_extents_batch (hb_font_t *font,
+			       void *font_data,
+			       unsigned int count,
+			       const hb_codepoint_t *first_glyph,
+			       unsigned int glyph_stride,
+			       hb_glyph_extents_t *first_extents,
+			       unsigned int extents_stride,
+			       void *user_data HB_UNUSED)
+{
+  const hb_ft_font_t *ft_font = (const hb_ft_font_t *) font_data;
+  hb_lock_t lock (ft_font->lock);
+
+  unsigned int found = 0;
+  for (unsigned int i = 0; i < count; i++)
+  {
+    found += _hb_ft_get_glyph_extents (font, ft_font, *first_glyph, first_extents);
+    first_glyph = &StructAtOffset<hb_codepoint_t> (first_glyph, glyph_stride);
+    first_extents = &StructAtOffset<hb_glyph_extents_t> (first_extents, extents_stride);
+  }
+  return found;
+}
+
 static hb_bool_t
 hb_ft_get_glyph_contour_point (hb_font_t *font HB_UNUSED,
 			       void *font_data,
@@ -494,10 +683,11 @@ static struct hb_ft_font_funcs_lazy_loader_t : hb_font_funcs_lazy_loader_t<hb_ft
     hb_font_funcs_set_nominal_glyphs_func (funcs, hb_ft_get_nominal_glyphs, nullptr, nullptr);
     hb_font_funcs_set_variation_glyph_func (funcs, hb_ft_get_variation_glyph, nullptr, nullptr);
     hb_font_funcs_set_glyph_h_advances_func (funcs, hb_ft_get_glyph_h_advances, nullptr, nullptr);
-    hb_font_funcs_set_glyph_v_advance_func (funcs, hb_ft_get_glyph_v_advance, nullptr, nullptr);
+    hb_font_funcs_set_glyph_v_advances_func (funcs, hb_ft_get_glyph_v_advances, nullptr, nullptr);
     //hb_font_funcs_set_glyph_h_origin_func (funcs, hb_ft_get_glyph_h_origin, nullptr, nullptr);
     hb_font_funcs_set_glyph_v_origin_func (funcs, hb_ft_get_glyph_v_origin, nullptr, nullptr);
     hb_font_funcs_set_glyph_extents_func (funcs, hb_ft_get_glyph_extents, nullptr, nullptr);
+    hb_font_funcs_set_glyph_extents_batch_func (funcs, hb_ft_get_glyph_extents_batch, nullptr, nullptr);
     hb_font_funcs_set_glyph_contour_point_func (funcs, hb_ft_get_glyph_contour_point, nullptr, nullptr);
     hb_font_funcs_set_glyph_name_func (funcs, hb_ft_get_glyph_name, nullptr, nullptr);
     hb_font_funcs_set_glyph_from_name_func (funcs, hb_ft_get_glyph_from_name, nullptr, nullptr);
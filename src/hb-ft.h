@@ -116,6 +116,12 @@ hb_ft_font_set_load_flags (hb_font_t *font, int load_flags);
 HB_EXTERN int
 hb_ft_font_get_load_flags (hb_font_t *font);
 
+HB_EXTERN void
+hb_ft_font_set_ot_metrics (hb_font_t *font, hb_bool_t ot_metrics);
+
+HB_EXTERN hb_bool_t
+hb_ft_font_get_ot_metrics (hb_font_t *font);
+
 /* Call when size or variations settings on underlying FT_Face change. */
 HB_EXTERN void
 hb_ft_font_changed (hb_font_t *font);
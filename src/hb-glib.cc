@@ -31,6 +31,7 @@
 #include "hb-glib.h"
 
 #include "hb-machinery.hh"
+#include "hb-unicode.hh"
 
 
 /**
@@ -335,6 +336,29 @@ hb_glib_unicode_decompose (hb_unicode_funcs_t *ufuncs HB_UNUSED,
   return ret;
 }
 
+static void
+hb_glib_unicode_props (unsigned int          count,
+		       const hb_codepoint_t *first_unicode,
+		       unsigned int          unicode_stride,
+		       hb_unicode_props_t   *first_props)
+{
+  /* Straight to GLib, without going through the callbacks for each
+   * property of each character. */
+  for (unsigned int i = 0; i < count; i++)
+  {
+    hb_codepoint_t u = *first_unicode;
+    hb_unicode_props_t *props = &first_props[i];
+    /* hb_unicode_general_category_t and GUnicodeType are identical */
+    props->general_category = (hb_unicode_general_category_t) g_unichar_type (u);
+    props->combining_class = (hb_unicode_combining_class_t) g_unichar_combining_class (u);
+    props->script = hb_glib_script_to_script (g_unichar_get_script (u));
+    gunichar mirror = u;
+    g_unichar_get_mirror_char (u, &mirror);
+    props->mirroring = mirror;
+    first_unicode = &StructAtOffset<hb_codepoint_t> (first_unicode, unicode_stride);
+  }
+}
+
 
 #if HB_USE_ATEXIT
 static void free_static_glib_funcs ();
@@ -353,6 +377,9 @@ static struct hb_glib_unicode_funcs_lazy_loader_t : hb_unicode_funcs_lazy_loader
     hb_unicode_funcs_set_compose_func (funcs, hb_glib_unicode_compose, nullptr, nullptr);
     hb_unicode_funcs_set_decompose_func (funcs, hb_glib_unicode_decompose, nullptr, nullptr);
 
+    if (!hb_object_is_inert (funcs))
+      funcs->props_func = hb_glib_unicode_props;
+
     hb_unicode_funcs_make_immutable (funcs);
 
 #if HB_USE_ATEXIT
@@ -56,11 +56,22 @@ typedef struct hb_graphite2_tablelist_t
   unsigned int tag;
 } hb_graphite2_tablelist_t;
 
+/* Default feature values for a language, for shaping without features. */
+typedef struct hb_graphite2_feature_vals_t
+{
+  struct hb_graphite2_feature_vals_t *next;
+  gr_feature_val *feats;
+  hb_tag_t lang;
+} hb_graphite2_feature_vals_t;
+
+#define HB_GRAPHITE2_MAX_FEATURE_VALS 16
+
 struct hb_graphite2_face_data_t
 {
   hb_face_t *face;
   gr_face   *grface;
   hb_atomic_ptr_t<hb_graphite2_tablelist_t> tlist;
+  hb_atomic_ptr_t<hb_graphite2_feature_vals_t> feature_vals;
 };
 
 static const void *hb_graphite2_get_table (const void *data, unsigned int tag, size_t *len)
@@ -169,11 +180,54 @@ _hb_graphite2_shaper_face_data_destroy (hb_graphite2_face_data_t *data)
     free (old);
   }
 
+  hb_graphite2_feature_vals_t *vals = data->feature_vals;
+
+  while (vals)
+  {
+    hb_graphite2_feature_vals_t *old = vals;
+    gr_featureval_destroy (vals->feats);
+    vals = vals->next;
+    free (old);
+  }
+
   gr_face_destroy (data->grface);
 
   free (data);
 }
 
+/* Returns the face's default feature values for lang, kept until the
+ * face data is destroyed, or nullptr if too many languages are kept. */
+static const gr_feature_val *
+hb_graphite2_get_feature_vals (const hb_graphite2_face_data_t *face_data, hb_tag_t lang)
+{
+  unsigned int count = 0;
+  for (hb_graphite2_feature_vals_t *p = face_data->feature_vals; p; p = p->next, count++)
+    if (p->lang == lang)
+      return p->feats;
+  if (count >= HB_GRAPHITE2_MAX_FEATURE_VALS)
+    return nullptr;
+
+  hb_graphite2_feature_vals_t *p = (hb_graphite2_feature_vals_t *) calloc (1, sizeof (hb_graphite2_feature_vals_t));
+  if (unlikely (!p))
+    return nullptr;
+  p->feats = gr_face_featureval_for_lang (face_data->grface, lang);
+  if (unlikely (!p->feats))
+  {
+    free (p);
+    return nullptr;
+  }
+  p->lang = lang;
+
+retry:
+  hb_graphite2_feature_vals_t *vals = face_data->feature_vals;
+  p->next = vals;
+
+  if (unlikely (!face_data->feature_vals.cmpexch (vals, p)))
+    goto retry;
+
+  return p->feats;
+}
+
 /*
  * Since: 0.9.10
  */
@@ -236,18 +290,29 @@ _hb_graphite2_shape (hb_shape_plan_t    *shape_plan HB_UNUSED,
 		     unsigned int        num_features)
 {
   hb_face_t *face = font->face;
-  gr_face *grface = face->data.graphite2->grface;
+  const hb_graphite2_face_data_t *face_data = face->data.graphite2;
+  gr_face *grface = face_data->grface;
 
   const char *lang = hb_language_to_string (hb_buffer_get_language (buffer));
   const char *lang_end = lang ? strchr (lang, '-') : nullptr;
   int lang_len = lang_end ? lang_end - lang : -1;
-  gr_feature_val *feats = gr_face_featureval_for_lang (grface, lang ? hb_tag_from_string (lang, lang_len) : 0);
+  hb_tag_t lang_tag = lang ? hb_tag_from_string (lang, lang_len) : 0;
+
+  /* Without features the face's shared defaults do; otherwise we need
+   * our own copy to set them in. */
+  gr_feature_val *own_feats = nullptr;
+  const gr_feature_val *feats = num_features ? nullptr : hb_graphite2_get_feature_vals (face_data, lang_tag);
+  if (!feats)
+  {
+    own_feats = gr_face_featureval_for_lang (grface, lang_tag);
+    feats = own_feats;
+  }
 
   for (unsigned int i = 0; i < num_features; i++)
   {
     const gr_feature_ref *fref = gr_face_find_fref (grface, features[i].tag);
     if (fref)
-      gr_fref_set_feature_value (fref, features[i].value, feats);
+      gr_fref_set_feature_value (fref, features[i].value, own_feats);
   }
 
   gr_segment *seg = nullptr;
@@ -280,13 +345,13 @@ _hb_graphite2_shape (hb_shape_plan_t    *shape_plan HB_UNUSED,
 		     2 | (hb_buffer_get_direction (buffer) == HB_DIRECTION_RTL ? 1 : 0));
 
   if (unlikely (!seg)) {
-    if (feats) gr_featureval_destroy (feats);
+    if (own_feats) gr_featureval_destroy (own_feats);
     return false;
   }
 
   unsigned int glyph_count = gr_seg_n_slots (seg);
   if (unlikely (!glyph_count)) {
-    if (feats) gr_featureval_destroy (feats);
+    if (own_feats) gr_featureval_destroy (own_feats);
     gr_seg_destroy (seg);
     buffer->len = 0;
     return true;
@@ -299,7 +364,7 @@ _hb_graphite2_shape (hb_shape_plan_t    *shape_plan HB_UNUSED,
   {
     if (unlikely (!buffer->ensure (buffer->allocated * 2)))
     {
-      if (feats) gr_featureval_destroy (feats);
+      if (own_feats) gr_featureval_destroy (own_feats);
       gr_seg_destroy (seg);
       return false;
     }
@@ -435,7 +500,7 @@ _hb_graphite2_shape (hb_shape_plan_t    *shape_plan HB_UNUSED,
     hb_buffer_reverse_clusters (buffer);
   }
 
-  if (feats) gr_featureval_destroy (feats);
+  if (own_feats) gr_featureval_destroy (own_feats);
   gr_seg_destroy (seg);
 
   buffer->unsafe_to_break_all ();
@@ -32,6 +32,7 @@
 #include "hb-icu.h"
 
 #include "hb-machinery.hh"
+#include "hb-unicode.hh"
 
 #include <unicode/uchar.h>
 #include <unicode/unorm2.h>
@@ -84,11 +85,9 @@ hb_icu_unicode_combining_class (hb_unicode_funcs_t *ufuncs HB_UNUSED,
 }
 
 static hb_unicode_general_category_t
-hb_icu_unicode_general_category (hb_unicode_funcs_t *ufuncs HB_UNUSED,
-				 hb_codepoint_t      unicode,
-				 void               *user_data HB_UNUSED)
+hb_icu_general_category_to_general_category (int32_t category)
 {
-  switch (u_getIntPropertyValue(unicode, UCHAR_GENERAL_CATEGORY))
+  switch (category)
   {
   case U_UNASSIGNED:			return HB_UNICODE_GENERAL_CATEGORY_UNASSIGNED;
 
@@ -134,6 +133,14 @@ hb_icu_unicode_general_category (hb_unicode_funcs_t *ufuncs HB_UNUSED,
   return HB_UNICODE_GENERAL_CATEGORY_UNASSIGNED;
 }
 
+static hb_unicode_general_category_t
+hb_icu_unicode_general_category (hb_unicode_funcs_t *ufuncs HB_UNUSED,
+				 hb_codepoint_t      unicode,
+				 void               *user_data HB_UNUSED)
+{
+  return hb_icu_general_category_to_general_category (u_getIntPropertyValue(unicode, UCHAR_GENERAL_CATEGORY));
+}
+
 static hb_codepoint_t
 hb_icu_unicode_mirroring (hb_unicode_funcs_t *ufuncs HB_UNUSED,
 			  hb_codepoint_t      unicode,
@@ -300,6 +307,29 @@ hb_icu_unicode_decompose (hb_unicode_funcs_t *ufuncs HB_UNUSED,
   return ret;
 }
 
+static void
+hb_icu_unicode_props (unsigned int          count,
+		      const hb_codepoint_t *first_unicode,
+		      unsigned int          unicode_stride,
+		      hb_unicode_props_t   *first_props)
+{
+  /* Straight to ICU, without going through the callbacks for each
+   * property of each character; u_charType() is the cheap way to the
+   * general category. */
+  for (unsigned int i = 0; i < count; i++)
+  {
+    hb_codepoint_t u = *first_unicode;
+    hb_unicode_props_t *props = &first_props[i];
+    props->general_category = hb_icu_general_category_to_general_category (u_charType (u));
+    props->combining_class = (hb_unicode_combining_class_t) u_getCombiningClass (u);
+    UErrorCode status = U_ZERO_ERROR;
+    UScriptCode script_code = uscript_getScript (u, &status);
+    props->script = unlikely (U_FAILURE (status)) ? HB_SCRIPT_UNKNOWN : hb_icu_script_to_script (script_code);
+    props->mirroring = u_charMirror (u);
+    first_unicode = &StructAtOffset<hb_codepoint_t> (first_unicode, unicode_stride);
+  }
+}
+
 
 #if HB_USE_ATEXIT
 static void free_static_icu_funcs ();
@@ -325,6 +355,9 @@ static struct hb_icu_unicode_funcs_lazy_loader_t : hb_unicode_funcs_lazy_loader_
     hb_unicode_funcs_set_compose_func (funcs, hb_icu_unicode_compose, user_data, nullptr);
     hb_unicode_funcs_set_decompose_func (funcs, hb_icu_unicode_decompose, user_data, nullptr);
 
+    if (!hb_object_is_inert (funcs))
+      funcs->props_func = hb_icu_unicode_props;
+
     hb_unicode_funcs_make_immutable (funcs);
 
 #if HB_USE_ATEXIT
@@ -33,6 +33,7 @@
 #include "hb-blob.hh"
 
 #include "hb-array.hh"
+#include "hb-map.hh"
 #include "hb-vector.hh"
 
 
@@ -223,6 +224,18 @@ struct hb_dispatch_context_t
 #define HB_SANITIZE_MAX_OPS_MAX 0x3FFFFFFF
 #endif
 
+/* Implemented in hb-face.cc; see hb_face_set_sanitize_cache(). */
+HB_INTERNAL unsigned int
+_hb_face_get_sanitize_max_ops_factor (const hb_face_t *face);
+HB_INTERNAL void
+_hb_face_add_sanitize_ops (const hb_face_t *face, unsigned int ops);
+HB_INTERNAL bool
+_hb_face_sanitize_cache_lookup (const hb_face_t *face, hb_tag_t tag,
+				unsigned int num_glyphs, hb_blob_t *blob);
+HB_INTERNAL void
+_hb_face_sanitize_cache_add (const hb_face_t *face, hb_tag_t tag,
+			     unsigned int num_glyphs, hb_blob_t *blob);
+
 struct hb_sanitize_context_t :
        hb_dispatch_context_t<hb_sanitize_context_t, bool, HB_DEBUG_SANITIZE>
 {
@@ -233,7 +246,9 @@ struct hb_sanitize_context_t :
 	writable (false), edit_count (0),
 	blob (nullptr),
 	num_glyphs (65536),
-	num_glyphs_set (false) {}
+	num_glyphs_set (false),
+	face (nullptr), table_tag (HB_TAG_NONE),
+	max_ops_factor (HB_SANITIZE_MAX_OPS_FACTOR), ops_budget (0) {}
 
   const char *get_name () { return "SANITIZE"; }
   template <typename T, typename F>
@@ -290,8 +305,10 @@ struct hb_sanitize_context_t :
   void start_processing ()
   {
     reset_object ();
-    this->max_ops = MAX ((unsigned int) (this->end - this->start) * HB_SANITIZE_MAX_OPS_FACTOR,
-			 (unsigned) HB_SANITIZE_MAX_OPS_MIN);
+    unsigned long long max_ops_ = (unsigned long long) (this->end - this->start) * max_ops_factor;
+    max_ops_ = MAX (max_ops_, (unsigned long long) HB_SANITIZE_MAX_OPS_MIN);
+    this->max_ops = (int) MIN (max_ops_, (unsigned long long) HB_SANITIZE_MAX_OPS_MAX);
+    this->ops_budget = this->max_ops;
     this->edit_count = 0;
     this->debug_depth = 0;
 
@@ -401,7 +418,15 @@ struct hb_sanitize_context_t :
   {
     bool sane;
 
+    /* The very same bytes passed before, untouched. */
+    if (face && _hb_face_sanitize_cache_lookup (face, table_tag, num_glyphs, blob))
+    {
+      hb_blob_make_immutable (blob);
+      return blob;
+    }
+
     init (blob);
+    unsigned int ops_used = 0;
 
   retry:
     DEBUG_MSG_FUNC (SANITIZE, start, "start");
@@ -440,6 +465,7 @@ struct hb_sanitize_context_t :
 
 	if (start)
 	{
+	  ops_used += spent_ops ();
 	  writable = true;
 	  /* ok, we made it writable by relocating.  try again */
 	  DEBUG_MSG_FUNC (SANITIZE, start, "retry");
@@ -448,12 +474,18 @@ struct hb_sanitize_context_t :
       }
     }
 
+    ops_used += spent_ops ();
     end_processing ();
 
     DEBUG_MSG_FUNC (SANITIZE, start, sane ? "PASSED" : "FAILED");
+    if (face)
+      _hb_face_add_sanitize_ops (face, ops_used);
     if (sane)
     {
       hb_blob_make_immutable (blob);
+      /* Edited tables are private copies; not worth remembering. */
+      if (face && !writable)
+	_hb_face_sanitize_cache_add (face, table_tag, num_glyphs, blob);
       return blob;
     }
     else
@@ -468,9 +500,17 @@ struct hb_sanitize_context_t :
   {
     if (!num_glyphs_set)
       set_num_glyphs (hb_face_get_glyph_count (face));
+    this->face = face;
+    this->table_tag = tableTag;
+    this->max_ops_factor = _hb_face_get_sanitize_max_ops_factor (face);
     return sanitize_blob<Type> (hb_face_reference_table (face, tableTag));
   }
 
+  private:
+  unsigned int spent_ops () const
+  { return max_ops < ops_budget ? ops_budget - MAX (max_ops, 0) : 0; }
+  public:
+
   mutable unsigned int debug_depth;
   const char *start, *end;
   mutable int max_ops;
@@ -480,6 +520,10 @@ struct hb_sanitize_context_t :
   hb_blob_t *blob;
   unsigned int num_glyphs;
   bool  num_glyphs_set;
+  const hb_face_t *face;
+  hb_tag_t table_tag;
+  unsigned int max_ops_factor;
+  int ops_budget;
 };
 
 struct hb_sanitize_with_object_t
@@ -498,10 +542,24 @@ struct hb_sanitize_with_object_t
 
 /*
  * Serialize
+ *
+ * Bytes are written at head, into the current object.  push () starts a
+ * new object at head; pop_pack () finishes it, moves it to the tail end
+ * of the buffer and returns the index its parent links an offset to it
+ * by, with add_link ().  Identical objects, links included, are packed
+ * only once.  end_serialize () packs the root last and fills in all the
+ * offsets, laying the objects out anew if some offset would not fit.
+ * Without push () everything is written in place, as it comes.
  */
 
+#ifndef HB_SERIALIZE_MAX_OFFSET16
+#define HB_SERIALIZE_MAX_OFFSET16 0xFFFFu
+#endif
+
 struct hb_serialize_context_t
 {
+  typedef unsigned int objidx_t;
+
   hb_serialize_context_t (void *start_, unsigned int size)
   {
     this->start = (char *) start_;
@@ -514,8 +572,17 @@ struct hb_serialize_context_t
   void reset ()
   {
     this->successful = true;
+    this->ran_out_of_room = false;
     this->head = this->start;
+    this->tail = this->end;
     this->debug_depth = 0;
+    this->current.head = this->start;
+    this->current.links_start = 0;
+    this->frames.resize (0);
+    this->links.resize (0);
+    this->packed.resize (0);
+    this->packed_links.resize (0);
+    this->packed_map.clear ();
   }
 
   bool propagate_error (bool e)
@@ -548,14 +615,22 @@ struct hb_serialize_context_t
   }
   void end_serialize ()
   {
+    if (likely (this->successful) && packed.length > 1)
+    {
+      assert (!frames.length);
+      pack (current, false);
+      resolve_links ();
+    }
+
     DEBUG_MSG_LEVEL (SERIALIZE, this->start, 0, -1,
-		     "end [%p..%p] serialized %d bytes; %s",
+		     "end [%p..%p] serialized %u bytes; %s",
 		     this->start, this->end,
-		     (int) (this->head - this->start),
+		     length (),
 		     this->successful ? "successful" : "UNSUCCESSFUL");
   }
 
-  unsigned int length () const { return this->head - this->start; }
+  unsigned int length () const
+  { return (this->head - this->start) + (this->end - this->tail); }
 
   void align (unsigned int alignment)
   {
@@ -574,7 +649,8 @@ struct hb_serialize_context_t
   template <typename Type>
   Type *allocate_size (unsigned int size)
   {
-    if (unlikely (!this->successful || this->end - this->head < ptrdiff_t (size))) {
+    if (unlikely (!this->successful || this->tail - this->head < ptrdiff_t (size))) {
+      this->ran_out_of_room = this->ran_out_of_room || this->successful;
       this->successful = false;
       return nullptr;
     }
@@ -618,41 +694,406 @@ struct hb_serialize_context_t
   template <typename Type>
   Type *extend (Type &obj) { return extend_size (obj, obj.get_size ()); }
 
+  /* Drops what the current object has serialized from snap on, and the
+   * links from there. */
+  void revert (char *snap)
+  {
+    assert (current.head <= snap && snap <= this->head);
+    this->head = snap;
+    unsigned int position = snap - current.head;
+    unsigned int j = current.links_start;
+    for (unsigned int i = j; i < links.length; i++)
+      if (links[i].position < position)
+	links[j++] = links[i];
+    links.shrink (j);
+  }
+
+  /* Starts a new object at head. */
+  void push ()
+  {
+    frame_t *frame = frames.push ();
+    if (unlikely (frames.in_error ()))
+    {
+      this->successful = false;
+      return;
+    }
+    *frame = current;
+    current.head = this->head;
+    current.links_start = links.length;
+  }
+
+  /* Drops the current object. */
+  void pop_discard ()
+  {
+    if (unlikely (!frames.length)) return;
+    this->head = current.head;
+    links.shrink (current.links_start);
+    current = frames[frames.length - 1];
+    frames.pop ();
+  }
+
+  /* Finishes the current object; returns what to link to it by, or 0,
+   * for a null offset, if it came out empty. */
+  objidx_t pop_pack ()
+  {
+    if (unlikely (!this->successful || !frames.length))
+    {
+      pop_discard ();
+      return 0;
+    }
+    frame_t obj = current;
+    current = frames[frames.length - 1];
+    frames.pop ();
+    return pack (obj, true);
+  }
+
+  /* Makes ofs, in the current object and relative to base, point at the
+   * packed object objidx once everything is laid out. */
+  template <typename OffsetType>
+  void add_link (OffsetType &ofs, objidx_t objidx, const void *base)
+  {
+    if (!objidx || unlikely (!this->successful))
+      return;
+    assert (current.head <= (const char *) base);
+    assert ((const char *) &ofs + sizeof (ofs) <= this->head);
+    link_t *link = links.push ();
+    if (unlikely (links.in_error ()))
+    {
+      this->successful = false;
+      return;
+    }
+    link->is_wide = sizeof (ofs) == 4;
+    link->position = (const char *) &ofs - current.head;
+    link->bias = (const char *) base - current.head;
+    link->objidx = objidx;
+  }
+
   /* Output routines. */
   template <typename Type>
   Type *copy () const
-  {
-    assert (this->successful);
-    unsigned int len = this->head - this->start;
-    void *p = malloc (len);
-    if (p)
-      memcpy (p, this->start, len);
-    return reinterpret_cast<Type *> (p);
-  }
+  { return reinterpret_cast<Type *> ((void *) copy_bytes ().arrayZ); }
   hb_bytes_t copy_bytes () const
   {
     assert (this->successful);
-    unsigned int len = this->head - this->start;
-    void *p = malloc (len);
-    if (p)
-      memcpy (p, this->start, len);
-    else
+    unsigned int head_len = this->head - this->start;
+    unsigned int tail_len = this->end - this->tail;
+    char *p = (char *) malloc (head_len + tail_len);
+    if (unlikely (!p))
       return hb_bytes_t ();
-    return hb_bytes_t ((char *) p, len);
+    memcpy (p, this->start, head_len);
+    memcpy (p + head_len, this->tail, tail_len);
+    return hb_bytes_t (p, head_len + tail_len);
   }
   hb_blob_t *copy_blob () const
   {
-    assert (this->successful);
-    return hb_blob_create (this->start,
-			   this->head - this->start,
-			   HB_MEMORY_MODE_DUPLICATE,
-			   nullptr, nullptr);
+    hb_bytes_t bytes = copy_bytes ();
+    return hb_blob_create (bytes.arrayZ, bytes.length,
+			   HB_MEMORY_MODE_WRITABLE,
+			   (char *) bytes.arrayZ, free);
   }
 
   public:
   unsigned int debug_depth;
-  char *start, *end, *head;
+  char *start, *end, *head, *tail;
   bool successful;
+  bool ran_out_of_room;
+
+  private:
+  struct link_t
+  {
+    unsigned int is_wide : 1;
+    unsigned int position : 31;	/* From the start of the object. */
+    unsigned int bias;		/* Where the offset counts from. */
+    objidx_t objidx;
+  };
+  struct frame_t
+  {
+    char *head;
+    unsigned int links_start;	/* Into links. */
+  };
+  struct object_t
+  {
+    char *head;			/* Null once dropped as unreachable. */
+    unsigned int length;
+    unsigned int links_start;	/* Into packed_links. */
+    unsigned int num_links;
+    objidx_t next;		/* Next packed object of the same hash. */
+  };
+
+  static uint32_t hash_object (const char *p, unsigned int length,
+			       const link_t *object_links, unsigned int num_links)
+  {
+    uint32_t hash = length;
+    unsigned int i = 0;
+    for (; i + 4 <= length; i += 4)
+    {
+      uint32_t v;
+      memcpy (&v, p + i, 4);
+      hash = (hash ^ v) * 2654435761u;
+      hash ^= hash >> 15;
+    }
+    for (; i < length; i++)
+      hash = (hash ^ (uint8_t) p[i]) * 2654435761u;
+    for (i = 0; i < num_links; i++)
+      hash = (hash ^ (object_links[i].position * 31 + object_links[i].objidx)) * 2654435761u;
+    return hash & 0x7FFFFFFFu; /* Keep clear of HB_MAP_VALUE_INVALID. */
+  }
+
+  objidx_t pack (const frame_t &obj, bool share)
+  {
+    unsigned int length = this->head - obj.head;
+    unsigned int num_links = links.length - obj.links_start;
+    const link_t *obj_links = links.arrayZ () + obj.links_start;
+    this->head = obj.head;
+    if (!length)
+    {
+      links.shrink (obj.links_start);
+      return 0;
+    }
+
+    uint32_t hash = hash_object (obj.head, length, obj_links, num_links);
+    objidx_t first = packed_map.get (hash);
+    if (share)
+      for (objidx_t i = first; i != HB_MAP_VALUE_INVALID; i = packed[i].next)
+      {
+	const object_t &other = packed[i];
+	if (other.length == length && other.num_links == num_links &&
+	    0 == memcmp (other.head, obj.head, length) &&
+	    (!num_links ||
+	     0 == memcmp (packed_links.arrayZ () + other.links_start, obj_links,
+			  num_links * sizeof (link_t))))
+	{
+	  links.shrink (obj.links_start);
+	  return i;
+	}
+      }
+
+    if (!packed.length)
+      packed.push (); /* Index 0 stands for null. */
+    object_t *object = packed.push ();
+    unsigned int links_start = packed_links.length;
+    if (unlikely (packed.in_error () ||
+		  !packed_links.resize (links_start + num_links)))
+    {
+      this->successful = false;
+      return 0;
+    }
+    if (num_links)
+      memcpy (packed_links.arrayZ () + links_start, obj_links, num_links * sizeof (link_t));
+    links.shrink (obj.links_start);
+
+    this->tail -= length;
+    memmove (this->tail, obj.head, length);
+    object->head = this->tail;
+    object->length = length;
+    object->links_start = links_start;
+    object->num_links = num_links;
+    object->next = first;
+    objidx_t objidx = packed.length - 1;
+    packed_map.set (hash, objidx);
+    return objidx;
+  }
+
+  bool offsets_fit () const
+  {
+    for (unsigned int i = 1; i < packed.length; i++)
+    {
+      const object_t &object = packed[i];
+      if (!object.head) continue;
+      for (unsigned int j = 0; j < object.num_links; j++)
+      {
+	const link_t &link = packed_links[object.links_start + j];
+	unsigned int offset = packed[link.objidx].head - (object.head + link.bias);
+	if (!link.is_wide && offset > HB_SERIALIZE_MAX_OFFSET16)
+	  return false;
+      }
+    }
+    return true;
+  }
+
+  /* Packing order puts every object before the ones it links to, but
+   * keeps objects nobody links to any more (whose parents failed to
+   * subset after they were packed) and can leave a wide gap between a
+   * parent and a child packed much earlier.  Lays everything reachable
+   * from the root out again, in topological order, always placing next
+   * whatever is closest to the root, counting the bytes of every object
+   * on the way; objects behind wide offsets go last. */
+  void repack ()
+  {
+    unsigned int count = packed.length;
+    objidx_t root = count - 1;
+    hb_vector_t<unsigned int> parents;
+    hb_vector_t<uint64_t> distances;
+    hb_vector_t<objidx_t> order;
+    hb_vector_t<queue_item_t> queue;
+    if (unlikely (!parents.resize (count) || !distances.resize (count) ||
+		  !order.alloc (count)))
+    {
+      this->successful = false;
+      return;
+    }
+
+    /* Count parents among the reachable objects only. */
+    order.push (root);
+    parents[root] = 1;
+    for (unsigned int i = 0; i < order.length; i++)
+    {
+      const object_t &object = packed[order[i]];
+      for (unsigned int j = 0; j < object.num_links; j++)
+	if (!parents[packed_links[object.links_start + j].objidx]++)
+	  order.push (packed_links[object.links_start + j].objidx);
+    }
+    unsigned int reachable = order.length;
+    order.resize (0);
+
+    for (unsigned int i = 0; i < count; i++)
+      distances[i] = (uint64_t) -1;
+    distances[root] = 0;
+    queue_push (queue, 0, root);
+    while (queue.length)
+    {
+      objidx_t i = queue_pop (queue);
+      order.push (i);
+      const object_t &object = packed[i];
+      for (unsigned int j = 0; j < object.num_links; j++)
+      {
+	const link_t &link = packed_links[object.links_start + j];
+	uint64_t distance = distances[i] + packed[link.objidx].length +
+			    (link.is_wide ? ((uint64_t) 1 << 32) : 0);
+	if (distance < distances[link.objidx])
+	  distances[link.objidx] = distance;
+	if (!--parents[link.objidx])
+	  queue_push (queue, distances[link.objidx], link.objidx);
+      }
+    }
+    if (unlikely (queue.in_error () || order.length != reachable))
+    {
+      this->successful = false;
+      return;
+    }
+
+    unsigned int size = 0;
+    for (unsigned int i = 0; i < order.length; i++)
+      size += packed[order[i]].length;
+    char *buf = (char *) malloc (size);
+    if (unlikely (!buf))
+    {
+      this->successful = false;
+      return;
+    }
+    char *p = buf;
+    for (unsigned int i = 0; i < order.length; i++)
+    {
+      memcpy (p, packed[order[i]].head, packed[order[i]].length);
+      p += packed[order[i]].length;
+    }
+    for (unsigned int i = 1; i < count; i++)
+      packed[i].head = nullptr;
+    this->tail = this->end - size;
+    memcpy (this->tail, buf, size);
+    free (buf);
+    p = this->tail;
+    for (unsigned int i = 0; i < order.length; i++)
+    {
+      packed[order[i]].head = p;
+      p += packed[order[i]].length;
+    }
+  }
+
+  void resolve_links ()
+  {
+    /* Whatever the root does not reach has no parents, or parents that
+     * are themselves unreachable; either way some object has none. */
+    bool orphans = false;
+    {
+      hb_vector_t<bool> linked;
+      if (unlikely (!linked.resize (packed.length)))
+      {
+	this->successful = false;
+	return;
+      }
+      for (unsigned int i = 0; i < packed_links.length; i++)
+	linked[packed_links[i].objidx] = true;
+      for (unsigned int i = 1; i + 1 < packed.length; i++)
+	orphans = orphans || !linked[i];
+    }
+    if (orphans || !offsets_fit ())
+    {
+      repack ();
+      if (unlikely (!this->successful)) return;
+      if (unlikely (!offsets_fit ()))
+      {
+	DEBUG_MSG_LEVEL (SERIALIZE, this->start, 0, 0, "offset overflow");
+	this->successful = false;
+	return;
+      }
+    }
+
+    for (unsigned int i = 1; i < packed.length; i++)
+    {
+      const object_t &object = packed[i];
+      if (!object.head) continue;
+      for (unsigned int j = 0; j < object.num_links; j++)
+      {
+	const link_t &link = packed_links[object.links_start + j];
+	unsigned int offset = packed[link.objidx].head - (object.head + link.bias);
+	uint8_t *p = (uint8_t *) object.head + link.position;
+	if (link.is_wide)
+	{
+	  *p++ = offset >> 24;
+	  *p++ = offset >> 16;
+	}
+	*p++ = offset >> 8;
+	*p++ = offset;
+      }
+    }
+  }
+
+  /* A binary heap of objects by distance; among equals, the one packed
+   * later, as packing would have placed it, comes first. */
+  struct queue_item_t
+  {
+    bool operator < (const queue_item_t &o) const
+    { return distance != o.distance ? distance < o.distance : objidx > o.objidx; }
+
+    uint64_t distance;
+    objidx_t objidx;
+  };
+  static void queue_push (hb_vector_t<queue_item_t> &queue, uint64_t distance, objidx_t objidx)
+  {
+    queue_item_t item = {distance, objidx};
+    unsigned int i = queue.length;
+    if (unlikely (!queue.resize (i + 1))) return;
+    for (; i && item < queue[(i - 1) / 2]; i = (i - 1) / 2)
+      queue[i] = queue[(i - 1) / 2];
+    queue[i] = item;
+  }
+  static objidx_t queue_pop (hb_vector_t<queue_item_t> &queue)
+  {
+    objidx_t objidx = queue[0].objidx;
+    queue_item_t item = queue[queue.length - 1];
+    queue.pop ();
+    unsigned int count = queue.length;
+    unsigned int i = 0;
+    for (;;)
+    {
+      unsigned int child = 2 * i + 1;
+      if (child >= count) break;
+      if (child + 1 < count && queue[child + 1] < queue[child]) child++;
+      if (!(queue[child] < item)) break;
+      queue[i] = queue[child];
+      i = child;
+    }
+    if (count) queue[i] = item;
+    return objidx;
+  }
+
+  frame_t current;
+  hb_vector_t<frame_t> frames;		/* Enclosing objects of current. */
+  hb_vector_t<link_t> links;		/* Of current and enclosing objects. */
+  hb_vector_t<object_t> packed;		/* Indexed by objidx_t. */
+  hb_vector_t<link_t> packed_links;
+  hb_map_t packed_map;			/* Hash to last packed objidx_t. */
 };
 
 
@@ -830,6 +1271,27 @@ struct hb_lazy_loader_t : hb_data_wrapper_t<Data, WheresData>
   {
     return this->instance.get_relaxed ();
   }
+  /* Without loading; nullptr if not loaded, or failed to. */
+  const Stored * get_stored_if_loaded () const
+  {
+    Stored *p = this->instance.get ();
+    return p == Funcs::get_null () ? nullptr : p;
+  }
+
+  /* Unloads the instance, to be created again on next use; returns it
+   * for the caller to free with destroy_detached() once no thread can
+   * still be using it, or nullptr if there was none. */
+  Stored * detach () const
+  {
+  retry:
+    Stored *p = this->instance.get ();
+    if (!p || p == Funcs::get_null ())
+      return nullptr;
+    if (unlikely (!cmpexch (p, nullptr)))
+      goto retry;
+    return p;
+  }
+  static void destroy_detached (void *p) { do_destroy ((Stored *) p); }
 
   bool cmpexch (Stored *current, Stored *value) const
   {
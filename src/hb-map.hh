@@ -33,8 +33,15 @@
 template <typename T>
 inline uint32_t Hash (const T &v)
 {
-  /* Knuth's multiplicative method: */
-  return (uint32_t) v * 2654435761u;
+  /* The MurmurHash3 finalizer; mixes all bits, so that runs of
+   * sequential keys (eg. glyph ids) don't cluster. */
+  uint32_t h = (uint32_t) v;
+  h ^= h >> 16;
+  h *= 0x85EBCA6Bu;
+  h ^= h >> 13;
+  h *= 0xC2B2AE35u;
+  h ^= h >> 16;
+  return h;
 }
 
 
@@ -62,16 +69,22 @@ struct hb_map_t
   unsigned int population; /* Not including tombstones. */
   unsigned int occupancy; /* Including tombstones. */
   unsigned int mask;
-  unsigned int prime;
   item_t *items;
+  /* When frozen with dense keys, the values are in direct, indexed by
+   * key, and items is nullptr.  See freeze(). */
+  bool frozen;
+  hb_codepoint_t *direct;
+  unsigned int direct_length;
 
   void init_shallow ()
   {
     successful = true;
     population = occupancy = 0;
     mask = 0;
-    prime = 0;
     items = nullptr;
+    frozen = false;
+    direct = nullptr;
+    direct_length = 0;
   }
   void init ()
   {
@@ -82,6 +95,10 @@ struct hb_map_t
   {
     free (items);
     items = nullptr;
+    free (direct);
+    direct = nullptr;
+    direct_length = 0;
+    frozen = false;
   }
   void fini ()
   {
@@ -92,11 +109,12 @@ struct hb_map_t
 
   bool in_error () const { return !successful; }
 
-  bool resize ()
+  /* Rehashes into a table sized for at least min_population items. */
+  bool resize (unsigned int min_population = 0)
   {
     if (unlikely (!successful)) return false;
 
-    unsigned int power = hb_bit_storage (population * 2 + 8);
+    unsigned int power = hb_bit_storage (MAX (population, min_population) * 2 + 8);
     unsigned int new_size = 1u << power;
     item_t *new_items = (item_t *) malloc ((size_t) new_size * sizeof (item_t));
     if (unlikely (!new_items))
@@ -112,7 +130,6 @@ struct hb_map_t
     /* Switch to new, empty, array. */
     population = occupancy = 0;
     mask = new_size - 1;
-    prime = prime_for (power);
     items = new_items;
 
     /* Insert back old items. */
@@ -126,10 +143,22 @@ struct hb_map_t
     return true;
   }
 
+  /* Makes room for count more items, so that adding that many does not
+   * rehash. */
+  bool alloc (unsigned int count)
+  {
+    if (unlikely (!successful)) return false;
+    if (frozen && unlikely (!thaw ())) return false;
+    unsigned int needed = occupancy + count;
+    if (needed + needed / 2 < mask) return true;
+    return resize (population + count);
+  }
+
   void set (hb_codepoint_t key, hb_codepoint_t value)
   {
     if (unlikely (!successful)) return;
     if (unlikely (key == INVALID)) return;
+    if (frozen && unlikely (!thaw ())) return;
     if ((occupancy + occupancy / 2) >= mask && !resize ()) return;
     unsigned int i = bucket_for (key);
 
@@ -139,7 +168,7 @@ struct hb_map_t
     if (!items[i].is_unused ())
     {
       occupancy--;
-      if (items[i].is_tombstone ())
+      if (!items[i].is_tombstone ())
 	population--;
     }
 
@@ -153,6 +182,7 @@ struct hb_map_t
   }
   hb_codepoint_t get (hb_codepoint_t key) const
   {
+    if (direct) return key < direct_length ? direct[key] : INVALID;
     if (unlikely (!items)) return INVALID;
     unsigned int i = bucket_for (key);
     return items[i].key == key ? items[i].value : INVALID;
@@ -170,19 +200,96 @@ struct hb_map_t
 
   void clear ()
   {
-    memset (items, 0xFF, ((size_t) mask + 1) * sizeof (item_t));
+    if (frozen)
+    {
+      free (direct);
+      direct = nullptr;
+      direct_length = 0;
+      frozen = false;
+    }
+    if (items)
+      memset (items, 0xFF, ((size_t) mask + 1) * sizeof (item_t));
     population = occupancy = 0;
   }
 
+  /* Switches to a compact read-only layout, for maps that are done
+   * changing: if the keys are dense, an array indexed by key, which is
+   * a perfect hash; otherwise a table rehashed to the smallest size,
+   * without tombstones.  Modifying the map afterwards thaws it. */
+  void freeze ()
+  {
+    if (unlikely (!successful) || frozen) return;
+
+    hb_codepoint_t max_key = 0;
+    for (unsigned int i = 0; items && i <= mask; i++)
+      if (!items[i].is_unused () && !items[i].is_tombstone ())
+	max_key = MAX (max_key, items[i].key);
+
+    /* An array entry is half the size of an item, and the table is
+     * at most three-quarters full; use the array while it's no larger
+     * than about twice the table. */
+    if (population && max_key < population * 4)
+    {
+      direct = (hb_codepoint_t *) malloc ((size_t) (max_key + 1) * sizeof (direct[0]));
+      if (unlikely (!direct))
+      {
+	successful = false;
+	return;
+      }
+      memset (direct, 0xFF, (size_t) (max_key + 1) * sizeof (direct[0]));
+      for (unsigned int i = 0; i <= mask; i++)
+	if (!items[i].is_unused () && !items[i].is_tombstone ())
+	  direct[items[i].key] = items[i].value;
+      direct_length = max_key + 1;
+
+      free (items);
+      items = nullptr;
+      mask = 0;
+      occupancy = population;
+    }
+    else if (occupancy != population || (mask + 1) / 4 > population + 8)
+      resize ();
+
+    frozen = true;
+  }
+
   bool is_empty () const { return population == 0; }
 
   unsigned int get_population () const { return population; }
 
+  /* Heap bytes held by the table. */
+  unsigned int get_memory_usage () const
+  {
+    if (direct) return direct_length * sizeof (direct[0]);
+    return items ? (mask + 1) * sizeof (items[0]) : 0;
+  }
+
   protected:
 
+  bool thaw ()
+  {
+    frozen = false;
+    if (!direct)
+      return true;
+
+    hb_codepoint_t *values = direct;
+    unsigned int length = direct_length;
+    unsigned int count = population;
+    direct = nullptr;
+    direct_length = 0;
+    population = occupancy = 0;
+
+    bool ret = resize (count);
+    for (unsigned int i = 0; ret && i < length; i++)
+      if (values[i] != INVALID)
+	set (i, values[i]);
+    free (values);
+    return ret && successful;
+  }
+
   unsigned int bucket_for (hb_codepoint_t key) const
   {
-    unsigned int i = Hash (key) % prime;
+    unsigned int i = Hash (key) & mask;
     unsigned int step = 0;
     unsigned int tombstone = INVALID;
     while (!items[i].is_unused ())
@@ -195,57 +302,6 @@ struct hb_map_t
     }
     return tombstone == INVALID ? i : tombstone;
   }
-
-  static unsigned int prime_for (unsigned int shift)
-  {
-    /* Following comment and table copied from glib. */
-    /* Each table size has an associated prime modulo (the first prime
-     * lower than the table size) used to find the initial bucket. Probing
-     * then works modulo 2^n. The prime modulo is necessary to get a
-     * good distribution with poor hash functions.
-     */
-    /* Not declaring static to make all kinds of compilers happy... */
-    /*static*/ const unsigned int prime_mod [32] =
-    {
-      1,          /* For 1 << 0 */
-      2,
-      3,
-      7,
-      13,
-      31,
-      61,
-      127,
-      251,
-      509,
-      1021,
-      2039,
-      4093,
-      8191,
-      16381,
-      32749,
-      65521,      /* For 1 << 16 */
-      131071,
-      262139,
-      524287,
-      1048573,
-      2097143,
-      4194301,
-      8388593,
-      16777213,
-      33554393,
-      67108859,
-      134217689,
-      268435399,
-      536870909,
-      1073741789,
-      2147483647  /* For 1 << 31 */
-    };
-
-    if (unlikely (shift >= ARRAY_LENGTH (prime_mod)))
-      return prime_mod[ARRAY_LENGTH (prime_mod) - 1];
-
-    return prime_mod[shift];
-  }
 };
 
 
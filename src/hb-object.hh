@@ -38,104 +38,6 @@
 #include "hb-vector.hh"
 
 
-/*
- * Lockable set
- */
-
-template <typename item_t, typename lock_t>
-struct hb_lockable_set_t
-{
-  hb_vector_t<item_t> items;
-
-  void init () { items.init (); }
-
-  template <typename T>
-  item_t *replace_or_insert (T v, lock_t &l, bool replace)
-  {
-    l.lock ();
-    item_t *item = items.find (v);
-    if (item) {
-      if (replace) {
-	item_t old = *item;
-	*item = v;
-	l.unlock ();
-	old.fini ();
-      }
-      else {
-        item = nullptr;
-	l.unlock ();
-      }
-    } else {
-      item = items.push (v);
-      l.unlock ();
-    }
-    return item;
-  }
-
-  template <typename T>
-  void remove (T v, lock_t &l)
-  {
-    l.lock ();
-    item_t *item = items.find (v);
-    if (item)
-    {
-      item_t old = *item;
-      *item = items[items.length - 1];
-      items.pop ();
-      l.unlock ();
-      old.fini ();
-    } else {
-      l.unlock ();
-    }
-  }
-
-  template <typename T>
-  bool find (T v, item_t *i, lock_t &l)
-  {
-    l.lock ();
-    item_t *item = items.find (v);
-    if (item)
-      *i = *item;
-    l.unlock ();
-    return !!item;
-  }
-
-  template <typename T>
-  item_t *find_or_insert (T v, lock_t &l)
-  {
-    l.lock ();
-    item_t *item = items.find (v);
-    if (!item) {
-      item = items.push (v);
-    }
-    l.unlock ();
-    return item;
-  }
-
-  void fini (lock_t &l)
-  {
-    if (!items.length)
-    {
-      /* No need to lock. */
-      items.fini ();
-      return;
-    }
-    l.lock ();
-    while (items.length)
-    {
-      item_t old = items[items.length - 1];
-      items.pop ();
-      l.unlock ();
-      old.fini ();
-      l.lock ();
-    }
-    items.fini ();
-    l.unlock ();
-  }
-
-};
-
-
 /*
  * Reference-count.
  */
@@ -165,28 +67,69 @@ struct hb_user_data_array_t
 {
   struct hb_user_data_item_t {
     hb_user_data_key_t *key;
-    void *data;
-    hb_destroy_func_t destroy;
+    hb_atomic_ptr_t<void> data;		/* Read by get() without the lock. */
+    hb_destroy_func_t destroy;		/* Only touched under the lock. */
+
+    bool is_set () const { return data.get_relaxed () || destroy; }
+    void fini () { if (destroy) destroy (data.get_relaxed ()); }
+  };
 
-    bool operator == (hb_user_data_key_t *other_key) const { return key == other_key; }
-    bool operator == (hb_user_data_item_t &other) const { return key == other.key; }
+  /* The items, in an open-addressed hash table at most half full, that
+   * get() reads without locking.  set() changes the data of a key already
+   * in the table in place, and leaves removed keys in with no data; only
+   * for a key new to the object does it publish a new table.  Superseded
+   * tables are kept until fini(), as readers may still be looking at
+   * them; objects only ever see a handful of keys. */
+  struct snapshot_t
+  {
+    snapshot_t *next;		/* Next superseded one. */
+    unsigned int count;
+    unsigned int mask;
+    hb_user_data_item_t items[VAR];
+
+    static unsigned int hash (const hb_user_data_key_t *key)
+    {
+      unsigned int h = (unsigned int) (uintptr_t) key * 2654435761u;
+      return h ^ (h >> 15);
+    }
 
-    void fini () { if (destroy) destroy (data); }
+    hb_user_data_item_t *find (const hb_user_data_key_t *key)
+    {
+      for (unsigned int i = hash (key) & mask; items[i].key; i = (i + 1) & mask)
+	if (items[i].key == key)
+	  return &items[i];
+      return nullptr;
+    }
+
+    void add (const hb_user_data_item_t &item)
+    {
+      unsigned int i = hash (item.key) & mask;
+      while (items[i].key)
+	i = (i + 1) & mask;
+      items[i] = item;
+      count++;
+    }
   };
 
-  hb_mutex_t lock;
-  hb_lockable_set_t<hb_user_data_item_t, hb_mutex_t> items;
+  hb_mutex_t lock;			/* Serializes writers. */
+  hb_atomic_ptr_t<snapshot_t> snapshot;
+  snapshot_t *superseded;
 
-  void init () { lock.init (); items.init (); }
+  void init () { lock.init (); snapshot.init (); superseded = nullptr; }
 
   HB_INTERNAL bool set (hb_user_data_key_t *key,
 			void *              data,
 			hb_destroy_func_t   destroy,
 			hb_bool_t           replace);
 
-  HB_INTERNAL void *get (hb_user_data_key_t *key);
+  void *get (hb_user_data_key_t *key) const
+  {
+    snapshot_t *current = snapshot.get ();
+    hb_user_data_item_t *item = current ? current->find (key) : nullptr;
+    return item ? item->data.get () : nullptr;
+  }
 
-  void fini () { items.fini (lock); lock.fini (); }
+  HB_INTERNAL void fini ();
 };
 
 
@@ -118,10 +118,15 @@ typedef struct OffsetTable
 
   public:
 
+  /* Writes the table directory only; the table data is expected to
+   * follow it in the order of @items, each table padded to four bytes.
+   * If @patched_head is not nullptr, it must be a writable copy of the
+   * head table in @items, which then gets its checkSumAdjustment set. */
   template <typename item_t>
   bool serialize (hb_serialize_context_t *c,
 		  hb_tag_t sfnt_tag,
-		  hb_array_t<item_t> items)
+		  hb_array_t<item_t> items,
+		  head *patched_head = nullptr)
   {
     TRACE_SERIALIZE (this);
     /* Alloc 12 for the OTHeader. */
@@ -133,45 +138,34 @@ typedef struct OffsetTable
     if (unlikely (!tables.serialize (c, items.length))) return_trace (false);
 
     const char *dir_end = (const char *) c->head;
-    HBUINT32 *checksum_adjustment = nullptr;
+    unsigned int offset = dir_end - (const char *) this;
 
-    /* Write OffsetTables, alloc for and write actual table blobs. */
+    if (patched_head)
+      patched_head->checkSumAdjustment.set (0);
+
+    /* Write OffsetTables. */
     for (unsigned int i = 0; i < tables.len; i++)
     {
       TableRecord &rec = tables.arrayZ[i];
       hb_blob_t *blob = items[i].blob;
+      const char *data = hb_blob_get_data (blob, nullptr);
       rec.tag.set (items[i].tag);
       rec.length.set (hb_blob_get_length (blob));
-      rec.offset.serialize (c, this);
-
-      /* Allocate room for the table and copy it. */
-      char *start = (char *) c->allocate_size<void> (rec.length);
-      if (unlikely (!start)) {return false;}
-
-      memcpy (start, hb_blob_get_data (blob, nullptr), rec.length);
+      rec.offset.set (offset);
+      offset += hb_ceil_to_4 (rec.length);
 
-      /* 4-byte alignment. */
-      c->align (4);
-      const char *end = (const char *) c->head;
-
-      if (items[i].tag == HB_OT_TAG_head && end - start >= head::static_size)
-      {
-	head *h = (head *) start;
-	checksum_adjustment = &h->checkSumAdjustment;
-	checksum_adjustment->set (0);
-      }
+      if (patched_head && items[i].tag == HB_OT_TAG_head)
+	data = (const char *) patched_head;
 
-      rec.checkSum.set_for_data (start, end - start);
+      rec.checkSum.set_for_unpadded_data (data, rec.length);
     }
 
     tables.qsort ();
 
-    if (checksum_adjustment)
+    if (patched_head)
     {
       CheckSum checksum;
 
-      /* The following line is a slower version of the following block. */
-      //checksum.set_for_data (this, (const char *) c->head - (const char *) this);
       checksum.set_for_data (this, dir_end - (const char *) this);
       for (unsigned int i = 0; i < items.length; i++)
       {
@@ -179,7 +173,7 @@ typedef struct OffsetTable
 	checksum.set (checksum + rec.checkSum);
       }
 
-      checksum_adjustment->set (0xB1B0AFBAu - checksum);
+      patched_head->checkSumAdjustment.set (0xB1B0AFBAu - checksum);
     }
 
     return_trace (true);
@@ -483,12 +477,13 @@ struct OpenTypeFontFile
   template <typename item_t>
   bool serialize_single (hb_serialize_context_t *c,
 			 hb_tag_t sfnt_tag,
-			 hb_array_t<item_t> items)
+			 hb_array_t<item_t> items,
+			 head *patched_head = nullptr)
   {
     TRACE_SERIALIZE (this);
     assert (sfnt_tag != TTCTag);
     if (unlikely (!c->extend_min (*this))) return_trace (false);
-    return_trace (u.fontFace.serialize (c, sfnt_tag, items));
+    return_trace (u.fontFace.serialize (c, sfnt_tag, items, patched_head));
   }
 
   bool sanitize (hb_sanitize_context_t *c) const
@@ -207,6 +207,21 @@ struct CheckSum : HBUINT32
   void set_for_data (const void *data, unsigned int length)
   { set (CalcTableChecksum ((const HBUINT32 *) data, length)); }
 
+  /* As above, but for data of any length; the tail is treated as
+   * zero-padded to four bytes. */
+  void set_for_unpadded_data (const void *data, unsigned int length)
+  {
+    uint32_t sum = CalcTableChecksum ((const HBUINT32 *) data, length & ~3u);
+    if (length & 3)
+    {
+      HBUINT32 tail;
+      tail.set (0);
+      memcpy (&tail, (const char *) data + (length & ~3u), length & 3);
+      sum += tail;
+    }
+    set (sum);
+  }
+
   public:
   DEFINE_SIZE_STATIC (4);
 };
@@ -271,17 +286,39 @@ struct OffsetTo : Offset<OffsetType, has_null>
     return * (Type *) Offset<OffsetType>::serialize (c, base);
   }
 
+  /* Subsets src into an object of its own and points at that; returns
+   * whether anything was left of it. */
   template <typename T>
-  void serialize_subset (hb_subset_context_t *c, const T &src, const void *base)
+  bool serialize_subset (hb_subset_context_t *c, const T &src, const void *base)
   {
+    this->set (0);
     if (&src == &Null (T))
+      return false;
+    hb_serialize_context_t *s = c->serializer;
+    s->push ();
+    if (!src.subset (c))
     {
-      this->set (0);
-      return;
+      s->pop_discard ();
+      return false;
     }
-    serialize (c->serializer, base);
-    if (!src.subset (c))
-      this->set (0);
+    s->add_link (*this, s->pop_pack (), base);
+    return true;
+  }
+
+  /* Serializes a Type from src into an object of its own, and points at
+   * that, so that identical ones are shared. */
+  template <typename T>
+  bool serialize_serialize (hb_serialize_context_t *c, const T &src, const void *base)
+  {
+    this->set (0);
+    c->push ();
+    if (unlikely (!c->start_embed<Type> ()->serialize (c, src)))
+    {
+      c->pop_discard ();
+      return false;
+    }
+    c->add_link (*this, c->pop_pack (), base);
+    return true;
   }
 
   bool sanitize_shallow (hb_sanitize_context_t *c, const void *base) const
@@ -626,12 +626,19 @@ struct FDSelect3_4 {
 
   hb_codepoint_t get_fd (hb_codepoint_t glyph) const
   {
-    unsigned int i;
-    for (i = 1; i < nRanges; i++)
-      if (glyph < ranges[i].first)
-	break;
+    /* Find the last range starting at or before glyph; sanitize() made
+     * sure ranges are sorted. */
+    unsigned int lo = 1, hi = nRanges;
+    while (lo < hi)
+    {
+      unsigned int mid = (lo + hi) / 2;
+      if (glyph < ranges[mid].first)
+	hi = mid;
+      else
+	lo = mid + 1;
+    }
 
-    return (hb_codepoint_t)ranges[i - 1].fd;
+    return (hb_codepoint_t)ranges[lo - 1].fd;
   }
 
   GID_TYPE &sentinel ()  { return StructAfter<GID_TYPE> (ranges[nRanges - 1]); }
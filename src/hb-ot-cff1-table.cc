@@ -121,6 +121,78 @@ static const uint8_t standard_encoding_to_sid [] =
     0,   144,   0,    0,    0,  145,    0,    0,  146,  147,  148,  149,    0,    0,    0,    0
 };
 
+/* SID to standard string */
+static const char * const standard_strings [] =
+{
+  ".notdef", "space", "exclam", "quotedbl", "numbersign", "dollar",
+  "percent", "ampersand", "quoteright", "parenleft", "parenright",
+  "asterisk", "plus", "comma", "hyphen", "period", "slash", "zero", "one",
+  "two", "three", "four", "five", "six", "seven", "eight", "nine", "colon",
+  "semicolon", "less", "equal", "greater", "question", "at", "A", "B", "C",
+  "D", "E", "F", "G", "H", "I", "J", "K", "L", "M", "N", "O", "P", "Q", "R",
+  "S", "T", "U", "V", "W", "X", "Y", "Z", "bracketleft", "backslash",
+  "bracketright", "asciicircum", "underscore", "quoteleft", "a", "b", "c",
+  "d", "e", "f", "g", "h", "i", "j", "k", "l", "m", "n", "o", "p", "q", "r",
+  "s", "t", "u", "v", "w", "x", "y", "z", "braceleft", "bar", "braceright",
+  "asciitilde", "exclamdown", "cent", "sterling", "fraction", "yen",
+  "florin", "section", "currency", "quotesingle", "quotedblleft",
+  "guillemotleft", "guilsinglleft", "guilsinglright", "fi", "fl", "endash",
+  "dagger", "daggerdbl", "periodcentered", "paragraph", "bullet",
+  "quotesinglbase", "quotedblbase", "quotedblright", "guillemotright",
+  "ellipsis", "perthousand", "questiondown", "grave", "acute", "circumflex",
+  "tilde", "macron", "breve", "dotaccent", "dieresis", "ring", "cedilla",
+  "hungarumlaut", "ogonek", "caron", "emdash", "AE", "ordfeminine", "Lslash",
+  "Oslash", "OE", "ordmasculine", "ae", "dotlessi", "lslash", "oslash", "oe",
+  "germandbls", "onesuperior", "logicalnot", "mu", "trademark", "Eth",
+  "onehalf", "plusminus", "Thorn", "onequarter", "divide", "brokenbar",
+  "degree", "thorn", "threequarters", "twosuperior", "registered", "minus",
+  "eth", "multiply", "threesuperior", "copyright", "Aacute", "Acircumflex",
+  "Adieresis", "Agrave", "Aring", "Atilde", "Ccedilla", "Eacute",
+  "Ecircumflex", "Edieresis", "Egrave", "Iacute", "Icircumflex", "Idieresis",
+  "Igrave", "Ntilde", "Oacute", "Ocircumflex", "Odieresis", "Ograve",
+  "Otilde", "Scaron", "Uacute", "Ucircumflex", "Udieresis", "Ugrave",
+  "Yacute", "Ydieresis", "Zcaron", "aacute", "acircumflex", "adieresis",
+  "agrave", "aring", "atilde", "ccedilla", "eacute", "ecircumflex",
+  "edieresis", "egrave", "iacute", "icircumflex", "idieresis", "igrave",
+  "ntilde", "oacute", "ocircumflex", "odieresis", "ograve", "otilde",
+  "scaron", "uacute", "ucircumflex", "udieresis", "ugrave", "yacute",
+  "ydieresis", "zcaron", "exclamsmall", "Hungarumlautsmall",
+  "dollaroldstyle", "dollarsuperior", "ampersandsmall", "Acutesmall",
+  "parenleftsuperior", "parenrightsuperior", "twodotenleader",
+  "onedotenleader", "zerooldstyle", "oneoldstyle", "twooldstyle",
+  "threeoldstyle", "fouroldstyle", "fiveoldstyle", "sixoldstyle",
+  "sevenoldstyle", "eightoldstyle", "nineoldstyle", "commasuperior",
+  "threequartersemdash", "periodsuperior", "questionsmall", "asuperior",
+  "bsuperior", "centsuperior", "dsuperior", "esuperior", "isuperior",
+  "lsuperior", "msuperior", "nsuperior", "osuperior", "rsuperior",
+  "ssuperior", "tsuperior", "ff", "ffi", "ffl", "parenleftinferior",
+  "parenrightinferior", "Circumflexsmall", "hyphensuperior", "Gravesmall",
+  "Asmall", "Bsmall", "Csmall", "Dsmall", "Esmall", "Fsmall", "Gsmall",
+  "Hsmall", "Ismall", "Jsmall", "Ksmall", "Lsmall", "Msmall", "Nsmall",
+  "Osmall", "Psmall", "Qsmall", "Rsmall", "Ssmall", "Tsmall", "Usmall",
+  "Vsmall", "Wsmall", "Xsmall", "Ysmall", "Zsmall", "colonmonetary",
+  "onefitted", "rupiah", "Tildesmall", "exclamdownsmall", "centoldstyle",
+  "Lslashsmall", "Scaronsmall", "Zcaronsmall", "Dieresissmall", "Brevesmall",
+  "Caronsmall", "Dotaccentsmall", "Macronsmall", "figuredash",
+  "hypheninferior", "Ogoneksmall", "Ringsmall", "Cedillasmall",
+  "questiondownsmall", "oneeighth", "threeeighths", "fiveeighths",
+  "seveneighths", "onethird", "twothirds", "zerosuperior", "foursuperior",
+  "fivesuperior", "sixsuperior", "sevensuperior", "eightsuperior",
+  "ninesuperior", "zeroinferior", "oneinferior", "twoinferior",
+  "threeinferior", "fourinferior", "fiveinferior", "sixinferior",
+  "seveninferior", "eightinferior", "nineinferior", "centinferior",
+  "dollarinferior", "periodinferior", "commainferior", "Agravesmall",
+  "Aacutesmall", "Acircumflexsmall", "Atildesmall", "Adieresissmall",
+  "Aringsmall", "AEsmall", "Ccedillasmall", "Egravesmall", "Eacutesmall",
+  "Ecircumflexsmall", "Edieresissmall", "Igravesmall", "Iacutesmall",
+  "Icircumflexsmall", "Idieresissmall", "Ethsmall", "Ntildesmall",
+  "Ogravesmall", "Oacutesmall", "Ocircumflexsmall", "Otildesmall",
+  "Odieresissmall", "OEsmall", "Oslashsmall", "Ugravesmall", "Uacutesmall",
+  "Ucircumflexsmall", "Udieresissmall", "Yacutesmall", "Thornsmall",
+  "Ydieresissmall", "001.000", "001.001", "001.002", "001.003", "Black",
+  "Bold", "Book", "Light", "Medium", "Regular", "Roman", "Semibold",
+};
+
 hb_codepoint_t OT::cff1::lookup_standard_encoding_for_code (hb_codepoint_t sid)
 {
   if (sid < ARRAY_LENGTH (standard_encoding_to_code))
@@ -161,6 +233,15 @@ hb_codepoint_t OT::cff1::lookup_standard_encoding_for_sid (hb_codepoint_t code)
     return CFF_UNDEF_SID;
 }
 
+hb_bytes_t OT::cff1::lookup_standard_string (hb_codepoint_t sid)
+{
+  static_assert ((ARRAY_LENGTH_CONST (standard_strings) == CFF1_NUM_STD_STRINGS), "");
+  if (sid < ARRAY_LENGTH (standard_strings))
+    return hb_bytes_t (standard_strings[sid], strlen (standard_strings[sid]));
+  else
+    return hb_bytes_t ();
+}
+
 struct bounds_t
 {
   void init ()
@@ -291,9 +372,9 @@ bool _get_bounds (const OT::cff1::accelerator_t *cff, hb_codepoint_t glyph, boun
   bounds.init ();
   if (unlikely (!cff->is_valid () || (glyph >= cff->num_glyphs))) return false;
 
-  unsigned int fd = cff->fdSelect->get_fd (glyph);
+  unsigned int fd = cff->get_fd (glyph);
   cff1_cs_interpreter_t<cff1_cs_opset_extents_t, extents_param_t> interp;
-  const byte_str_t str = (*cff->charStrings)[glyph];
+  const byte_str_t str = cff->charStringsAccel[glyph];
   interp.env.init (str, *cff, fd);
   interp.env.set_in_seac (in_seac);
   extents_param_t  param;
@@ -303,8 +384,37 @@ bool _get_bounds (const OT::cff1::accelerator_t *cff, hb_codepoint_t glyph, boun
   return true;
 }
 
+hb_extents_cache_t *OT::cff1::accelerator_t::get_extents_cache () const
+{
+#ifdef HB_NO_CFF1_EXTENTS_CACHE
+  return nullptr;
+#else
+retry:
+  hb_extents_cache_t *cache = extents_cache.get ();
+  if (unlikely (!cache))
+  {
+    cache = (hb_extents_cache_t *) calloc (1, sizeof (hb_extents_cache_t));
+    if (unlikely (!cache))
+      return nullptr;
+    cache->init ();
+    if (unlikely (!extents_cache.cmpexch (nullptr, cache)))
+    {
+      free (cache);
+      goto retry;
+    }
+  }
+  return cache;
+#endif
+}
+
 bool OT::cff1::accelerator_t::get_extents (hb_codepoint_t glyph, hb_glyph_extents_t *extents) const
 {
+  if (unlikely (!is_valid ())) return false;
+
+  hb_extents_cache_t *cache = get_extents_cache ();
+  if (cache && cache->get (glyph, extents))
+    return true;
+
   bounds_t  bounds;
 
   if (!_get_bounds (this, glyph, bounds))
@@ -331,6 +441,8 @@ bool OT::cff1::accelerator_t::get_extents (hb_codepoint_t glyph, hb_glyph_extent
     extents->height = (int32_t)bounds.min.y.floor () - extents->y_bearing;
   }
 
+  if (cache)
+    cache->set (glyph, extents);
   return true;
 }
 
@@ -367,9 +479,9 @@ bool OT::cff1::accelerator_t::get_seac_components (hb_codepoint_t glyph, hb_code
 {
   if (unlikely (!is_valid () || (glyph >= num_glyphs))) return false;
 
-  unsigned int fd = fdSelect->get_fd (glyph);
+  unsigned int fd = get_fd (glyph);
   cff1_cs_interpreter_t<cff1_cs_opset_seac_t, get_seac_param_t> interp;
-  const byte_str_t str = (*charStrings)[glyph];
+  const byte_str_t str = charStringsAccel[glyph];
   interp.env.init (str, *this, fd);
   get_seac_param_t  param;
   param.init (this);
@@ -383,3 +495,51 @@ bool OT::cff1::accelerator_t::get_seac_components (hb_codepoint_t glyph, hb_code
   }
   return false;
 }
+
+const hb_glyph_name_index_t *OT::cff1::accelerator_t::get_name_index () const
+{
+retry:
+  hb_glyph_name_index_t *index = name_index.get ();
+
+  if (unlikely (!index))
+  {
+    glyph_name_func_t names = {this};
+    index = hb_glyph_name_index_t::create (names, num_glyphs);
+    if (unlikely (!index))
+      return nullptr;
+
+    if (unlikely (!name_index.cmpexch (nullptr, index)))
+    {
+      index->destroy ();
+      goto retry;
+    }
+  }
+  return index;
+}
+
+bool OT::cff1::accelerator_t::get_glyph_name (hb_codepoint_t glyph,
+					      char *buf, unsigned int buf_len) const
+{
+  hb_bytes_t s = find_glyph_name (glyph);
+  if (!s.length) return false;
+  if (!buf_len) return true;
+  unsigned int len = MIN (buf_len - 1, s.length);
+  strncpy (buf, s.arrayZ, len);
+  buf[len] = '\0';
+  return true;
+}
+
+bool OT::cff1::accelerator_t::get_glyph_from_name (const char *name, int len,
+						   hb_codepoint_t *glyph) const
+{
+  if (unlikely (!is_valid () || is_CID ())) return false;
+
+  if (len < 0) len = strlen (name);
+  if (unlikely (!len)) return false;
+
+  const hb_glyph_name_index_t *index = get_name_index ();
+  if (unlikely (!index)) return false;
+
+  glyph_name_func_t names = {this};
+  return index->find (names, hb_bytes_t (name, len), glyph);
+}
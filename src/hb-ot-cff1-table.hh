@@ -29,7 +29,9 @@
 
 #include "hb-ot-head-table.hh"
 #include "hb-ot-cff-common.hh"
+#include "hb-cache.hh"
 #include "hb-subset-cff1.hh"
+#include "hb-ot-glyph-name-index.hh"
 
 namespace CFF {
 
@@ -41,6 +43,9 @@ namespace CFF {
 
 #define CFF_UNDEF_SID   CFF_UNDEF_CODE
 
+/* SIDs below this name the standard strings; the rest index stringIndex. */
+#define CFF1_NUM_STD_STRINGS 391
+
 enum EncodingID { StandardEncoding = 0, ExpertEncoding = 1 };
 enum CharsetID { ISOAdobeCharset = 0, ExpertCharset = 1, ExpertSubsetCharset = 2 };
 
@@ -860,8 +865,16 @@ struct cff1_private_dict_values_base_t : dict_values_t<VAL>
     dict_values_t<VAL>::init ();
     subrsOffset = 0;
     localSubrs = &Null(CFF1Subrs);
+    localSubrsAccel.init (localSubrs);
+  }
+  void fini ()
+  {
+    dict_values_t<VAL>::fini ();
+    localSubrsAccel.fini ();
   }
-  void fini () { dict_values_t<VAL>::fini (); }
+
+  unsigned int get_memory_usage () const
+  { return dict_values_t<VAL>::get_memory_usage () + localSubrsAccel.get_memory_usage (); }
 
   unsigned int calculate_serialized_size () const
   {
@@ -876,6 +889,7 @@ struct cff1_private_dict_values_base_t : dict_values_t<VAL>
 
   unsigned int      subrsOffset;
   const CFF1Subrs    *localSubrs;
+  index_accelerator_t<CFF1Subrs> localSubrsAccel;
 };
 
 typedef cff1_private_dict_values_base_t<op_str_t> cff1_private_dict_values_subset_t;
@@ -1001,6 +1015,10 @@ struct cff1
       topDict.init ();
       fontDicts.init ();
       privateDicts.init ();
+      glyph_fds.init ();
+      glyph_sids.init ();
+      globalSubrsAccel.init (&Null(CFF1Subrs));
+      charStringsAccel.init (&Null(CFF1CharStrings));
 
       this->blob = sc.reference_table<cff1> (face);
 
@@ -1102,6 +1120,7 @@ struct cff1
 	  if (priv->localSubrs != &Null(CFF1Subrs) &&
 	      unlikely (!priv->localSubrs->sanitize (&sc)))
 	  { fini (); return; }
+	  priv->localSubrsAccel.init (priv->localSubrs);
 	}
       }
       else  /* non-CID */
@@ -1120,7 +1139,11 @@ struct cff1
 	if (priv->localSubrs != &Null(CFF1Subrs) &&
 	    unlikely (!priv->localSubrs->sanitize (&sc)))
 	{ fini (); return; }
+	priv->localSubrsAccel.init (priv->localSubrs);
       }
+
+      globalSubrsAccel.init (globalSubrs);
+      charStringsAccel.init (charStrings);
     }
 
     void fini ()
@@ -1129,13 +1152,76 @@ struct cff1
       topDict.fini ();
       fontDicts.fini_deep ();
       privateDicts.fini_deep ();
+      globalSubrsAccel.fini ();
+      charStringsAccel.fini ();
+      free (glyph_fds.get ());
+      free (glyph_sids.get ());
+      glyph_fds.init ();
+      glyph_sids.init ();
       hb_blob_destroy (blob);
       blob = nullptr;
     }
 
     bool is_valid () const { return blob != nullptr; }
+
+    /* Heap bytes held by the parsed dicts; see hb_face_get_memory_usage(). */
+    unsigned int get_memory_usage () const
+    {
+      unsigned int size = topDict.get_memory_usage () +
+			  fontDicts.get_allocated_size () +
+			  privateDicts.get_allocated_size ();
+      for (unsigned int i = 0; i < fontDicts.length; i++)
+	size += fontDicts[i].get_memory_usage ();
+      for (unsigned int i = 0; i < privateDicts.length; i++)
+	size += privateDicts[i].get_memory_usage ();
+      size += globalSubrsAccel.get_memory_usage () + charStringsAccel.get_memory_usage ();
+      if (glyph_fds.get ()) size += num_glyphs * sizeof (uint8_t);
+      if (glyph_sids.get ()) size += num_glyphs * sizeof (uint16_t);
+      return size;
+    }
+
+    hb_codepoint_t get_fd (hb_codepoint_t glyph) const
+    {
+      const uint8_t *fds = fdSelect->format == 3 ? get_glyph_fds () : nullptr;
+      if (fds && likely (glyph < num_glyphs))
+	return fds[glyph];
+      return fdSelect->get_fd (glyph);
+    }
+
+    hb_codepoint_t get_sid (hb_codepoint_t glyph) const
+    {
+      const uint16_t *sids = is_CID () && charset->format != 0 ? get_glyph_sids () : nullptr;
+      if (sids && likely (glyph < num_glyphs))
+	return sids[glyph];
+      return charset->get_sid (glyph);
+    }
     bool is_CID () const { return topDict.is_CID (); }
 
+    hb_codepoint_t glyph_to_sid (hb_codepoint_t glyph) const
+    {
+      if (charset != &Null(Charset))
+	return get_sid (glyph);
+      else
+      {
+	hb_codepoint_t sid = 0;
+	switch (topDict.CharsetOffset)
+	{
+	  case  ISOAdobeCharset:
+	    if (glyph <= 228 /*zcaron*/) sid = glyph;
+	    break;
+	  case  ExpertCharset:
+	    sid = lookup_expert_charset_for_sid (glyph);
+	    break;
+	  case  ExpertSubsetCharset:
+	      sid = lookup_expert_subset_charset_for_sid (glyph);
+	    break;
+	  default:
+	    break;
+	}
+	return sid;
+      }
+    }
+
     bool is_predef_charset () const { return topDict.CharsetOffset <= ExpertSubsetCharset; }
 
     unsigned int std_code_to_glyph (hb_codepoint_t code) const
@@ -1152,8 +1238,54 @@ struct cff1
     }
 
     protected:
+    /* FDSelect format 3 and charset formats 1 and 2 are lists of ranges,
+     * which CID-keyed fonts have many of and look up for every glyph.
+     * These flatten them into per-glyph arrays on first use. */
+    template <typename T, typename Func>
+    T *get_glyph_array (hb_atomic_ptr_t<T> &slot, Func get) const
+    {
+    retry:
+      T *array = slot.get ();
+      if (unlikely (!array))
+      {
+	array = (T *) malloc (num_glyphs * sizeof (T));
+	if (unlikely (!array))
+	  return nullptr;
+	for (unsigned int i = 0; i < num_glyphs; i++)
+	  array[i] = get (i);
+	if (unlikely (!slot.cmpexch (nullptr, array)))
+	{
+	  free (array);
+	  goto retry;
+	}
+      }
+      return array;
+    }
+    struct get_fd_func_t
+    {
+      const FDSelect *fdSelect;
+      uint8_t operator () (hb_codepoint_t glyph) const { return fdSelect->get_fd (glyph); }
+    };
+    struct get_sid_func_t
+    {
+      const Charset *charset;
+      uint16_t operator () (hb_codepoint_t glyph) const { return charset->get_sid (glyph); }
+    };
+    const uint8_t *get_glyph_fds () const
+    {
+      get_fd_func_t get = {fdSelect};
+      return get_glyph_array (glyph_fds, get);
+    }
+    const uint16_t *get_glyph_sids () const
+    {
+      get_sid_func_t get = {charset};
+      return get_glyph_array (glyph_sids, get);
+    }
+
     hb_blob_t	       *blob;
     hb_sanitize_context_t   sc;
+    mutable hb_atomic_ptr_t<uint8_t> glyph_fds;
+    mutable hb_atomic_ptr_t<uint16_t> glyph_sids;
 
     public:
     const Charset	   *charset;
@@ -1162,6 +1294,8 @@ struct cff1
     const CFF1StringIndex   *stringIndex;
     const CFF1Subrs	 *globalSubrs;
     const CFF1CharStrings   *charStrings;
+    index_accelerator_t<CFF1Subrs>	globalSubrsAccel;
+    index_accelerator_t<CFF1CharStrings>	charStringsAccel;
     const CFF1FDArray       *fdArray;
     const CFF1FDSelect      *fdSelect;
     unsigned int	    fdCount;
@@ -1175,8 +1309,75 @@ struct cff1
 
   struct accelerator_t : accelerator_templ_t<cff1_private_dict_opset_t, cff1_private_dict_values_t>
   {
+    void init (hb_face_t *face)
+    {
+      SUPER::init (face);
+      extents_cache.init ();
+      name_index.init ();
+    }
+
+    void fini ()
+    {
+      hb_extents_cache_t *cache = extents_cache.get ();
+      if (cache)
+      {
+	cache->fini ();
+	free (cache);
+      }
+      if (name_index.get ())
+	name_index.get ()->destroy ();
+      SUPER::fini ();
+    }
+
+    unsigned int get_memory_usage () const
+    {
+      return SUPER::get_memory_usage () +
+	     (extents_cache.get () ? sizeof (hb_extents_cache_t) : 0) +
+	     (name_index.get () ? name_index.get ()->get_size () : 0);
+    }
+
     HB_INTERNAL bool get_extents (hb_codepoint_t glyph, hb_glyph_extents_t *extents) const;
     HB_INTERNAL bool get_seac_components (hb_codepoint_t glyph, hb_codepoint_t *base, hb_codepoint_t *accent) const;
+
+    HB_INTERNAL bool get_glyph_name (hb_codepoint_t glyph,
+				     char *buf, unsigned int buf_len) const;
+    HB_INTERNAL bool get_glyph_from_name (const char *name, int len,
+					  hb_codepoint_t *glyph) const;
+
+    /* Hash index of the glyph names, built on first use. */
+    HB_INTERNAL const hb_glyph_name_index_t *get_name_index () const;
+
+    private:
+    HB_INTERNAL hb_extents_cache_t *get_extents_cache () const;
+
+    /* Names come from the charset; CID-keyed fonts have none. */
+    hb_bytes_t find_glyph_name (hb_codepoint_t glyph) const
+    {
+      if (unlikely (!is_valid () || is_CID () || glyph >= num_glyphs))
+	return hb_bytes_t ();
+      hb_codepoint_t sid = glyph_to_sid (glyph);
+      if (!sid && glyph)
+	return hb_bytes_t ();
+      if (sid < CFF1_NUM_STD_STRINGS)
+	return lookup_standard_string (sid);
+      byte_str_t s = (*stringIndex)[sid - CFF1_NUM_STD_STRINGS];
+      return hb_bytes_t ((const char *) s.arrayZ, s.length);
+    }
+
+    struct glyph_name_func_t
+    {
+      const accelerator_t *thiz;
+      hb_bytes_t operator () (hb_codepoint_t glyph) const
+      { return thiz->find_glyph_name (glyph); }
+    };
+
+    mutable hb_atomic_ptr_t<hb_glyph_name_index_t> name_index;
+
+    /* CFF1 outlines do not vary, so extents computed from the charstrings
+     * are shared by every font on the face.  Allocated on first use. */
+    mutable hb_atomic_ptr_t<hb_extents_cache_t> extents_cache;
+
+    typedef accelerator_templ_t<cff1_private_dict_opset_t, cff1_private_dict_values_t> SUPER;
   };
 
   struct accelerator_subset_t : accelerator_templ_t<cff1_private_dict_opset_subset, cff1_private_dict_values_subset_t>
@@ -1228,31 +1429,6 @@ struct cff1
       }
     }
 
-    hb_codepoint_t glyph_to_sid (hb_codepoint_t glyph) const
-    {
-      if (charset != &Null(Charset))
-	return charset->get_sid (glyph);
-      else
-      {
-	hb_codepoint_t sid = 0;
-	switch (topDict.CharsetOffset)
-	{
-	  case  ISOAdobeCharset:
-	    if (glyph <= 228 /*zcaron*/) sid = glyph;
-	    break;
-	  case  ExpertCharset:
-	    sid = lookup_expert_charset_for_sid (glyph);
-	    break;
-	  case  ExpertSubsetCharset:
-	      sid = lookup_expert_subset_charset_for_sid (glyph);
-	    break;
-	  default:
-	    break;
-	}
-	return sid;
-      }
-    }
-
     const Encoding	  *encoding;
 
     private:
@@ -1283,6 +1459,7 @@ struct cff1
   HB_INTERNAL static hb_codepoint_t lookup_expert_charset_for_sid (hb_codepoint_t glyph);
   HB_INTERNAL static hb_codepoint_t lookup_expert_subset_charset_for_sid (hb_codepoint_t glyph);
   HB_INTERNAL static hb_codepoint_t lookup_standard_encoding_for_sid (hb_codepoint_t code);
+  HB_INTERNAL static hb_bytes_t lookup_standard_string (hb_codepoint_t sid);
 
   public:
   FixedVersion<HBUINT8> version;	  /* Version of CFF table. set to 0x0100u */
@@ -253,9 +253,17 @@ struct cff2_private_dict_values_base_t : dict_values_t<VAL>
     dict_values_t<VAL>::init ();
     subrsOffset = 0;
     localSubrs = &Null(CFF2Subrs);
+    localSubrsAccel.init (localSubrs);
     ivs = 0;
   }
-  void fini () { dict_values_t<VAL>::fini (); }
+  void fini ()
+  {
+    dict_values_t<VAL>::fini ();
+    localSubrsAccel.fini ();
+  }
+
+  unsigned int get_memory_usage () const
+  { return dict_values_t<VAL>::get_memory_usage () + localSubrsAccel.get_memory_usage (); }
 
   unsigned int calculate_serialized_size () const
   {
@@ -270,6 +278,7 @@ struct cff2_private_dict_values_base_t : dict_values_t<VAL>
 
   unsigned int      subrsOffset;
   const CFF2Subrs   *localSubrs;
+  index_accelerator_t<CFF2Subrs> localSubrsAccel;
   unsigned int      ivs;
 };
 
@@ -425,6 +434,8 @@ struct cff2
       topDict.init ();
       fontDicts.init ();
       privateDicts.init ();
+      globalSubrsAccel.init (&Null(CFF2Subrs));
+      charStringsAccel.init (&Null(CFF2CharStrings));
 
       this->blob = sc.reference_table<cff2> (face);
 
@@ -490,7 +501,11 @@ struct cff2
 	if (privateDicts[i].localSubrs != &Null(CFF2Subrs) &&
 	  unlikely (!privateDicts[i].localSubrs->sanitize (&sc)))
 	{ fini (); return; }
+	privateDicts[i].localSubrsAccel.init (privateDicts[i].localSubrs);
       }
+
+      globalSubrsAccel.init (globalSubrs);
+      charStringsAccel.init (charStrings);
     }
 
     void fini ()
@@ -499,12 +514,30 @@ struct cff2
       topDict.fini ();
       fontDicts.fini_deep ();
       privateDicts.fini_deep ();
+      globalSubrsAccel.fini ();
+      charStringsAccel.fini ();
       hb_blob_destroy (blob);
       blob = nullptr;
     }
 
     bool is_valid () const { return blob != nullptr; }
 
+    /* Heap bytes held by the parsed dicts; see hb_face_get_memory_usage(). */
+    unsigned int get_memory_usage () const
+    {
+      unsigned int size = topDict.get_memory_usage () +
+			  fontDicts.get_allocated_size () +
+			  privateDicts.get_allocated_size ();
+      for (unsigned int i = 0; i < fontDicts.length; i++)
+	size += fontDicts[i].get_memory_usage ();
+      for (unsigned int i = 0; i < privateDicts.length; i++)
+	size += privateDicts[i].get_memory_usage ();
+      size += globalSubrsAccel.get_memory_usage () + charStringsAccel.get_memory_usage ();
+      return size;
+    }
+
+    hb_codepoint_t get_fd (hb_codepoint_t glyph) const { return fdSelect->get_fd (glyph); }
+
     protected:
     hb_blob_t			*blob;
     hb_sanitize_context_t	sc;
@@ -514,6 +547,8 @@ struct cff2
     const CFF2Subrs		*globalSubrs;
     const CFF2VariationStore	*varStore;
     const CFF2CharStrings	*charStrings;
+    index_accelerator_t<CFF2Subrs>	globalSubrsAccel;
+    index_accelerator_t<CFF2CharStrings>	charStringsAccel;
     const CFF2FDArray		*fdArray;
     const CFF2FDSelect		*fdSelect;
     unsigned int		fdCount;
@@ -29,6 +29,7 @@
 
 #include "hb-open-type.hh"
 #include "hb-set.hh"
+#include "hb-cache.hh"
 
 /*
  * cmap -- Character to Glyph Index Mapping
@@ -36,6 +37,13 @@
  */
 #define HB_OT_TAG_cmap HB_TAG('c','m','a','p')
 
+/* How many code points hb_face_get_nominal_glyphs_coverage() answers by
+ * looking them up one by one, before it builds a BMP coverage bitmap. */
+#ifndef HB_CMAP_BMP_COVERAGE_THRESHOLD
+#define HB_CMAP_BMP_COVERAGE_THRESHOLD 65536
+#endif
+#define HB_CMAP_BMP_COVERAGE_WORDS (0x10000 / 32)
+
 namespace OT {
 
 
@@ -318,6 +326,50 @@ struct CmapSubtableFormat4
       }
     }
 
+    /* Calls sink.add (unicode, glyph) for every mapping get_glyph()
+     * would find, in unicode order.  Returns false, having added
+     * nothing, if the segments are not sorted for get_glyph()'s
+     * bsearch to agree with a walk. */
+    template <typename Sink>
+    bool collect_mapping (Sink &sink) const
+    {
+      unsigned int count = this->segCount;
+      for (unsigned int i = 0; i < count; i++)
+	if (unlikely (this->startCount[i] > this->endCount[i] ||
+		      (i && this->startCount[i] <= this->endCount[i - 1])))
+	  return false;
+
+      if (count && this->startCount[count - 1] == 0xFFFFu)
+	count--; /* Skip sentinel segment. */
+      for (unsigned int i = 0; i < count; i++)
+      {
+	hb_codepoint_t start = this->startCount[i];
+	hb_codepoint_t end = this->endCount[i];
+	unsigned int rangeOffset = this->idRangeOffset[i];
+	unsigned int delta = this->idDelta[i];
+	for (hb_codepoint_t codepoint = start; codepoint <= end; codepoint++)
+	{
+	  hb_codepoint_t gid;
+	  if (rangeOffset == 0)
+	    gid = codepoint + delta;
+	  else
+	  {
+	    unsigned int index = rangeOffset / 2 + (codepoint - start) + i - this->segCount;
+	    if (unlikely (index >= this->glyphIdArrayLength))
+	      break;
+	    gid = this->glyphIdArray[index];
+	    if (unlikely (!gid))
+	      continue;
+	    gid += delta;
+	  }
+	  gid &= 0xFFFFu;
+	  if (gid)
+	    sink.add (codepoint, gid);
+	}
+      }
+      return true;
+    }
+
     const HBUINT16 *endCount;
     const HBUINT16 *startCount;
     const HBUINT16 *idDelta;
@@ -484,6 +536,35 @@ struct CmapSubtableLongSegmented
     }
   }
 
+  /* Calls sink.add (unicode, glyph) for every mapping get_glyph() would
+   * find, in unicode order.  Returns false, having added nothing, if the
+   * groups are not sorted for get_glyph()'s bsearch to agree with a
+   * walk. */
+  template <typename Sink>
+  bool collect_mapping (Sink &sink) const
+  {
+    unsigned int count = this->groups.len;
+    for (unsigned int i = 0; i < count; i++)
+      if (unlikely (this->groups[i].startCharCode > this->groups[i].endCharCode ||
+		    (i && this->groups[i].startCharCode <= this->groups[i - 1].endCharCode)))
+	return false;
+
+    for (unsigned int i = 0; i < count; i++)
+    {
+      const CmapSubtableLongGroup &group = this->groups[i];
+      hb_codepoint_t start = group.startCharCode;
+      hb_codepoint_t end = MIN ((hb_codepoint_t) group.endCharCode,
+				(hb_codepoint_t) HB_UNICODE_MAX);
+      for (hb_codepoint_t codepoint = start; codepoint <= end; codepoint++)
+      {
+	hb_codepoint_t gid = T::group_get_glyph (group, codepoint);
+	if (gid)
+	  sink.add (codepoint, gid);
+      }
+    }
+    return true;
+  }
+
   bool sanitize (hb_sanitize_context_t *c) const
   {
     TRACE_SANITIZE (this);
@@ -999,6 +1080,7 @@ struct cmap
       this->table = hb_sanitize_context_t ().reference_table<cmap> (face);
       bool symbol;
       this->subtable = table->find_best_subtable (&symbol);
+      this->symbol = symbol;
       this->subtable_uvs = &Null (CmapSubtableFormat14);
       {
 	const CmapSubtable *st = table->find_subtable (0, 5);
@@ -1028,21 +1110,122 @@ struct cmap
 	  break;
 	}
       }
+
+      this->bmp_coverage.init ();
+      this->coverage_queries.set_relaxed (0);
+      this->glyph_unicodes.init ();
+    }
+
+    void fini ()
+    {
+      free (this->bmp_coverage.get ());
+      hb_vector_t<uint64_t> *reverse = this->glyph_unicodes.get ();
+      if (reverse)
+      {
+	reverse->fini ();
+	free (reverse);
+      }
+      this->table.destroy ();
+    }
+
+    unsigned int get_memory_usage () const
+    {
+      unsigned int bytes = 0;
+      if (this->bmp_coverage.get ())
+	bytes += HB_CMAP_BMP_COVERAGE_WORDS * sizeof (uint32_t);
+      const hb_vector_t<uint64_t> *reverse = this->glyph_unicodes.get ();
+      if (reverse)
+	bytes += sizeof (*reverse) + reverse->get_allocated_size ();
+      return bytes;
+    }
+
+    /* Calls sink.add (unicode, glyph) for every mapping
+     * get_nominal_glyph() finds, in unicode order.  Walks the segments of
+     * formats 4, 12 and 13 directly, instead of looking up each code
+     * point. */
+    template <typename Sink>
+    void collect_mapping (Sink &sink) const
+    {
+      if (unlikely (!this->get_glyph_funcZ)) return;
+      if (!this->symbol)
+	switch (this->subtable->u.format)
+	{
+	case  4: if (this->format4_accel.collect_mapping (sink)) return; break;
+	case 12: if (this->subtable->u.format12.collect_mapping (sink)) return; break;
+	case 13: if (this->subtable->u.format13.collect_mapping (sink)) return; break;
+	default: break;
+	}
+
+      hb_set_t unicodes;
+      this->subtable->collect_unicodes (&unicodes);
+      if (this->symbol)
+	unicodes.add_range (0x0000u, 0x00FFu);
+      hb_codepoint_t u = HB_SET_VALUE_INVALID;
+      while (unicodes.next (&u))
+      {
+	hb_codepoint_t gid;
+	if (get_nominal_glyph (u, &gid))
+	  sink.add (u, gid);
+      }
     }
 
-    void fini () { this->table.destroy (); }
+    /* Retrieves the code points mapping to glyph, in increasing order,
+     * from a reverse index built on first use.  Returns their total
+     * number. */
+    unsigned int get_glyph_unicodes (hb_codepoint_t  glyph,
+				     unsigned int    start_offset,
+				     unsigned int   *unicodes_count, /* IN/OUT */
+				     hb_codepoint_t *unicodes /* OUT */) const
+    {
+      const hb_vector_t<uint64_t> *reverse = get_glyph_unicodes_index ();
+      unsigned int lo = 0, hi = reverse ? reverse->length : 0;
+      uint64_t key = (uint64_t) glyph << 32;
+      while (lo < hi)
+      {
+	unsigned int mid = lo + (hi - lo) / 2;
+	if ((*reverse)[mid] < key)
+	  lo = mid + 1;
+	else
+	  hi = mid;
+      }
+      unsigned int total = 0;
+      unsigned int max = unicodes_count ? *unicodes_count : 0;
+      unsigned int written = 0;
+      for (unsigned int i = lo; reverse && i < reverse->length && ((*reverse)[i] >> 32) == glyph; i++, total++)
+	if (total >= start_offset && written < max)
+	  unicodes[written++] = (hb_codepoint_t) (*reverse)[i];
+      if (unicodes_count)
+	*unicodes_count = written;
+      return total;
+    }
 
+    /* If cache is given, it is consulted first and filled with
+     * successful lookups.  The cache is lock-free, so multiple
+     * threads can share it. */
     bool get_nominal_glyph (hb_codepoint_t  unicode,
-				   hb_codepoint_t *glyph) const
+			    hb_codepoint_t *glyph,
+			    hb_cmap_cache_t *cache = nullptr) const
     {
       if (unlikely (!this->get_glyph_funcZ)) return false;
-      return this->get_glyph_funcZ (this->get_glyph_data, unicode, glyph);
+
+      unsigned int v;
+      if (cache && cache->get (unicode, &v))
+      {
+	*glyph = v;
+	return true;
+      }
+
+      bool ret = this->get_glyph_funcZ (this->get_glyph_data, unicode, glyph);
+      if (cache && ret)
+	cache->set (unicode, *glyph);
+      return ret;
     }
     unsigned int get_nominal_glyphs (unsigned int count,
 				     const hb_codepoint_t *first_unicode,
 				     unsigned int unicode_stride,
 				     hb_codepoint_t *first_glyph,
-				     unsigned int glyph_stride) const
+				     unsigned int glyph_stride,
+				     hb_cmap_cache_t *cache = nullptr) const
     {
       if (unlikely (!this->get_glyph_funcZ)) return 0;
 
@@ -1050,19 +1233,58 @@ struct cmap
       const void *get_glyph_data = this->get_glyph_data;
 
       unsigned int done;
-      for (done = 0;
-	   done < count && get_glyph_funcZ (get_glyph_data, *first_unicode, first_glyph);
-	   done++)
+      for (done = 0; done < count; done++)
       {
+	hb_codepoint_t unicode = *first_unicode;
+	unsigned int v;
+	if (cache && cache->get (unicode, &v))
+	  *first_glyph = v;
+	else if (get_glyph_funcZ (get_glyph_data, unicode, first_glyph))
+	{
+	  if (cache)
+	    cache->set (unicode, *first_glyph);
+	}
+	else
+	  break;
 	first_unicode = &StructAtOffset<hb_codepoint_t> (first_unicode, unicode_stride);
 	first_glyph = &StructAtOffset<hb_codepoint_t> (first_glyph, glyph_stride);
       }
       return done;
     }
 
+    /* Sets bit i % 32 of coverage[i / 32] for each of the count code
+     * points that map to a glyph, clearing the others; returns how many
+     * do.  Once enough code points have been asked about, BMP ones are
+     * answered from a bitmap built by looking all of them up once. */
+    unsigned int get_coverage (unsigned int count,
+			       const hb_codepoint_t *unicodes,
+			       uint32_t *coverage) const
+    {
+      memset (coverage, 0, (count + 31) / 32 * sizeof (coverage[0]));
+      if (unlikely (!this->get_glyph_funcZ)) return 0;
+
+      const uint32_t *bmp = get_bmp_coverage (count);
+      unsigned int covered = 0;
+      for (unsigned int i = 0; i < count; i++)
+      {
+	hb_codepoint_t u = unicodes[i];
+	hb_codepoint_t glyph;
+	bool has = bmp && u < 0x10000u ?
+		   (bmp[u / 32] >> (u % 32)) & 1 :
+		   this->get_glyph_funcZ (this->get_glyph_data, u, &glyph);
+	if (has)
+	{
+	  coverage[i / 32] |= 1u << (i % 32);
+	  covered++;
+	}
+      }
+      return covered;
+    }
+
     bool get_variation_glyph (hb_codepoint_t  unicode,
 			      hb_codepoint_t  variation_selector,
-			      hb_codepoint_t *glyph) const
+			      hb_codepoint_t *glyph,
+			      hb_cmap_cache_t *cache = nullptr) const
     {
       switch (this->subtable_uvs->get_glyph_variant (unicode,
 						     variation_selector,
@@ -1073,7 +1295,7 @@ struct cmap
 	case GLYPH_VARIANT_USE_DEFAULT:	break;
       }
 
-      return get_nominal_glyph (unicode, glyph);
+      return get_nominal_glyph (unicode, glyph, cache);
     }
 
     void collect_unicodes (hb_set_t *out) const
@@ -1126,9 +1348,86 @@ struct cmap
       return false;
     }
 
+    /* The BMP coverage bitmap, built once more than
+     * HB_CMAP_BMP_COVERAGE_THRESHOLD code points have been queried. */
+    const uint32_t *get_bmp_coverage (unsigned int count) const
+    {
+      uint32_t *bmp = this->bmp_coverage.get ();
+      if (likely (bmp))
+	return bmp;
+
+      int queries = this->coverage_queries.get_relaxed ();
+      if (queries < HB_CMAP_BMP_COVERAGE_THRESHOLD)
+      {
+	this->coverage_queries.set_relaxed (queries + MIN (count, (unsigned int) HB_CMAP_BMP_COVERAGE_THRESHOLD));
+	return nullptr;
+      }
+
+      bmp = (uint32_t *) calloc (HB_CMAP_BMP_COVERAGE_WORDS, sizeof (uint32_t));
+      if (unlikely (!bmp))
+	return nullptr;
+      for (hb_codepoint_t u = 0; u < 0x10000u; u++)
+      {
+	hb_codepoint_t glyph;
+	if (this->get_glyph_funcZ (this->get_glyph_data, u, &glyph))
+	  bmp[u / 32] |= 1u << (u % 32);
+      }
+      if (unlikely (!this->bmp_coverage.cmpexch (nullptr, bmp)))
+      {
+	free (bmp);
+	bmp = this->bmp_coverage.get ();
+      }
+      return bmp;
+    }
+
+    struct glyph_unicode_sink_t
+    {
+      void add (hb_codepoint_t u, hb_codepoint_t gid)
+      { pairs->push (((uint64_t) gid << 32) | u); }
+      hb_vector_t<uint64_t> *pairs;
+    };
+    static int cmp_glyph_unicode (const void *pa, const void *pb)
+    {
+      uint64_t a = *(const uint64_t *) pa, b = *(const uint64_t *) pb;
+      return a < b ? -1 : a > b ? 1 : 0;
+    }
+
+    /* Every (glyph << 32 | unicode) of the mapping, sorted. */
+    const hb_vector_t<uint64_t> *get_glyph_unicodes_index () const
+    {
+      hb_vector_t<uint64_t> *reverse = this->glyph_unicodes.get ();
+      if (likely (reverse))
+	return reverse;
+      /* The Null accelerator of the empty face is not writable. */
+      if (unlikely (!this->get_glyph_funcZ))
+	return nullptr;
+
+      reverse = (hb_vector_t<uint64_t> *) calloc (1, sizeof (*reverse));
+      if (unlikely (!reverse))
+	return nullptr;
+      reverse->init ();
+      glyph_unicode_sink_t sink = {reverse};
+      collect_mapping (sink);
+      reverse->as_array ().qsort (cmp_glyph_unicode);
+      if (unlikely (reverse->in_error () ||
+		    !this->glyph_unicodes.cmpexch (nullptr, reverse)))
+      {
+	bool lost = !reverse->in_error ();
+	reverse->fini ();
+	free (reverse);
+	return lost ? this->glyph_unicodes.get () : nullptr;
+      }
+      return reverse;
+    }
+
     private:
     hb_nonnull_ptr_t<const CmapSubtable> subtable;
     hb_nonnull_ptr_t<const CmapSubtableFormat14> subtable_uvs;
+    bool symbol;
+
+    mutable hb_atomic_ptr_t<uint32_t> bmp_coverage;
+    mutable hb_atomic_int_t coverage_queries;
+    mutable hb_atomic_ptr_t<hb_vector_t<uint64_t> > glyph_unicodes;
 
     hb_cmap_get_glyph_func_t get_glyph_funcZ;
     const void *get_glyph_data;
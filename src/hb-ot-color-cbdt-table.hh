@@ -343,13 +343,12 @@ struct CBLC
   }
 
   protected:
-  const BitmapSizeTable &choose_strike (hb_font_t *font) const
+  unsigned int choose_strike (unsigned int requested_ppem) const
   {
     unsigned count = sizeTables.len;
     if (unlikely (!count))
-      return Null(BitmapSizeTable);
+      return 0;
 
-    unsigned int requested_ppem = MAX (font->x_ppem, font->y_ppem);
     if (!requested_ppem)
       requested_ppem = 1<<30; /* Choose largest strike. */
     unsigned int best_i = 0;
@@ -366,7 +365,7 @@ struct CBLC
       }
     }
 
-    return sizeTables[best_i];
+    return best_i;
   }
 
   protected:
@@ -382,26 +381,141 @@ struct CBDT
 
   struct accelerator_t
   {
+    /* Per-strike map from glyph to the first index subtable record
+     * covering it, so lookups don't scan the records. */
+    struct strike_index_t
+    {
+      bool scan; /* Records overlap too much to index; scan them instead. */
+      unsigned int first_glyph;
+      unsigned int count;
+      uint16_t records[VAR]; /* Record index plus one, or zero. */
+    };
+
     void init (hb_face_t *face)
     {
       cblc = hb_sanitize_context_t().reference_table<CBLC> (face);
       cbdt = hb_sanitize_context_t().reference_table<CBDT> (face);
 
       upem = hb_face_get_upem (face);
+
+      cached_strike.set (0);
+      num_strikes = cblc->sizeTables.len;
+      strike_indices = num_strikes ?
+		       (hb_atomic_ptr_t<strike_index_t> *) calloc (num_strikes, sizeof (strike_indices[0])) :
+		       nullptr;
+      if (unlikely (!strike_indices))
+	num_strikes = 0;
     }
 
     void fini ()
     {
       this->cblc.destroy ();
       this->cbdt.destroy ();
+
+      for (unsigned int i = 0; i < num_strikes; i++)
+	free (strike_indices[i].get ());
+      free (strike_indices);
+    }
+
+    /* Remembers the strike chosen for the last ppem asked about, since
+     * text rarely mixes sizes. */
+    unsigned int choose_strike (hb_font_t *font) const
+    {
+      /* The Null accelerator, of faces without the tables, is read-only. */
+      if (unlikely (!has_data ()))
+	return 0;
+
+      unsigned int ppem = MAX (font->x_ppem, font->y_ppem);
+      int cached = cached_strike.get ();
+      if (cached && (unsigned int) (cached - 1) >> 15 == ppem)
+	return (cached - 1) & 0x7FFF;
+
+      unsigned int i = this->cblc->choose_strike (ppem);
+      if (ppem < 0xFFFF && i <= 0x7FFF)
+	cached_strike.set ((int) ((ppem << 15) | i) + 1);
+      return i;
+    }
+
+    const strike_index_t *get_strike_index (unsigned int strike_i) const
+    {
+      if (unlikely (strike_i >= num_strikes))
+	return nullptr;
+
+    retry:
+      strike_index_t *index = strike_indices[strike_i].get ();
+      if (unlikely (!index))
+      {
+	index = create_strike_index (this->cblc->sizeTables[strike_i]);
+	if (unlikely (!index))
+	  return nullptr;
+	if (unlikely (!strike_indices[strike_i].cmpexch (nullptr, index)))
+	{
+	  free (index);
+	  goto retry;
+	}
+      }
+      return index;
+    }
+
+    strike_index_t *create_strike_index (const BitmapSizeTable &strike) const
+    {
+      const IndexSubtableArray &array = cblc+strike.indexSubtableArrayOffset;
+      unsigned int num_records = strike.numberOfIndexSubtables;
+
+      unsigned int first = (unsigned int) -1, last = 0;
+      unsigned long long total = 0;
+      for (unsigned int i = 0; i < num_records; i++)
+      {
+	const IndexSubtableRecord &record = array.indexSubtablesZ[i];
+	first = MIN (first, (unsigned int) record.firstGlyphIndex);
+	last = MAX (last, (unsigned int) record.lastGlyphIndex);
+	total += record.lastGlyphIndex - record.firstGlyphIndex + 1;
+      }
+      bool scan = num_records >= 0xFFFFu || total > 0x20000u;
+      unsigned int count = scan || !num_records ? 0 : last - first + 1;
+
+      strike_index_t *index = (strike_index_t *) calloc (1, sizeof (strike_index_t) +
+							    count * sizeof (index->records[0]));
+      if (unlikely (!index))
+	return nullptr;
+      index->scan = scan;
+      index->first_glyph = first;
+      index->count = count;
+      if (count)
+	for (unsigned int i = 0; i < num_records; i++)
+	{
+	  const IndexSubtableRecord &record = array.indexSubtablesZ[i];
+	  for (unsigned int g = record.firstGlyphIndex; g <= record.lastGlyphIndex; g++)
+	    if (!index->records[g - first])
+	      index->records[g - first] = i + 1;
+	}
+      return index;
+    }
+
+    const IndexSubtableRecord *find_table (unsigned int strike_i,
+					   hb_codepoint_t glyph,
+					   const void **out_base) const
+    {
+      const BitmapSizeTable &strike = this->cblc->sizeTables[strike_i];
+      const strike_index_t *index = get_strike_index (strike_i);
+      if (unlikely (!index || index->scan))
+	return strike.find_table (glyph, cblc, out_base);
+
+      const IndexSubtableArray &array = cblc+strike.indexSubtableArrayOffset;
+      *out_base = &array;
+      unsigned int i = glyph - index->first_glyph;
+      if (i >= index->count || !index->records[i])
+	return nullptr;
+      return &array.indexSubtablesZ[index->records[i] - 1];
     }
 
     bool get_extents (hb_font_t *font, hb_codepoint_t glyph,
 		      hb_glyph_extents_t *extents) const
     {
       const void *base;
-      const BitmapSizeTable &strike = this->cblc->choose_strike (font);
-      const IndexSubtableRecord *subtable_record = strike.find_table (glyph, cblc, &base);
+      unsigned int strike_i = choose_strike (font);
+      const BitmapSizeTable &strike = this->cblc->sizeTables[strike_i];
+      const IndexSubtableRecord *subtable_record = find_table (strike_i, glyph, &base);
       if (!subtable_record || !strike.ppemX || !strike.ppemY)
 	return false;
 
@@ -452,57 +566,89 @@ struct CBDT
       return true;
     }
 
-    hb_blob_t* reference_png (hb_font_t      *font,
-				     hb_codepoint_t  glyph) const
+    /* Sets offset and length to the range of glyph's PNG within the
+     * CBDT blob. */
+    bool get_png_data (hb_font_t      *font,
+		       hb_codepoint_t  glyph,
+		       unsigned int   *offset,
+		       unsigned int   *length) const
     {
       const void *base;
-      const BitmapSizeTable &strike = this->cblc->choose_strike (font);
-      const IndexSubtableRecord *subtable_record = strike.find_table (glyph, cblc, &base);
+      unsigned int strike_i = choose_strike (font);
+      const BitmapSizeTable &strike = this->cblc->sizeTables[strike_i];
+      const IndexSubtableRecord *subtable_record = find_table (strike_i, glyph, &base);
       if (!subtable_record || !strike.ppemX || !strike.ppemY)
-	return hb_blob_get_empty ();
+	return false;
 
       unsigned int image_offset = 0, image_length = 0, image_format = 0;
       if (!subtable_record->get_image_data (glyph, base, &image_offset, &image_length, &image_format))
-	return hb_blob_get_empty ();
+	return false;
 
       {
 	unsigned int cbdt_len = cbdt.get_length ();
 	if (unlikely (image_offset > cbdt_len || cbdt_len - image_offset < image_length))
-	  return hb_blob_get_empty ();
+	  return false;
 
 	switch (image_format)
 	{
 	  case 17: {
 	    if (unlikely (image_length < GlyphBitmapDataFormat17::min_size))
-	      return hb_blob_get_empty ();
+	      return false;
 	    const GlyphBitmapDataFormat17& glyphFormat17 =
 	      StructAtOffset<GlyphBitmapDataFormat17> (this->cbdt, image_offset);
-	    return hb_blob_create_sub_blob (cbdt.get_blob (),
-					    image_offset + GlyphBitmapDataFormat17::min_size,
-					    glyphFormat17.data.len);
+	    *offset = image_offset + GlyphBitmapDataFormat17::min_size;
+	    *length = glyphFormat17.data.len;
+	    break;
 	  }
 	  case 18: {
 	    if (unlikely (image_length < GlyphBitmapDataFormat18::min_size))
-	      return hb_blob_get_empty ();
+	      return false;
 	    const GlyphBitmapDataFormat18& glyphFormat18 =
 	      StructAtOffset<GlyphBitmapDataFormat18> (this->cbdt, image_offset);
-	    return hb_blob_create_sub_blob (cbdt.get_blob (),
-					    image_offset + GlyphBitmapDataFormat18::min_size,
-					    glyphFormat18.data.len);
+	    *offset = image_offset + GlyphBitmapDataFormat18::min_size;
+	    *length = glyphFormat18.data.len;
+	    break;
 	  }
 	  case 19: {
 	    if (unlikely (image_length < GlyphBitmapDataFormat19::min_size))
-	      return hb_blob_get_empty ();
+	      return false;
 	    const GlyphBitmapDataFormat19& glyphFormat19 =
 	      StructAtOffset<GlyphBitmapDataFormat19> (this->cbdt, image_offset);
-	    return hb_blob_create_sub_blob (cbdt.get_blob (),
-					    image_offset + GlyphBitmapDataFormat19::min_size,
-					    glyphFormat19.data.len);
+	    *offset = image_offset + GlyphBitmapDataFormat19::min_size;
+	    *length = glyphFormat19.data.len;
+	    break;
 	  }
+	  default:
+	    return false;
 	}
       }
 
-      return hb_blob_get_empty ();
+      /* The data length comes from the image itself; keep it in the blob,
+       * as hb_blob_create_sub_blob() would. */
+      unsigned int cbdt_len = cbdt.get_length ();
+      *length = MIN (*length, cbdt_len - *offset);
+      return true;
+    }
+
+    hb_blob_t* reference_png (hb_font_t      *font,
+			      hb_codepoint_t  glyph) const
+    {
+      unsigned int offset, length;
+      if (!get_png_data (font, glyph, &offset, &length))
+	return hb_blob_get_empty ();
+      return hb_blob_create_sub_blob (cbdt.get_blob (), offset, length);
+    }
+
+    bool get_png_data (hb_font_t      *font,
+		       hb_codepoint_t  glyph,
+		       const char    **data,
+		       unsigned int   *length) const
+    {
+      unsigned int offset;
+      if (!get_png_data (font, glyph, &offset, length))
+	return false;
+      *data = (const char *) this->cbdt.get () + offset;
+      return true;
     }
 
     bool has_data () const { return cbdt.get_length (); }
@@ -512,6 +658,10 @@ struct CBDT
     hb_blob_ptr_t<CBDT> cbdt;
 
     unsigned int upem;
+
+    mutable hb_atomic_int_t cached_strike; /* (ppem << 15 | strike) + 1, or zero. */
+    unsigned int num_strikes;
+    hb_atomic_ptr_t<strike_index_t> *strike_indices;
   };
 
   bool sanitize (hb_sanitize_context_t *c) const
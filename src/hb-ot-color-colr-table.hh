@@ -91,16 +91,20 @@ struct COLR
 
   bool has_data () const { return numBaseGlyphs; }
 
-  unsigned int get_glyph_layers (hb_codepoint_t       glyph,
-				 unsigned int         start_offset,
-				 unsigned int        *count, /* IN/OUT.  May be NULL. */
-				 hb_ot_color_layer_t *layers /* OUT.     May be NULL. */) const
+  hb_array_t<const LayerRecord> get_all_layers () const
+  { return hb_array_t<const LayerRecord> ((this+layersZ).arrayZ, numLayers); }
+
+  hb_array_t<const LayerRecord> get_glyph_layers (hb_codepoint_t glyph) const
   {
     const BaseGlyphRecord &record = (this+baseGlyphsZ).bsearch (numBaseGlyphs, glyph);
+    return get_all_layers ().sub_array (record.firstLayerIdx, record.numLayers);
+  }
 
-    hb_array_t<const LayerRecord> all_layers ((this+layersZ).arrayZ, numLayers);
-    hb_array_t<const LayerRecord> glyph_layers = all_layers.sub_array (record.firstLayerIdx,
-								       record.numLayers);
+  static unsigned int get_glyph_layers (hb_array_t<const LayerRecord> glyph_layers,
+					unsigned int         start_offset,
+					unsigned int        *count, /* IN/OUT.  May be NULL. */
+					hb_ot_color_layer_t *layers /* OUT.     May be NULL. */)
+  {
     if (count)
     {
       hb_array_t<const LayerRecord> segment_layers = glyph_layers.sub_array (start_offset, *count);
@@ -114,6 +118,77 @@ struct COLR
     return glyph_layers.length;
   }
 
+  unsigned int get_glyph_layers (hb_codepoint_t       glyph,
+				 unsigned int         start_offset,
+				 unsigned int        *count, /* IN/OUT.  May be NULL. */
+				 hb_ot_color_layer_t *layers /* OUT.     May be NULL. */) const
+  { return get_glyph_layers (get_glyph_layers (glyph), start_offset, count, layers); }
+
+  struct accelerator_t
+  {
+    void init (hb_face_t *face)
+    {
+      colr = hb_sanitize_context_t().reference_table<COLR> (face);
+      base_glyphs.init ();
+
+      /* Direct map from glyph to its base glyph record's layer range. */
+      const COLR *table = colr.get ();
+      const SortedUnsizedArrayOf<BaseGlyphRecord> &records = table+table->baseGlyphsZ;
+      unsigned int count = table->numBaseGlyphs;
+      unsigned int num_glyphs = 0;
+      for (unsigned int i = 0; i < count; i++)
+	num_glyphs = MAX (num_glyphs, records[i].glyphId + 1u);
+      if (unlikely (!base_glyphs.resize (num_glyphs)))
+      {
+	base_glyphs.resize (0);
+	return;
+      }
+      if (!num_glyphs)
+	return;
+      memset (base_glyphs.arrayZ (), 0, num_glyphs * sizeof (base_glyphs[0]));
+      for (unsigned int i = 0; i < count; i++)
+      {
+	/* Look the glyph up as get_glyph_layers() would, in case records
+	 * repeat or are out of order. */
+	hb_codepoint_t glyph = records[i].glyphId;
+	const BaseGlyphRecord &record = records.bsearch (count, glyph);
+	base_glyphs[glyph] = (record.firstLayerIdx << 16) | record.numLayers;
+      }
+    }
+
+    void fini ()
+    {
+      base_glyphs.fini ();
+      colr.destroy ();
+    }
+
+    bool has_data () const { return colr->has_data (); }
+
+    /* Layers of glyph, pointing into the table. */
+    hb_array_t<const LayerRecord> get_glyph_layers (hb_codepoint_t glyph) const
+    {
+      if (unlikely (!base_glyphs.length && colr->has_data ()))
+	return colr->get_glyph_layers (glyph);
+      if (glyph >= base_glyphs.length)
+	return hb_array_t<const LayerRecord> ();
+      uint32_t v = base_glyphs[glyph];
+      return colr->get_all_layers ().sub_array (v >> 16, v & 0xFFFFu);
+    }
+
+    unsigned int get_glyph_layers (hb_codepoint_t       glyph,
+				   unsigned int         start_offset,
+				   unsigned int        *count, /* IN/OUT.  May be NULL. */
+				   hb_ot_color_layer_t *layers /* OUT.     May be NULL. */) const
+    { return COLR::get_glyph_layers (get_glyph_layers (glyph), start_offset, count, layers); }
+
+    unsigned int get_memory_usage () const { return base_glyphs.get_allocated_size (); }
+
+    private:
+    hb_blob_ptr_t<COLR> colr;
+    /* firstLayerIdx << 16 | numLayers, by glyph. */
+    hb_vector_t<uint32_t> base_glyphs;
+  };
+
   bool sanitize (hb_sanitize_context_t *c) const
   {
     TRACE_SANITIZE (this);
@@ -134,6 +209,8 @@ struct COLR
   DEFINE_SIZE_STATIC (14);
 };
 
+struct COLR_accelerator_t : COLR::accelerator_t {};
+
 } /* namespace OT */
 
 
@@ -152,6 +152,115 @@ struct CPAL
     return numColors;
   }
 
+  struct accelerator_t
+  {
+    void init (hb_face_t *face)
+    {
+      table = hb_sanitize_context_t().reference_table<CPAL> (face);
+      num_palettes = table->numPalettes;
+      decoded = num_palettes ?
+		(hb_atomic_ptr_t<uint32_t> *) calloc (num_palettes * FORMAT_COUNT, sizeof (decoded[0])) :
+		nullptr;
+      if (unlikely (!decoded))
+	num_palettes = 0;
+    }
+
+    void fini ()
+    {
+      for (unsigned int i = 0; i < num_palettes * FORMAT_COUNT; i++)
+	free (decoded[i].get ());
+      free (decoded);
+      table.destroy ();
+    }
+
+    bool has_data () const { return table->has_data (); }
+    unsigned int get_palette_count () const { return table->get_palette_count (); }
+    unsigned int get_color_count () const   { return table->get_color_count (); }
+
+    hb_ot_color_palette_flags_t get_palette_flags (unsigned int palette_index) const
+    { return table->get_palette_flags (palette_index); }
+
+    hb_ot_name_id_t get_palette_name_id (unsigned int palette_index) const
+    { return table->get_palette_name_id (palette_index); }
+
+    hb_ot_name_id_t get_color_name_id (unsigned int color_index) const
+    { return table->get_color_name_id (color_index); }
+
+    /* The get_color_count() colors of a palette in the given format,
+     * decoded once per face. */
+    const uint32_t *get_palette (unsigned int                 palette_index,
+				 hb_ot_color_palette_format_t format) const
+    {
+      if (unlikely (palette_index >= num_palettes || (unsigned int) format >= FORMAT_COUNT))
+	return nullptr;
+
+      hb_atomic_ptr_t<uint32_t> &slot = decoded[palette_index * FORMAT_COUNT + format];
+    retry:
+      uint32_t *colors = slot.get ();
+      if (unlikely (!colors))
+      {
+	unsigned int count = table->numColors;
+	colors = (uint32_t *) malloc (MAX (count, 1u) * sizeof (colors[0]));
+	if (unlikely (!colors))
+	  return nullptr;
+	table->get_palette_colors (palette_index, 0, &count, colors);
+	if (format == HB_OT_COLOR_PALETTE_FORMAT_RGBA_PREMULTIPLIED)
+	  for (unsigned int i = 0; i < count; i++)
+	    colors[i] = premultiply (colors[i]);
+	if (unlikely (!slot.cmpexch (nullptr, colors)))
+	{
+	  free (colors);
+	  goto retry;
+	}
+      }
+      return colors;
+    }
+
+    unsigned int get_palette_colors (unsigned int  palette_index,
+				     unsigned int  start_offset,
+				     unsigned int *color_count, /* IN/OUT.  May be NULL. */
+				     hb_color_t   *colors       /* OUT.     May be NULL. */) const
+    {
+      const uint32_t *palette;
+      if (!color_count ||
+	  !(palette = get_palette (palette_index, HB_OT_COLOR_PALETTE_FORMAT_BGRA)))
+	return table->get_palette_colors (palette_index, start_offset, color_count, colors);
+
+      unsigned int num_colors = table->numColors;
+      unsigned int count = start_offset < num_colors ? MIN (num_colors - start_offset, *color_count) : 0;
+      *color_count = count;
+      if (count)
+	memcpy (colors, palette + start_offset, count * sizeof (colors[0]));
+      return num_colors;
+    }
+
+    unsigned int get_memory_usage () const
+    {
+      unsigned int size = num_palettes * FORMAT_COUNT * sizeof (decoded[0]);
+      for (unsigned int i = 0; i < num_palettes * FORMAT_COUNT; i++)
+	if (decoded[i].get ())
+	  size += table->numColors * sizeof (uint32_t);
+      return size;
+    }
+
+    private:
+    enum { FORMAT_COUNT = 2 };
+
+    static uint32_t premultiply (hb_color_t color)
+    {
+      unsigned int a = hb_color_get_alpha (color);
+      unsigned int r = (hb_color_get_red (color) * a + 127) / 255;
+      unsigned int g = (hb_color_get_green (color) * a + 127) / 255;
+      unsigned int b = (hb_color_get_blue (color) * a + 127) / 255;
+      return (r << 24) | (g << 16) | (b << 8) | a;
+    }
+
+    hb_blob_ptr_t<CPAL> table;
+    unsigned int num_palettes;
+    /* By palette index, then format. */
+    hb_atomic_ptr_t<uint32_t> *decoded;
+  };
+
   private:
   const CPALV1Tail& v1 () const
   {
@@ -187,6 +296,8 @@ struct CPAL
   DEFINE_SIZE_ARRAY (12, colorRecordIndicesZ);
 };
 
+struct CPAL_accelerator_t : CPAL::accelerator_t {};
+
 } /* namespace OT */
 
 
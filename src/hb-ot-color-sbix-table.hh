@@ -69,15 +69,19 @@ struct SBIXStrike
 		  imageOffsetsZ.sanitize_shallow (c, c->get_num_glyphs () + 1));
   }
 
-  hb_blob_t *get_glyph_blob (unsigned int  glyph_id,
-			     hb_blob_t    *sbix_blob,
-			     hb_tag_t      file_type,
-			     int          *x_offset,
-			     int          *y_offset,
-			     unsigned int  num_glyphs,
-			     unsigned int *strike_ppem) const
+  /* Finds the image of glyph_id, following 'dupe' references; sets
+   * offset and length to its range within sbix_blob. */
+  bool get_glyph_data (unsigned int  glyph_id,
+		       hb_blob_t    *sbix_blob,
+		       hb_tag_t      file_type,
+		       int          *x_offset,
+		       int          *y_offset,
+		       unsigned int  num_glyphs,
+		       unsigned int *strike_ppem,
+		       unsigned int *offset,
+		       unsigned int *length) const
   {
-    if (unlikely (!ppem)) return hb_blob_get_empty (); /* To get Null() object out of the way. */
+    if (unlikely (!ppem)) return false; /* To get Null() object out of the way. */
 
     unsigned int retry_count = 8;
     unsigned int sbix_len = sbix_blob->length;
@@ -89,7 +93,7 @@ struct SBIXStrike
 		  imageOffsetsZ[glyph_id + 1] <= imageOffsetsZ[glyph_id] ||
 		  imageOffsetsZ[glyph_id + 1] - imageOffsetsZ[glyph_id] <= SBIXGlyph::min_size ||
 		  (unsigned int) imageOffsetsZ[glyph_id + 1] > sbix_len - strike_offset))
-      return hb_blob_get_empty ();
+      return false;
 
     unsigned int glyph_offset = strike_offset + (unsigned int) imageOffsetsZ[glyph_id] + SBIXGlyph::min_size;
     unsigned int glyph_length = imageOffsetsZ[glyph_id + 1] - imageOffsetsZ[glyph_id] - SBIXGlyph::min_size;
@@ -104,16 +108,33 @@ struct SBIXStrike
 	if (retry_count--)
 	  goto retry;
       }
-      return hb_blob_get_empty ();
+      return false;
     }
 
     if (unlikely (file_type != glyph->graphicType))
-      return hb_blob_get_empty ();
+      return false;
 
     if (strike_ppem) *strike_ppem = ppem;
     if (x_offset) *x_offset = glyph->xOffset;
     if (y_offset) *y_offset = glyph->yOffset;
-    return hb_blob_create_sub_blob (sbix_blob, glyph_offset, glyph_length);
+    *offset = glyph_offset;
+    *length = glyph_length;
+    return true;
+  }
+
+  hb_blob_t *get_glyph_blob (unsigned int  glyph_id,
+			     hb_blob_t    *sbix_blob,
+			     hb_tag_t      file_type,
+			     int          *x_offset,
+			     int          *y_offset,
+			     unsigned int  num_glyphs,
+			     unsigned int *strike_ppem) const
+  {
+    unsigned int offset, length;
+    if (!get_glyph_data (glyph_id, sbix_blob, file_type, x_offset, y_offset,
+			 num_glyphs, strike_ppem, &offset, &length))
+      return hb_blob_get_empty ();
+    return hb_blob_create_sub_blob (sbix_blob, offset, length);
   }
 
   public:
@@ -142,6 +163,7 @@ struct sbix
     {
       table = hb_sanitize_context_t().reference_table<sbix> (face);
       num_glyphs = face->get_num_glyphs ();
+      cached_strike.set (0);
     }
     void fini () { table.destroy (); }
 
@@ -167,15 +189,51 @@ struct sbix
 						  num_glyphs, available_ppem);
     }
 
+    /* Like reference_png(), but points into the table instead of making
+     * a blob. */
+    bool get_png_data (hb_font_t      *font,
+		       hb_codepoint_t  glyph_id,
+		       const char    **data,
+		       unsigned int   *length,
+		       int            *x_offset,
+		       int            *y_offset,
+		       unsigned int   *available_ppem) const
+    {
+      hb_blob_t *blob = table.get_blob ();
+      unsigned int offset;
+      if (!choose_strike (font).get_glyph_data (glyph_id, blob,
+						HB_TAG ('p','n','g',' '),
+						x_offset, y_offset,
+						num_glyphs, available_ppem,
+						&offset, length))
+	return false;
+      *data = blob->data + offset;
+      return true;
+    }
+
     private:
 
+    /* Remembers the strike chosen for the last ppem asked about, since
+     * text rarely mixes sizes. */
     const SBIXStrike &choose_strike (hb_font_t *font) const
+    {
+      unsigned int ppem = MAX (font->x_ppem, font->y_ppem);
+      int cached = cached_strike.get ();
+      if (cached && (unsigned int) (cached - 1) >> 15 == ppem)
+	return table->get_strike ((cached - 1) & 0x7FFF);
+
+      unsigned int i = choose_strike (ppem);
+      if (ppem < 0xFFFF && i <= 0x7FFF)
+	cached_strike.set ((int) ((ppem << 15) | i) + 1);
+      return table->get_strike (i);
+    }
+
+    unsigned int choose_strike (unsigned int requested_ppem) const
     {
       unsigned count = table->strikes.len;
       if (unlikely (!count))
-        return Null(SBIXStrike);
+        return 0;
 
-      unsigned int requested_ppem = MAX (font->x_ppem, font->y_ppem);
       if (!requested_ppem)
         requested_ppem = 1<<30; /* Choose largest strike. */
       /* TODO Add DPI sensitivity as well? */
@@ -193,7 +251,7 @@ struct sbix
 	}
       }
 
-      return table->get_strike (best_i);
+      return best_i;
     }
 
     struct PNGHeader
@@ -230,9 +288,12 @@ struct sbix
 
       int x_offset = 0, y_offset = 0;
       unsigned int strike_ppem = 0;
-      hb_blob_t *blob = reference_png (font, glyph, &x_offset, &y_offset, &strike_ppem);
+      const char *data = nullptr;
+      unsigned int length = 0;
+      get_png_data (font, glyph, &data, &length, &x_offset, &y_offset, &strike_ppem);
 
-      const PNGHeader &png = *blob->as<PNGHeader>();
+      const PNGHeader &png = length < PNGHeader::min_size ?
+			     Null(PNGHeader) : *(const PNGHeader *) data;
 
       extents->x_bearing = x_offset;
       extents->y_bearing = y_offset;
@@ -249,8 +310,6 @@ struct sbix
 	extents->height = round (extents->height * scale);
       }
 
-      hb_blob_destroy (blob);
-
       return strike_ppem;
     }
 
@@ -258,6 +317,8 @@ struct sbix
     hb_blob_ptr_t<sbix> table;
 
     unsigned int num_glyphs;
+
+    mutable hb_atomic_int_t cached_strike; /* (ppem << 15 | strike) + 1, or zero. */
   };
 
   bool sanitize (hb_sanitize_context_t *c) const
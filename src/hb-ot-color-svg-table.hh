@@ -50,6 +50,14 @@ struct SVGDocumentIndexEntry
 				    svgDocLength);
   }
 
+  /* Both relative to the SVG Document Index. */
+  unsigned int get_offset () const { return svgDoc; }
+  unsigned int get_length () const { return svgDocLength; }
+
+  bool covers (hb_codepoint_t g) const { return startGlyphID <= g && g <= endGlyphID; }
+  unsigned int get_start_glyph () const { return startGlyphID; }
+  unsigned int get_end_glyph () const { return endGlyphID; }
+
   bool sanitize (hb_sanitize_context_t *c, const void *base) const
   {
     TRACE_SANITIZE (this);
@@ -80,8 +88,85 @@ struct SVG
   struct accelerator_t
   {
     void init (hb_face_t *face)
-    { table = hb_sanitize_context_t().reference_table<SVG> (face); }
-    void fini () { table.destroy (); }
+    {
+      table = hb_sanitize_context_t().reference_table<SVG> (face);
+      glyph_documents.init ();
+
+      /* Map each glyph to its document, numbering documents by the first
+       * entry that points at them, so glyphs in different entries sharing
+       * a document get the same one. */
+      const SortedArrayOf<SVGDocumentIndexEntry> &entries = table+table->svgDocEntries;
+      unsigned int count = entries.len;
+      unsigned int num_glyphs = 0;
+      unsigned long long total = 0;
+      for (unsigned int i = 0; i < count; i++)
+      {
+	num_glyphs = MAX (num_glyphs, entries[i].get_end_glyph () + 1);
+	if (entries[i].get_end_glyph () >= entries[i].get_start_glyph ())
+	  total += entries[i].get_end_glyph () - entries[i].get_start_glyph () + 1;
+      }
+      /* Overlapping entries aren't worth indexing; bsearch them. */
+      if (!count || count >= 0xFFFFu || total > 0x20000u ||
+	  unlikely (!glyph_documents.resize (num_glyphs)))
+      {
+	glyph_documents.resize (0);
+	return;
+      }
+      memset (glyph_documents.arrayZ (), 0, num_glyphs * sizeof (glyph_documents[0]));
+
+      hb_map_t first_entry;
+      for (unsigned int i = 0; i < count; i++)
+      {
+	const SVGDocumentIndexEntry &entry = entries[i];
+	unsigned int document = first_entry.get (entry.get_offset ());
+	if (document == HB_MAP_VALUE_INVALID ||
+	    entries[document].get_length () != entry.get_length ())
+	{
+	  if (document == HB_MAP_VALUE_INVALID)
+	    first_entry.set (entry.get_offset (), i);
+	  document = i;
+	}
+	for (unsigned int g = entry.get_start_glyph (); g <= entry.get_end_glyph (); g++)
+	  /* Answer as the bsearch would, in case entries overlap. */
+	  if (&table->get_glyph_entry (g) == &entry)
+	    glyph_documents[g] = document + 1;
+      }
+    }
+
+    void fini ()
+    {
+      glyph_documents.fini ();
+      table.destroy ();
+    }
+
+    /* Index of glyph's entry in the SVG Document Index, or -1; glyphs
+     * whose documents are the same get the same index. */
+    unsigned int get_glyph_document (hb_codepoint_t glyph_id) const
+    {
+      if (unlikely (!glyph_documents.length))
+      {
+	const SortedArrayOf<SVGDocumentIndexEntry> &entries = table+table->svgDocEntries;
+	const SVGDocumentIndexEntry *entry = entries.as_array ().bsearch (glyph_id);
+	return entry ? entry - entries.arrayZ : (unsigned int) -1;
+      }
+      if (glyph_id >= glyph_documents.length)
+	return (unsigned int) -1;
+      return glyph_documents[glyph_id] - 1;
+    }
+
+    bool get_document_data (unsigned int   document,
+			    const char   **data,
+			    unsigned int  *length) const
+    {
+      const SVGDocumentIndexEntry &entry = (table+table->svgDocEntries)[document];
+      hb_blob_t *blob = table.get_blob ();
+      unsigned long long offset = (unsigned long long) table->svgDocEntries + entry.get_offset ();
+      if (!entry.get_length () || offset >= blob->length)
+	return false;
+      *data = blob->data + offset;
+      *length = MIN (entry.get_length (), blob->length - (unsigned int) offset);
+      return true;
+    }
 
     hb_blob_t *reference_blob_for_glyph (hb_codepoint_t glyph_id) const
     {
@@ -91,8 +176,12 @@ struct SVG
 
     bool has_data () const { return table->has_data (); }
 
+    unsigned int get_memory_usage () const { return glyph_documents.get_allocated_size (); }
+
     private:
     hb_blob_ptr_t<SVG> table;
+    /* Document index plus one, by glyph; zero if none. */
+    hb_vector_t<uint16_t> glyph_documents;
   };
 
   const SVGDocumentIndexEntry &get_glyph_entry (hb_codepoint_t glyph_id) const
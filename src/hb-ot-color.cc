@@ -66,6 +66,7 @@
 hb_bool_t
 hb_ot_color_has_palettes (hb_face_t *face)
 {
+  hb_face_use_t use (face);
   return face->table.CPAL->has_data ();
 }
 
@@ -81,6 +82,7 @@ hb_ot_color_has_palettes (hb_face_t *face)
 unsigned int
 hb_ot_color_palette_get_count (hb_face_t *face)
 {
+  hb_face_use_t use (face);
   return face->table.CPAL->get_palette_count ();
 }
 
@@ -101,6 +103,7 @@ hb_ot_name_id_t
 hb_ot_color_palette_get_name_id (hb_face_t *face,
 				 unsigned int palette_index)
 {
+  hb_face_use_t use (face);
   return face->table.CPAL->get_palette_name_id (palette_index);
 }
 
@@ -117,6 +120,7 @@ hb_ot_name_id_t
 hb_ot_color_palette_color_get_name_id (hb_face_t *face,
 				       unsigned int color_index)
 {
+  hb_face_use_t use (face);
   return face->table.CPAL->get_color_name_id (color_index);
 }
 
@@ -133,6 +137,7 @@ hb_ot_color_palette_flags_t
 hb_ot_color_palette_get_flags (hb_face_t *face,
 			       unsigned int palette_index)
 {
+  hb_face_use_t use (face);
   return face->table.CPAL->get_palette_flags (palette_index);
 }
 
@@ -167,9 +172,42 @@ hb_ot_color_palette_get_colors (hb_face_t     *face,
 				unsigned int  *colors_count  /* IN/OUT.  May be NULL. */,
 				hb_color_t    *colors        /* OUT.     May be NULL. */)
 {
+  hb_face_use_t use (face);
   return face->table.CPAL->get_palette_colors (palette_index, start_offset, colors_count, colors);
 }
 
+/**
+ * hb_ot_color_palette_get_color_array:
+ * @face:          a font face.
+ * @palette_index: the index of the color palette whose colors
+ *                 are being requested.
+ * @format:        the layout to return colors in.
+ * @color_count:   (out) (optional): the number of colors in the palette.
+ *
+ * Retrieves all the colors in a color palette, like
+ * hb_ot_color_palette_get_colors(), but without copying: colors are
+ * decoded into @format the first time a palette is asked for and kept
+ * with @face, so renderers can use them every frame at no cost.
+ *
+ * Returns: (array length=color_count) (transfer none): the colors of the
+ * palette, valid for as long as @face is alive, or %NULL if
+ * @palette_index is out of range.
+ *
+ * Since: REPLACEME
+ */
+const uint32_t *
+hb_ot_color_palette_get_color_array (hb_face_t                    *face,
+				     unsigned int                  palette_index,
+				     hb_ot_color_palette_format_t  format,
+				     unsigned int                 *color_count)
+{
+  hb_face_use_t use (face);
+  const uint32_t *colors = face->table.CPAL->get_palette (palette_index, format);
+  if (color_count)
+    *color_count = colors ? face->table.CPAL->get_color_count () : 0;
+  return colors;
+}
+
 
 /*
  * COLR
@@ -186,6 +224,7 @@ hb_ot_color_palette_get_colors (hb_face_t     *face,
 hb_bool_t
 hb_ot_color_has_layers (hb_face_t *face)
 {
+  hb_face_use_t use (face);
   return face->table.COLR->has_data ();
 }
 
@@ -209,6 +248,7 @@ hb_ot_color_glyph_get_layers (hb_face_t           *face,
 			      unsigned int        *count, /* IN/OUT.  May be NULL. */
 			      hb_ot_color_layer_t *layers /* OUT.     May be NULL. */)
 {
+  hb_face_use_t use (face);
   return face->table.COLR->get_glyph_layers (glyph, start_offset, count, layers);
 }
 
@@ -230,6 +270,7 @@ hb_ot_color_glyph_get_layers (hb_face_t           *face,
 hb_bool_t
 hb_ot_color_has_svg (hb_face_t *face)
 {
+  hb_face_use_t use (face);
   return face->table.SVG->has_data ();
 }
 
@@ -247,9 +288,52 @@ hb_ot_color_has_svg (hb_face_t *face)
 hb_blob_t *
 hb_ot_color_glyph_reference_svg (hb_face_t *face, hb_codepoint_t glyph)
 {
+  hb_face_use_t use (face);
   return face->table.SVG->reference_blob_for_glyph (glyph);
 }
 
+/**
+ * hb_ot_color_glyph_get_svg_document:
+ * @face: a font face.
+ * @glyph: a svg glyph index.
+ * @document_index: (out) (optional): index identifying the document.
+ * @data: (out) (optional) (array length=length): the document.
+ * @length: (out) (optional): length of @data in bytes.
+ *
+ * Finds the SVG document holding @glyph, like
+ * hb_ot_color_glyph_reference_svg(), but returns it as a range of the
+ * face's table data instead of creating a blob.  One document often
+ * holds many glyphs; all of them get the same @document_index, so callers
+ * can parse each document once and cache it by that index.  As with
+ * hb_ot_color_glyph_reference_svg(), the document may be gzip-encoded.
+ *
+ * @data stays valid for as long as @face is alive.
+ *
+ * Returns: true if @glyph has an SVG document, false otherwise.
+ *
+ * Since: REPLACEME
+ */
+hb_bool_t
+hb_ot_color_glyph_get_svg_document (hb_face_t       *face,
+				    hb_codepoint_t   glyph,
+				    unsigned int    *document_index,
+				    const char     **data,
+				    unsigned int    *length)
+{
+  hb_face_use_t use (face);
+  unsigned int document = face->table.SVG->get_glyph_document (glyph);
+  const char *document_data = nullptr;
+  unsigned int document_length = 0;
+  bool ret = document != (unsigned int) -1 &&
+	     face->table.SVG->get_document_data (document, &document_data, &document_length);
+  if (!ret)
+    document = (unsigned int) -1;
+  if (document_index) *document_index = document;
+  if (data) *data = document_data;
+  if (length) *length = document_length;
+  return ret;
+}
+
 
 /*
  * PNG: CBDT or sbix
@@ -268,6 +352,7 @@ hb_ot_color_glyph_reference_svg (hb_face_t *face, hb_codepoint_t glyph)
 hb_bool_t
 hb_ot_color_has_png (hb_face_t *face)
 {
+  hb_face_use_t use (face);
   return face->table.CBDT->has_data () || face->table.sbix->has_data ();
 }
 
@@ -287,6 +372,7 @@ hb_ot_color_has_png (hb_face_t *face)
 hb_blob_t *
 hb_ot_color_glyph_reference_png (hb_font_t *font, hb_codepoint_t  glyph)
 {
+  hb_face_use_t use (font->face);
   hb_blob_t *blob = hb_blob_get_empty ();
 
   if (font->face->table.sbix->has_data ())
@@ -297,3 +383,114 @@ hb_ot_color_glyph_reference_png (hb_font_t *font, hb_codepoint_t  glyph)
 
   return blob;
 }
+
+/**
+ * hb_ot_color_glyph_get_png_data:
+ * @font: a font object, as for hb_ot_color_glyph_reference_png().
+ * @glyph: a glyph index.
+ * @data: (out) (array length=length): PNG data of the glyph.
+ * @length: (out): length of @data in bytes.
+ *
+ * Like hb_ot_color_glyph_reference_png(), but returns the PNG as a range
+ * of the face's table data instead of creating a blob, which is cheaper
+ * for callers that look images up for every glyph they draw.  @data stays
+ * valid for as long as the face of @font is alive.
+ *
+ * Returns: true if @glyph has a PNG image, false otherwise.
+ *
+ * Since: REPLACEME
+ */
+hb_bool_t
+hb_ot_color_glyph_get_png_data (hb_font_t      *font,
+				hb_codepoint_t  glyph,
+				const char    **data,
+				unsigned int   *length)
+{
+  hb_face_use_t use (font->face);
+  *data = nullptr;
+  *length = 0;
+
+  if (font->face->table.sbix->has_data () &&
+      font->face->table.sbix->get_png_data (font, glyph, data, length,
+					    nullptr, nullptr, nullptr) &&
+      *length)
+    return true;
+
+  if (font->face->table.CBDT->has_data () &&
+      font->face->table.CBDT->get_png_data (font, glyph, data, length) &&
+      *length)
+    return true;
+
+  *data = nullptr;
+  *length = 0;
+  return false;
+}
+
+
+/*
+ * All formats
+ */
+
+/**
+ * hb_ot_color_glyphs_get_formats:
+ * @font: a font object, as for hb_ot_color_glyph_reference_png().
+ * @count: number of glyphs.
+ * @first_glyph: the first glyph to classify.
+ * @glyph_stride: distance in bytes between consecutive glyphs.
+ * @first_format: (out): where to store the first glyph's formats.
+ * @format_stride: distance in bytes between consecutive formats.
+ *
+ * Finds the color image formats each of @count glyphs, such as those of a
+ * shaped buffer, is available in, so that they can be grouped by how they
+ * are to be drawn.  Each table is only consulted if the face has it, and
+ * PNG images are looked for at @font's ppem, as with
+ * hb_ot_color_glyph_get_png_data().
+ *
+ * Returns: the number of glyphs available in any color format.
+ *
+ * Since: REPLACEME
+ */
+unsigned int
+hb_ot_color_glyphs_get_formats (hb_font_t                  *font,
+				unsigned int                count,
+				const hb_codepoint_t       *first_glyph,
+				unsigned int                glyph_stride,
+				hb_ot_color_glyph_format_t *first_format,
+				unsigned int                format_stride)
+{
+  hb_face_t *face = font->face;
+  hb_face_use_t use (face);
+  const OT::COLR_accelerator_t &COLR = *face->table.COLR;
+  const OT::SVG_accelerator_t &SVG = *face->table.SVG;
+  const OT::sbix_accelerator_t &sbix = *face->table.sbix;
+  const OT::CBDT_accelerator_t &CBDT = *face->table.CBDT;
+  bool has_layers = COLR.has_data ();
+  bool has_svg = SVG.has_data ();
+  bool has_sbix = sbix.has_data ();
+  bool has_cbdt = CBDT.has_data ();
+
+  unsigned int colored = 0;
+  for (unsigned int i = 0; i < count; i++)
+  {
+    hb_codepoint_t glyph = *first_glyph;
+    unsigned int format = HB_OT_COLOR_GLYPH_FORMAT_NONE;
+    const char *data;
+    unsigned int length;
+
+    if (has_layers && COLR.get_glyph_layers (glyph).length)
+      format |= HB_OT_COLOR_GLYPH_FORMAT_LAYERS;
+    if ((has_sbix && sbix.get_png_data (font, glyph, &data, &length,
+					nullptr, nullptr, nullptr) && length) ||
+	(has_cbdt && CBDT.get_png_data (font, glyph, &data, &length) && length))
+      format |= HB_OT_COLOR_GLYPH_FORMAT_PNG;
+    if (has_svg && SVG.get_glyph_document (glyph) != (unsigned int) -1)
+      format |= HB_OT_COLOR_GLYPH_FORMAT_SVG;
+
+    *first_format = (hb_ot_color_glyph_format_t) format;
+    colored += format != HB_OT_COLOR_GLYPH_FORMAT_NONE;
+
+    first_glyph = &StructAtOffset<hb_codepoint_t> (first_glyph, glyph_stride);
+    first_format = &StructAtOffset<hb_ot_color_glyph_format_t> (first_format, format_stride);
+  }
+  return colored;
+}
@@ -85,6 +85,29 @@ hb_ot_color_palette_get_colors (hb_face_t    *face,
 				unsigned int *color_count,  /* IN/OUT.  May be NULL. */
 				hb_color_t   *colors        /* OUT.     May be NULL. */);
 
+/**
+ * hb_ot_color_palette_format_t:
+ * @HB_OT_COLOR_PALETTE_FORMAT_BGRA: #hb_color_t values, as returned by
+ *   hb_ot_color_palette_get_colors().
+ * @HB_OT_COLOR_PALETTE_FORMAT_RGBA_PREMULTIPLIED: red, green, blue and alpha
+ *   from the most significant byte down, with red, green and blue multiplied
+ *   by alpha.
+ *
+ * Layouts of colors returned by hb_ot_color_palette_get_color_array().
+ *
+ * Since: REPLACEME
+ */
+typedef enum {
+  HB_OT_COLOR_PALETTE_FORMAT_BGRA			= 0,
+  HB_OT_COLOR_PALETTE_FORMAT_RGBA_PREMULTIPLIED		= 1
+} hb_ot_color_palette_format_t;
+
+HB_EXTERN const uint32_t *
+hb_ot_color_palette_get_color_array (hb_face_t                    *face,
+				     unsigned int                  palette_index,
+				     hb_ot_color_palette_format_t  format,
+				     unsigned int                 *color_count /* OUT.  May be NULL. */);
+
 
 /*
  * Color layers.
@@ -123,6 +146,13 @@ hb_ot_color_has_svg (hb_face_t *face);
 HB_EXTERN hb_blob_t *
 hb_ot_color_glyph_reference_svg (hb_face_t *face, hb_codepoint_t glyph);
 
+HB_EXTERN hb_bool_t
+hb_ot_color_glyph_get_svg_document (hb_face_t       *face,
+				    hb_codepoint_t   glyph,
+				    unsigned int    *document_index, /* OUT.  May be NULL. */
+				    const char     **data,           /* OUT.  May be NULL. */
+				    unsigned int    *length          /* OUT.  May be NULL. */);
+
 /*
  * PNG: CBDT or sbix
  */
@@ -133,6 +163,43 @@ hb_ot_color_has_png (hb_face_t *face);
 HB_EXTERN hb_blob_t *
 hb_ot_color_glyph_reference_png (hb_font_t *font, hb_codepoint_t glyph);
 
+HB_EXTERN hb_bool_t
+hb_ot_color_glyph_get_png_data (hb_font_t      *font,
+				hb_codepoint_t  glyph,
+				const char    **data,
+				unsigned int   *length);
+
+/*
+ * All formats
+ */
+
+/**
+ * hb_ot_color_glyph_format_t:
+ * @HB_OT_COLOR_GLYPH_FORMAT_NONE: the glyph has no color image; draw its outline.
+ * @HB_OT_COLOR_GLYPH_FORMAT_LAYERS: the glyph has `COLR` layers.
+ * @HB_OT_COLOR_GLYPH_FORMAT_PNG: the glyph has a PNG image, in `sbix` or `CBDT`.
+ * @HB_OT_COLOR_GLYPH_FORMAT_SVG: the glyph has an `SVG` document.
+ *
+ * The color image formats a glyph is available in, as found by
+ * hb_ot_color_glyphs_get_formats().
+ *
+ * Since: REPLACEME
+ */
+typedef enum { /*< flags >*/
+  HB_OT_COLOR_GLYPH_FORMAT_NONE		= 0x00000000u,
+  HB_OT_COLOR_GLYPH_FORMAT_LAYERS	= 0x00000001u,
+  HB_OT_COLOR_GLYPH_FORMAT_PNG		= 0x00000002u,
+  HB_OT_COLOR_GLYPH_FORMAT_SVG		= 0x00000004u
+} hb_ot_color_glyph_format_t;
+
+HB_EXTERN unsigned int
+hb_ot_color_glyphs_get_formats (hb_font_t                  *font,
+				unsigned int                count,
+				const hb_codepoint_t       *first_glyph,
+				unsigned int                glyph_stride,
+				hb_ot_color_glyph_format_t *first_format,
+				unsigned int                format_stride);
+
 
 HB_END_DECLS
 
@@ -27,19 +27,40 @@
 #include "hb-ot-face.hh"
 
 #include "hb-ot-cmap-table.hh"
+#include "hb-ot-gasp-table.hh"
 #include "hb-ot-glyf-table.hh"
+#include "hb-ot-hdmx-table.hh"
 #include "hb-ot-cff1-table.hh"
 #include "hb-ot-cff2-table.hh"
+#include "hb-ot-head-table.hh"
 #include "hb-ot-hmtx-table.hh"
 #include "hb-ot-kern-table.hh"
 #include "hb-ot-name-table.hh"
+#include "hb-ot-os2-table.hh"
 #include "hb-ot-post-table.hh"
+#include "hb-ot-stat-table.hh"
+#include "hb-ot-vorg-table.hh"
 #include "hb-ot-color-cbdt-table.hh"
+#include "hb-ot-color-colr-table.hh"
+#include "hb-ot-color-cpal-table.hh"
 #include "hb-ot-color-sbix-table.hh"
 #include "hb-ot-color-svg-table.hh"
+#include "hb-ot-layout-base-table.hh"
 #include "hb-ot-layout-gdef-table.hh"
 #include "hb-ot-layout-gsub-table.hh"
 #include "hb-ot-layout-gpos-table.hh"
+#include "hb-ot-layout-jstf-table.hh"
+#include "hb-ot-math-table.hh"
+#include "hb-ot-var-avar-table.hh"
+#include "hb-ot-var-fvar-table.hh"
+#include "hb-ot-var-mvar-table.hh"
+#include "hb-aat-layout-ankr-table.hh"
+#include "hb-aat-layout-feat-table.hh"
+#include "hb-aat-layout-kerx-table.hh"
+#include "hb-aat-layout-lcar-table.hh"
+#include "hb-aat-layout-morx-table.hh"
+#include "hb-aat-layout-trak-table.hh"
+#include "hb-aat-ltag-table.hh"
 
 
 void hb_ot_face_t::init0 (hb_face_t *face)
@@ -59,3 +80,479 @@ void hb_ot_face_t::fini ()
 #undef HB_OT_ACCELERATOR
 #undef HB_OT_TABLE
 }
+
+/* Accelerators that own heap memory beyond their own struct report it
+ * through get_memory_usage(). */
+template <typename T>
+static auto _get_memory_usage (const T &obj, int) -> decltype (obj.get_memory_usage ())
+{ return obj.get_memory_usage (); }
+template <typename T>
+static unsigned int _get_memory_usage (const T &obj HB_UNUSED, long)
+{ return 0; }
+
+void hb_ot_face_t::get_memory_usage (hb_ot_face_memory_usage_t *usage) const
+{
+  /* Table blobs point into the face blob; only the blob object is ours. */
+#define HB_OT_TABLE(Namespace, Type) \
+  if (Type.get_stored_if_loaded ()) \
+    usage->add (Namespace::Type::tableTag, sizeof (hb_blob_t));
+#define HB_OT_ACCELERATOR(Namespace, Type) \
+  if (const Namespace::Type##_accelerator_t *accel = Type.get_stored_if_loaded ()) \
+    usage->add (Namespace::Type::tableTag, \
+		sizeof (*accel) + _get_memory_usage (*accel, 0));
+  HB_OT_TABLES
+#undef HB_OT_ACCELERATOR
+#undef HB_OT_TABLE
+}
+
+
+/**
+ * hb_face_prewarm:
+ * @face: a face.
+ * @flags: the parts of @face to load.
+ *
+ * Loads the chosen tables of @face and builds the lookup structures that
+ * HarfBuzz otherwise builds the first time each is needed, so that cost is
+ * not paid by whoever first uses the face.  Calling this again, or using
+ * the face from other threads meanwhile, is safe; this may for example be
+ * called from a background thread while the face is already in use.
+ *
+ * Since: REPLACEME
+ **/
+void
+hb_face_prewarm (hb_face_t               *face,
+		 hb_face_prewarm_flags_t  flags)
+{
+  if (unlikely (hb_object_is_inert (face)))
+    return;
+
+  hb_face_use_t use (face);
+
+  face->load_upem ();
+  face->get_num_glyphs ();
+
+  if (flags & HB_FACE_PREWARM_CMAP)
+    face->table.cmap.get ();
+  if (flags & HB_FACE_PREWARM_METRICS)
+  {
+    face->table.hmtx.get ();
+    face->table.vmtx.get ();
+  }
+  if (flags & HB_FACE_PREWARM_OUTLINES)
+  {
+    face->table.glyf.get ();
+#ifndef HB_NO_CFF
+    face->table.cff1.get ();
+    face->table.cff2.get ();
+#endif
+    face->table.VORG.get ();
+  }
+  if (flags & HB_FACE_PREWARM_LAYOUT)
+  {
+    face->table.GDEF->get_glyph_props_array ();
+    face->table.GSUB.get ();
+    face->table.GPOS.get ();
+    face->table.kern.get ();
+#ifndef HB_NO_AAT
+    face->table.morx.get ();
+    face->table.kerx.get ();
+#endif
+  }
+  if (flags & HB_FACE_PREWARM_NAMES)
+  {
+    face->table.post->get_name_index ();
+#ifndef HB_NO_CFF
+    face->table.cff1->get_name_index ();
+#endif
+    face->table.name.get ();
+  }
+  if (flags & HB_FACE_PREWARM_COLOR)
+  {
+    face->table.CBDT.get ();
+    face->table.sbix.get ();
+    face->table.SVG.get ();
+    face->table.COLR.get ();
+    face->table.CPAL.get ();
+  }
+}
+
+
+/*
+ * Trimming.
+ */
+
+void
+hb_face_t::retire (retired_t *r)
+{
+  hb_lock_t l (retired_lock);
+  r->next = retired.get ();
+  retired.set_relaxed (r);
+}
+
+void
+hb_face_t::reclaim () const
+{
+  retired_t *r;
+  {
+    hb_lock_t l (retired_lock);
+    /* Whoever stops using the face last frees what was retired before. */
+    _hb_memory_barrier ();
+    if (users.get ())
+      return;
+    r = retired.get ();
+    retired.set_relaxed (nullptr);
+  }
+  while (r)
+  {
+    retired_t *next = r->next;
+    r->destroy (r->p);
+    free (r);
+    r = next;
+  }
+}
+
+template <typename Loader>
+static void
+_hb_face_trim (hb_face_t *face, const Loader &loader)
+{
+  hb_face_t::retired_t *r = (hb_face_t::retired_t *) malloc (sizeof (hb_face_t::retired_t));
+  if (unlikely (!r))
+    return;
+  r->p = loader.detach ();
+  if (!r->p)
+  {
+    free (r);
+    return;
+  }
+  r->destroy = Loader::destroy_detached;
+  face->retire (r);
+}
+
+/**
+ * hb_face_trim:
+ * @face: a face.
+ * @flags: the parts of @face to unload.
+ *
+ * Unloads the chosen tables of @face and frees the lookup structures built
+ * for them, to be loaded and built again when next needed.  This is meant
+ * for releasing memory held by faces kept around for later use.
+ *
+ * This may be called while @face is in use from other threads; the memory
+ * is then freed once the calls that may be using it return.  The character
+ * map and metrics are used too often to be worth unloading, so
+ * %HB_FACE_PREWARM_CMAP and %HB_FACE_PREWARM_METRICS are ignored, as are
+ * the name table, which hb_ot_name_list_names() hands out pointers into,
+ * and the color palettes hb_ot_color_palette_get_color_array() hands out.
+ *
+ * Since: REPLACEME
+ **/
+void
+hb_face_trim (hb_face_t               *face,
+	      hb_face_prewarm_flags_t  flags)
+{
+  if (unlikely (hb_object_is_inert (face)))
+    return;
+
+  if (flags & HB_FACE_PREWARM_OUTLINES)
+  {
+    _hb_face_trim (face, face->table.glyf);
+    _hb_face_trim (face, face->table.cff1);
+    _hb_face_trim (face, face->table.cff2);
+  }
+  if (flags & HB_FACE_PREWARM_LAYOUT)
+  {
+    _hb_face_trim (face, face->table.GSUB);
+    _hb_face_trim (face, face->table.GPOS);
+    _hb_face_trim (face, face->table.kern);
+    _hb_face_trim (face, face->table.morx);
+    _hb_face_trim (face, face->table.kerx);
+  }
+  if (flags & HB_FACE_PREWARM_NAMES)
+  {
+    _hb_face_trim (face, face->table.post);
+  }
+  if (flags & HB_FACE_PREWARM_COLOR)
+  {
+    _hb_face_trim (face, face->table.CBDT);
+    _hb_face_trim (face, face->table.sbix);
+    _hb_face_trim (face, face->table.SVG);
+    _hb_face_trim (face, face->table.COLR);
+  }
+
+  face->reclaim ();
+}
+
+
+/*
+ * Serialized accelerators.
+ *
+ * Lazily-built accelerator state that is plain data is written into a
+ * blob that other processes can map and attach instead of building it
+ * again: the sorted glyph names of post, the dense glyph props of GDEF,
+ * and the coverage digests of GSUB and GPOS lookups and subtables.  The
+ * blob is a header, a section list and the section data, all native-endian
+ * and located by offsets, with sections eight-byte aligned.  Each section
+ * records the length and hash of the table it was built from, so a blob is
+ * only attached to a face with the same tables.
+ */
+
+#define HB_OT_FACE_ACCELERATORS_MAGIC HB_TAG ('h','b','a','c')
+#define HB_OT_FACE_ACCELERATORS_VERSION 1
+
+struct hb_ot_face_accelerators_header_t
+{
+  uint32_t magic;
+  uint32_t version;
+  uint32_t digest_size;		/* sizeof (hb_set_digest_t) of the writer. */
+  uint32_t num_glyphs;
+  uint32_t num_sections;
+  uint32_t reserved;
+};
+
+struct hb_ot_face_accelerators_section_t
+{
+  hb_tag_t tag;			/* The table the data was built from. */
+  uint32_t table_length;
+  uint32_t table_hash;
+  uint32_t offset;		/* From the start of the blob. */
+  uint32_t length;
+};
+
+static uint32_t
+_hb_ot_face_table_hash (hb_face_t *face, hb_tag_t tag, uint32_t *length)
+{
+  hb_blob_t *blob = hb_face_reference_table (face, tag);
+  unsigned int len;
+  const uint8_t *data = (const uint8_t *) hb_blob_get_data (blob, &len);
+  uint32_t h = 2166136261u; /* FNV-1a */
+  for (unsigned int i = 0; i < len; i++)
+    h = (h ^ data[i]) * 16777619u;
+  hb_blob_destroy (blob);
+  *length = len;
+  return h;
+}
+
+static unsigned int
+_hb_ot_face_accelerators_header_size (unsigned int num_sections)
+{
+  return (sizeof (hb_ot_face_accelerators_header_t) +
+	  num_sections * sizeof (hb_ot_face_accelerators_section_t) + 7) & ~7;
+}
+
+struct hb_ot_face_accelerators_writer_t
+{
+  void init (hb_face_t *face_)
+  {
+    face = face_;
+    sections.init ();
+    data.init ();
+  }
+  void fini ()
+  {
+    sections.fini ();
+    data.fini ();
+  }
+
+  /* Starts a section of length bytes and returns where to write it. */
+  char *add_section (hb_tag_t tag, unsigned int length)
+  {
+    hb_ot_face_accelerators_section_t *section = sections.push ();
+    section->tag = tag;
+    section->table_hash = _hb_ot_face_table_hash (face, tag, &section->table_length);
+    section->offset = data.length; /* Relative to the data, for now. */
+    section->length = length;
+    if (unlikely (!data.resize (data.length + ((length + 7) & ~7))))
+      return nullptr;
+    memset (data.arrayZ () + section->offset, 0, data.length - section->offset);
+    return data.arrayZ () + section->offset;
+  }
+
+  void add_array (hb_tag_t tag, const uint16_t *array, unsigned int count)
+  {
+    if (!array || !count)
+      return;
+    char *p = add_section (tag, count * sizeof (array[0]));
+    if (likely (p))
+      memcpy (p, array, count * sizeof (array[0]));
+  }
+
+  template <typename T>
+  void add_digests (const typename T::accelerator_t &accel)
+  {
+    unsigned int count = 0;
+    for (unsigned int i = 0; i < accel.lookup_count; i++)
+      count += accel.accels[i].get_digest_count ();
+    if (!accel.lookup_count)
+      return;
+
+    unsigned int header_size = ((accel.lookup_count + 2) * 4 + 7) & ~7;
+    char *p = add_section (T::tableTag, header_size + count * sizeof (hb_set_digest_t));
+    if (unlikely (!p))
+      return;
+
+    uint32_t *header = (uint32_t *) p;
+    hb_set_digest_t *digests = (hb_set_digest_t *) (p + header_size);
+    header[0] = accel.lookup_count;
+    unsigned int start = 0;
+    for (unsigned int i = 0; i < accel.lookup_count; i++)
+    {
+      header[1 + i] = start;
+      accel.accels[i].get_digests (digests + start);
+      start += accel.accels[i].get_digest_count ();
+    }
+    header[1 + accel.lookup_count] = start;
+  }
+
+  hb_blob_t *get_blob ()
+  {
+    if (unlikely (sections.in_error () || data.in_error ()))
+      return hb_blob_get_empty ();
+
+    unsigned int header_size = _hb_ot_face_accelerators_header_size (sections.length);
+    unsigned int length = header_size + data.length;
+    char *blob_data = (char *) calloc (length, 1);
+    if (unlikely (!blob_data))
+      return hb_blob_get_empty ();
+
+    hb_ot_face_accelerators_header_t *header = (hb_ot_face_accelerators_header_t *) blob_data;
+    header->magic = HB_OT_FACE_ACCELERATORS_MAGIC;
+    header->version = HB_OT_FACE_ACCELERATORS_VERSION;
+    header->digest_size = sizeof (hb_set_digest_t);
+    header->num_glyphs = face->get_num_glyphs ();
+    header->num_sections = sections.length;
+    hb_ot_face_accelerators_section_t *out = (hb_ot_face_accelerators_section_t *) (header + 1);
+    for (unsigned int i = 0; i < sections.length; i++)
+    {
+      out[i] = sections[i];
+      out[i].offset += header_size;
+    }
+    memcpy (blob_data + header_size, data.arrayZ (), data.length);
+
+    return hb_blob_create (blob_data, length, HB_MEMORY_MODE_WRITABLE,
+			   blob_data, free);
+  }
+
+  hb_face_t *face;
+  hb_vector_t<hb_ot_face_accelerators_section_t> sections;
+  hb_vector_t<char> data;
+};
+
+/**
+ * hb_face_serialize_accelerators:
+ * @face: a face.
+ *
+ * Builds the lookup structures that HarfBuzz otherwise builds on first use
+ * for @face, and writes those that are plain data into a blob that
+ * hb_face_attach_accelerators() can use in another process, for example
+ * after saving it to a file that each process maps with
+ * hb_blob_create_from_file().  Covered are the glyph name index of the
+ * post table, the glyph properties of the GDEF table, and the coverage
+ * digests of GSUB and GPOS lookups.
+ *
+ * The blob is native-endian and specific to the HarfBuzz build that wrote
+ * it; other builds refuse to attach it, without harm.
+ *
+ * Return value: (transfer full): the serialized state, or the empty blob on
+ * failure.
+ *
+ * Since: REPLACEME
+ **/
+hb_blob_t *
+hb_face_serialize_accelerators (hb_face_t *face)
+{
+  hb_face_use_t use (face);
+
+  hb_ot_face_accelerators_writer_t writer;
+  writer.init (face);
+
+  const OT::post_accelerator_t &post = *face->table.post;
+  writer.add_array (HB_OT_TAG_post, post.get_gids_sorted_by_name (), post.get_glyph_count ());
+
+  const OT::GDEF_accelerator_t &gdef = *face->table.GDEF;
+  writer.add_array (HB_OT_TAG_GDEF, gdef.get_glyph_props_array (), gdef.num_glyphs);
+
+  writer.add_digests<OT::GSUB> (*face->table.GSUB);
+  writer.add_digests<OT::GPOS> (*face->table.GPOS);
+
+  hb_blob_t *blob = writer.get_blob ();
+  writer.fini ();
+  return blob;
+}
+
+/**
+ * hb_face_attach_accelerators:
+ * @face: a face.
+ * @blob: state written by hb_face_serialize_accelerators().
+ *
+ * Makes @face use the lookup structures in @blob, rather than building its
+ * own on first use.  Data that can be used in place, such as the glyph name
+ * index and glyph properties, is not copied, so processes that map the
+ * same file share its memory.
+ *
+ * This must be called before @face is used: structures already built are
+ * kept.  @blob is checked against the tables of @face, which reads them
+ * once, and is referenced until @face is destroyed.  Its contents must not
+ * change.
+ *
+ * Return value: true if @blob was attached; false if it was written by a
+ * different HarfBuzz build or for different font data, if @face already has
+ * accelerators attached, or if @face is immutable.
+ *
+ * Since: REPLACEME
+ **/
+hb_bool_t
+hb_face_attach_accelerators (hb_face_t *face,
+			     hb_blob_t *blob)
+{
+  if (unlikely (hb_object_is_immutable (face) || face->accelerators.get ()))
+    return false;
+
+  unsigned int length;
+  const char *data = hb_blob_get_data (blob, &length);
+  const hb_ot_face_accelerators_header_t *header = (const hb_ot_face_accelerators_header_t *) data;
+  if (length < sizeof (*header) || ((uintptr_t) data & 7) ||
+      header->magic != HB_OT_FACE_ACCELERATORS_MAGIC ||
+      header->version != HB_OT_FACE_ACCELERATORS_VERSION ||
+      header->digest_size != sizeof (hb_set_digest_t) ||
+      header->num_glyphs != face->get_num_glyphs () ||
+      header->num_sections > 64 ||
+      length < _hb_ot_face_accelerators_header_size (header->num_sections))
+    return false;
+
+  const hb_ot_face_accelerators_section_t *sections = (const hb_ot_face_accelerators_section_t *) (header + 1);
+  for (unsigned int i = 0; i < header->num_sections; i++)
+  {
+    const hb_ot_face_accelerators_section_t &section = sections[i];
+    uint32_t table_length;
+    if ((section.offset & 7) || section.offset > length ||
+	section.length > length - section.offset ||
+	_hb_ot_face_table_hash (face, section.tag, &table_length) != section.table_hash ||
+	table_length != section.table_length)
+      return false;
+  }
+
+  hb_blob_t *ref = hb_blob_reference (blob);
+  if (unlikely (!face->accelerators.cmpexch (nullptr, ref)))
+  {
+    hb_blob_destroy (ref);
+    return false;
+  }
+  return true;
+}
+
+hb_bytes_t
+_hb_ot_face_get_attached_accelerator (hb_face_t *face, hb_tag_t tag)
+{
+  hb_blob_t *blob = face->accelerators.get ();
+  if (likely (!blob))
+    return hb_bytes_t ();
+
+  /* Checked by hb_face_attach_accelerators(). */
+  const char *data = hb_blob_get_data (blob, nullptr);
+  const hb_ot_face_accelerators_header_t *header = (const hb_ot_face_accelerators_header_t *) data;
+  const hb_ot_face_accelerators_section_t *sections = (const hb_ot_face_accelerators_section_t *) (header + 1);
+  for (unsigned int i = 0; i < header->num_sections; i++)
+    if (sections[i].tag == tag)
+      return hb_bytes_t (data + sections[i].offset, sections[i].length);
+  return hb_bytes_t ();
+}
@@ -45,7 +45,7 @@
     HB_OT_ACCELERATOR(OT, hmtx) \
     HB_OT_ACCELERATOR(OT, vmtx) \
     HB_OT_ACCELERATOR(OT, post) \
-    HB_OT_TABLE(OT, kern) \
+    HB_OT_ACCELERATOR(OT, kern) \
     HB_OT_ACCELERATOR(OT, glyf) \
     HB_OT_ACCELERATOR(OT, cff1) \
     HB_OT_ACCELERATOR(OT, cff2) \
@@ -53,6 +53,9 @@
     HB_OT_ACCELERATOR(OT, name) \
     HB_OT_TABLE(OT, OS2) \
     HB_OT_TABLE(OT, STAT) \
+    /* OpenType hinting. */ \
+    HB_OT_TABLE(OT, gasp) \
+    HB_OT_TABLE(OT, hdmx) \
     /* OpenType shaping. */ \
     HB_OT_ACCELERATOR(OT, GDEF) \
     HB_OT_ACCELERATOR(OT, GSUB) \
@@ -61,8 +64,8 @@
     HB_OT_TABLE(OT, JSTF) \
     /* AAT shaping. */ \
     HB_OT_TABLE(AAT, mort) \
-    HB_OT_TABLE(AAT, morx) \
-    HB_OT_TABLE(AAT, kerx) \
+    HB_OT_ACCELERATOR(AAT, morx) \
+    HB_OT_ACCELERATOR(AAT, kerx) \
     HB_OT_TABLE(AAT, ankr) \
     HB_OT_TABLE(AAT, trak) \
     HB_OT_TABLE(AAT, lcar) \
@@ -73,10 +76,10 @@
     HB_OT_TABLE(OT, avar) \
     HB_OT_TABLE(OT, MVAR) \
     /* OpenType math. */ \
-    HB_OT_TABLE(OT, MATH) \
+    HB_OT_ACCELERATOR(OT, MATH) \
     /* OpenType color fonts. */ \
-    HB_OT_TABLE(OT, COLR) \
-    HB_OT_TABLE(OT, CPAL) \
+    HB_OT_ACCELERATOR(OT, COLR) \
+    HB_OT_ACCELERATOR(OT, CPAL) \
     HB_OT_ACCELERATOR(OT, CBDT) \
     HB_OT_ACCELERATOR(OT, sbix) \
     HB_OT_ACCELERATOR(OT, SVG) \
@@ -89,10 +92,67 @@ HB_OT_TABLES
 #undef HB_OT_ACCELERATOR
 #undef HB_OT_TABLE
 
+/* Accumulates entries for hb_face_get_memory_usage(). */
+struct hb_ot_face_memory_usage_t
+{
+  void add (hb_tag_t tag, unsigned int bytes)
+  {
+    if (!bytes)
+      return;
+    total += bytes;
+    if (count >= start_offset && count - start_offset < max_entries)
+    {
+      entries[count - start_offset].tag = tag;
+      entries[count - start_offset].bytes = bytes;
+    }
+    count++;
+  }
+
+  hb_face_memory_usage_t *entries;
+  unsigned int start_offset;
+  unsigned int max_entries;
+  unsigned int count;
+  unsigned int total;
+};
+
+/* Accelerators of faces made with hb_face_collection_create_face() are
+ * shared by the faces of the collection whose tables they are built from
+ * are the same; see _hb_face_create_accelerator().  Faces not from a
+ * collection each build their own as usual. */
+typedef void (*hb_face_accelerator_init_func_t) (void *p, hb_face_t *face);
+typedef void (*hb_face_accelerator_fini_func_t) (void *p);
+
+HB_INTERNAL void *
+_hb_face_create_accelerator (hb_face_t                       *face,
+			     unsigned int                     order,
+			     unsigned int                     size,
+			     hb_face_accelerator_init_func_t  init,
+			     hb_face_accelerator_fini_func_t  fini);
+
+HB_INTERNAL void
+_hb_face_destroy_accelerator (void                            *p,
+			      hb_face_accelerator_fini_func_t  fini);
+
+template <typename T, unsigned int WheresFace>
+struct hb_face_shared_lazy_loader_t : hb_lazy_loader_t<T,
+						       hb_face_shared_lazy_loader_t<T, WheresFace>,
+						       hb_face_t, WheresFace>
+{
+  static T *create (hb_face_t *face)
+  { return (T *) _hb_face_create_accelerator (face, WheresFace, sizeof (T), init_accelerator, fini_accelerator); }
+  static void destroy (T *p)
+  { _hb_face_destroy_accelerator (p, fini_accelerator); }
+
+  private:
+  static void init_accelerator (void *p, hb_face_t *face) { ((T *) p)->init (face); }
+  static void fini_accelerator (void *p) { ((T *) p)->fini (); }
+};
+
 struct hb_ot_face_t
 {
   HB_INTERNAL void init0 (hb_face_t *face);
   HB_INTERNAL void fini ();
+  HB_INTERNAL void get_memory_usage (hb_ot_face_memory_usage_t *usage) const;
 
 #define HB_OT_TABLE_ORDER(Namespace, Type) \
     HB_PASTE (ORDER_, HB_PASTE (Namespace, HB_PASTE (_, Type)))
@@ -110,11 +170,17 @@ struct hb_ot_face_t
 #define HB_OT_TABLE(Namespace, Type) \
   hb_table_lazy_loader_t<Namespace::Type, HB_OT_TABLE_ORDER (Namespace, Type)> Type;
 #define HB_OT_ACCELERATOR(Namespace, Type) \
-  hb_face_lazy_loader_t<Namespace::Type##_accelerator_t, HB_OT_TABLE_ORDER (Namespace, Type)> Type;
+  hb_face_shared_lazy_loader_t<Namespace::Type##_accelerator_t, HB_OT_TABLE_ORDER (Namespace, Type)> Type;
   HB_OT_TABLES
 #undef HB_OT_ACCELERATOR
 #undef HB_OT_TABLE
 };
 
 
+/* Returns the section built from table tag of the accelerator state
+ * attached with hb_face_attach_accelerators(), or an empty array. */
+HB_INTERNAL hb_bytes_t
+_hb_ot_face_get_attached_accelerator (hb_face_t *face, hb_tag_t tag);
+
+
 #endif /* HB_OT_FACE_HH */
@@ -30,16 +30,20 @@
 
 #include "hb-font.hh"
 #include "hb-machinery.hh"
+#include "hb-cache.hh"
 #include "hb-ot-face.hh"
 
 #include "hb-ot-cmap-table.hh"
+#include "hb-ot-gasp-table.hh"
 #include "hb-ot-glyf-table.hh"
+#include "hb-ot-hdmx-table.hh"
 #include "hb-ot-cff1-table.hh"
 #include "hb-ot-cff2-table.hh"
 #include "hb-ot-hmtx-table.hh"
 #include "hb-ot-kern-table.hh"
 #include "hb-ot-os2-table.hh"
 #include "hb-ot-post-table.hh"
+#include "hb-ot-var-mvar-table.hh"
 #include "hb-ot-stat-table.hh" // Just so we compile it; unused otherwise.
 #include "hb-ot-vorg-table.hh"
 #include "hb-ot-color-cbdt-table.hh"
@@ -58,6 +62,182 @@
  **/
 
 
+struct hb_ot_font_t
+{
+  const hb_ot_face_t *ot_face;
+
+  /* cmap caching; off unless enabled with hb_ot_font_set_cmap_caching().
+   * The cmap of a face never changes, so the cache is never cleared. */
+  bool cmap_caching;
+  mutable hb_cmap_cache_t cmap_cache;
+
+  /* Advances of variable fonts, where computing one involves evaluating
+   * HVAR/VVAR deltas, are cached in the font's variation instance; see
+   * get_advance_cache(). */
+
+  /* Extents caching; off unless enabled with
+   * hb_ot_font_set_glyph_extents_caching().  Invalidated whenever the
+   * font's variation coordinates change, and when its ppem changes, since
+   * bitmap extents depend on the strike. */
+  mutable hb_atomic_int_t cached_coords_serial;
+  bool extents_caching;
+  mutable hb_atomic_int_t cached_ppem;
+  mutable hb_atomic_ptr_t<hb_extents_cache_t> extents_cache;
+
+  /* Hinted advances; off unless enabled with
+   * hb_ot_font_set_hinted_advances().  The hdmx record to use is looked
+   * up again whenever the font's x ppem changes; cached_hdmx holds the
+   * ppem it was looked up for, shifted up 17 bits, and one more than the
+   * index of the record, or zero where there is none to use. */
+  bool hinted_advances;
+  mutable hb_atomic_int_t cached_hdmx;
+
+  /* Vertical origins found in VORG, or from glyf and vmtx; allocated on
+   * first use, and invalidated with the extents cache. */
+  mutable hb_atomic_ptr_t<hb_v_origin_cache_t> v_origin_cache;
+
+  /* Font-wide metrics while at the default coordinates; at others they
+   * are kept in the font's variation instance. */
+  mutable hb_atomic_ptr_t<hb_font_metrics_t> metrics;
+
+  void sync_coords (const hb_font_t *font) const
+  {
+    if (cached_coords_serial.get () != (int) font->serial_coords)
+    {
+      hb_extents_cache_t *extents;
+      if ((extents = extents_cache.get ())) extents->clear ();
+      hb_v_origin_cache_t *v_origins;
+      if ((v_origins = v_origin_cache.get ())) v_origins->clear ();
+      cached_coords_serial.set (font->serial_coords);
+    }
+  }
+
+  template <typename Cache>
+  static Cache *get_cache (hb_atomic_ptr_t<Cache> &slot)
+  {
+  retry:
+    Cache *cache = slot.get ();
+    if (unlikely (!cache))
+    {
+      cache = (Cache *) calloc (1, sizeof (Cache));
+      if (unlikely (!cache))
+	return nullptr;
+      cache->init ();
+      if (unlikely (!slot.cmpexch (nullptr, cache)))
+      {
+	free (cache);
+	goto retry;
+      }
+    }
+    return cache;
+  }
+
+  template <typename Cache>
+  static void destroy_cache (hb_atomic_ptr_t<Cache> &slot)
+  {
+    Cache *cache = slot.get ();
+    if (cache)
+    {
+      cache->fini ();
+      free (cache);
+    }
+  }
+
+  hb_cmap_cache_t *get_cmap_cache () const
+  { return cmap_caching ? &cmap_cache : nullptr; }
+
+  /* Shared by all fonts at the same coordinates, and so never cleared. */
+  static hb_advance_cache_t *get_advance_cache (bool vertical, const hb_font_t *font)
+  { return font->instance ? font->instance->get_advance_cache (vertical) : nullptr; }
+
+  hb_extents_cache_t *get_extents_cache (const hb_font_t *font) const
+  {
+    if (!extents_caching)
+      return nullptr;
+
+    sync_coords (font);
+    int ppem = (int) ((font->x_ppem << 16) ^ font->y_ppem);
+    if (cached_ppem.get () != ppem)
+    {
+      hb_extents_cache_t *cache;
+      if ((cache = extents_cache.get ())) cache->clear ();
+      cached_ppem.set (ppem);
+    }
+    return get_cache (extents_cache);
+  }
+
+  /* Returns the index of the hdmx record to take font's horizontal
+   * advances from, or -1.  hdmx only covers the default instance, and
+   * gasp, where present, must ask for grid-fitting at the ppem. */
+  int get_hdmx_record (const hb_font_t *font) const
+  {
+    unsigned int ppem = font->x_ppem;
+    if (likely (!hinted_advances) || font->num_coords || !ppem || ppem > 255)
+      return -1;
+
+    unsigned int v = cached_hdmx.get_relaxed ();
+    if (v >> 17 == ppem)
+      return (int) (v & 0x1FFFFu) - 1;
+
+    int index = -1;
+    const OT::gasp &gasp = *ot_face->gasp;
+    if (!gasp.has_data () ||
+	(gasp.get_behavior (ppem) & (OT::gasp::GRIDFIT | OT::gasp::SYMMETRIC_GRIDFIT)))
+      index = ot_face->hdmx->find_record (ppem);
+    cached_hdmx.set_relaxed ((ppem << 17) | (index + 1));
+    return index;
+  }
+
+  hb_v_origin_cache_t *get_v_origin_cache (const hb_font_t *font) const
+  {
+    sync_coords (font);
+    return get_cache (v_origin_cache);
+  }
+};
+
+static hb_ot_font_t *
+_hb_ot_font_create (hb_font_t *font)
+{
+  hb_ot_font_t *ot_font = (hb_ot_font_t *) calloc (1, sizeof (hb_ot_font_t));
+  if (unlikely (!ot_font))
+    return nullptr;
+
+  ot_font->ot_face = &font->face->table;
+  ot_font->cmap_caching = false;
+  ot_font->cmap_cache.init ();
+
+  ot_font->cached_coords_serial.set_relaxed (0);
+
+  ot_font->extents_caching = false;
+  ot_font->cached_ppem.set_relaxed (0);
+  ot_font->extents_cache.init ();
+
+  ot_font->hinted_advances = false;
+  ot_font->cached_hdmx.set_relaxed (0);
+
+  ot_font->v_origin_cache.init ();
+
+  ot_font->metrics.init ();
+
+  return ot_font;
+}
+
+static void
+_hb_ot_font_destroy (void *font_data)
+{
+  hb_ot_font_t *ot_font = (hb_ot_font_t *) font_data;
+
+  ot_font->cmap_cache.fini ();
+
+  ot_font->destroy_cache (ot_font->extents_cache);
+  ot_font->destroy_cache (ot_font->v_origin_cache);
+
+  free (ot_font->metrics.get ());
+
+  free (ot_font);
+}
+
+
 static hb_bool_t
 hb_ot_get_nominal_glyph (hb_font_t *font HB_UNUSED,
 			 void *font_data,
@@ -65,8 +245,9 @@ hb_ot_get_nominal_glyph (hb_font_t *font HB_UNUSED,
 			 hb_codepoint_t *glyph,
 			 void *user_data HB_UNUSED)
 {
-  const hb_ot_face_t *ot_face = (const hb_ot_face_t *) font_data;
-  return ot_face->cmap->get_nominal_glyph (unicode, glyph);
+  const hb_ot_font_t *ot_font = (const hb_ot_font_t *) font_data;
+  const hb_ot_face_t *ot_face = ot_font->ot_face;
+  return ot_face->cmap->get_nominal_glyph (unicode, glyph, ot_font->get_cmap_cache ());
 }
 
 static unsigned int
@@ -79,10 +260,12 @@ hb_ot_get_nominal_glyphs (hb_font_t *font HB_UNUSED,
 			  unsigned int glyph_stride,
 			  void *user_data HB_UNUSED)
 {
-  const hb_ot_face_t *ot_face = (const hb_ot_face_t *) font_data;
+  const hb_ot_font_t *ot_font = (const hb_ot_font_t *) font_data;
+  const hb_ot_face_t *ot_face = ot_font->ot_face;
   return ot_face->cmap->get_nominal_glyphs (count,
 					    first_unicode, unicode_stride,
-					    first_glyph, glyph_stride);
+					    first_glyph, glyph_stride,
+					    ot_font->get_cmap_cache ());
 }
 
 static hb_bool_t
@@ -93,8 +276,10 @@ hb_ot_get_variation_glyph (hb_font_t *font HB_UNUSED,
 			   hb_codepoint_t *glyph,
 			   void *user_data HB_UNUSED)
 {
-  const hb_ot_face_t *ot_face = (const hb_ot_face_t *) font_data;
-  return ot_face->cmap->get_variation_glyph (unicode, variation_selector, glyph);
+  const hb_ot_font_t *ot_font = (const hb_ot_font_t *) font_data;
+  const hb_ot_face_t *ot_face = ot_font->ot_face;
+  return ot_face->cmap->get_variation_glyph (unicode, variation_selector, glyph,
+					     ot_font->get_cmap_cache ());
 }
 
 static void
@@ -106,15 +291,39 @@ hb_ot_get_glyph_h_advances (hb_font_t* font, void* font_data,
 			    unsigned advance_stride,
 			    void *user_data HB_UNUSED)
 {
-  const hb_ot_face_t *ot_face = (const hb_ot_face_t *) font_data;
+  const hb_ot_font_t *ot_font = (const hb_ot_font_t *) font_data;
+  const hb_ot_face_t *ot_face = ot_font->ot_face;
   const OT::hmtx_accelerator_t &hmtx = *ot_face->hmtx;
+  hb_advance_cache_t *cache = ot_font->get_advance_cache (false, font);
+  OT::VariationStore::cache_t *store_cache = hmtx.get_var_store_cache (font);
 
+  const hb_codepoint_t *glyphs = first_glyph;
+  hb_position_t *advances = first_advance;
   for (unsigned int i = 0; i < count; i++)
   {
-    *first_advance = font->em_scale_x (hmtx.get_advance (*first_glyph, font));
+    *first_advance = hmtx.get_advance (*first_glyph, font, cache, store_cache);
     first_glyph = &StructAtOffset<hb_codepoint_t> (first_glyph, glyph_stride);
     first_advance = &StructAtOffset<hb_position_t> (first_advance, advance_stride);
   }
+  font->em_scale_x (count, advances, advance_stride);
+
+  int record = ot_font->get_hdmx_record (font);
+  if (record >= 0)
+  {
+    /* Device widths are in pixels at x ppem. */
+    const OT::hdmx &hdmx = *ot_face->hdmx;
+    const OT::DeviceRecord &device = hdmx[record];
+    unsigned int num_widths = hdmx.get_num_widths ();
+    double pixel = (double) font->x_scale / font->x_ppem;
+    for (unsigned int i = 0; i < count; i++)
+    {
+      unsigned int width;
+      if (device.get_width (*glyphs, num_widths, &width))
+	*advances = (hb_position_t) round (width * pixel);
+      glyphs = &StructAtOffset<hb_codepoint_t> (glyphs, glyph_stride);
+      advances = &StructAtOffset<hb_position_t> (advances, advance_stride);
+    }
+  }
 }
 
 static void
@@ -126,15 +335,52 @@ hb_ot_get_glyph_v_advances (hb_font_t* font, void* font_data,
 			    unsigned advance_stride,
 			    void *user_data HB_UNUSED)
 {
-  const hb_ot_face_t *ot_face = (const hb_ot_face_t *) font_data;
+  const hb_ot_font_t *ot_font = (const hb_ot_font_t *) font_data;
+  const hb_ot_face_t *ot_face = ot_font->ot_face;
   const OT::vmtx_accelerator_t &vmtx = *ot_face->vmtx;
+  hb_advance_cache_t *cache = ot_font->get_advance_cache (true, font);
+  OT::VariationStore::cache_t *store_cache = vmtx.get_var_store_cache (font);
 
+  hb_position_t *advances = first_advance;
   for (unsigned int i = 0; i < count; i++)
   {
-    *first_advance = font->em_scale_y (-(int) vmtx.get_advance (*first_glyph, font));
+    *first_advance = -(int) vmtx.get_advance (*first_glyph, font, cache, store_cache);
     first_glyph = &StructAtOffset<hb_codepoint_t> (first_glyph, glyph_stride);
     first_advance = &StructAtOffset<hb_position_t> (first_advance, advance_stride);
   }
+  font->em_scale_y (count, advances, advance_stride);
+}
+
+/* Finds the Y of glyph's vertical origin in font units, from VORG, or
+ * from glyf and vmtx; false if the face has neither. */
+static inline bool
+_hb_ot_get_glyph_v_origin_y (const hb_ot_face_t *ot_face,
+			     hb_v_origin_cache_t *cache,
+			     hb_codepoint_t glyph,
+			     int *y)
+{
+  unsigned int v;
+  if (cache && cache->get (glyph, &v))
+  {
+    *y = (int16_t) v;
+    return true;
+  }
+
+  const OT::VORG &VORG = *ot_face->VORG;
+  if (VORG.has_data ())
+    *y = VORG.get_y_origin (glyph);
+  else
+  {
+    hb_glyph_extents_t extents = {0};
+    if (!ot_face->glyf->get_extents (glyph, &extents))
+      return false;
+    const OT::vmtx_accelerator_t &vmtx = *ot_face->vmtx;
+    *y = extents.y_bearing + (int) vmtx.get_side_bearing (glyph);
+  }
+
+  if (cache && (int16_t) *y == *y)
+    cache->set (glyph, (uint16_t) *y);
+  return true;
 }
 
 static hb_bool_t
@@ -145,23 +391,16 @@ hb_ot_get_glyph_v_origin (hb_font_t *font,
 			  hb_position_t *y,
 			  void *user_data HB_UNUSED)
 {
-  const hb_ot_face_t *ot_face = (const hb_ot_face_t *) font_data;
+  const hb_ot_font_t *ot_font = (const hb_ot_font_t *) font_data;
+  const hb_ot_face_t *ot_face = ot_font->ot_face;
 
   *x = font->get_glyph_h_advance (glyph) / 2;
 
-  const OT::VORG &VORG = *ot_face->VORG;
-  if (VORG.has_data ())
+  hb_face_use_t use (ot_face->face);
+  int origin_y;
+  if (_hb_ot_get_glyph_v_origin_y (ot_face, ot_font->get_v_origin_cache (font), glyph, &origin_y))
   {
-    *y = font->em_scale_y (VORG.get_y_origin (glyph));
-    return true;
-  }
-
-  hb_glyph_extents_t extents = {0};
-  if (ot_face->glyf->get_extents (glyph, &extents))
-  {
-    const OT::vmtx_accelerator_t &vmtx = *ot_face->vmtx;
-    hb_position_t tsb = vmtx.get_side_bearing (glyph);
-    *y = font->em_scale_y (extents.y_bearing + tsb);
+    *y = font->em_scale_y (origin_y);
     return true;
   }
 
@@ -173,22 +412,77 @@ hb_ot_get_glyph_v_origin (hb_font_t *font,
 }
 
 static hb_bool_t
-hb_ot_get_glyph_extents (hb_font_t *font,
-			 void *font_data,
-			 hb_codepoint_t glyph,
-			 hb_glyph_extents_t *extents,
-			 void *user_data HB_UNUSED)
+hb_ot_get_glyph_v_origins (hb_font_t *font,
+			   void *font_data,
+			   unsigned int count,
+			   const hb_codepoint_t *first_glyph,
+			   unsigned int glyph_stride,
+			   hb_position_t *first_x,
+			   unsigned int x_stride,
+			   hb_position_t *first_y,
+			   unsigned int y_stride,
+			   void *user_data HB_UNUSED)
 {
-  const hb_ot_face_t *ot_face = (const hb_ot_face_t *) font_data;
-  bool ret = ot_face->sbix->get_extents (font, glyph, extents);
-  if (!ret)
-    ret = ot_face->glyf->get_extents (glyph, extents);
-  if (!ret)
-    ret = ot_face->cff1->get_extents (glyph, extents);
-  if (!ret)
-    ret = ot_face->cff2->get_extents (font, glyph, extents);
+  const hb_ot_font_t *ot_font = (const hb_ot_font_t *) font_data;
+  const hb_ot_face_t *ot_face = ot_font->ot_face;
+
+  font->get_glyph_h_advances (count, first_glyph, glyph_stride, first_x, x_stride);
+
+  hb_face_use_t use (ot_face->face);
+  hb_v_origin_cache_t *cache = ot_font->get_v_origin_cache (font);
+  bool have_ascender = false;
+  hb_position_t ascender = 0;
+  for (unsigned int i = 0; i < count; i++)
+  {
+    *first_x /= 2;
+
+    int origin_y;
+    if (_hb_ot_get_glyph_v_origin_y (ot_face, cache, *first_glyph, &origin_y))
+      *first_y = font->em_scale_y (origin_y);
+    else
+    {
+      if (!have_ascender)
+      {
+	hb_font_extents_t font_extents;
+	font->get_h_extents_with_fallback (&font_extents);
+	ascender = font_extents.ascender;
+	have_ascender = true;
+      }
+      *first_y = ascender;
+    }
+
+    first_glyph = &StructAtOffset<hb_codepoint_t> (first_glyph, glyph_stride);
+    first_x = &StructAtOffset<hb_position_t> (first_x, x_stride);
+    first_y = &StructAtOffset<hb_position_t> (first_y, y_stride);
+  }
+
+  return true;
+}
+
+static inline bool
+_hb_ot_get_glyph_extents (hb_font_t *font,
+			  const hb_ot_face_t *ot_face,
+			  hb_extents_cache_t *cache,
+			  hb_codepoint_t glyph,
+			  hb_glyph_extents_t *extents)
+{
+  bool ret = cache && cache->get (glyph, extents);
   if (!ret)
-    ret = ot_face->CBDT->get_extents (font, glyph, extents);
+  {
+    ret = ot_face->sbix->get_extents (font, glyph, extents);
+    if (!ret)
+      ret = ot_face->glyf->get_extents (glyph, extents);
+#ifndef HB_NO_CFF
+    if (!ret)
+      ret = ot_face->cff1->get_extents (glyph, extents);
+    if (!ret)
+      ret = ot_face->cff2->get_extents (font, glyph, extents);
+#endif
+    if (!ret)
+      ret = ot_face->CBDT->get_extents (font, glyph, extents);
+    if (ret && cache)
+      cache->set (glyph, extents);
+  }
   // TODO Hook up side-bearings variations.
   extents->x_bearing = font->em_scale_x (extents->x_bearing);
   extents->y_bearing = font->em_scale_y (extents->y_bearing);
@@ -197,6 +491,45 @@ hb_ot_get_glyph_extents (hb_font_t *font,
   return ret;
 }
 
+static hb_bool_t
+hb_ot_get_glyph_extents (hb_font_t *font,
+			 void *font_data,
+			 hb_codepoint_t glyph,
+			 hb_glyph_extents_t *extents,
+			 void *user_data HB_UNUSED)
+{
+  const hb_ot_font_t *ot_font = (const hb_ot_font_t *) font_data;
+  hb_face_use_t use (ot_font->ot_face->face);
+  return _hb_ot_get_glyph_extents (font, ot_font->ot_face,
+				   ot_font->get_extents_cache (font),
+				   glyph, extents);
+}
+
+static unsigned int
+hb_ot_get_glyph_extents_batch (hb_font_t *font,
+			       void *font_data,
+			       unsigned int count,
+			       const hb_codepoint_t *first_glyph,
+			       unsigned int glyph_stride,
+			       hb_glyph_extents_t *first_extents,
+			       unsigned int extents_stride,
+			       void *user_data HB_UNUSED)
+{
+  const hb_ot_font_t *ot_font = (const hb_ot_font_t *) font_data;
+  const hb_ot_face_t *ot_face = ot_font->ot_face;
+  hb_extents_cache_t *cache = ot_font->get_extents_cache (font);
+  hb_face_use_t use (ot_face->face);
+
+  unsigned int found = 0;
+  for (unsigned int i = 0; i < count; i++)
+  {
+    found += _hb_ot_get_glyph_extents (font, ot_face, cache, *first_glyph, first_extents);
+    first_glyph = &StructAtOffset<hb_codepoint_t> (first_glyph, glyph_stride);
+    first_extents = &StructAtOffset<hb_glyph_extents_t> (first_extents, extents_stride);
+  }
+  return found;
+}
+
 static hb_bool_t
 hb_ot_get_glyph_name (hb_font_t *font HB_UNUSED,
                       void *font_data,
@@ -204,8 +537,15 @@ hb_ot_get_glyph_name (hb_font_t *font HB_UNUSED,
                       char *name, unsigned int size,
                       void *user_data HB_UNUSED)
 {
-  const hb_ot_face_t *ot_face = (const hb_ot_face_t *) font_data;
-  return ot_face->post->get_glyph_name (glyph, name, size);
+  const hb_ot_font_t *ot_font = (const hb_ot_font_t *) font_data;
+  const hb_ot_face_t *ot_face = ot_font->ot_face;
+  hb_face_use_t use (ot_face->face);
+  if (ot_face->post->get_glyph_name (glyph, name, size)) return true;
+#ifndef HB_NO_CFF
+  return ot_face->cff1->get_glyph_name (glyph, name, size);
+#else
+  return false;
+#endif
 }
 
 static hb_bool_t
@@ -215,8 +555,111 @@ hb_ot_get_glyph_from_name (hb_font_t *font HB_UNUSED,
                            hb_codepoint_t *glyph,
                            void *user_data HB_UNUSED)
 {
-  const hb_ot_face_t *ot_face = (const hb_ot_face_t *) font_data;
-  return ot_face->post->get_glyph_from_name (name, len, glyph);
+  const hb_ot_font_t *ot_font = (const hb_ot_font_t *) font_data;
+  const hb_ot_face_t *ot_face = ot_font->ot_face;
+  hb_face_use_t use (ot_face->face);
+  if (ot_face->post->get_glyph_from_name (name, len, glyph)) return true;
+#ifndef HB_NO_CFF
+  return ot_face->cff1->get_glyph_from_name (name, len, glyph);
+#else
+  return false;
+#endif
+}
+
+/* MVAR value tags, by hb_font_metrics_t::metric_t. */
+static const hb_tag_t _hb_ot_font_metrics_tags[hb_font_metrics_t::COUNT] =
+{
+  HB_TAG ('h','a','s','c'),
+  HB_TAG ('h','d','s','c'),
+  HB_TAG ('h','l','g','p'),
+  HB_TAG ('v','a','s','c'),
+  HB_TAG ('v','d','s','c'),
+  HB_TAG ('v','l','g','p'),
+  HB_TAG ('x','h','g','t'),
+  HB_TAG ('c','p','h','t'),
+  HB_TAG ('u','n','d','s'),
+  HB_TAG ('u','n','d','o'),
+  HB_TAG ('s','t','r','s'),
+  HB_TAG ('s','t','r','o'),
+};
+
+static void
+_hb_ot_font_compute_metrics (hb_font_t *font, hb_font_metrics_t *metrics)
+{
+  hb_face_t *face = font->face;
+  hb_face_use_t use (face);
+  const OT::hmtx_accelerator_t &hmtx = *face->table.hmtx;
+  const OT::vmtx_accelerator_t &vmtx = *face->table.vmtx;
+  const OT::OS2 &os2 = *face->table.OS2;
+  int *values = metrics->values;
+
+  values[hb_font_metrics_t::ASCENDER] = hmtx.ascender;
+  values[hb_font_metrics_t::DESCENDER] = hmtx.descender;
+  values[hb_font_metrics_t::LINE_GAP] = hmtx.line_gap;
+  values[hb_font_metrics_t::VERTICAL_ASCENDER] = vmtx.ascender;
+  values[hb_font_metrics_t::VERTICAL_DESCENDER] = vmtx.descender;
+  values[hb_font_metrics_t::VERTICAL_LINE_GAP] = vmtx.line_gap;
+  values[hb_font_metrics_t::X_HEIGHT] = os2.v2 ().sxHeight;
+  values[hb_font_metrics_t::CAP_HEIGHT] = os2.v2 ().sCapHeight;
+  values[hb_font_metrics_t::STRIKEOUT_SIZE] = os2.yStrikeoutSize;
+  values[hb_font_metrics_t::STRIKEOUT_OFFSET] = os2.yStrikeoutPosition;
+
+  /* Not through the post accelerator, which would index glyph names. */
+  hb_blob_t *post_blob = hb_sanitize_context_t ().reference_table<OT::post> (face);
+  const OT::post *post = post_blob->as<OT::post> ();
+  values[hb_font_metrics_t::UNDERLINE_SIZE] = post->underlineThickness;
+  values[hb_font_metrics_t::UNDERLINE_OFFSET] = post->underlinePosition;
+  hb_blob_destroy (post_blob);
+
+  if (font->num_coords)
+  {
+    const OT::MVAR &mvar = *face->table.MVAR;
+    for (unsigned int i = 0; i < hb_font_metrics_t::COUNT; i++)
+      values[i] += (int) round (mvar.get_var (_hb_ot_font_metrics_tags[i],
+					       font->coords, font->num_coords));
+  }
+}
+
+/* Returns the metrics of font at its coordinates: from its variation
+ * instance, or from default_slot at the default coordinates, computing
+ * and caching them there on first use; or, where there is neither or on
+ * allocation failure, computed into scratch. */
+static const hb_font_metrics_t *
+_hb_ot_font_get_metrics (hb_font_t *font,
+			 hb_atomic_ptr_t<hb_font_metrics_t> *default_slot,
+			 hb_font_metrics_t *scratch)
+{
+  hb_atomic_ptr_t<hb_font_metrics_t> *slot;
+  if (font->instance)
+    slot = &font->instance->metrics;
+  else if (!font->num_coords)
+    slot = default_slot;
+  else
+    slot = nullptr;
+  if (unlikely (!slot))
+  {
+    _hb_ot_font_compute_metrics (font, scratch);
+    return scratch;
+  }
+
+retry:
+  hb_font_metrics_t *metrics = slot->get ();
+  if (unlikely (!metrics))
+  {
+    metrics = (hb_font_metrics_t *) malloc (sizeof (hb_font_metrics_t));
+    if (unlikely (!metrics))
+    {
+      _hb_ot_font_compute_metrics (font, scratch);
+      return scratch;
+    }
+    _hb_ot_font_compute_metrics (font, metrics);
+    if (unlikely (!slot->cmpexch (nullptr, metrics)))
+    {
+      free (metrics);
+      goto retry;
+    }
+  }
+  return metrics;
 }
 
 static hb_bool_t
@@ -225,13 +668,13 @@ hb_ot_get_font_h_extents (hb_font_t *font,
 			  hb_font_extents_t *metrics,
 			  void *user_data HB_UNUSED)
 {
-  const hb_ot_face_t *ot_face = (const hb_ot_face_t *) font_data;
-  const OT::hmtx_accelerator_t &hmtx = *ot_face->hmtx;
-  metrics->ascender = font->em_scale_y (hmtx.ascender);
-  metrics->descender = font->em_scale_y (hmtx.descender);
-  metrics->line_gap = font->em_scale_y (hmtx.line_gap);
-  // TODO Hook up variations.
-  return hmtx.has_font_extents;
+  const hb_ot_font_t *ot_font = (const hb_ot_font_t *) font_data;
+  hb_font_metrics_t scratch;
+  const int *values = _hb_ot_font_get_metrics (font, &ot_font->metrics, &scratch)->values;
+  metrics->ascender = font->em_scale_y (values[hb_font_metrics_t::ASCENDER]);
+  metrics->descender = font->em_scale_y (values[hb_font_metrics_t::DESCENDER]);
+  metrics->line_gap = font->em_scale_y (values[hb_font_metrics_t::LINE_GAP]);
+  return ot_font->ot_face->hmtx->has_font_extents;
 }
 
 static hb_bool_t
@@ -240,13 +683,13 @@ hb_ot_get_font_v_extents (hb_font_t *font,
 			  hb_font_extents_t *metrics,
 			  void *user_data HB_UNUSED)
 {
-  const hb_ot_face_t *ot_face = (const hb_ot_face_t *) font_data;
-  const OT::vmtx_accelerator_t &vmtx = *ot_face->vmtx;
-  metrics->ascender = font->em_scale_x (vmtx.ascender);
-  metrics->descender = font->em_scale_x (vmtx.descender);
-  metrics->line_gap = font->em_scale_x (vmtx.line_gap);
-  // TODO Hook up variations.
-  return vmtx.has_font_extents;
+  const hb_ot_font_t *ot_font = (const hb_ot_font_t *) font_data;
+  hb_font_metrics_t scratch;
+  const int *values = _hb_ot_font_get_metrics (font, &ot_font->metrics, &scratch)->values;
+  metrics->ascender = font->em_scale_x (values[hb_font_metrics_t::VERTICAL_ASCENDER]);
+  metrics->descender = font->em_scale_x (values[hb_font_metrics_t::VERTICAL_DESCENDER]);
+  metrics->line_gap = font->em_scale_x (values[hb_font_metrics_t::VERTICAL_LINE_GAP]);
+  return ot_font->ot_face->vmtx->has_font_extents;
 }
 
 #if HB_USE_ATEXIT
@@ -268,7 +711,9 @@ static struct hb_ot_font_funcs_lazy_loader_t : hb_font_funcs_lazy_loader_t<hb_ot
     hb_font_funcs_set_glyph_v_advances_func (funcs, hb_ot_get_glyph_v_advances, nullptr, nullptr);
     //hb_font_funcs_set_glyph_h_origin_func (funcs, hb_ot_get_glyph_h_origin, nullptr, nullptr);
     hb_font_funcs_set_glyph_v_origin_func (funcs, hb_ot_get_glyph_v_origin, nullptr, nullptr);
+    hb_font_funcs_set_glyph_v_origins_func (funcs, hb_ot_get_glyph_v_origins, nullptr, nullptr);
     hb_font_funcs_set_glyph_extents_func (funcs, hb_ot_get_glyph_extents, nullptr, nullptr);
+    hb_font_funcs_set_glyph_extents_batch_func (funcs, hb_ot_get_glyph_extents_batch, nullptr, nullptr);
     //hb_font_funcs_set_glyph_contour_point_func (funcs, hb_ot_get_glyph_contour_point, nullptr, nullptr);
     hb_font_funcs_set_glyph_name_func (funcs, hb_ot_get_glyph_name, nullptr, nullptr);
     hb_font_funcs_set_glyph_from_name_func (funcs, hb_ot_get_glyph_from_name, nullptr, nullptr);
@@ -306,8 +751,173 @@ _hb_ot_get_font_funcs ()
 void
 hb_ot_font_set_funcs (hb_font_t *font)
 {
+  hb_ot_font_t *ot_font = _hb_ot_font_create (font);
+  if (unlikely (!ot_font))
+    return;
+
+  hb_font_set_funcs (font,
+		     _hb_ot_get_font_funcs (),
+		     ot_font,
+		     _hb_ot_font_destroy);
+}
+
+bool
+_hb_ot_font_set_funcs_like (hb_font_t *font, const hb_font_t *other)
+{
+  if (other->klass != _hb_ot_get_font_funcs ())
+    return false;
+
+  hb_ot_font_t *ot_font = _hb_ot_font_create (font);
+  if (unlikely (!ot_font))
+    return false;
+  ot_font->cmap_caching = ((const hb_ot_font_t *) other->user_data)->cmap_caching;
+  ot_font->extents_caching = ((const hb_ot_font_t *) other->user_data)->extents_caching;
+  ot_font->hinted_advances = ((const hb_ot_font_t *) other->user_data)->hinted_advances;
+
   hb_font_set_funcs (font,
 		     _hb_ot_get_font_funcs (),
-		     &font->face->table,
-		     nullptr);
+		     ot_font,
+		     _hb_ot_font_destroy);
+  return true;
+}
+
+unsigned int
+_hb_ot_font_get_memory_usage (const hb_font_t *font)
+{
+  if (font->klass != _hb_ot_get_font_funcs ())
+    return 0;
+
+  const hb_ot_font_t *ot_font = (const hb_ot_font_t *) font->user_data;
+  unsigned int bytes = sizeof (*ot_font);
+  if (ot_font->extents_cache.get ()) bytes += sizeof (hb_extents_cache_t);
+  if (ot_font->v_origin_cache.get ()) bytes += sizeof (hb_v_origin_cache_t);
+  if (ot_font->metrics.get ()) bytes += sizeof (hb_font_metrics_t);
+  return bytes;
+}
+
+/**
+ * hb_ot_font_set_cmap_caching:
+ * @font: a font using the OpenType font functions.
+ * @enabled: whether to cache character to glyph mappings.
+ *
+ * Enables or disables caching of nominal glyph lookups in @font.  When
+ * enabled, recently mapped characters are remembered, saving the cmap
+ * subtable search for text that keeps using the same characters, like
+ * CJK.
+ *
+ * Does nothing if @font is not using the OpenType font functions set with
+ * hb_ot_font_set_funcs().
+ *
+ * Since: REPLACEME
+ **/
+void
+hb_ot_font_set_cmap_caching (hb_font_t *font,
+			     hb_bool_t  enabled)
+{
+  if (hb_object_is_immutable (font) || font->klass != _hb_ot_get_font_funcs ())
+    return;
+
+  hb_ot_font_t *ot_font = (hb_ot_font_t *) font->user_data;
+  ot_font->cmap_caching = enabled;
+}
+
+/**
+ * hb_ot_font_set_glyph_extents_caching:
+ * @font: a font using the OpenType font functions.
+ * @enabled: whether to cache glyph extents.
+ *
+ * Enables or disables caching of glyph extents in @font.  When enabled,
+ * recently queried glyph extents, as produced by the glyf, CFF, CFF2,
+ * sbix and CBDT backends, are remembered until the font's variation
+ * coordinates or ppem change.  Useful when the same glyphs' extents are
+ * queried repeatedly, particularly for CFF fonts, where computing extents
+ * involves interpreting the glyph's charstring.
+ *
+ * Does nothing if @font is not using the OpenType font functions set with
+ * hb_ot_font_set_funcs().
+ *
+ * Since: REPLACEME
+ **/
+void
+hb_ot_font_set_glyph_extents_caching (hb_font_t *font,
+				      hb_bool_t  enabled)
+{
+  if (hb_object_is_immutable (font) || font->klass != _hb_ot_get_font_funcs ())
+    return;
+
+  hb_ot_font_t *ot_font = (hb_ot_font_t *) font->user_data;
+  ot_font->extents_caching = enabled;
+}
+
+/**
+ * hb_ot_font_get_metrics:
+ * @font: a font.
+ * @metrics: (out): return location for the metrics.
+ *
+ * Fetches all of @font's font-wide metrics at once, scaled to @font's
+ * scale and with any `MVAR` deltas for its variation coordinates applied.
+ * The metrics are read from the OpenType tables of @font's face, whatever
+ * font functions @font uses, and are cached for later calls, shared by
+ * all fonts of the face at the same variation coordinates.
+ *
+ * Metrics the face does not have are set to zero.
+ *
+ * Since: REPLACEME
+ **/
+void
+hb_ot_font_get_metrics (hb_font_t            *font,
+			hb_ot_font_metrics_t *metrics)
+{
+  hb_atomic_ptr_t<hb_font_metrics_t> *default_slot = nullptr;
+  if (font->klass == _hb_ot_get_font_funcs ())
+    default_slot = &((hb_ot_font_t *) font->user_data)->metrics;
+
+  hb_font_metrics_t scratch;
+  const int *values = _hb_ot_font_get_metrics (font, default_slot, &scratch)->values;
+
+  memset (metrics, 0, sizeof (*metrics));
+  metrics->ascender = font->em_scale_y (values[hb_font_metrics_t::ASCENDER]);
+  metrics->descender = font->em_scale_y (values[hb_font_metrics_t::DESCENDER]);
+  metrics->line_gap = font->em_scale_y (values[hb_font_metrics_t::LINE_GAP]);
+  metrics->vertical_ascender = font->em_scale_x (values[hb_font_metrics_t::VERTICAL_ASCENDER]);
+  metrics->vertical_descender = font->em_scale_x (values[hb_font_metrics_t::VERTICAL_DESCENDER]);
+  metrics->vertical_line_gap = font->em_scale_x (values[hb_font_metrics_t::VERTICAL_LINE_GAP]);
+  metrics->x_height = font->em_scale_y (values[hb_font_metrics_t::X_HEIGHT]);
+  metrics->cap_height = font->em_scale_y (values[hb_font_metrics_t::CAP_HEIGHT]);
+  metrics->underline_size = font->em_scale_y (values[hb_font_metrics_t::UNDERLINE_SIZE]);
+  metrics->underline_offset = font->em_scale_y (values[hb_font_metrics_t::UNDERLINE_OFFSET]);
+  metrics->strikeout_size = font->em_scale_y (values[hb_font_metrics_t::STRIKEOUT_SIZE]);
+  metrics->strikeout_offset = font->em_scale_y (values[hb_font_metrics_t::STRIKEOUT_OFFSET]);
+}
+
+/**
+ * hb_ot_font_set_hinted_advances:
+ * @font: a font using the OpenType font functions.
+ * @enabled: whether to use hinted advances.
+ *
+ * Enables or disables hinted horizontal advances in @font.  When enabled,
+ * and the face's `hdmx` table has device widths for @font's x ppem, glyph
+ * advances are taken from them instead of from `hmtx`, scaled from pixels
+ * to @font's scale.  Where the face has a `gasp` table, it must ask for
+ * grid-fitting at that ppem.  Only fonts at the default variation
+ * coordinates are affected, since `hdmx` describes only those.
+ *
+ * This gives the advances a hinting rasterizer would, without going
+ * through FreeType.  Runs of @font already in a #hb_shape_cache_t keep
+ * their old advances; clear it after changing this.
+ *
+ * Does nothing if @font is not using the OpenType font functions set with
+ * hb_ot_font_set_funcs().
+ *
+ * Since: REPLACEME
+ **/
+void
+hb_ot_font_set_hinted_advances (hb_font_t *font,
+				hb_bool_t  enabled)
+{
+  if (hb_object_is_immutable (font) || font->klass != _hb_ot_get_font_funcs ())
+    return;
+
+  hb_ot_font_t *ot_font = (hb_ot_font_t *) font->user_data;
+  ot_font->hinted_advances = enabled;
 }
@@ -39,6 +39,62 @@ HB_BEGIN_DECLS
 HB_EXTERN void
 hb_ot_font_set_funcs (hb_font_t *font);
 
+HB_EXTERN void
+hb_ot_font_set_cmap_caching (hb_font_t *font,
+			     hb_bool_t  enabled);
+
+HB_EXTERN void
+hb_ot_font_set_glyph_extents_caching (hb_font_t *font,
+				      hb_bool_t  enabled);
+
+HB_EXTERN void
+hb_ot_font_set_hinted_advances (hb_font_t *font,
+				hb_bool_t  enabled);
+
+/**
+ * hb_ot_font_metrics_t:
+ * @ascender: typographic ascender.
+ * @descender: typographic descender; usually negative.
+ * @line_gap: suggested line spacing gap.
+ * @vertical_ascender: ascender for vertical text.
+ * @vertical_descender: descender for vertical text.
+ * @vertical_line_gap: line gap for vertical text.
+ * @x_height: height of lowercase letters, from the `OS/2` table.
+ * @cap_height: height of capital letters, from the `OS/2` table.
+ * @underline_size: suggested underline thickness.
+ * @underline_offset: suggested underline position, from the baseline.
+ * @strikeout_size: suggested strikeout thickness.
+ * @strikeout_offset: suggested strikeout position, from the baseline.
+ *
+ * Font-wide metrics, as returned by hb_ot_font_get_metrics().
+ *
+ * Since: REPLACEME
+ */
+typedef struct hb_ot_font_metrics_t
+{
+  hb_position_t ascender;
+  hb_position_t descender;
+  hb_position_t line_gap;
+  hb_position_t vertical_ascender;
+  hb_position_t vertical_descender;
+  hb_position_t vertical_line_gap;
+  hb_position_t x_height;
+  hb_position_t cap_height;
+  hb_position_t underline_size;
+  hb_position_t underline_offset;
+  hb_position_t strikeout_size;
+  hb_position_t strikeout_offset;
+  /*< private >*/
+  hb_position_t reserved4;
+  hb_position_t reserved3;
+  hb_position_t reserved2;
+  hb_position_t reserved1;
+} hb_ot_font_metrics_t;
+
+HB_EXTERN void
+hb_ot_font_get_metrics (hb_font_t            *font,
+			hb_ot_font_metrics_t *metrics);
+
 
 HB_END_DECLS
 
@@ -59,9 +59,29 @@ struct gasp
 {
   enum { tableTag = HB_OT_TAG_gasp };
 
+  enum behavior_t {
+    GRIDFIT		= 1u<<0,
+    DOGRAY		= 1u<<1,
+    SYMMETRIC_GRIDFIT	= 1u<<2,
+    SYMMETRIC_SMOOTHING	= 1u<<3
+  };
+
+  bool has_data () const { return this != &Null (gasp); }
+
   const GaspRange &get_gasp_range (unsigned int i) const
   { return gaspRanges[i]; }
 
+  /* Returns the behavior flags for ppem; ranges are sorted by their
+   * upper limit. */
+  unsigned int get_behavior (unsigned int ppem) const
+  {
+    unsigned int count = gaspRanges.len;
+    for (unsigned int i = 0; i < count; i++)
+      if (ppem <= gaspRanges[i].rangeMaxPPEM)
+	return gaspRanges[i].rangeGaspBehavior;
+    return 0;
+  }
+
   bool sanitize (hb_sanitize_context_t *c) const
   {
     TRACE_SANITIZE (this);
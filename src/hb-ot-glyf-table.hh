@@ -238,18 +238,35 @@ struct glyf
 	return;
       short_offset = 0 == head.indexToLocFormat;
 
-      loca_table = hb_sanitize_context_t ().reference_table<loca> (face);
-      glyf_table = hb_sanitize_context_t ().reference_table<glyf> (face);
+      /* Neither table has any structure to check as a whole, so skip the
+       * sanitizer and just pin the blobs.  Every glyph record is range-checked
+       * when it is first touched, in get_offsets() and the users of it; the
+       * cost of opening a font is thus independent of its number of glyphs. */
+      loca_table = reference_table (face, HB_OT_TAG_loca);
+      glyf_table = reference_table (face, HB_OT_TAG_glyf);
 
       num_glyphs = MAX (1u, loca_table.get_length () / (short_offset ? 2 : 4)) - 1;
     }
 
     void fini ()
     {
+      component_graph_t *graph = component_graph.get ();
+      if (graph)
+      {
+	graph->fini ();
+	free (graph);
+      }
       loca_table.destroy ();
       glyf_table.destroy ();
     }
 
+    static hb_blob_t *reference_table (hb_face_t *face, hb_tag_t tag)
+    {
+      hb_blob_t *blob = hb_face_reference_table (face, tag);
+      hb_blob_make_immutable (blob);
+      return blob;
+    }
+
     /*
      * Returns true if the referenced glyph is a valid glyph and a composite glyph.
      * If true is returned a pointer to the composite glyph will be written into
@@ -270,6 +287,68 @@ struct glyf
 						 composite);
     }
 
+    /* Direct components of every glyph, taken from the composite glyph
+     * records, so closing over composites does not reparse glyphs that
+     * are shared by many parents. */
+    struct component_graph_t
+    {
+      void init () { starts.init (); components.init (); }
+      void fini () { starts.fini (); components.fini (); }
+
+      hb_array_t<const hb_codepoint_t> operator [] (hb_codepoint_t glyph) const
+      {
+	if (unlikely (glyph + 1 >= starts.length))
+	  return hb_array_t<const hb_codepoint_t> ();
+	return components.sub_array (starts[glyph], starts[glyph + 1] - starts[glyph]);
+      }
+
+      hb_vector_t<unsigned int> starts; /* num_glyphs + 1 entries. */
+      hb_vector_t<hb_codepoint_t> components;
+    };
+
+    /* Builds the component graph on first use; returns nullptr if
+     * out of memory. */
+    const component_graph_t *get_component_graph () const
+    {
+    retry:
+      component_graph_t *graph = component_graph.get ();
+      if (unlikely (!graph))
+      {
+	graph = (component_graph_t *) calloc (1, sizeof (component_graph_t));
+	if (unlikely (!graph))
+	  return nullptr;
+	graph->init ();
+	if (unlikely (!graph->starts.alloc (num_glyphs + 1)))
+	{
+	  free (graph);
+	  return nullptr;
+	}
+	for (unsigned int i = 0; i < num_glyphs; i++)
+	{
+	  graph->starts.push (graph->components.length);
+	  CompositeGlyphHeader::Iterator composite;
+	  if (get_composite (i, &composite))
+	    do
+	      graph->components.push (composite.current->glyphIndex);
+	    while (composite.move_to_next ());
+	}
+	graph->starts.push (graph->components.length);
+	if (unlikely (graph->starts.in_error () || graph->components.in_error ()))
+	{
+	  graph->fini ();
+	  free (graph);
+	  return nullptr;
+	}
+	if (unlikely (!component_graph.cmpexch (nullptr, graph)))
+	{
+	  graph->fini ();
+	  free (graph);
+	  goto retry;
+	}
+      }
+      return graph;
+    }
+
     enum simple_glyph_flag_t {
       FLAG_ON_CURVE = 0x01,
       FLAG_X_SHORT = 0x02,
@@ -299,14 +378,14 @@ struct glyf
       else if (num_contours > 0)
       {
 	/* simple glyph w/contours, possibly trimmable */
+	if (unlikely (GlyphHeader::static_size + 2 * (unsigned int) num_contours + 2 >= (unsigned int) (glyph_end - glyph))) return false;
 	glyph += GlyphHeader::static_size + 2 * num_contours;
 
-	if (unlikely (glyph + 2 >= glyph_end)) return false;
 	uint16_t nCoordinates = (uint16_t) StructAtOffset<HBUINT16> (glyph - 2, 0) + 1;
 	uint16_t nInstructions = (uint16_t) StructAtOffset<HBUINT16> (glyph, 0);
 
+	if (unlikely (2 + (unsigned int) nInstructions + 2 >= (unsigned int) (glyph_end - glyph))) return false;
 	glyph += 2 + nInstructions;
-	if (unlikely (glyph + 2 >= glyph_end)) return false;
 
 	unsigned int coordBytes = 0;
 	unsigned int coordsWithFlags = 0;
@@ -327,15 +406,11 @@ struct glyf
 	    glyph++;
 	  }
 
-	  unsigned int xBytes, yBytes;
-	  xBytes = yBytes = 0;
-	  if (flag & FLAG_X_SHORT) xBytes = 1;
-	  else if ((flag & FLAG_X_SAME) == 0) xBytes = 2;
-
-	  if (flag & FLAG_Y_SHORT) yBytes = 1;
-	  else if ((flag & FLAG_Y_SAME) == 0) yBytes = 2;
-
-	  coordBytes += (xBytes + yBytes) * repeat;
+	  /* Bytes of x and y coordinates per point, indexed by the
+	   * X_SHORT, Y_SHORT, X_SAME and Y_SAME bits. */
+	  static const uint8_t coord_bytes[16] = {4, 3, 3, 2, 2, 3, 1, 2,
+						  2, 1, 3, 2, 0, 1, 1, 2};
+	  coordBytes += coord_bytes[((flag >> 1) & 3) | ((flag >> 2) & 12)] * repeat;
 	  coordsWithFlags += repeat;
 	  if (coordsWithFlags >= nCoordinates)
 	    break;
@@ -346,10 +421,8 @@ struct glyf
 	  DEBUG_MSG(SUBSET, nullptr, "Expect %d coords to have flags, got flags for %d", nCoordinates, coordsWithFlags);
 	  return false;
 	}
-	glyph += coordBytes;
-
-	if (glyph < glyph_end)
-	  *end_offset -= glyph_end - glyph;
+	if (coordBytes < (unsigned int) (glyph_end - glyph))
+	  *end_offset -= (glyph_end - glyph) - coordBytes;
       }
       return true;
     }
@@ -440,6 +513,60 @@ struct glyf
       return true;
     }
 
+    /* Where a glyph's bytes are, and which of them are instructions. */
+    struct glyph_range_t
+    {
+      /* Bytes kept once the instructions are stripped. */
+      unsigned int get_stripped_length () const
+      { return end_offset - start_offset - (instruction_end - instruction_start); }
+
+      unsigned int start_offset;	/* Equal to end_offset if empty. */
+      unsigned int end_offset;
+      unsigned int instruction_start;	/* Equal to instruction_end if none. */
+      unsigned int instruction_end;
+    };
+
+    /* Fills in ranges[i] for glyphs[i], with padding removed and, if
+     * strip_instructions, the instruction bytes to drop.  Invalid and
+     * 0-length glyphs get empty ranges.  Returns false if a glyph's
+     * instructions are malformed. */
+    bool get_glyph_ranges (hb_array_t<const hb_codepoint_t> glyphs,
+			   bool strip_instructions,
+			   glyph_range_t *ranges /* OUT */) const
+    {
+      for (unsigned int i = 0; i < glyphs.length; i++)
+      {
+	glyph_range_t *range = &ranges[i];
+	range->start_offset = range->end_offset = 0;
+	range->instruction_start = range->instruction_end = 0;
+
+	if (glyphs[i] == HB_MAP_VALUE_INVALID)
+	  continue; /* Left empty. */
+
+	unsigned int start_offset, end_offset;
+	if (unlikely (!(get_offsets (glyphs[i], &start_offset, &end_offset) &&
+			remove_padding (start_offset, &end_offset))))
+	{
+	  DEBUG_MSG(SUBSET, nullptr, "Invalid gid %d", glyphs[i]);
+	  continue;
+	}
+	if (end_offset - start_offset < GlyphHeader::static_size)
+	  continue; /* 0-length glyph */
+
+	if (strip_instructions &&
+	    unlikely (!get_instruction_offsets (start_offset, end_offset,
+						&range->instruction_start,
+						&range->instruction_end)))
+	{
+	  DEBUG_MSG(SUBSET, nullptr, "Unable to get instruction offsets for %d", glyphs[i]);
+	  return false;
+	}
+	range->start_offset = start_offset;
+	range->end_offset = end_offset;
+      }
+      return true;
+    }
+
     bool get_extents (hb_codepoint_t glyph, hb_glyph_extents_t *extents) const
     {
       unsigned int start_offset, end_offset;
@@ -464,6 +591,7 @@ struct glyf
     unsigned int num_glyphs;
     hb_blob_ptr_t<loca> loca_table;
     hb_blob_ptr_t<glyf> glyf_table;
+    mutable hb_atomic_ptr_t<component_graph_t> component_graph;
   };
 
   protected:
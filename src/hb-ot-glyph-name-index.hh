@@ -0,0 +1,132 @@
+/*
+ * Copyright © 2018  Google, Inc.
+ *
+ *  This is part of HarfBuzz, a text shaping library.
+ *
+ * Permission is hereby granted, without written agreement and without
+ * license or royalty fees, to use, copy, modify, and distribute this
+ * software and its documentation for any purpose, provided that the
+ * above copyright notice and the following two paragraphs appear in
+ * all copies of this software.
+ *
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE TO ANY PARTY FOR
+ * DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES
+ * ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION, EVEN
+ * IF THE COPYRIGHT HOLDER HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * THE COPYRIGHT HOLDER SPECIFICALLY DISCLAIMS ANY WARRANTIES, INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER IS
+ * ON AN "AS IS" BASIS, AND THE COPYRIGHT HOLDER HAS NO OBLIGATION TO
+ * PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+ */
+
+#ifndef HB_OT_GLYPH_NAME_INDEX_HH
+#define HB_OT_GLYPH_NAME_INDEX_HH
+
+#include "hb.hh"
+
+
+/*
+ * Hash index from glyph names to glyph ids, shared by the post and CFF
+ * tables.  The names themselves stay in the table; Names is a function
+ * object returning the name of a glyph as an hb_bytes_t.
+ *
+ * Entries are the glyph id in the low 16 bits and the top 16 bits of the
+ * name's hash in the high ones, so most mismatches are rejected without
+ * looking at the name.  Open addressing, at most half full.
+ */
+
+struct hb_glyph_name_index_t
+{
+  enum { EMPTY = 0xFFFFFFFFu };
+
+  static uint32_t hash (hb_bytes_t name)
+  {
+    uint32_t h = 2166136261u; /* FNV-1a */
+    for (unsigned int i = 0; i < name.length; i++)
+      h = (h ^ (uint8_t) name[i]) * 16777619u;
+    return h;
+  }
+
+  /* Builds the index of the first num_glyphs glyphs; if several have the
+   * same name, the first one wins. */
+  template <typename Names>
+  static hb_glyph_name_index_t *create (const Names &names, unsigned int num_glyphs)
+  {
+    num_glyphs = MIN (num_glyphs, 0xFFFFu);
+    unsigned int size = 16;
+    while (size < 2 * num_glyphs)
+      size *= 2;
+
+    hb_glyph_name_index_t *index = (hb_glyph_name_index_t *)
+      malloc (sizeof (hb_glyph_name_index_t) + size * sizeof (uint32_t));
+    if (unlikely (!index))
+      return nullptr;
+    index->mask = size - 1;
+    index->entries = (uint32_t *) (index + 1);
+    memset (index->entries, 0xFF, size * sizeof (uint32_t));
+
+    for (unsigned int glyph = 0; glyph < num_glyphs; glyph++)
+    {
+      hb_bytes_t name = names (glyph);
+      if (!name.length)
+	continue;
+      uint32_t h = hash (name);
+      unsigned int i;
+      if (index->find_slot (names, name, h, &i))
+	continue;
+      index->entries[i] = (h & 0xFFFF0000u) | glyph;
+    }
+
+    return index;
+  }
+
+  void destroy () { free (this); }
+
+  unsigned int get_size () const
+  { return sizeof (*this) + (mask + 1) * sizeof (uint32_t); }
+
+  template <typename Names>
+  bool find (const Names &names, hb_bytes_t name, hb_codepoint_t *glyph) const
+  {
+    unsigned int i;
+    if (!find_slot (names, name, hash (name), &i))
+      return false;
+    *glyph = entries[i] & 0xFFFFu;
+    return true;
+  }
+
+  private:
+  /* Sets *slot to the entry for name if there is one, and returns true;
+   * otherwise to the empty entry where it would go. */
+  template <typename Names>
+  bool find_slot (const Names &names, hb_bytes_t name, uint32_t h,
+		  unsigned int *slot) const
+  {
+    unsigned int i = h & mask;
+    for (;;)
+    {
+      uint32_t entry = entries[i];
+      if (entry == EMPTY)
+      {
+	*slot = i;
+	return false;
+      }
+      if ((entry & 0xFFFF0000u) == (h & 0xFFFF0000u) &&
+	  !names (entry & 0xFFFFu).cmp (name))
+      {
+	*slot = i;
+	return true;
+      }
+      i = (i + 1) & mask;
+    }
+  }
+
+  unsigned int mask;
+  uint32_t *entries;
+};
+
+
+#endif /* HB_OT_GLYPH_NAME_INDEX_HH */
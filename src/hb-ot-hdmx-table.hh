@@ -41,6 +41,17 @@ namespace OT {
 
 struct DeviceRecord
 {
+  /* Widths of glyphs past num_widths, which is sizeDeviceRecord less
+   * min_size, are not recorded. */
+  bool get_width (hb_codepoint_t glyph, unsigned int num_widths,
+		  unsigned int *width) const
+  {
+    if (unlikely (glyph >= num_widths))
+      return false;
+    *width = widthsZ[glyph];
+    return true;
+  }
+
   struct SubsetView
   {
     const DeviceRecord *source_device_record;
@@ -63,6 +74,8 @@ struct DeviceRecord
     {
       if (unlikely (i >= len ())) return nullptr;
       hb_codepoint_t gid = this->subset_plan->glyphs [i];
+      if (gid == HB_MAP_VALUE_INVALID)
+	return &Null (HBUINT8); /* Not retained; left zero. */
 
       if (gid >= sizeDeviceRecord - DeviceRecord::min_size)
         return nullptr;
@@ -132,6 +145,18 @@ struct hdmx
     return StructAtOffset<DeviceRecord> (&this->firstDeviceRecord, i * sizeDeviceRecord);
   }
 
+  /* Returns the index of the record for ppem, or -1. */
+  int find_record (unsigned int ppem) const
+  {
+    for (unsigned int i = 0; i < numRecords; i++)
+      if ((*this)[i].pixelSize == ppem)
+	return i;
+    return -1;
+  }
+
+  unsigned int get_num_widths () const
+  { return sizeDeviceRecord - DeviceRecord::min_size; }
+
   bool serialize (hb_serialize_context_t *c, const hdmx *source_hdmx, hb_subset_plan_t *plan)
   {
     TRACE_SERIALIZE (this);
@@ -67,6 +67,9 @@ struct head
   bool is_italic () const    { return macStyle & ITALIC; }
   bool is_condensed () const { return macStyle & CONDENSED; }
 
+  /* Changes with any table of the font file. */
+  uint32_t get_checksum_adjustment () const { return checkSumAdjustment; }
+
   bool sanitize (hb_sanitize_context_t *c) const
   {
     TRACE_SANITIZE (this);
@@ -31,6 +31,7 @@
 #include "hb-ot-hhea-table.hh"
 #include "hb-ot-os2-table.hh"
 #include "hb-ot-var-hvar-table.hh"
+#include "hb-cache.hh"
 
 /*
  * hmtx -- Horizontal Metrics
@@ -86,6 +87,10 @@ struct hmtxvmtx
     return result;
   }
 
+  template <typename accelerator_t>
+  static unsigned int get_subset_advance (const accelerator_t &_mtx, hb_codepoint_t gid)
+  { return gid == HB_MAP_VALUE_INVALID ? 0 : _mtx.get_advance (gid); }
+
   bool subset (hb_subset_plan_t *plan) const
   {
     typename T::accelerator_t _mtx;
@@ -95,9 +100,9 @@ struct hmtxvmtx
      * and just keep LSB */
     hb_vector_t<hb_codepoint_t> &gids = plan->glyphs;
     unsigned int num_advances = gids.length;
-    unsigned int last_advance = _mtx.get_advance (gids[num_advances - 1]);
+    unsigned int last_advance = get_subset_advance (_mtx, gids[num_advances - 1]);
     while (num_advances > 1 &&
-	   last_advance == _mtx.get_advance (gids[num_advances - 2]))
+	   last_advance == get_subset_advance (_mtx, gids[num_advances - 2]))
     {
       num_advances--;
     }
@@ -122,6 +127,14 @@ struct hmtxvmtx
     bool failed = false;
     for (unsigned int i = 0; i < gids.length; i++)
     {
+      if (gids[i] == HB_MAP_VALUE_INVALID)
+      {
+	/* Not retained; zero advance and side bearing. */
+	memset (dest_pos, 0, i < num_advances ? 4 : 2);
+	dest_pos += (i < num_advances ? 4 : 2);
+	continue;
+      }
+
       /* the last metric or the one for gids[i] */
       LongMetric *src_metric = old_metrics + MIN ((hb_codepoint_t) _mtx.num_advances - 1, gids[i]);
       if (gids[i] < _mtx.num_advances)
@@ -269,17 +282,41 @@ struct hmtxvmtx
       return table->longMetricZ[MIN (glyph, (uint32_t) num_advances - 1)].advance;
     }
 
-    unsigned int get_advance (hb_codepoint_t  glyph,
-			      hb_font_t      *font) const
+    /* If cache is given, it must be cleared by the caller whenever
+     * font's variation coordinates change.  Likewise, store_cache, as
+     * returned by get_var_store_cache(), is only valid for the font's
+     * current coordinates. */
+    unsigned int get_advance (hb_codepoint_t      glyph,
+			      hb_font_t          *font,
+			      hb_advance_cache_t *cache = nullptr,
+			      VariationStore::cache_t *store_cache = nullptr) const
     {
       unsigned int advance = get_advance (glyph);
-      if (likely (glyph < num_metrics))
+      if (likely (glyph < num_metrics) && font->num_coords)
       {
-	advance += (font->num_coords ? var_table->get_advance_var (glyph, font->coords, font->num_coords) : 0); // TODO Optimize?!
+	unsigned int cached;
+	if (cache && cache->get (glyph, &cached))
+	  return cached;
+
+	advance += var_table->get_advance_var (glyph, font->coords, font->num_coords,
+					       store_cache ? store_cache : get_var_store_cache (font));
+
+	if (cache)
+	  cache->set (glyph, advance);
       }
       return advance;
     }
 
+    VariationStore::cache_t *get_var_store_cache (const hb_font_t *font) const
+    {
+      return font->get_var_store_cache (T::tableTag == HB_OT_TAG_vmtx ?
+					hb_font_instance_t::VVAR : hb_font_instance_t::HVAR,
+					var_table->get_var_store ());
+    }
+
+    /* Whether advances come from the table rather than the default. */
+    bool has_data () const { return num_metrics; }
+
     public:
     bool has_font_extents;
     int ascender;
@@ -323,6 +323,52 @@ struct kern
     return_trace (dispatch (c));
   }
 
+  struct accelerator_t
+  {
+    void init (hb_face_t *face)
+    {
+      table = hb_sanitize_context_t ().reference_table<kern> (face);
+      pair_maps.init ();
+      switch (table->get_type ()) {
+      case 0: table->u.ot.collect_pair_maps (&pair_maps); break;
+      case 1: table->u.aat.collect_pair_maps (&pair_maps); break;
+      default:break;
+      }
+    }
+    void fini ()
+    {
+      for (unsigned int i = 0; i < pair_maps.length; i++)
+	hb_map_destroy (pair_maps[i]);
+      pair_maps.fini ();
+      table.destroy ();
+    }
+
+    unsigned int get_memory_usage () const
+    {
+      unsigned int size = pair_maps.get_allocated_size ();
+      for (unsigned int i = 0; i < pair_maps.length; i++)
+	if (pair_maps[i])
+	  size += sizeof (*pair_maps[i]) + pair_maps[i]->get_memory_usage ();
+      return size;
+    }
+
+    bool has_data () const { return table->has_data (); }
+    bool has_state_machine () const { return table->has_state_machine (); }
+    bool has_cross_stream () const { return table->has_cross_stream (); }
+    hb_blob_t *get_blob () const { return table.get_blob (); }
+
+    bool apply (AAT::hb_aat_apply_context_t *c) const
+    {
+      c->set_pair_maps (&pair_maps);
+      return table->apply (c);
+    }
+
+    private:
+    hb_blob_ptr_t<kern> table;
+    /* Per subtable; see AAT::KerxTable::collect_pair_maps(). */
+    hb_vector_t<hb_map_t *> pair_maps;
+  };
+
   protected:
   union {
   HBUINT32		version32;
@@ -334,6 +380,8 @@ struct kern
   DEFINE_SIZE_UNION (4, version32);
 };
 
+struct kern_accelerator_t : kern::accelerator_t {};
+
 } /* namespace OT */
 
 
@@ -560,9 +560,27 @@ struct Feature
   bool subset (hb_subset_context_t *c) const
   {
     TRACE_SUBSET (this);
-    struct Feature *out = c->serializer->embed (*this);
-    if (unlikely (!out)) return_trace (false);
+    const hb_map_t *lookup_index_map = c->lookup_index_map;
+    if (!lookup_index_map)
+    {
+      struct Feature *out = c->serializer->embed (*this);
+      if (unlikely (!out)) return_trace (false);
+      out->featureParams.set (0); /* TODO(subset) FeatureParams. */
+      return_trace (true);
+    }
+
+    struct Feature *out = c->serializer->start_embed<Feature> ();
+    if (unlikely (!c->serializer->extend_min (*out))) return_trace (false);
     out->featureParams.set (0); /* TODO(subset) FeatureParams. */
+    unsigned int count = lookupIndex.len;
+    unsigned int retained = 0;
+    for (unsigned int i = 0; i < count; i++)
+      retained += lookup_index_map->has (lookupIndex[i]);
+    if (unlikely (!out->lookupIndex.serialize (c->serializer, retained))) return_trace (false);
+    retained = 0;
+    for (unsigned int i = 0; i < count; i++)
+      if (lookup_index_map->has (lookupIndex[i]))
+	out->lookupIndex[retained++].set (lookup_index_map->get (lookupIndex[i]));
     return_trace (true);
   }
 
@@ -740,17 +758,28 @@ struct Lookup
     struct Lookup *out = c->serializer->embed (*this);
     if (unlikely (!out)) return_trace (false);
 
-    /* Subset the actual subtables. */
-    /* TODO Drop empty ones, either by calling intersects() beforehand,
-     * or just dropping null offsets after. */
+    /* Subset the actual subtables, dropping the ones that subset to
+     * nothing; everything after the array only moves down by the size
+     * of the dropped offsets. */
     const OffsetArrayOf<TSubTable>& subtables = get_subtables<TSubTable> ();
     OffsetArrayOf<TSubTable>& out_subtables = out->get_subtables<TSubTable> ();
     unsigned int count = subTable.len;
+    unsigned int retained = 0;
     for (unsigned int i = 0; i < count; i++)
     {
       SubTableSubsetWrapper<TSubTable> wrapper (this+subtables[i], get_type ());
 
-      out_subtables[i].serialize_subset (c, wrapper, out);
+      retained += out_subtables.arrayZ[retained].serialize_subset (c, wrapper, out);
+    }
+    if (!retained)
+      return_trace (false);
+    if (retained < count)
+    {
+      char *array_end = (char *) &out_subtables.arrayZ[count];
+      unsigned int shrink = (count - retained) * out_subtables[0].static_size;
+      memmove (array_end - shrink, array_end, c->serializer->head - array_end);
+      c->serializer->revert (c->serializer->head - shrink);
+      out_subtables.len.set (retained);
     }
 
     return_trace (true);
@@ -1477,6 +1506,9 @@ struct ClassDef
     }
   }
 
+  /* Format 1 is already a flat array; only format 2 needs a search. */
+  bool is_flat () const { return u.format != 2; }
+
   bool serialize (hb_serialize_context_t *c,
 		  hb_array_t<const GlyphID> glyphs,
 		  hb_array_t<const HBUINT16> klasses)
@@ -1632,14 +1664,30 @@ struct VarRegionAxis
   DEFINE_SIZE_STATIC (6);
 };
 
+#define REGION_CACHE_ITEM_CACHE_INVALID 2.f
+
 struct VarRegionList
 {
+  /* A region scalar cache is an array of regionCount floats, initialized
+   * to REGION_CACHE_ITEM_CACHE_INVALID.  Scalars only depend on coords,
+   * so a cache is only valid for one set of coordinates. */
+  typedef float cache_t;
+
   float evaluate (unsigned int region_index,
-			 const int *coords, unsigned int coord_len) const
+		  const int *coords, unsigned int coord_len,
+		  cache_t *cache = nullptr) const
   {
     if (unlikely (region_index >= regionCount))
       return 0.;
 
+    float *cached_value = nullptr;
+    if (cache)
+    {
+      cached_value = &(cache[region_index]);
+      if (likely (*cached_value != REGION_CACHE_ITEM_CACHE_INVALID))
+	return *cached_value;
+    }
+
     const VarRegionAxis *axes = axesZ.arrayZ + (region_index * axisCount);
 
     float v = 1.;
@@ -1649,9 +1697,15 @@ struct VarRegionList
       int coord = i < coord_len ? coords[i] : 0;
       float factor = axes[i].evaluate (coord);
       if (factor == 0.f)
-	return 0.;
+      {
+	v = 0.;
+	break;
+      }
       v *= factor;
     }
+
+    if (cached_value)
+      *cached_value = v;
     return v;
   }
 
@@ -1685,8 +1739,9 @@ struct VarData
   { return itemCount * get_row_size (); }
 
   float get_delta (unsigned int inner,
-			  const int *coords, unsigned int coord_count,
-			  const VarRegionList &regions) const
+		   const int *coords, unsigned int coord_count,
+		   const VarRegionList &regions,
+		   VarRegionList::cache_t *cache = nullptr) const
   {
     if (unlikely (inner >= itemCount))
       return 0.;
@@ -1703,13 +1758,13 @@ struct VarData
    const HBINT16 *scursor = reinterpret_cast<const HBINT16 *> (row);
    for (; i < scount; i++)
    {
-     float scalar = regions.evaluate (regionIndices.arrayZ[i], coords, coord_count);
+     float scalar = regions.evaluate (regionIndices.arrayZ[i], coords, coord_count, cache);
      delta += scalar * *scursor++;
    }
    const HBINT8 *bcursor = reinterpret_cast<const HBINT8 *> (scursor);
    for (; i < count; i++)
    {
-     float scalar = regions.evaluate (regionIndices.arrayZ[i], coords, coord_count);
+     float scalar = regions.evaluate (regionIndices.arrayZ[i], coords, coord_count, cache);
      delta += scalar * *bcursor++;
    }
 
@@ -1719,12 +1774,13 @@ struct VarData
   void get_scalars (int *coords, unsigned int coord_count,
                     const VarRegionList &regions,
                     float *scalars /*OUT */,
-                    unsigned int num_scalars) const
+                    unsigned int num_scalars,
+                    VarRegionList::cache_t *cache = nullptr) const
   {
     assert (num_scalars == regionIndices.len);
    for (unsigned int i = 0; i < num_scalars; i++)
    {
-     scalars[i] = regions.evaluate (regionIndices.arrayZ[i], coords, coord_count);
+     scalars[i] = regions.evaluate (regionIndices.arrayZ[i], coords, coord_count, cache);
    }
   }
 
@@ -1750,23 +1806,63 @@ struct VarData
 
 struct VariationStore
 {
+  typedef VarRegionList::cache_t cache_t;
+
+  /* Returns nullptr if the store has no regions or on allocation failure;
+   * both are fine to pass to get_delta(). */
+  cache_t *create_cache () const
+  {
+    unsigned int count = (this+regions).get_region_count ();
+    if (!count)
+      return nullptr;
+
+    cache_t *cache = (cache_t *) malloc (sizeof (cache_t) * count);
+    if (unlikely (!cache))
+      return nullptr;
+
+    for (unsigned int i = 0; i < count; i++)
+      cache[i] = REGION_CACHE_ITEM_CACHE_INVALID;
+
+    return cache;
+  }
+
+  /* As above, but with every scalar already evaluated at coords. */
+  cache_t *create_cache (const int *coords, unsigned int coord_count) const
+  {
+    cache_t *cache = create_cache ();
+    if (unlikely (!cache))
+      return nullptr;
+
+    const VarRegionList &region_list = this+regions;
+    unsigned int count = region_list.get_region_count ();
+    for (unsigned int i = 0; i < count; i++)
+      region_list.evaluate (i, coords, coord_count, cache);
+
+    return cache;
+  }
+
+  static void destroy_cache (cache_t *cache) { free (cache); }
+
   float get_delta (unsigned int outer, unsigned int inner,
-		   const int *coords, unsigned int coord_count) const
+		   const int *coords, unsigned int coord_count,
+		   cache_t *cache = nullptr) const
   {
     if (unlikely (outer >= dataSets.len))
       return 0.;
 
     return (this+dataSets[outer]).get_delta (inner,
 					     coords, coord_count,
-					     this+regions);
+					     this+regions,
+					     cache);
   }
 
   float get_delta (unsigned int index,
-		   const int *coords, unsigned int coord_count) const
+		   const int *coords, unsigned int coord_count,
+		   cache_t *cache = nullptr) const
   {
     unsigned int outer = index >> 16;
     unsigned int inner = index & 0xFFFF;
-    return get_delta (outer, inner, coords, coord_count);
+    return get_delta (outer, inner, coords, coord_count, cache);
   }
 
   bool sanitize (hb_sanitize_context_t *c) const
@@ -1778,16 +1874,19 @@ struct VariationStore
 		  dataSets.sanitize (c, this));
   }
 
+  unsigned int get_sub_table_count () const { return dataSets.len; }
+
   unsigned int get_region_index_count (unsigned int ivs) const
   { return (this+dataSets[ivs]).get_region_index_count (); }
 
   void get_scalars (unsigned int ivs,
 		    int *coords, unsigned int coord_count,
 		    float *scalars /*OUT*/,
-		    unsigned int num_scalars) const
+		    unsigned int num_scalars,
+		    cache_t *cache = nullptr) const
   {
     (this+dataSets[ivs]).get_scalars (coords, coord_count, this+regions,
-                                      &scalars[0], num_scalars);
+                                      &scalars[0], num_scalars, cache);
   }
 
   protected:
@@ -1848,6 +1947,15 @@ struct Condition
     }
   }
 
+  bool subset (hb_subset_context_t *c) const
+  {
+    TRACE_SUBSET (this);
+    switch (u.format) {
+    case 1: return_trace (c->serializer->embed (u.format1));
+    default:return_trace (c->serializer->embed (u.format));
+    }
+  }
+
   protected:
   union {
   HBUINT16		format;		/* Format identifier */
@@ -1868,6 +1976,17 @@ struct ConditionSet
     return true;
   }
 
+  bool subset (hb_subset_context_t *c) const
+  {
+    TRACE_SUBSET (this);
+    struct ConditionSet *out = c->serializer->embed (*this);
+    if (unlikely (!out)) return_trace (false);
+    unsigned int count = conditions.len;
+    for (unsigned int i = 0; i < count; i++)
+      out->conditions.arrayZ[i].serialize_subset (c, this+conditions.arrayZ[i], out);
+    return_trace (true);
+  }
+
   bool sanitize (hb_sanitize_context_t *c) const
   {
     TRACE_SANITIZE (this);
@@ -1877,7 +1996,7 @@ struct ConditionSet
   protected:
   LOffsetArrayOf<Condition>	conditions;
   public:
-  DEFINE_SIZE_ARRAY (2, conditions);
+  DEFINE_SIZE_ARRAY_SIZED (2, conditions);
 };
 
 struct FeatureTableSubstitutionRecord
@@ -1911,6 +2030,24 @@ struct FeatureTableSubstitution
     return nullptr;
   }
 
+  void collect_lookups (hb_set_t *lookup_indexes) const
+  {
+    unsigned int count = substitutions.len;
+    for (unsigned int i = 0; i < count; i++)
+      (this+substitutions.arrayZ[i].feature).add_lookup_indexes_to (lookup_indexes);
+  }
+
+  bool subset (hb_subset_context_t *c) const
+  {
+    TRACE_SUBSET (this);
+    struct FeatureTableSubstitution *out = c->serializer->embed (*this);
+    if (unlikely (!out)) return_trace (false);
+    unsigned int count = substitutions.len;
+    for (unsigned int i = 0; i < count; i++)
+      out->substitutions.arrayZ[i].feature.serialize_subset (c, this+substitutions.arrayZ[i].feature, out);
+    return_trace (true);
+  }
+
   bool sanitize (hb_sanitize_context_t *c) const
   {
     TRACE_SANITIZE (this);
@@ -1924,7 +2061,7 @@ struct FeatureTableSubstitution
   ArrayOf<FeatureTableSubstitutionRecord>
 			substitutions;
   public:
-  DEFINE_SIZE_ARRAY (6, substitutions);
+  DEFINE_SIZE_ARRAY_SIZED (6, substitutions);
 };
 
 struct FeatureVariationRecord
@@ -1975,10 +2112,27 @@ struct FeatureVariations
     return (this+record.substitutions).find_substitute (feature_index);
   }
 
+  void collect_lookups (hb_set_t *lookup_indexes) const
+  {
+    unsigned int count = varRecords.len;
+    for (unsigned int i = 0; i < count; i++)
+      (this+varRecords.arrayZ[i].substitutions).collect_lookups (lookup_indexes);
+  }
+
   bool subset (hb_subset_context_t *c) const
   {
     TRACE_SUBSET (this);
-    return_trace (c->serializer->embed (*this));
+    struct FeatureVariations *out = c->serializer->embed (*this);
+    if (unlikely (!out)) return_trace (false);
+    unsigned int count = varRecords.len;
+    for (unsigned int i = 0; i < count; i++)
+    {
+      const FeatureVariationRecord &record = varRecords.arrayZ[i];
+      FeatureVariationRecord &out_record = out->varRecords.arrayZ[i];
+      out_record.conditions.serialize_subset (c, this+record.conditions, out);
+      out_record.substitutions.serialize_subset (c, this+record.substitutions, out);
+    }
+    return_trace (true);
   }
 
   bool sanitize (hb_sanitize_context_t *c) const
@@ -2082,11 +2236,15 @@ struct VariationDevice
 
   private:
 
-  hb_position_t get_x_delta (hb_font_t *font, const VariationStore &store) const
-  { return font->em_scalef_x (get_delta (font, store)); }
+  hb_position_t get_x_delta (hb_font_t *font,
+			     const VariationStore &store,
+			     VariationStore::cache_t *store_cache = nullptr) const
+  { return font->em_scalef_x (get_delta (font, store, store_cache)); }
 
-  hb_position_t get_y_delta (hb_font_t *font, const VariationStore &store) const
-  { return font->em_scalef_y (get_delta (font, store)); }
+  hb_position_t get_y_delta (hb_font_t *font,
+			     const VariationStore &store,
+			     VariationStore::cache_t *store_cache = nullptr) const
+  { return font->em_scalef_y (get_delta (font, store, store_cache)); }
 
   bool sanitize (hb_sanitize_context_t *c) const
   {
@@ -2096,9 +2254,11 @@ struct VariationDevice
 
   private:
 
-  float get_delta (hb_font_t *font, const VariationStore &store) const
+  float get_delta (hb_font_t *font,
+		   const VariationStore &store,
+		   VariationStore::cache_t *store_cache = nullptr) const
   {
-    return store.get_delta (outerIndex, innerIndex, font->coords, font->num_coords);
+    return store.get_delta (outerIndex, innerIndex, font->coords, font->num_coords, store_cache);
   }
 
   protected:
@@ -2122,26 +2282,30 @@ struct DeviceHeader
 
 struct Device
 {
-  hb_position_t get_x_delta (hb_font_t *font, const VariationStore &store=Null (VariationStore)) const
+  hb_position_t get_x_delta (hb_font_t *font,
+			     const VariationStore &store=Null (VariationStore),
+			     VariationStore::cache_t *store_cache = nullptr) const
   {
     switch (u.b.format)
     {
     case 1: case 2: case 3:
       return u.hinting.get_x_delta (font);
     case 0x8000:
-      return u.variation.get_x_delta (font, store);
+      return u.variation.get_x_delta (font, store, store_cache);
     default:
       return 0;
     }
   }
-  hb_position_t get_y_delta (hb_font_t *font, const VariationStore &store=Null (VariationStore)) const
+  hb_position_t get_y_delta (hb_font_t *font,
+			     const VariationStore &store=Null (VariationStore),
+			     VariationStore::cache_t *store_cache = nullptr) const
   {
     switch (u.b.format)
     {
     case 1: case 2: case 3:
       return u.hinting.get_y_delta (font);
     case 0x8000:
-      return u.variation.get_y_delta (font, store);
+      return u.variation.get_y_delta (font, store, store_cache);
     default:
       return 0;
     }
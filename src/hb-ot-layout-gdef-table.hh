@@ -422,11 +422,79 @@ struct GDEF
 	hb_blob_destroy (this->table.get_blob ());
 	this->table = hb_blob_get_empty ();
       }
+
+      this->num_glyphs = face->get_num_glyphs ();
+      this->glyph_props.init ();
+
+      /* Props from hb_face_attach_accelerators(), if any. */
+      this->glyph_props_attached = false;
+      hb_bytes_t attached = _hb_ot_face_get_attached_accelerator (face, HB_OT_TAG_GDEF);
+      if (attached.length && attached.length == num_glyphs * sizeof (uint16_t))
+      {
+	this->glyph_props.set_relaxed ((uint16_t *) attached.arrayZ);
+	this->glyph_props_attached = true;
+      }
+    }
+
+    void fini ()
+    {
+      if (!this->glyph_props_attached)
+	free (this->glyph_props.get ());
+      this->table.destroy ();
+    }
+
+    unsigned int get_memory_usage () const
+    {
+      return this->glyph_props.get () && !this->glyph_props_attached ?
+	     num_glyphs * sizeof (uint16_t) : 0;
+    }
+
+    /* Same as GDEF::get_glyph_props(), but served from a dense per-glyph
+     * array that is built on first use, saving two ClassDef lookups per
+     * call. */
+    unsigned int get_glyph_props (hb_codepoint_t glyph) const
+    {
+      const uint16_t *props = get_glyph_props_array ();
+      if (likely (props && glyph < num_glyphs))
+	return props[glyph];
+      return table->get_glyph_props (glyph);
     }
 
-    void fini () { this->table.destroy (); }
+    /* The dense array, num_glyphs long; nullptr if not worth building. */
+    const uint16_t *get_glyph_props_array () const
+    {
+    retry:
+      uint16_t *props = this->glyph_props.get ();
+      if (likely (props))
+	return props;
+
+      /* Without glyph classes every glyph has zero props and the
+       * table lookup is trivial; don't bother. */
+      if (!table->has_glyph_classes () || !num_glyphs)
+	return nullptr;
+
+      props = (uint16_t *) malloc (num_glyphs * sizeof (props[0]));
+      if (unlikely (!props))
+	return nullptr;
+
+      for (unsigned int i = 0; i < num_glyphs; i++)
+	props[i] = table->get_glyph_props (i);
 
+      if (unlikely (!this->glyph_props.cmpexch (nullptr, props)))
+      {
+	free (props);
+	goto retry;
+      }
+      return props;
+    }
+
+    public:
     hb_blob_ptr_t<GDEF> table;
+    unsigned int num_glyphs;
+
+    private:
+    mutable hb_atomic_ptr_t<uint16_t> glyph_props;
+    bool glyph_props_attached; /* Points into the face's attached accelerators. */
   };
 
   unsigned int get_size () const
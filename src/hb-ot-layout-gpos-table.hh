@@ -133,23 +133,24 @@ struct ValueFormat : HBUINT16
     if (!use_x_device && !use_y_device) return ret;
 
     const VariationStore &store = c->var_store;
+    VariationStore::cache_t *store_cache = c->var_store_cache;
 
     /* pixel -> fractional pixel */
     if (format & xPlaDevice) {
-      if (use_x_device) glyph_pos.x_offset  += (base + get_device (values, &ret)).get_x_delta (font, store);
+      if (use_x_device) glyph_pos.x_offset  += (base + get_device (values, &ret)).get_x_delta (font, store, store_cache);
       values++;
     }
     if (format & yPlaDevice) {
-      if (use_y_device) glyph_pos.y_offset  += (base + get_device (values, &ret)).get_y_delta (font, store);
+      if (use_y_device) glyph_pos.y_offset  += (base + get_device (values, &ret)).get_y_delta (font, store, store_cache);
       values++;
     }
     if (format & xAdvDevice) {
-      if (horizontal && use_x_device) glyph_pos.x_advance += (base + get_device (values, &ret)).get_x_delta (font, store);
+      if (horizontal && use_x_device) glyph_pos.x_advance += (base + get_device (values, &ret)).get_x_delta (font, store, store_cache);
       values++;
     }
     if (format & yAdvDevice) {
       /* y_advance values grow downward but font-space grows upward, hence negation */
-      if (!horizontal && use_y_device) glyph_pos.y_advance -= (base + get_device (values, &ret)).get_y_delta (font, store);
+      if (!horizontal && use_y_device) glyph_pos.y_advance -= (base + get_device (values, &ret)).get_y_delta (font, store, store_cache);
       values++;
     }
     return ret;
@@ -303,9 +304,9 @@ struct AnchorFormat3
     *y = font->em_fscale_y (yCoordinate);
 
     if (font->x_ppem || font->num_coords)
-      *x += (this+xDeviceTable).get_x_delta (font, c->var_store);
+      *x += (this+xDeviceTable).get_x_delta (font, c->var_store, c->var_store_cache);
     if (font->y_ppem || font->num_coords)
-      *y += (this+yDeviceTable).get_y_delta (font, c->var_store);
+      *y += (this+yDeviceTable).get_y_delta (font, c->var_store, c->var_store_cache);
   }
 
   bool sanitize (hb_sanitize_context_t *c) const
@@ -336,12 +337,42 @@ struct Anchor
 		   float *x, float *y) const
   {
     *x = *y = 0;
+    hb_font_t *font = c->font;
     switch (u.format) {
     case 1: u.format1.get_anchor (c, glyph_id, x, y); return;
-    case 2: u.format2.get_anchor (c, glyph_id, x, y); return;
-    case 3: u.format3.get_anchor (c, glyph_id, x, y); return;
+    case 2:
+      if (font->x_ppem || font->y_ppem) break;
+      u.format2.get_anchor (c, glyph_id, x, y);	      return;
+    case 3:
+      if (font->x_ppem || font->y_ppem || font->num_coords) break;
+      u.format3.get_anchor (c, glyph_id, x, y);	      return;
     default:					      return;
     }
+
+    /* Contour points and device tables are costly; the same attachments
+     * come up again and again, so remember them for the buffer. */
+    if (u.format == 3)
+      glyph_id = 0; /* Does not depend on the glyph. */
+    hb_anchor_cache_t::item_t *item = c->get_anchor_cache_item (this, glyph_id);
+    if (item && item->anchor == this && item->glyph == glyph_id)
+    {
+      *x = item->x;
+      *y = item->y;
+      return;
+    }
+
+    if (u.format == 2)
+      u.format2.get_anchor (c, glyph_id, x, y);
+    else
+      u.format3.get_anchor (c, glyph_id, x, y);
+
+    if (item)
+    {
+      item->anchor = this;
+      item->glyph = glyph_id;
+      item->x = *x;
+      item->y = *y;
+    }
   }
 
   bool sanitize (hb_sanitize_context_t *c) const
@@ -606,6 +637,7 @@ struct SinglePos
 struct PairValueRecord
 {
   friend struct PairSet;
+  friend struct PairPosFormat1;
 
   protected:
   GlyphID	secondGlyph;		/* GlyphID of second glyph in the
@@ -657,9 +689,7 @@ struct PairSet
   {
     TRACE_APPLY (this);
     hb_buffer_t *buffer = c->buffer;
-    unsigned int len1 = valueFormats[0].get_len ();
-    unsigned int len2 = valueFormats[1].get_len ();
-    unsigned int record_size = HBUINT16::static_size * (1 + len1 + len2);
+    unsigned int record_size = get_record_size (valueFormats);
 
     unsigned int count = len;
 
@@ -678,21 +708,38 @@ struct PairSet
       else if (x > mid_x)
 	min = mid + 1;
       else
-      {
-	/* Note the intentional use of "|" instead of short-circuit "||". */
-	if (valueFormats[0].apply_value (c, this, &record->values[0], buffer->cur_pos()) |
-	    valueFormats[1].apply_value (c, this, &record->values[len1], buffer->pos[pos]))
-	  buffer->unsafe_to_break (buffer->idx, pos + 1);
-	if (len2)
-	  pos++;
-	buffer->idx = pos;
-	return_trace (true);
-      }
+	return_trace (apply_record (c, valueFormats, record, pos));
     }
 
     return_trace (false);
   }
 
+  static unsigned int get_record_size (const ValueFormat *valueFormats)
+  { return HBUINT16::static_size * (1 + valueFormats[0].get_len () + valueFormats[1].get_len ()); }
+
+  const PairValueRecord &get_record (unsigned int i, unsigned int record_size) const
+  { return StructAtOffset<PairValueRecord> (&firstPairValueRecord, record_size * i); }
+
+  /* Applies the matched record to the current glyph and the one at pos. */
+  bool apply_record (hb_ot_apply_context_t *c,
+		     const ValueFormat *valueFormats,
+		     const PairValueRecord *record,
+		     unsigned int pos) const
+  {
+    hb_buffer_t *buffer = c->buffer;
+    unsigned int len1 = valueFormats[0].get_len ();
+    unsigned int len2 = valueFormats[1].get_len ();
+
+    /* Note the intentional use of "|" instead of short-circuit "||". */
+    if (valueFormats[0].apply_value (c, this, &record->values[0], buffer->cur_pos()) |
+	valueFormats[1].apply_value (c, this, &record->values[len1], buffer->pos[pos]))
+      buffer->unsafe_to_break (buffer->idx, pos + 1);
+    if (len2)
+      pos++;
+    buffer->idx = pos;
+    return true;
+  }
+
   struct sanitize_closure_t
   {
     const void *base;
@@ -756,16 +803,73 @@ struct PairPosFormat1
   {
     TRACE_APPLY (this);
     hb_buffer_t *buffer = c->buffer;
-    unsigned int index = (this+coverage).get_coverage  (buffer->cur().codepoint);
-    if (likely (index == NOT_COVERED)) return_trace (false);
+    const hb_map_t *flat_pairs = c->get_flat_pairs (this);
+    unsigned int index = 0;
+    if (!flat_pairs)
+    {
+      index = (this+coverage).get_coverage  (buffer->cur().codepoint);
+      if (likely (index == NOT_COVERED)) return_trace (false);
+    }
 
     hb_ot_apply_context_t::skipping_iterator_t &skippy_iter = c->iter_input;
     skippy_iter.reset (buffer->idx, 1);
     if (!skippy_iter.next ()) return_trace (false);
 
+    if (flat_pairs)
+    {
+      /* The accelerator has checked the coverage of the first glyph. */
+      hb_codepoint_t second = buffer->info[skippy_iter.idx].codepoint;
+      hb_codepoint_t value = second <= 0xFFFFu ?
+			     flat_pairs->get (buffer->cur().codepoint << 16 | second) :
+			     HB_MAP_VALUE_INVALID;
+      if (value == HB_MAP_VALUE_INVALID) return_trace (false);
+      const PairSet &set = this+pairSet[value >> 16];
+      const PairValueRecord &record = set.get_record (value & 0xFFFFu, PairSet::get_record_size (valueFormat));
+      return_trace (set.apply_record (c, valueFormat, &record, skippy_iter.idx));
+    }
+
     return_trace ((this+pairSet[index]).apply (c, valueFormat, skippy_iter.idx));
   }
 
+  /* Maps each (first << 16 | second) glyph pair to the position of its
+   * record, as (pair set index << 16 | record index).  Returns false if
+   * the subtable is not sorted the way apply() searches it, in which
+   * case the map can't stand in for that search. */
+  bool collect_pairs (hb_map_t *pairs) const
+  {
+    unsigned int count = pairSet.len;
+    unsigned int record_size = PairSet::get_record_size (valueFormat);
+    hb_codepoint_t last_first = 0;
+    bool first_pair = true;
+    for (Coverage::Iter iter (this+coverage); iter.more (); iter.next ())
+    {
+      hb_codepoint_t first = iter.get_glyph ();
+      if (!first_pair && first <= last_first)
+	return false;
+      first_pair = false;
+      last_first = first;
+
+      unsigned int index = iter.get_coverage ();
+      if (unlikely (index >= count))
+	continue;
+      const PairSet &set = this+pairSet[index];
+      unsigned int len = set.len;
+      if (unlikely (!pairs->alloc (len)))
+	return false;
+      for (unsigned int i = 0; i < len; i++)
+      {
+	hb_codepoint_t second = set.get_record (i, record_size).secondGlyph;
+	if (i && second <= set.get_record (i - 1, record_size).secondGlyph)
+	  return false;
+	hb_codepoint_t key = first << 16 | second;
+	if (unlikely (key == HB_MAP_VALUE_INVALID))
+	  return false;
+	pairs->set (key, index << 16 | i);
+      }
+    }
+    return !pairs->in_error ();
+  }
+
   bool subset (hb_subset_context_t *c) const
   {
     TRACE_SUBSET (this);
@@ -827,23 +931,64 @@ struct PairPosFormat2
 
   const Coverage &get_coverage () const { return this+coverage; }
 
+  unsigned int get_class_defs (const ClassDef **class_defs) const
+  {
+    class_defs[0] = &(this+classDef1);
+    class_defs[1] = &(this+classDef2);
+    return 2;
+  }
+
+  /* If the subtable only adjusts the x_advance of the first glyph,
+   * returns the number of class pairs, and if x_advances is not nullptr,
+   * writes their adjustments to it, class1-major.  Returns 0 otherwise. */
+  unsigned int get_x_advances (int16_t *x_advances) const
+  {
+    if (valueFormat1 != ValueFormat::xAdvance || valueFormat2 != 0)
+      return 0;
+    unsigned int count = (unsigned int) class1Count * (unsigned int) class2Count;
+    if (x_advances)
+      for (unsigned int i = 0; i < count; i++)
+	x_advances[i] = *CastP<HBINT16> (&values[i]);
+    return count;
+  }
+
   bool apply (hb_ot_apply_context_t *c) const
   {
     TRACE_APPLY (this);
     hb_buffer_t *buffer = c->buffer;
-    unsigned int index = (this+coverage).get_coverage  (buffer->cur().codepoint);
-    if (likely (index == NOT_COVERED)) return_trace (false);
+    const int16_t *x_advances = c->get_flat_x_advances (this);
+    /* With x_advances, the accelerator has checked the coverage. */
+    if (!x_advances &&
+	likely ((this+coverage).get_coverage  (buffer->cur().codepoint) == NOT_COVERED))
+      return_trace (false);
 
     hb_ot_apply_context_t::skipping_iterator_t &skippy_iter = c->iter_input;
     skippy_iter.reset (buffer->idx, 1);
     if (!skippy_iter.next ()) return_trace (false);
 
+    if (x_advances)
+    {
+      unsigned int klass1 = c->get_class (this+classDef1, buffer->cur().codepoint);
+      unsigned int klass2 = c->get_class (this+classDef2, buffer->info[skippy_iter.idx].codepoint);
+      if (unlikely (klass1 >= class1Count || klass2 >= class2Count)) return_trace (false);
+
+      int x_advance = x_advances[klass1 * class2Count + klass2];
+      if (x_advance)
+      {
+	if (likely (HB_DIRECTION_IS_HORIZONTAL (c->direction)))
+	  buffer->cur_pos().x_advance += c->font->em_scale_x (x_advance);
+	buffer->unsafe_to_break (buffer->idx, skippy_iter.idx + 1);
+      }
+      buffer->idx = skippy_iter.idx;
+      return_trace (true);
+    }
+
     unsigned int len1 = valueFormat1.get_len ();
     unsigned int len2 = valueFormat2.get_len ();
     unsigned int record_len = len1 + len2;
 
-    unsigned int klass1 = (this+classDef1).get_class (buffer->cur().codepoint);
-    unsigned int klass2 = (this+classDef2).get_class (buffer->info[skippy_iter.idx].codepoint);
+    unsigned int klass1 = c->get_class (this+classDef1, buffer->cur().codepoint);
+    unsigned int klass2 = c->get_class (this+classDef2, buffer->info[skippy_iter.idx].codepoint);
     if (unlikely (klass1 >= class1Count || klass2 >= class2Count)) return_trace (false);
 
     const Value *v = &values[record_len * (klass1 * class2Count + klass2)];
@@ -1571,6 +1716,9 @@ struct PosLookup : Lookup
     return false;
   }
 
+  /* Positioning never changes the glyphs. */
+  bool is_inplace () const { return true; }
+
   bool apply (hb_ot_apply_context_t *c) const
   {
     TRACE_APPLY (this);
@@ -1716,11 +1864,9 @@ propagate_attachment_offsets (hb_glyph_position_t *pos,
 }
 
 void
-GPOS::position_start (hb_font_t *font HB_UNUSED, hb_buffer_t *buffer)
+GPOS::position_start (hb_font_t *font HB_UNUSED, hb_buffer_t *buffer HB_UNUSED)
 {
-  unsigned int count = buffer->len;
-  for (unsigned int i = 0; i < count; i++)
-    buffer->pos[i].attach_chain() = buffer->pos[i].attach_type() = 0;
+  /* hb_buffer_t::clear_positions() zeroed attach_chain() and attach_type(). */
 }
 
 void
@@ -1753,18 +1899,31 @@ struct GPOS_accelerator_t : GPOS::accelerator_t {};
 template <typename context_t>
 /*static*/ inline typename context_t::return_t PosLookup::dispatch_recurse_func (context_t *c, unsigned int lookup_index)
 {
-  const PosLookup &l = c->face->table.GPOS.get_relaxed ()->table->get_lookup (lookup_index);
+  const PosLookup &l = c->face->table.GPOS->table->get_lookup (lookup_index);
   return l.dispatch (c);
 }
 
 /*static*/ inline bool PosLookup::apply_recurse_func (hb_ot_apply_context_t *c, unsigned int lookup_index)
 {
-  const PosLookup &l = c->face->table.GPOS.get_relaxed ()->table->get_lookup (lookup_index);
+  const GPOS_accelerator_t &gpos = *c->face->table.GPOS;
   unsigned int saved_lookup_props = c->lookup_props;
   unsigned int saved_lookup_index = c->lookup_index;
   c->set_lookup_index (lookup_index);
-  c->set_lookup_props (l.get_props ());
-  bool ret = l.dispatch (c);
+  bool ret;
+  /* Go through the lookup's accelerator, same as top-level lookups do,
+   * so each subtable's digest and native tables are used. */
+  if (likely (lookup_index < gpos.lookup_count))
+  {
+    const hb_ot_layout_lookup_accelerator_t &accel = gpos.accels[lookup_index];
+    c->set_lookup_props (accel.get_props ());
+    ret = accel.apply (c);
+  }
+  else
+  {
+    const PosLookup &l = gpos.table->get_lookup (lookup_index);
+    c->set_lookup_props (l.get_props ());
+    ret = l.dispatch (c);
+  }
   c->set_lookup_index (saved_lookup_index);
   c->set_lookup_props (saved_lookup_props);
   return ret;
@@ -93,13 +93,17 @@ struct SingleSubstFormat1
     return_trace (true);
   }
 
+  /* What apply() replaces @glyph, at @index in the coverage, with. */
+  hb_codepoint_t get_substitute (unsigned int index HB_UNUSED, hb_codepoint_t glyph) const
+  { return (glyph + deltaGlyphID) & 0xFFFFu; }
+
   bool serialize (hb_serialize_context_t *c,
 		  hb_array_t<const GlyphID> glyphs,
 		  int delta)
   {
     TRACE_SERIALIZE (this);
     if (unlikely (!c->extend_min (*this))) return_trace (false);
-    if (unlikely (!coverage.serialize (c, this).serialize (c, glyphs))) return_trace (false);
+    if (unlikely (!coverage.serialize_serialize (c, glyphs, this))) return_trace (false);
     deltaGlyphID.set (delta); /* TODO(serialize) overflow? */
     return_trace (true);
   }
@@ -115,12 +119,18 @@ struct SingleSubstFormat1
     for (Coverage::Iter iter (this+coverage); iter.more (); iter.next ())
     {
       if (!glyphset.has (iter.get_glyph ())) continue;
+      /* The substitute may not be retained, if it is only reachable
+       * through feature variations. */
+      hb_codepoint_t substitute = glyph_map[(iter.get_glyph () + delta) & 0xFFFF];
+      if (substitute == HB_MAP_VALUE_INVALID) continue;
       from.push ()->set (glyph_map[iter.get_glyph ()]);
-      to.push ()->set (glyph_map[(iter.get_glyph () + delta) & 0xFFFF]);
+      to.push ()->set (substitute);
     }
     c->serializer->propagate_error (from, to);
+    /* Otherwise the Coverage would stay packed with nothing linking to it. */
+    if (!from.length) return_trace (false);
     SingleSubst_serialize (c->serializer, from, to);
-    return_trace (from.length);
+    return_trace (true);
   }
 
   bool sanitize (hb_sanitize_context_t *c) const
@@ -192,6 +202,11 @@ struct SingleSubstFormat2
     return_trace (true);
   }
 
+  /* What apply() replaces the glyph at @index in the coverage with, or
+   * HB_SET_VALUE_INVALID. */
+  hb_codepoint_t get_substitute (unsigned int index, hb_codepoint_t glyph HB_UNUSED) const
+  { return index < substitute.len ? (hb_codepoint_t) substitute[index] : HB_SET_VALUE_INVALID; }
+
   bool serialize (hb_serialize_context_t *c,
 		  hb_array_t<const GlyphID> glyphs,
 		  hb_array_t<const GlyphID> substitutes)
@@ -199,7 +214,7 @@ struct SingleSubstFormat2
     TRACE_SERIALIZE (this);
     if (unlikely (!c->extend_min (*this))) return_trace (false);
     if (unlikely (!substitute.serialize (c, substitutes))) return_trace (false);
-    if (unlikely (!coverage.serialize (c, this).serialize (c, glyphs))) return_trace (false);
+    if (unlikely (!coverage.serialize_serialize (c, glyphs, this))) return_trace (false);
     return_trace (true);
   }
 
@@ -213,12 +228,16 @@ struct SingleSubstFormat2
     for (Coverage::Iter iter (this+coverage); iter.more (); iter.next ())
     {
       if (!glyphset.has (iter.get_glyph ())) continue;
+      hb_codepoint_t new_substitute = glyph_map[substitute[iter.get_coverage ()]];
+      if (new_substitute == HB_MAP_VALUE_INVALID) continue;
       from.push ()->set (glyph_map[iter.get_glyph ()]);
-      to.push ()->set (glyph_map[substitute[iter.get_coverage ()]]);
+      to.push ()->set (new_substitute);
     }
     c->serializer->propagate_error (from, to);
+    /* Otherwise the Coverage would stay packed with nothing linking to it. */
+    if (!from.length) return_trace (false);
     SingleSubst_serialize (c->serializer, from, to);
-    return_trace (from.length);
+    return_trace (true);
   }
 
   bool sanitize (hb_sanitize_context_t *c) const
@@ -268,6 +287,22 @@ struct SingleSubst
     }
   }
 
+  /* What apply () would replace glyph with, or HB_SET_VALUE_INVALID if
+   * it would not apply. */
+  hb_codepoint_t get_substitute (hb_codepoint_t glyph) const
+  {
+    unsigned int index;
+    switch (u.format) {
+    case 1:
+      index = u.format1.get_coverage ().get_coverage (glyph);
+      return index == NOT_COVERED ? HB_SET_VALUE_INVALID : u.format1.get_substitute (index, glyph);
+    case 2:
+      index = u.format2.get_coverage ().get_coverage (glyph);
+      return index == NOT_COVERED ? HB_SET_VALUE_INVALID : u.format2.get_substitute (index, glyph);
+    default:return HB_SET_VALUE_INVALID;
+    }
+  }
+
   template <typename context_t>
   typename context_t::return_t dispatch (context_t *c) const
   {
@@ -423,7 +458,7 @@ struct MultipleSubstFormat1
 	return_trace (false);
       substitute_glyphs_list += substitute_len;
     }
-    return_trace (coverage.serialize (c, this).serialize (c, glyphs));
+    return_trace (coverage.serialize_serialize (c, glyphs, this));
   }
 
   bool subset (hb_subset_context_t *c) const
@@ -613,7 +648,7 @@ struct AlternateSubstFormat1
 	return_trace (false);
       alternate_glyphs_list += alternate_len;
     }
-    return_trace (coverage.serialize (c, this).serialize (c, glyphs));
+    return_trace (coverage.serialize_serialize (c, glyphs, this));
   }
 
   bool subset (hb_subset_context_t *c) const
@@ -768,6 +803,15 @@ struct Ligature
     return_trace (true);
   }
 
+  bool add_to_trie (hb_flat_trie_t *trie, unsigned int root, unsigned int value) const
+  {
+    unsigned int count = component.lenP1;
+    /* apply() never matches these. */
+    if (unlikely (!count || count > HB_MAX_CONTEXT_LENGTH))
+      return true;
+    return trie->add (root, component.arrayZ, count - 1, value);
+  }
+
   public:
   bool sanitize (hb_sanitize_context_t *c) const
   {
@@ -838,6 +882,38 @@ struct LigatureSet
     return_trace (false);
   }
 
+  /* Same as apply(), but only tries the ligatures whose components the
+   * trie finds after the current glyph. */
+  bool apply (hb_ot_apply_context_t *c, const hb_flat_trie_t &trie, unsigned int root) const
+  {
+    TRACE_APPLY (this);
+    unsigned int candidates[HB_MAX_CONTEXT_LENGTH];
+    unsigned int num_candidates = 0;
+    if (unlikely (!collect_candidates (c, trie, root, c->buffer->idx,
+				       candidates, &num_candidates)))
+      return_trace (apply (c));
+
+    hb_stable_sort (candidates, num_candidates, cmp_candidate);
+    for (unsigned int i = 0; i < num_candidates; i++)
+    {
+      if (i && candidates[i] == candidates[i - 1])
+	continue;
+      const Ligature &lig = this+ligature[candidates[i]];
+      if (lig.apply (c)) return_trace (true);
+    }
+
+    return_trace (false);
+  }
+
+  bool add_to_trie (hb_flat_trie_t *trie, unsigned int root) const
+  {
+    unsigned int num_ligs = ligature.len;
+    for (unsigned int i = 0; i < num_ligs; i++)
+      if (unlikely (!(this+ligature[i]).add_to_trie (trie, root, i)))
+	return false;
+    return true;
+  }
+
   bool serialize (hb_serialize_context_t *c,
 		  hb_array_t<const GlyphID> ligatures,
 		  hb_array_t<const unsigned int> component_count_list,
@@ -865,6 +941,48 @@ struct LigatureSet
     return_trace (ligature.sanitize (c, this));
   }
 
+  private:
+  /* Adds the values of the trie nodes below node that the glyphs after
+   * pos can reach.  Same as the skipping iterator, except that glyphs
+   * that may or may not be skipped are tried both ways, and masks are
+   * not checked; so this finds every ligature that could match, and
+   * maybe a few more.  Returns false if there are too many. */
+  static bool collect_candidates (hb_ot_apply_context_t *c,
+				  const hb_flat_trie_t &trie,
+				  unsigned int node,
+				  unsigned int pos,
+				  unsigned int *candidates,
+				  unsigned int *num_candidates)
+  {
+    unsigned int value = trie.get_value (node);
+    if (value != hb_flat_trie_t::NO_VALUE)
+    {
+      if (unlikely (*num_candidates == HB_MAX_CONTEXT_LENGTH))
+	return false;
+      candidates[(*num_candidates)++] = value;
+    }
+    if (!trie.has_children (node))
+      return true;
+
+    const hb_glyph_info_t *info = c->buffer->info;
+    unsigned int count = c->buffer->len;
+    for (unsigned int i = pos + 1; i < count; i++)
+    {
+      hb_ot_apply_context_t::matcher_t::may_skip_t skip = c->iter_input.may_skip (info[i]);
+      if (skip == hb_ot_apply_context_t::matcher_t::SKIP_YES)
+	continue;
+      unsigned int child = trie.get_child (node, info[i].codepoint);
+      if (child &&
+	  !collect_candidates (c, trie, child, i, candidates, num_candidates))
+	return false;
+      if (skip == hb_ot_apply_context_t::matcher_t::SKIP_NO)
+	break;
+    }
+    return true;
+  }
+  static int cmp_candidate (const unsigned int *a, const unsigned int *b)
+  { return *a < *b ? -1 : *a > *b ? 1 : 0; }
+
   protected:
   OffsetArrayOf<Ligature>
 		ligature;		/* Array LigatureSet tables
@@ -935,9 +1053,24 @@ struct LigatureSubstFormat1
     if (likely (index == NOT_COVERED)) return_trace (false);
 
     const LigatureSet &lig_set = this+ligatureSet[index];
+    const hb_flat_trie_t *trie = c->get_flat_trie (this);
+    if (trie && index < trie->get_num_roots ())
+      return_trace (lig_set.apply (c, *trie, index));
     return_trace (lig_set.apply (c));
   }
 
+  /* Adds each ligature's components to trie, under the coverage index of
+   * its first glyph, with the ligature's index in its LigatureSet. */
+  bool collect_ligatures (hb_flat_trie_t *trie) const
+  {
+    unsigned int count = ligatureSet.len;
+    trie->init (count);
+    for (unsigned int i = 0; i < count; i++)
+      if (unlikely (!(this+ligatureSet[i]).add_to_trie (trie, i)))
+	return false;
+    return !trie->in_error ();
+  }
+
   bool serialize (hb_serialize_context_t *c,
 		  hb_array_t<const GlyphID> first_glyphs,
 		  hb_array_t<const unsigned int> ligature_per_first_glyph_count_list,
@@ -959,7 +1092,7 @@ struct LigatureSubstFormat1
       ligatures_list += ligature_count;
       component_count_list += ligature_count;
     }
-    return_trace (coverage.serialize (c, this).serialize (c, first_glyphs));
+    return_trace (coverage.serialize_serialize (c, first_glyphs, this));
   }
 
   bool subset (hb_subset_context_t *c) const
@@ -1288,6 +1421,86 @@ struct SubstLookup : Lookup
     return lookup_type_is_reverse (type);
   }
 
+  /* Which glyphs of the set closure () looks at: those of the lookup's
+   * coverage for Single, Multiple and Alternate lookups, also the
+   * components for Ligature ones (that is, their collect_glyphs () input),
+   * and any for the others, which match context and class 0 too. */
+  enum closure_reads_t
+  {
+    CLOSURE_READS_COVERAGE,
+    CLOSURE_READS_INPUT,
+    CLOSURE_READS_ANY
+  };
+  closure_reads_t get_closure_reads () const
+  {
+    closure_reads_t reads = CLOSURE_READS_COVERAGE;
+    unsigned int count = get_subtable_count ();
+    for (unsigned int i = 0; i < count; i++)
+    {
+      unsigned int type = get_type ();
+      if (type == SubTable::Extension)
+	type = CastR<ExtensionSubst> (get_subtable (i)).get_type ();
+      switch (type) {
+      case SubTable::Single:
+      case SubTable::Multiple:
+      case SubTable::Alternate:	break;
+      case SubTable::Ligature:	reads = CLOSURE_READS_INPUT; break;
+      default:			return CLOSURE_READS_ANY;
+      }
+    }
+    return reads;
+  }
+
+  /* Whether every subtable replaces one glyph by one, so the lookup can
+   * be applied without an output buffer. */
+  bool is_inplace () const
+  {
+    unsigned int count = get_subtable_count ();
+    for (unsigned int i = 0; i < count; i++)
+    {
+      unsigned int type = get_type ();
+      if (type == SubTable::Extension)
+	type = CastR<ExtensionSubst> (get_subtable (i)).get_type ();
+      if (type != SubTable::Single && type != SubTable::Alternate)
+	return false;
+    }
+    return true;
+  }
+
+  /* Whether every subtable is a single substitution, so that in a row
+   * of such lookups each glyph can be mapped straight to its final
+   * substitute; see hb_ot_map_t::build_batches (). */
+  bool is_single () const
+  {
+    unsigned int count = get_subtable_count ();
+    for (unsigned int i = 0; i < count; i++)
+    {
+      unsigned int type = get_type ();
+      if (type == SubTable::Extension)
+	type = CastR<ExtensionSubst> (get_subtable (i)).get_type ();
+      if (type != SubTable::Single)
+	return false;
+    }
+    return true;
+  }
+
+  /* For lookups where is_single (): what apply () would replace glyph
+   * with, or HB_SET_VALUE_INVALID if it would not apply. */
+  hb_codepoint_t get_single_substitute (hb_codepoint_t glyph) const
+  {
+    unsigned int count = get_subtable_count ();
+    for (unsigned int i = 0; i < count; i++)
+    {
+      const SubTable *subtable = &get_subtable (i);
+      if (get_type () == SubTable::Extension)
+	subtable = &CastR<ExtensionSubst> (*subtable).get_subtable<SubTable> ();
+      hb_codepoint_t u = subtable->u.single.get_substitute (glyph);
+      if (u != HB_SET_VALUE_INVALID)
+	return u;
+    }
+    return HB_SET_VALUE_INVALID;
+  }
+
   bool apply (hb_ot_apply_context_t *c) const
   {
     TRACE_APPLY (this);
@@ -1454,7 +1667,68 @@ struct GSUB : GSUBGPOS
 };
 
 
-struct GSUB_accelerator_t : GSUB::accelerator_t {};
+/* Number of hb_ot_layout_lookups_substitute_closure() results
+ * remembered per face. */
+#ifndef HB_OT_LAYOUT_CLOSURE_CACHE_SIZE
+#define HB_OT_LAYOUT_CLOSURE_CACHE_SIZE 8
+#endif
+
+struct GSUB_accelerator_t : GSUB::accelerator_t
+{
+  void init (hb_face_t *face)
+  {
+    GSUB::accelerator_t::init (face);
+    closure_cache_lock.init ();
+    memset (closure_cache, 0, sizeof (closure_cache));
+    closure_cache_serial = 0;
+  }
+
+  void fini ()
+  {
+    for (unsigned int i = 0; i < ARRAY_LENGTH (closure_cache); i++)
+      closure_cache[i].fini ();
+    closure_cache_lock.fini ();
+    GSUB::accelerator_t::fini ();
+  }
+
+  /* Closure is monotonic and idempotent: if a previous closure over the
+   * same lookups started from a subset of glyphs and ended in a superset
+   * of it, that result is the closure of glyphs as well. */
+  HB_INTERNAL bool closure_from_cache (const hb_set_t *lookups,
+				       hb_set_t *glyphs) const;
+  HB_INTERNAL void closure_to_cache (const hb_set_t *lookups,
+				     const hb_set_t *input,
+				     const hb_set_t *output) const;
+
+  private:
+  struct closure_entry_t
+  {
+    void fini ()
+    {
+      hb_set_destroy (lookups);
+      hb_set_destroy (input);
+      hb_set_destroy (output);
+      lookups = input = output = nullptr;
+    }
+
+    bool matches (const hb_set_t *lookups_, const hb_set_t *glyphs) const
+    {
+      return output &&
+	     (lookups_ ? lookups && lookups->is_equal (lookups_) : !lookups) &&
+	     input->is_subset (glyphs) &&
+	     glyphs->is_subset (output);
+    }
+
+    hb_set_t *lookups; /* nullptr means all lookups. */
+    hb_set_t *input;
+    hb_set_t *output;
+    unsigned int last_used;
+  };
+
+  mutable hb_mutex_t closure_cache_lock;
+  mutable closure_entry_t closure_cache[HB_OT_LAYOUT_CLOSURE_CACHE_SIZE];
+  mutable unsigned int closure_cache_serial;
+};
 
 
 /* Out-of-class implementation for methods recursing */
@@ -1470,18 +1744,31 @@ struct GSUB_accelerator_t : GSUB::accelerator_t {};
 template <typename context_t>
 /*static*/ inline typename context_t::return_t SubstLookup::dispatch_recurse_func (context_t *c, unsigned int lookup_index)
 {
-  const SubstLookup &l = c->face->table.GSUB.get_relaxed ()->table->get_lookup (lookup_index);
+  const SubstLookup &l = c->face->table.GSUB->table->get_lookup (lookup_index);
   return l.dispatch (c);
 }
 
 /*static*/ inline bool SubstLookup::apply_recurse_func (hb_ot_apply_context_t *c, unsigned int lookup_index)
 {
-  const SubstLookup &l = c->face->table.GSUB.get_relaxed ()->table->get_lookup (lookup_index);
+  const GSUB_accelerator_t &gsub = *c->face->table.GSUB;
   unsigned int saved_lookup_props = c->lookup_props;
   unsigned int saved_lookup_index = c->lookup_index;
   c->set_lookup_index (lookup_index);
-  c->set_lookup_props (l.get_props ());
-  bool ret = l.dispatch (c);
+  bool ret;
+  /* Go through the lookup's accelerator, same as top-level lookups do,
+   * so each subtable's digest and native tables are used. */
+  if (likely (lookup_index < gsub.lookup_count))
+  {
+    const hb_ot_layout_lookup_accelerator_t &accel = gsub.accels[lookup_index];
+    c->set_lookup_props (accel.get_props ());
+    ret = accel.apply (c);
+  }
+  else
+  {
+    const SubstLookup &l = gsub.table->get_lookup (lookup_index);
+    c->set_lookup_props (l.get_props ());
+    ret = l.dispatch (c);
+  }
   c->set_lookup_index (saved_lookup_index);
   c->set_lookup_props (saved_lookup_props);
   return ret;
@@ -58,6 +58,28 @@ struct hb_intersects_context_t :
 			     debug_depth (0) {}
 };
 
+/* Flushes of more glyphs than this do not list which were new; lookups
+ * that may read any rerun after them without checking. */
+#ifndef HB_CLOSURE_MAX_LISTED_BLOCK
+#define HB_CLOSURE_MAX_LISTED_BLOCK 32
+#endif
+
+/* What hb_closure_context_t::flush () added, in blocks of one flush each. */
+struct hb_closure_added_t
+{
+  struct block_t
+  {
+    bool listed;
+    unsigned int start, end;	/* Into glyphs, if listed. */
+  };
+
+  bool in_error () const { return glyphs.in_error () || blocks.in_error (); }
+
+  bool list;	/* Whether to list glyphs at all. */
+  hb_vector_t<hb_codepoint_t> glyphs;
+  hb_vector_t<block_t> blocks;
+};
+
 struct hb_closure_context_t :
        hb_dispatch_context_t<hb_closure_context_t, hb_void_t, HB_DEBUG_CLOSURE>
 {
@@ -93,6 +115,7 @@ struct hb_closure_context_t :
   hb_face_t *face;
   hb_set_t *glyphs;
   hb_set_t out[1];
+  hb_closure_added_t *added; /* If set, flush () appends the new glyphs. */
   recurse_func_t recurse_func;
   unsigned int nesting_level_left;
   unsigned int debug_depth;
@@ -103,6 +126,7 @@ struct hb_closure_context_t :
 			unsigned int nesting_level_left_ = HB_MAX_NESTING_LEVEL) :
 			  face (face_),
 			  glyphs (glyphs_),
+			  added (nullptr),
 			  recurse_func (nullptr),
 			  nesting_level_left (nesting_level_left_),
 			  debug_depth (0),
@@ -114,7 +138,24 @@ struct hb_closure_context_t :
 
   void flush ()
   {
-    hb_set_union (glyphs, out);
+    if (added && !out->is_empty ())
+    {
+      hb_closure_added_t::block_t block;
+      block.listed = added->list && out->get_population () <= HB_CLOSURE_MAX_LISTED_BLOCK;
+      block.start = added->glyphs.length;
+      if (block.listed)
+	for (hb_codepoint_t g = HB_SET_VALUE_INVALID; out->next (&g);)
+	  if (!glyphs->has (g))
+	    added->glyphs.push (g);
+      block.end = added->glyphs.length;
+
+      unsigned int population = glyphs->get_population ();
+      hb_set_union (glyphs, out);
+      if (glyphs->get_population () != population)
+	added->blocks.push (block);
+    }
+    else
+      hb_set_union (glyphs, out);
     hb_set_clear (out);
   }
 
@@ -252,6 +293,169 @@ struct hb_add_coverage_context_t :
 };
 
 
+/* Flat copy of a format-2 ClassDef, for O(1) class lookups; built by the
+ * lookup accelerators when HB_OPTIONS=flat-layout-tables is set. */
+struct hb_flat_class_def_t
+{
+  void init () { class_def = nullptr; start = count = 0; classes = nullptr; }
+  void fini () { free (classes); init (); }
+
+  bool build (const ClassDef &class_def_, unsigned int *budget)
+  {
+    hb_set_t glyphs;
+    class_def_.add_coverage (&glyphs);
+    if (glyphs.is_empty ())
+      return false;
+
+    hb_codepoint_t first = glyphs.get_min (), last = glyphs.get_max ();
+    unsigned int size = (last - first + 1) * sizeof (classes[0]);
+    if (size > *budget)
+      return false;
+    classes = (uint16_t *) malloc (size);
+    if (unlikely (!classes))
+      return false;
+    *budget -= size;
+
+    class_def = &class_def_;
+    start = first;
+    count = last - first + 1;
+    for (unsigned int i = 0; i < count; i++)
+      classes[i] = class_def_.get_class (first + i);
+    return true;
+  }
+
+  unsigned int get_class (hb_codepoint_t glyph) const
+  {
+    glyph -= start;
+    return glyph < count ? classes[glyph] : 0;
+  }
+
+  unsigned int get_memory_usage () const
+  { return classes ? count * sizeof (classes[0]) : 0; }
+
+  const ClassDef *class_def;
+  hb_codepoint_t start;
+  unsigned int count;
+  uint16_t *classes;
+};
+
+/* Native trie over glyph sequences, with one root per coverage index;
+ * built for LigatureSubst by the lookup accelerators when
+ * HB_OPTIONS=flat-layout-tables is set.  Each node holds the lowest value
+ * added for the sequence that ends there. */
+struct hb_flat_trie_t
+{
+  enum { NO_VALUE = 0xFFFFu };
+
+  struct node_t
+  {
+    uint16_t glyph; /* On the edge into this node. */
+    uint16_t value; /* NO_VALUE if no sequence ends here. */
+    uint32_t first_child; /* 0 if none; siblings are sorted by glyph. */
+    uint32_t next_sibling; /* 0 if none. */
+  };
+
+  void init (unsigned int num_roots_)
+  {
+    nodes.init ();
+    num_roots = num_roots_;
+    /* Node 0 is a root, so 0 can mean no child. */
+    if (unlikely (!nodes.resize (MAX (num_roots, 1u))))
+      return;
+    for (unsigned int i = 0; i < nodes.length; i++)
+    {
+      nodes[i].glyph = 0;
+      nodes[i].value = NO_VALUE;
+      nodes[i].first_child = nodes[i].next_sibling = 0;
+    }
+  }
+  void fini () { nodes.fini (); }
+
+  bool in_error () const { return nodes.in_error (); }
+
+  bool add (unsigned int root, const HBUINT16 *glyphs, unsigned int len, unsigned int value)
+  {
+    if (unlikely (in_error () || root >= num_roots || value >= NO_VALUE))
+      return false;
+
+    unsigned int node = root;
+    for (unsigned int i = 0; i < len; i++)
+    {
+      hb_codepoint_t g = glyphs[i];
+      unsigned int prev = 0, cur = nodes[node].first_child;
+      while (cur && nodes[cur].glyph < g)
+      {
+	prev = cur;
+	cur = nodes[cur].next_sibling;
+      }
+      if (!cur || nodes[cur].glyph != g)
+      {
+	unsigned int n = nodes.length;
+	node_t *child = nodes.push ();
+	if (unlikely (nodes.in_error ()))
+	  return false;
+	child->glyph = g;
+	child->value = NO_VALUE;
+	child->first_child = 0;
+	child->next_sibling = cur;
+	if (prev)
+	  nodes[prev].next_sibling = n;
+	else
+	  nodes[node].first_child = n;
+	cur = n;
+      }
+      node = cur;
+    }
+    if (nodes[node].value == NO_VALUE)
+      nodes[node].value = value;
+    return true;
+  }
+
+  unsigned int get_num_roots () const { return num_roots; }
+  unsigned int get_value (unsigned int node) const { return nodes[node].value; }
+  bool has_children (unsigned int node) const { return nodes[node].first_child; }
+
+  /* Returns the child of node along glyph, or 0 if none. */
+  unsigned int get_child (unsigned int node, hb_codepoint_t glyph) const
+  {
+    for (unsigned int cur = nodes[node].first_child; cur; cur = nodes[cur].next_sibling)
+      if (nodes[cur].glyph >= glyph)
+	return nodes[cur].glyph == glyph ? cur : 0;
+    return 0;
+  }
+
+  unsigned int get_memory_usage () const
+  { return nodes.get_allocated_size (); }
+
+  private:
+  hb_vector_t<node_t> nodes;
+  unsigned int num_roots;
+};
+
+#ifndef HB_OT_LAYOUT_ANCHOR_CACHE_BITS
+#define HB_OT_LAYOUT_ANCHOR_CACHE_BITS 8
+#endif
+
+/* Direct-mapped memo of anchors resolved against the font, for the ones
+ * that take contour points or device tables; see OT::Anchor. */
+struct hb_anchor_cache_t
+{
+  struct item_t
+  {
+    const void *anchor; /* nullptr if unused. */
+    hb_codepoint_t glyph;
+    float x, y;
+  };
+
+  item_t *get_item (const void *anchor, hb_codepoint_t glyph)
+  {
+    unsigned int h = (unsigned int) (((uintptr_t) anchor >> 1) + glyph * 31u);
+    return &items[h & ((1u << HB_OT_LAYOUT_ANCHOR_CACHE_BITS) - 1)];
+  }
+
+  item_t items[1u << HB_OT_LAYOUT_ANCHOR_CACHE_BITS];
+};
+
 struct hb_ot_apply_context_t :
        hb_dispatch_context_t<hb_ot_apply_context_t, bool, HB_DEBUG_APPLY>
 {
@@ -305,9 +509,10 @@ struct hb_ot_apply_context_t :
     };
 
     may_skip_t may_skip (const hb_ot_apply_context_t *c,
-			 const hb_glyph_info_t       &info) const
+			 const hb_glyph_info_t       &info,
+			 unsigned int                 i = (unsigned int) -1) const
     {
-      if (!c->check_glyph_property (&info, lookup_props))
+      if (!c->check_glyph_property (&info, lookup_props, i))
 	return SKIP_YES;
 
       if (unlikely (_hb_glyph_info_is_default_ignorable_and_not_hidden (&info) &&
@@ -377,7 +582,7 @@ struct hb_ot_apply_context_t :
 	idx++;
 	const hb_glyph_info_t &info = c->buffer->info[idx];
 
-	matcher_t::may_skip_t skip = matcher.may_skip (c, info);
+	matcher_t::may_skip_t skip = matcher.may_skip (c, info, idx);
 	if (unlikely (skip == matcher_t::SKIP_YES))
 	  continue;
 
@@ -404,7 +609,7 @@ struct hb_ot_apply_context_t :
 	idx--;
 	const hb_glyph_info_t &info = c->buffer->out_info[idx];
 
-	matcher_t::may_skip_t skip = matcher.may_skip (c, info);
+	matcher_t::may_skip_t skip = matcher.may_skip (c, info, idx);
 	if (unlikely (skip == matcher_t::SKIP_YES))
 	  continue;
 
@@ -457,9 +662,22 @@ struct hb_ot_apply_context_t :
   hb_font_t *font;
   hb_face_t *face;
   hb_buffer_t *buffer;
+  hb_set_digest_t digest; /* Of the glyphs in buffer, or more. */
   recurse_func_t recurse_func;
   const GDEF &gdef;
+  const GDEF_accelerator_t &gdef_accel;
   const VariationStore &var_store;
+  VariationStore::cache_t *var_store_cache;
+  hb_anchor_cache_t *anchor_cache; /* Allocated on first use. */
+  /* Flat ClassDefs of the subtable being applied, if any. */
+  const hb_flat_class_def_t *flat_class_defs;
+  unsigned int num_flat_class_defs;
+  /* Native tables of the subtable being applied, if any, and their owner. */
+  const void *flat_obj;
+  const hb_map_t *flat_pairs;
+  const int16_t *flat_x_advances;
+  const hb_flat_trie_t *flat_trie;
+  const hb_set_digest_t *coverage_digests;
 
   hb_direction_t direction;
   hb_mask_t lookup_mask;
@@ -476,15 +694,30 @@ struct hb_ot_apply_context_t :
 
   uint32_t random_state;
 
+  /* See init_property_cache().  0 means unknown, 1 false and 2 true. */
+  mutable hb_vector_t<uint8_t> property_cache;
+  unsigned int property_cache_props;
+
 
   hb_ot_apply_context_t (unsigned int table_index_,
 		      hb_font_t *font_,
 		      hb_buffer_t *buffer_) :
 			iter_input (), iter_context (),
 			font (font_), face (font->face), buffer (buffer_),
+			digest (buffer_->digest ()),
 			recurse_func (nullptr),
 			gdef (*face->table.GDEF->table),
+			gdef_accel (*face->table.GDEF),
 			var_store (gdef.get_var_store ()),
+			var_store_cache (table_index_ == 1 ? font->get_var_store_cache (hb_font_instance_t::GDEF, var_store) : nullptr),
+			anchor_cache (nullptr),
+			flat_class_defs (nullptr),
+			num_flat_class_defs (0),
+			flat_obj (nullptr),
+			flat_pairs (nullptr),
+			flat_x_advances (nullptr),
+			flat_trie (nullptr),
+			coverage_digests (nullptr),
 			direction (buffer_->props.direction),
 			lookup_mask (1),
 			table_index (table_index_),
@@ -496,7 +729,25 @@ struct hb_ot_apply_context_t :
 			auto_zwnj (true),
 			auto_zwj (true),
 			random (false),
-			random_state (1) { init_iters (); }
+			random_state (1),
+			property_cache_props (0) { init_iters (); }
+
+  ~hb_ot_apply_context_t ()
+  {
+    free (anchor_cache);
+  }
+
+  /* Returns the anchor cache slot of anchor on glyph, which may be holding
+   * another anchor; nullptr if out of memory. */
+  hb_anchor_cache_t::item_t *get_anchor_cache_item (const void *anchor, hb_codepoint_t glyph)
+  {
+    if (unlikely (!anchor_cache))
+    {
+      anchor_cache = (hb_anchor_cache_t *) calloc (1, sizeof (hb_anchor_cache_t));
+      if (unlikely (!anchor_cache)) return nullptr;
+    }
+    return anchor_cache->get_item (anchor, glyph);
+  }
 
   void init_iters ()
   {
@@ -512,6 +763,23 @@ struct hb_ot_apply_context_t :
   void set_lookup_index (unsigned int lookup_index_) { lookup_index = lookup_index_; }
   void set_lookup_props (unsigned int lookup_props_) { lookup_props = lookup_props_; init_iters (); }
 
+  unsigned int get_class (const ClassDef &class_def, hb_codepoint_t glyph) const
+  {
+    for (unsigned int i = 0; i < num_flat_class_defs; i++)
+      if (flat_class_defs[i].class_def == &class_def)
+	return flat_class_defs[i].get_class (glyph);
+    return class_def.get_class (glyph);
+  }
+
+  const hb_map_t *get_flat_pairs (const void *obj) const
+  { return flat_obj == obj ? flat_pairs : nullptr; }
+  const int16_t *get_flat_x_advances (const void *obj) const
+  { return flat_obj == obj ? flat_x_advances : nullptr; }
+  const hb_flat_trie_t *get_flat_trie (const void *obj) const
+  { return flat_obj == obj ? flat_trie : nullptr; }
+  const hb_set_digest_t *get_coverage_digests (const void *obj) const
+  { return flat_obj == obj ? coverage_digests : nullptr; }
+
   uint32_t random_number ()
   {
     /* http://www.cplusplus.com/reference/random/minstd_rand/ */
@@ -557,11 +825,50 @@ struct hb_ot_apply_context_t :
     return true;
   }
 
+  /* Same, for the glyph at position i of the buffer, which may come from
+   * the property cache. */
+  bool check_glyph_property (const hb_glyph_info_t *info,
+			     unsigned int  match_props,
+			     unsigned int  i) const
+  {
+    if (i < property_cache.length && match_props == property_cache_props)
+    {
+      uint8_t &v = property_cache[i];
+      if (unlikely (!v))
+	v = 1 + check_glyph_property (info, match_props);
+      return v - 1;
+    }
+    return check_glyph_property (info, match_props);
+  }
+
+  /* GPOS doesn't change glyphs or their props, so there the results of
+   * check_glyph_property() can be kept per buffer position, across the
+   * lookups that have the same lookup props.  Only worth it with mark
+   * filtering sets, whose Coverage tables are searched for every mark.
+   * Call before applying each lookup of GPOS. */
+  void init_property_cache ()
+  {
+    if (!(lookup_props & LookupFlag::UseMarkFilteringSet))
+      return;
+    if (lookup_props == property_cache_props &&
+	property_cache.length == buffer->len)
+      return;
+    if (unlikely (!property_cache.resize (buffer->len)))
+    {
+      property_cache.resize (0);
+      return;
+    }
+    memset (property_cache.arrayZ (), 0, property_cache.length);
+    property_cache_props = lookup_props;
+  }
+  void reset_property_cache () { property_cache.resize (0); }
+
   void _set_glyph_props (hb_codepoint_t glyph_index,
 			  unsigned int class_guess = 0,
 			  bool ligature = false,
-			  bool component = false) const
+			  bool component = false)
   {
+    digest.add (glyph_index);
     unsigned int add_in = _hb_glyph_info_get_glyph_props (&buffer->cur()) &
 			  HB_OT_LAYOUT_GLYPH_PROPS_PRESERVE;
     add_in |= HB_OT_LAYOUT_GLYPH_PROPS_SUBSTITUTED;
@@ -579,29 +886,36 @@ struct hb_ot_apply_context_t :
     if (component)
       add_in |= HB_OT_LAYOUT_GLYPH_PROPS_MULTIPLIED;
     if (likely (has_glyph_classes))
-      _hb_glyph_info_set_glyph_props (&buffer->cur(), add_in | gdef.get_glyph_props (glyph_index));
+      _hb_glyph_info_set_glyph_props (&buffer->cur(), add_in | gdef_accel.get_glyph_props (glyph_index));
     else if (class_guess)
       _hb_glyph_info_set_glyph_props (&buffer->cur(), add_in | class_guess);
   }
 
-  void replace_glyph (hb_codepoint_t glyph_index) const
+  void replace_glyph (hb_codepoint_t glyph_index)
   {
     _set_glyph_props (glyph_index);
+    if (!buffer->have_output)
+    {
+      /* One-to-one lookups run in place; see apply_string(). */
+      buffer->cur().codepoint = glyph_index;
+      buffer->skip_glyph ();
+      return;
+    }
     buffer->replace_glyph (glyph_index);
   }
-  void replace_glyph_inplace (hb_codepoint_t glyph_index) const
+  void replace_glyph_inplace (hb_codepoint_t glyph_index)
   {
     _set_glyph_props (glyph_index);
     buffer->cur().codepoint = glyph_index;
   }
   void replace_glyph_with_ligature (hb_codepoint_t glyph_index,
-					   unsigned int class_guess) const
+					   unsigned int class_guess)
   {
     _set_glyph_props (glyph_index, class_guess, true);
     buffer->replace_glyph (glyph_index);
   }
   void output_glyph_for_component (hb_codepoint_t glyph_index,
-					  unsigned int class_guess) const
+					  unsigned int class_guess)
   {
     _set_glyph_props (glyph_index, class_guess, false, true);
     buffer->output_glyph (glyph_index);
@@ -624,23 +938,330 @@ struct hb_get_subtables_context_t :
   struct hb_applicable_t
   {
     template <typename T>
-    void init (const T &obj_, hb_apply_func_t apply_func_)
+    void init (const T &obj_, hb_apply_func_t apply_func_, unsigned int *flat_budget,
+	       const hb_set_digest_t *digest_ = nullptr)
     {
       obj = &obj_;
+      coverage = &obj_.get_coverage ();
       apply_func = apply_func_;
-      digest.init ();
-      obj_.get_coverage ().add_coverage (&digest);
+      if (digest_)
+	digest = *digest_;
+      else
+      {
+	digest.init ();
+	obj_.get_coverage ().add_coverage (&digest);
+      }
+#if HB_DEBUG_DIGEST
+      digest_rejected.set_relaxed (0);
+      digest_covered.set_relaxed (0);
+      digest_false_positive.set_relaxed (0);
+#endif
+
+      coverage_start = coverage_count = 0;
+      coverage_bits = nullptr;
+      substitutes = nullptr;
+      pairs = nullptr;
+      x_advances = nullptr;
+      trie = nullptr;
+      coverage_digests = nullptr;
+      _build_coverage_digests (obj_, 0);
+      num_flat_class_defs = 0;
+      for (unsigned int i = 0; i < ARRAY_LENGTH (flat_class_defs); i++)
+	flat_class_defs[i].init ();
+      if (flat_budget)
+      {
+	build_flat_coverage (flat_budget);
+	if (coverage_bits)
+	{
+	  _build_substitutes (obj_, flat_budget, 0);
+	  _build_pairs (obj_, flat_budget, 0);
+	  _build_x_advances (obj_, flat_budget, 0);
+	  _build_trie (obj_, flat_budget, 0);
+	}
+
+	const ClassDef *class_defs[ARRAY_LENGTH (flat_class_defs)];
+	unsigned int count = _get_class_defs (obj_, class_defs, 0);
+	for (unsigned int i = 0; i < count; i++)
+	  if (!class_defs[i]->is_flat () &&
+	      flat_class_defs[num_flat_class_defs].build (*class_defs[i], flat_budget))
+	    num_flat_class_defs++;
+      }
+    }
+    void fini ()
+    {
+      free (coverage_bits);
+      free (substitutes);
+      hb_map_destroy (pairs);
+      free (x_advances);
+      if (trie)
+      {
+	trie->fini ();
+	free (trie);
+      }
+      free (coverage_digests);
+      for (unsigned int i = 0; i < ARRAY_LENGTH (flat_class_defs); i++)
+	flat_class_defs[i].fini ();
+    }
+
+    bool may_have (hb_codepoint_t g) const
+    {
+      if (coverage_bits)
+      {
+	g -= coverage_start;
+	return g < coverage_count && (coverage_bits[g >> 3] & (1u << (g & 7)));
+      }
+#if HB_DEBUG_DIGEST
+      if (!digest.may_have (g))
+      {
+	digest_rejected.inc ();
+	return false;
+      }
+      if (coverage->get_coverage (g) == NOT_COVERED)
+	digest_false_positive.inc ();
+      else
+	digest_covered.inc ();
+      return true;
+#else
+      return digest.may_have (g);
+#endif
     }
 
     bool apply (OT::hb_ot_apply_context_t *c) const
     {
-      return digest.may_have (c->buffer->cur().codepoint) && apply_func (obj, c);
+      if (!may_have (c->buffer->cur().codepoint))
+	return false;
+      if (substitutes)
+      {
+	c->replace_glyph (substitutes[c->buffer->cur().codepoint - coverage_start]);
+	return true;
+      }
+      if (pairs || x_advances || trie || coverage_digests)
+      {
+	c->flat_obj = obj;
+	c->flat_pairs = pairs;
+	c->flat_x_advances = x_advances;
+	c->flat_trie = trie;
+	c->coverage_digests = coverage_digests;
+      }
+      if (likely (!num_flat_class_defs))
+	return apply_func (obj, c);
+
+      const hb_flat_class_def_t *saved_flat_class_defs = c->flat_class_defs;
+      unsigned int saved_num_flat_class_defs = c->num_flat_class_defs;
+      c->flat_class_defs = flat_class_defs;
+      c->num_flat_class_defs = num_flat_class_defs;
+      bool ret = apply_func (obj, c);
+      c->flat_class_defs = saved_flat_class_defs;
+      c->num_flat_class_defs = saved_num_flat_class_defs;
+      return ret;
     }
 
+    const Coverage &get_coverage () const { return *coverage; }
+    const hb_set_digest_t &get_digest () const { return digest; }
+
+    /* Heap bytes held by the flat tables. */
+    unsigned int get_memory_usage () const
+    {
+      unsigned int size = coverage_bits ? ((coverage_count - 1) >> 3) + 1 : 0;
+      if (substitutes)
+	size += coverage_count * sizeof (substitutes[0]);
+      if (pairs)
+	size += pairs->get_memory_usage ();
+      if (x_advances)
+	size += num_x_advances * sizeof (x_advances[0]);
+      if (trie)
+	size += trie->get_memory_usage ();
+      if (coverage_digests)
+	size += num_coverage_digests * sizeof (coverage_digests[0]);
+      for (unsigned int i = 0; i < num_flat_class_defs; i++)
+	size += flat_class_defs[i].get_memory_usage ();
+      return size;
+    }
+
+#if HB_DEBUG_DIGEST
+    void report_digest_stats (unsigned int subtable_index) const
+    {
+      DEBUG_MSG (DIGEST, obj,
+		 "subtable %u: %d rejected by digest; %d passed, of which %d not covered",
+		 subtable_index,
+		 digest_rejected.get_relaxed (),
+		 digest_covered.get_relaxed () + digest_false_positive.get_relaxed (),
+		 digest_false_positive.get_relaxed ());
+    }
+#endif
+
     private:
+    /* Subtables that look up the class of the current glyph pair, or of
+     * the first input glyph, expose those ClassDefs through
+     * get_class_defs(); pick that up if present. */
+    template <typename T>
+    static auto _get_class_defs (const T &obj_, const ClassDef **class_defs, int) -> decltype (obj_.get_class_defs (class_defs))
+    { return obj_.get_class_defs (class_defs); }
+    template <typename T>
+    static unsigned int _get_class_defs (const T &obj_ HB_UNUSED, const ClassDef **class_defs HB_UNUSED, long)
+    { return 0; }
+
+    /* Single substitutions expose get_substitute(); for those, a native
+     * array over the flat coverage range replaces apply() altogether. */
+    template <typename T>
+    auto _build_substitutes (const T &obj_, unsigned int *budget, int) -> decltype (obj_.get_substitute (0, 0), void ())
+    {
+      unsigned int size = coverage_count * sizeof (substitutes[0]);
+      if (size > *budget)
+	return;
+      substitutes = (uint16_t *) calloc (coverage_count, sizeof (substitutes[0]));
+      if (unlikely (!substitutes))
+	return;
+      *budget -= size;
+
+      for (Coverage::Iter iter (*coverage); iter.more (); iter.next ())
+      {
+	hb_codepoint_t g = iter.get_glyph ();
+	hb_codepoint_t u = obj_.get_substitute (iter.get_coverage (), g);
+	g -= coverage_start;
+	if (u == HB_SET_VALUE_INVALID)
+	  coverage_bits[g >> 3] &= ~(1u << (g & 7));
+	else
+	  substitutes[g] = u;
+      }
+    }
+    template <typename T>
+    void _build_substitutes (const T &obj_ HB_UNUSED, unsigned int *budget HB_UNUSED, long) {}
+
+    /* Pair adjustments expose collect_pairs(); for those, a native hash
+     * of the glyph pairs replaces the big-endian record search. */
+    template <typename T>
+    auto _build_pairs (const T &obj_, unsigned int *budget, int) -> decltype (obj_.collect_pairs (nullptr), void ())
+    {
+      hb_map_t *map = hb_map_create ();
+      if (likely (!hb_object_is_inert (map)) && obj_.collect_pairs (map))
+      {
+	map->freeze ();
+	unsigned int size = map->get_memory_usage ();
+	if (likely (!map->in_error ()) && size <= *budget)
+	{
+	  *budget -= size;
+	  pairs = map;
+	  return;
+	}
+      }
+      hb_map_destroy (map);
+    }
+    template <typename T>
+    void _build_pairs (const T &obj_ HB_UNUSED, unsigned int *budget HB_UNUSED, long) {}
+
+    /* Class pair adjustments that only touch the first glyph's x_advance
+     * expose get_x_advances(); for those, a native copy of the matrix
+     * replaces decoding the value records. */
+    template <typename T>
+    auto _build_x_advances (const T &obj_, unsigned int *budget, int) -> decltype (obj_.get_x_advances (nullptr), void ())
+    {
+      unsigned int count = obj_.get_x_advances (nullptr);
+      unsigned int size = count * sizeof (x_advances[0]);
+      if (!count || size > *budget)
+	return;
+      x_advances = (int16_t *) malloc (size);
+      if (unlikely (!x_advances))
+	return;
+      *budget -= size;
+      num_x_advances = count;
+      obj_.get_x_advances (x_advances);
+    }
+    template <typename T>
+    void _build_x_advances (const T &obj_ HB_UNUSED, unsigned int *budget HB_UNUSED, long) {}
+
+    /* Ligature substitutions expose collect_ligatures(); for those, a
+     * trie over the components narrows down which ligatures to try. */
+    template <typename T>
+    auto _build_trie (const T &obj_, unsigned int *budget, int) -> decltype (obj_.collect_ligatures (nullptr), void ())
+    {
+      hb_flat_trie_t *t = (hb_flat_trie_t *) calloc (1, sizeof (hb_flat_trie_t));
+      if (unlikely (!t))
+	return;
+      if (obj_.collect_ligatures (t) && !t->in_error () &&
+	  t->get_memory_usage () <= *budget)
+      {
+	*budget -= t->get_memory_usage ();
+	trie = t;
+	return;
+      }
+      t->fini ();
+      free (t);
+    }
+    template <typename T>
+    void _build_trie (const T &obj_ HB_UNUSED, unsigned int *budget HB_UNUSED, long) {}
+
+    /* Coverage-based chain contexts expose get_coverage_digests(); for
+     * those, a digest per Coverage rejects most glyphs before searching
+     * the Coverage.  Cheap enough to always build. */
+    template <typename T>
+    auto _build_coverage_digests (const T &obj_, int) -> decltype (obj_.get_coverage_digests (nullptr), void ())
+    {
+      unsigned int count = obj_.get_coverage_digests (nullptr);
+      if (!count)
+	return;
+      coverage_digests = (hb_set_digest_t *) calloc (count, sizeof (coverage_digests[0]));
+      if (unlikely (!coverage_digests))
+	return;
+      num_coverage_digests = count;
+      obj_.get_coverage_digests (coverage_digests);
+    }
+    template <typename T>
+    void _build_coverage_digests (const T &obj_ HB_UNUSED, long) {}
+
+    /* An exact coverage bitmap replaces the digest test. */
+    void build_flat_coverage (unsigned int *budget)
+    {
+      hb_codepoint_t first = HB_SET_VALUE_INVALID, last = 0;
+      for (Coverage::Iter iter (*coverage); iter.more (); iter.next ())
+      {
+	hb_codepoint_t g = iter.get_glyph ();
+	first = MIN (first, g);
+	last = MAX (last, g);
+      }
+      if (first > last)
+	return;
+
+      unsigned int size = ((last - first) >> 3) + 1;
+      if (size > *budget)
+	return;
+      coverage_bits = (uint8_t *) calloc (size, 1);
+      if (unlikely (!coverage_bits))
+	return;
+      *budget -= size;
+
+      coverage_start = first;
+      coverage_count = last - first + 1;
+      for (Coverage::Iter iter (*coverage); iter.more (); iter.next ())
+      {
+	hb_codepoint_t g = iter.get_glyph () - first;
+	coverage_bits[g >> 3] |= 1u << (g & 7);
+      }
+    }
+
     const void *obj;
+    const Coverage *coverage;
     hb_apply_func_t apply_func;
     hb_set_digest_t digest;
+
+    hb_codepoint_t coverage_start;
+    unsigned int coverage_count;
+    uint8_t *coverage_bits;
+    uint16_t *substitutes; /* Over the coverage_bits range, if not nullptr. */
+    hb_map_t *pairs; /* See PairPosFormat1::collect_pairs(). */
+    int16_t *x_advances; /* See PairPosFormat2::get_x_advances(). */
+    unsigned int num_x_advances;
+    hb_flat_trie_t *trie; /* See LigatureSubstFormat1::collect_ligatures(). */
+    hb_set_digest_t *coverage_digests; /* See ChainContextFormat3::get_coverage_digests(). */
+    unsigned int num_coverage_digests;
+    unsigned int num_flat_class_defs;
+    hb_flat_class_def_t flat_class_defs[2];
+#if HB_DEBUG_DIGEST
+    /* Digest effectiveness statistics, reported when the face is destroyed. */
+    mutable hb_atomic_int_t digest_rejected;
+    mutable hb_atomic_int_t digest_covered;
+    mutable hb_atomic_int_t digest_false_positive;
+#endif
   };
 
   typedef hb_vector_t<hb_applicable_t> array_t;
@@ -650,17 +1271,27 @@ struct hb_get_subtables_context_t :
   template <typename T>
   return_t dispatch (const T &obj)
   {
+    unsigned int i = array.length;
     hb_applicable_t *entry = array.push();
-    entry->init (obj, apply_to<T>);
+    entry->init (obj, apply_to<T>, flat_budget, i < num_digests ? &digests[i] : nullptr);
     return HB_VOID;
   }
   static return_t default_return_value () { return HB_VOID; }
 
-  hb_get_subtables_context_t (array_t &array_) :
+  hb_get_subtables_context_t (array_t &array_,
+			      unsigned int *flat_budget_ = nullptr,
+			      const hb_set_digest_t *digests_ = nullptr,
+			      unsigned int num_digests_ = 0) :
 			      array (array_),
+			      flat_budget (flat_budget_),
+			      digests (digests_),
+			      num_digests (num_digests_),
 			      debug_depth (0) {}
 
   array_t &array;
+  unsigned int *flat_budget; /* Bytes left for flat tables; nullptr disables. */
+  const hb_set_digest_t *digests; /* Precomputed subtable digests, if any. */
+  unsigned int num_digests;
   unsigned int debug_depth;
 };
 
@@ -754,6 +1385,22 @@ static inline bool match_coverage (hb_codepoint_t glyph_id, const HBUINT16 &valu
   return (data+coverage).get_coverage (glyph_id) != NOT_COVERED;
 }
 
+/* Match data for match_coverage_digest(): the digests of the Coverages
+ * at offsets, in the same order. */
+struct CoverageDigestMatchData
+{
+  const void *base;
+  const HBUINT16 *offsets;
+  const hb_set_digest_t *digests;
+};
+static inline bool match_coverage_digest (hb_codepoint_t glyph_id, const HBUINT16 &value, const void *data)
+{
+  const CoverageDigestMatchData &match_data = *(const CoverageDigestMatchData *) data;
+  if (!match_data.digests[&value - match_data.offsets].may_have (glyph_id))
+    return false;
+  return match_coverage (glyph_id, value, match_data.base);
+}
+
 static inline bool would_match_input (hb_would_apply_context_t *c,
 				      unsigned int count, /* Including the first glyph (not matched) */
 				      const HBUINT16 input[], /* Array of input values--start with second glyph */
@@ -1618,6 +2265,12 @@ struct ContextFormat2
 
   const Coverage &get_coverage () const { return this+coverage; }
 
+  unsigned int get_class_defs (const ClassDef **class_defs) const
+  {
+    class_defs[0] = &(this+classDef);
+    return 1;
+  }
+
   bool apply (hb_ot_apply_context_t *c) const
   {
     TRACE_APPLY (this);
@@ -1625,7 +2278,7 @@ struct ContextFormat2
     if (likely (index == NOT_COVERED)) return_trace (false);
 
     const ClassDef &class_def = this+classDef;
-    index = class_def.get_class (c->buffer->cur().codepoint);
+    index = c->get_class (class_def, c->buffer->cur().codepoint);
     const RuleSet &rule_set = this+ruleSet[index];
     struct ContextApplyLookupContext lookup_context = {
       {match_class},
@@ -2297,6 +2950,12 @@ struct ChainContextFormat2
 
   const Coverage &get_coverage () const { return this+coverage; }
 
+  unsigned int get_class_defs (const ClassDef **class_defs) const
+  {
+    class_defs[0] = &(this+inputClassDef);
+    return 1;
+  }
+
   bool apply (hb_ot_apply_context_t *c) const
   {
     TRACE_APPLY (this);
@@ -2307,7 +2966,7 @@ struct ChainContextFormat2
     const ClassDef &input_class_def = this+inputClassDef;
     const ClassDef &lookahead_class_def = this+lookaheadClassDef;
 
-    index = input_class_def.get_class (c->buffer->cur().codepoint);
+    index = c->get_class (input_class_def, c->buffer->cur().codepoint);
     const ChainRuleSet &rule_set = this+ruleSet[index];
     struct ChainContextApplyLookupContext lookup_context = {
       {match_class},
@@ -2447,6 +3106,27 @@ struct ChainContextFormat3
     return this+input[0];
   }
 
+  /* Returns the number of Coverages, and if digests is not nullptr,
+   * writes the digest of each to it: backtrack, input, then lookahead. */
+  unsigned int get_coverage_digests (hb_set_digest_t *digests) const
+  {
+    const OffsetArrayOf<Coverage> &input = StructAfter<OffsetArrayOf<Coverage> > (backtrack);
+    const OffsetArrayOf<Coverage> &lookahead = StructAfter<OffsetArrayOf<Coverage> > (input);
+    unsigned int count = backtrack.len + input.len + lookahead.len;
+    if (!digests)
+      return count;
+
+    for (unsigned int i = 0; i < count; i++)
+      digests[i].init ();
+    for (unsigned int i = 0; i < backtrack.len; i++)
+      (this+backtrack[i]).add_coverage (digests++);
+    for (unsigned int i = 0; i < input.len; i++)
+      (this+input[i]).add_coverage (digests++);
+    for (unsigned int i = 0; i < lookahead.len; i++)
+      (this+lookahead[i]).add_coverage (digests++);
+    return count;
+  }
+
   bool apply (hb_ot_apply_context_t *c) const
   {
     TRACE_APPLY (this);
@@ -2457,6 +3137,26 @@ struct ChainContextFormat3
 
     const OffsetArrayOf<Coverage> &lookahead = StructAfter<OffsetArrayOf<Coverage> > (input);
     const ArrayOf<LookupRecord> &lookup = StructAfter<ArrayOf<LookupRecord> > (lookahead);
+
+    const hb_set_digest_t *digests = c->get_coverage_digests (this);
+    if (digests)
+    {
+      CoverageDigestMatchData match_data[3] = {
+	{this, (const HBUINT16 *) backtrack.arrayZ, digests},
+	{this, (const HBUINT16 *) input.arrayZ + 1, digests + backtrack.len + 1},
+	{this, (const HBUINT16 *) lookahead.arrayZ, digests + backtrack.len + input.len}
+      };
+      struct ChainContextApplyLookupContext lookup_context = {
+	{match_coverage_digest},
+	{&match_data[0], &match_data[1], &match_data[2]}
+      };
+      return_trace (chain_context_apply_lookup (c,
+						backtrack.len, (const HBUINT16 *) backtrack.arrayZ,
+						input.len, (const HBUINT16 *) input.arrayZ + 1,
+						lookahead.len, (const HBUINT16 *) lookahead.arrayZ,
+						lookup.len, lookup.arrayZ, lookup_context));
+    }
+
     struct ChainContextApplyLookupContext lookup_context = {
       {match_coverage},
       {this, this, this}
@@ -2617,36 +3317,339 @@ struct Extension
  * GSUB/GPOS Common
  */
 
+/* Lookups with at least this many subtables get a glyph-to-subtable
+ * index, if enabled with HB_OPTIONS=lookup-glyph-index. */
+#ifndef HB_OT_LAYOUT_LOOKUP_GLYPH_INDEX_MIN_SUBTABLES
+#define HB_OT_LAYOUT_LOOKUP_GLYPH_INDEX_MIN_SUBTABLES 8
+#endif
+
+/* Per-table memory bound for the flat Coverage / ClassDef copies made
+ * with HB_OPTIONS=flat-layout-tables. */
+#ifndef HB_OT_LAYOUT_FLAT_TABLES_MAX_BYTES
+#define HB_OT_LAYOUT_FLAT_TABLES_MAX_BYTES (1u << 20)
+#endif
+
+/* Per-table number of hb_ot_layout_collect_lookups() results kept. */
+#ifndef HB_OT_LAYOUT_MAX_LOOKUPS_QUERIES
+#define HB_OT_LAYOUT_MAX_LOOKUPS_QUERIES 16
+#endif
+
 struct hb_ot_layout_lookup_accelerator_t
 {
+  /* If given, digests holds the lookup's digest followed by those of its
+   * subtables, as written by get_digests (). */
   template <typename TLookup>
-  void init (const TLookup &lookup)
+  void init (const TLookup &lookup, unsigned int *flat_budget = nullptr,
+	     const hb_set_digest_t *digests = nullptr, unsigned int num_digests = 0)
   {
-    digest.init ();
-    lookup.add_coverage (&digest);
+    props = lookup.get_props ();
+    inplace = lookup.is_inplace ();
+    if (num_digests)
+      digest = digests[0];
+    else
+    {
+      digest.init ();
+      lookup.add_coverage (&digest);
+    }
 
     subtables.init ();
-    OT::hb_get_subtables_context_t c_get_subtables (subtables);
+    subtables.alloc (lookup.get_subtable_count (), true);
+    OT::hb_get_subtables_context_t c_get_subtables (subtables, flat_budget,
+						    digests + !!num_digests,
+						    num_digests ? num_digests - 1 : 0);
     lookup.dispatch (&c_get_subtables);
+
+    has_glyph_index = false;
+    glyph_index.init ();
+    glyph_subtables.init ();
+    if (subtables.length >= HB_OT_LAYOUT_LOOKUP_GLYPH_INDEX_MIN_SUBTABLES &&
+	hb_options ().lookup_glyph_index)
+      build_glyph_index ();
+  }
+  void fini ()
+  {
+#if HB_DEBUG_DIGEST
+    for (unsigned int i = 0; i < subtables.length; i++)
+      subtables[i].report_digest_stats (i);
+#endif
+    for (unsigned int i = 0; i < subtables.length; i++)
+      subtables[i].fini ();
+    subtables.fini ();
+    glyph_index.fini ();
+    glyph_subtables.fini ();
   }
-  void fini () { subtables.fini (); }
 
   bool may_have (hb_codepoint_t g) const
   { return digest.may_have (g); }
+  bool may_have (const hb_set_digest_t &glyphs) const
+  { return digest.may_have (glyphs); }
+
+  unsigned int get_memory_usage () const
+  {
+    unsigned int size = subtables.get_allocated_size () +
+			glyph_index.get_allocated_size () +
+			glyph_subtables.get_allocated_size ();
+    for (unsigned int i = 0; i < subtables.length; i++)
+      size += subtables[i].get_memory_usage ();
+    return size;
+  }
+
+  const hb_set_digest_t &get_digest () const { return digest; }
+  unsigned int get_props () const { return props; }
+  bool is_inplace () const { return inplace; }
+  unsigned int get_digest_count () const { return 1 + subtables.length; }
+  void get_digests (hb_set_digest_t *digests) const
+  {
+    digests[0] = digest;
+    for (unsigned int i = 0; i < subtables.length; i++)
+      digests[1 + i] = subtables[i].get_digest ();
+  }
 
   bool apply (hb_ot_apply_context_t *c) const
+  { return apply<false> (c, nullptr); }
+
+  /* If counting, adds the number of subtables tried to *attempts. */
+  template <bool counting>
+  bool apply (hb_ot_apply_context_t *c, uint64_t *attempts) const
   {
+    if (has_glyph_index)
+    {
+      const glyph_entry_t *entry = glyph_index.bsearch (c->buffer->cur().codepoint);
+      if (!entry)
+	return false;
+      for (unsigned int i = entry->start; i < entry->end; i++)
+      {
+	if (counting) (*attempts)++;
+	if (subtables[glyph_subtables[i]].apply (c))
+	  return true;
+      }
+      return false;
+    }
+
     for (unsigned int i = 0; i < subtables.length; i++)
+    {
+      if (counting) (*attempts)++;
       if (subtables[i].apply (c))
 	return true;
+    }
     return false;
   }
 
   private:
+  struct glyph_entry_t
+  {
+    int cmp (hb_codepoint_t g) const
+    { return g < glyph ? -1 : g > glyph ? 1 : 0; }
+
+    hb_codepoint_t glyph;
+    unsigned int start; /* Range into glyph_subtables. */
+    unsigned int end;
+  };
+
+  struct glyph_subtable_t
+  {
+    static int cmp (const void *pa, const void *pb)
+    {
+      const glyph_subtable_t *a = (const glyph_subtable_t *) pa;
+      const glyph_subtable_t *b = (const glyph_subtable_t *) pb;
+      if (a->glyph != b->glyph) return a->glyph < b->glyph ? -1 : 1;
+      if (a->subtable != b->subtable) return a->subtable < b->subtable ? -1 : 1;
+      return 0;
+    }
+
+    hb_codepoint_t glyph;
+    unsigned int subtable;
+  };
+
+  /* Maps each covered glyph to the subtables, in lookup order, whose
+   * coverage contains it.  Subtables only ever apply if the current glyph
+   * is in their coverage, so that's all apply() needs to try. */
+  void build_glyph_index ()
+  {
+    hb_vector_t<glyph_subtable_t> pairs;
+    for (unsigned int i = 0; i < subtables.length; i++)
+      for (Coverage::Iter iter (subtables[i].get_coverage ()); iter.more (); iter.next ())
+      {
+	glyph_subtable_t *pair = pairs.push ();
+	pair->glyph = iter.get_glyph ();
+	pair->subtable = i;
+      }
+    if (unlikely (pairs.in_error ()))
+      return;
+    pairs.qsort (glyph_subtable_t::cmp);
+
+    for (unsigned int i = 0; i < pairs.length; i++)
+    {
+      if (!i || pairs[i].glyph != pairs[i - 1].glyph)
+      {
+	glyph_entry_t *entry = glyph_index.push ();
+	entry->glyph = pairs[i].glyph;
+	entry->start = entry->end = glyph_subtables.length;
+      }
+      /* A Coverage may list a glyph twice; only try each subtable once. */
+      if (i && pairs[i].glyph == pairs[i - 1].glyph &&
+	  pairs[i].subtable == pairs[i - 1].subtable)
+	continue;
+      glyph_subtables.push (pairs[i].subtable);
+      glyph_index[glyph_index.length - 1].end = glyph_subtables.length;
+    }
+
+    if (unlikely (glyph_index.in_error () || glyph_subtables.in_error ()))
+    {
+      glyph_index.fini ();
+      glyph_subtables.fini ();
+      return;
+    }
+    /* These last as long as the face. */
+    glyph_index.shrink_to_fit ();
+    glyph_subtables.shrink_to_fit ();
+    has_glyph_index = true;
+  }
+
   hb_set_digest_t digest;
+  unsigned int props; /* Of the lookup; see Lookup::get_props(). */
+  bool inplace; /* Of the lookup; see Lookup::is_inplace(). */
   hb_get_subtables_context_t::array_t subtables;
+
+  bool has_glyph_index;
+  hb_vector_t<glyph_entry_t> glyph_index; /* Sorted by glyph. */
+  hb_vector_t<unsigned int> glyph_subtables;
+};
+
+/*
+ * Feature tags of a language system, or of the whole FeatureList, sorted
+ * so the map builder does not scan them for every feature it looks up.
+ * If a tag appears more than once, the first occurrence wins, as with a
+ * linear search.
+ */
+struct GSUBGPOS;
+
+struct hb_ot_layout_feature_index_t
+{
+  struct entry_t
+  {
+    hb_tag_t tag;
+    uint16_t index;
+    uint16_t position;
+
+    static int cmp (const void *pa, const void *pb)
+    {
+      const entry_t *a = (const entry_t *) pa;
+      const entry_t *b = (const entry_t *) pb;
+      if (a->tag != b->tag) return a->tag < b->tag ? -1 : 1;
+      return (int) a->position - (int) b->position;
+    }
+    static int cmp_tag (const void *pkey, const void *pentry)
+    {
+      hb_tag_t key = *(const hb_tag_t *) pkey;
+      hb_tag_t tag = ((const entry_t *) pentry)->tag;
+      return key < tag ? -1 : key > tag ? 1 : 0;
+    }
+  };
+
+  /* Indexes the count features whose indices get_index() returns. */
+  template <typename GetIndex>
+  static hb_ot_layout_feature_index_t *create (const GSUBGPOS &g,
+					       const GetIndex &get_index,
+					       unsigned int count);
+
+  void destroy () { free (this); }
+
+  unsigned int get_size () const
+  { return sizeof (*this) + count * sizeof (entry_t); }
+
+  bool find (hb_tag_t tag, unsigned int *feature_index) const
+  {
+    const entry_t *entry = (const entry_t *) hb_bsearch (&tag, entries, count,
+							 sizeof (entries[0]),
+							 entry_t::cmp_tag);
+    if (feature_index)
+      *feature_index = entry ? entry->index : (unsigned int) Index::NOT_FOUND_INDEX;
+    return entry;
+  }
+
+  unsigned int count;
+  entry_t *entries;
+};
+
+
+/* The glyphs hb_ot_layout_lookup_collect_glyphs() finds for a lookup;
+ * collected on first use and not changed afterwards. */
+struct hb_ot_layout_lookup_glyphs_t
+{
+  void init ()
+  {
+    before.init ();
+    input.init ();
+    after.init ();
+    output.init ();
+  }
+  void fini ()
+  {
+    before.fini ();
+    input.fini ();
+    after.fini ();
+    output.fini ();
+  }
+
+  bool in_error () const
+  {
+    return before.in_error () || input.in_error () ||
+	   after.in_error () || output.in_error ();
+  }
+
+  unsigned int get_size () const
+  {
+    return sizeof (*this) +
+	   before.get_memory_usage () + input.get_memory_usage () +
+	   after.get_memory_usage () + output.get_memory_usage ();
+  }
+
+  hb_set_t before;
+  hb_set_t input;
+  hb_set_t after;
+  hb_set_t output;
+};
+
+/* The lookups an hb_ot_layout_collect_lookups() query found.  The key
+ * is each of its scripts, languages and features arrays as its length
+ * plus one, or zero for nullptr, followed by its tags. */
+struct hb_ot_layout_lookups_query_t
+{
+  void init ()
+  {
+    next = nullptr;
+    depth = 0;
+    key.init ();
+    lookups.init ();
+  }
+  void fini ()
+  {
+    key.fini ();
+    lookups.fini ();
+  }
+
+  bool in_error () const { return key.in_error () || lookups.in_error (); }
+
+  bool has_key (const hb_vector_t<hb_tag_t> &other) const
+  {
+    return key.length == other.length &&
+	   (!key.length || !memcmp (key.arrayZ (), other.arrayZ (), key.length * sizeof (key[0])));
+  }
+
+  unsigned int get_size () const
+  {
+    return sizeof (*this) + key.get_allocated_size () +
+	   lookups.get_memory_usage ();
+  }
+
+  hb_ot_layout_lookups_query_t *next;
+  unsigned int depth; /* Queries from here to the end of the list. */
+  hb_vector_t<hb_tag_t> key;
+  hb_set_t lookups;
 };
 
+
 struct GSUBGPOS
 {
   bool has_data () const { return version.to_int (); }
@@ -2706,18 +3709,62 @@ struct GSUBGPOS
     struct GSUBGPOS *out = c->serializer->embed (*this);
     if (unlikely (!out)) return_trace (false);
 
+    typedef OffsetListOf<TLookup> TLookupList;
+    const TLookupList &lookups = this+CastR<const OffsetTo<TLookupList> > (lookupList);
+    const FeatureVariations &feature_vars = version.to_int () >= 0x00010001u ?
+					    this+featureVars : Null(FeatureVariations);
+
+    /* Only lookups that some feature refers to can ever be applied;
+     * contextual subtables, which could refer to others, are not
+     * subset yet. */
+    hb_set_t lookup_indexes;
+    unsigned int feature_count = get_feature_count ();
+    for (unsigned int i = 0; i < feature_count; i++)
+      get_feature (i).add_lookup_indexes_to (&lookup_indexes);
+    feature_vars.collect_lookups (&lookup_indexes);
+
+    /* The features must only refer to the lookups that turn out
+     * non-empty, so subset those first; where they end up in the table
+     * does not depend on the order they are serialized in. */
+    hb_serialize_context_t *s = c->serializer;
+    hb_map_t lookup_index_map;
+    hb_vector_t<hb_serialize_context_t::objidx_t> lookup_objidxs;
+    hb_codepoint_t lookup_index = HB_SET_VALUE_INVALID;
+    while (lookup_indexes.next (&lookup_index))
+    {
+      if (unlikely (lookup_index >= lookups.len)) break;
+      s->push ();
+      if (!lookups[lookup_index].subset (c))
+      {
+	s->pop_discard ();
+	continue;
+      }
+      lookup_index_map.set (lookup_index, lookup_objidxs.length);
+      lookup_objidxs.push (s->pop_pack ());
+    }
+    if (unlikely (!s->propagate_error (lookup_objidxs, lookup_index_map)))
+      return_trace (false);
+    lookup_index_map.freeze ();
+
     out->scriptList.serialize_subset (c, this+scriptList, out);
+    c->lookup_index_map = &lookup_index_map;
     out->featureList.serialize_subset (c, this+featureList, out);
 
-    typedef OffsetListOf<TLookup> TLookupList;
-    /* TODO Use intersects() to count how many subtables survive? */
-    CastR<OffsetTo<TLookupList> > (out->lookupList)
-      .serialize_subset (c,
-			 this+CastR<const OffsetTo<TLookupList> > (lookupList),
-			 out);
+    if (lookupList.is_null ())
+      out->lookupList.set (0);
+    else
+    {
+      s->push ();
+      TLookupList *out_lookups = s->start_embed<TLookupList> ();
+      if (likely (out_lookups->serialize (s, lookup_objidxs.length)))
+	for (unsigned int i = 0; i < lookup_objidxs.length; i++)
+	  s->add_link (out_lookups->arrayZ[i], lookup_objidxs[i], out_lookups);
+      s->add_link (out->lookupList, s->pop_pack (), out);
+    }
 
     if (version.to_int () >= 0x00010001u)
-     out->featureVars.serialize_subset (c, this+featureVars, out);
+     out->featureVars.serialize_subset (c, feature_vars, out);
+    c->lookup_index_map = nullptr;
 
     return_trace (true);
   }
@@ -2755,12 +3802,53 @@ struct GSUBGPOS
 
       this->lookup_count = table->get_lookup_count ();
 
+      /* Slot langsys_starts[i] is the default language system of script i,
+       * followed by its others; the final slot is the whole FeatureList.
+       * The feature indices get built on first use. */
+      this->script_count = table->get_script_count ();
+      this->langsys_starts = (unsigned int *) malloc ((this->script_count + 1) * sizeof (unsigned int));
+      if (likely (this->langsys_starts))
+      {
+	unsigned int slots = 0;
+	for (unsigned int i = 0; i < this->script_count; i++)
+	{
+	  this->langsys_starts[i] = slots;
+	  slots += 1 + table->get_script (i).get_lang_sys_count ();
+	}
+	this->langsys_starts[this->script_count] = slots;
+	this->feature_indices = (hb_atomic_ptr_t<hb_ot_layout_feature_index_t> *)
+				calloc (slots + 1, sizeof (this->feature_indices[0]));
+      }
+      if (unlikely (!this->langsys_starts || !this->feature_indices))
+      {
+	free (this->langsys_starts);
+	this->langsys_starts = nullptr;
+	this->feature_indices = nullptr;
+      }
+
+      this->lookups_queries.init ();
+
       this->accels = (hb_ot_layout_lookup_accelerator_t *) calloc (this->lookup_count, sizeof (hb_ot_layout_lookup_accelerator_t));
       if (unlikely (!this->accels))
 	this->lookup_count = 0;
-
+      this->lookup_glyphs = (hb_atomic_ptr_t<hb_ot_layout_lookup_glyphs_t> *)
+			    calloc (this->lookup_count, sizeof (this->lookup_glyphs[0]));
+      this->first_glyphs = (hb_atomic_ptr_t<hb_set_t> *)
+			   calloc (this->lookup_count, sizeof (this->first_glyphs[0]));
+
+      /* Digests from hb_face_attach_accelerators(), if any. */
+      const uint32_t *starts = nullptr;
+      const hb_set_digest_t *digests = nullptr;
+      get_attached_digests (face, &starts, &digests);
+
+      unsigned int flat_budget = HB_OT_LAYOUT_FLAT_TABLES_MAX_BYTES;
+      unsigned int *flat_budget_ptr = hb_options ().flat_layout_tables ? &flat_budget : nullptr;
       for (unsigned int i = 0; i < this->lookup_count; i++)
-	this->accels[i].init (table->get_lookup (i));
+	if (digests)
+	  this->accels[i].init (table->get_lookup (i), flat_budget_ptr,
+				digests + starts[i], starts[i + 1] - starts[i]);
+	else
+	  this->accels[i].init (table->get_lookup (i), flat_budget_ptr);
     }
 
     void fini ()
@@ -2768,12 +3856,305 @@ struct GSUBGPOS
       for (unsigned int i = 0; i < this->lookup_count; i++)
 	this->accels[i].fini ();
       free (this->accels);
+      if (this->lookup_glyphs)
+	for (unsigned int i = 0; i < this->lookup_count; i++)
+	  destroy_lookup_glyphs (this->lookup_glyphs[i].get ());
+      free (this->lookup_glyphs);
+      if (this->first_glyphs)
+	for (unsigned int i = 0; i < this->lookup_count; i++)
+	  hb_set_destroy (this->first_glyphs[i].get ());
+      free (this->first_glyphs);
+      hb_ot_layout_lookups_query_t *query = this->lookups_queries.get ();
+      while (query)
+      {
+	hb_ot_layout_lookups_query_t *next = query->next;
+	query->fini ();
+	free (query);
+	query = next;
+      }
+      if (this->feature_indices)
+      {
+	unsigned int slots = this->langsys_starts[this->script_count] + 1;
+	for (unsigned int i = 0; i < slots; i++)
+	  if (this->feature_indices[i].get ())
+	    this->feature_indices[i].get ()->destroy ();
+      }
+      free (this->feature_indices);
+      free (this->langsys_starts);
       this->table.destroy ();
     }
 
+    unsigned int get_memory_usage () const
+    {
+      unsigned int size = lookup_count * sizeof (accels[0]);
+      for (unsigned int i = 0; i < lookup_count; i++)
+	size += accels[i].get_memory_usage ();
+      if (lookup_glyphs)
+      {
+	size += lookup_count * sizeof (lookup_glyphs[0]);
+	for (unsigned int i = 0; i < lookup_count; i++)
+	  if (lookup_glyphs[i].get ())
+	    size += lookup_glyphs[i].get ()->get_size ();
+      }
+      if (first_glyphs)
+      {
+	size += lookup_count * sizeof (first_glyphs[0]);
+	for (unsigned int i = 0; i < lookup_count; i++)
+	  if (first_glyphs[i].get ())
+	    size += sizeof (hb_set_t) + first_glyphs[i].get ()->get_memory_usage ();
+      }
+      for (const hb_ot_layout_lookups_query_t *query = lookups_queries.get ();
+	   query; query = query->next)
+	size += query->get_size ();
+      if (feature_indices)
+      {
+	unsigned int slots = langsys_starts[script_count] + 1;
+	size += (script_count + 1) * sizeof (langsys_starts[0]) +
+		slots * sizeof (feature_indices[0]);
+	for (unsigned int i = 0; i < slots; i++)
+	  if (feature_indices[i].get ())
+	    size += feature_indices[i].get ()->get_size ();
+      }
+      return size;
+    }
+
+    /* Finds the first feature of the language system with the tag, or of
+     * the whole FeatureList if script_index is Index::NOT_FOUND_INDEX. */
+    bool find_feature (unsigned int script_index,
+		       unsigned int language_index,
+		       hb_tag_t feature_tag,
+		       unsigned int *feature_index) const
+    {
+      const hb_ot_layout_feature_index_t *index = get_feature_index (script_index, language_index);
+      if (likely (index))
+	return index->find (feature_tag, feature_index);
+
+      const GSUBGPOS &g = *table;
+      const LangSys &l = g.get_script (script_index).get_lang_sys (language_index);
+      bool all = script_index == Index::NOT_FOUND_INDEX;
+      unsigned int num_features = all ? g.get_feature_count () : l.get_feature_count ();
+      for (unsigned int i = 0; i < num_features; i++)
+      {
+	unsigned int f_index = all ? i : l.get_feature_index (i);
+	if (feature_tag == g.get_feature_tag (f_index))
+	{
+	  if (feature_index) *feature_index = f_index;
+	  return true;
+	}
+      }
+      if (feature_index) *feature_index = Index::NOT_FOUND_INDEX;
+      return false;
+    }
+
+    /* The glyphs the lookup reads and writes, or nullptr if they could not
+     * be collected. */
+    const hb_ot_layout_lookup_glyphs_t *get_lookup_glyphs (hb_face_t *face,
+							   unsigned int lookup_index) const
+    {
+      if (unlikely (!lookup_glyphs || lookup_index >= lookup_count))
+	return nullptr;
+
+    retry:
+      hb_ot_layout_lookup_glyphs_t *glyphs = lookup_glyphs[lookup_index].get ();
+
+      if (unlikely (!glyphs))
+      {
+	glyphs = (hb_ot_layout_lookup_glyphs_t *) calloc (1, sizeof (hb_ot_layout_lookup_glyphs_t));
+	if (unlikely (!glyphs))
+	  return nullptr;
+	glyphs->init ();
+
+	hb_collect_glyphs_context_t c (face,
+				       &glyphs->before,
+				       &glyphs->input,
+				       &glyphs->after,
+				       &glyphs->output);
+	table->get_lookup (lookup_index).collect_glyphs (&c);
+	if (unlikely (glyphs->in_error ()))
+	{
+	  destroy_lookup_glyphs (glyphs);
+	  return nullptr;
+	}
+
+	if (unlikely (!lookup_glyphs[lookup_index].cmpexch (nullptr, glyphs)))
+	{
+	  destroy_lookup_glyphs (glyphs);
+	  goto retry;
+	}
+      }
+
+      return glyphs;
+    }
+
+    /* The glyphs the lookup's subtables cover, that is, those it may
+     * start matching at; built on first use.  Exact, unlike the lookup
+     * accelerator's digest.  nullptr if it could not be built. */
+    const hb_set_t *get_first_glyphs (unsigned int lookup_index) const
+    {
+      if (unlikely (!first_glyphs || lookup_index >= lookup_count))
+	return nullptr;
+
+    retry:
+      hb_set_t *glyphs = first_glyphs[lookup_index].get ();
+
+      if (unlikely (!glyphs))
+      {
+	glyphs = hb_set_create ();
+	table->get_lookup (lookup_index).add_coverage (glyphs);
+	if (unlikely (glyphs->in_error ()))
+	{
+	  hb_set_destroy (glyphs);
+	  return nullptr;
+	}
+
+	if (unlikely (!first_glyphs[lookup_index].cmpexch (nullptr, glyphs)))
+	{
+	  hb_set_destroy (glyphs);
+	  goto retry;
+	}
+      }
+
+      return glyphs;
+    }
+
+    /* The lookups of the cached hb_ot_layout_collect_lookups() query with
+     * the key, if any. */
+    const hb_set_t *find_lookups_query (const hb_vector_t<hb_tag_t> &key) const
+    {
+      for (const hb_ot_layout_lookups_query_t *query = lookups_queries.get ();
+	   query; query = query->next)
+	if (query->has_key (key))
+	  return &query->lookups;
+      return nullptr;
+    }
+
+    /* Caches the query, taking ownership of it, and returns the lookups
+     * now cached for its key.  Returns nullptr, leaving the query to the
+     * caller, if it is in error or the cache is full. */
+    const hb_set_t *add_lookups_query (hb_ot_layout_lookups_query_t *query) const
+    {
+      if (unlikely (query->in_error ()))
+	return nullptr;
+
+    retry:
+      hb_ot_layout_lookups_query_t *head = lookups_queries.get ();
+      for (const hb_ot_layout_lookups_query_t *other = head; other; other = other->next)
+	if (other->has_key (query->key))
+	{
+	  query->fini ();
+	  free (query);
+	  return &other->lookups;
+	}
+      if (head && head->depth >= HB_OT_LAYOUT_MAX_LOOKUPS_QUERIES)
+	return nullptr;
+
+      query->next = head;
+      query->depth = head ? head->depth + 1 : 1;
+      if (unlikely (!lookups_queries.cmpexch (head, query)))
+	goto retry;
+
+      return &query->lookups;
+    }
+
+    private:
+    static void destroy_lookup_glyphs (hb_ot_layout_lookup_glyphs_t *glyphs)
+    {
+      if (!glyphs) return;
+      glyphs->fini ();
+      free (glyphs);
+    }
+
+    struct langsys_feature_index_func_t
+    {
+      unsigned int operator () (unsigned int i) const { return l->get_feature_index (i); }
+      const LangSys *l;
+    };
+    struct feature_list_index_func_t
+    {
+      unsigned int operator () (unsigned int i) const { return i; }
+    };
+
+    const hb_ot_layout_feature_index_t *get_feature_index (unsigned int script_index,
+							   unsigned int language_index) const
+    {
+      if (unlikely (!feature_indices))
+	return nullptr;
+
+      const GSUBGPOS &g = *table;
+      unsigned int slot;
+      if (script_index == Index::NOT_FOUND_INDEX)
+	slot = langsys_starts[script_count];
+      else if (script_index < script_count &&
+	       (language_index == Index::NOT_FOUND_INDEX ||
+		language_index < g.get_script (script_index).get_lang_sys_count ()))
+	slot = langsys_starts[script_index] +
+	       (language_index == Index::NOT_FOUND_INDEX ? 0 : 1 + language_index);
+      else
+	return nullptr;
+
+    retry:
+      hb_ot_layout_feature_index_t *index = feature_indices[slot].get ();
+
+      if (unlikely (!index))
+      {
+	if (script_index == Index::NOT_FOUND_INDEX)
+	{
+	  feature_list_index_func_t get_index;
+	  index = hb_ot_layout_feature_index_t::create (g, get_index, g.get_feature_count ());
+	}
+	else
+	{
+	  langsys_feature_index_func_t get_index = {&g.get_script (script_index).get_lang_sys (language_index)};
+	  index = hb_ot_layout_feature_index_t::create (g, get_index, get_index.l->get_feature_count ());
+	}
+	if (unlikely (!index))
+	  return nullptr;
+
+	if (unlikely (!feature_indices[slot].cmpexch (nullptr, index)))
+	{
+	  index->destroy ();
+	  goto retry;
+	}
+      }
+
+      return index;
+    }
+
+    public:
+
+    /* The attached section is the lookup count, the index of each
+     * lookup's first digest plus a final end index, all native-endian
+     * 32-bit, padded to eight bytes, then the digests. */
+    void get_attached_digests (hb_face_t *face,
+			       const uint32_t **starts,
+			       const hb_set_digest_t **digests) const
+    {
+      hb_bytes_t attached = _hb_ot_face_get_attached_accelerator (face, T::tableTag);
+      if (!attached.length)
+	return;
+      const uint32_t *header = (const uint32_t *) attached.arrayZ;
+      unsigned int header_size = ((lookup_count + 2) * 4 + 7) & ~7;
+      if (attached.length < header_size || header[0] != lookup_count)
+	return;
+      unsigned int count = (attached.length - header_size) / sizeof (hb_set_digest_t);
+      for (unsigned int i = 0; i < lookup_count; i++)
+	if (header[1 + i] >= header[2 + i] || header[2 + i] > count)
+	  return;
+      *starts = header + 1;
+      *digests = (const hb_set_digest_t *) (attached.arrayZ + header_size);
+    }
+
     hb_blob_ptr_t<T> table;
     unsigned int lookup_count;
     hb_ot_layout_lookup_accelerator_t *accels;
+
+    private:
+    unsigned int script_count;
+    unsigned int *langsys_starts;
+    hb_atomic_ptr_t<hb_ot_layout_feature_index_t> *feature_indices;
+    hb_atomic_ptr_t<hb_ot_layout_lookup_glyphs_t> *lookup_glyphs;
+    hb_atomic_ptr_t<hb_set_t> *first_glyphs;
+    hb_atomic_ptr_t<hb_ot_layout_lookups_query_t> lookups_queries; /* Newest first. */
   };
 
   protected:
@@ -2795,6 +4176,38 @@ struct GSUBGPOS
 };
 
 
+
+template <typename GetIndex>
+/*static*/ inline hb_ot_layout_feature_index_t *
+hb_ot_layout_feature_index_t::create (const GSUBGPOS &g,
+				      const GetIndex &get_index,
+				      unsigned int count)
+{
+  hb_ot_layout_feature_index_t *index = (hb_ot_layout_feature_index_t *)
+    malloc (sizeof (hb_ot_layout_feature_index_t) + count * sizeof (entry_t));
+  if (unlikely (!index))
+    return nullptr;
+  index->entries = (entry_t *) (index + 1);
+
+  for (unsigned int i = 0; i < count; i++)
+  {
+    unsigned int f_index = get_index (i);
+    index->entries[i].tag = g.get_feature_tag (f_index);
+    index->entries[i].index = f_index;
+    index->entries[i].position = i;
+  }
+  ::qsort (index->entries, count, sizeof (entry_t), entry_t::cmp);
+
+  /* Keep the first of each tag. */
+  unsigned int j = 0;
+  for (unsigned int i = 0; i < count; i++)
+    if (!j || index->entries[i].tag != index->entries[j - 1].tag)
+      index->entries[j++] = index->entries[i];
+  index->count = j;
+
+  return index;
+}
+
 } /* namespace OT */
 
 
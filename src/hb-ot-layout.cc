@@ -85,10 +85,9 @@ hb_ot_layout_kern (const hb_ot_shape_plan_t *plan,
 		   hb_font_t *font,
 		   hb_buffer_t  *buffer)
 {
-  hb_blob_t *blob = font->face->table.kern.get_blob ();
-  const AAT::kern& kern = *blob->as<AAT::kern> ();
+  const OT::kern_accelerator_t& kern = *font->face->table.kern;
 
-  AAT::hb_aat_apply_context_t c (plan, font, buffer, blob);
+  AAT::hb_aat_apply_context_t c (plan, font, buffer, kern.get_blob ());
 
   kern.apply (&c);
 }
@@ -207,7 +206,7 @@ _hb_ot_layout_set_glyph_props (hb_font_t *font,
 {
   _hb_buffer_assert_gsubgpos_vars (buffer);
 
-  const OT::GDEF &gdef = *font->face->table.GDEF->table;
+  const OT::GDEF_accelerator_t &gdef = *font->face->table.GDEF;
   unsigned int count = buffer->len;
   for (unsigned int i = 0; i < count; i++)
   {
@@ -263,6 +262,151 @@ hb_ot_layout_get_attach_points (hb_face_t      *face,
 						     point_array);
 }
 
+/* Ligature carets, computed once per glyph and direction, and kept for as
+ * long as the font keeps the scale, ppem, variation coordinates and font
+ * functions they were computed with. */
+#ifndef HB_OT_LAYOUT_LIG_CARET_CACHE_MAX
+#define HB_OT_LAYOUT_LIG_CARET_CACHE_MAX 8192 /* Carets and counts kept. */
+#endif
+
+static unsigned int
+_hb_ot_layout_compute_ligature_carets (hb_font_t      *font,
+				       hb_direction_t  direction,
+				       hb_codepoint_t  glyph,
+				       unsigned int    start_offset,
+				       unsigned int   *caret_count /* IN/OUT */,
+				       hb_position_t  *caret_array /* OUT */)
+{
+  unsigned int room = caret_count ? *caret_count : 0;
+  unsigned int result = font->face->table.GDEF->table->get_lig_carets (font, direction, glyph, start_offset, caret_count, caret_array);
+  if (!result)
+  {
+    /* GDEF zeroed it. */
+    if (caret_count) *caret_count = room;
+    result = font->face->table.lcar->get_lig_carets (font, direction, glyph, start_offset, caret_count, caret_array);
+  }
+  return result;
+}
+
+struct hb_ot_lig_caret_cache_t
+{
+  hb_mutex_t lock;
+
+  /* What the carets were computed with. */
+  hb_face_t *face;
+  hb_font_funcs_t *klass;
+  void *user_data;
+  int x_scale, y_scale;
+  unsigned int x_ppem, y_ppem;
+  unsigned int serial_coords;
+
+  hb_map_t index;			/* Glyph times four plus direction to where in carets. */
+  hb_vector_t<hb_position_t> carets;	/* A count, followed by that many carets. */
+
+  void init ()
+  {
+    lock.init ();
+    face = nullptr;
+    index.init ();
+    carets.init ();
+  }
+  void fini ()
+  {
+    carets.fini ();
+    index.fini ();
+    lock.fini ();
+  }
+
+  void reset (const hb_font_t *font)
+  {
+    face = font->face;
+    klass = font->klass;
+    user_data = font->user_data;
+    x_scale = font->x_scale;
+    y_scale = font->y_scale;
+    x_ppem = font->x_ppem;
+    y_ppem = font->y_ppem;
+    serial_coords = font->serial_coords;
+    index.clear ();
+    carets.resize (0);
+  }
+  bool is_current (const hb_font_t *font) const
+  {
+    return face == font->face && klass == font->klass && user_data == font->user_data &&
+	   x_scale == font->x_scale && y_scale == font->y_scale &&
+	   x_ppem == font->x_ppem && y_ppem == font->y_ppem &&
+	   serial_coords == font->serial_coords;
+  }
+
+  /* Returns where the count of the carets of glyph is in carets, computing
+   * them if need be, or -1 if they cannot be kept.  Must hold the lock. */
+  unsigned int find (hb_font_t *font, hb_direction_t direction, hb_codepoint_t glyph)
+  {
+    if (unlikely (!is_current (font)))
+      reset (font);
+
+    hb_codepoint_t key = glyph * 4 + (direction - HB_DIRECTION_LTR);
+    hb_codepoint_t offset = index.get (key);
+    if (offset != HB_MAP_VALUE_INVALID)
+      return offset;
+
+    unsigned int count = _hb_ot_layout_compute_ligature_carets (font, direction, glyph, 0, nullptr, nullptr);
+    if (unlikely (count >= HB_OT_LAYOUT_LIG_CARET_CACHE_MAX))
+      return (unsigned int) -1;
+    if (carets.length + 1 + count > HB_OT_LAYOUT_LIG_CARET_CACHE_MAX)
+    {
+      index.clear ();
+      carets.resize (0);
+    }
+
+    offset = carets.length;
+    if (unlikely (!carets.resize (offset + 1 + count)))
+      return (unsigned int) -1;
+    carets[offset] = count;
+    _hb_ot_layout_compute_ligature_carets (font, direction, glyph, 0, &count, &carets[offset + 1]);
+    index.set (key, offset);
+    if (unlikely (index.in_error ()))
+    {
+      /* Leaves the carets unreachable until the next clear. */
+      index.clear ();
+      return (unsigned int) -1;
+    }
+    return offset;
+  }
+};
+
+void
+_hb_ot_layout_lig_caret_cache_destroy (hb_ot_lig_caret_cache_t *cache)
+{
+  if (!cache)
+    return;
+  cache->fini ();
+  free (cache);
+}
+
+static hb_ot_lig_caret_cache_t *
+_hb_ot_layout_get_lig_caret_cache (hb_font_t *font, hb_direction_t direction)
+{
+  if (unlikely (hb_object_is_inert (font) || !HB_DIRECTION_IS_VALID (direction)))
+    return nullptr;
+
+retry:
+  hb_ot_lig_caret_cache_t *cache = font->lig_carets.get ();
+  if (unlikely (!cache))
+  {
+    cache = (hb_ot_lig_caret_cache_t *) calloc (1, sizeof (hb_ot_lig_caret_cache_t));
+    if (unlikely (!cache))
+      return nullptr;
+    cache->init ();
+    if (unlikely (!font->lig_carets.cmpexch (nullptr, cache)))
+    {
+      _hb_ot_layout_lig_caret_cache_destroy (cache);
+      goto retry;
+    }
+  }
+  return cache;
+}
+
 unsigned int
 hb_ot_layout_get_ligature_carets (hb_font_t      *font,
 				  hb_direction_t  direction,
@@ -271,15 +415,96 @@ hb_ot_layout_get_ligature_carets (hb_font_t      *font,
 				  unsigned int   *caret_count /* IN/OUT */,
 				  hb_position_t  *caret_array /* OUT */)
 {
-  unsigned int result_caret_count = 0;
-  unsigned int result = font->face->table.GDEF->table->get_lig_carets (font, direction, glyph, start_offset, &result_caret_count, caret_array);
-  if (result)
+  hb_ot_lig_caret_cache_t *cache = _hb_ot_layout_get_lig_caret_cache (font, direction);
+  if (cache)
   {
-    if (caret_count) *caret_count = result_caret_count;
+    hb_lock_t l (cache->lock);
+    unsigned int offset = cache->find (font, direction, glyph);
+    if (likely (offset != (unsigned int) -1))
+    {
+      unsigned int total = cache->carets[offset];
+      if (caret_count)
+      {
+	hb_array_t<const hb_position_t> carets = cache->carets.as_array ().sub_array (offset + 1, total)
+							      .sub_array (start_offset, caret_count);
+	if (carets.length)
+	  memcpy (caret_array, carets.arrayZ, carets.length * sizeof (caret_array[0]));
+      }
+      return total;
+    }
   }
-  else
-    result = font->face->table.lcar->get_lig_carets (font, direction, glyph, start_offset, caret_count, caret_array);
-  return result;
+
+  return _hb_ot_layout_compute_ligature_carets (font, direction, glyph, start_offset, caret_count, caret_array);
+}
+
+/**
+ * hb_ot_layout_get_ligature_carets_for_glyphs:
+ * @font: a font.
+ * @direction: text direction the carets are for.
+ * @count: number of glyphs.
+ * @first_glyph: the first glyph.
+ * @glyph_stride: bytes from one glyph to the next.
+ * @caret_starts: (out) (optional): @count plus one entries; where the
+ *                carets of each glyph start in @caret_array, and, last,
+ *                the total number of carets.
+ * @caret_array_size: room in @caret_array.
+ * @caret_array: (out) (array length=caret_array_size): the carets of all the
+ *               glyphs, one after the other.
+ *
+ * Gets the ligature carets of many glyphs at once, as
+ * hb_ot_layout_get_ligature_carets() would one at a time; @first_glyph and
+ * @glyph_stride may for example point into an array of #hb_glyph_info_t.
+ * Carets past @caret_array_size are left out, but still counted.  Carets
+ * are remembered by @font, so asking for the same glyphs again, for
+ * example on every caret movement, is cheap until its scale, ppem,
+ * variation coordinates or font functions change.
+ *
+ * Return value: the total number of carets of the glyphs.
+ *
+ * Since: REPLACEME
+ **/
+unsigned int
+hb_ot_layout_get_ligature_carets_for_glyphs (hb_font_t            *font,
+					     hb_direction_t        direction,
+					     unsigned int          count,
+					     const hb_codepoint_t *first_glyph,
+					     unsigned int          glyph_stride,
+					     unsigned int         *caret_starts /* OUT */,
+					     unsigned int          caret_array_size,
+					     hb_position_t        *caret_array /* OUT */)
+{
+  hb_ot_lig_caret_cache_t *cache = _hb_ot_layout_get_lig_caret_cache (font, direction);
+  if (cache)
+    cache->lock.lock ();
+
+  unsigned int total = 0;
+  for (unsigned int i = 0; i < count; i++)
+  {
+    hb_codepoint_t glyph = *first_glyph;
+    first_glyph = &StructAtOffset<const hb_codepoint_t> (first_glyph, glyph_stride);
+    if (caret_starts)
+      caret_starts[i] = total;
+
+    hb_position_t *out = caret_array + MIN (total, caret_array_size);
+    unsigned int room = caret_array_size - MIN (total, caret_array_size);
+    unsigned int offset = cache ? cache->find (font, direction, glyph) : (unsigned int) -1;
+    if (likely (offset != (unsigned int) -1))
+    {
+      unsigned int n = cache->carets[offset];
+      unsigned int copy = MIN (n, room);
+      if (copy)
+	memcpy (out, &cache->carets[offset + 1], copy * sizeof (caret_array[0]));
+      total += n;
+    }
+    else
+      total += _hb_ot_layout_compute_ligature_carets (font, direction, glyph, 0, &room, out);
+  }
+  if (caret_starts)
+    caret_starts[count] = total;
+
+  if (cache)
+    cache->lock.unlock ();
+  return total;
 }
 
 
@@ -330,6 +555,26 @@ get_gsubgpos_table (hb_face_t *face,
   }
 }
 
+/* Looks feature_tag up in the language system, or in the whole FeatureList
+ * for HB_OT_LAYOUT_NO_SCRIPT_INDEX, through the table's accelerator. */
+static bool
+find_feature (hb_face_t    *face,
+	      hb_tag_t      table_tag,
+	      unsigned int  script_index,
+	      unsigned int  language_index,
+	      hb_tag_t      feature_tag,
+	      unsigned int *feature_index)
+{
+  hb_face_use_t use (face);
+  static_assert ((OT::Index::NOT_FOUND_INDEX == HB_OT_LAYOUT_NO_FEATURE_INDEX), "");
+  switch (table_tag) {
+    case HB_OT_TAG_GSUB: return face->table.GSUB->find_feature (script_index, language_index, feature_tag, feature_index);
+    case HB_OT_TAG_GPOS: return face->table.GPOS->find_feature (script_index, language_index, feature_tag, feature_index);
+    default:
+      if (feature_index) *feature_index = HB_OT_LAYOUT_NO_FEATURE_INDEX;
+      return false;
+  }
+}
 
 unsigned int
 hb_ot_layout_table_get_script_tags (hb_face_t    *face,
@@ -338,6 +583,7 @@ hb_ot_layout_table_get_script_tags (hb_face_t    *face,
 				    unsigned int *script_count /* IN/OUT */,
 				    hb_tag_t     *script_tags  /* OUT */)
 {
+  hb_face_use_t use (face);
   const OT::GSUBGPOS &g = get_gsubgpos_table (face, table_tag);
 
   return g.get_script_tags (start_offset, script_count, script_tags);
@@ -351,6 +597,7 @@ hb_ot_layout_table_find_script (hb_face_t    *face,
 				hb_tag_t      script_tag,
 				unsigned int *script_index)
 {
+  hb_face_use_t use (face);
   static_assert ((OT::Index::NOT_FOUND_INDEX == HB_OT_LAYOUT_NO_SCRIPT_INDEX), "");
   const OT::GSUBGPOS &g = get_gsubgpos_table (face, table_tag);
 
@@ -400,6 +647,7 @@ hb_ot_layout_table_select_script (hb_face_t      *face,
 				  unsigned int   *script_index  /* OUT */,
 				  hb_tag_t       *chosen_script /* OUT */)
 {
+  hb_face_use_t use (face);
   static_assert ((OT::Index::NOT_FOUND_INDEX == HB_OT_LAYOUT_NO_SCRIPT_INDEX), "");
   const OT::GSUBGPOS &g = get_gsubgpos_table (face, table_tag);
   unsigned int i;
@@ -449,6 +697,7 @@ hb_ot_layout_table_get_feature_tags (hb_face_t    *face,
 				     unsigned int *feature_count /* IN/OUT */,
 				     hb_tag_t     *feature_tags  /* OUT */)
 {
+  hb_face_use_t use (face);
   const OT::GSUBGPOS &g = get_gsubgpos_table (face, table_tag);
 
   return g.get_feature_tags (start_offset, feature_count, feature_tags);
@@ -460,20 +709,9 @@ hb_ot_layout_table_find_feature (hb_face_t    *face,
 				 hb_tag_t      feature_tag,
 				 unsigned int *feature_index)
 {
-  static_assert ((OT::Index::NOT_FOUND_INDEX == HB_OT_LAYOUT_NO_FEATURE_INDEX), "");
-  const OT::GSUBGPOS &g = get_gsubgpos_table (face, table_tag);
-
-  unsigned int num_features = g.get_feature_count ();
-  for (unsigned int i = 0; i < num_features; i++)
-  {
-    if (feature_tag == g.get_feature_tag (i)) {
-      if (feature_index) *feature_index = i;
-      return true;
-    }
-  }
-
-  if (feature_index) *feature_index = HB_OT_LAYOUT_NO_FEATURE_INDEX;
-  return false;
+  return find_feature (face, table_tag,
+		       HB_OT_LAYOUT_NO_SCRIPT_INDEX, HB_OT_LAYOUT_DEFAULT_LANGUAGE_INDEX,
+		       feature_tag, feature_index);
 }
 
 
@@ -485,6 +723,7 @@ hb_ot_layout_script_get_language_tags (hb_face_t    *face,
 				       unsigned int *language_count /* IN/OUT */,
 				       hb_tag_t     *language_tags  /* OUT */)
 {
+  hb_face_use_t use (face);
   const OT::Script &s = get_gsubgpos_table (face, table_tag).get_script (script_index);
 
   return s.get_lang_sys_tags (start_offset, language_count, language_tags);
@@ -518,6 +757,7 @@ hb_ot_layout_script_select_language (hb_face_t      *face,
 				     const hb_tag_t *language_tags,
 				     unsigned int   *language_index /* OUT */)
 {
+  hb_face_use_t use (face);
   static_assert ((OT::Index::NOT_FOUND_INDEX == HB_OT_LAYOUT_DEFAULT_LANGUAGE_INDEX), "");
   const OT::Script &s = get_gsubgpos_table (face, table_tag).get_script (script_index);
   unsigned int i;
@@ -564,6 +804,7 @@ hb_ot_layout_language_get_required_feature (hb_face_t    *face,
 					    unsigned int *feature_index,
 					    hb_tag_t     *feature_tag)
 {
+  hb_face_use_t use (face);
   const OT::GSUBGPOS &g = get_gsubgpos_table (face, table_tag);
   const OT::LangSys &l = g.get_script (script_index).get_lang_sys (language_index);
 
@@ -583,6 +824,7 @@ hb_ot_layout_language_get_feature_indexes (hb_face_t    *face,
 					   unsigned int *feature_count   /* IN/OUT */,
 					   unsigned int *feature_indexes /* OUT */)
 {
+  hb_face_use_t use (face);
   const OT::GSUBGPOS &g = get_gsubgpos_table (face, table_tag);
   const OT::LangSys &l = g.get_script (script_index).get_lang_sys (language_index);
 
@@ -598,6 +840,7 @@ hb_ot_layout_language_get_feature_tags (hb_face_t    *face,
 					unsigned int *feature_count /* IN/OUT */,
 					hb_tag_t     *feature_tags  /* OUT */)
 {
+  hb_face_use_t use (face);
   const OT::GSUBGPOS &g = get_gsubgpos_table (face, table_tag);
   const OT::LangSys &l = g.get_script (script_index).get_lang_sys (language_index);
 
@@ -622,22 +865,14 @@ hb_ot_layout_language_find_feature (hb_face_t    *face,
 				    hb_tag_t      feature_tag,
 				    unsigned int *feature_index)
 {
-  static_assert ((OT::Index::NOT_FOUND_INDEX == HB_OT_LAYOUT_NO_FEATURE_INDEX), "");
-  const OT::GSUBGPOS &g = get_gsubgpos_table (face, table_tag);
-  const OT::LangSys &l = g.get_script (script_index).get_lang_sys (language_index);
-
-  unsigned int num_features = l.get_feature_count ();
-  for (unsigned int i = 0; i < num_features; i++) {
-    unsigned int f_index = l.get_feature_index (i);
-
-    if (feature_tag == g.get_feature_tag (f_index)) {
-      if (feature_index) *feature_index = f_index;
-      return true;
-    }
+  if (unlikely (script_index == HB_OT_LAYOUT_NO_SCRIPT_INDEX))
+  {
+    /* Not the whole FeatureList; the empty language system. */
+    if (feature_index) *feature_index = HB_OT_LAYOUT_NO_FEATURE_INDEX;
+    return false;
   }
-
-  if (feature_index) *feature_index = HB_OT_LAYOUT_NO_FEATURE_INDEX;
-  return false;
+  return find_feature (face, table_tag, script_index, language_index,
+		       feature_tag, feature_index);
 }
 
 /**
@@ -671,6 +906,7 @@ unsigned int
 hb_ot_layout_table_get_lookup_count (hb_face_t    *face,
 				     hb_tag_t      table_tag)
 {
+  hb_face_use_t use (face);
   return get_gsubgpos_table (face, table_tag).get_lookup_count ();
 }
 
@@ -818,6 +1054,7 @@ hb_ot_layout_collect_features (hb_face_t      *face,
                                const hb_tag_t *features,
                                hb_set_t       *feature_indexes /* OUT */)
 {
+  hb_face_use_t use (face);
   hb_collect_features_context_t c (face, table_tag, feature_indexes);
   if (!scripts)
   {
@@ -843,6 +1080,67 @@ hb_ot_layout_collect_features (hb_face_t      *face,
   }
 }
 
+static void
+collect_lookups (hb_face_t      *face,
+		 hb_tag_t        table_tag,
+		 const hb_tag_t *scripts,
+		 const hb_tag_t *languages,
+		 const hb_tag_t *features,
+		 hb_set_t       *lookup_indexes /* OUT */)
+{
+  const OT::GSUBGPOS &g = get_gsubgpos_table (face, table_tag);
+
+  hb_set_t feature_indexes;
+  hb_ot_layout_collect_features (face, table_tag, scripts, languages, features, &feature_indexes);
+
+  for (hb_codepoint_t feature_index = HB_SET_VALUE_INVALID;
+       hb_set_next (&feature_indexes, &feature_index);)
+    g.get_feature (feature_index).add_lookup_indexes_to (lookup_indexes);
+}
+
+static void
+lookups_query_key_add (hb_vector_t<hb_tag_t> *key, const hb_tag_t *tags)
+{
+  unsigned int count = 0;
+  if (tags)
+    while (tags[count])
+      count++;
+  key->push (tags ? count + 1 : 0);
+  for (unsigned int i = 0; i < count; i++)
+    key->push (tags[i]);
+}
+
+template <typename Accelerator>
+static const hb_set_t *
+get_cached_lookups (const Accelerator &accel,
+		    hb_face_t      *face,
+		    hb_tag_t        table_tag,
+		    const hb_tag_t *scripts,
+		    const hb_tag_t *languages,
+		    const hb_tag_t *features)
+{
+  OT::hb_ot_layout_lookups_query_t *query = (OT::hb_ot_layout_lookups_query_t *) calloc (1, sizeof (OT::hb_ot_layout_lookups_query_t));
+  if (unlikely (!query))
+    return nullptr;
+  query->init ();
+  lookups_query_key_add (&query->key, scripts);
+  lookups_query_key_add (&query->key, languages);
+  lookups_query_key_add (&query->key, features);
+
+  const hb_set_t *lookups = accel.find_lookups_query (query->key);
+  if (!lookups && likely (!query->key.in_error ()))
+  {
+    collect_lookups (face, table_tag, scripts, languages, features, &query->lookups);
+    lookups = accel.add_lookups_query (query);
+    if (lookups)
+      return lookups;
+  }
+
+  query->fini ();
+  free (query);
+  return lookups;
+}
+
 /**
  * hb_ot_layout_collect_lookups:
  *
@@ -856,14 +1154,40 @@ hb_ot_layout_collect_lookups (hb_face_t      *face,
 			      const hb_tag_t *features,
 			      hb_set_t       *lookup_indexes /* OUT */)
 {
-  const OT::GSUBGPOS &g = get_gsubgpos_table (face, table_tag);
+  hb_face_use_t use (face);
 
-  hb_set_t feature_indexes;
-  hb_ot_layout_collect_features (face, table_tag, scripts, languages, features, &feature_indexes);
+  /* Results are cached per table, for the subsetter and clients that
+   * ask the same question again. */
+  const hb_set_t *lookups = nullptr;
+  switch (table_tag)
+  {
+    case HB_OT_TAG_GSUB:
+      lookups = get_cached_lookups (*face->table.GSUB, face, table_tag, scripts, languages, features);
+      break;
+    case HB_OT_TAG_GPOS:
+      lookups = get_cached_lookups (*face->table.GPOS, face, table_tag, scripts, languages, features);
+      break;
+  }
+  if (likely (lookups))
+  {
+    lookup_indexes->union_ (lookups);
+    return;
+  }
 
-  for (hb_codepoint_t feature_index = HB_SET_VALUE_INVALID;
-       hb_set_next (&feature_indexes, &feature_index);)
-    g.get_feature (feature_index).add_lookup_indexes_to (lookup_indexes);
+  collect_lookups (face, table_tag, scripts, languages, features, lookup_indexes);
+}
+
+static void
+lookup_glyphs_copy (const OT::hb_ot_layout_lookup_glyphs_t *glyphs,
+		    hb_set_t *glyphs_before,
+		    hb_set_t *glyphs_input,
+		    hb_set_t *glyphs_after,
+		    hb_set_t *glyphs_output)
+{
+  if (glyphs_before) glyphs_before->union_ (&glyphs->before);
+  if (glyphs_input)  glyphs_input->union_ (&glyphs->input);
+  if (glyphs_after)  glyphs_after->union_ (&glyphs->after);
+  if (glyphs_output) glyphs_output->union_ (&glyphs->output);
 }
 
 /**
@@ -880,6 +1204,25 @@ hb_ot_layout_lookup_collect_glyphs (hb_face_t    *face,
 				    hb_set_t     *glyphs_after,  /* OUT.  May be NULL */
 				    hb_set_t     *glyphs_output  /* OUT.  May be NULL */)
 {
+  hb_face_use_t use (face);
+
+  /* The accelerators keep each lookup's glyphs once collected. */
+  const OT::hb_ot_layout_lookup_glyphs_t *glyphs = nullptr;
+  switch (table_tag)
+  {
+    case HB_OT_TAG_GSUB:
+      glyphs = face->table.GSUB->get_lookup_glyphs (face, lookup_index);
+      break;
+    case HB_OT_TAG_GPOS:
+      glyphs = face->table.GPOS->get_lookup_glyphs (face, lookup_index);
+      break;
+  }
+  if (likely (glyphs))
+  {
+    lookup_glyphs_copy (glyphs, glyphs_before, glyphs_input, glyphs_after, glyphs_output);
+    return;
+  }
+
   OT::hb_collect_glyphs_context_t c (face,
 				     glyphs_before,
 				     glyphs_input,
@@ -903,7 +1246,6 @@ hb_ot_layout_lookup_collect_glyphs (hb_face_t    *face,
   }
 }
 
-
 /* Variations support */
 
 hb_bool_t
@@ -913,6 +1255,7 @@ hb_ot_layout_table_find_feature_variations (hb_face_t    *face,
 					    unsigned int  num_coords,
 					    unsigned int *variations_index /* out */)
 {
+  hb_face_use_t use (face);
   const OT::GSUBGPOS &g = get_gsubgpos_table (face, table_tag);
 
   return g.find_variations_index (coords, num_coords, variations_index);
@@ -927,6 +1270,7 @@ hb_ot_layout_feature_with_variations_get_lookups (hb_face_t    *face,
 						  unsigned int *lookup_count /* IN/OUT */,
 						  unsigned int *lookup_indexes /* OUT */)
 {
+  hb_face_use_t use (face);
   static_assert ((OT::FeatureVariations::NOT_FOUND_INDEX == HB_OT_LAYOUT_NO_VARIATIONS_INDEX), "");
   const OT::GSUBGPOS &g = get_gsubgpos_table (face, table_tag);
 
@@ -943,6 +1287,7 @@ hb_ot_layout_feature_with_variations_get_lookups (hb_face_t    *face,
 hb_bool_t
 hb_ot_layout_has_substitution (hb_face_t *face)
 {
+  hb_face_use_t use (face);
   return face->table.GSUB->table->has_data ();
 }
 
@@ -971,12 +1316,25 @@ hb_ot_layout_lookup_would_substitute_fast (hb_face_t            *face,
 					   unsigned int          glyphs_length,
 					   bool                  zero_context)
 {
-  if (unlikely (lookup_index >= face->table.GSUB->lookup_count)) return false;
+  hb_face_use_t use (face);
+  const OT::GSUB_accelerator_t &accel = *face->table.GSUB;
+  if (unlikely (lookup_index >= accel.lookup_count)) return false;
+
+  /* Shapers probe many glyphs no subtable covers; turn those away before
+   * setting up the dispatch.  The digest weeds out most; the exact set the
+   * rest. */
+  if (unlikely (!glyphs_length) ||
+      !accel.accels[lookup_index].may_have (glyphs[0]))
+    return false;
+  const hb_set_t *first_glyphs = accel.get_first_glyphs (lookup_index);
+  if (likely (first_glyphs) && !first_glyphs->has (glyphs[0]))
+    return false;
+
   OT::hb_would_apply_context_t c (face, glyphs, glyphs_length, (bool) zero_context);
 
-  const OT::SubstLookup& l = face->table.GSUB->table->get_lookup (lookup_index);
+  const OT::SubstLookup& l = accel.table->get_lookup (lookup_index);
 
-  return l.would_apply (&c, &face->table.GSUB->accels[lookup_index]);
+  return l.would_apply (&c, &accel.accels[lookup_index]);
 }
 
 void
@@ -1046,6 +1404,7 @@ hb_ot_layout_lookup_substitute_closure (hb_face_t    *face,
 				        unsigned int  lookup_index,
 				        hb_set_t     *glyphs)
 {
+  hb_face_use_t use (face);
   hb_map_t done_lookups;
   OT::hb_closure_context_t c (face, glyphs, &done_lookups);
 
@@ -1054,6 +1413,53 @@ hb_ot_layout_lookup_substitute_closure (hb_face_t    *face,
   l.closure (&c, lookup_index);
 }
 
+/* A top-level lookup of hb_ot_layout_lookups_substitute_closure(). */
+struct hb_closure_lookup_t
+{
+  unsigned int index;
+  OT::SubstLookup::closure_reads_t reads;
+  hb_set_digest_t coverage;	/* If it reads its coverage. */
+  const hb_set_t *input;	/* If it reads its input; fetched when needed. */
+  unsigned int seen;		/* Added blocks it has been run with, or checked. */
+};
+
+static bool
+closure_lookup_may_read (hb_closure_lookup_t *l, hb_face_t *face,
+			 const OT::GSUB_accelerator_t &accel, hb_codepoint_t glyph)
+{
+  if (l->reads == OT::SubstLookup::CLOSURE_READS_COVERAGE)
+    return l->coverage.may_have (glyph);
+  if (!l->input)
+  {
+    const OT::hb_ot_layout_lookup_glyphs_t *lookup_glyphs = accel.get_lookup_glyphs (face, l->index);
+    if (unlikely (!lookup_glyphs))
+      return true;
+    l->input = &lookup_glyphs->input;
+  }
+  return l->input->has (glyph);
+}
+
+/* Whether glyphs added since the lookup last ran may change its output. */
+static bool
+closure_lookup_is_due (hb_closure_lookup_t *l, hb_face_t *face,
+		       const OT::GSUB_accelerator_t &accel,
+		       const OT::hb_closure_added_t &added)
+{
+  unsigned int count = added.blocks.length;
+  if (l->reads == OT::SubstLookup::CLOSURE_READS_ANY)
+    return l->seen < count;
+  for (; l->seen < count; l->seen++)
+  {
+    const OT::hb_closure_added_t::block_t &block = added.blocks[l->seen];
+    if (!block.listed)
+      return true;
+    for (unsigned int i = block.start; i < block.end; i++)
+      if (closure_lookup_may_read (l, face, accel, added.glyphs[i]))
+	return true;
+  }
+  return false;
+}
+
 /**
  * hb_ot_layout_lookups_substitute_closure:
  *
@@ -1067,27 +1473,125 @@ hb_ot_layout_lookups_substitute_closure (hb_face_t      *face,
                                          const hb_set_t *lookups,
                                          hb_set_t       *glyphs)
 {
+  hb_face_use_t use (face);
+  const OT::GSUB_accelerator_t &accel = *face->table.GSUB;
+  if (accel.closure_from_cache (lookups, glyphs))
+    return;
+
+  hb_set_t input;
+  input.set (glyphs);
+
   hb_map_t done_lookups;
   OT::hb_closure_context_t c (face, glyphs, &done_lookups);
-  const OT::GSUB& gsub = *face->table.GSUB->table;
+  const OT::GSUB& gsub = *accel.table;
+
+  /* Rather than rerunning every lookup until the set stops growing, keep
+   * the glyphs as they get added and rerun only the lookups that look at
+   * some of those added since they last ran.  Their first run is with
+   * everything. */
+  hb_vector_t<hb_closure_lookup_t> todo;
+  OT::hb_closure_added_t added;
+  added.list = false;
+  for (unsigned int lookup_index = 0; lookup_index < accel.lookup_count; lookup_index++)
+  {
+    if (lookups && !lookups->has (lookup_index))
+      continue;
+    hb_closure_lookup_t *l = todo.push ();
+    l->index = lookup_index;
+    l->reads = gsub.get_lookup (lookup_index).get_closure_reads ();
+    l->coverage = accel.accels[lookup_index].get_digest ();
+    l->input = nullptr;
+    l->seen = 0;
+    added.list = added.list || l->reads != OT::SubstLookup::CLOSURE_READS_ANY;
+  }
+  c.added = &added;
 
   unsigned int iteration_count = 0;
-  unsigned int glyphs_length;
+  unsigned int added_length;
+  for (unsigned int i = 0; i < todo.length; i++)
+  {
+    todo[i].seen = added.blocks.length;
+    gsub.get_lookup (todo[i].index).closure (&c, todo[i].index);
+  }
   do
   {
-    glyphs_length = glyphs->get_population ();
-    if (lookups != nullptr)
-    {
-      for (hb_codepoint_t lookup_index = HB_SET_VALUE_INVALID; hb_set_next (lookups, &lookup_index);)
-        gsub.get_lookup (lookup_index).closure (&c, lookup_index);
-    }
-    else
+    added_length = added.blocks.length;
+    for (unsigned int i = 0; i < todo.length; i++)
+      if (closure_lookup_is_due (&todo[i], face, accel, added))
+      {
+	todo[i].seen = added.blocks.length;
+	gsub.get_lookup (todo[i].index).closure (&c, todo[i].index);
+      }
+  } while (iteration_count++ <= HB_CLOSURE_MAX_STAGES &&
+	   added_length != added.blocks.length);
+
+  if (unlikely (todo.in_error () || added.in_error () ||
+		accel.lookup_count != gsub.get_lookup_count ()))
+  {
+    /* Rerun everything until the set stops growing. */
+    c.added = nullptr;
+    unsigned int glyphs_length;
+    iteration_count = 0;
+    do
     {
+      glyphs_length = glyphs->get_population ();
       for (unsigned int i = 0; i < gsub.get_lookup_count (); i++)
-        gsub.get_lookup (i).closure (&c, i);
+	if (!lookups || lookups->has (i))
+	  gsub.get_lookup (i).closure (&c, i);
+    } while (iteration_count++ <= HB_CLOSURE_MAX_STAGES &&
+	     glyphs_length != glyphs->get_population ());
+  }
+
+  accel.closure_to_cache (lookups, &input, glyphs);
+}
+
+bool
+OT::GSUB_accelerator_t::closure_from_cache (const hb_set_t *lookups,
+					    hb_set_t *glyphs) const
+{
+  hb_lock_t l (closure_cache_lock);
+  for (unsigned int i = 0; i < ARRAY_LENGTH (closure_cache); i++)
+    if (closure_cache[i].matches (lookups, glyphs))
+    {
+      closure_cache[i].last_used = ++closure_cache_serial;
+      glyphs->set (closure_cache[i].output);
+      return true;
     }
-  } while (iteration_count++ <= HB_CLOSURE_MAX_STAGES &&
-	   glyphs_length != glyphs->get_population ());
+  return false;
+}
+
+void
+OT::GSUB_accelerator_t::closure_to_cache (const hb_set_t *lookups,
+					  const hb_set_t *input,
+					  const hb_set_t *output) const
+{
+  if (unlikely (input->in_error () || output->in_error ()))
+    return;
+
+  hb_lock_t l (closure_cache_lock);
+
+  /* Replace the least-recently-used entry. */
+  closure_entry_t *entry = &closure_cache[0];
+  for (unsigned int i = 1; i < ARRAY_LENGTH (closure_cache); i++)
+    if (closure_cache[i].last_used < entry->last_used)
+      entry = &closure_cache[i];
+  entry->fini ();
+
+  entry->lookups = lookups ? hb_set_create () : nullptr;
+  entry->input = hb_set_create ();
+  entry->output = hb_set_create ();
+  if (lookups)
+    entry->lookups->set (lookups);
+  entry->input->set (input);
+  entry->output->set (output);
+  if (unlikely ((entry->lookups && entry->lookups->in_error ()) ||
+		entry->input->in_error () ||
+		entry->output->in_error ()))
+  {
+    entry->fini ();
+    return;
+  }
+  entry->last_used = ++closure_cache_serial;
 }
 
 /*
@@ -1097,6 +1601,7 @@ hb_ot_layout_lookups_substitute_closure (hb_face_t      *face,
 hb_bool_t
 hb_ot_layout_has_positioning (hb_face_t *face)
 {
+  hb_face_use_t use (face);
   return face->table.GPOS->table->has_data ();
 }
 
@@ -1131,6 +1636,7 @@ hb_ot_layout_get_size_params (hb_face_t       *face,
 			      unsigned int    *range_start,       /* OUT.  May be NULL */
 			      unsigned int    *range_end          /* OUT.  May be NULL */)
 {
+  hb_face_use_t use (face);
   const OT::GPOS &gpos = *face->table.GPOS->table;
   const hb_tag_t tag = HB_TAG ('s','i','z','e');
 
@@ -1198,6 +1704,7 @@ hb_ot_layout_feature_get_name_ids (hb_face_t       *face,
 				   unsigned int    *num_named_parameters, /* OUT.  May be NULL */
 				   hb_ot_name_id_t *first_param_id        /* OUT.  May be NULL */)
 {
+  hb_face_use_t use (face);
   const OT::GSUBGPOS &g = get_gsubgpos_table (face, table_tag);
 
   hb_tag_t feature_tag = g.get_feature_tag (feature_index);
@@ -1269,6 +1776,7 @@ hb_ot_layout_feature_get_characters (hb_face_t      *face,
 				     unsigned int   *char_count, /* IN/OUT.  May be NULL */
 				     hb_codepoint_t *characters  /* OUT.     May be NULL */)
 {
+  hb_face_use_t use (face);
   const OT::GSUBGPOS &g = get_gsubgpos_table (face, table_tag);
 
   hb_tag_t feature_tag = g.get_feature_tag (feature_index);
@@ -1326,42 +1834,56 @@ struct GPOSProxy
 };
 
 
+/* If profiling, fills in stats; otherwise stats is ignored. */
+template <bool profiling>
 static inline bool
 apply_forward (OT::hb_ot_apply_context_t *c,
-	       const OT::hb_ot_layout_lookup_accelerator_t &accel)
+	       const OT::hb_ot_layout_lookup_accelerator_t &accel,
+	       hb_ot_map_t::lookup_stats_t *stats)
 {
   bool ret = false;
   hb_buffer_t *buffer = c->buffer;
   while (buffer->idx < buffer->len && buffer->successful)
   {
+    if (profiling) stats->positions++;
     bool applied = false;
     if (accel.may_have (buffer->cur().codepoint) &&
 	(buffer->cur().mask & c->lookup_mask) &&
-	c->check_glyph_property (&buffer->cur(), c->lookup_props))
+	c->check_glyph_property (&buffer->cur(), c->lookup_props, buffer->idx))
      {
-       applied = accel.apply (c);
+       applied = accel.apply<profiling> (c, profiling ? &stats->subtable_attempts : nullptr);
      }
 
     if (applied)
+    {
+      if (profiling) stats->applications++;
       ret = true;
+    }
     else
       buffer->next_glyph ();
   }
   return ret;
 }
 
+template <bool profiling>
 static inline bool
 apply_backward (OT::hb_ot_apply_context_t *c,
-	       const OT::hb_ot_layout_lookup_accelerator_t &accel)
+	       const OT::hb_ot_layout_lookup_accelerator_t &accel,
+	       hb_ot_map_t::lookup_stats_t *stats)
 {
   bool ret = false;
   hb_buffer_t *buffer = c->buffer;
   do
   {
+    if (profiling) stats->positions++;
     if (accel.may_have (buffer->cur().codepoint) &&
 	(buffer->cur().mask & c->lookup_mask) &&
-	c->check_glyph_property (&buffer->cur(), c->lookup_props))
-     ret |= accel.apply (c);
+	c->check_glyph_property (&buffer->cur(), c->lookup_props, buffer->idx))
+    {
+      bool applied = accel.apply<profiling> (c, profiling ? &stats->subtable_attempts : nullptr);
+      if (profiling && applied) stats->applications++;
+      ret |= applied;
+    }
 
     /* The reverse lookup doesn't "advance" cursor (for good reason). */
     buffer->idx--;
@@ -1374,28 +1896,39 @@ apply_backward (OT::hb_ot_apply_context_t *c,
 template <typename Proxy>
 static inline void
 apply_string (OT::hb_ot_apply_context_t *c,
-	      const typename Proxy::Lookup &lookup,
-	      const OT::hb_ot_layout_lookup_accelerator_t &accel)
+	      unsigned int lookup_props,
+	      bool is_reverse,
+	      const OT::hb_ot_layout_lookup_accelerator_t &accel,
+	      hb_ot_map_t::lookup_stats_t *stats = nullptr)
 {
   hb_buffer_t *buffer = c->buffer;
 
   if (unlikely (!buffer->len || !c->lookup_mask))
     return;
 
-  c->set_lookup_props (lookup.get_props ());
+  c->set_lookup_props (lookup_props);
+  if (Proxy::table_index == 1)
+    c->init_property_cache ();
 
-  if (likely (!lookup.is_reverse ()))
+  if (likely (!is_reverse))
   {
-    /* in/out forward substitution/positioning */
+    /* in/out forward substitution/positioning; substitutions that only
+     * ever replace one glyph by one run in place too. */
+    bool inplace = Proxy::inplace || accel.is_inplace ();
     if (Proxy::table_index == 0)
-      buffer->clear_output ();
+    {
+      if (inplace)
+	buffer->remove_output ();
+      else
+	buffer->clear_output ();
+    }
     buffer->idx = 0;
 
     bool ret;
-    ret = apply_forward (c, accel);
+    ret = unlikely (stats) ? apply_forward<true> (c, accel, stats) : apply_forward<false> (c, accel, nullptr);
     if (ret)
     {
-      if (!Proxy::inplace)
+      if (!inplace)
 	buffer->swap_buffers ();
       else
 	assert (!buffer->has_separate_output ());
@@ -1408,7 +1941,32 @@ apply_string (OT::hb_ot_apply_context_t *c,
       buffer->remove_output ();
     buffer->idx = buffer->len - 1;
 
-    apply_backward (c, accel);
+    if (unlikely (stats))
+      apply_backward<true> (c, accel, stats);
+    else
+      apply_backward<false> (c, accel, nullptr);
+  }
+}
+
+/* Does what applying the lookups of batch in turn would. */
+static inline void
+apply_batch (OT::hb_ot_apply_context_t       *c,
+	     const hb_ot_map_t::batch_map_t &batch)
+{
+  hb_buffer_t *buffer = c->buffer;
+  buffer->remove_output ();
+
+  unsigned int count = buffer->len;
+  hb_glyph_info_t *info = buffer->info;
+  for (unsigned int i = 0; i < count; i++)
+  {
+    if (!(info[i].mask & batch.mask) || !batch.digest.may_have (info[i].codepoint))
+      continue;
+    hb_codepoint_t u = batch.mapping->get (info[i].codepoint);
+    if (u == HB_MAP_VALUE_INVALID)
+      continue;
+    buffer->idx = i;
+    c->replace_glyph_inplace (u);
   }
 }
 
@@ -1423,33 +1981,188 @@ inline void hb_ot_map_t::apply (const Proxy &proxy,
   OT::hb_ot_apply_context_t c (table_index, font, buffer);
   c.set_recurse_func (Proxy::Lookup::apply_recurse_func);
 
+  const hb_buffer_trace_event_t lookup_event = table_index ? HB_BUFFER_TRACE_EVENT_GPOS_LOOKUP : HB_BUFFER_TRACE_EVENT_GSUB_LOOKUP;
+  const hb_buffer_trace_event_t stage_event = table_index ? HB_BUFFER_TRACE_EVENT_GPOS_STAGE : HB_BUFFER_TRACE_EVENT_GSUB_STAGE;
+  const hb_buffer_trace_event_t pause_event = table_index ? HB_BUFFER_TRACE_EVENT_GPOS_PAUSE : HB_BUFFER_TRACE_EVENT_GSUB_PAUSE;
+
+  hb_vector_t<lookup_stats_t> stats;
+  bool profiling = plan->is_lookup_profiling () &&
+		   stats.resize (lookups[table_index].length);
+
+  /* Batches apply several lookups at once, so only when nothing wants to
+   * hear about the lookups one by one. */
+  unsigned int batch_index = 0;
+  bool use_batches = table_index == 0 && batches.length &&
+		     !profiling && !buffer->messaging () && !buffer->tracing ();
+
   for (unsigned int stage_index = 0; stage_index < stages[table_index].length; stage_index++) {
     const stage_map_t *stage = &stages[table_index][stage_index];
+    uint64_t stage_start = buffer->trace_start ();
+    /* Skip stages none of whose lookups cover the buffer's glyphs. */
+    if (!stage->digest.may_have (c.digest))
+    {
+      if (unlikely (profiling))
+	for (; i < stage->last_lookup; i++)
+	  stats[i].digest_rejects++;
+      i = stage->last_lookup;
+    }
     for (; i < stage->last_lookup; i++)
     {
-      unsigned int lookup_index = lookups[table_index][i].index;
+      if (use_batches)
+      {
+	while (batch_index < batches.length && batches[batch_index].start < i)
+	  batch_index++;
+	if (batch_index < batches.length && batches[batch_index].start == i)
+	{
+	  const batch_map_t &batch = batches[batch_index];
+	  if (batch.digest.may_have (c.digest) &&
+	      likely (buffer->charge_ops (batch.end - batch.start)))
+	    apply_batch (&c, batch);
+	  i = batch.end - 1;
+	  continue;
+	}
+      }
+
+      const lookup_map_t &lookup = lookups[table_index][i];
+      unsigned int lookup_index = lookup.index;
       if (!buffer->message (font, "start lookup %d", lookup_index)) continue;
+      lookup_stats_t *lookup_stats = unlikely (profiling) ? &stats[i] : nullptr;
+      uint64_t lookup_start = lookup_stats ? hb_buffer_t::trace_now_ns () : buffer->trace_start ();
       c.set_lookup_index (lookup_index);
-      c.set_lookup_mask (lookups[table_index][i].mask);
-      c.set_auto_zwj (lookups[table_index][i].auto_zwj);
-      c.set_auto_zwnj (lookups[table_index][i].auto_zwnj);
-      if (lookups[table_index][i].random)
+      c.set_lookup_mask (lookup.mask);
+      c.set_auto_zwj (lookup.auto_zwj);
+      c.set_auto_zwnj (lookup.auto_zwnj);
+      if (lookup.random)
       {
 	c.set_random (true);
 	buffer->unsafe_to_break_all ();
       }
-      apply_string<Proxy> (&c,
-			   proxy.table.get_lookup (lookup_index),
-			   proxy.accels[lookup_index]);
+      /* Skip lookups that cover none of the buffer's glyphs. */
+      const OT::hb_ot_layout_lookup_accelerator_t &accel = proxy.accels[lookup_index];
+      if (accel.may_have (c.digest) && likely (buffer->charge_ops (1)))
+	apply_string<Proxy> (&c, lookup.props, lookup.reverse, accel, lookup_stats);
+      else if (lookup_stats)
+	lookup_stats->digest_rejects++;
+      if (lookup_stats)
+	lookup_stats->elapsed_ns += hb_buffer_t::trace_now_ns () - lookup_start;
+      buffer->trace (font, lookup_event, lookup_index, lookup_start);
       (void) buffer->message (font, "end lookup %d", lookup_index);
     }
+    buffer->trace (font, stage_event, stage_index, stage_start);
 
     if (stage->pause_func)
     {
+      uint64_t pause_start = buffer->trace_start ();
       buffer->clear_output ();
       stage->pause_func (plan, font, buffer);
+      c.digest = buffer->digest ();
+      c.reset_property_cache ();
+      buffer->trace (font, pause_event, stage_index, pause_start);
     }
   }
+
+  if (unlikely (profiling))
+    plan->add_lookup_stats (table_index, stats.arrayZ ());
+}
+
+unsigned int
+hb_ot_layout_lookup_get_props (hb_face_t    *face,
+			       unsigned int  table_index,
+			       unsigned int  lookup_index,
+			       bool         *is_reverse)
+{
+  hb_face_use_t use (face);
+  if (table_index == 0)
+  {
+    const OT::SubstLookup &l = face->table.GSUB->table->get_lookup (lookup_index);
+    *is_reverse = l.is_reverse ();
+    return l.get_props ();
+  }
+  else
+  {
+    const OT::PosLookup &l = face->table.GPOS->table->get_lookup (lookup_index);
+    *is_reverse = l.is_reverse ();
+    return l.get_props ();
+  }
+}
+
+bool
+hb_ot_layout_substitute_lookup_is_single (hb_face_t    *face,
+					  unsigned int  lookup_index)
+{
+  hb_face_use_t use (face);
+  const OT::GSUB_accelerator_t &accel = *face->table.GSUB;
+  if (unlikely (lookup_index >= accel.lookup_count))
+    return false;
+  const OT::SubstLookup &l = accel.table->get_lookup (lookup_index);
+  return !(l.get_props () & (OT::LookupFlag::IgnoreFlags |
+			     OT::LookupFlag::UseMarkFilteringSet |
+			     OT::LookupFlag::MarkAttachmentType)) &&
+	 l.is_single ();
+}
+
+bool
+hb_ot_layout_substitute_lookups_compose (hb_face_t          *face,
+					 const unsigned int *lookup_indices,
+					 unsigned int        count,
+					 hb_map_t           *mapping,
+					 hb_set_digest_t    *digest)
+{
+  hb_face_use_t use (face);
+  const OT::GSUB_accelerator_t &accel = *face->table.GSUB;
+
+  /* Only glyphs some lookup covers can change, and each lookup applies
+   * to each glyph at most once, in its first subtable that covers it. */
+  hb_set_t glyphs;
+  glyphs.init ();
+  for (unsigned int i = 0; i < count; i++)
+    accel.table->get_lookup (lookup_indices[i]).add_coverage (&glyphs);
+
+  hb_codepoint_t g = HB_SET_VALUE_INVALID;
+  while (glyphs.next (&g))
+  {
+    hb_codepoint_t u = g;
+    bool changed = false;
+    for (unsigned int i = 0; i < count; i++)
+    {
+      hb_codepoint_t v = accel.table->get_lookup (lookup_indices[i]).get_single_substitute (u);
+      if (v != HB_SET_VALUE_INVALID)
+      {
+	u = v;
+	changed = true;
+      }
+    }
+    /* Keep glyphs that come back to themselves too: they were still
+     * substituted, which shows in their glyph props. */
+    if (changed)
+    {
+      mapping->set (g, u);
+      digest->add (g);
+    }
+  }
+
+  bool ret = !glyphs.in_error () && !mapping->in_error ();
+  glyphs.fini ();
+  return ret;
+}
+
+void
+hb_ot_layout_lookup_add_digest (hb_face_t       *face,
+				unsigned int     table_index,
+				unsigned int     lookup_index,
+				hb_set_digest_t *digest)
+{
+  hb_face_use_t use (face);
+  if (table_index == 0)
+  {
+    if (lookup_index < face->table.GSUB->lookup_count)
+      digest->add (face->table.GSUB->accels[lookup_index].get_digest ());
+  }
+  else
+  {
+    if (lookup_index < face->table.GPOS->lookup_count)
+      digest->add (face->table.GPOS->accels[lookup_index].get_digest ());
+  }
 }
 
 void hb_ot_map_t::substitute (const hb_ot_shape_plan_t *plan, hb_font_t *font, hb_buffer_t *buffer) const
@@ -1469,7 +2182,7 @@ hb_ot_layout_substitute_lookup (OT::hb_ot_apply_context_t *c,
 				const OT::SubstLookup &lookup,
 				const OT::hb_ot_layout_lookup_accelerator_t &accel)
 {
-  apply_string<GSUBProxy> (c, lookup, accel);
+  apply_string<GSUBProxy> (c, lookup.get_props (), lookup.is_reverse (), accel);
 }
 
 #if 0
@@ -129,6 +129,16 @@ hb_ot_layout_get_ligature_carets (hb_font_t      *font,
 				  unsigned int   *caret_count /* IN/OUT */,
 				  hb_position_t  *caret_array /* OUT */);
 
+HB_EXTERN unsigned int
+hb_ot_layout_get_ligature_carets_for_glyphs (hb_font_t            *font,
+					     hb_direction_t        direction,
+					     unsigned int          count,
+					     const hb_codepoint_t *first_glyph,
+					     unsigned int          glyph_stride,
+					     unsigned int         *caret_starts /* OUT */,
+					     unsigned int          caret_array_size,
+					     hb_position_t        *caret_array /* OUT */);
+
 
 /*
  * GSUB/GPOS feature query and enumeration interface
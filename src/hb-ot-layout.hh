@@ -104,6 +104,41 @@ hb_ot_layout_lookup_would_substitute_fast (hb_face_t            *face,
 					   bool                  zero_context);
 
 
+/* Adds the glyphs lookup @lookup_index of @table_index (0 for GSUB, 1 for
+ * GPOS) may apply to, to @digest. */
+HB_INTERNAL void
+hb_ot_layout_lookup_add_digest (hb_face_t       *face,
+				unsigned int     table_index,
+				unsigned int     lookup_index,
+				hb_set_digest_t *digest);
+
+
+/* Returns the props of lookup @lookup_index of @table_index, and sets
+ * @is_reverse if it is applied from the end of the buffer. */
+HB_INTERNAL unsigned int
+hb_ot_layout_lookup_get_props (hb_face_t    *face,
+			       unsigned int  table_index,
+			       unsigned int  lookup_index,
+			       bool         *is_reverse);
+
+/* Whether every subtable of GSUB lookup @lookup_index is a single
+ * substitution, and its lookup flags skip no glyphs. */
+HB_INTERNAL bool
+hb_ot_layout_substitute_lookup_is_single (hb_face_t    *face,
+					  unsigned int  lookup_index);
+
+/* Maps each glyph that the single substitution GSUB lookups
+ * @lookup_indices, applied in turn, change to the glyph they end up with,
+ * in @mapping, and adds those changed glyphs to @digest.  Returns false
+ * if out of memory. */
+HB_INTERNAL bool
+hb_ot_layout_substitute_lookups_compose (hb_face_t          *face,
+					 const unsigned int *lookup_indices,
+					 unsigned int        count,
+					 hb_map_t           *mapping,
+					 hb_set_digest_t    *digest);
+
+
 /* Should be called before all the substitute_lookup's are done. */
 HB_INTERNAL void
 hb_ot_layout_substitute_start (hb_font_t    *font,
@@ -208,18 +243,20 @@ enum hb_unicode_props_flags_t {
 HB_MARK_AS_FLAG_T (hb_unicode_props_flags_t);
 
 static inline void
-_hb_glyph_info_set_unicode_props (hb_glyph_info_t *info, hb_buffer_t *buffer)
+_hb_glyph_info_set_unicode_props (hb_glyph_info_t *info, hb_buffer_t *buffer,
+				  const hb_unicode_props_t *uprops = nullptr)
 {
   hb_unicode_funcs_t *unicode = buffer->unicode;
   unsigned int u = info->codepoint;
-  unsigned int gen_cat = (unsigned int) unicode->general_category (u);
+  unsigned int gen_cat = uprops ? (unsigned int) uprops->general_category :
+				  (unsigned int) unicode->general_category (u);
   unsigned int props = gen_cat;
 
   if (u >= 0x80)
   {
     buffer->scratch_flags |= HB_BUFFER_SCRATCH_FLAG_HAS_NON_ASCII;
 
-    if (unlikely (unicode->is_default_ignorable (u)))
+    if (unlikely (uprops ? uprops->default_ignorable : unicode->is_default_ignorable (u)))
     {
       buffer->scratch_flags |= HB_BUFFER_SCRATCH_FLAG_HAS_DEFAULT_IGNORABLES;
       props |=  UPROPS_MASK_IGNORABLE;
@@ -248,7 +285,8 @@ _hb_glyph_info_set_unicode_props (hb_glyph_info_t *info, hb_buffer_t *buffer)
     if (unlikely (HB_UNICODE_GENERAL_CATEGORY_IS_MARK (gen_cat)))
     {
       props |= UPROPS_MASK_CONTINUATION;
-      props |= unicode->modified_combining_class (u)<<8;
+      props |= (uprops ? unicode->modified_combining_class (u, uprops->combining_class) :
+			 unicode->modified_combining_class (u))<<8;
     }
   }
 
@@ -37,6 +37,73 @@ void hb_ot_map_t::collect_lookups (unsigned int table_index, hb_set_t *lookups_o
     hb_set_add (lookups_out, lookups[table_index][i].index);
 }
 
+static bool
+lookup_is_batchable (hb_face_t                       *face,
+		     const hb_ot_map_t::lookup_map_t &lookup)
+{
+  return lookup.mask && !lookup.random && !lookup.reverse &&
+	 hb_ot_layout_substitute_lookup_is_single (face, lookup.index);
+}
+
+void hb_ot_map_t::build_batches (hb_face_t *face)
+{
+  hb_vector_t<unsigned int> indices;
+  indices.init ();
+
+  /* Batches don't cross pauses, which may look at or change the glyphs. */
+  unsigned int stage_start = 0;
+  for (unsigned int stage_index = 0; stage_index < stages[0].length; stage_index++)
+  {
+    unsigned int stage_end = stages[0][stage_index].last_lookup;
+    unsigned int i = stage_start;
+    while (i < stage_end)
+    {
+      if (!lookup_is_batchable (face, lookups[0][i]))
+      {
+	i++;
+	continue;
+      }
+      unsigned int end = i + 1;
+      while (end < stage_end &&
+	     lookups[0][end].mask == lookups[0][i].mask &&
+	     lookup_is_batchable (face, lookups[0][end]))
+	end++;
+
+      if (end - i >= 2 && indices.resize (end - i))
+      {
+	for (unsigned int j = i; j < end; j++)
+	  indices[j - i] = lookups[0][j].index;
+
+	batch_map_t *batch = batches.push ();
+	if (unlikely (batches.in_error ()))
+	  break;
+	batch->start = i;
+	batch->end = end;
+	batch->mask = lookups[0][i].mask;
+	batch->digest.init ();
+	batch->mapping = hb_map_create ();
+	bool ok = hb_ot_layout_substitute_lookups_compose (face,
+							   indices.arrayZ (),
+							   indices.length,
+							   batch->mapping,
+							   &batch->digest);
+	if (likely (ok))
+	  batch->mapping->freeze ();
+	if (unlikely (!ok || batch->mapping->in_error ()) ||
+	    !batch->mapping->get_population ())
+	{
+	  hb_map_destroy (batch->mapping);
+	  batches.pop ();
+	}
+      }
+      i = end;
+    }
+    stage_start = stage_end;
+  }
+
+  indices.fini ();
+}
+
 
 hb_ot_map_builder_t::hb_ot_map_builder_t (hb_face_t *face_,
 					  const hb_segment_properties_t *props_)
@@ -44,8 +111,12 @@ hb_ot_map_builder_t::hb_ot_map_builder_t (hb_face_t *face_,
   memset (this, 0, sizeof (*this));
 
   feature_infos.init ();
+  feature_infos.alloc (HB_OT_MAP_BUILDER_FEATURES_RESERVE, true);
   for (unsigned int table_index = 0; table_index < 2; table_index++)
+  {
     stages[table_index].init ();
+    stages[table_index].alloc (HB_OT_MAP_BUILDER_STAGES_RESERVE, true);
+  }
 
   face = face_;
   props = *props_;
@@ -103,18 +174,21 @@ hb_ot_map_builder_t::add_lookups (hb_ot_map_t  &m,
   unsigned int lookup_indices[32];
   unsigned int offset, len;
   unsigned int table_lookup_count;
+  bool reverse;
 
   table_lookup_count = hb_ot_layout_table_get_lookup_count (face, table_tags[table_index]);
 
   offset = 0;
   do {
     len = ARRAY_LENGTH (lookup_indices);
-    hb_ot_layout_feature_with_variations_get_lookups (face,
-						      table_tags[table_index],
-						      feature_index,
-						      variations_index,
-						      offset, &len,
-						      lookup_indices);
+    unsigned int total = hb_ot_layout_feature_with_variations_get_lookups (face,
+									   table_tags[table_index],
+									   feature_index,
+									   variations_index,
+									   offset, &len,
+									   lookup_indices);
+    if (!offset)
+      m.lookups[table_index].alloc (m.lookups[table_index].length + total);
 
     for (unsigned int i = 0; i < len; i++)
     {
@@ -126,6 +200,9 @@ hb_ot_map_builder_t::add_lookups (hb_ot_map_t  &m,
       lookup->auto_zwnj = auto_zwnj;
       lookup->auto_zwj = auto_zwj;
       lookup->random = random;
+      lookup->props = hb_ot_layout_lookup_get_props (face, table_index,
+						     lookup->index, &reverse);
+      lookup->reverse = reverse;
     }
 
     offset += len;
@@ -202,6 +279,8 @@ hb_ot_map_builder_t::compile (hb_ot_map_t                  &m,
   /* Allocate bits now */
   unsigned int next_bit = global_bit_shift + 1;
 
+  m.features.alloc (feature_infos.length, true);
+
   for (unsigned int i = 0; i < feature_infos.length; i++)
   {
     const feature_info_t *info = &feature_infos[i];
@@ -283,6 +362,8 @@ hb_ot_map_builder_t::compile (hb_ot_map_t                  &m,
 
     unsigned int stage_index = 0;
     unsigned int last_num_lookups = 0;
+    unsigned int stage_lookups_start = 0;
+    m.stages[table_index].alloc (stages[table_index].length, true);
     for (unsigned stage = 0; stage < current_stage[table_index]; stage++)
     {
       if (required_feature_index[table_index] != HB_OT_LAYOUT_NO_FEATURE_INDEX &&
@@ -326,9 +407,89 @@ hb_ot_map_builder_t::compile (hb_ot_map_t                  &m,
 	hb_ot_map_t::stage_map_t *stage_map = m.stages[table_index].push ();
 	stage_map->last_lookup = last_num_lookups;
 	stage_map->pause_func = stages[table_index][stage_index].pause_func;
+	stage_map->digest.init ();
+	for (unsigned int i = stage_lookups_start; i < last_num_lookups; i++)
+	  hb_ot_layout_lookup_add_digest (face, table_index,
+					  m.lookups[table_index][i].index,
+					  &stage_map->digest);
+	stage_lookups_start = last_num_lookups;
 
 	stage_index++;
       }
     }
   }
+
+  m.build_batches (face);
+}
+
+
+void
+hb_ot_map_t::serialize (hb_plan_writer_t *w) const
+{
+  w->write (global_mask);
+  w->write (chosen_script);
+  w->write (found_script);
+  w->write_array (features);
+  for (unsigned int table_index = 0; table_index < 2; table_index++)
+  {
+    w->write_array (lookups[table_index]);
+    /* Pause funcs are pointers, so they are not stored; the builder
+     * restores them from its own stages. */
+    w->write (stages[table_index].length);
+    for (unsigned int i = 0; i < stages[table_index].length; i++)
+    {
+      w->write (stages[table_index][i].last_lookup);
+      w->write (stages[table_index][i].digest);
+    }
+  }
+}
+
+bool
+hb_ot_map_builder_t::deserialize (hb_ot_map_t      &m,
+				  hb_plan_reader_t *r)
+{
+  if (!r->read (&m.global_mask) ||
+      !r->read (&m.chosen_script) ||
+      !r->read (&m.found_script) ||
+      !r->read_array (m.features))
+    return false;
+
+  add_gsub_pause (nullptr);
+  add_gpos_pause (nullptr);
+
+  for (unsigned int table_index = 0; table_index < 2; table_index++)
+  {
+    if (!r->read_array (m.lookups[table_index]))
+      return false;
+
+    /* Lookups index the face's lookup accelerators, so make sure the blob
+     * cannot point past them. */
+    unsigned int lookup_count = hb_ot_layout_table_get_lookup_count (face, table_tags[table_index]);
+    for (unsigned int i = 0; i < m.lookups[table_index].length; i++)
+      if (unlikely (m.lookups[table_index][i].index >= lookup_count))
+	return false;
+
+    unsigned int stage_count;
+    if (!r->read (&stage_count) ||
+	stage_count != stages[table_index].length ||
+	!m.stages[table_index].resize (stage_count))
+      return false;
+    unsigned int last_lookup = 0;
+    for (unsigned int i = 0; i < stage_count; i++)
+    {
+      hb_ot_map_t::stage_map_t *stage_map = &m.stages[table_index][i];
+      if (!r->read (&stage_map->last_lookup) ||
+	  !r->read (&stage_map->digest) ||
+	  stage_map->last_lookup < last_lookup ||
+	  stage_map->last_lookup > m.lookups[table_index].length)
+	return false;
+      last_lookup = stage_map->last_lookup;
+      stage_map->pause_func = stages[table_index][i].pause_func;
+    }
+  }
+
+  m.build_batches (face);
+
+  feature_infos.shrink (0);
+  return true;
 }
@@ -30,15 +30,92 @@
 #define HB_OT_MAP_HH
 
 #include "hb-buffer.hh"
+#include "hb-map.hh"
 
 
 #define HB_OT_MAP_MAX_BITS 8u
 #define HB_OT_MAP_MAX_VALUE ((1u << HB_OT_MAP_MAX_BITS) - 1u)
 
+/* Room the map builder makes up front for the features and pauses shapers
+ * add, which typically come to a few dozen and a handful. */
+#ifndef HB_OT_MAP_BUILDER_FEATURES_RESERVE
+#define HB_OT_MAP_BUILDER_FEATURES_RESERVE 48
+#endif
+#ifndef HB_OT_MAP_BUILDER_STAGES_RESERVE
+#define HB_OT_MAP_BUILDER_STAGES_RESERVE 8
+#endif
+
 struct hb_ot_shape_plan_t;
 
 static const hb_tag_t table_tags[2] = {HB_OT_TAG_GSUB, HB_OT_TAG_GPOS};
 
+
+/* Flat storage of compiled plans, for hb_shape_plan_serialize().  Data is
+ * copied as is, in host byte order and layout: blobs are only ever read back
+ * by the same build of HarfBuzz, which the blob header makes sure of. */
+
+struct hb_plan_writer_t
+{
+  hb_vector_t<char> bytes;
+
+  void write (const void *data, unsigned int size)
+  {
+    unsigned int length = bytes.length;
+    if (likely (size && bytes.resize (length + size)))
+      memcpy (bytes.arrayZ () + length, data, size);
+  }
+  template <typename T>
+  void write (const T &v) { write (&v, sizeof (v)); }
+  template <typename T>
+  void write_array (const hb_vector_t<T> &v)
+  {
+    write (v.length);
+    write (v.arrayZ (), v.length * sizeof (T));
+  }
+
+  bool in_error () const { return bytes.in_error (); }
+};
+
+struct hb_plan_reader_t
+{
+  hb_plan_reader_t (const char *data, unsigned int size) :
+    p (data), end (data + size) {}
+
+  bool read (void *data, unsigned int size)
+  {
+    if (unlikely (size > (unsigned int) (end - p)))
+      return false;
+    if (size)
+      memcpy (data, p, size);
+    p += size;
+    return true;
+  }
+  /* Returns @size bytes in place, without copying them. */
+  const char *skip (unsigned int size)
+  {
+    if (unlikely (size > (unsigned int) (end - p)))
+      return nullptr;
+    const char *data = p;
+    p += size;
+    return data;
+  }
+  template <typename T>
+  bool read (T *v) { return read (v, sizeof (*v)); }
+  template <typename T>
+  bool read_array (hb_vector_t<T> &v)
+  {
+    unsigned int length;
+    return read (&length) &&
+	   length <= (unsigned int) (end - p) / sizeof (T) &&
+	   v.resize (length) &&
+	   read (v.arrayZ (), length * sizeof (T));
+  }
+
+  private:
+  const char *p, *end;
+};
+
+
 struct hb_ot_map_t
 {
   friend struct hb_ot_map_builder_t;
@@ -66,6 +143,8 @@ struct hb_ot_map_t
     unsigned short auto_zwnj : 1;
     unsigned short auto_zwj : 1;
     unsigned short random : 1;
+    unsigned short reverse : 1; /* Resolved from the lookup at compile time, */
+    unsigned int props;		/* as is this; see OT::Lookup::get_props(). */
     hb_mask_t mask;
 
     static int cmp (const void *pa, const void *pb)
@@ -76,11 +155,43 @@ struct hb_ot_map_t
     }
   };
 
+  /* Counters for a lookup_map_t, gathered while the shape plan is
+   * profiling; see hb_shape_plan_set_lookup_profiling(). */
+  struct lookup_stats_t {
+    uint64_t positions;
+    uint64_t digest_rejects;
+    uint64_t subtable_attempts;
+    uint64_t applications;
+    uint64_t elapsed_ns;
+
+    void add (const lookup_stats_t &other)
+    {
+      positions += other.positions;
+      digest_rejects += other.digest_rejects;
+      subtable_attempts += other.subtable_attempts;
+      applications += other.applications;
+      elapsed_ns += other.elapsed_ns;
+    }
+  };
+
   typedef void (*pause_func_t) (const struct hb_ot_shape_plan_t *plan, hb_font_t *font, hb_buffer_t *buffer);
 
   struct stage_map_t {
     unsigned int last_lookup; /* Cumulative */
     pause_func_t pause_func;
+    hb_set_digest_t digest; /* Of the glyphs the stage's lookups cover. */
+  };
+
+  /* A row of GSUB lookups, lookups[0][start..end), that are all single
+   * substitutions with the same mask and no lookup flags to skip glyphs
+   * by; applied as one, through the glyph mapping they compose to.  Built
+   * by build_batches (). */
+  struct batch_map_t {
+    unsigned int start;
+    unsigned int end;
+    hb_mask_t mask;
+    hb_set_digest_t digest; /* Of the glyphs in mapping. */
+    hb_map_t *mapping;
   };
 
   void init ()
@@ -93,6 +204,7 @@ struct hb_ot_map_t
       lookups[table_index].init ();
       stages[table_index].init ();
     }
+    batches.init ();
   }
   void fini ()
   {
@@ -102,10 +214,30 @@ struct hb_ot_map_t
       lookups[table_index].fini ();
       stages[table_index].fini ();
     }
+    for (unsigned int i = 0; i < batches.length; i++)
+      hb_map_destroy (batches[i].mapping);
+    batches.fini ();
+  }
+
+  unsigned int get_memory_usage () const
+  {
+    unsigned int bytes = features.get_allocated_size ();
+    for (unsigned int table_index = 0; table_index < 2; table_index++)
+      bytes += lookups[table_index].get_allocated_size () +
+	       stages[table_index].get_allocated_size ();
+    bytes += batches.get_allocated_size ();
+    for (unsigned int i = 0; i < batches.length; i++)
+      bytes += batches[i].mapping->get_memory_usage ();
+    return bytes;
   }
 
   hb_mask_t get_global_mask () const { return global_mask; }
 
+  unsigned int get_lookup_count (unsigned int table_index) const
+  { return lookups[table_index].length; }
+  unsigned int get_lookup_index (unsigned int table_index, unsigned int i) const
+  { return lookups[table_index][i].index; }
+
   hb_mask_t get_mask (hb_tag_t feature_tag, unsigned int *shift = nullptr) const
   {
     const feature_map_t *map = features.bsearch (feature_tag);
@@ -153,6 +285,10 @@ struct hb_ot_map_t
   }
 
   HB_INTERNAL void collect_lookups (unsigned int table_index, hb_set_t *lookups) const;
+  /* Called once lookups and stages are in place. */
+  HB_INTERNAL void build_batches (hb_face_t *face);
+  /* Read back by hb_ot_map_builder_t::deserialize (). */
+  HB_INTERNAL void serialize (hb_plan_writer_t *w) const;
   template <typename Proxy>
   HB_INTERNAL inline void apply (const Proxy &proxy,
 				 const struct hb_ot_shape_plan_t *plan, hb_font_t *font, hb_buffer_t *buffer) const;
@@ -170,6 +306,7 @@ struct hb_ot_map_t
   hb_vector_t<feature_map_t> features;
   hb_vector_t<lookup_map_t> lookups[2]; /* GSUB/GPOS */
   hb_vector_t<stage_map_t> stages[2]; /* GSUB/GPOS */
+  hb_vector_t<batch_map_t> batches; /* GSUB; sorted. */
 };
 
 enum hb_ot_map_feature_flags_t
@@ -227,6 +364,10 @@ struct hb_ot_map_builder_t
 
   HB_INTERNAL void compile (hb_ot_map_t                  &m,
 			    const hb_ot_shape_plan_key_t &key);
+  /* Instead of compile (), restores m from a compiled map that this
+   * builder's face, properties and features produced before. */
+  HB_INTERNAL bool deserialize (hb_ot_map_t      &m,
+				hb_plan_reader_t *r);
 
   private:
 
@@ -173,12 +173,16 @@ struct MathItalicsCorrectionInfo
 		  italicsCorrection.sanitize (c, this));
   }
 
+  const Coverage &get_coverage () const { return this+coverage; }
+
   hb_position_t get_value (hb_codepoint_t glyph,
 			   hb_font_t *font) const
-  {
-    unsigned int index = (this+coverage).get_coverage (glyph);
-    return italicsCorrection[index].get_x_value (font, this);
-  }
+  { return get_value_at (get_coverage ().get_coverage (glyph), font); }
+
+  /* Index is the glyph's coverage index. */
+  hb_position_t get_value_at (unsigned int index,
+			      hb_font_t *font) const
+  { return italicsCorrection[index].get_x_value (font, this); }
 
   protected:
   OffsetTo<Coverage>       coverage;		/* Offset to Coverage table -
@@ -204,10 +208,16 @@ struct MathTopAccentAttachment
 		  topAccentAttachment.sanitize (c, this));
   }
 
+  const Coverage &get_coverage () const { return this+topAccentCoverage; }
+
   hb_position_t get_value (hb_codepoint_t glyph,
 			   hb_font_t *font) const
+  { return get_value_at (glyph, get_coverage ().get_coverage (glyph), font); }
+
+  hb_position_t get_value_at (hb_codepoint_t glyph,
+			      unsigned int index,
+			      hb_font_t *font) const
   {
-    unsigned int index = (this+topAccentCoverage).get_coverage (glyph);
     if (index == NOT_COVERED)
       return font->get_glyph_h_advance (glyph) / 2;
     return topAccentAttachment[index].get_x_value (font, this);
@@ -335,14 +345,19 @@ struct MathKernInfo
 		  mathKernInfoRecords.sanitize (c, this));
   }
 
+  const Coverage &get_coverage () const { return this+mathKernCoverage; }
+
   hb_position_t get_kerning (hb_codepoint_t glyph,
 			     hb_ot_math_kern_t kern,
 			     hb_position_t correction_height,
 			     hb_font_t *font) const
-  {
-    unsigned int index = (this+mathKernCoverage).get_coverage (glyph);
-    return mathKernInfoRecords[index].get_kerning (kern, correction_height, font, this);
-  }
+  { return get_kerning_at (get_coverage ().get_coverage (glyph), kern, correction_height, font); }
+
+  hb_position_t get_kerning_at (unsigned int index,
+				hb_ot_math_kern_t kern,
+				hb_position_t correction_height,
+				hb_font_t *font) const
+  { return mathKernInfoRecords[index].get_kerning (kern, correction_height, font, this); }
 
   protected:
   OffsetTo<Coverage>		mathKernCoverage;    /* Offset to Coverage table -
@@ -388,6 +403,15 @@ struct MathGlyphInfo
 			     hb_font_t *font) const
   { return (this+mathKernInfo).get_kerning (glyph, kern, correction_height, font); }
 
+  const MathItalicsCorrectionInfo &get_italics_correction_info () const
+  { return this+mathItalicsCorrectionInfo; }
+  const MathTopAccentAttachment &get_top_accent_info () const
+  { return this+mathTopAccentAttachment; }
+  const Coverage &get_extended_shape_coverage () const
+  { return this+extendedShapeCoverage; }
+  const MathKernInfo &get_kern_info () const
+  { return this+mathKernInfo; }
+
   protected:
   /* Offset to MathItalicsCorrectionInfo table -
    * from the beginning of MathGlyphInfo table. */
@@ -624,18 +648,23 @@ struct MathVariants
 		       start_offset, parts_count, parts,
 		       italics_correction); }
 
-  private:
+  const Coverage &get_coverage (bool vertical) const
+  { return this+(vertical ? vertGlyphCoverage : horizGlyphCoverage); }
+
   const MathGlyphConstruction &
   get_glyph_construction (hb_codepoint_t glyph,
 			  hb_direction_t direction,
 			  hb_font_t *font HB_UNUSED) const
   {
     bool vertical = HB_DIRECTION_IS_VERTICAL (direction);
-    unsigned int count = vertical ? vertGlyphCount : horizGlyphCount;
-    const OffsetTo<Coverage> &coverage = vertical ? vertGlyphCoverage
-						  : horizGlyphCoverage;
+    return get_glyph_construction_at (get_coverage (vertical).get_coverage (glyph), vertical);
+  }
 
-    unsigned int index = (this+coverage).get_coverage (glyph);
+  /* Index is the glyph's index in the coverage for the direction. */
+  const MathGlyphConstruction &
+  get_glyph_construction_at (unsigned int index, bool vertical) const
+  {
+    unsigned int count = vertical ? vertGlyphCount : horizGlyphCount;
     if (unlikely (index >= count)) return Null (MathGlyphConstruction);
 
     if (!vertical)
@@ -701,6 +730,154 @@ struct MATH
 
   const MathVariants &get_variants () const    { return this+mathVariants; }
 
+  struct accelerator_t
+  {
+    void init (hb_face_t *face)
+    {
+      table = hb_sanitize_context_t().reference_table<MATH> (face);
+      glyphs.init ();
+      if (!table->has_data ())
+	return;
+
+      /* Look every glyph up in each coverage once. */
+      unsigned int num_glyphs = face->get_num_glyphs ();
+      if (unlikely (!glyphs.resize (num_glyphs)))
+      {
+	glyphs.resize (0);
+	return;
+      }
+      const MathGlyphInfo &info = table->get_glyph_info ();
+      const Coverage &italics = info.get_italics_correction_info ().get_coverage ();
+      const Coverage &top_accent = info.get_top_accent_info ().get_coverage ();
+      const Coverage &extended_shape = info.get_extended_shape_coverage ();
+      const Coverage &kern = info.get_kern_info ().get_coverage ();
+      const Coverage &vert = table->get_variants ().get_coverage (true);
+      const Coverage &horiz = table->get_variants ().get_coverage (false);
+      for (unsigned int g = 0; g < num_glyphs; g++)
+      {
+	glyph_t &glyph = glyphs[g];
+	glyph.italics = pack (italics.get_coverage (g));
+	glyph.top_accent = pack (top_accent.get_coverage (g));
+	glyph.extended_shape = extended_shape.get_coverage (g) != NOT_COVERED;
+	glyph.kern = pack (kern.get_coverage (g));
+	glyph.vert = pack (vert.get_coverage (g));
+	glyph.horiz = pack (horiz.get_coverage (g));
+      }
+    }
+
+    void fini ()
+    {
+      glyphs.fini ();
+      table.destroy ();
+    }
+
+    bool has_data () const { return table->has_data (); }
+
+    hb_position_t get_constant (hb_ot_math_constant_t  constant,
+				hb_font_t             *font) const
+    { return table->get_constant (constant, font); }
+
+    /* Glyphs past the face's glyph count go through the coverages. */
+
+    hb_position_t get_italics_correction (hb_codepoint_t glyph, hb_font_t *font) const
+    {
+      const MathGlyphInfo &info = table->get_glyph_info ();
+      if (unlikely (glyph >= glyphs.length))
+	return info.get_italics_correction (glyph, font);
+      return info.get_italics_correction_info ().get_value_at (unpack (glyphs[glyph].italics), font);
+    }
+
+    hb_position_t get_top_accent_attachment (hb_codepoint_t glyph, hb_font_t *font) const
+    {
+      const MathGlyphInfo &info = table->get_glyph_info ();
+      if (unlikely (glyph >= glyphs.length))
+	return info.get_top_accent_attachment (glyph, font);
+      return info.get_top_accent_info ().get_value_at (glyph, unpack (glyphs[glyph].top_accent), font);
+    }
+
+    bool is_extended_shape (hb_codepoint_t glyph) const
+    {
+      if (unlikely (glyph >= glyphs.length))
+	return table->get_glyph_info ().is_extended_shape (glyph);
+      return glyphs[glyph].extended_shape;
+    }
+
+    hb_position_t get_kerning (hb_codepoint_t glyph,
+			       hb_ot_math_kern_t kern,
+			       hb_position_t correction_height,
+			       hb_font_t *font) const
+    {
+      const MathGlyphInfo &info = table->get_glyph_info ();
+      if (unlikely (glyph >= glyphs.length))
+	return info.get_kerning (glyph, kern, correction_height, font);
+      return info.get_kern_info ().get_kerning_at (unpack (glyphs[glyph].kern),
+						   kern, correction_height, font);
+    }
+
+    hb_position_t get_min_connector_overlap (hb_direction_t direction,
+					     hb_font_t *font) const
+    { return table->get_variants ().get_min_connector_overlap (direction, font); }
+
+    unsigned int get_glyph_variants (hb_codepoint_t glyph,
+				     hb_direction_t direction,
+				     hb_font_t *font,
+				     unsigned int start_offset,
+				     unsigned int *variants_count, /* IN/OUT */
+				     hb_ot_math_glyph_variant_t *variants /* OUT */) const
+    {
+      return get_glyph_construction (glyph, direction)
+	     .get_variants (direction, font, start_offset, variants_count, variants);
+    }
+
+    unsigned int get_glyph_parts (hb_codepoint_t glyph,
+				  hb_direction_t direction,
+				  hb_font_t *font,
+				  unsigned int start_offset,
+				  unsigned int *parts_count, /* IN/OUT */
+				  hb_ot_math_glyph_part_t *parts /* OUT */,
+				  hb_position_t *italics_correction /* OUT */) const
+    {
+      return get_glyph_construction (glyph, direction)
+	     .get_assembly ()
+	     .get_parts (direction, font,
+			 start_offset, parts_count, parts,
+			 italics_correction);
+    }
+
+    unsigned int get_memory_usage () const { return glyphs.get_allocated_size (); }
+
+    private:
+    const MathGlyphConstruction &get_glyph_construction (hb_codepoint_t glyph,
+							 hb_direction_t direction) const
+    {
+      const MathVariants &variants = table->get_variants ();
+      if (unlikely (glyph >= glyphs.length))
+	return variants.get_glyph_construction (glyph, direction, nullptr);
+      bool vertical = HB_DIRECTION_IS_VERTICAL (direction);
+      return variants.get_glyph_construction_at (unpack (vertical ? glyphs[glyph].vert
+								  : glyphs[glyph].horiz),
+						 vertical);
+    }
+
+    /* Coverage index plus one, or zero if not covered. */
+    static uint16_t pack (unsigned int index) { return index < 0xFFFFu ? index + 1 : 0; }
+    static unsigned int unpack (uint16_t v) { return v ? v - 1u : (unsigned int) NOT_COVERED; }
+
+    struct glyph_t
+    {
+      uint16_t italics;
+      uint16_t top_accent;
+      uint16_t kern;
+      uint16_t vert;
+      uint16_t horiz;
+      bool extended_shape;
+    };
+
+    hb_blob_ptr_t<MATH> table;
+    /* By glyph. */
+    hb_vector_t<glyph_t> glyphs;
+  };
+
   protected:
   FixedVersion<>version;		/* Version of the MATH table
 					 * initially set to 0x00010000u */
@@ -712,6 +889,8 @@ struct MATH
   DEFINE_SIZE_STATIC (10);
 };
 
+struct MATH_accelerator_t : MATH::accelerator_t {};
+
 } /* namespace OT */
 
 
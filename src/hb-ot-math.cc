@@ -96,7 +96,7 @@ hb_position_t
 hb_ot_math_get_glyph_italics_correction (hb_font_t *font,
 					 hb_codepoint_t glyph)
 {
-  return font->face->table.MATH->get_glyph_info().get_italics_correction (glyph, font);
+  return font->face->table.MATH->get_italics_correction (glyph, font);
 }
 
 /**
@@ -112,7 +112,68 @@ hb_position_t
 hb_ot_math_get_glyph_top_accent_attachment (hb_font_t *font,
 					    hb_codepoint_t glyph)
 {
-  return font->face->table.MATH->get_glyph_info().get_top_accent_attachment (glyph, font);
+  return font->face->table.MATH->get_top_accent_attachment (glyph, font);
+}
+
+/**
+ * hb_ot_math_get_glyph_italics_corrections:
+ * @font: #hb_font_t from which to retrieve the values
+ * @count: number of glyphs
+ * @first_glyph: first glyph index
+ * @glyph_stride: distance in bytes between consecutive glyph indices
+ * @first_correction: (out): where to store the first italics correction
+ * @correction_stride: distance in bytes between consecutive italics corrections
+ *
+ * Like hb_ot_math_get_glyph_italics_correction(), for @count glyphs at once.
+ *
+ * Since: REPLACEME
+ **/
+void
+hb_ot_math_get_glyph_italics_corrections (hb_font_t            *font,
+					  unsigned int          count,
+					  const hb_codepoint_t *first_glyph,
+					  unsigned int          glyph_stride,
+					  hb_position_t        *first_correction,
+					  unsigned int          correction_stride)
+{
+  const OT::MATH_accelerator_t &math = *font->face->table.MATH;
+  for (unsigned int i = 0; i < count; i++)
+  {
+    *first_correction = math.get_italics_correction (*first_glyph, font);
+    first_glyph = &StructAtOffset<hb_codepoint_t> (first_glyph, glyph_stride);
+    first_correction = &StructAtOffset<hb_position_t> (first_correction, correction_stride);
+  }
+}
+
+/**
+ * hb_ot_math_get_glyph_top_accent_attachments:
+ * @font: #hb_font_t from which to retrieve the values
+ * @count: number of glyphs
+ * @first_glyph: first glyph index
+ * @glyph_stride: distance in bytes between consecutive glyph indices
+ * @first_attachment: (out): where to store the first top accent attachment
+ * @attachment_stride: distance in bytes between consecutive top accent attachments
+ *
+ * Like hb_ot_math_get_glyph_top_accent_attachment(), for @count glyphs at
+ * once.
+ *
+ * Since: REPLACEME
+ **/
+void
+hb_ot_math_get_glyph_top_accent_attachments (hb_font_t            *font,
+					     unsigned int          count,
+					     const hb_codepoint_t *first_glyph,
+					     unsigned int          glyph_stride,
+					     hb_position_t        *first_attachment,
+					     unsigned int          attachment_stride)
+{
+  const OT::MATH_accelerator_t &math = *font->face->table.MATH;
+  for (unsigned int i = 0; i < count; i++)
+  {
+    *first_attachment = math.get_top_accent_attachment (*first_glyph, font);
+    first_glyph = &StructAtOffset<hb_codepoint_t> (first_glyph, glyph_stride);
+    first_attachment = &StructAtOffset<hb_position_t> (first_attachment, attachment_stride);
+  }
 }
 
 /**
@@ -128,7 +189,7 @@ hb_bool_t
 hb_ot_math_is_glyph_extended_shape (hb_face_t *face,
 				    hb_codepoint_t glyph)
 {
-  return face->table.MATH->get_glyph_info().is_extended_shape (glyph);
+  return face->table.MATH->is_extended_shape (glyph);
 }
 
 /**
@@ -154,10 +215,10 @@ hb_ot_math_get_glyph_kerning (hb_font_t *font,
 			      hb_ot_math_kern_t kern,
 			      hb_position_t correction_height)
 {
-  return font->face->table.MATH->get_glyph_info().get_kerning (glyph,
-							       kern,
-							       correction_height,
-							       font);
+  return font->face->table.MATH->get_kerning (glyph,
+					       kern,
+					       correction_height,
+					       font);
 }
 
 /**
@@ -187,10 +248,10 @@ hb_ot_math_get_glyph_variants (hb_font_t *font,
 			       unsigned int *variants_count, /* IN/OUT */
 			       hb_ot_math_glyph_variant_t *variants /* OUT */)
 {
-  return font->face->table.MATH->get_variants().get_glyph_variants (glyph, direction, font,
-								    start_offset,
-								    variants_count,
-								    variants);
+  return font->face->table.MATH->get_glyph_variants (glyph, direction, font,
+						      start_offset,
+						      variants_count,
+						      variants);
 }
 
 /**
@@ -211,7 +272,7 @@ hb_position_t
 hb_ot_math_get_min_connector_overlap (hb_font_t *font,
 				      hb_direction_t direction)
 {
-  return font->face->table.MATH->get_variants().get_min_connector_overlap (direction, font);
+  return font->face->table.MATH->get_min_connector_overlap (direction, font);
 }
 
 /**
@@ -243,11 +304,11 @@ hb_ot_math_get_glyph_assembly (hb_font_t *font,
 			       hb_ot_math_glyph_part_t *parts, /* OUT */
 			       hb_position_t *italics_correction /* OUT */)
 {
-  return font->face->table.MATH->get_variants().get_glyph_parts (glyph,
-								 direction,
-								 font,
-								 start_offset,
-								 parts_count,
-								 parts,
-								 italics_correction);
+  return font->face->table.MATH->get_glyph_parts (glyph,
+						   direction,
+						   font,
+						   start_offset,
+						   parts_count,
+						   parts,
+						   italics_correction);
 }
@@ -172,6 +172,22 @@ HB_EXTERN hb_position_t
 hb_ot_math_get_glyph_top_accent_attachment (hb_font_t *font,
 					    hb_codepoint_t glyph);
 
+HB_EXTERN void
+hb_ot_math_get_glyph_italics_corrections (hb_font_t            *font,
+					  unsigned int          count,
+					  const hb_codepoint_t *first_glyph,
+					  unsigned int          glyph_stride,
+					  hb_position_t        *first_correction,
+					  unsigned int          correction_stride);
+
+HB_EXTERN void
+hb_ot_math_get_glyph_top_accent_attachments (hb_font_t            *font,
+					     unsigned int          count,
+					     const hb_codepoint_t *first_glyph,
+					     unsigned int          glyph_stride,
+					     hb_position_t        *first_attachment,
+					     unsigned int          attachment_stride);
+
 HB_EXTERN hb_bool_t
 hb_ot_math_is_glyph_extended_shape (hb_face_t *face,
 				    hb_codepoint_t glyph);
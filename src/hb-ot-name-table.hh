@@ -32,6 +32,13 @@
 #include "hb-aat-layout.hh"
 
 
+/* A name string, NUL-terminated and followed by its code units. */
+struct hb_ot_name_decoded_t
+{
+  unsigned int length;	/* In code units, without the NUL. */
+};
+
+
 namespace OT {
 
 
@@ -216,17 +223,38 @@ struct name
 	this->names[j++] = this->names[i];
       }
       this->names.resize (j);
+
+      /* A UTF-8 and a UTF-32 slot per entry. */
+      this->decoded = (hb_atomic_ptr_t<hb_ot_name_decoded_t> *)
+		      calloc (2 * this->names.length, sizeof (this->decoded[0]));
     }
 
     void fini ()
     {
+      if (this->decoded)
+	for (unsigned int i = 0; i < 2 * this->names.length; i++)
+	  free (this->decoded[i].get ());
+      free (this->decoded);
       this->names.fini ();
       this->table.destroy ();
     }
 
-    int get_index (hb_ot_name_id_t   name_id,
-			  hb_language_t     language,
-			  unsigned int     *width=nullptr) const
+    unsigned int get_memory_usage () const
+    {
+      unsigned int size = this->names.get_allocated_size ();
+      if (this->decoded)
+      {
+	size += 2 * this->names.length * sizeof (this->decoded[0]);
+	for (unsigned int i = 0; i < 2 * this->names.length; i++)
+	  if (const hb_ot_name_decoded_t *d = this->decoded[i].get ())
+	    size += sizeof (*d) + (d->length + 1) * (i & 1 ? 4 : 1);
+      }
+      return size;
+    }
+
+    /* Returns the position of the entry in names, or -1. */
+    int find_entry (hb_ot_name_id_t name_id,
+		    hb_language_t   language) const
     {
       const hb_ot_name_entry_t key = {name_id, {0}, language};
       const hb_ot_name_entry_t *entry = (const hb_ot_name_entry_t *)
@@ -235,13 +263,25 @@ struct name
 						    this->names.length,
 						    sizeof (key),
 						    _hb_ot_name_entry_cmp_key);
-      if (!entry)
+      return entry ? entry - this->names.arrayZ () : -1;
+    }
+
+    /* Bytes per code unit of the entry at position i in names. */
+    unsigned int get_width (unsigned int i) const
+    { return this->names[i].entry_score < 10 ? 2 : 1; }
+
+    int get_index (hb_ot_name_id_t   name_id,
+			  hb_language_t     language,
+			  unsigned int     *width=nullptr) const
+    {
+      int i = find_entry (name_id, language);
+      if (i == -1)
         return -1;
 
       if (width)
-        *width = entry->entry_score < 10 ? 2 : 1;
+        *width = get_width (i);
 
-      return entry->entry_index;
+      return this->names[i].entry_index;
     }
 
     hb_bytes_t get_name (unsigned int idx) const
@@ -258,6 +298,9 @@ struct name
     public:
     hb_blob_ptr_t<name> table;
     hb_vector_t<hb_ot_name_entry_t> names;
+    /* Entries decoded to UTF-8 and UTF-32, in turn, on first use; see
+     * hb-ot-name.cc.  nullptr on allocation failure. */
+    hb_atomic_ptr_t<hb_ot_name_decoded_t> *decoded;
   };
 
   /* We only implement format 0 for now. */
@@ -109,30 +109,98 @@ hb_ot_name_convert_utf (hb_bytes_t                       bytes,
   return dst_len;
 }
 
+template <typename utf_t>
+static inline unsigned int
+hb_ot_name_convert_entry (const OT::name_accelerator_t &name,
+			  unsigned int                  i,
+			  unsigned int                 *text_size /* IN/OUT */,
+			  typename utf_t::codepoint_t  *text /* OUT */)
+{
+  hb_bytes_t bytes = name.get_name (name.names[i].entry_index);
+  if (name.get_width (i) == 2) /* UTF16-BE */
+    return hb_ot_name_convert_utf<hb_utf16_be_t, utf_t> (bytes, text_size, text);
+  else /* ASCII */
+    return hb_ot_name_convert_utf<hb_ascii_t, utf_t> (bytes, text_size, text);
+}
+
+/* Returns entry i of names decoded to utf_t, which must be UTF-8 or
+ * UTF-32, decoding it on first use; nullptr on allocation failure. */
+template <typename utf_t>
+static const hb_ot_name_decoded_t *
+hb_ot_name_get_decoded (const OT::name_accelerator_t &name,
+			unsigned int                  i)
+{
+  typedef typename utf_t::codepoint_t codepoint_t;
+
+  if (unlikely (!name.decoded))
+    return nullptr;
+  hb_atomic_ptr_t<hb_ot_name_decoded_t> &slot = name.decoded[2 * i + (sizeof (codepoint_t) == 4)];
+
+retry:
+  hb_ot_name_decoded_t *d = slot.get ();
+  if (unlikely (!d))
+  {
+    unsigned int length = hb_ot_name_convert_entry<utf_t> (name, i, nullptr, nullptr);
+    d = (hb_ot_name_decoded_t *) malloc (sizeof (*d) + (length + 1) * sizeof (codepoint_t));
+    if (unlikely (!d))
+      return nullptr;
+    unsigned int size = length + 1;
+    d->length = hb_ot_name_convert_entry<utf_t> (name, i, &size, (codepoint_t *) (d + 1));
+    if (unlikely (!slot.cmpexch (nullptr, d)))
+    {
+      free (d);
+      goto retry;
+    }
+  }
+  return d;
+}
+
+template <typename utf_t>
+static inline unsigned int
+hb_ot_name_copy_decoded (const hb_ot_name_decoded_t  *d,
+			 unsigned int                *text_size /* IN/OUT */,
+			 typename utf_t::codepoint_t *text /* OUT */)
+{
+  typedef typename utf_t::codepoint_t codepoint_t;
+  const codepoint_t *src = (const codepoint_t *) (d + 1);
+
+  if (text_size && *text_size)
+  {
+    /* Truncate where hb_ot_name_convert_utf() would: at a character
+     * boundary, leaving room for NUL-termination. */
+    unsigned int n = MIN (*text_size - 1, d->length);
+    if (sizeof (codepoint_t) == 1 && n < d->length)
+      while (n && (src[n] & 0xC0) == 0x80)
+	n--;
+    memcpy (text, src, n * sizeof (codepoint_t));
+    text[n] = 0; /* NUL-terminate. */
+    *text_size = n;
+  }
+  return d->length;
+}
+
 template <typename utf_t>
 static inline unsigned int
 hb_ot_name_get_utf (hb_face_t       *face,
 		    hb_ot_name_id_t  name_id,
 		    hb_language_t    language,
 		    unsigned int    *text_size /* IN/OUT */,
-		    typename utf_t::codepoint_t *text /* OUT */)
+		    typename utf_t::codepoint_t *text, /* OUT */
+		    bool             use_decoded)
 {
   const OT::name_accelerator_t &name = *face->table.name;
 
   if (!language)
     language = hb_language_from_string ("en", 2);
 
-  unsigned int width;
-  int idx = name.get_index (name_id, language, &width);
-  if (idx != -1)
+  int i = name.find_entry (name_id, language);
+  if (i != -1)
   {
-    hb_bytes_t bytes = name.get_name (idx);
-
-    if (width == 2) /* UTF16-BE */
-      return hb_ot_name_convert_utf<hb_utf16_be_t, utf_t> (bytes, text_size, text);
+    if (use_decoded)
+      if (const hb_ot_name_decoded_t *d = hb_ot_name_get_decoded<utf_t> (name, i))
+	return hb_ot_name_copy_decoded<utf_t> (d, text_size, text);
 
-    if (width == 1) /* ASCII */
-      return hb_ot_name_convert_utf<hb_ascii_t, utf_t> (bytes, text_size, text);
+    return hb_ot_name_convert_entry<utf_t> (name, i, text_size, text);
   }
 
   if (text_size)
@@ -168,7 +236,7 @@ hb_ot_name_get_utf8 (hb_face_t       *face,
 		     char            *text      /* OUT */)
 {
   return hb_ot_name_get_utf<hb_utf8_t> (face, name_id, language, text_size,
-					(hb_utf8_t::codepoint_t *) text);
+					(hb_utf8_t::codepoint_t *) text, true);
 }
 
 /**
@@ -194,7 +262,7 @@ hb_ot_name_get_utf16 (hb_face_t       *face,
 		      unsigned int    *text_size /* IN/OUT */,
 		      uint16_t        *text      /* OUT */)
 {
-  return hb_ot_name_get_utf<hb_utf16_t> (face, name_id, language, text_size, text);
+  return hb_ot_name_get_utf<hb_utf16_t> (face, name_id, language, text_size, text, false);
 }
 
 /**
@@ -220,5 +288,53 @@ hb_ot_name_get_utf32 (hb_face_t       *face,
 		      unsigned int    *text_size /* IN/OUT */,
 		      uint32_t        *text      /* OUT */)
 {
-  return hb_ot_name_get_utf<hb_utf32_t> (face, name_id, language, text_size, text);
+  return hb_ot_name_get_utf<hb_utf32_t> (face, name_id, language, text_size, text, true);
+}
+
+/**
+ * hb_ot_name_get_utf8_strings:
+ * @face: font face.
+ * @language: language to fetch the names for.
+ * @count: number of names to fetch.
+ * @name_ids: (array length=count): OpenType name identifiers to fetch.
+ * @strings: (out) (array length=count) (transfer none): fetched names, or %NULL.
+ * @lengths: (out) (array length=count) (allow-none): lengths of fetched names, in bytes.
+ *
+ * Fetches several font names from the OpenType 'name' table at once, such
+ * as the family and subfamily names.  Each name is looked up like
+ * hb_ot_name_get_utf8() does; missing names get %NULL and length zero.
+ * Returned strings are NUL-terminated UTF-8, owned by the @face and
+ * should not be modified.  They can be used as long as @face is alive.
+ *
+ * Returns: number of names found.
+ * Since: REPLACEME
+ **/
+unsigned int
+hb_ot_name_get_utf8_strings (hb_face_t             *face,
+			     hb_language_t          language,
+			     unsigned int           count,
+			     const hb_ot_name_id_t *name_ids,
+			     const char           **strings /* OUT */,
+			     unsigned int          *lengths /* OUT */)
+{
+  const OT::name_accelerator_t &name = *face->table.name;
+
+  if (!language)
+    language = hb_language_from_string ("en", 2);
+
+  unsigned int found = 0;
+  for (unsigned int j = 0; j < count; j++)
+  {
+    const hb_ot_name_decoded_t *d = nullptr;
+    int i = name.find_entry (name_ids[j], language);
+    if (i != -1)
+      d = hb_ot_name_get_decoded<hb_utf8_t> (name, i);
+
+    strings[j] = d ? (const char *) (d + 1) : nullptr;
+    if (lengths)
+      lengths[j] = d ? d->length : 0;
+    if (d)
+      found++;
+  }
+  return found;
 }
@@ -123,6 +123,14 @@ hb_ot_name_get_utf32 (hb_face_t       *face,
 		      unsigned int    *text_size /* IN/OUT */,
 		      uint32_t        *text      /* OUT */);
 
+HB_EXTERN unsigned int
+hb_ot_name_get_utf8_strings (hb_face_t             *face,
+			     hb_language_t          language,
+			     unsigned int           count,
+			     const hb_ot_name_id_t *name_ids,
+			     const char           **strings /* OUT */,
+			     unsigned int          *lengths /* OUT */);
+
 
 HB_END_DECLS
 
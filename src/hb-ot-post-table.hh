@@ -32,6 +32,7 @@
 #define HB_STRING_ARRAY_NAME format1_names
 #define HB_STRING_ARRAY_LIST "hb-ot-post-macroman.hh"
 #include "hb-string-array.hh"
+#include "hb-ot-glyph-name-index.hh"
 #undef HB_STRING_ARRAY_LIST
 #undef HB_STRING_ARRAY_NAME
 
@@ -100,6 +101,8 @@ struct post
     void init (hb_face_t *face)
     {
       index_to_offset.init ();
+      name_index.init ();
+      gids_attached = false;
 
       table = hb_sanitize_context_t ().reference_table<post> (face);
       unsigned int table_length = table.get_length ();
@@ -117,14 +120,33 @@ struct post
 	   index_to_offset.length < 65535 && data < end && data + *data < end;
 	   data += 1 + *data)
 	index_to_offset.push (data - pool);
+
+      /* Sorted names from hb_face_attach_accelerators(), if any. */
+      hb_bytes_t attached = _hb_ot_face_get_attached_accelerator (face, HB_OT_TAG_post);
+      if (attached.length && attached.length == get_glyph_count () * sizeof (uint16_t))
+      {
+	gids_sorted_by_name.set_relaxed ((uint16_t *) attached.arrayZ);
+	gids_attached = true;
+      }
     }
     void fini ()
     {
       index_to_offset.fini ();
-      free (gids_sorted_by_name.get ());
+      if (!gids_attached)
+	free (gids_sorted_by_name.get ());
+      if (name_index.get ())
+	name_index.get ()->destroy ();
       table.destroy ();
     }
 
+    unsigned int get_memory_usage () const
+    {
+      return index_to_offset.get_allocated_size () +
+	     (gids_sorted_by_name.get () && !gids_attached ?
+	      get_glyph_count () * sizeof (uint16_t) : 0) +
+	     (name_index.get () ? name_index.get ()->get_size () : 0);
+    }
+
     bool get_glyph_name (hb_codepoint_t glyph,
 			 char *buf, unsigned int buf_len) const
     {
@@ -147,14 +169,49 @@ struct post
 
       if (unlikely (!len)) return false;
 
+      hb_bytes_t st (name, len);
+
+      /* Attached sorted names are there to avoid building anything. */
+      if (!gids_attached)
+      {
+	const hb_glyph_name_index_t *index = get_name_index ();
+	if (likely (index))
+	{
+	  glyph_name_func_t names = {this};
+	  return index->find (names, st, glyph);
+	}
+      }
+
+      const uint16_t *gids = get_gids_sorted_by_name ();
+      if (unlikely (!gids))
+	return false; /* Anything better?! */
+
+      const uint16_t *gid = (const uint16_t *) hb_bsearch_r (hb_addressof (st), gids, count,
+							     sizeof (gids[0]), cmp_key, (void *) this);
+      if (gid)
+      {
+	*glyph = *gid;
+	return true;
+      }
+
+      return false;
+    }
+
+    /* Glyph ids sorted by name, built on first use; get_glyph_count ()
+     * long.  Lookups only use these when attached; see
+     * hb_face_attach_accelerators(). */
+    const uint16_t *get_gids_sorted_by_name () const
+    {
+      unsigned int count = get_glyph_count ();
+
     retry:
       uint16_t *gids = gids_sorted_by_name.get ();
 
-      if (unlikely (!gids))
+      if (unlikely (!gids && count))
       {
 	gids = (uint16_t *) malloc (count * sizeof (gids[0]));
 	if (unlikely (!gids))
-	  return false; /* Anything better?! */
+	  return nullptr;
 
 	for (unsigned int i = 0; i < count; i++)
 	  gids[i] = i;
@@ -166,21 +223,31 @@ struct post
 	  goto retry;
 	}
       }
+      return gids;
+    }
 
-      hb_bytes_t st (name, len);
-      const uint16_t *gid = (const uint16_t *) hb_bsearch_r (hb_addressof (st), gids, count,
-							     sizeof (gids[0]), cmp_key, (void *) this);
-      if (gid)
+    /* Hash index of the names, built on first use. */
+    const hb_glyph_name_index_t *get_name_index () const
+    {
+    retry:
+      hb_glyph_name_index_t *index = name_index.get ();
+
+      if (unlikely (!index))
       {
-	*glyph = *gid;
-	return true;
-      }
+	glyph_name_func_t names = {this};
+	index = hb_glyph_name_index_t::create (names, get_glyph_count ());
+	if (unlikely (!index))
+	  return nullptr;
 
-      return false;
+	if (unlikely (!name_index.cmpexch (nullptr, index)))
+	{
+	  index->destroy ();
+	  goto retry;
+	}
+      }
+      return index;
     }
 
-    protected:
-
     unsigned int get_glyph_count () const
     {
       if (version == 0x00010000)
@@ -192,6 +259,15 @@ struct post
       return 0;
     }
 
+    protected:
+
+    struct glyph_name_func_t
+    {
+      const accelerator_t *thiz;
+      hb_bytes_t operator () (hb_codepoint_t glyph) const
+      { return thiz->find_glyph_name (glyph); }
+    };
+
     static int cmp_gids (const void *pa, const void *pb, void *arg)
     {
       const accelerator_t *thiz = (const accelerator_t *) arg;
@@ -243,7 +319,9 @@ struct post
     const ArrayOf<HBUINT16> *glyphNameIndex;
     hb_vector_t<uint32_t> index_to_offset;
     const uint8_t *pool;
-    hb_atomic_ptr_t<uint16_t *> gids_sorted_by_name;
+    mutable hb_atomic_ptr_t<uint16_t *> gids_sorted_by_name;
+    mutable hb_atomic_ptr_t<hb_glyph_name_index_t> name_index;
+    bool gids_attached; /* Points into the face's attached accelerators. */
   };
 
   bool sanitize (hb_sanitize_context_t *c) const
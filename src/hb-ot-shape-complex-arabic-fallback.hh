@@ -45,8 +45,7 @@ static const hb_tag_t arabic_fallback_features[] =
 };
 
 static OT::SubstLookup *
-arabic_fallback_synthesize_lookup_single (const hb_ot_shape_plan_t *plan HB_UNUSED,
-					  hb_font_t *font,
+arabic_fallback_synthesize_lookup_single (hb_font_t *font,
 					  unsigned int feature_index)
 {
   OT::GlyphID glyphs[SHAPING_TABLE_LAST - SHAPING_TABLE_FIRST + 1];
@@ -95,8 +94,7 @@ arabic_fallback_synthesize_lookup_single (const hb_ot_shape_plan_t *plan HB_UNUS
 }
 
 static OT::SubstLookup *
-arabic_fallback_synthesize_lookup_ligature (const hb_ot_shape_plan_t *plan HB_UNUSED,
-					    hb_font_t *font)
+arabic_fallback_synthesize_lookup_ligature (hb_font_t *font)
 {
   OT::GlyphID first_glyphs[ARRAY_LENGTH_CONST (ligature_table)];
   unsigned int first_glyphs_indirection[ARRAY_LENGTH_CONST (ligature_table)];
@@ -171,26 +169,46 @@ arabic_fallback_synthesize_lookup_ligature (const hb_ot_shape_plan_t *plan HB_UN
 }
 
 static OT::SubstLookup *
-arabic_fallback_synthesize_lookup (const hb_ot_shape_plan_t *plan,
-				   hb_font_t *font,
+arabic_fallback_synthesize_lookup (hb_font_t *font,
 				   unsigned int feature_index)
 {
   if (feature_index < 4)
-    return arabic_fallback_synthesize_lookup_single (plan, font, feature_index);
+    return arabic_fallback_synthesize_lookup_single (font, feature_index);
   else
-    return arabic_fallback_synthesize_lookup_ligature (plan, font);
+    return arabic_fallback_synthesize_lookup_ligature (font);
 }
 
 #define ARABIC_FALLBACK_MAX_LOOKUPS 5
 
+/* The lookups a face gets, built once on first use and shared by all its
+ * shape plans.  They only depend on the font's cmap, which all fonts of a
+ * face are assumed to share, as the plans already did. */
+struct arabic_fallback_lookups_t
+{
+  struct entry_t
+  {
+    hb_tag_t feature;
+    OT::SubstLookup *lookup;
+    OT::hb_ot_layout_lookup_accelerator_t accel;
+  };
+
+  /* Synthesized from Unicode Arabic Presentation Forms, for each of
+   * arabic_fallback_features; null lookups where the font has none. */
+  entry_t unicode[ARABIC_FALLBACK_MAX_LOOKUPS];
+  /* The hand-coded Windows-1256 lookups, if the font looks like it uses
+   * that encoding. */
+  unsigned int num_win1256;
+  entry_t win1256[ARABIC_FALLBACK_MAX_LOOKUPS];
+};
+
+/* What a shape plan uses: the face's lookups for features it enables. */
 struct arabic_fallback_plan_t
 {
   unsigned int num_lookups;
-  bool free_lookups;
 
   hb_mask_t mask_array[ARABIC_FALLBACK_MAX_LOOKUPS];
-  OT::SubstLookup *lookup_array[ARABIC_FALLBACK_MAX_LOOKUPS];
-  OT::hb_ot_layout_lookup_accelerator_t accel_array[ARABIC_FALLBACK_MAX_LOOKUPS];
+  const OT::SubstLookup *lookup_array[ARABIC_FALLBACK_MAX_LOOKUPS];
+  const OT::hb_ot_layout_lookup_accelerator_t *accel_array[ARABIC_FALLBACK_MAX_LOOKUPS];
 };
 
 #if defined(_WIN32) && !defined(HB_NO_WIN1256)
@@ -211,10 +229,9 @@ struct ManifestLookup
 };
 typedef OT::ArrayOf<ManifestLookup> Manifest;
 
-static bool
-arabic_fallback_plan_init_win1256 (arabic_fallback_plan_t *fallback_plan HB_UNUSED,
-				   const hb_ot_shape_plan_t *plan HB_UNUSED,
-				   hb_font_t *font HB_UNUSED)
+static void
+arabic_fallback_lookups_init_win1256 (arabic_fallback_lookups_t *lookups HB_UNUSED,
+				      hb_font_t *font HB_UNUSED)
 {
 #ifdef HB_WITH_WIN1256
   /* Does this font look like it's Windows-1256-encoded? */
@@ -224,7 +241,7 @@ arabic_fallback_plan_init_win1256 (arabic_fallback_plan_t *fallback_plan HB_UNUS
 	hb_font_get_glyph (font, 0x0649u, 0, &g) && g == 236 /* ALEF MAKSURA */ &&
 	hb_font_get_glyph (font, 0x064Au, 0, &g) && g == 237 /* YEH */ &&
 	hb_font_get_glyph (font, 0x0652u, 0, &g) && g == 250 /* SUKUN */))
-    return false;
+    return;
 
   const Manifest &manifest = reinterpret_cast<const Manifest&> (arabic_win1256_gsub_lookups.manifest);
   static_assert (sizeof (arabic_win1256_gsub_lookups.manifestData) / sizeof (ManifestLookup)
@@ -235,73 +252,123 @@ arabic_fallback_plan_init_win1256 (arabic_fallback_plan_t *fallback_plan HB_UNUS
   unsigned int count = manifest.len;
   for (unsigned int i = 0; i < count; i++)
   {
-    fallback_plan->mask_array[j] = plan->map.get_1_mask (manifest[i].tag);
-    if (fallback_plan->mask_array[j])
+    arabic_fallback_lookups_t::entry_t &entry = lookups->win1256[j];
+    entry.feature = manifest[i].tag;
+    entry.lookup = const_cast<OT::SubstLookup*> (&(&manifest+manifest[i].lookupOffset));
+    if (entry.lookup)
     {
-      fallback_plan->lookup_array[j] = const_cast<OT::SubstLookup*> (&(&manifest+manifest[i].lookupOffset));
-      if (fallback_plan->lookup_array[j])
-      {
-	fallback_plan->accel_array[j].init (*fallback_plan->lookup_array[j]);
-	j++;
-      }
+      entry.accel.init (*entry.lookup);
+      j++;
     }
   }
 
-  fallback_plan->num_lookups = j;
-  fallback_plan->free_lookups = false;
-
-  return j > 0;
-#else
-  return false;
+  lookups->num_win1256 = j;
 #endif
 }
 
-static bool
-arabic_fallback_plan_init_unicode (arabic_fallback_plan_t *fallback_plan,
-				   const hb_ot_shape_plan_t *plan,
-				   hb_font_t *font)
+static void
+arabic_fallback_lookups_init_unicode (arabic_fallback_lookups_t *lookups,
+				      hb_font_t *font)
 {
   static_assert ((ARRAY_LENGTH_CONST(arabic_fallback_features) <= ARABIC_FALLBACK_MAX_LOOKUPS), "");
-  unsigned int j = 0;
   for (unsigned int i = 0; i < ARRAY_LENGTH(arabic_fallback_features) ; i++)
   {
-    fallback_plan->mask_array[j] = plan->map.get_1_mask (arabic_fallback_features[i]);
-    if (fallback_plan->mask_array[j])
+    arabic_fallback_lookups_t::entry_t &entry = lookups->unicode[i];
+    entry.feature = arabic_fallback_features[i];
+    entry.lookup = arabic_fallback_synthesize_lookup (font, i);
+    if (entry.lookup)
+      entry.accel.init (*entry.lookup);
+  }
+}
+
+void
+_hb_ot_shape_complex_arabic_fallback_lookups_destroy (arabic_fallback_lookups_t *lookups)
+{
+  for (unsigned int i = 0; i < ARRAY_LENGTH (lookups->unicode); i++)
+    if (lookups->unicode[i].lookup)
     {
-      fallback_plan->lookup_array[j] = arabic_fallback_synthesize_lookup (plan, font, i);
-      if (fallback_plan->lookup_array[j])
-      {
-	fallback_plan->accel_array[j].init (*fallback_plan->lookup_array[j]);
-	j++;
-      }
+      lookups->unicode[i].accel.fini ();
+      free (lookups->unicode[i].lookup);
     }
+  for (unsigned int i = 0; i < lookups->num_win1256; i++)
+    lookups->win1256[i].accel.fini ();
+
+  free (lookups);
+}
+
+static const arabic_fallback_lookups_t *
+arabic_fallback_lookups_get (hb_font_t *font)
+{
+  hb_ot_face_data_t *face_data = font->face->data.ot.get_stored ();
+  if (unlikely (!face_data))
+    return nullptr;
+
+retry:
+  arabic_fallback_lookups_t *lookups = face_data->arabic_fallback_lookups.get ();
+  if (likely (lookups))
+    return lookups;
+
+  lookups = (arabic_fallback_lookups_t *) calloc (1, sizeof (arabic_fallback_lookups_t));
+  if (unlikely (!lookups))
+    return nullptr;
+
+  arabic_fallback_lookups_init_unicode (lookups, font);
+  arabic_fallback_lookups_init_win1256 (lookups, font);
+
+  if (unlikely (!face_data->arabic_fallback_lookups.cmpexch (nullptr, lookups)))
+  {
+    _hb_ot_shape_complex_arabic_fallback_lookups_destroy (lookups);
+    goto retry;
   }
+  return lookups;
+}
 
+/* Picks the entries for features the plan enables; returns their number. */
+static unsigned int
+arabic_fallback_plan_init_entries (arabic_fallback_plan_t *fallback_plan,
+				   const hb_ot_shape_plan_t *plan,
+				   const arabic_fallback_lookups_t::entry_t *entries,
+				   unsigned int count)
+{
+  unsigned int j = 0;
+  for (unsigned int i = 0; i < count; i++)
+  {
+    if (!entries[i].lookup)
+      continue;
+    fallback_plan->mask_array[j] = plan->map.get_1_mask (entries[i].feature);
+    if (fallback_plan->mask_array[j])
+    {
+      fallback_plan->lookup_array[j] = entries[i].lookup;
+      fallback_plan->accel_array[j] = &entries[i].accel;
+      j++;
+    }
+  }
   fallback_plan->num_lookups = j;
-  fallback_plan->free_lookups = true;
-
-  return j > 0;
+  return j;
 }
 
 static arabic_fallback_plan_t *
 arabic_fallback_plan_create (const hb_ot_shape_plan_t *plan,
 			     hb_font_t *font)
 {
+  const arabic_fallback_lookups_t *lookups = arabic_fallback_lookups_get (font);
+  if (unlikely (!lookups))
+    return const_cast<arabic_fallback_plan_t *> (&Null(arabic_fallback_plan_t));
+
   arabic_fallback_plan_t *fallback_plan = (arabic_fallback_plan_t *) calloc (1, sizeof (arabic_fallback_plan_t));
   if (unlikely (!fallback_plan))
     return const_cast<arabic_fallback_plan_t *> (&Null(arabic_fallback_plan_t));
 
-  fallback_plan->num_lookups = 0;
-  fallback_plan->free_lookups = false;
-
-  /* Try synthesizing GSUB table using Unicode Arabic Presentation Forms,
+  /* Try the lookups synthesized from Unicode Arabic Presentation Forms,
    * in case the font has cmap entries for the presentation-forms characters. */
-  if (arabic_fallback_plan_init_unicode (fallback_plan, plan, font))
+  if (arabic_fallback_plan_init_entries (fallback_plan, plan,
+					 lookups->unicode, ARRAY_LENGTH (lookups->unicode)))
     return fallback_plan;
 
   /* See if this looks like a Windows-1256-encoded font.  If it does, use a
    * hand-coded GSUB table. */
-  if (arabic_fallback_plan_init_win1256 (fallback_plan, plan, font))
+  if (arabic_fallback_plan_init_entries (fallback_plan, plan,
+					 lookups->win1256, lookups->num_win1256))
     return fallback_plan;
 
   assert (fallback_plan->num_lookups == 0);
@@ -315,14 +382,6 @@ arabic_fallback_plan_destroy (arabic_fallback_plan_t *fallback_plan)
   if (!fallback_plan || fallback_plan->num_lookups == 0)
     return;
 
-  for (unsigned int i = 0; i < fallback_plan->num_lookups; i++)
-    if (fallback_plan->lookup_array[i])
-    {
-      fallback_plan->accel_array[i].fini ();
-      if (fallback_plan->free_lookups)
-	free (fallback_plan->lookup_array[i]);
-    }
-
   free (fallback_plan);
 }
 
@@ -337,7 +396,7 @@ arabic_fallback_plan_shape (arabic_fallback_plan_t *fallback_plan,
       c.set_lookup_mask (fallback_plan->mask_array[i]);
       hb_ot_layout_substitute_lookup (&c,
 				      *fallback_plan->lookup_array[i],
-				      fallback_plan->accel_array[i]);
+				      *fallback_plan->accel_array[i]);
     }
 }
 
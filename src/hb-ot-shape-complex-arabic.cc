@@ -28,6 +28,8 @@
 #include "hb-ot-shape-complex-arabic.hh"
 #include "hb-ot-shape.hh"
 
+#ifndef HB_NO_SHAPER_ARABIC
+
 
 /* buffer var allocations */
 #define arabic_shaping_action() complex_var_u8_0() /* arabic shaping action */
@@ -444,6 +446,7 @@ apply_stch (const hb_ot_shape_plan_t *plan HB_UNUSED,
 {
   if (likely (!(buffer->scratch_flags & HB_BUFFER_SCRATCH_FLAG_ARABIC_HAS_STCH)))
     return;
+  buffer->scratch_flags |= HB_BUFFER_SCRATCH_FLAG_HAS_SIZE_DEPENDENT_GLYPHS;
 
   /* The Arabic shaper currently always processes in RTL mode, so we should
    * stretch / position the stretched pieces to the left / preceding glyphs. */
@@ -706,3 +709,5 @@ const hb_ot_complex_shaper_t _hb_ot_complex_shaper_arabic =
   HB_OT_SHAPE_ZERO_WIDTH_MARKS_BY_GDEF_LATE,
   true, /* fallback_position */
 };
+
+#endif
@@ -26,6 +26,8 @@
 
 #include "hb-ot-shape-complex.hh"
 
+#ifndef HB_NO_SHAPER_HANGUL
+
 
 /* Hangul shaper */
 
@@ -117,6 +119,44 @@ data_destroy_hangul (void *data)
 /* buffer var allocations */
 #define hangul_shaping_feature() complex_var_u8_0() /* hangul jamo shaping feature */
 
+/* Whether preprocess_text_hangul() would leave the buffer as is: there
+ * are no jamo or tone marks, and the font has glyphs for all precomposed
+ * syllables.  True for most modern Korean text. */
+static bool
+is_precomposed_text_supported (hb_buffer_t *buffer,
+			       hb_font_t   *font)
+{
+  hb_codepoint_t syllables[64];
+  hb_codepoint_t glyphs[ARRAY_LENGTH_CONST (syllables)];
+  unsigned int num_syllables = 0;
+
+  unsigned int count = buffer->len;
+  const hb_glyph_info_t *info = buffer->info;
+  for (unsigned int i = 0; i < count; i++)
+  {
+    hb_codepoint_t u = info[i].codepoint;
+    if (isCombinedS (u))
+    {
+      syllables[num_syllables++] = u;
+      if (num_syllables == ARRAY_LENGTH (syllables))
+      {
+	if (font->get_nominal_glyphs (num_syllables,
+				      syllables, sizeof (syllables[0]),
+				      glyphs, sizeof (glyphs[0])) != num_syllables)
+	  return false;
+	num_syllables = 0;
+      }
+    }
+    else if (isL (u) || isV (u) || isT (u) || isHangulTone (u))
+      return false;
+  }
+
+  return !num_syllables ||
+	 font->get_nominal_glyphs (num_syllables,
+				   syllables, sizeof (syllables[0]),
+				   glyphs, sizeof (glyphs[0])) == num_syllables;
+}
+
 static bool
 is_zero_width_char (hb_font_t *font,
 		    hb_codepoint_t unicode)
@@ -132,6 +172,9 @@ preprocess_text_hangul (const hb_ot_shape_plan_t *plan HB_UNUSED,
 {
   HB_BUFFER_ALLOCATE_VAR (buffer, hangul_shaping_feature);
 
+  if (is_precomposed_text_supported (buffer, font))
+    return;
+
   /* Hangul syllables come in two shapes: LV, and LVT.  Of those:
    *
    *   - LV can be precomposed, or decomposed.  Lets call those
@@ -429,3 +472,5 @@ const hb_ot_complex_shaper_t _hb_ot_complex_shaper_hangul =
   HB_OT_SHAPE_ZERO_WIDTH_MARKS_NONE,
   false, /* fallback_position */
 };
+
+#endif
@@ -26,6 +26,8 @@
 
 #include "hb-ot-shape-complex.hh"
 
+#ifndef HB_NO_SHAPER_HEBREW
+
 
 static bool
 compose_hebrew (const hb_ot_shape_normalize_context_t *c,
@@ -172,3 +174,5 @@ const hb_ot_complex_shaper_t _hb_ot_complex_shaper_hebrew =
   HB_OT_SHAPE_ZERO_WIDTH_MARKS_BY_GDEF_LATE,
   true, /* fallback_position */
 };
+
+#endif
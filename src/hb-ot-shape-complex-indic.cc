@@ -27,6 +27,9 @@
 #include "hb-ot-shape-complex-indic.hh"
 #include "hb-ot-shape-complex-vowel-constraints.hh"
 #include "hb-ot-layout.hh"
+#include "hb-cache.hh"
+
+#ifndef HB_NO_SHAPER_INDIC
 
 
 /*
@@ -276,6 +279,9 @@ struct indic_shape_plan_t
   bool is_old_spec;
   bool uniscribe_bug_compatible;
   mutable hb_atomic_int_t virama_glyph;
+  /* Consonant glyph -> position, as found by consonant_position_from_face().
+   * Depends only on the face and the virama glyph, both fixed per plan. */
+  mutable hb_cache_t<16, 8, 8> consonant_positions;
 
   would_substitute_feature_t rphf;
   would_substitute_feature_t pref;
@@ -302,6 +308,7 @@ data_create_indic (const hb_ot_shape_plan_t *plan)
   indic_plan->is_old_spec = indic_plan->config->has_old_spec && ((plan->map.chosen_script[0] & 0x000000FFu) != '2');
   indic_plan->uniscribe_bug_compatible = hb_options ().uniscribe_bug_compatible;
   indic_plan->virama_glyph.set_relaxed (-1);
+  indic_plan->consonant_positions.init ();
 
   /* Use zero-context would_substitute() matching for new-spec of the main
    * Indic scripts, and scripts with one spec only, but not for old-specs.
@@ -347,17 +354,24 @@ consonant_position_from_face (const indic_shape_plan_t *indic_plan,
    * 930,94D in 'blwf', not the expected 94D,930 (with new-spec
    * table).  As such, we simply match both sequences.  Seems
    * to work. */
+  unsigned int cached;
+  if (indic_plan->consonant_positions.get (consonant, &cached))
+    return (indic_position_t) cached;
+
+  indic_position_t pos = POS_BASE_C;
   hb_codepoint_t glyphs[3] = {virama, consonant, virama};
   if (indic_plan->blwf.would_substitute (glyphs  , 2, face) ||
       indic_plan->blwf.would_substitute (glyphs+1, 2, face))
-    return POS_BELOW_C;
-  if (indic_plan->pstf.would_substitute (glyphs  , 2, face) ||
-      indic_plan->pstf.would_substitute (glyphs+1, 2, face))
-    return POS_POST_C;
-  if (indic_plan->pref.would_substitute (glyphs  , 2, face) ||
-      indic_plan->pref.would_substitute (glyphs+1, 2, face))
-    return POS_POST_C;
-  return POS_BASE_C;
+    pos = POS_BELOW_C;
+  else if (indic_plan->pstf.would_substitute (glyphs  , 2, face) ||
+	   indic_plan->pstf.would_substitute (glyphs+1, 2, face))
+    pos = POS_POST_C;
+  else if (indic_plan->pref.would_substitute (glyphs  , 2, face) ||
+	   indic_plan->pref.would_substitute (glyphs+1, 2, face))
+    pos = POS_POST_C;
+
+  indic_plan->consonant_positions.set (consonant, pos);
+  return pos;
 }
 
 
@@ -762,6 +776,30 @@ initial_reordering_consonant_syllable (const hb_ot_shape_plan_t *plan,
   }
 
 
+  /* Most syllables are in order already.  Those need no sorting, and no
+   * cluster accounting for it either, unless in old-spec mode. */
+  bool sorted = true;
+  for (unsigned int i = start + 1; i < end; i++)
+    if (info[i - 1].indic_position() > info[i].indic_position())
+    {
+      sorted = false;
+      break;
+    }
+
+  if (sorted)
+  {
+    /* Find base again */
+    base = end;
+    for (unsigned int i = start; i < end; i++)
+      if (info[i].indic_position() == POS_BASE_C)
+      {
+	base = i;
+	break;
+      }
+    if (indic_plan->is_old_spec || end - start > 127)
+      buffer->merge_clusters (base, end);
+  }
+  else
   {
     /* Use syllable() for sort accounting temporarily. */
     unsigned int syllable = info[start].syllable();
@@ -1635,3 +1673,5 @@ const hb_ot_complex_shaper_t _hb_ot_complex_shaper_indic =
   HB_OT_SHAPE_ZERO_WIDTH_MARKS_NONE,
   false, /* fallback_position */
 };
+
+#endif
@@ -27,6 +27,8 @@
 #include "hb-ot-shape-complex-khmer.hh"
 #include "hb-ot-layout.hh"
 
+#ifndef HB_NO_SHAPER_KHMER
+
 
 /*
  * Khmer shaper.
@@ -499,3 +501,5 @@ const hb_ot_complex_shaper_t _hb_ot_complex_shaper_khmer =
   HB_OT_SHAPE_ZERO_WIDTH_MARKS_NONE,
   false, /* fallback_position */
 };
+
+#endif
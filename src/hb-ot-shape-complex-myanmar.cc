@@ -26,6 +26,8 @@
 
 #include "hb-ot-shape-complex-myanmar.hh"
 
+#ifndef HB_NO_SHAPER_MYANMAR
+
 
 /*
  * Myanmar shaper.
@@ -411,3 +413,5 @@ const hb_ot_complex_shaper_t _hb_ot_complex_shaper_myanmar_zawgyi =
   HB_OT_SHAPE_ZERO_WIDTH_MARKS_NONE,
   false, /* fallback_position */
 };
+
+#endif
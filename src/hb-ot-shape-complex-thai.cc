@@ -26,6 +26,8 @@
 
 #include "hb-ot-shape-complex.hh"
 
+#ifndef HB_NO_SHAPER_THAI
+
 
 /* Thai / Lao shaper */
 
@@ -158,6 +160,25 @@ thai_pua_shape (hb_codepoint_t u, thai_action_t action, hb_font_t *font)
   return u;
 }
 
+/* Memoizes thai_pua_shape() results for the duration of one buffer, so each
+ * PUA glyph is probed in the font at most once.  Entry zero means unknown. */
+struct thai_pua_cache_t
+{
+  inline void init (void) { memset (this, 0, sizeof (*this)); }
+
+  inline hb_codepoint_t shape (hb_codepoint_t u, thai_action_t action, hb_font_t *font)
+  {
+    if (action == NOP || (u & ~0x007Fu) != 0x0E00u)
+      return thai_pua_shape (u, action, font);
+    hb_codepoint_t &v = pua[action - 1][u & 0x007Fu];
+    if (!v)
+      v = thai_pua_shape (u, action, font);
+    return v;
+  }
+
+  hb_codepoint_t pua[RD][0x80];
+};
+
 
 static enum thai_above_state_t
 {     /* Cluster above looks like: */
@@ -221,6 +242,8 @@ do_thai_pua_shaping (const hb_ot_shape_plan_t *plan HB_UNUSED,
   thai_above_state_t above_state = thai_above_start_state[NOT_CONSONANT];
   thai_below_state_t below_state = thai_below_start_state[NOT_CONSONANT];
   unsigned int base = 0;
+  bool cache_initialized = false;
+  thai_pua_cache_t cache;
 
   hb_glyph_info_t *info = buffer->info;
   unsigned int count = buffer->len;
@@ -245,10 +268,17 @@ do_thai_pua_shaping (const hb_ot_shape_plan_t *plan HB_UNUSED,
     thai_action_t action = above_edge.action != NOP ? above_edge.action : below_edge.action;
 
     buffer->unsafe_to_break (base, i);
+    if (action == NOP)
+      continue;
+    if (unlikely (!cache_initialized))
+    {
+      cache.init ();
+      cache_initialized = true;
+    }
     if (action == RD)
-      info[base].codepoint = thai_pua_shape (info[base].codepoint, action, font);
+      info[base].codepoint = cache.shape (info[base].codepoint, action, font);
     else
-      info[i].codepoint = thai_pua_shape (info[i].codepoint, action, font);
+      info[i].codepoint = cache.shape (info[i].codepoint, action, font);
   }
 }
 
@@ -313,8 +343,19 @@ preprocess_text_thai (const hb_ot_shape_plan_t *plan,
 #define SARA_AA_FROM_SARA_AM(x) ((x) - 1)
 #define IS_TONE_MARK(x) (hb_in_ranges<hb_codepoint_t> ((x) & ~0x0080u, 0x0E34u, 0x0E37u, 0x0E47u, 0x0E4Eu, 0x0E31u, 0x0E31u))
 
-  buffer->clear_output ();
+  /* Most text has no SARA AM; leave the buffer alone then. */
   unsigned int count = buffer->len;
+  bool has_sara_am = false;
+  for (unsigned int i = 0; i < count; i++)
+    if (unlikely (IS_SARA_AM (buffer->info[i].codepoint)))
+    {
+      has_sara_am = true;
+      break;
+    }
+  if (!has_sara_am)
+    goto pua;
+
+  buffer->clear_output ();
   for (buffer->idx = 0; buffer->idx < count && buffer->successful;)
   {
     hb_codepoint_t u = buffer->cur().codepoint;
@@ -359,6 +400,7 @@ preprocess_text_thai (const hb_ot_shape_plan_t *plan,
   }
   buffer->swap_buffers ();
 
+pua:
   /* If font has Thai GSUB, we are done. */
   if (plan->props.script == HB_SCRIPT_THAI && !plan->map.found_script[0])
     do_thai_pua_shaping (plan, buffer, font);
@@ -381,3 +423,5 @@ const hb_ot_complex_shaper_t _hb_ot_complex_shaper_thai =
   HB_OT_SHAPE_ZERO_WIDTH_MARKS_BY_GDEF_LATE,
   false,/* fallback_position */
 };
+
+#endif
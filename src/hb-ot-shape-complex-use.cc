@@ -30,6 +30,8 @@
 #include "hb-ot-shape-complex-arabic.hh"
 #include "hb-ot-shape-complex-vowel-constraints.hh"
 
+#ifndef HB_NO_SHAPER_USE
+
 /* buffer var allocations */
 #define use_category() complex_var_u8_0()
 
@@ -121,10 +123,6 @@ static void
 reorder (const hb_ot_shape_plan_t *plan,
 	 hb_font_t *font,
 	 hb_buffer_t *buffer);
-static void
-clear_syllables (const hb_ot_shape_plan_t *plan,
-		 hb_font_t *font,
-		 hb_buffer_t *buffer);
 
 static void
 collect_features_use (hb_ot_shape_planner_t *plan)
@@ -143,8 +141,7 @@ collect_features_use (hb_ot_shape_planner_t *plan)
   /* "Reordering group" */
   map->add_gsub_pause (clear_substitution_flags);
   map->add_feature (HB_TAG('r','p','h','f'), F_MANUAL_ZWJ);
-  map->add_gsub_pause (record_rphf);
-  map->add_gsub_pause (clear_substitution_flags);
+  map->add_gsub_pause (record_rphf); /* Also clears substitution flags for pref. */
   map->enable_feature (HB_TAG('p','r','e','f'), F_MANUAL_ZWJ);
   map->add_gsub_pause (record_pref);
 
@@ -152,8 +149,7 @@ collect_features_use (hb_ot_shape_planner_t *plan)
   for (unsigned int i = 0; i < ARRAY_LENGTH (basic_features); i++)
     map->enable_feature (basic_features[i], F_MANUAL_ZWJ);
 
-  map->add_gsub_pause (reorder);
-  map->add_gsub_pause (clear_syllables);
+  map->add_gsub_pause (reorder); /* Also clears syllables. */
 
   /* "Topographical features" */
   for (unsigned int i = 0; i < ARRAY_LENGTH (arabic_features); i++)
@@ -172,6 +168,7 @@ collect_features_use (hb_ot_shape_planner_t *plan)
 struct use_shape_plan_t
 {
   hb_mask_t rphf_mask;
+  hb_mask_t pref_mask;
 
   arabic_shape_plan_t *arabic_plan;
 };
@@ -218,6 +215,7 @@ data_create_use (const hb_ot_shape_plan_t *plan)
     return nullptr;
 
   use_plan->rphf_mask = plan->map.get_1_mask (HB_TAG('r','p','h','f'));
+  use_plan->pref_mask = plan->map.get_1_mask (HB_TAG('p','r','e','f'));
 
   if (has_arabic_joining (plan->props.script))
   {
@@ -281,25 +279,6 @@ setup_masks_use (const hb_ot_shape_plan_t *plan,
     info[i].use_category() = hb_use_get_category (info[i].codepoint);
 }
 
-static void
-setup_rphf_mask (const hb_ot_shape_plan_t *plan,
-		 hb_buffer_t *buffer)
-{
-  const use_shape_plan_t *use_plan = (const use_shape_plan_t *) plan->data;
-
-  hb_mask_t mask = use_plan->rphf_mask;
-  if (!mask) return;
-
-  hb_glyph_info_t *info = buffer->info;
-
-  foreach_syllable (buffer, start, end)
-  {
-    unsigned int limit = info[start].use_category() == USE_R ? 1 : MIN (3u, end - start);
-    for (unsigned int i = start; i < start + limit; i++)
-      info[i].mask |= mask;
-  }
-}
-
 static void
 setup_topographical_masks (const hb_ot_shape_plan_t *plan,
 			   hb_buffer_t *buffer)
@@ -369,18 +348,39 @@ setup_syllables (const hb_ot_shape_plan_t *plan,
 		 hb_font_t *font HB_UNUSED,
 		 hb_buffer_t *buffer)
 {
+  const use_shape_plan_t *use_plan = (const use_shape_plan_t *) plan->data;
+  hb_mask_t rphf_mask = use_plan->rphf_mask;
+
   find_syllables (buffer);
+
+  /* Set up the rphf mask in the same pass. */
+  hb_glyph_info_t *info = buffer->info;
   foreach_syllable (buffer, start, end)
+  {
     buffer->unsafe_to_break (start, end);
-  setup_rphf_mask (plan, buffer);
+
+    if (rphf_mask)
+    {
+      unsigned int limit = info[start].use_category() == USE_R ? 1 : MIN (3u, end - start);
+      for (unsigned int i = start; i < start + limit; i++)
+	info[i].mask |= rphf_mask;
+    }
+  }
+
   setup_topographical_masks (plan, buffer);
 }
 
 static void
-clear_substitution_flags (const hb_ot_shape_plan_t *plan HB_UNUSED,
+clear_substitution_flags (const hb_ot_shape_plan_t *plan,
 			  hb_font_t *font HB_UNUSED,
 			  hb_buffer_t *buffer)
 {
+  /* Only record_rphf and record_pref look at the flags, and record_rphf
+   * clears them again before pref. */
+  const use_shape_plan_t *use_plan = (const use_shape_plan_t *) plan->data;
+  if (!use_plan->rphf_mask)
+    return;
+
   hb_glyph_info_t *info = buffer->info;
   unsigned int count = buffer->len;
   for (unsigned int i = 0; i < count; i++)
@@ -395,7 +395,9 @@ record_rphf (const hb_ot_shape_plan_t *plan,
   const use_shape_plan_t *use_plan = (const use_shape_plan_t *) plan->data;
 
   hb_mask_t mask = use_plan->rphf_mask;
-  if (!mask) return;
+  /* Without a pref feature, nobody looks at substitution flags anymore. */
+  bool clear = use_plan->pref_mask;
+  if (!mask && !clear) return;
   hb_glyph_info_t *info = buffer->info;
 
   foreach_syllable (buffer, start, end)
@@ -407,14 +409,21 @@ record_rphf (const hb_ot_shape_plan_t *plan,
 	info[i].use_category() = USE_R;
 	break;
       }
+
+    /* Clear substitution flags before pref. */
+    if (clear)
+      for (unsigned int i = start; i < end; i++)
+	_hb_glyph_info_clear_substituted (&info[i]);
   }
 }
 
 static void
-record_pref (const hb_ot_shape_plan_t *plan HB_UNUSED,
+record_pref (const hb_ot_shape_plan_t *plan,
 	     hb_font_t *font HB_UNUSED,
 	     hb_buffer_t *buffer)
 {
+  const use_shape_plan_t *use_plan = (const use_shape_plan_t *) plan->data;
+  if (!use_plan->pref_mask) return;
   hb_glyph_info_t *info = buffer->info;
 
   foreach_syllable (buffer, start, end)
@@ -580,21 +589,18 @@ reorder (const hb_ot_shape_plan_t *plan,
 {
   insert_dotted_circles (plan, font, buffer);
 
+  hb_glyph_info_t *info = buffer->info;
   foreach_syllable (buffer, start, end)
+  {
     reorder_syllable (buffer, start, end);
 
-  HB_BUFFER_DEALLOCATE_VAR (buffer, use_category);
-}
+    /* Syllables are not needed anymore; clearing them here saves a pass.
+     * foreach_syllable already computed end. */
+    for (unsigned int i = start; i < end; i++)
+      info[i].syllable() = 0;
+  }
 
-static void
-clear_syllables (const hb_ot_shape_plan_t *plan HB_UNUSED,
-		 hb_font_t *font HB_UNUSED,
-		 hb_buffer_t *buffer)
-{
-  hb_glyph_info_t *info = buffer->info;
-  unsigned int count = buffer->len;
-  for (unsigned int i = 0; i < count; i++)
-    info[i].syllable() = 0;
+  HB_BUFFER_DEALLOCATE_VAR (buffer, use_category);
 }
 
 
@@ -637,3 +643,5 @@ const hb_ot_complex_shaper_t _hb_ot_complex_shaper_use =
   HB_OT_SHAPE_ZERO_WIDTH_MARKS_BY_GDEF_EARLY,
   false, /* fallback_position */
 };
+
+#endif
@@ -18,6 +18,13 @@
 static void
 _output_dotted_circle (hb_buffer_t *buffer)
 {
+  /* Most text needs no dotted circle, so the output buffer is only started
+   * once one is due; everything before idx is kept in place. */
+  if (!buffer->have_output)
+  {
+    buffer->clear_output ();
+    buffer->out_len = buffer->idx;
+  }
   hb_glyph_info_t &dottedcircle = buffer->output_glyph (0x25CCu);
   _hb_glyph_info_reset_continuation (&dottedcircle);
 }
@@ -41,7 +48,6 @@ _hb_preprocess_text_vowel_constraints (const hb_ot_shape_plan_t *plan HB_UNUSED,
    * https://github.com/harfbuzz/harfbuzz/issues/1019
    */
   bool processed = false;
-  buffer->clear_output ();
   unsigned int count = buffer->len;
   switch ((unsigned) buffer->props.script)
   {
@@ -428,9 +434,14 @@ _hb_preprocess_text_vowel_constraints (const hb_ot_shape_plan_t *plan HB_UNUSED,
   }
   if (processed)
   {
-    if (buffer->idx < count)
-      buffer->next_glyph ();
-    buffer->swap_buffers ();
+    if (buffer->have_output)
+    {
+      if (buffer->idx < count)
+	buffer->next_glyph ();
+      buffer->swap_buffers ();
+    }
+    else
+      buffer->idx = 0;
   }
 }
 
@@ -171,6 +171,34 @@ struct hb_ot_complex_shaper_t
 HB_COMPLEX_SHAPERS_IMPLEMENT_SHAPERS
 #undef HB_COMPLEX_SHAPER_IMPLEMENT
 
+/* Shapers compiled out, see hb-config.hh, leave their scripts to the
+ * default one. */
+#ifdef HB_NO_SHAPER_ARABIC
+#define _hb_ot_complex_shaper_arabic _hb_ot_complex_shaper_default
+#endif
+#ifdef HB_NO_SHAPER_HANGUL
+#define _hb_ot_complex_shaper_hangul _hb_ot_complex_shaper_default
+#endif
+#ifdef HB_NO_SHAPER_HEBREW
+#define _hb_ot_complex_shaper_hebrew _hb_ot_complex_shaper_default
+#endif
+#ifdef HB_NO_SHAPER_INDIC
+#define _hb_ot_complex_shaper_indic _hb_ot_complex_shaper_default
+#endif
+#ifdef HB_NO_SHAPER_KHMER
+#define _hb_ot_complex_shaper_khmer _hb_ot_complex_shaper_default
+#endif
+#ifdef HB_NO_SHAPER_MYANMAR
+#define _hb_ot_complex_shaper_myanmar _hb_ot_complex_shaper_default
+#define _hb_ot_complex_shaper_myanmar_zawgyi _hb_ot_complex_shaper_default
+#endif
+#ifdef HB_NO_SHAPER_THAI
+#define _hb_ot_complex_shaper_thai _hb_ot_complex_shaper_default
+#endif
+#ifdef HB_NO_SHAPER_USE
+#define _hb_ot_complex_shaper_use _hb_ot_complex_shaper_default
+#endif
+
 
 static inline const hb_ot_complex_shaper_t *
 hb_ot_shape_complex_categorize (const hb_ot_shape_planner_t *planner)
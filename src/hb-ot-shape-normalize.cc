@@ -212,6 +212,31 @@ decompose_current_character (const hb_ot_shape_normalize_context_t *c, bool shor
   next_char (buffer, glyph); /* glyph is initialized in earlier branches. */
 }
 
+/* Same as calling decompose_current_character() up to end, but when
+ * shortest, the characters that map to a glyph directly are looked up
+ * with one get_nominal_glyphs() call per run of them. */
+static inline void
+decompose_current_run (const hb_ot_shape_normalize_context_t *c, unsigned int end, bool shortest)
+{
+  hb_buffer_t * const buffer = c->buffer;
+  while (buffer->idx < end && buffer->successful)
+  {
+    if (shortest)
+    {
+      unsigned int done = c->font->get_nominal_glyphs (end - buffer->idx,
+						       &buffer->cur().codepoint,
+						       sizeof (buffer->info[0]),
+						       &buffer->cur().glyph_index(),
+						       sizeof (buffer->info[0]));
+      buffer->next_glyphs (done);
+      if (buffer->idx == end || !buffer->successful)
+	break;
+    }
+    /* Doesn't map, or not shortest. */
+    decompose_current_character (c, shortest);
+  }
+}
+
 static inline void
 handle_variation_selector_cluster (const hb_ot_shape_normalize_context_t *c,
 				   unsigned int end,
@@ -262,8 +287,7 @@ decompose_multi_char_cluster (const hb_ot_shape_normalize_context_t *c, unsigned
       return;
     }
 
-  while (buffer->idx < end && buffer->successful)
-    decompose_current_character (c, short_circuit);
+  decompose_current_run (c, end, short_circuit);
 }
 
 
@@ -312,6 +336,25 @@ _hb_ot_shape_normalize (const hb_ot_shape_plan_t *plan,
 			      mode != HB_OT_SHAPE_NORMALIZATION_MODE_COMPOSED_DIACRITICS_NO_SHORT_CIRCUIT);
   unsigned int count;
 
+  /* Fast path: if there are no marks and the font maps every character
+   * directly, the rounds below would only look up the same nominal glyphs,
+   * one run at a time.  Do that in one call, in place.  Common for Latin and
+   * CJK text, and for text that came from an NFC source. */
+  if (might_short_circuit)
+  {
+    count = buffer->len;
+    hb_glyph_info_t *info = buffer->info;
+    unsigned int i;
+    for (i = 0; i < count; i++)
+      if (unlikely (HB_UNICODE_GENERAL_CATEGORY_IS_MARK (_hb_glyph_info_get_general_category (&info[i]))))
+	break;
+    if (i == count &&
+	font->get_nominal_glyphs (count,
+				  &info[0].codepoint, sizeof (info[0]),
+				  &info[0].glyph_index(), sizeof (info[0])) == count)
+      return;
+  }
+
   /* We do a fairly straightforward yet custom normalization process in three
    * separate rounds: decompose, reorder, recompose (if desired).  Currently
    * this makes two buffer swaps.  We can make it faster by moving the last
@@ -337,17 +380,7 @@ _hb_ot_shape_normalize (const hb_ot_shape_plan_t *plan,
 	end--; /* Leave one base for the marks to cluster with. */
 
       /* From idx to end are simple clusters. */
-      if (might_short_circuit)
-      {
-        unsigned int done = font->get_nominal_glyphs (end - buffer->idx,
-						      &buffer->cur().codepoint,
-						      sizeof (buffer->info[0]),
-						      &buffer->cur().glyph_index(),
-						      sizeof (buffer->info[0]));
-	buffer->next_glyphs (done);
-      }
-      while (buffer->idx < end && buffer->successful)
-	decompose_current_character (&c, might_short_circuit);
+      decompose_current_run (&c, end, might_short_circuit);
 
       if (buffer->idx == count || !buffer->successful)
 	break;
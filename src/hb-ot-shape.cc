@@ -56,8 +56,11 @@ hb_ot_shape_collect_features (hb_ot_shape_planner_t          *planner,
 			      unsigned int                    num_user_features);
 
 static bool
-_hb_apply_morx (hb_face_t *face)
+_hb_apply_morx (hb_face_t *face HB_UNUSED)
 {
+#ifdef HB_NO_AAT
+  return false;
+#else
   if (hb_options ().aat &&
       hb_aat_layout_has_substitution (face))
     return true;
@@ -68,6 +71,7 @@ _hb_apply_morx (hb_face_t *face)
 					       HB_OT_TAG_GSUB,
 					       0, nullptr, nullptr)) &&
 	 hb_aat_layout_has_substitution (face);
+#endif
 }
 
 hb_ot_shape_planner_t::hb_ot_shape_planner_t (hb_face_t                     *face,
@@ -94,8 +98,10 @@ hb_ot_shape_planner_t::compile (hb_ot_shape_plan_t           &plan,
   plan.props = props;
   plan.shaper = shaper;
   map.compile (plan.map, key);
+#ifndef HB_NO_AAT
   if (apply_morx)
     aat_map.compile (plan.aat_map);
+#endif
 
   plan.frac_mask = plan.map.get_1_mask (HB_TAG ('f','r','a','c'));
   plan.numr_mask = plan.map.get_1_mask (HB_TAG ('n','u','m','r'));
@@ -130,6 +136,13 @@ hb_ot_shape_planner_t::compile (hb_ot_shape_plan_t           &plan,
    * Decide who does positioning. GPOS, kerx, kern, or fallback.
    */
 
+#ifdef HB_NO_AAT
+  if (!disable_gpos && hb_ot_layout_has_positioning (face))
+    plan.apply_gpos = true;
+
+  if (!has_gpos_kern && hb_ot_layout_has_kerning (face))
+    plan.apply_kern = true;
+#else
   if (hb_options ().aat && hb_aat_layout_has_positioning (face))
     plan.apply_kerx = true;
   else if (!apply_morx && !disable_gpos && hb_ot_layout_has_positioning (face))
@@ -145,6 +158,7 @@ hb_ot_shape_planner_t::compile (hb_ot_shape_plan_t           &plan,
     else if (hb_ot_layout_has_kerning (face))
       plan.apply_kern = true;
   }
+#endif
 
   plan.zero_marks = script_zero_marks &&
 		    !plan.apply_kerx &&
@@ -158,16 +172,110 @@ hb_ot_shape_planner_t::compile (hb_ot_shape_plan_t           &plan,
   plan.fallback_mark_positioning = plan.adjust_mark_positioning_when_zeroing &&
 				   script_fallback_mark_positioning;
 
+#ifndef HB_NO_AAT
   /* Currently we always apply trak. */
   plan.apply_trak = plan.requested_tracking && hb_aat_layout_has_tracking (face);
+#endif
+}
+
+/* The plan's bit fields, in the order serialize () stores them. */
+#define HB_OT_SHAPE_PLAN_FLAGS \
+  HB_OT_SHAPE_PLAN_FLAG (requested_kerning) \
+  HB_OT_SHAPE_PLAN_FLAG (requested_tracking) \
+  HB_OT_SHAPE_PLAN_FLAG (has_frac) \
+  HB_OT_SHAPE_PLAN_FLAG (has_gpos_mark) \
+  HB_OT_SHAPE_PLAN_FLAG (zero_marks) \
+  HB_OT_SHAPE_PLAN_FLAG (fallback_glyph_classes) \
+  HB_OT_SHAPE_PLAN_FLAG (fallback_mark_positioning) \
+  HB_OT_SHAPE_PLAN_FLAG (adjust_mark_positioning_when_zeroing) \
+  HB_OT_SHAPE_PLAN_FLAG (apply_gpos) \
+  HB_OT_SHAPE_PLAN_FLAG (apply_kerx) \
+  HB_OT_SHAPE_PLAN_FLAG (apply_kern) \
+  HB_OT_SHAPE_PLAN_FLAG (apply_morx) \
+  HB_OT_SHAPE_PLAN_FLAG (apply_trak)
+
+bool
+hb_ot_shape_planner_t::deserialize (hb_ot_shape_plan_t &plan,
+				    hb_plan_reader_t   *r)
+{
+  plan.props = props;
+  plan.shaper = shaper;
+  if (!map.deserialize (plan.map, r) ||
+      !r->read_array (plan.aat_map.chain_flags) ||
+      !r->read_array (plan.aat_map.subtable_digests))
+    return false;
+
+  hb_mask_t masks[6];
+  unsigned int flags;
+  if (!r->read (&masks) || !r->read (&flags))
+    return false;
+  plan.frac_mask = masks[0];
+  plan.numr_mask = masks[1];
+  plan.dnom_mask = masks[2];
+  plan.rtlm_mask = masks[3];
+  plan.kern_mask = masks[4];
+  plan.trak_mask = masks[5];
+
+  unsigned int bit = 0;
+#define HB_OT_SHAPE_PLAN_FLAG(name) plan.name = (flags >> bit++) & 1;
+  HB_OT_SHAPE_PLAN_FLAGS
+#undef HB_OT_SHAPE_PLAN_FLAG
+
+  /* The shaper was chosen for this; they must agree. */
+  return plan.apply_morx == apply_morx;
+}
+
+void
+hb_ot_shape_plan_t::serialize (hb_plan_writer_t *w) const
+{
+  map.serialize (w);
+  w->write_array (aat_map.chain_flags);
+  w->write_array (aat_map.subtable_digests);
+
+  hb_mask_t masks[6] = {frac_mask, numr_mask, dnom_mask, rtlm_mask, kern_mask, trak_mask};
+  w->write (masks);
+
+  unsigned int flags = 0, bit = 0;
+#define HB_OT_SHAPE_PLAN_FLAG(name) flags |= (unsigned int) name << bit++;
+  HB_OT_SHAPE_PLAN_FLAGS
+#undef HB_OT_SHAPE_PLAN_FLAG
+  w->write (flags);
+}
+
+/* The tables shaping reads, prefetched before planning starts reading
+ * them if the face asks for it; see hb_face_set_prefetch_on_plan(). */
+static void
+hb_ot_shape_prefetch_tables (hb_face_t                     *face,
+			     const hb_segment_properties_t *props)
+{
+  bool vertical = HB_DIRECTION_IS_VERTICAL (props->direction);
+  const hb_tag_t tags[] = {
+    HB_TAG ('c','m','a','p'),
+    vertical ? HB_TAG ('v','h','e','a') : HB_TAG ('h','h','e','a'),
+    vertical ? HB_TAG ('v','m','t','x') : HB_TAG ('h','m','t','x'),
+    HB_OT_TAG_GDEF,
+    HB_OT_TAG_GSUB,
+    HB_OT_TAG_GPOS,
+    HB_TAG ('k','e','r','n'),
+    HB_TAG ('m','o','r','x'),
+    HB_TAG ('k','e','r','x'),
+    HB_TAG ('t','r','a','k'),
+    HB_TAG ('a','n','k','r'),
+  };
+  hb_face_prefetch_tables (face, tags, ARRAY_LENGTH (tags));
 }
 
 bool
 hb_ot_shape_plan_t::init0 (hb_face_t                     *face,
-			   const hb_shape_plan_key_t     *key)
+			   const hb_shape_plan_key_t     *key,
+			   hb_plan_reader_t              *reader)
 {
   map.init ();
   aat_map.init ();
+  lookup_profile.init ();
+
+  if (unlikely (face->prefetch_on_plan))
+    hb_ot_shape_prefetch_tables (face, &key->props);
 
   hb_ot_shape_planner_t planner (face,
 				 &key->props);
@@ -176,7 +284,17 @@ hb_ot_shape_plan_t::init0 (hb_face_t                     *face,
 				key->user_features,
 				key->num_user_features);
 
-  planner.compile (*this, key->ot);
+  if (reader)
+  {
+    if (unlikely (!planner.deserialize (*this, reader)))
+    {
+      map.fini ();
+      aat_map.fini ();
+      return false;
+    }
+  }
+  else
+    planner.compile (*this, key->ot);
 
   if (shaper->data_create)
   {
@@ -188,6 +306,18 @@ hb_ot_shape_plan_t::init0 (hb_face_t                     *face,
   return true;
 }
 
+static void
+destroy_lookup_profile (hb_ot_lookup_profile_t *profile)
+{
+  if (!profile)
+    return;
+
+  profile->lock.fini ();
+  for (unsigned int table_index = 0; table_index < 2; table_index++)
+    profile->stats[table_index].fini ();
+  free (profile);
+}
+
 void
 hb_ot_shape_plan_t::fini ()
 {
@@ -196,15 +326,71 @@ hb_ot_shape_plan_t::fini ()
 
   map.fini ();
   aat_map.fini ();
+
+  destroy_lookup_profile (lookup_profile.get ());
+}
+
+bool
+hb_ot_shape_plan_t::set_lookup_profiling (bool enabled) const
+{
+retry:
+  hb_ot_lookup_profile_t *profile = lookup_profile.get ();
+  if (!profile)
+  {
+    if (!enabled)
+      return true;
+
+    profile = (hb_ot_lookup_profile_t *) calloc (1, sizeof (hb_ot_lookup_profile_t));
+    if (unlikely (!profile))
+      return false;
+    profile->lock.init ();
+    for (unsigned int table_index = 0; table_index < 2; table_index++)
+      profile->stats[table_index].init ();
+    if (unlikely (!profile->stats[0].resize (map.get_lookup_count (0)) ||
+		  !profile->stats[1].resize (map.get_lookup_count (1))))
+    {
+      destroy_lookup_profile (profile);
+      return false;
+    }
+
+    if (unlikely (!lookup_profile.cmpexch (nullptr, profile)))
+    {
+      destroy_lookup_profile (profile);
+      goto retry;
+    }
+  }
+
+  profile->enabled.set_relaxed (enabled);
+  return true;
+}
+
+void
+hb_ot_shape_plan_t::add_lookup_stats (unsigned int table_index,
+				      const hb_ot_map_t::lookup_stats_t *stats) const
+{
+  hb_ot_lookup_profile_t *profile = lookup_profile.get ();
+  if (unlikely (!profile))
+    return;
+
+  hb_lock_t l (profile->lock);
+  unsigned int count = profile->stats[table_index].length;
+  for (unsigned int i = 0; i < count; i++)
+    profile->stats[table_index][i].add (stats[i]);
 }
 
 void
 hb_ot_shape_plan_t::substitute (hb_font_t   *font,
 				hb_buffer_t *buffer) const
 {
+#ifndef HB_NO_AAT
   if (unlikely (apply_morx))
+  {
+    uint64_t start = buffer->trace_start ();
     hb_aat_layout_substitute (this, font, buffer);
+    buffer->trace (font, HB_BUFFER_TRACE_EVENT_MORX, 0, start);
+  }
   else
+#endif
     map.substitute (this, font, buffer);
 }
 
@@ -214,15 +400,23 @@ hb_ot_shape_plan_t::position (hb_font_t   *font,
 {
   if (this->apply_gpos)
     map.position (this, font, buffer);
+#ifndef HB_NO_AAT
   else if (this->apply_kerx)
     hb_aat_layout_position (this, font, buffer);
+#endif
   else if (this->apply_kern)
     hb_ot_layout_kern (this, font, buffer);
   else
+  {
+    uint64_t start = buffer->trace_start ();
     _hb_ot_shape_fallback_kern (this, font, buffer);
+    buffer->trace (font, HB_BUFFER_TRACE_EVENT_FALLBACK_POSITION, 0, start);
+  }
 
+#ifndef HB_NO_AAT
   if (this->apply_trak)
     hb_aat_layout_track (this, font, buffer);
+#endif
 }
 
 
@@ -318,6 +512,7 @@ hb_ot_shape_collect_features (hb_ot_shape_planner_t          *planner,
 		      feature->value);
   }
 
+#ifndef HB_NO_AAT
   if (planner->apply_morx)
   {
     hb_aat_map_builder_t *aat_map = &planner->aat_map;
@@ -327,6 +522,7 @@ hb_ot_shape_collect_features (hb_ot_shape_planner_t          *planner,
       aat_map->add_feature (feature->tag, feature->value);
     }
   }
+#endif
 
   if (planner->shaper->override_features)
     planner->shaper->override_features (planner);
@@ -337,17 +533,26 @@ hb_ot_shape_collect_features (hb_ot_shape_planner_t          *planner,
  * shaper face data
  */
 
-struct hb_ot_face_data_t {};
-
 hb_ot_face_data_t *
-_hb_ot_shaper_face_data_create (hb_face_t *face)
+_hb_ot_shaper_face_data_create (hb_face_t *face HB_UNUSED)
 {
-  return (hb_ot_face_data_t *) HB_SHAPER_DATA_SUCCEEDED;
+  hb_ot_face_data_t *data = (hb_ot_face_data_t *) calloc (1, sizeof (hb_ot_face_data_t));
+  if (unlikely (!data))
+    return nullptr;
+
+  data->arabic_fallback_lookups.init ();
+  return data;
 }
 
 void
 _hb_ot_shaper_face_data_destroy (hb_ot_face_data_t *data)
 {
+#ifndef HB_NO_SHAPER_ARABIC
+  arabic_fallback_lookups_t *lookups = data->arabic_fallback_lookups.get ();
+  if (lookups)
+    _hb_ot_shape_complex_arabic_fallback_lookups_destroy (lookups);
+#endif
+  free (data);
 }
 
 
@@ -393,41 +598,73 @@ struct hb_ot_shape_context_t
 
 /* Prepare */
 
+static inline void
+hb_set_unicode_props_and_mask (hb_glyph_info_t *info,
+			       hb_buffer_t *buffer,
+			       hb_mask_t global_mask,
+			       const hb_unicode_props_t *uprops)
+{
+  info->mask = global_mask;
+  _hb_glyph_info_set_unicode_props (info, buffer, uprops);
+
+  /* Marks, and with them keycaps and emoji variation selectors, are
+   * already set as continuation by the above line.  Handle
+   * Emoji_Modifier, flags and ZWJ sequences.  The latter two look back at
+   * the previous glyph, whose props are final by now. */
+  if (unlikely (_hb_glyph_info_get_general_category (info) == HB_UNICODE_GENERAL_CATEGORY_MODIFIER_SYMBOL &&
+		hb_in_range<hb_codepoint_t> (info->codepoint, 0x1F3FBu, 0x1F3FFu)))
+    _hb_glyph_info_set_continuation (info);
+  /* Regional indicators pair up into flags. */
+  else if (unlikely (hb_in_range<hb_codepoint_t> (info->codepoint, 0x1F1E6u, 0x1F1FFu)))
+  {
+    if (info != buffer->info &&
+	hb_in_range<hb_codepoint_t> (info[-1].codepoint, 0x1F1E6u, 0x1F1FFu) &&
+	!_hb_glyph_info_is_continuation (info - 1))
+      _hb_glyph_info_set_continuation (info);
+  }
+  /* ZWJ is default-ignorable, so there is none until the buffer has had
+   * one of those; most text never gets past this. */
+  else if (likely (!(buffer->scratch_flags & HB_BUFFER_SCRATCH_FLAG_HAS_DEFAULT_IGNORABLES)))
+    return;
+  else if (unlikely (_hb_glyph_info_is_zwj (info)))
+    _hb_glyph_info_set_continuation (info);
+  else if (unlikely (info != buffer->info &&
+		     _hb_glyph_info_is_zwj (info - 1) &&
+		     _hb_unicode_is_emoji_Extended_Pictographic (info->codepoint)))
+    _hb_glyph_info_set_continuation (info);
+}
+
+/* Sets the initial masks and the Unicode properties of every glyph, in a
+ * single traversal of the buffer. */
 static void
-hb_set_unicode_props (hb_buffer_t *buffer)
+hb_set_unicode_props (hb_buffer_t *buffer, hb_mask_t global_mask)
 {
   /* Implement enough of Unicode Graphemes here that shaping
    * in reverse-direction wouldn't break graphemes.  Namely,
    * we mark all marks and ZWJ and ZWJ,Extended_Pictographic
-   * sequences as continuations.  The foreach_grapheme()
-   * macro uses this bit.
+   * sequences as continuations, and the second of each pair
+   * of regional indicators, so that a flag makes one grapheme.
+   * The foreach_grapheme() macro uses this bit.
    *
    * https://www.unicode.org/reports/tr29/#Regex_Definitions
    */
   unsigned int count = buffer->len;
   hb_glyph_info_t *info = buffer->info;
-  for (unsigned int i = 0; i < count; i++)
+  hb_unicode_funcs_t *unicode = buffer->unicode;
+  if (!unicode->has_props_func ())
   {
-    _hb_glyph_info_set_unicode_props (&info[i], buffer);
+    for (unsigned int i = 0; i < count; i++)
+      hb_set_unicode_props_and_mask (&info[i], buffer, global_mask, nullptr);
+    return;
+  }
 
-    /* Marks are already set as continuation by the above line.
-     * Handle Emoji_Modifier and ZWJ-continuation. */
-    if (unlikely (_hb_glyph_info_get_general_category (&info[i]) == HB_UNICODE_GENERAL_CATEGORY_MODIFIER_SYMBOL &&
-		  hb_in_range<hb_codepoint_t> (info[i].codepoint, 0x1F3FBu, 0x1F3FFu)))
-    {
-	_hb_glyph_info_set_continuation (&info[i]);
-    }
-    else if (unlikely (_hb_glyph_info_is_zwj (&info[i])))
-    {
-      _hb_glyph_info_set_continuation (&info[i]);
-      if (i + 1 < count &&
-	  _hb_unicode_is_emoji_Extended_Pictographic (info[i + 1].codepoint))
-      {
-        i++;
-	_hb_glyph_info_set_unicode_props (&info[i], buffer);
-	_hb_glyph_info_set_continuation (&info[i]);
-      }
-    }
+  hb_unicode_props_t uprops[64];
+  for (unsigned int start = 0; start < count; start += ARRAY_LENGTH (uprops))
+  {
+    unsigned int n = MIN<unsigned int> (count - start, ARRAY_LENGTH (uprops));
+    unicode->props (n, &info[start].codepoint, sizeof (hb_glyph_info_t), uprops);
+    for (unsigned int i = 0; i < n; i++)
+      hb_set_unicode_props_and_mask (&info[start + i], buffer, global_mask, &uprops[i]);
   }
 }
 
@@ -445,17 +682,16 @@ hb_insert_dotted_circle (hb_buffer_t *buffer, hb_font_t *font)
   hb_glyph_info_t dottedcircle = {0};
   dottedcircle.codepoint = 0x25CCu;
   _hb_glyph_info_set_unicode_props (&dottedcircle, buffer);
+  dottedcircle.cluster = buffer->info[0].cluster;
+  dottedcircle.mask = buffer->info[0].mask;
 
-  buffer->clear_output ();
-
-  buffer->idx = 0;
-  hb_glyph_info_t info = dottedcircle;
-  info.cluster = buffer->cur().cluster;
-  info.mask = buffer->cur().mask;
-  buffer->output_info (info);
-  while (buffer->idx < buffer->len && buffer->successful)
-    buffer->next_glyph ();
-  buffer->swap_buffers ();
+  /* Only the first glyph moves, so shift the buffer up by one in place
+   * rather than copying it all through the output buffer. */
+  if (unlikely (!buffer->ensure (buffer->len + 1)))
+    return;
+  memmove (buffer->info + 1, buffer->info, buffer->len * sizeof (buffer->info[0]));
+  buffer->info[0] = dottedcircle;
+  buffer->len++;
 }
 
 static void
@@ -472,8 +708,8 @@ hb_form_clusters (hb_buffer_t *buffer)
       buffer->unsafe_to_break (start, end);
 }
 
-static void
-hb_ensure_native_direction (hb_buffer_t *buffer)
+static bool
+hb_is_native_direction (const hb_buffer_t *buffer)
 {
   hb_direction_t direction = buffer->props.direction;
   hb_direction_t horiz_dir = hb_script_get_horizontal_direction (buffer->props.script);
@@ -482,10 +718,16 @@ hb_ensure_native_direction (hb_buffer_t *buffer)
    * The only BTT vertical script is Ogham, but it's not clear to me whether OpenType
    * Ogham fonts are supposed to be implemented BTT or not.  Need to research that
    * first. */
-  if ((HB_DIRECTION_IS_HORIZONTAL (direction) &&
-       direction != horiz_dir && horiz_dir != HB_DIRECTION_INVALID) ||
-      (HB_DIRECTION_IS_VERTICAL   (direction) &&
-       direction != HB_DIRECTION_TTB))
+  return !((HB_DIRECTION_IS_HORIZONTAL (direction) &&
+	    direction != horiz_dir && horiz_dir != HB_DIRECTION_INVALID) ||
+	   (HB_DIRECTION_IS_VERTICAL   (direction) &&
+	    direction != HB_DIRECTION_TTB));
+}
+
+static void
+hb_ensure_native_direction (hb_buffer_t *buffer)
+{
+  if (!hb_is_native_direction (buffer))
   {
 
     if (buffer->cluster_level == HB_BUFFER_CLUSTER_LEVEL_MONOTONE_CHARACTERS)
@@ -520,9 +762,28 @@ hb_ot_mirror_chars (const hb_ot_shape_context_t *c)
   hb_unicode_funcs_t *unicode = buffer->unicode;
   hb_mask_t rtlm_mask = c->plan->rtlm_mask;
 
+  /* With the built-in Unicode functions, the only BMP characters that
+   * mirror are brackets, quotation marks and symbols.  Use the general
+   * category the props pass cached to skip mirroring lookups for the
+   * letters and marks that make up most of a right-to-left paragraph. */
+  bool by_category = unicode->has_props_func ();
+  const unsigned int mirrored_categories =
+    FLAG (HB_UNICODE_GENERAL_CATEGORY_OPEN_PUNCTUATION) |
+    FLAG (HB_UNICODE_GENERAL_CATEGORY_CLOSE_PUNCTUATION) |
+    FLAG (HB_UNICODE_GENERAL_CATEGORY_INITIAL_PUNCTUATION) |
+    FLAG (HB_UNICODE_GENERAL_CATEGORY_FINAL_PUNCTUATION) |
+    FLAG (HB_UNICODE_GENERAL_CATEGORY_MATH_SYMBOL) |
+    FLAG (HB_UNICODE_GENERAL_CATEGORY_OTHER_SYMBOL);
+
   unsigned int count = buffer->len;
   hb_glyph_info_t *info = buffer->info;
   for (unsigned int i = 0; i < count; i++) {
+    if (by_category && info[i].codepoint < 0x10000u &&
+	!(FLAG_UNSAFE (_hb_glyph_info_get_general_category (&info[i])) & mirrored_categories))
+    {
+      info[i].mask |= rtlm_mask;
+      continue;
+    }
     hb_codepoint_t codepoint = unicode->mirroring (info[i].codepoint);
     if (likely (codepoint == info[i].codepoint || !c->font->has_glyph (codepoint)))
       info[i].mask |= rtlm_mask;
@@ -581,16 +842,6 @@ hb_ot_shape_setup_masks_fraction (const hb_ot_shape_context_t *c)
   }
 }
 
-static inline void
-hb_ot_shape_initialize_masks (const hb_ot_shape_context_t *c)
-{
-  hb_ot_map_t *map = &c->plan->map;
-  hb_buffer_t *buffer = c->buffer;
-
-  hb_mask_t global_mask = map->get_global_mask ();
-  buffer->reset_masks (global_mask);
-}
-
 static inline void
 hb_ot_shape_setup_masks (const hb_ot_shape_context_t *c)
 {
@@ -613,23 +864,6 @@ hb_ot_shape_setup_masks (const hb_ot_shape_context_t *c)
   }
 }
 
-static void
-hb_ot_zero_width_default_ignorables (const hb_buffer_t *buffer)
-{
-  if (!(buffer->scratch_flags & HB_BUFFER_SCRATCH_FLAG_HAS_DEFAULT_IGNORABLES) ||
-      (buffer->flags & HB_BUFFER_FLAG_PRESERVE_DEFAULT_IGNORABLES) ||
-      (buffer->flags & HB_BUFFER_FLAG_REMOVE_DEFAULT_IGNORABLES))
-    return;
-
-  unsigned int count = buffer->len;
-  hb_glyph_info_t *info = buffer->info;
-  hb_glyph_position_t *pos = buffer->pos;
-  unsigned int i = 0;
-  for (i = 0; i < count; i++)
-    if (unlikely (_hb_glyph_info_is_default_ignorable (&info[i])))
-      pos[i].x_advance = pos[i].y_advance = pos[i].x_offset = pos[i].y_offset = 0;
-}
-
 static void
 hb_ot_hide_default_ignorables (hb_buffer_t *buffer,
 			       hb_font_t   *font)
@@ -704,7 +938,9 @@ hb_ot_substitute_default (const hb_ot_shape_context_t *c)
 
   HB_BUFFER_ALLOCATE_VAR (buffer, glyph_index);
 
+  uint64_t start = buffer->trace_start ();
   _hb_ot_shape_normalize (c->plan, buffer, c->font);
+  buffer->trace (c->font, HB_BUFFER_TRACE_EVENT_NORMALIZE, 0, start);
 
   hb_ot_shape_setup_masks (c);
 
@@ -744,8 +980,10 @@ static inline void
 hb_ot_substitute_post (const hb_ot_shape_context_t *c)
 {
   hb_ot_hide_default_ignorables (c->buffer, c->font);
+#ifndef HB_NO_AAT
   if (c->plan->apply_morx)
     hb_aat_layout_remove_deleted_glyphs (c->buffer);
+#endif
 
   if (c->plan->shaper->postprocess_glyphs)
     c->plan->shaper->postprocess_glyphs (c->plan, c->buffer, c->font);
@@ -784,6 +1022,36 @@ zero_mark_widths_by_gdef (hb_buffer_t *buffer, bool adjust_offsets)
     }
 }
 
+/* Zeroes, in one pass, the widths of marks if zero_marks, and the advances
+ * and offsets of default-ignorables, unless those are preserved or were
+ * removed. */
+static inline void
+zero_widths_after_positioning (hb_buffer_t *buffer,
+			       bool zero_marks,
+			       bool adjust_offsets)
+{
+  bool zero_ignorables = (buffer->scratch_flags & HB_BUFFER_SCRATCH_FLAG_HAS_DEFAULT_IGNORABLES) &&
+			 !(buffer->flags & HB_BUFFER_FLAG_PRESERVE_DEFAULT_IGNORABLES) &&
+			 !(buffer->flags & HB_BUFFER_FLAG_REMOVE_DEFAULT_IGNORABLES);
+  if (!zero_marks && !zero_ignorables)
+    return;
+
+  unsigned int count = buffer->len;
+  hb_glyph_info_t *info = buffer->info;
+  hb_glyph_position_t *pos = buffer->pos;
+  for (unsigned int i = 0; i < count; i++)
+  {
+    if (zero_marks && _hb_glyph_info_is_mark (&info[i]))
+    {
+      if (adjust_offsets)
+        adjust_mark_offsets (&pos[i]);
+      zero_mark_width (&pos[i]);
+    }
+    if (zero_ignorables && unlikely (_hb_glyph_info_is_default_ignorable (&info[i])))
+      pos[i].x_advance = pos[i].y_advance = pos[i].x_offset = pos[i].y_offset = 0;
+  }
+}
+
 static inline void
 hb_ot_position_default (const hb_ot_shape_context_t *c)
 {
@@ -807,11 +1075,14 @@ hb_ot_position_default (const hb_ot_shape_context_t *c)
   {
     c->font->get_glyph_v_advances (count, &info[0].codepoint, sizeof(info[0]),
                                    &pos[0].y_advance, sizeof(pos[0]));
+    /* Offsets are still zero, so subtracting the origins is negating them. */
+    c->font->get_glyph_v_origins_with_fallback (count, &info[0].codepoint, sizeof(info[0]),
+						&pos[0].x_offset, sizeof(pos[0]),
+						&pos[0].y_offset, sizeof(pos[0]));
     for (unsigned int i = 0; i < count; i++)
     {
-      c->font->subtract_glyph_v_origin (info[i].codepoint,
-					&pos[i].x_offset,
-					&pos[i].y_offset);
+      pos[i].x_offset = -pos[i].x_offset;
+      pos[i].y_offset = -pos[i].y_offset;
     }
   }
   if (c->buffer->scratch_flags & HB_BUFFER_SCRATCH_FLAG_HAS_SPACE_FALLBACK)
@@ -863,24 +1134,13 @@ hb_ot_position_complex (const hb_ot_shape_context_t *c)
 
   c->plan->position (c->font, c->buffer);
 
-  if (c->plan->zero_marks)
-    switch (c->plan->shaper->zero_width_marks)
-    {
-      case HB_OT_SHAPE_ZERO_WIDTH_MARKS_BY_GDEF_LATE:
-	zero_mark_widths_by_gdef (c->buffer, adjust_offsets_when_zeroing);
-	break;
-
-      default:
-      case HB_OT_SHAPE_ZERO_WIDTH_MARKS_NONE:
-      case HB_OT_SHAPE_ZERO_WIDTH_MARKS_BY_GDEF_EARLY:
-	break;
-    }
-
-  /* Finish off.  Has to follow a certain order. */
+  /* Finish off.  Has to follow a certain order.  Deleted AAT glyphs need
+   * no zeroing: hb_ot_substitute_post() removed them. */
   hb_ot_layout_position_finish_advances (c->font, c->buffer);
-  hb_ot_zero_width_default_ignorables (c->buffer);
-  if (c->plan->apply_morx)
-    hb_aat_layout_zero_width_deleted_glyphs (c->buffer);
+  zero_widths_after_positioning (c->buffer,
+				 c->plan->zero_marks &&
+				 c->plan->shaper->zero_width_marks == HB_OT_SHAPE_ZERO_WIDTH_MARKS_BY_GDEF_LATE,
+				 adjust_offsets_when_zeroing);
   hb_ot_layout_position_finish_offsets (c->font, c->buffer);
 
   /* The nil glyph_h_origin() func returns 0, so no need to apply it. */
@@ -891,7 +1151,11 @@ hb_ot_position_complex (const hb_ot_shape_context_t *c)
 					&pos[i].y_offset);
 
   if (c->plan->fallback_mark_positioning)
+  {
+    uint64_t start = c->buffer->trace_start ();
     _hb_ot_shape_fallback_mark_position (c->plan, c->font, c->buffer);
+    c->buffer->trace (c->font, HB_BUFFER_TRACE_EVENT_FALLBACK_POSITION, 0, start);
+  }
 }
 
 static inline void
@@ -937,21 +1201,44 @@ hb_propagate_flags (hb_buffer_t *buffer)
 
 /* Pull it all together! */
 
-static void
-hb_ot_shape_internal (hb_ot_shape_context_t *c)
+/* Sets the buffer's length and operation limits for one shaping run, and
+ * returns the operation limit, for hb_shape_limits_finish(). */
+static int
+hb_shape_limits_start (hb_buffer_t *buffer)
 {
-  c->buffer->deallocate_var_all ();
-  c->buffer->scratch_flags = HB_BUFFER_SCRATCH_FLAG_DEFAULT;
-  if (likely (!hb_unsigned_mul_overflows (c->buffer->len, HB_BUFFER_MAX_LEN_FACTOR)))
+  if (likely (!hb_unsigned_mul_overflows (buffer->len, HB_BUFFER_MAX_LEN_FACTOR)))
   {
-    c->buffer->max_len = MAX (c->buffer->len * HB_BUFFER_MAX_LEN_FACTOR,
-			      (unsigned) HB_BUFFER_MAX_LEN_MIN);
+    buffer->max_len = MAX (buffer->len * HB_BUFFER_MAX_LEN_FACTOR,
+			   (unsigned) HB_BUFFER_MAX_LEN_MIN);
   }
-  if (likely (!hb_unsigned_mul_overflows (c->buffer->len, HB_BUFFER_MAX_OPS_FACTOR)))
+  if (likely (!hb_unsigned_mul_overflows (buffer->len, HB_BUFFER_MAX_OPS_FACTOR)))
   {
-    c->buffer->max_ops = MAX (c->buffer->len * HB_BUFFER_MAX_OPS_FACTOR,
-			      (unsigned) HB_BUFFER_MAX_OPS_MIN);
+    buffer->max_ops = MAX (buffer->len * HB_BUFFER_MAX_OPS_FACTOR,
+			   (unsigned) HB_BUFFER_MAX_OPS_MIN);
   }
+  if (buffer->max_ops_budget)
+    buffer->max_ops = MIN (buffer->max_ops,
+			   (int) MIN (buffer->max_ops_budget, (unsigned) HB_BUFFER_MAX_OPS_DEFAULT));
+  buffer->ops_exhausted = false;
+  return buffer->max_ops;
+}
+
+static void
+hb_shape_limits_finish (hb_buffer_t *buffer, int max_ops)
+{
+  buffer->ops_used = max_ops - MAX (buffer->max_ops, 0);
+  /* Recursion and AAT loops overdraw max_ops when refused. */
+  buffer->ops_exhausted = buffer->ops_exhausted || buffer->max_ops < 0;
+  buffer->max_len = HB_BUFFER_MAX_LEN_DEFAULT;
+  buffer->max_ops = HB_BUFFER_MAX_OPS_DEFAULT;
+}
+
+static void
+hb_ot_shape_internal (hb_ot_shape_context_t *c)
+{
+  c->buffer->deallocate_var_all ();
+  c->buffer->scratch_flags = HB_BUFFER_SCRATCH_FLAG_DEFAULT;
+  int max_ops = hb_shape_limits_start (c->buffer);
 
   /* Save the original direction, we use it later. */
   c->target_direction = c->buffer->props.direction;
@@ -960,8 +1247,7 @@ hb_ot_shape_internal (hb_ot_shape_context_t *c)
 
   c->buffer->clear_output ();
 
-  hb_ot_shape_initialize_masks (c);
-  hb_set_unicode_props (c->buffer);
+  hb_set_unicode_props (c->buffer, c->plan->map.get_global_mask ());
   hb_insert_dotted_circle (c->buffer, c->font);
 
   hb_form_clusters (c->buffer);
@@ -981,8 +1267,7 @@ hb_ot_shape_internal (hb_ot_shape_context_t *c)
 
   c->buffer->props.direction = c->target_direction;
 
-  c->buffer->max_len = HB_BUFFER_MAX_LEN_DEFAULT;
-  c->buffer->max_ops = HB_BUFFER_MAX_OPS_DEFAULT;
+  hb_shape_limits_finish (c->buffer, max_ops);
   c->buffer->deallocate_var_all ();
 }
 
@@ -1000,6 +1285,79 @@ _hb_ot_shape (hb_shape_plan_t    *shape_plan,
   return true;
 }
 
+/* Whether the glyphs in an already shaped buffer are what shaping it again
+ * with the same plan at another font size would produce: nothing that
+ * happened after positioning, or that depended on it, can be replayed. */
+static bool
+hb_ot_shape_can_reposition (const hb_ot_shape_plan_t *plan HB_UNUSED,
+			    const hb_buffer_t        *buffer)
+{
+#ifndef HB_NO_AAT
+  if (plan->apply_morx)
+    return false;
+#endif
+
+  if (buffer->scratch_flags & HB_BUFFER_SCRATCH_FLAG_HAS_SIZE_DEPENDENT_GLYPHS)
+    return false;
+
+  /* Hidden default-ignorables were replaced or removed after positioning. */
+  if (!(buffer->flags & HB_BUFFER_FLAG_PRESERVE_DEFAULT_IGNORABLES))
+  {
+    if (buffer->scratch_flags & HB_BUFFER_SCRATCH_FLAG_HAS_DEFAULT_IGNORABLES)
+      return false;
+    unsigned int count = buffer->len;
+    const hb_glyph_info_t *info = buffer->info;
+    for (unsigned int i = 0; i < count; i++)
+      if (unlikely (_hb_glyph_info_is_default_ignorable (&info[i])))
+	return false;
+  }
+
+  return true;
+}
+
+/* Replays only the positioning stage of hb_ot_shape_internal() on a buffer
+ * it shaped before, relying on the glyph properties shaping left behind. */
+hb_bool_t
+_hb_ot_shape_reposition (hb_shape_plan_t    *shape_plan,
+			 hb_font_t          *font,
+			 hb_buffer_t        *buffer,
+			 const hb_feature_t *features,
+			 unsigned int        num_features)
+{
+  if (!hb_ot_shape_can_reposition (&shape_plan->ot, buffer))
+    return false;
+
+  hb_ot_shape_context_t c = {&shape_plan->ot, font, font->face, buffer, features, num_features};
+
+  buffer->deallocate_var_all ();
+  int max_ops = hb_shape_limits_start (buffer);
+
+  c.target_direction = buffer->props.direction;
+
+  _hb_buffer_allocate_unicode_vars (buffer);
+
+  /* Positioning ran in the native direction, in logical order; the clusters
+   * were reversed then already. */
+  if (!hb_is_native_direction (buffer))
+    buffer->props.direction = HB_DIRECTION_REVERSE (buffer->props.direction);
+  if (HB_DIRECTION_IS_BACKWARD (buffer->props.direction))
+    hb_buffer_reverse (buffer);
+
+  _hb_buffer_allocate_gsubgpos_vars (buffer);
+  hb_ot_position (&c);
+
+  hb_propagate_flags (buffer);
+
+  _hb_buffer_deallocate_unicode_vars (buffer);
+
+  buffer->props.direction = c.target_direction;
+
+  hb_shape_limits_finish (buffer, max_ops);
+  buffer->deallocate_var_all ();
+
+  return true;
+}
+
 
 /**
  * hb_ot_shape_plan_collect_lookups:
@@ -58,6 +58,15 @@ struct hb_ot_shape_plan_key_t
 
 struct hb_shape_plan_key_t;
 
+/* Per-lookup counters of a shape plan; see
+ * hb_shape_plan_set_lookup_profiling(). */
+struct hb_ot_lookup_profile_t
+{
+  hb_atomic_int_t enabled;
+  hb_mutex_t lock;
+  hb_vector_t<hb_ot_map_t::lookup_stats_t> stats[2]; /* GSUB/GPOS, indexed like the map's lookups. */
+};
+
 struct hb_ot_shape_plan_t
 {
   hb_segment_properties_t props;
@@ -96,16 +105,59 @@ struct hb_ot_shape_plan_t
     map.collect_lookups (table_index, lookups);
   }
 
+  /* Created the first time profiling is turned on, and kept until fini ()
+   * even if it is turned off again, so its stats can still be read. */
+  mutable hb_atomic_ptr_t<hb_ot_lookup_profile_t> lookup_profile;
+
+  /* If reader is given, restores what serialize () wrote instead of
+   * compiling the plan. */
   HB_INTERNAL bool init0 (hb_face_t                     *face,
-			  const hb_shape_plan_key_t     *key);
+			  const hb_shape_plan_key_t     *key,
+			  hb_plan_reader_t              *reader = nullptr);
   HB_INTERNAL void fini ();
 
+  HB_INTERNAL void serialize (hb_plan_writer_t *w) const;
+
+  HB_INTERNAL bool set_lookup_profiling (bool enabled) const;
+  bool is_lookup_profiling () const
+  {
+    const hb_ot_lookup_profile_t *profile = lookup_profile.get ();
+    return unlikely (profile && profile->enabled.get_relaxed ());
+  }
+  /* Adds stats, one per map lookup of table_index, to the profile. */
+  HB_INTERNAL void add_lookup_stats (unsigned int table_index,
+				     const hb_ot_map_t::lookup_stats_t *stats) const;
+
+  /* Excludes the complex shaper's data. */
+  unsigned int get_memory_usage () const
+  { return map.get_memory_usage () + aat_map.get_memory_usage (); }
+
   HB_INTERNAL void substitute (hb_font_t *font, hb_buffer_t *buffer) const;
   HB_INTERNAL void position (hb_font_t *font, hb_buffer_t *buffer) const;
 };
 
 struct hb_shape_plan_t;
 
+/* Backs hb_shape_reposition(); false if the buffer needs a full reshape. */
+HB_INTERNAL hb_bool_t
+_hb_ot_shape_reposition (hb_shape_plan_t    *shape_plan,
+			 hb_font_t          *font,
+			 hb_buffer_t        *buffer,
+			 const hb_feature_t *features,
+			 unsigned int        num_features);
+
+struct arabic_fallback_lookups_t;
+HB_INTERNAL void
+_hb_ot_shape_complex_arabic_fallback_lookups_destroy (arabic_fallback_lookups_t *lookups);
+
+/* The ot shaper's per-face data, shared by all shape plans of the face. */
+struct hb_ot_face_data_t
+{
+  /* Lookups synthesized for Arabic fonts without GSUB;
+   * see hb-ot-shape-complex-arabic-fallback.hh. */
+  hb_atomic_ptr_t<arabic_fallback_lookups_t> arabic_fallback_lookups;
+};
+
 struct hb_ot_shape_planner_t
 {
   /* In the order that they are filled in. */
@@ -123,6 +175,8 @@ struct hb_ot_shape_planner_t
 
   HB_INTERNAL void compile (hb_ot_shape_plan_t           &plan,
 			    const hb_ot_shape_plan_key_t &key);
+  HB_INTERNAL bool deserialize (hb_ot_shape_plan_t &plan,
+				hb_plan_reader_t   *r);
 };
 
 
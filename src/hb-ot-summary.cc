@@ -0,0 +1,399 @@
+/*
+ * Copyright © 2018  Google, Inc.
+ *
+ *  This is part of HarfBuzz, a text shaping library.
+ *
+ * Permission is hereby granted, without written agreement and without
+ * license or royalty fees, to use, copy, modify, and distribute this
+ * software and its documentation for any purpose, provided that the
+ * above copyright notice and the following two paragraphs appear in
+ * all copies of this software.
+ *
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE TO ANY PARTY FOR
+ * DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES
+ * ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION, EVEN
+ * IF THE COPYRIGHT HOLDER HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * THE COPYRIGHT HOLDER SPECIFICALLY DISCLAIMS ANY WARRANTIES, INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER IS
+ * ON AN "AS IS" BASIS, AND THE COPYRIGHT HOLDER HAS NO OBLIGATION TO
+ * PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+ *
+ */
+
+#include "hb-open-type.hh"
+
+#include "hb-ot-face.hh"
+#include "hb-ot-layout-gsubgpos.hh"
+#include "hb-ot-os2-table.hh"
+#include "hb-ot-var-fvar-table.hh"
+#include "hb-ot-summary.h"
+
+
+/**
+ * SECTION:hb-ot-summary
+ * @title: hb-ot-summary
+ * @short_description: OpenType face metadata for font indexing
+ * @include: hb-ot.h
+ *
+ * Functions for reading what a font index needs of a face, without
+ * keeping the face around.  Summaries hold no reference to the blob they
+ * were made from and share nothing, so many files can be summarized in
+ * parallel.
+ **/
+
+
+namespace OT {
+
+/* Only the header and ScriptList of a GSUB or GPOS table; the lookups,
+ * which make up most of it, are never looked at. */
+struct GSUBGPOSScripts : GSUBGPOS
+{
+  bool sanitize (hb_sanitize_context_t *c) const
+  {
+    TRACE_SANITIZE (this);
+    return_trace (version.sanitize (c) &&
+		  likely (version.major == 1) &&
+		  scriptList.sanitize (c, this));
+  }
+};
+
+} /* namespace OT */
+
+
+/* The names kept, in English. */
+static const hb_ot_name_id_t _hb_ot_face_summary_name_ids[] =
+{
+  HB_OT_NAME_ID_FONT_FAMILY,
+  HB_OT_NAME_ID_FONT_SUBFAMILY,
+  HB_OT_NAME_ID_FULL_NAME,
+  HB_OT_NAME_ID_POSTSCRIPT_NAME,
+  HB_OT_NAME_ID_TYPOGRAPHIC_FAMILY,
+  HB_OT_NAME_ID_TYPOGRAPHIC_SUBFAMILY,
+};
+#define HB_OT_FACE_SUMMARY_NAME_COUNT ((unsigned int) ARRAY_LENGTH_CONST (_hb_ot_face_summary_name_ids))
+
+struct hb_ot_face_summary_t
+{
+  hb_object_header_t header;
+
+  /* Offsets into name_pool, or -1 for names the face lacks. */
+  int name_offsets[HB_OT_FACE_SUMMARY_NAME_COUNT];
+  unsigned int name_lengths[HB_OT_FACE_SUMMARY_NAME_COUNT];
+  hb_vector_t<char> name_pool;
+
+  unsigned int weight_class;
+  unsigned int width_class;
+  bool italic;
+
+  hb_vector_t<hb_ot_var_axis_info_t> axes;
+  hb_set_t unicodes;
+  hb_vector_t<hb_tag_t> scripts; /* Sorted. */
+};
+
+static int
+_hb_ot_face_summary_tag_cmp (const void *pa, const void *pb)
+{
+  hb_tag_t a = * (const hb_tag_t *) pa;
+  hb_tag_t b = * (const hb_tag_t *) pb;
+  return a < b ? -1 : a > b ? +1 : 0;
+}
+
+static void
+_hb_ot_face_summary_add_scripts (hb_ot_face_summary_t *summary,
+				 hb_face_t            *face,
+				 hb_tag_t              table_tag)
+{
+  hb_blob_t *blob = hb_sanitize_context_t ().reference_table<OT::GSUBGPOSScripts> (face, table_tag);
+  const OT::GSUBGPOS &table = *blob->as<OT::GSUBGPOSScripts> ();
+
+  unsigned int count = table.get_script_count ();
+  unsigned int start = summary->scripts.length;
+  if (likely (summary->scripts.resize (start + count)))
+    table.get_script_tags (0, &count, &summary->scripts[start]);
+
+  hb_blob_destroy (blob);
+}
+
+/**
+ * hb_ot_face_summary_create: (Xconstructor)
+ * @blob: a font file.
+ * @index: the index of the face within @blob.
+ *
+ * Reads the metadata of face @index of @blob, as hb_face_create() would
+ * open it: its English names, its weight, width and slant from the 'OS/2'
+ * table, its variation axes, the characters its 'cmap' table maps, and
+ * the scripts its 'GSUB' and 'GPOS' tables list.  Only those tables are
+ * loaded, and only the header and script list of 'GSUB' and 'GPOS' are
+ * sanitized, which makes this much cheaper than querying a face for all
+ * of these.
+ *
+ * Return value: (transfer full): the new summary.
+ *
+ * Since: REPLACEME
+ **/
+hb_ot_face_summary_t *
+hb_ot_face_summary_create (hb_blob_t    *blob,
+			   unsigned int  index)
+{
+  hb_ot_face_summary_t *summary;
+
+  if (!(summary = hb_object_create<hb_ot_face_summary_t> ()))
+    return hb_ot_face_summary_get_empty ();
+
+  summary->name_pool.init ();
+  summary->axes.init ();
+  summary->unicodes.init ();
+  summary->scripts.init ();
+
+  hb_face_t *face = hb_face_create (blob, index);
+
+  const char *names[HB_OT_FACE_SUMMARY_NAME_COUNT];
+  hb_ot_name_get_utf8_strings (face, HB_LANGUAGE_INVALID,
+			       HB_OT_FACE_SUMMARY_NAME_COUNT, _hb_ot_face_summary_name_ids,
+			       names, summary->name_lengths);
+  for (unsigned int i = 0; i < HB_OT_FACE_SUMMARY_NAME_COUNT; i++)
+  {
+    summary->name_offsets[i] = -1;
+    if (!names[i])
+      continue;
+    unsigned int offset = summary->name_pool.length;
+    if (unlikely (!summary->name_pool.resize (offset + summary->name_lengths[i] + 1)))
+    {
+      summary->name_lengths[i] = 0;
+      continue;
+    }
+    memcpy (&summary->name_pool[offset], names[i], summary->name_lengths[i] + 1);
+    summary->name_offsets[i] = offset;
+  }
+
+  const OT::OS2 &os2 = *face->table.OS2;
+  summary->weight_class = os2.usWeightClass;
+  summary->width_class = os2.usWidthClass;
+  summary->italic = os2.is_italic ();
+
+  unsigned int axis_count = face->table.fvar->get_axis_count ();
+  if (likely (summary->axes.resize (axis_count)))
+    face->table.fvar->get_axis_infos (0, &axis_count, summary->axes.arrayZ ());
+
+  hb_face_collect_unicodes (face, &summary->unicodes);
+
+  _hb_ot_face_summary_add_scripts (summary, face, HB_OT_TAG_GSUB);
+  _hb_ot_face_summary_add_scripts (summary, face, HB_OT_TAG_GPOS);
+  summary->scripts.qsort (_hb_ot_face_summary_tag_cmp);
+  unsigned int j = 0;
+  for (unsigned int i = 0; i < summary->scripts.length; i++)
+    if (!j || summary->scripts[j - 1] != summary->scripts[i])
+      summary->scripts[j++] = summary->scripts[i];
+  summary->scripts.shrink (j);
+
+  hb_face_destroy (face);
+
+  return summary;
+}
+
+/**
+ * hb_ot_face_summary_get_empty:
+ *
+ * Return value: (transfer full): the empty summary, of a face with no
+ * tables.
+ *
+ * Since: REPLACEME
+ **/
+hb_ot_face_summary_t *
+hb_ot_face_summary_get_empty ()
+{
+  return const_cast<hb_ot_face_summary_t *> (&Null(hb_ot_face_summary_t));
+}
+
+/**
+ * hb_ot_face_summary_reference: (skip)
+ * @summary: a summary.
+ *
+ * Return value: (transfer full): @summary.
+ *
+ * Since: REPLACEME
+ **/
+hb_ot_face_summary_t *
+hb_ot_face_summary_reference (hb_ot_face_summary_t *summary)
+{
+  return hb_object_reference (summary);
+}
+
+/**
+ * hb_ot_face_summary_destroy: (skip)
+ * @summary: a summary.
+ *
+ * Since: REPLACEME
+ **/
+void
+hb_ot_face_summary_destroy (hb_ot_face_summary_t *summary)
+{
+  if (!hb_object_destroy (summary)) return;
+
+  summary->name_pool.fini ();
+  summary->axes.fini ();
+  summary->unicodes.fini ();
+  summary->scripts.fini ();
+
+  free (summary);
+}
+
+
+/**
+ * hb_ot_face_summary_get_name:
+ * @summary: a summary.
+ * @name_id: OpenType name identifier to fetch.
+ * @length: (out) (allow-none): length of the name, in bytes.
+ *
+ * Fetches an English name of the face, as hb_ot_name_get_utf8() would.
+ * Only the family, subfamily, full, PostScript, typographic family and
+ * typographic subfamily names are kept.
+ *
+ * Returns: (transfer none): the NUL-terminated UTF-8 name, owned by
+ * @summary, or %NULL if the face does not have it.
+ *
+ * Since: REPLACEME
+ **/
+const char *
+hb_ot_face_summary_get_name (hb_ot_face_summary_t *summary,
+			     hb_ot_name_id_t       name_id,
+			     unsigned int         *length /* OUT */)
+{
+  if (length) *length = 0;
+  if (unlikely (hb_object_is_inert (summary)))
+    return nullptr;
+
+  for (unsigned int i = 0; i < HB_OT_FACE_SUMMARY_NAME_COUNT; i++)
+    if (_hb_ot_face_summary_name_ids[i] == name_id)
+    {
+      if (summary->name_offsets[i] == -1)
+	return nullptr;
+      if (length) *length = summary->name_lengths[i];
+      return &summary->name_pool[summary->name_offsets[i]];
+    }
+  return nullptr;
+}
+
+/**
+ * hb_ot_face_summary_get_weight_class:
+ * @summary: a summary.
+ *
+ * Returns: the usWeightClass of the face's 'OS/2' table, or 0.
+ *
+ * Since: REPLACEME
+ **/
+unsigned int
+hb_ot_face_summary_get_weight_class (hb_ot_face_summary_t *summary)
+{
+  return summary->weight_class;
+}
+
+/**
+ * hb_ot_face_summary_get_width_class:
+ * @summary: a summary.
+ *
+ * Returns: the usWidthClass of the face's 'OS/2' table, or 0.
+ *
+ * Since: REPLACEME
+ **/
+unsigned int
+hb_ot_face_summary_get_width_class (hb_ot_face_summary_t *summary)
+{
+  return summary->width_class;
+}
+
+/**
+ * hb_ot_face_summary_is_italic:
+ * @summary: a summary.
+ *
+ * Returns: whether the face's 'OS/2' table has the italic bit set.
+ *
+ * Since: REPLACEME
+ **/
+hb_bool_t
+hb_ot_face_summary_is_italic (hb_ot_face_summary_t *summary)
+{
+  return summary->italic;
+}
+
+/**
+ * hb_ot_face_summary_get_axis_infos:
+ * @summary: a summary.
+ * @start_offset: offset of the first axis to retrieve.
+ * @axes_count: (inout) (allow-none): input size of @axes_array, and
+ *              output number of axes written to it.
+ * @axes_array: (out caller-allocates) (array length=axes_count): axes.
+ *
+ * Fetches the variation axes of the face, as hb_ot_var_get_axis_infos()
+ * would.
+ *
+ * Returns: total number of axes.
+ *
+ * Since: REPLACEME
+ **/
+unsigned int
+hb_ot_face_summary_get_axis_infos (hb_ot_face_summary_t  *summary,
+				   unsigned int           start_offset,
+				   unsigned int          *axes_count /* IN/OUT */,
+				   hb_ot_var_axis_info_t *axes_array /* OUT */)
+{
+  if (axes_count)
+  {
+    hb_array_t<const hb_ot_var_axis_info_t> arr = summary->axes.sub_array (start_offset, axes_count);
+    for (unsigned int i = 0; i < arr.length; i++)
+      axes_array[i] = arr[i];
+  }
+  return summary->axes.length;
+}
+
+/**
+ * hb_ot_face_summary_collect_unicodes:
+ * @summary: a summary.
+ * @out: set to add the characters to.
+ *
+ * Adds the characters the face's 'cmap' table maps to @out, as
+ * hb_face_collect_unicodes() would.
+ *
+ * Since: REPLACEME
+ **/
+void
+hb_ot_face_summary_collect_unicodes (hb_ot_face_summary_t *summary,
+				     hb_set_t             *out)
+{
+  if (unlikely (hb_object_is_inert (summary)))
+    return;
+  out->union_ (&summary->unicodes);
+}
+
+/**
+ * hb_ot_face_summary_get_script_tags:
+ * @summary: a summary.
+ * @start_offset: offset of the first script tag to retrieve.
+ * @script_count: (inout) (allow-none): input size of @script_tags, and
+ *                output number of tags written to it.
+ * @script_tags: (out caller-allocates) (array length=script_count): script tags.
+ *
+ * Fetches the script tags listed by the 'GSUB' and 'GPOS' tables of the
+ * face, sorted and without duplicates.
+ *
+ * Returns: total number of script tags.
+ *
+ * Since: REPLACEME
+ **/
+unsigned int
+hb_ot_face_summary_get_script_tags (hb_ot_face_summary_t *summary,
+				    unsigned int          start_offset,
+				    unsigned int         *script_count /* IN/OUT */,
+				    hb_tag_t             *script_tags /* OUT */)
+{
+  if (script_count)
+  {
+    hb_array_t<const hb_tag_t> arr = summary->scripts.sub_array (start_offset, script_count);
+    for (unsigned int i = 0; i < arr.length; i++)
+      script_tags[i] = arr[i];
+  }
+  return summary->scripts.length;
+}
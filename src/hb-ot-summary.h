@@ -0,0 +1,97 @@
+/*
+ * Copyright © 2018  Google, Inc.
+ *
+ *  This is part of HarfBuzz, a text shaping library.
+ *
+ * Permission is hereby granted, without written agreement and without
+ * license or royalty fees, to use, copy, modify, and distribute this
+ * software and its documentation for any purpose, provided that the
+ * above copyright notice and the following two paragraphs appear in
+ * all copies of this software.
+ *
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE TO ANY PARTY FOR
+ * DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES
+ * ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION, EVEN
+ * IF THE COPYRIGHT HOLDER HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * THE COPYRIGHT HOLDER SPECIFICALLY DISCLAIMS ANY WARRANTIES, INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER IS
+ * ON AN "AS IS" BASIS, AND THE COPYRIGHT HOLDER HAS NO OBLIGATION TO
+ * PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+ *
+ */
+
+#ifndef HB_OT_H_IN
+#error "Include <hb-ot.h> instead."
+#endif
+
+#ifndef HB_OT_SUMMARY_H
+#define HB_OT_SUMMARY_H
+
+#include "hb.h"
+#include "hb-ot-name.h"
+#include "hb-ot-var.h"
+
+HB_BEGIN_DECLS
+
+
+/**
+ * hb_ot_face_summary_t:
+ *
+ * The metadata a font index needs from one face, read off its blob in
+ * one go.
+ *
+ * Since: REPLACEME
+ **/
+typedef struct hb_ot_face_summary_t hb_ot_face_summary_t;
+
+HB_EXTERN hb_ot_face_summary_t *
+hb_ot_face_summary_create (hb_blob_t    *blob,
+			   unsigned int  index);
+
+HB_EXTERN hb_ot_face_summary_t *
+hb_ot_face_summary_get_empty (void);
+
+HB_EXTERN hb_ot_face_summary_t *
+hb_ot_face_summary_reference (hb_ot_face_summary_t *summary);
+
+HB_EXTERN void
+hb_ot_face_summary_destroy (hb_ot_face_summary_t *summary);
+
+
+HB_EXTERN const char *
+hb_ot_face_summary_get_name (hb_ot_face_summary_t *summary,
+			     hb_ot_name_id_t       name_id,
+			     unsigned int         *length /* OUT */);
+
+HB_EXTERN unsigned int
+hb_ot_face_summary_get_weight_class (hb_ot_face_summary_t *summary);
+
+HB_EXTERN unsigned int
+hb_ot_face_summary_get_width_class (hb_ot_face_summary_t *summary);
+
+HB_EXTERN hb_bool_t
+hb_ot_face_summary_is_italic (hb_ot_face_summary_t *summary);
+
+HB_EXTERN unsigned int
+hb_ot_face_summary_get_axis_infos (hb_ot_face_summary_t  *summary,
+				   unsigned int           start_offset,
+				   unsigned int          *axes_count /* IN/OUT */,
+				   hb_ot_var_axis_info_t *axes_array /* OUT */);
+
+HB_EXTERN void
+hb_ot_face_summary_collect_unicodes (hb_ot_face_summary_t *summary,
+				     hb_set_t             *out);
+
+HB_EXTERN unsigned int
+hb_ot_face_summary_get_script_tags (hb_ot_face_summary_t *summary,
+				    unsigned int          start_offset,
+				    unsigned int         *script_count /* IN/OUT */,
+				    hb_tag_t             *script_tags /* OUT */);
+
+
+HB_END_DECLS
+
+#endif /* HB_OT_SUMMARY_H */
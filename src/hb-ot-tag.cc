@@ -320,6 +320,79 @@ parse_private_use_subtag (const char     *private_use_subtag,
   return true;
 }
 
+/* What hb_ot_tags_from_script_and_language() derives from the language
+ * alone: the -hbsc and -hbot overrides and the language tags.  Cached with
+ * the interned language, as the lookups are string compares. */
+struct hb_ot_language_tags_t
+{
+  bool has_script_tag;
+  hb_tag_t script_tag;
+  unsigned int language_count;
+  hb_tag_t language_tags[HB_OT_MAX_TAGS_PER_LANGUAGE];
+};
+
+static void
+hb_ot_language_tags_compute (hb_language_t language, hb_ot_language_tags_t *t)
+{
+  const char *lang_str, *s, *limit, *private_use_subtag;
+
+  lang_str = hb_language_to_string (language);
+  limit = nullptr;
+  private_use_subtag = nullptr;
+  if (lang_str[0] == 'x' && lang_str[1] == '-')
+  {
+    private_use_subtag = lang_str;
+  } else {
+    for (s = lang_str + 1; *s; s++)
+    {
+      if (s[-1] == '-' && s[1] == '-')
+      {
+	if (s[0] == 'x')
+	{
+	  private_use_subtag = s;
+	  if (!limit)
+	    limit = s - 1;
+	  break;
+	} else if (!limit)
+	{
+	  limit = s - 1;
+	}
+      }
+    }
+    if (!limit)
+      limit = s;
+  }
+
+  unsigned int script_count = 1;
+  t->has_script_tag = !parse_private_use_subtag (private_use_subtag, &script_count, &t->script_tag, "-hbsc", TOLOWER);
+  t->language_count = HB_OT_MAX_TAGS_PER_LANGUAGE;
+  if (parse_private_use_subtag (private_use_subtag, &t->language_count, t->language_tags, "-hbot", TOUPPER))
+    hb_ot_tags_from_language (lang_str, limit, &t->language_count, t->language_tags);
+}
+
+static const hb_ot_language_tags_t *
+hb_ot_language_tags_get (hb_language_t language, hb_ot_language_tags_t *scratch)
+{
+  hb_atomic_ptr_t<void> *slot = _hb_language_get_ot_tags (language);
+  const hb_ot_language_tags_t *t = (const hb_ot_language_tags_t *) slot->get ();
+  if (likely (t))
+    return t;
+
+  hb_ot_language_tags_t *tags = (hb_ot_language_tags_t *) malloc (sizeof (hb_ot_language_tags_t));
+  if (unlikely (!tags))
+  {
+    hb_ot_language_tags_compute (language, scratch);
+    return scratch;
+  }
+  hb_ot_language_tags_compute (language, tags);
+  if (unlikely (!slot->cmpexch (nullptr, tags)))
+  {
+    free (tags);
+    return (const hb_ot_language_tags_t *) slot->get ();
+  }
+  return tags;
+}
+
 /**
  * hb_ot_tags_from_script_and_language:
  * @script: an #hb_script_t to convert.
@@ -354,41 +427,23 @@ hb_ot_tags_from_script_and_language (hb_script_t   script,
   }
   else
   {
-    const char *lang_str, *s, *limit, *private_use_subtag;
-    bool needs_language;
+    hb_ot_language_tags_t scratch;
+    const hb_ot_language_tags_t *t = hb_ot_language_tags_get (language, &scratch);
 
-    lang_str = hb_language_to_string (language);
-    limit = nullptr;
-    private_use_subtag = nullptr;
-    if (lang_str[0] == 'x' && lang_str[1] == '-')
+    if (t->has_script_tag && script_count && script_tags && *script_count)
     {
-      private_use_subtag = lang_str;
-    } else {
-      for (s = lang_str + 1; *s; s++)
-      {
-	if (s[-1] == '-' && s[1] == '-')
-	{
-	  if (s[0] == 'x')
-	  {
-	    private_use_subtag = s;
-	    if (!limit)
-	      limit = s - 1;
-	    break;
-	  } else if (!limit)
-	  {
-	    limit = s - 1;
-	  }
-	}
-      }
-      if (!limit)
-	limit = s;
+      script_tags[0] = t->script_tag;
+      *script_count = 1;
+      needs_script = false;
     }
 
-    needs_script = parse_private_use_subtag (private_use_subtag, script_count, script_tags, "-hbsc", TOLOWER);
-    needs_language = parse_private_use_subtag (private_use_subtag, language_count, language_tags, "-hbot", TOUPPER);
-
-    if (needs_language && language_count && language_tags && *language_count)
-      hb_ot_tags_from_language (lang_str, limit, language_count, language_tags);
+    if (language_count && language_tags && *language_count)
+    {
+      unsigned int count = MIN (*language_count, t->language_count);
+      for (unsigned int i = 0; i < count; i++)
+	language_tags[i] = t->language_tags[i];
+      *language_count = count;
+    }
   }
 
   if (needs_script && script_count && script_tags && *script_count)
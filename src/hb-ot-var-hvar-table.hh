@@ -115,12 +115,15 @@ struct HVARVVAR
   }
 
   float get_advance_var (hb_codepoint_t glyph,
-			 const int *coords, unsigned int coord_count) const
+			 const int *coords, unsigned int coord_count,
+			 VariationStore::cache_t *store_cache = nullptr) const
   {
     unsigned int varidx = (this+advMap).map (glyph);
-    return (this+varStore).get_delta (varidx, coords, coord_count);
+    return (this+varStore).get_delta (varidx, coords, coord_count, store_cache);
   }
 
+  const VariationStore &get_var_store () const { return this+varStore; }
+
   bool has_sidebearing_deltas () const { return lsbMap && rsbMap; }
 
   protected:
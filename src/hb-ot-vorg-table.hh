@@ -114,7 +114,9 @@ struct VORG
     unsigned int i = 0;
     while ((glyph < plan->glyphs.length) && (i < vertYOrigins.len))
     {
-      if (plan->glyphs[glyph] > vertYOrigins[i].glyph)
+      if (plan->glyphs[glyph] == HB_MAP_VALUE_INVALID)
+        glyph++;
+      else if (plan->glyphs[glyph] > vertYOrigins[i].glyph)
         i++;
       else if (plan->glyphs[glyph] < vertYOrigins[i].glyph)
         glyph++;
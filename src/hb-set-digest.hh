@@ -64,6 +64,7 @@ struct hb_set_digest_lowest_bits_t
   void init () { mask = 0; }
 
   void add (hb_codepoint_t g) { mask |= mask_for (g); }
+  void add (const hb_set_digest_lowest_bits_t &o) { mask |= o.mask; }
 
   bool add_range (hb_codepoint_t a, hb_codepoint_t b)
   {
@@ -100,6 +101,13 @@ struct hb_set_digest_lowest_bits_t
   bool may_have (hb_codepoint_t g) const
   { return !!(mask & mask_for (g)); }
 
+  /* Whether the two sets may have any glyph in common. */
+  bool may_have (const hb_set_digest_lowest_bits_t &o) const
+  { return !!(mask & o.mask); }
+
+  /* Whether may_have() is true for every glyph. */
+  bool is_full () const { return mask == (mask_t) -1; }
+
   private:
 
   static mask_t mask_for (hb_codepoint_t g)
@@ -121,6 +129,11 @@ struct hb_set_digest_combiner_t
     head.add (g);
     tail.add (g);
   }
+  void add (const hb_set_digest_combiner_t &o)
+  {
+    head.add (o.head);
+    tail.add (o.tail);
+  }
 
   bool add_range (hb_codepoint_t a, hb_codepoint_t b)
   {
@@ -147,6 +160,16 @@ struct hb_set_digest_combiner_t
     return head.may_have (g) && tail.may_have (g);
   }
 
+  bool may_have (const hb_set_digest_combiner_t &o) const
+  {
+    return head.may_have (o.head) && tail.may_have (o.tail);
+  }
+
+  bool is_full () const
+  {
+    return head.is_full () && tail.is_full ();
+  }
+
   private:
   head_t head;
   tail_t tail;
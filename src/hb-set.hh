@@ -37,6 +37,13 @@
 /* TODO Keep a free-list so we can free pages that are completely zeroed.  At that
  * point maybe also use a sentinel value for "all-1" pages? */
 
+/* Sets of up to this many elements are stored as a sorted array of
+ * codepoints instead of pages.  Sets that shrink to half of it are
+ * converted back after set operations. */
+#ifndef HB_SET_SPARSE_MAX_LENGTH
+#define HB_SET_SPARSE_MAX_LENGTH 512
+#endif
+
 struct hb_set_t
 {
   HB_NO_COPY_ASSIGN (hb_set_t);
@@ -59,13 +66,7 @@ struct hb_set_t
     unsigned int len () const
     { return ARRAY_LENGTH_CONST (v); }
 
-    bool is_empty () const
-    {
-      for (unsigned int i = 0; i < len (); i++)
-        if (v[i])
-	  return false;
-      return true;
-    }
+    bool is_empty () const { return v.is_zero (); }
 
     void add (hb_codepoint_t g) { elt (g) |= mask (g); }
     void del (hb_codepoint_t g) { elt (g) &= ~mask (g); }
@@ -93,13 +94,7 @@ struct hb_set_t
       return 0 == hb_memcmp (&v, &other->v, sizeof (v));
     }
 
-    unsigned int get_population () const
-    {
-      unsigned int pop = 0;
-      for (unsigned int i = 0; i < len (); i++)
-        pop += hb_popcount (v[i]);
-      return pop;
-    }
+    unsigned int get_population () const { return v.get_population (); }
 
     bool next (hb_codepoint_t *codepoint) const
     {
@@ -134,7 +129,7 @@ struct hb_set_t
       unsigned int i = m / ELT_BITS;
       unsigned int j = m & ELT_MASK;
 
-      const elt_t vv = v[i] & ((elt_t (1) << (j + 1)) - 1);
+      const elt_t vv = v[i] & ((elt_t (2) << j) - 1);
       for (const elt_t *p = &vv; (int) i >= 0; p = &v[--i])
 	if (*p)
 	{
@@ -157,7 +152,7 @@ struct hb_set_t
       for (int i = len () - 1; i >= 0; i--)
         if (v[i])
 	  return i * ELT_BITS + elt_get_max (v[i]);
-      return 0;
+      return INVALID;
     }
 
     typedef unsigned long long elt_t;
@@ -188,6 +183,10 @@ struct hb_set_t
   mutable unsigned int population;
   hb_vector_t<page_map_t> page_map;
   hb_vector_t<page_t> pages;
+  /* If is_sparse, the elements are in sparse_values and there are no
+   * pages.  An empty set may be in either representation. */
+  bool is_sparse;
+  hb_vector_t<hb_codepoint_t> sparse_values;
 
   void init_shallow ()
   {
@@ -195,6 +194,8 @@ struct hb_set_t
     population = 0;
     page_map.init ();
     pages.init ();
+    is_sparse = true;
+    sparse_values.init ();
   }
   void init ()
   {
@@ -206,6 +207,7 @@ struct hb_set_t
     population = 0;
     page_map.fini ();
     pages.fini ();
+    sparse_values.fini ();
   }
   void fini ()
   {
@@ -215,6 +217,13 @@ struct hb_set_t
 
   bool in_error () const { return !successful; }
 
+  /* Heap bytes held by the set. */
+  unsigned int get_memory_usage () const
+  {
+    return page_map.get_allocated_size () + pages.get_allocated_size () +
+	   sparse_values.get_allocated_size ();
+  }
+
   bool resize (unsigned int count)
   {
     if (unlikely (!successful)) return false;
@@ -235,9 +244,13 @@ struct hb_set_t
     population = 0;
     page_map.resize (0);
     pages.resize (0);
+    is_sparse = true;
+    sparse_values.resize (0);
   }
   bool is_empty () const
   {
+    if (is_sparse)
+      return !sparse_values.length;
     unsigned int count = pages.length;
     for (unsigned int i = 0; i < count; i++)
       if (!pages[i].is_empty ())
@@ -252,6 +265,19 @@ struct hb_set_t
     if (unlikely (!successful)) return;
     if (unlikely (g == INVALID)) return;
     dirty ();
+    if (is_sparse)
+    {
+      unsigned int i;
+      if (sparse_find (g, &i))
+	return;
+      if (sparse_values.length < HB_SET_SPARSE_MAX_LENGTH)
+      {
+	sparse_insert (i, g);
+	return;
+      }
+      densify ();
+      if (unlikely (!successful)) return;
+    }
     page_t *page = page_for_insert (g); if (unlikely (!page)) return;
     page->add (g);
   }
@@ -260,6 +286,17 @@ struct hb_set_t
     if (unlikely (!successful)) return true; /* https://github.com/harfbuzz/harfbuzz/issues/657 */
     if (unlikely (a > b || a == INVALID || b == INVALID)) return false;
     dirty ();
+    if (is_sparse)
+    {
+      if (b - a < HB_SET_SPARSE_MAX_LENGTH - sparse_values.length)
+      {
+	for (hb_codepoint_t g = a; g <= b; g++)
+	  add (g);
+	return successful;
+      }
+      densify ();
+      if (unlikely (!successful)) return true;
+    }
     unsigned int ma = get_major (a);
     unsigned int mb = get_major (b);
     if (ma == mb)
@@ -290,6 +327,12 @@ struct hb_set_t
     if (unlikely (!successful)) return;
     if (!count) return;
     dirty ();
+    for (; count && is_sparse; count--)
+    {
+      add (*array);
+      array = (const T *) ((const char *) array + stride);
+    }
+    if (unlikely (!successful) || !count) return;
     hb_codepoint_t g = *array;
     while (count)
     {
@@ -318,6 +361,17 @@ struct hb_set_t
     dirty ();
     hb_codepoint_t g = *array;
     hb_codepoint_t last_g = g;
+    for (; count && is_sparse; count--)
+    {
+      g = *array;
+      if (g < last_g) return false;
+      last_g = g;
+      add (g);
+      array = (const T *) ((const char *) array + stride);
+    }
+    if (unlikely (!successful)) return true;
+    if (!count) return true;
+    g = *array;
     while (count)
     {
       unsigned int m = get_major (g);
@@ -343,6 +397,18 @@ struct hb_set_t
   {
     /* TODO perform op even if !successful. */
     if (unlikely (!successful)) return;
+    if (is_sparse)
+    {
+      unsigned int i;
+      if (!sparse_find (g, &i))
+	return;
+      dirty ();
+      memmove (sparse_values + i,
+	       sparse_values + i + 1,
+	       (sparse_values.length - i - 1) * sparse_values.item_size);
+      sparse_values.resize (sparse_values.length - 1);
+      return;
+    }
     page_t *page = page_for (g);
     if (!page)
       return;
@@ -359,6 +425,8 @@ struct hb_set_t
   }
   bool has (hb_codepoint_t g) const
   {
+    if (is_sparse)
+      return sparse_find (g);
     const page_t *page = page_for (g);
     if (!page)
       return false;
@@ -373,6 +441,19 @@ struct hb_set_t
   void set (const hb_set_t *other)
   {
     if (unlikely (!successful)) return;
+    if (other->is_sparse)
+    {
+      unsigned int count = other->sparse_values.length;
+      if (!resize (0) || !sparse_resize (count))
+	return;
+      is_sparse = true;
+      population = count;
+      if (count)
+	memcpy ((void *) sparse_values, (const void *) other->sparse_values, count * sparse_values.item_size);
+      return;
+    }
+    is_sparse = false;
+    sparse_values.resize (0);
     unsigned int count = other->pages.length;
     if (!resize (count))
       return;
@@ -386,6 +467,14 @@ struct hb_set_t
     if (get_population () != other->get_population ())
       return false;
 
+    if (is_sparse && other->is_sparse)
+      return 0 == hb_memcmp (sparse_values.arrayZ (), other->sparse_values.arrayZ (),
+			     sparse_values.length * sparse_values.item_size);
+    if (is_sparse)
+      return is_subset (other);
+    if (other->is_sparse)
+      return other->is_subset (this);
+
     unsigned int na = pages.length;
     unsigned int nb = other->pages.length;
 
@@ -429,6 +518,36 @@ struct hb_set_t
 
     dirty ();
 
+    if (is_sparse && other->is_sparse)
+    {
+      process_sparse<Op> (other);
+      return;
+    }
+    if (other->is_sparse)
+    {
+      hb_set_t dense;
+      dense.set (other);
+      dense.densify ();
+      if (unlikely (dense.in_error ()))
+      {
+	successful = false;
+	return;
+      }
+      process<Op> (&dense);
+      return;
+    }
+    densify ();
+    if (unlikely (!successful)) return;
+
+    process_pages<Op> (other);
+
+    if (pages.length && get_population () <= HB_SET_SPARSE_MAX_LENGTH / 2)
+      sparsify ();
+  }
+
+  template <class Op>
+  void process_pages (const hb_set_t *other)
+  {
     unsigned int na = pages.length;
     unsigned int nb = other->pages.length;
     unsigned int next_page = na;
@@ -466,6 +585,27 @@ struct hb_set_t
         return;
     newCount = count;
 
+    if (!Op::passthru_left)
+    {
+      /* Drop the pages of this set that are not in other first, so that
+       * the backward pass never overwrites entries it has yet to read. */
+      unsigned int k = 0;
+      for (a = 0, b = 0; a < na && b < nb; )
+      {
+	if (page_map[a].major == other->page_map[b].major)
+	{
+	  page_map[k++] = page_map[a];
+	  a++;
+	  b++;
+	}
+	else if (page_map[a].major < other->page_map[b].major)
+	  a++;
+	else
+	  b++;
+      }
+      na = k;
+    }
+
     /* Process in-place backward. */
     a = na;
     b = nb;
@@ -518,7 +658,26 @@ struct hb_set_t
       }
     assert (!count);
     if (pages.length > newCount)
-      resize (newCount);
+      compact (newCount);
+  }
+
+  /* Drops the pages not referenced by the first count entries of
+   * page_map, which may be anywhere in pages. */
+  void compact (unsigned int count)
+  {
+    hb_vector_t<page_t> compacted;
+    if (unlikely (!compacted.resize (count)))
+    {
+      successful = false;
+      return;
+    }
+    for (unsigned int i = 0; i < count; i++)
+    {
+      compacted[i] = page_at (i);
+      page_map[i].index = i;
+    }
+    memcpy ((void *) pages, (const void *) compacted, count * pages.item_size);
+    resize (count);
   }
 
   void union_ (const hb_set_t *other)
@@ -544,6 +703,19 @@ struct hb_set_t
       return *codepoint != INVALID;
     }
 
+    if (is_sparse)
+    {
+      unsigned int i;
+      sparse_find (*codepoint + 1, &i);
+      if (i < sparse_values.length)
+      {
+	*codepoint = sparse_values[i];
+	return true;
+      }
+      *codepoint = INVALID;
+      return false;
+    }
+
     page_map_t map = {get_major (*codepoint), 0};
     unsigned int i;
     page_map.bfind (map, &i, HB_BFIND_NOT_FOUND_STORE_CLOSEST);
@@ -575,6 +747,19 @@ struct hb_set_t
       return *codepoint != INVALID;
     }
 
+    if (is_sparse)
+    {
+      unsigned int i;
+      sparse_find (*codepoint, &i);
+      if (i)
+      {
+	*codepoint = sparse_values[i - 1];
+	return true;
+      }
+      *codepoint = INVALID;
+      return false;
+    }
+
     page_map_t map = {get_major (*codepoint), 0};
     unsigned int i;
     page_map.bfind (map, &i, HB_BFIND_NOT_FOUND_STORE_CLOSEST);
@@ -641,6 +826,9 @@ struct hb_set_t
     if (population != (unsigned int) -1)
       return population;
 
+    if (is_sparse)
+      return population = sparse_values.length;
+
     unsigned int pop = 0;
     unsigned int count = pages.length;
     for (unsigned int i = 0; i < count; i++)
@@ -651,6 +839,8 @@ struct hb_set_t
   }
   hb_codepoint_t get_min () const
   {
+    if (is_sparse)
+      return sparse_values.length ? sparse_values[0] : INVALID;
     unsigned int count = pages.length;
     for (unsigned int i = 0; i < count; i++)
       if (!page_at (i).is_empty ())
@@ -659,8 +849,10 @@ struct hb_set_t
   }
   hb_codepoint_t get_max () const
   {
+    if (is_sparse)
+      return sparse_values.length ? sparse_values[sparse_values.length - 1] : INVALID;
     unsigned int count = pages.length;
-    for (int i = count - 1; i >= 0; i++)
+    for (int i = count - 1; i >= 0; i--)
       if (!page_at (i).is_empty ())
         return page_map[(unsigned) i].major * page_t::PAGE_BITS + page_at (i).get_max ();
     return INVALID;
@@ -695,6 +887,131 @@ struct hb_set_t
 
   protected:
 
+  /* Sets *i to the index of the first element not less than g. */
+  bool sparse_find (hb_codepoint_t g, unsigned int *i = nullptr) const
+  {
+    const hb_codepoint_t *array = sparse_values.arrayZ ();
+    unsigned int lo = 0, hi = sparse_values.length;
+    while (lo < hi)
+    {
+      unsigned int mid = (lo + hi) / 2;
+      if (array[mid] < g)
+	lo = mid + 1;
+      else
+	hi = mid;
+    }
+    if (i)
+      *i = lo;
+    return lo < sparse_values.length && array[lo] == g;
+  }
+  bool sparse_resize (unsigned int count)
+  {
+    if (unlikely (!sparse_values.resize (count)))
+    {
+      successful = false;
+      return false;
+    }
+    return true;
+  }
+  void sparse_insert (unsigned int i, hb_codepoint_t g)
+  {
+    if (unlikely (!sparse_resize (sparse_values.length + 1)))
+      return;
+    memmove (sparse_values + i + 1,
+	     sparse_values + i,
+	     (sparse_values.length - 1 - i) * sparse_values.item_size);
+    sparse_values[i] = g;
+  }
+
+  /* Switches to pages. */
+  void densify ()
+  {
+    if (!is_sparse)
+      return;
+    hb_vector_t<hb_codepoint_t> values;
+    if (unlikely (!values.resize (sparse_values.length)))
+    {
+      successful = false;
+      return;
+    }
+    if (values.length)
+      memcpy ((void *) values, (const void *) sparse_values, values.length * values.item_size);
+    sparse_values.fini ();
+    is_sparse = false;
+    add_sorted_array (values.arrayZ (), values.length);
+  }
+  /* Switches to a sorted array; population must fit. */
+  void sparsify ()
+  {
+    unsigned int count = get_population ();
+    if (!sparse_resize (count))
+      return;
+    hb_codepoint_t g = INVALID;
+    for (unsigned int i = 0; next (&g); i++)
+      sparse_values[i] = g;
+    is_sparse = true;
+    page_map.fini ();
+    pages.fini ();
+  }
+
+  /* Merges two sparse sets, keeping the elements Op keeps. */
+  template <class Op>
+  void process_sparse (const hb_set_t *other)
+  {
+    unsigned int na = sparse_values.length;
+    unsigned int nb = other->sparse_values.length;
+    unsigned int count = 0;
+    if (Op::passthru_left) count += na;
+    if (Op::passthru_right) count += nb;
+    if (!Op::passthru_left && !Op::passthru_right) count = MIN (na, nb);
+
+    hb_vector_t<hb_codepoint_t> out;
+    if (unlikely (!out.resize (count)))
+    {
+      successful = false;
+      return;
+    }
+
+    page_t::elt_t both;
+    Op::process (both, (page_t::elt_t) 1, (page_t::elt_t) 1);
+
+    const hb_codepoint_t *a = sparse_values.arrayZ ();
+    const hb_codepoint_t *b = other->sparse_values.arrayZ ();
+    unsigned int i = 0, j = 0, k = 0;
+    while (i < na && j < nb)
+    {
+      if (a[i] == b[j])
+      {
+	if (both) out[k++] = a[i];
+	i++;
+	j++;
+      }
+      else if (a[i] < b[j])
+      {
+	if (Op::passthru_left) out[k++] = a[i];
+	i++;
+      }
+      else
+      {
+	if (Op::passthru_right) out[k++] = b[j];
+	j++;
+      }
+    }
+    if (Op::passthru_left)
+      for (; i < na; i++) out[k++] = a[i];
+    if (Op::passthru_right)
+      for (; j < nb; j++) out[k++] = b[j];
+
+    if (!sparse_resize (k))
+      return;
+    if (k)
+      memcpy ((void *) sparse_values, (const void *) out, k * sparse_values.item_size);
+    population = k;
+
+    if (k > HB_SET_SPARSE_MAX_LENGTH)
+      densify ();
+  }
+
   page_t *page_for_insert (hb_codepoint_t g)
   {
     page_map_t map = {get_major (g), pages.length};
@@ -29,6 +29,8 @@
 #include "hb-shaper.hh"
 #include "hb-font.hh"
 #include "hb-buffer.hh"
+#include "hb-open-file.hh"
+#include "hb-ot-head-table.hh"
 
 
 /**
@@ -56,7 +58,8 @@ hb_shape_plan_key_t::init (bool                           copy,
 			   unsigned int                   num_user_features,
 			   const int                     *coords,
 			   unsigned int                   num_coords,
-			   const char * const            *shaper_list)
+			   const char * const            *shaper_list,
+			   const hb_ot_shape_plan_key_t  *ot_key)
 {
   hb_feature_t *features = nullptr;
   if (copy && num_user_features && !(features = (hb_feature_t *) calloc (num_user_features, sizeof (hb_feature_t))))
@@ -79,7 +82,10 @@ hb_shape_plan_key_t::init (bool                           copy,
   }
   this->shaper_func = nullptr;
   this->shaper_name = nullptr;
-  this->ot.init (face, coords, num_coords);
+  if (ot_key)
+    this->ot = *ot_key;
+  else
+    this->ot.init (face, coords, num_coords);
 
   /*
    * Choose shaper.
@@ -91,6 +97,7 @@ hb_shape_plan_key_t::init (bool                           copy,
 	  { \
 	    this->shaper_func = _hb_##shaper##_shape; \
 	    this->shaper_name = #shaper; \
+	    this->hash = compute_hash (); \
 	    return true; \
 	  } \
 	} HB_STMT_END
@@ -143,16 +150,195 @@ hb_shape_plan_key_t::user_features_match (const hb_shape_plan_key_t *other)
   return true;
 }
 
+void
+hb_shape_plan_key_t::set_ot (const hb_ot_shape_plan_key_t &ot_)
+{
+  this->ot = ot_;
+  this->hash = compute_hash ();
+}
+
+unsigned int
+hb_shape_plan_key_t::compute_hash () const
+{
+  unsigned int h = hb_segment_properties_hash (&this->props);
+  h = h * 31 + this->num_user_features;
+  for (unsigned int i = 0; i < num_user_features; i++)
+  {
+    const hb_feature_t &feature = this->user_features[i];
+    h = h * 31 + feature.tag;
+    h = h * 31 + feature.value;
+    h = h * 31 + (feature.start == HB_FEATURE_GLOBAL_START &&
+		  feature.end   == HB_FEATURE_GLOBAL_END);
+  }
+  for (unsigned int i = 0; i < ARRAY_LENGTH (this->ot.variations_index); i++)
+    h = h * 31 + this->ot.variations_index[i];
+  h = h * 31 + (unsigned int) (uintptr_t) this->shaper_func;
+  return h ^ (h >> 16);
+}
+
 bool
 hb_shape_plan_key_t::equal (const hb_shape_plan_key_t *other)
 {
-  return hb_segment_properties_equal (&this->props, &other->props) &&
+  return this->hash == other->hash &&
+	 hb_segment_properties_equal (&this->props, &other->props) &&
 	 this->user_features_match (other) &&
 	 this->ot.equal (&other->ot) &&
 	 this->shaper_func == other->shaper_func;
 }
 
 
+/*
+ * hb_face_t::plan_cache_t
+ */
+
+void
+hb_face_t::plan_cache_t::fini ()
+{
+  for (plan_node_t *node = mru; node; )
+  {
+    plan_node_t *next = node->lru_next;
+    hb_shape_plan_destroy (node->shape_plan);
+    ::free (node);
+    node = next;
+  }
+  lock.fini ();
+}
+
+hb_face_t::plan_node_t *
+hb_face_t::plan_cache_t::lookup (const hb_shape_plan_key_t *key, unsigned int hash)
+{
+  for (plan_node_t *node = buckets[hash % BUCKETS]; node; node = node->next)
+    if (node->hash == hash && node->shape_plan->key.equal (key))
+      return node;
+  return nullptr;
+}
+
+void
+hb_face_t::plan_cache_t::lru_unlink (plan_node_t *node)
+{
+  if (node->lru_prev) node->lru_prev->lru_next = node->lru_next; else mru = node->lru_next;
+  if (node->lru_next) node->lru_next->lru_prev = node->lru_prev; else lru = node->lru_prev;
+  node->lru_prev = node->lru_next = nullptr;
+}
+
+void
+hb_face_t::plan_cache_t::lru_push_front (plan_node_t *node)
+{
+  node->lru_prev = nullptr;
+  node->lru_next = mru;
+  if (mru) mru->lru_prev = node; else lru = node;
+  mru = node;
+}
+
+static void
+_hb_shape_plan_destroy_retired (void *p)
+{
+  hb_shape_plan_destroy ((hb_shape_plan_t *) p);
+}
+
+/* Plans found with find_borrowed() may still be in use; they are freed,
+ * along with their node, once the face is not. */
+void
+hb_face_t::plan_cache_t::evict ()
+{
+  while (count > max_count)
+  {
+    plan_node_t *node = lru;
+    lru_unlink (node);
+
+    plan_node_t **link = &buckets[node->hash % BUCKETS];
+    while (*link != node)
+      link = &(*link)->next;
+    *link = node->next;
+
+    count--;
+    DEBUG_MSG_FUNC (SHAPE_PLAN, node->shape_plan, "evicted from cache");
+    node->retired.p = node->shape_plan;
+    node->retired.destroy = _hb_shape_plan_destroy_retired;
+    face->retire (&node->retired);
+  }
+}
+
+hb_shape_plan_t *
+hb_face_t::plan_cache_t::find (const hb_shape_plan_key_t *key)
+{
+  hb_lock_t l (lock);
+  hb_shape_plan_t *shape_plan = touch (key);
+  return shape_plan ? hb_shape_plan_reference (shape_plan) : nullptr;
+}
+
+hb_shape_plan_t *
+hb_face_t::plan_cache_t::find_borrowed (const hb_shape_plan_key_t *key)
+{
+  hb_lock_t l (lock);
+  return touch (key);
+}
+
+/* Looks key up and marks it most recently used; called with the lock held. */
+hb_shape_plan_t *
+hb_face_t::plan_cache_t::touch (const hb_shape_plan_key_t *key)
+{
+  plan_node_t *node = lookup (key, key->hash);
+  if (!node)
+  {
+    misses++;
+    return nullptr;
+  }
+  hits++;
+
+  if (node != mru)
+  {
+    lru_unlink (node);
+    lru_push_front (node);
+  }
+  return node->shape_plan;
+}
+
+hb_shape_plan_t *
+hb_face_t::plan_cache_t::insert (hb_shape_plan_t *shape_plan)
+{
+  hb_lock_t l (lock);
+
+  if (!max_count)
+    return shape_plan;
+
+  unsigned int hash = shape_plan->key.hash;
+  plan_node_t *node = lookup (&shape_plan->key, hash);
+  if (node)
+  {
+    hb_shape_plan_destroy (shape_plan);
+    return hb_shape_plan_reference (node->shape_plan);
+  }
+
+  node = (plan_node_t *) calloc (1, sizeof (plan_node_t));
+  if (unlikely (!node))
+    return shape_plan;
+
+  node->shape_plan = shape_plan;
+  node->hash = hash;
+  node->next = buckets[hash % BUCKETS];
+  buckets[hash % BUCKETS] = node;
+  lru_push_front (node);
+  count++;
+  DEBUG_MSG_FUNC (SHAPE_PLAN, shape_plan, "inserted into cache");
+
+  evict ();
+
+  return hb_shape_plan_reference (shape_plan);
+}
+
+void
+hb_face_t::plan_cache_t::set_max_count (unsigned int max_count_)
+{
+  {
+    hb_lock_t l (lock);
+    max_count = max_count_;
+    evict ();
+  }
+  face->reclaim ();
+}
+
+
 /*
  * hb_shape_plan_t
  */
@@ -185,24 +371,19 @@ hb_shape_plan_create (hb_face_t                     *face,
 				shaper_list);
 }
 
-hb_shape_plan_t *
-hb_shape_plan_create2 (hb_face_t                     *face,
+/* If ot_key is given, it replaces what coords resolve to.  If reader is,
+ * the plan is restored from it instead of being compiled. */
+static hb_shape_plan_t *
+_hb_shape_plan_create (hb_face_t                     *face,
 		       const hb_segment_properties_t *props,
 		       const hb_feature_t            *user_features,
 		       unsigned int                   num_user_features,
 		       const int                     *coords,
 		       unsigned int                   num_coords,
-		       const char * const            *shaper_list)
+		       const char * const            *shaper_list,
+		       const hb_ot_shape_plan_key_t  *ot_key,
+		       hb_plan_reader_t              *reader)
 {
-  DEBUG_MSG_FUNC (SHAPE_PLAN, nullptr,
-		  "face=%p num_features=%d num_coords=%d shaper_list=%p",
-		  face,
-		  num_user_features,
-		  num_coords,
-		  shaper_list);
-
-  assert (props->direction != HB_DIRECTION_INVALID);
-
   hb_shape_plan_t *shape_plan;
 
   if (unlikely (!props))
@@ -222,9 +403,10 @@ hb_shape_plan_create2 (hb_face_t                     *face,
 				       num_user_features,
 				       coords,
 				       num_coords,
-				       shaper_list)))
+				       shaper_list,
+				       ot_key)))
     goto bail2;
-  if (unlikely (!shape_plan->ot.init0 (face, &shape_plan->key)))
+  if (unlikely (!shape_plan->ot.init0 (face, &shape_plan->key, reader)))
     goto bail3;
 
   return shape_plan;
@@ -237,6 +419,31 @@ bail:
   return hb_shape_plan_get_empty ();
 }
 
+hb_shape_plan_t *
+hb_shape_plan_create2 (hb_face_t                     *face,
+		       const hb_segment_properties_t *props,
+		       const hb_feature_t            *user_features,
+		       unsigned int                   num_user_features,
+		       const int                     *coords,
+		       unsigned int                   num_coords,
+		       const char * const            *shaper_list)
+{
+  DEBUG_MSG_FUNC (SHAPE_PLAN, nullptr,
+		  "face=%p num_features=%d num_coords=%d shaper_list=%p",
+		  face,
+		  num_user_features,
+		  num_coords,
+		  shaper_list);
+
+  assert (props->direction != HB_DIRECTION_INVALID);
+
+  return _hb_shape_plan_create (face, props,
+				user_features, num_user_features,
+				coords, num_coords,
+				shaper_list,
+				nullptr, nullptr);
+}
+
 /**
  * hb_shape_plan_get_empty:
  *
@@ -344,6 +551,138 @@ hb_shape_plan_get_shaper (hb_shape_plan_t *shape_plan)
   return shape_plan->key.shaper_name;
 }
 
+/**
+ * hb_shape_plan_get_memory_usage:
+ * @shape_plan: a shape plan.
+ *
+ * Retrieves how much heap memory @shape_plan holds: the plan itself, its
+ * copy of the user features, and the feature and lookup maps.  Data private
+ * to script-specific shapers is not included.
+ *
+ * Return value: heap memory held by @shape_plan, in bytes.
+ *
+ * Since: REPLACEME
+ **/
+unsigned int
+hb_shape_plan_get_memory_usage (hb_shape_plan_t *shape_plan)
+{
+  if (unlikely (hb_object_is_inert (shape_plan)))
+    return 0;
+
+  return sizeof (*shape_plan) +
+	 shape_plan->key.num_user_features * sizeof (hb_feature_t) +
+	 shape_plan->ot.get_memory_usage ();
+}
+
+
+/**
+ * hb_shape_plan_set_lookup_profiling:
+ * @shape_plan: a shape plan.
+ * @enabled: whether to profile.
+ *
+ * Turns on or off the gathering of per-lookup counters by @shape_plan,
+ * for finding out which lookups of a font are expensive.  Counts are
+ * added up over all buffers shaped with the plan, from all threads, and
+ * are read with hb_shape_plan_get_lookup_stats().  Turning profiling off
+ * keeps the counts gathered so far.
+ *
+ * Profiling slows lookups down somewhat; when it is off, it costs nothing.
+ * Only the OpenType shaper's GSUB and GPOS lookups are profiled.
+ *
+ * Return value: %false if @shape_plan is inert or memory for the
+ * counters could not be allocated, %true otherwise.
+ *
+ * Since: REPLACEME
+ **/
+hb_bool_t
+hb_shape_plan_set_lookup_profiling (hb_shape_plan_t *shape_plan,
+				    hb_bool_t        enabled)
+{
+  if (unlikely (hb_object_is_inert (shape_plan)))
+    return false;
+
+  return shape_plan->ot.set_lookup_profiling (enabled);
+}
+
+/**
+ * hb_shape_plan_get_lookup_stats:
+ * @shape_plan: a shape plan.
+ * @start_offset: index of the first entry to return.
+ * @stats_count: (inout) (optional): input length of @stats; output number
+ *   of entries written.
+ * @stats: (out) (array length=stats_count) (optional): the counters.
+ *
+ * Fetches the per-lookup counters gathered since profiling was first
+ * turned on for @shape_plan, or since hb_shape_plan_reset_lookup_stats().
+ * There is one entry for each lookup the plan applies, GSUB then GPOS,
+ * in the order they are applied.
+ *
+ * Return value: total number of entries, zero if profiling was never
+ * turned on.
+ *
+ * Since: REPLACEME
+ **/
+unsigned int
+hb_shape_plan_get_lookup_stats (hb_shape_plan_t              *shape_plan,
+				unsigned int                  start_offset,
+				unsigned int                 *stats_count /* IN/OUT */,
+				hb_shape_plan_lookup_stats_t *stats /* OUT */)
+{
+  hb_ot_lookup_profile_t *profile = shape_plan->ot.lookup_profile.get ();
+  if (!profile)
+  {
+    if (stats_count)
+      *stats_count = 0;
+    return 0;
+  }
+
+  const hb_ot_map_t &map = shape_plan->ot.map;
+  unsigned int total = profile->stats[0].length + profile->stats[1].length;
+  if (stats_count)
+  {
+    unsigned int count = start_offset < total ? MIN (*stats_count, total - start_offset) : 0;
+    hb_lock_t l (profile->lock);
+    for (unsigned int i = 0; i < count; i++)
+    {
+      unsigned int j = start_offset + i;
+      unsigned int table_index = j >= profile->stats[0].length;
+      if (table_index)
+	j -= profile->stats[0].length;
+      const hb_ot_map_t::lookup_stats_t &s = profile->stats[table_index][j];
+      stats[i].table_tag = table_index ? HB_OT_TAG_GPOS : HB_OT_TAG_GSUB;
+      stats[i].lookup_index = map.get_lookup_index (table_index, j);
+      stats[i].positions = s.positions;
+      stats[i].digest_rejects = s.digest_rejects;
+      stats[i].subtable_attempts = s.subtable_attempts;
+      stats[i].applications = s.applications;
+      stats[i].elapsed_ns = s.elapsed_ns;
+    }
+    *stats_count = count;
+  }
+  return total;
+}
+
+/**
+ * hb_shape_plan_reset_lookup_stats:
+ * @shape_plan: a shape plan.
+ *
+ * Zeroes the counters returned by hb_shape_plan_get_lookup_stats().
+ *
+ * Since: REPLACEME
+ **/
+void
+hb_shape_plan_reset_lookup_stats (hb_shape_plan_t *shape_plan)
+{
+  hb_ot_lookup_profile_t *profile = shape_plan->ot.lookup_profile.get ();
+  if (!profile)
+    return;
+
+  hb_lock_t l (profile->lock);
+  for (unsigned int table_index = 0; table_index < 2; table_index++)
+    for (unsigned int i = 0; i < profile->stats[table_index].length; i++)
+      profile->stats[table_index][i] = hb_ot_map_t::lookup_stats_t ();
+}
+
 
 /**
  * hb_shape_plan_execute:
@@ -384,6 +723,19 @@ hb_shape_plan_execute (hb_shape_plan_t    *shape_plan,
   assert (shape_plan->face_unsafe == font->face);
   assert (hb_segment_properties_equal (&shape_plan->key.props, &buffer->props));
 
+  hb_face_use_t use (font->face);
+  return _hb_shape_plan_execute (shape_plan, font, buffer, features, num_features);
+}
+
+/* hb_shape_plan_execute(), minus the checks and the hb_face_use_t guard,
+ * which the caller provides. */
+hb_bool_t
+_hb_shape_plan_execute (hb_shape_plan_t    *shape_plan,
+			hb_font_t          *font,
+			hb_buffer_t        *buffer,
+			const hb_feature_t *features,
+			unsigned int        num_features)
+{
 #define HB_SHAPER_EXECUTE(shaper) \
 	HB_STMT_START { \
 	  return font->data.shaper && \
@@ -435,14 +787,17 @@ hb_shape_plan_create_cached (hb_face_t                     *face,
 				       shaper_list);
 }
 
-hb_shape_plan_t *
-hb_shape_plan_create_cached2 (hb_face_t                     *face,
-			      const hb_segment_properties_t *props,
-			      const hb_feature_t            *user_features,
-			      unsigned int                   num_user_features,
-			      const int                     *coords,
-			      unsigned int                   num_coords,
-			      const char * const            *shaper_list)
+static hb_shape_plan_t *
+_hb_shape_plan_get_cached_or_create (hb_face_t                     *face,
+				     const hb_segment_properties_t *props,
+				     const hb_feature_t            *user_features,
+				     unsigned int                   num_user_features,
+				     const int                     *coords,
+				     unsigned int                   num_coords,
+				     const char * const            *shaper_list,
+				     const hb_ot_shape_plan_key_t  *ot_key,
+				     bool                           borrow,
+				     hb_shape_plan_t              **created)
 {
   DEBUG_MSG_FUNC (SHAPE_PLAN, nullptr,
 		  "face=%p num_features=%d shaper_list=%p",
@@ -450,9 +805,7 @@ hb_shape_plan_create_cached2 (hb_face_t                     *face,
 		  num_user_features,
 		  shaper_list);
 
-retry:
-  hb_face_t::plan_node_t *cached_plan_nodes = face->shape_plans;
-
+  *created = nullptr;
   bool dont_cache = hb_object_is_inert (face);
 
   if (likely (!dont_cache))
@@ -465,39 +818,1184 @@ retry:
 		   num_user_features,
 		   coords,
 		   num_coords,
-		   shaper_list))
+		   shaper_list,
+		   ot_key))
       return hb_shape_plan_get_empty ();
 
-    for (hb_face_t::plan_node_t *node = cached_plan_nodes; node; node = node->next)
-      if (node->shape_plan->key.equal (&key))
-      {
-        DEBUG_MSG_FUNC (SHAPE_PLAN, node->shape_plan, "fulfilled from cache");
-        return hb_shape_plan_reference (node->shape_plan);
-      }
+    hb_shape_plan_t *cached = borrow ? face->shape_plans.find_borrowed (&key)
+				     : face->shape_plans.find (&key);
+    if (cached)
+    {
+      DEBUG_MSG_FUNC (SHAPE_PLAN, cached, "fulfilled from cache");
+      return cached;
+    }
   }
 
-  hb_shape_plan_t *shape_plan = hb_shape_plan_create2 (face, props,
+  assert (props->direction != HB_DIRECTION_INVALID);
+  hb_shape_plan_t *shape_plan = _hb_shape_plan_create (face, props,
 						       user_features, num_user_features,
 						       coords, num_coords,
-						       shaper_list);
+						       shaper_list,
+						       ot_key, nullptr);
 
-  if (unlikely (dont_cache))
-    return shape_plan;
+  /* Another thread may have inserted an equal plan meanwhile; in that case
+   * ours is dropped and theirs returned. */
+  if (likely (!dont_cache && !hb_object_is_inert (shape_plan)))
+    shape_plan = face->shape_plans.insert (shape_plan);
 
-  hb_face_t::plan_node_t *node = (hb_face_t::plan_node_t *) calloc (1, sizeof (hb_face_t::plan_node_t));
-  if (unlikely (!node))
+  *created = shape_plan;
+  return shape_plan;
+}
+
+hb_shape_plan_t *
+hb_shape_plan_create_cached2 (hb_face_t                     *face,
+			      const hb_segment_properties_t *props,
+			      const hb_feature_t            *user_features,
+			      unsigned int                   num_user_features,
+			      const int                     *coords,
+			      unsigned int                   num_coords,
+			      const char * const            *shaper_list)
+{
+  hb_shape_plan_t *created;
+  hb_shape_plan_t *shape_plan = _hb_shape_plan_get_cached_or_create (face, props,
+								     user_features, num_user_features,
+								     coords, num_coords,
+								     shaper_list,
+								     nullptr, false, &created);
+  /* Plans evicted making room for ours wait for the face to be unused. */
+  if (unlikely (face->retired.get ()))
+    face->reclaim ();
+  return shape_plan;
+}
+
+/* hb_shape_plan_create_cached2() for the face and coords of @font, but the
+ * plan returned is borrowed: it stays valid while the caller holds a
+ * hb_face_use_t on the face.  If no plan was cached, the one created is
+ * returned in @created too, and is then the caller's to destroy; otherwise
+ * @created is set to nullptr.  This spares shaping a shared face the
+ * reference count traffic on its plans.
+ *
+ * The feature variations the coords select are cached on the font until
+ * its coords change, so looking the plan up does not evaluate the
+ * FeatureVariations conditions every time. */
+hb_shape_plan_t *
+_hb_shape_plan_get_cached (hb_font_t                     *font,
+			   const hb_segment_properties_t *props,
+			   const hb_feature_t            *user_features,
+			   unsigned int                   num_user_features,
+			   const char * const            *shaper_list,
+			   hb_shape_plan_t              **created)
+{
+  hb_ot_shape_plan_key_t ot_key;
+  int serial = (int) font->serial_coords + 1;
+  if (font->variations_serial.get () == serial)
+  {
+    ot_key.variations_index[0] = font->variations_index[0].get_relaxed ();
+    ot_key.variations_index[1] = font->variations_index[1].get_relaxed ();
+  }
+  else
+  {
+    ot_key.init (font->face, font->coords, font->num_coords);
+    if (likely (!hb_object_is_inert (font)))
+    {
+      /* Other threads can only be storing the same. */
+      font->variations_index[0].set_relaxed (ot_key.variations_index[0]);
+      font->variations_index[1].set_relaxed (ot_key.variations_index[1]);
+      font->variations_serial.set (serial);
+    }
+  }
+
+  return _hb_shape_plan_get_cached_or_create (font->face, props,
+					      user_features, num_user_features,
+					      font->coords, font->num_coords,
+					      shaper_list,
+					      &ot_key, true, created);
+}
+
+
+/*
+ * Serialization.
+ */
+
+#define HB_SHAPE_PLAN_BLOB_MAGIC HB_TAG ('H','B','S','P')
+#define HB_SHAPE_PLAN_BLOB_FORMAT 1
+
+/* Identifies the build that wrote a blob: the layout of the compiled plan
+ * is copied as is. */
+struct hb_shape_plan_blob_header_t
+{
+  hb_tag_t magic;
+  unsigned int format;
+  unsigned int version[3];
+  unsigned int sizes[4];
+  unsigned int face_hash;
+
+  void init (hb_face_t *face)
+  {
+    memset (this, 0, sizeof (*this));
+    magic = HB_SHAPE_PLAN_BLOB_MAGIC;
+    format = HB_SHAPE_PLAN_BLOB_FORMAT;
+    version[0] = HB_VERSION_MAJOR;
+    version[1] = HB_VERSION_MINOR;
+    version[2] = HB_VERSION_MICRO;
+    sizes[0] = sizeof (hb_ot_map_t::feature_map_t);
+    sizes[1] = sizeof (hb_ot_map_t::lookup_map_t);
+    sizes[2] = sizeof (hb_set_digest_t);
+    sizes[3] = sizeof (hb_feature_t);
+    face_hash = compute_face_hash (face);
+  }
+
+  bool equal (const hb_shape_plan_blob_header_t *other) const
+  { return 0 == memcmp (this, other, sizeof (*this)); }
+
+  private:
+  /* Of the tables compiling a plan reads.  Hashing them is as slow as
+   * reading them all, so it is done once per face. */
+  static unsigned int compute_face_hash (hb_face_t *face)
+  {
+    unsigned int cached = face->plan_blob_hash.get_relaxed ();
+    if (cached)
+      return cached;
+
+    static const hb_tag_t tags[] = {
+      HB_OT_TAG_GSUB, HB_OT_TAG_GPOS, HB_OT_TAG_GDEF,
+      HB_TAG ('m','o','r','x'), HB_TAG ('m','o','r','t'),
+      HB_TAG ('k','e','r','x'), HB_TAG ('k','e','r','n'),
+      HB_TAG ('t','r','a','k'), HB_TAG ('f','e','a','t'),
+    };
+    unsigned int h = face->get_num_glyphs ();
+    for (unsigned int i = 0; i < ARRAY_LENGTH (tags); i++)
+    {
+      hb_blob_t *blob = face->reference_table (tags[i]);
+      unsigned int length = hb_blob_get_length (blob);
+      const uint8_t *data = (const uint8_t *) hb_blob_get_data (blob, nullptr);
+      h = h * 31 + tags[i];
+      h = h * 31 + length;
+      unsigned int j = 0;
+      for (; j + 4 <= length; j += 4)
+      {
+	uint32_t v;
+	memcpy (&v, data + j, 4);
+	h = h * 31 + v;
+      }
+      for (; j < length; j++)
+	h = h * 31 + data[j];
+      hb_blob_destroy (blob);
+    }
+    h = (h ^ (h >> 16)) | 1; /* Never zero. */
+    if (!hb_object_is_inert (face))
+      face->plan_blob_hash.set_relaxed (h);
+    return h;
+  }
+};
+
+/**
+ * hb_shape_plan_serialize:
+ * @shape_plan: a shape plan.
+ *
+ * Saves the compiled form of @shape_plan, along with the face properties,
+ * user features and variations it was created for, so that
+ * hb_shape_plan_deserialize() can recreate it without compiling it again.
+ * Meant for short-lived processes that shape with the same fonts over and
+ * over.
+ *
+ * The blob is only valid for the same build of HarfBuzz, and for a face
+ * with the same layout tables; it is not a storage format.
+ *
+ * Return value: (transfer full): the serialized plan, or the empty blob if
+ * @shape_plan is inert or memory ran out.
+ *
+ * Since: REPLACEME
+ **/
+hb_blob_t *
+hb_shape_plan_serialize (hb_shape_plan_t *shape_plan)
+{
+  if (unlikely (hb_object_is_inert (shape_plan)))
+    return hb_blob_get_empty ();
+
+  const hb_shape_plan_key_t &key = shape_plan->key;
+  hb_plan_writer_t w;
+
+  hb_shape_plan_blob_header_t header;
+  header.init (shape_plan->face_unsafe);
+  w.write (header);
+
+  unsigned int shaper_name_length = strlen (key.shaper_name);
+  w.write (shaper_name_length);
+  w.write (key.shaper_name, shaper_name_length);
+
+  const char *language = hb_language_to_string (key.props.language);
+  unsigned int language_length = language ? strlen (language) : 0;
+  w.write ((unsigned int) key.props.direction);
+  w.write ((unsigned int) key.props.script);
+  w.write (language_length);
+  w.write (language, language_length);
+
+  w.write (key.num_user_features);
+  w.write (key.user_features, key.num_user_features * sizeof (hb_feature_t));
+  w.write (key.ot);
+
+  shape_plan->ot.serialize (&w);
+
+  if (unlikely (w.in_error ()))
+    return hb_blob_get_empty ();
+
+  unsigned int length = w.bytes.length;
+  char *data = (char *) malloc (length);
+  if (unlikely (!data))
+    return hb_blob_get_empty ();
+  memcpy (data, w.bytes.arrayZ (), length);
+  return hb_blob_create (data, length, HB_MEMORY_MODE_WRITABLE, data, free);
+}
+
+/**
+ * hb_shape_plan_deserialize:
+ * @face: the face @blob was serialized for.
+ * @blob: a blob made by hb_shape_plan_serialize().
+ *
+ * Recreates a shape plan saved by hb_shape_plan_serialize(), without
+ * compiling it, and adds it to the shape plan cache of @face, as
+ * hb_shape_plan_create_cached2() would; hb_shape() and friends then use it.
+ * If an equal plan is cached already, that one is returned.
+ *
+ * Fails if @blob was written by another build of HarfBuzz, for a face whose
+ * layout tables differ from those of @face, or if it is corrupt.
+ *
+ * Return value: (transfer full): the shape plan, or the empty shape plan
+ * on failure.
+ *
+ * Since: REPLACEME
+ **/
+hb_shape_plan_t *
+hb_shape_plan_deserialize (hb_face_t *face,
+			   hb_blob_t *blob)
+{
+  if (unlikely (!face))
+    face = hb_face_get_empty ();
+
+  unsigned int length;
+  const char *data = hb_blob_get_data (blob, &length);
+  hb_plan_reader_t r (data, length);
+
+  hb_shape_plan_blob_header_t header, expected;
+  if (!r.read (&header))
+    return hb_shape_plan_get_empty ();
+  expected.init (face);
+  if (!header.equal (&expected))
+  {
+    DEBUG_MSG_FUNC (SHAPE_PLAN, nullptr, "blob is for another build or face");
+    return hb_shape_plan_get_empty ();
+  }
+
+  char shaper_name[32];
+  unsigned int shaper_name_length;
+  if (!r.read (&shaper_name_length) ||
+      shaper_name_length >= sizeof (shaper_name) ||
+      !r.read (shaper_name, shaper_name_length))
+    return hb_shape_plan_get_empty ();
+  shaper_name[shaper_name_length] = '\0';
+  const char * const shaper_list[] = {shaper_name, nullptr};
+
+  /* Enums are read as integers, and only converted once validated. */
+  hb_segment_properties_t props = HB_SEGMENT_PROPERTIES_DEFAULT;
+  unsigned int direction, script;
+  char language[64];
+  unsigned int language_length;
+  if (!r.read (&direction) ||
+      !r.read (&script) ||
+      !r.read (&language_length) ||
+      language_length >= sizeof (language) ||
+      !r.read (language, language_length))
+    return hb_shape_plan_get_empty ();
+  if (!HB_DIRECTION_IS_VALID (direction))
+    return hb_shape_plan_get_empty ();
+  /* hb_language_to_string() wrote it out canonical. */
+  for (unsigned int i = 0; i < language_length; i++)
+    if (!ISALNUM (language[i]) && language[i] != '-')
+      return hb_shape_plan_get_empty ();
+  props.direction = (hb_direction_t) direction;
+  props.script = hb_script_from_iso15924_tag (script);
+  props.language = language_length ? hb_language_from_string (language, language_length) : HB_LANGUAGE_INVALID;
+  if (unlikely (language_length && !props.language))
+    return hb_shape_plan_get_empty ();
+
+  hb_vector_t<hb_feature_t> user_features;
+  hb_ot_shape_plan_key_t ot_key;
+  if (!r.read_array (user_features) ||
+      !r.read (&ot_key))
+    return hb_shape_plan_get_empty ();
+
+  /* The rest of the blob is read even if an equal plan is cached, so that
+   * only whole blobs are accepted; inserting returns the cached one. */
+  bool dont_cache = hb_object_is_inert (face);
+
+  hb_shape_plan_t *shape_plan = _hb_shape_plan_create (face, &props,
+						       user_features.arrayZ (),
+						       user_features.length,
+						       nullptr, 0,
+						       shaper_list,
+						       &ot_key, &r);
+
+  if (unlikely (dont_cache || hb_object_is_inert (shape_plan)))
     return shape_plan;
 
-  node->shape_plan = shape_plan;
-  node->next = cached_plan_nodes;
+  return face->shape_plans.insert (shape_plan);
+}
+
+
+/*
+ * Shape cache.
+ */
 
-  if (unlikely (!face->shape_plans.cmpexch (cached_plan_nodes, node)))
+#ifndef HB_SHAPE_CACHE_MAX_LENGTH
+#define HB_SHAPE_CACHE_MAX_LENGTH 64
+#endif
+
+/* What shaping a buffer depends on, besides the plan: some of the font's
+ * and buffer's state, and the text.  Entries copy this, followed by the
+ * arrays; lookups point these at the font and buffer instead. */
+struct hb_shape_cache_key_t
+{
+  hb_shape_plan_t *plan;
+  hb_font_t *font;
+  hb_font_funcs_t *klass;
+  void *font_data;
+  int x_scale, y_scale;
+  unsigned int x_ppem, y_ppem;
+  float ptem;
+  hb_unicode_funcs_t *unicode;
+  hb_buffer_flags_t flags;
+  hb_buffer_cluster_level_t cluster_level;
+  hb_codepoint_t replacement;
+  hb_codepoint_t invisible;
+  unsigned int num_coords;
+  unsigned int len;
+  unsigned int context_len[2];
+  unsigned int hash; /* Of all the above and the arrays. */
+
+  void init (hb_shape_plan_t *plan_, hb_font_t *font_, hb_buffer_t *buffer)
   {
-    hb_shape_plan_destroy (shape_plan);
-    free (node);
-    goto retry;
+    plan = plan_;
+    font = font_;
+    klass = font->klass;
+    font_data = font->user_data;
+    x_scale = font->x_scale;
+    y_scale = font->y_scale;
+    x_ppem = font->x_ppem;
+    y_ppem = font->y_ppem;
+    ptem = font->ptem;
+    unicode = buffer->unicode;
+    flags = buffer->flags;
+    cluster_level = buffer->cluster_level;
+    replacement = buffer->replacement;
+    invisible = buffer->invisible;
+    num_coords = font->num_coords;
+    len = buffer->len;
+    context_len[0] = buffer->context_len[0];
+    context_len[1] = buffer->context_len[1];
   }
-  DEBUG_MSG_FUNC (SHAPE_PLAN, shape_plan, "inserted into cache");
 
-  return hb_shape_plan_reference (shape_plan);
+  unsigned int num_values () const
+  { return num_coords + 2 * len + context_len[0] + context_len[1]; }
+
+  bool equal (const hb_shape_cache_key_t *o) const
+  {
+    return hash == o->hash &&
+	   plan == o->plan && font == o->font &&
+	   klass == o->klass && font_data == o->font_data &&
+	   x_scale == o->x_scale && y_scale == o->y_scale &&
+	   x_ppem == o->x_ppem && y_ppem == o->y_ppem &&
+	   ptem == o->ptem &&
+	   unicode == o->unicode && flags == o->flags &&
+	   cluster_level == o->cluster_level &&
+	   replacement == o->replacement && invisible == o->invisible &&
+	   num_coords == o->num_coords && len == o->len &&
+	   context_len[0] == o->context_len[0] &&
+	   context_len[1] == o->context_len[1];
+  }
+};
+
+/* With the text as: coords, codepoints, clusters relative to the first
+ * one, pre-context, post-context; then the shaped glyphs. */
+struct hb_shape_cache_entry_t
+{
+  hb_shape_cache_entry_t *hash_next;
+  hb_shape_cache_entry_t *lru_prev;
+  hb_shape_cache_entry_t *lru_next;
+  hb_shape_cache_key_t key;
+  unsigned int num_glyphs;
+
+  uint32_t *key_values () { return (uint32_t *) (this + 1); }
+  hb_glyph_info_t *infos ()
+  { return (hb_glyph_info_t *) (key_values () + key.num_values ()); }
+  hb_glyph_position_t *positions ()
+  { return (hb_glyph_position_t *) (infos () + num_glyphs); }
+};
+
+struct hb_shape_cache_t
+{
+  hb_object_header_t header;
+
+  hb_mutex_t lock;
+  hb_shape_cache_entry_t **buckets;
+  unsigned int bucket_mask;
+  hb_shape_cache_entry_t lru; /* Sentinel; lru.lru_next is the newest. */
+  unsigned int num_entries;
+  unsigned int max_entries;
+  unsigned int hits;
+  unsigned int misses;
+};
+
+/* Returns the hash of @key, whose text part is @values. */
+static unsigned int
+_hb_shape_cache_key_hash (const hb_shape_cache_key_t *key,
+			  const uint32_t *values)
+{
+  const uint32_t *p = values + key->num_values ();
+  unsigned int h = (unsigned int) (uintptr_t) key->plan;
+  h = h * 31 + (unsigned int) (uintptr_t) key->font;
+  h = h * 31 + (unsigned int) (uintptr_t) key->klass;
+  h = h * 31 + (unsigned int) (uintptr_t) key->font_data;
+  h = h * 31 + key->x_scale;
+  h = h * 31 + key->y_scale;
+  h = h * 31 + key->x_ppem;
+  h = h * 31 + key->y_ppem;
+  h = h * 31 + key->flags;
+  h = h * 31 + key->cluster_level;
+  h = h * 31 + key->len;
+  for (const uint32_t *q = values; q < p; q++)
+    h = h * 31 + *q;
+  return h;
+}
+
+/* Writes the text part of the key, for @buffer whose first cluster is
+ * @base, to @values; returns the hash of the whole key. */
+static unsigned int
+_hb_shape_cache_key_values (const hb_shape_cache_key_t *key,
+			    const hb_font_t *font, const hb_buffer_t *buffer,
+			    uint32_t *values)
+{
+  uint32_t *p = values;
+  for (unsigned int i = 0; i < key->num_coords; i++)
+    *p++ = font->coords[i];
+  uint32_t base = buffer->info[0].cluster;
+  for (unsigned int i = 0; i < key->len; i++)
+    *p++ = buffer->info[i].codepoint;
+  for (unsigned int i = 0; i < key->len; i++)
+    *p++ = buffer->info[i].cluster - base;
+  for (unsigned int i = 0; i < key->context_len[0]; i++)
+    *p++ = buffer->context[0][i];
+  for (unsigned int i = 0; i < key->context_len[1]; i++)
+    *p++ = buffer->context[1][i];
+
+  return _hb_shape_cache_key_hash (key, values);
+}
+
+static void
+_hb_shape_cache_unlink (hb_shape_cache_t *cache, hb_shape_cache_entry_t *entry)
+{
+  hb_shape_cache_entry_t **slot = &cache->buckets[entry->key.hash & cache->bucket_mask];
+  while (*slot != entry)
+    slot = &(*slot)->hash_next;
+  *slot = entry->hash_next;
+  entry->lru_prev->lru_next = entry->lru_next;
+  entry->lru_next->lru_prev = entry->lru_prev;
+  cache->num_entries--;
+}
+
+static void
+_hb_shape_cache_link_front (hb_shape_cache_t *cache, hb_shape_cache_entry_t *entry)
+{
+  entry->lru_prev = &cache->lru;
+  entry->lru_next = cache->lru.lru_next;
+  entry->lru_next->lru_prev = entry;
+  cache->lru.lru_next = entry;
+}
+
+/* Adds @entry as the newest one, under the lock, unless an equal entry is
+ * there already.  Returns what to free: @entry in that case, or the entry
+ * evicted to make room, if any; its lru_next is nullptr. */
+static hb_shape_cache_entry_t *
+_hb_shape_cache_insert (hb_shape_cache_t *cache, hb_shape_cache_entry_t *entry)
+{
+  unsigned int num_values = entry->key.num_values ();
+  hb_shape_cache_entry_t **slot = &cache->buckets[entry->key.hash & cache->bucket_mask];
+  for (hb_shape_cache_entry_t *other = *slot; other; other = other->hash_next)
+    if (other->key.equal (&entry->key) &&
+	0 == memcmp (other->key_values (), entry->key_values (), num_values * sizeof (uint32_t)))
+    {
+      /* Another thread got here first. */
+      entry->lru_next = nullptr;
+      return entry;
+    }
+
+  hb_shape_cache_entry_t *evicted = nullptr;
+  if (cache->num_entries == cache->max_entries)
+  {
+    evicted = cache->lru.lru_prev;
+    _hb_shape_cache_unlink (cache, evicted);
+    evicted->lru_next = nullptr;
+  }
+  entry->hash_next = *slot;
+  *slot = entry;
+  _hb_shape_cache_link_front (cache, entry);
+  cache->num_entries++;
+  return evicted;
+}
+
+/* Frees a chain of entries linked through lru_next, ending in nullptr. */
+static void
+_hb_shape_cache_free_entries (hb_shape_cache_entry_t *entry)
+{
+  while (entry)
+  {
+    hb_shape_cache_entry_t *next = entry->lru_next;
+    hb_shape_plan_destroy (entry->key.plan);
+    hb_font_destroy (entry->key.font);
+    free (entry);
+    entry = next;
+  }
+}
+
+/**
+ * hb_shape_cache_create: (Xconstructor)
+ * @max_entries: most shaped runs to keep.
+ *
+ * Creates a cache of shaping results, for hb_shape_cache_shape() to look
+ * runs up in before shaping them, evicting the least recently used of up
+ * to @max_entries runs.  The cache may be used from several threads at
+ * once, and with any number of fonts.
+ *
+ * Return value: (transfer full): a new cache.
+ *
+ * Since: REPLACEME
+ **/
+hb_shape_cache_t *
+hb_shape_cache_create (unsigned int max_entries)
+{
+  hb_shape_cache_t *cache;
+
+  if (!max_entries || !(cache = hb_object_create<hb_shape_cache_t> ()))
+    return hb_shape_cache_get_empty ();
+
+  unsigned int num_buckets = 1;
+  while (num_buckets < max_entries && num_buckets < 0x40000000u)
+    num_buckets <<= 1;
+  cache->buckets = (hb_shape_cache_entry_t **) calloc (num_buckets, sizeof (cache->buckets[0]));
+  if (unlikely (!cache->buckets))
+  {
+    free (cache);
+    return hb_shape_cache_get_empty ();
+  }
+
+  cache->lock.init ();
+  cache->bucket_mask = num_buckets - 1;
+  cache->lru.lru_prev = cache->lru.lru_next = &cache->lru;
+  cache->max_entries = max_entries;
+
+  return cache;
+}
+
+/**
+ * hb_shape_cache_get_empty:
+ *
+ * Return value: (transfer full): the empty cache, which keeps nothing.
+ *
+ * Since: REPLACEME
+ **/
+hb_shape_cache_t *
+hb_shape_cache_get_empty ()
+{
+  return const_cast<hb_shape_cache_t *> (&Null(hb_shape_cache_t));
+}
+
+/**
+ * hb_shape_cache_reference: (skip)
+ * @cache: a shape cache.
+ *
+ * Return value: (transfer full): @cache.
+ *
+ * Since: REPLACEME
+ **/
+hb_shape_cache_t *
+hb_shape_cache_reference (hb_shape_cache_t *cache)
+{
+  return hb_object_reference (cache);
+}
+
+/**
+ * hb_shape_cache_destroy: (skip)
+ * @cache: a shape cache.
+ *
+ * Drops a reference to @cache, freeing its runs, and the references they
+ * hold on fonts and shape plans, once the last reference is gone.
+ *
+ * Since: REPLACEME
+ **/
+void
+hb_shape_cache_destroy (hb_shape_cache_t *cache)
+{
+  if (!hb_object_destroy (cache)) return;
+
+  hb_shape_cache_clear (cache);
+  free (cache->buckets);
+  cache->lock.fini ();
+
+  free (cache);
+}
+
+/**
+ * hb_shape_cache_clear:
+ * @cache: a shape cache.
+ *
+ * Drops all the runs in @cache, releasing the fonts they refer to.
+ *
+ * Since: REPLACEME
+ **/
+void
+hb_shape_cache_clear (hb_shape_cache_t *cache)
+{
+  if (unlikely (hb_object_is_inert (cache)))
+    return;
+
+  hb_shape_cache_entry_t *entries;
+  {
+    hb_lock_t l (cache->lock);
+    entries = cache->lru.lru_next;
+    cache->lru.lru_prev->lru_next = nullptr;
+    if (entries == &cache->lru)
+      entries = nullptr;
+    cache->lru.lru_prev = cache->lru.lru_next = &cache->lru;
+    memset (cache->buckets, 0, (cache->bucket_mask + 1) * sizeof (cache->buckets[0]));
+    cache->num_entries = 0;
+  }
+  _hb_shape_cache_free_entries (entries);
+}
+
+/**
+ * hb_shape_cache_get_stats:
+ * @cache: a shape cache.
+ * @hits: (out) (optional): number of runs found in @cache.
+ * @misses: (out) (optional): number of runs shaped and added to @cache.
+ *
+ * Reports how well @cache has been doing since it was created.
+ *
+ * Return value: number of runs in @cache.
+ *
+ * Since: REPLACEME
+ **/
+unsigned int
+hb_shape_cache_get_stats (hb_shape_cache_t *cache,
+			  unsigned int     *hits,
+			  unsigned int     *misses)
+{
+  if (unlikely (hb_object_is_inert (cache)))
+  {
+    if (hits) *hits = 0;
+    if (misses) *misses = 0;
+    return 0;
+  }
+
+  hb_lock_t l (cache->lock);
+  if (hits) *hits = cache->hits;
+  if (misses) *misses = cache->misses;
+  return cache->num_entries;
+}
+
+/**
+ * hb_shape_cache_shape:
+ * @cache: a shape cache.
+ * @font: an #hb_font_t to use for shaping
+ * @buffer: an #hb_buffer_t to shape
+ * @features: (array length=num_features) (allow-none): an array of user
+ *    specified #hb_feature_t or %NULL
+ * @num_features: the length of @features array
+ * @shaper_list: (array zero-terminated=1) (allow-none): a %NULL-terminated
+ *    array of shapers to use or %NULL
+ *
+ * Same as hb_shape_full(), except that the result is taken from @cache if
+ * the same text, with the same context and cluster values relative to the
+ * first one, was shaped with the same shape plan and font settings before.
+ * New results are added to @cache.
+ *
+ * Long runs (over 64 characters by default), runs with features that do
+ * not apply to the whole buffer, and buffers with a message function are
+ * shaped without @cache.  Changes to the font's functions' own data are not
+ * noticed; clear @cache after making any.
+ *
+ * Return value: false if all shapers failed, true otherwise
+ *
+ * Since: REPLACEME
+ **/
+hb_bool_t
+hb_shape_cache_shape (hb_shape_cache_t   *cache,
+		      hb_font_t          *font,
+		      hb_buffer_t        *buffer,
+		      const hb_feature_t *features,
+		      unsigned int        num_features,
+		      const char * const *shaper_list)
+{
+  bool cacheable = !hb_object_is_inert (cache) &&
+		   buffer->len && buffer->len <= HB_SHAPE_CACHE_MAX_LENGTH &&
+		   buffer->content_type == HB_BUFFER_CONTENT_TYPE_UNICODE &&
+		   !buffer->have_output && !buffer->messaging () &&
+		   font->num_coords <= HB_SHAPE_CACHE_MAX_LENGTH;
+  for (unsigned int i = 0; cacheable && i < num_features; i++)
+    cacheable = features[i].start == HB_FEATURE_GLOBAL_START &&
+		features[i].end == HB_FEATURE_GLOBAL_END;
+  if (!cacheable)
+    return hb_shape_full (font, buffer, features, num_features, shaper_list);
+
+  hb_shape_plan_t *plan = hb_shape_plan_create_cached2 (font->face, &buffer->props,
+							features, num_features,
+							font->coords, font->num_coords,
+							shaper_list);
+
+  hb_shape_cache_key_t key;
+  key.init (plan, font, buffer);
+  uint32_t values[HB_SHAPE_CACHE_MAX_LENGTH * 3 + 2 * hb_buffer_t::CONTEXT_LENGTH];
+  key.hash = _hb_shape_cache_key_values (&key, font, buffer, values);
+  unsigned int num_values = key.num_values ();
+  uint32_t base = buffer->info[0].cluster;
+
+  {
+    hb_lock_t l (cache->lock);
+    for (hb_shape_cache_entry_t *entry = cache->buckets[key.hash & cache->bucket_mask];
+	 entry; entry = entry->hash_next)
+    {
+      if (!entry->key.equal (&key) ||
+	  0 != memcmp (entry->key_values (), values, num_values * sizeof (values[0])))
+        continue;
+
+      if (unlikely (!buffer->ensure (entry->num_glyphs)))
+	break;
+      memcpy (buffer->info, entry->infos (), entry->num_glyphs * sizeof (buffer->info[0]));
+      memcpy (buffer->pos, entry->positions (), entry->num_glyphs * sizeof (buffer->pos[0]));
+      for (unsigned int i = 0; i < entry->num_glyphs; i++)
+	buffer->info[i].cluster += base;
+      buffer->len = entry->num_glyphs;
+      buffer->have_positions = true;
+      buffer->content_type = HB_BUFFER_CONTENT_TYPE_GLYPHS;
+
+      entry->lru_prev->lru_next = entry->lru_next;
+      entry->lru_next->lru_prev = entry->lru_prev;
+      _hb_shape_cache_link_front (cache, entry);
+      cache->hits++;
+
+      hb_shape_plan_destroy (plan);
+      return true;
+    }
+  }
+
+  if (unlikely (!hb_shape_plan_execute (plan, font, buffer, features, num_features)))
+  {
+    hb_shape_plan_destroy (plan);
+    return false;
+  }
+  buffer->content_type = HB_BUFFER_CONTENT_TYPE_GLYPHS;
+  if (unlikely (!buffer->successful || hb_object_is_inert (plan)))
+  {
+    hb_shape_plan_destroy (plan);
+    return true;
+  }
+
+  unsigned int num_glyphs = buffer->len;
+  hb_shape_cache_entry_t *entry = (hb_shape_cache_entry_t *)
+    malloc (sizeof (hb_shape_cache_entry_t) +
+	    num_values * sizeof (values[0]) +
+	    num_glyphs * (sizeof (hb_glyph_info_t) + sizeof (hb_glyph_position_t)));
+  if (unlikely (!entry))
+  {
+    hb_shape_plan_destroy (plan);
+    return true;
+  }
+  entry->key = key;
+  entry->key.font = hb_font_reference (font);
+  entry->num_glyphs = num_glyphs;
+  memcpy (entry->key_values (), values, num_values * sizeof (values[0]));
+  memcpy (entry->infos (), buffer->info, num_glyphs * sizeof (buffer->info[0]));
+  memcpy (entry->positions (), buffer->pos, num_glyphs * sizeof (buffer->pos[0]));
+  hb_glyph_info_t *infos = entry->infos ();
+  for (unsigned int i = 0; i < num_glyphs; i++)
+    infos[i].cluster -= base;
+
+  /* Plan and font references now belong to the entry. */
+  hb_shape_cache_entry_t *evicted;
+  {
+    hb_lock_t l (cache->lock);
+    evicted = _hb_shape_cache_insert (cache, entry);
+    cache->misses++;
+  }
+  _hb_shape_cache_free_entries (evicted);
+
+  return true;
+}
+
+
+/*
+ * Shape cache serialization.
+ */
+
+#define HB_SHAPE_CACHE_BLOB_MAGIC HB_TAG ('H','B','S','C')
+#define HB_SHAPE_CACHE_BLOB_FORMAT 1
+
+#define HB_SHAPE_CACHE_KNOWN_FLAGS \
+  (HB_BUFFER_FLAG_BOT | HB_BUFFER_FLAG_EOT | \
+   HB_BUFFER_FLAG_PRESERVE_DEFAULT_IGNORABLES | \
+   HB_BUFFER_FLAG_REMOVE_DEFAULT_IGNORABLES)
+
+/* An entry of a serialized cache: its key, less what
+ * hb_shape_cache_deserialize() takes from the font, then its arrays. */
+struct hb_shape_cache_record_t
+{
+  unsigned int plan_index;
+  int x_scale, y_scale;
+  unsigned int x_ppem, y_ppem;
+  float ptem;
+  unsigned int flags;		/* hb_buffer_flags_t, once validated. */
+  unsigned int cluster_level;	/* hb_buffer_cluster_level_t, likewise. */
+  hb_codepoint_t replacement;
+  hb_codepoint_t invisible;
+  unsigned int num_coords;
+  unsigned int len;
+  unsigned int context_len[2];
+  unsigned int num_glyphs;
+};
+
+/* Identifies the build that wrote a blob, as the shape plan header does,
+ * and the font file whose results it holds. */
+struct hb_shape_cache_blob_header_t
+{
+  hb_tag_t magic;
+  unsigned int format;
+  unsigned int version[3];
+  unsigned int sizes[3];
+  unsigned int face_hash;
+
+  void init (hb_face_t *face)
+  {
+    memset (this, 0, sizeof (*this));
+    magic = HB_SHAPE_CACHE_BLOB_MAGIC;
+    format = HB_SHAPE_CACHE_BLOB_FORMAT;
+    version[0] = HB_VERSION_MAJOR;
+    version[1] = HB_VERSION_MINOR;
+    version[2] = HB_VERSION_MICRO;
+    sizes[0] = sizeof (hb_glyph_info_t);
+    sizes[1] = sizeof (hb_glyph_position_t);
+    sizes[2] = sizeof (hb_shape_cache_record_t);
+    face_hash = compute_face_hash (face);
+  }
+
+  bool equal (const hb_shape_cache_blob_header_t *other) const
+  { return 0 == memcmp (this, other, sizeof (*this)); }
+
+  private:
+  /* Of the whole font, not just its layout tables: the head checksum
+   * adjustment and the table directory, with the checksum of each table.
+   * Faces not made from a font file hash their table lengths instead. */
+  static unsigned int compute_face_hash (hb_face_t *face)
+  {
+    unsigned int h = face->get_num_glyphs ();
+    h = h * 31 + face->get_upem ();
+    h = h * 31 + face->table.head->get_checksum_adjustment ();
+
+    hb_blob_t *blob = hb_face_reference_blob (face);
+    const OT::OpenTypeFontFace &ot_face = blob->as<OT::OpenTypeFontFile> ()->get_face (face->index);
+    unsigned int count = ot_face.get_table_count ();
+    for (unsigned int i = 0; i < count; i++)
+    {
+      const OT::TableRecord &record = ot_face.get_table (i);
+      h = h * 31 + record.tag;
+      h = h * 31 + record.checkSum;
+      h = h * 31 + record.length;
+    }
+    hb_blob_destroy (blob);
+
+    if (!count)
+    {
+      hb_tag_t tags[64];
+      unsigned int offset = 0, num_tags;
+      do
+      {
+	num_tags = ARRAY_LENGTH (tags);
+	hb_face_get_table_tags (face, offset, &num_tags, tags);
+	for (unsigned int i = 0; i < num_tags; i++)
+	{
+	  hb_blob_t *table = face->reference_table (tags[i]);
+	  h = h * 31 + tags[i];
+	  h = h * 31 + hb_blob_get_length (table);
+	  hb_blob_destroy (table);
+	}
+	offset += num_tags;
+      } while (num_tags == ARRAY_LENGTH (tags));
+    }
+
+    return h ^ (h >> 16);
+  }
+};
+
+/**
+ * hb_shape_cache_serialize:
+ * @cache: a shape cache.
+ * @face: the face whose runs to save.
+ *
+ * Saves the runs of @cache shaped with fonts of @face, along with their
+ * shape plans as hb_shape_plan_serialize() saves them, so that
+ * hb_shape_cache_deserialize() can put them back in a cache, in another
+ * process, without shaping them again.  Runs shaped with other Unicode
+ * functions than the default ones are left out.
+ *
+ * The blob is meant to be written to a file when a process exits and
+ * mapped with hb_blob_create_from_file() when the next one starts.  It is
+ * only valid for the same build of HarfBuzz, and for the same font file;
+ * it is not a storage format.
+ *
+ * Return value: (transfer full): the serialized runs, or the empty blob if
+ * @cache is the empty cache or memory ran out.
+ *
+ * Since: REPLACEME
+ **/
+hb_blob_t *
+hb_shape_cache_serialize (hb_shape_cache_t *cache,
+			  hb_face_t        *face)
+{
+  if (unlikely (hb_object_is_inert (cache) || !face))
+    return hb_blob_get_empty ();
+
+  hb_unicode_funcs_t *unicode = hb_unicode_funcs_get_default ();
+  hb_vector_t<hb_shape_plan_t *> plans;
+  hb_plan_writer_t records;
+  unsigned int num_records = 0;
+  {
+    /* Oldest first, so that loading them keeps them in order. */
+    hb_lock_t l (cache->lock);
+    for (hb_shape_cache_entry_t *entry = cache->lru.lru_prev;
+	 entry != &cache->lru;
+	 entry = entry->lru_prev)
+    {
+      const hb_shape_cache_key_t &key = entry->key;
+      if (key.font->face != face || key.unicode != unicode)
+	continue;
+
+      unsigned int plan_index = 0;
+      while (plan_index < plans.length && plans[plan_index] != key.plan)
+	plan_index++;
+      if (plan_index == plans.length)
+      {
+	if (unlikely (!plans.push (key.plan)))
+	  break;
+	hb_shape_plan_reference (key.plan);
+      }
+
+      hb_shape_cache_record_t record;
+      memset (&record, 0, sizeof (record));
+      record.plan_index = plan_index;
+      record.x_scale = key.x_scale;
+      record.y_scale = key.y_scale;
+      record.x_ppem = key.x_ppem;
+      record.y_ppem = key.y_ppem;
+      record.ptem = key.ptem;
+      record.flags = key.flags;
+      record.cluster_level = key.cluster_level;
+      record.replacement = key.replacement;
+      record.invisible = key.invisible;
+      record.num_coords = key.num_coords;
+      record.len = key.len;
+      record.context_len[0] = key.context_len[0];
+      record.context_len[1] = key.context_len[1];
+      record.num_glyphs = entry->num_glyphs;
+      records.write (record);
+      records.write (entry->key_values (), key.num_values () * sizeof (uint32_t));
+      records.write (entry->infos (), entry->num_glyphs * sizeof (hb_glyph_info_t));
+      records.write (entry->positions (), entry->num_glyphs * sizeof (hb_glyph_position_t));
+      num_records++;
+    }
+  }
+
+  hb_plan_writer_t w;
+  hb_shape_cache_blob_header_t header;
+  header.init (face);
+  w.write (header);
+
+  w.write (plans.length);
+  for (unsigned int i = 0; i < plans.length; i++)
+  {
+    hb_blob_t *plan_blob = hb_shape_plan_serialize (plans[i]);
+    unsigned int plan_length;
+    const char *plan_data = hb_blob_get_data (plan_blob, &plan_length);
+    w.write (plan_length);
+    w.write (plan_data, plan_length);
+    hb_blob_destroy (plan_blob);
+    hb_shape_plan_destroy (plans[i]);
+  }
+
+  w.write (num_records);
+  w.write (records.bytes.arrayZ (), records.bytes.length);
+
+  if (unlikely (w.in_error () || records.in_error () || plans.in_error ()))
+    return hb_blob_get_empty ();
+
+  unsigned int length = w.bytes.length;
+  char *data = (char *) malloc (length);
+  if (unlikely (!data))
+    return hb_blob_get_empty ();
+  memcpy (data, w.bytes.arrayZ (), length);
+  return hb_blob_create (data, length, HB_MEMORY_MODE_WRITABLE, data, free);
+}
+
+/**
+ * hb_shape_cache_deserialize:
+ * @cache: a shape cache.
+ * @font: the font to look the runs up for.
+ * @blob: a blob made by hb_shape_cache_serialize().
+ *
+ * Adds the runs saved by hb_shape_cache_serialize() to @cache, as if they
+ * had been shaped with @font, and the shape plans saved with them to the
+ * shape plan cache of its face, as hb_shape_plan_deserialize() does.
+ * hb_shape_cache_shape() then finds them when shaping with @font, at any
+ * scale, ppem or variations the runs were shaped at.  @font must use the
+ * same font functions, set up the same way, as the fonts the runs were
+ * shaped with; this is not checked.
+ *
+ * Nothing is added if @blob was written by another build of HarfBuzz, or
+ * for another font file than that of @font; the runs of a corrupt blob are
+ * added up to where it is corrupt.
+ *
+ * Return value: the number of runs added.
+ *
+ * Since: REPLACEME
+ **/
+unsigned int
+hb_shape_cache_deserialize (hb_shape_cache_t *cache,
+			    hb_font_t        *font,
+			    hb_blob_t        *blob)
+{
+  if (unlikely (hb_object_is_inert (cache)))
+    return 0;
+
+  unsigned int length;
+  const char *data = hb_blob_get_data (blob, &length);
+  hb_plan_reader_t r (data, length);
+
+  hb_shape_cache_blob_header_t header, expected;
+  if (!r.read (&header))
+    return 0;
+  expected.init (font->face);
+  if (!header.equal (&expected))
+  {
+    DEBUG_MSG_FUNC (SHAPE_PLAN, nullptr, "blob is for another build or font file");
+    return 0;
+  }
+
+  hb_vector_t<hb_shape_plan_t *> plans;
+  unsigned int num_plans;
+  bool ok = r.read (&num_plans);
+  for (unsigned int i = 0; ok && i < num_plans; i++)
+  {
+    unsigned int plan_length;
+    const char *plan_data;
+    if (!r.read (&plan_length) || !(plan_data = r.skip (plan_length)))
+    {
+      ok = false;
+      break;
+    }
+    hb_blob_t *plan_blob = hb_blob_create_sub_blob (blob, plan_data - data, plan_length);
+    hb_shape_plan_t *plan = hb_shape_plan_deserialize (font->face, plan_blob);
+    hb_blob_destroy (plan_blob);
+    if (unlikely (!plans.push (plan)))
+    {
+      hb_shape_plan_destroy (plan);
+      ok = false;
+    }
+  }
+
+  /* Entries are made outside the lock, chained through lru_next. */
+  hb_shape_cache_entry_t *loaded = nullptr;
+  hb_shape_cache_entry_t **tail = &loaded;
+  unsigned int num_records;
+  if (ok && r.read (&num_records))
+    for (unsigned int i = 0; i < num_records; i++)
+    {
+      hb_shape_cache_record_t record;
+      if (!r.read (&record) ||
+	  record.plan_index >= plans.length ||
+	  (record.flags & ~HB_SHAPE_CACHE_KNOWN_FLAGS) ||
+	  record.cluster_level > HB_BUFFER_CLUSTER_LEVEL_CHARACTERS ||
+	  !record.len || record.len > HB_SHAPE_CACHE_MAX_LENGTH ||
+	  record.num_coords > HB_SHAPE_CACHE_MAX_LENGTH ||
+	  record.context_len[0] > hb_buffer_t::CONTEXT_LENGTH ||
+	  record.context_len[1] > hb_buffer_t::CONTEXT_LENGTH ||
+	  record.num_glyphs > length / (sizeof (hb_glyph_info_t) + sizeof (hb_glyph_position_t)))
+	break;
+
+      hb_shape_cache_key_t key;
+      key.plan = plans[record.plan_index];
+      key.font = font;
+      key.klass = font->klass;
+      key.font_data = font->user_data;
+      key.x_scale = record.x_scale;
+      key.y_scale = record.y_scale;
+      key.x_ppem = record.x_ppem;
+      key.y_ppem = record.y_ppem;
+      key.ptem = record.ptem;
+      key.unicode = hb_unicode_funcs_get_default ();
+      key.flags = (hb_buffer_flags_t) record.flags;
+      key.cluster_level = (hb_buffer_cluster_level_t) record.cluster_level;
+      key.replacement = record.replacement;
+      key.invisible = record.invisible;
+      key.num_coords = record.num_coords;
+      key.len = record.len;
+      key.context_len[0] = record.context_len[0];
+      key.context_len[1] = record.context_len[1];
+
+      unsigned int values_size = key.num_values () * sizeof (uint32_t);
+      unsigned int glyphs_size = record.num_glyphs * (sizeof (hb_glyph_info_t) + sizeof (hb_glyph_position_t));
+      const char *values = r.skip (values_size);
+      const char *glyphs = r.skip (glyphs_size);
+      if (!values || !glyphs)
+	break;
+      if (hb_object_is_inert (key.plan))
+	continue;
+
+      hb_shape_cache_entry_t *entry = (hb_shape_cache_entry_t *)
+	malloc (sizeof (hb_shape_cache_entry_t) + values_size + glyphs_size);
+      if (unlikely (!entry))
+	break;
+      entry->key = key;
+      entry->num_glyphs = record.num_glyphs;
+      memcpy (entry->key_values (), values, values_size);
+      memcpy (entry->infos (), glyphs, glyphs_size);
+      entry->key.hash = _hb_shape_cache_key_hash (&entry->key, entry->key_values ());
+      hb_shape_plan_reference (key.plan);
+      hb_font_reference (font);
+
+      entry->lru_next = nullptr;
+      *tail = entry;
+      tail = &entry->lru_next;
+    }
+
+  unsigned int count = 0;
+  hb_shape_cache_entry_t *evicted = nullptr;
+  {
+    hb_lock_t l (cache->lock);
+    while (loaded)
+    {
+      hb_shape_cache_entry_t *next = loaded->lru_next;
+      hb_shape_cache_entry_t *freed = _hb_shape_cache_insert (cache, loaded);
+      if (freed != loaded)
+	count++;
+      if (freed)
+      {
+	freed->lru_next = evicted;
+	evicted = freed;
+      }
+      loaded = next;
+    }
+  }
+  _hb_shape_cache_free_entries (evicted);
+
+  for (unsigned int i = 0; i < plans.length; i++)
+    hb_shape_plan_destroy (plans[i]);
+
+  return count;
 }
@@ -102,6 +102,106 @@ hb_shape_plan_execute (hb_shape_plan_t    *shape_plan,
 HB_EXTERN const char *
 hb_shape_plan_get_shaper (hb_shape_plan_t *shape_plan);
 
+HB_EXTERN unsigned int
+hb_shape_plan_get_memory_usage (hb_shape_plan_t *shape_plan);
+
+HB_EXTERN hb_blob_t *
+hb_shape_plan_serialize (hb_shape_plan_t *shape_plan);
+
+HB_EXTERN hb_shape_plan_t *
+hb_shape_plan_deserialize (hb_face_t *face,
+			   hb_blob_t *blob);
+
+
+/**
+ * hb_shape_plan_lookup_stats_t:
+ * @table_tag: %HB_OT_TAG_GSUB or %HB_OT_TAG_GPOS.
+ * @lookup_index: index of the lookup in the table.
+ * @positions: glyph positions the lookup was tried at.
+ * @digest_rejects: times the lookup was skipped outright, because it
+ *   covers none of the glyphs in the buffer.
+ * @subtable_attempts: subtables tried, over all positions.
+ * @applications: positions the lookup applied at.
+ * @elapsed_ns: time spent in the lookup, in nanoseconds.
+ *
+ * Counters for one lookup of a shape plan, gathered while profiling is on;
+ * see hb_shape_plan_set_lookup_profiling().  A lookup that the plan applies
+ * more than once, for different features, has an entry for each time.
+ * Lookups applied from within other lookups are counted in their caller.
+ *
+ * Since: REPLACEME
+ */
+typedef struct hb_shape_plan_lookup_stats_t {
+  hb_tag_t table_tag;
+  unsigned int lookup_index;
+  uint64_t positions;
+  uint64_t digest_rejects;
+  uint64_t subtable_attempts;
+  uint64_t applications;
+  uint64_t elapsed_ns;
+} hb_shape_plan_lookup_stats_t;
+
+HB_EXTERN hb_bool_t
+hb_shape_plan_set_lookup_profiling (hb_shape_plan_t *shape_plan,
+				    hb_bool_t        enabled);
+
+HB_EXTERN unsigned int
+hb_shape_plan_get_lookup_stats (hb_shape_plan_t              *shape_plan,
+				unsigned int                  start_offset,
+				unsigned int                 *stats_count /* IN/OUT */,
+				hb_shape_plan_lookup_stats_t *stats /* OUT */);
+
+HB_EXTERN void
+hb_shape_plan_reset_lookup_stats (hb_shape_plan_t *shape_plan);
+
+
+/**
+ * hb_shape_cache_t:
+ *
+ * A thread-safe cache of shaped runs, for text that is shaped over and
+ * over, such as the words of a document.
+ *
+ * Since: REPLACEME
+ */
+typedef struct hb_shape_cache_t hb_shape_cache_t;
+
+HB_EXTERN hb_shape_cache_t *
+hb_shape_cache_create (unsigned int max_entries);
+
+HB_EXTERN hb_shape_cache_t *
+hb_shape_cache_get_empty (void);
+
+HB_EXTERN hb_shape_cache_t *
+hb_shape_cache_reference (hb_shape_cache_t *cache);
+
+HB_EXTERN void
+hb_shape_cache_destroy (hb_shape_cache_t *cache);
+
+HB_EXTERN void
+hb_shape_cache_clear (hb_shape_cache_t *cache);
+
+HB_EXTERN unsigned int
+hb_shape_cache_get_stats (hb_shape_cache_t *cache,
+			  unsigned int     *hits,
+			  unsigned int     *misses);
+
+HB_EXTERN hb_bool_t
+hb_shape_cache_shape (hb_shape_cache_t   *cache,
+		      hb_font_t          *font,
+		      hb_buffer_t        *buffer,
+		      const hb_feature_t *features,
+		      unsigned int        num_features,
+		      const char * const *shaper_list);
+
+HB_EXTERN hb_blob_t *
+hb_shape_cache_serialize (hb_shape_cache_t *cache,
+			  hb_face_t        *face);
+
+HB_EXTERN unsigned int
+hb_shape_cache_deserialize (hb_shape_cache_t *cache,
+			    hb_font_t        *font,
+			    hb_blob_t        *blob);
+
 
 HB_END_DECLS
 
@@ -44,6 +44,8 @@ struct hb_shape_plan_key_t
   hb_shape_func_t         *shaper_func;
   const char              *shaper_name;
 
+  unsigned int             hash; /* Of all the above that equal() compares. */
+
   HB_INTERNAL inline bool init (bool                           copy,
 				hb_face_t                     *face,
 				const hb_segment_properties_t *props,
@@ -51,13 +53,22 @@ struct hb_shape_plan_key_t
 				unsigned int                   num_user_features,
 				const int                     *coords,
 				unsigned int                   num_coords,
-				const char * const            *shaper_list);
+				const char * const            *shaper_list,
+				const hb_ot_shape_plan_key_t  *ot_key = nullptr);
 
   HB_INTERNAL inline void free () { ::free ((void *) user_features); }
 
   HB_INTERNAL bool user_features_match (const hb_shape_plan_key_t *other);
 
   HB_INTERNAL bool equal (const hb_shape_plan_key_t *other);
+
+  /* Replaces what init () worked out from coords; for restoring serialized
+   * plans, which only know the result.  Passing ot_key to init () does the
+   * same without working it out first. */
+  HB_INTERNAL void set_ot (const hb_ot_shape_plan_key_t &ot_);
+
+  private:
+  HB_INTERNAL unsigned int compute_hash () const;
 };
 
 struct hb_shape_plan_t
@@ -68,5 +79,20 @@ struct hb_shape_plan_t
   hb_ot_shape_plan_t ot;
 };
 
+HB_INTERNAL hb_shape_plan_t *
+_hb_shape_plan_get_cached (hb_font_t                     *font,
+			   const hb_segment_properties_t *props,
+			   const hb_feature_t            *user_features,
+			   unsigned int                   num_user_features,
+			   const char * const            *shaper_list,
+			   hb_shape_plan_t              **created);
+
+HB_INTERNAL hb_bool_t
+_hb_shape_plan_execute (hb_shape_plan_t    *shape_plan,
+			hb_font_t          *font,
+			hb_buffer_t        *buffer,
+			const hb_feature_t *features,
+			unsigned int        num_features);
+
 
 #endif /* HB_SHAPE_PLAN_HH */
@@ -132,12 +132,29 @@ hb_shape_full (hb_font_t          *font,
 	       unsigned int        num_features,
 	       const char * const *shaper_list)
 {
-  hb_shape_plan_t *shape_plan = hb_shape_plan_create_cached2 (font->face, &buffer->props,
-							      features, num_features,
-							      font->coords, font->num_coords,
-							      shaper_list);
-  hb_bool_t res = hb_shape_plan_execute (shape_plan, font, buffer, features, num_features);
-  hb_shape_plan_destroy (shape_plan);
+  if (unlikely (!buffer->len))
+  {
+    buffer->content_type = HB_BUFFER_CONTENT_TYPE_GLYPHS;
+    return true;
+  }
+
+  assert (!hb_object_is_immutable (buffer));
+  assert (buffer->content_type == HB_BUFFER_CONTENT_TYPE_UNICODE);
+
+  /* The plan is borrowed from the face's cache, not referenced; with many
+   * threads shaping with one face its reference count would bounce
+   * between them. */
+  hb_bool_t res;
+  hb_shape_plan_t *created;
+  {
+    hb_face_use_t use (font->face);
+    hb_shape_plan_t *shape_plan = _hb_shape_plan_get_cached (font, &buffer->props,
+							     features, num_features,
+							     shaper_list, &created);
+    res = likely (!hb_object_is_inert (shape_plan)) &&
+	  _hb_shape_plan_execute (shape_plan, font, buffer, features, num_features);
+  }
+  hb_shape_plan_destroy (created);
 
   if (res)
     buffer->content_type = HB_BUFFER_CONTENT_TYPE_GLYPHS;
@@ -166,3 +183,903 @@ hb_shape (hb_font_t           *font,
 {
   hb_shape_full (font, buffer, features, num_features, nullptr);
 }
+
+/**
+ * hb_shape_reposition:
+ * @font: an #hb_font_t to position with
+ * @buffer: an #hb_buffer_t shaped before
+ * @features: (array length=num_features) (allow-none): an array of user
+ *    specified #hb_feature_t or %NULL
+ * @num_features: the length of @features array
+ *
+ * Positions the glyphs of @buffer again for @font, without substituting
+ * them again.  This is much cheaper than shaping the text again when only
+ * the scale, ppem or point size of the font changed since @buffer was
+ * shaped.  @buffer must be unmodified since it was shaped with hb_shape()
+ * or hb_shape_full() using the OpenType shaper, and @font must have the
+ * same face and variation coordinates as the font used then; @features and
+ * the segment properties of @buffer must also be the same.
+ *
+ * Nothing is done if the glyphs were chosen after or based on positioning,
+ * as with AAT 'morx' substitutions, hidden default-ignorables or Arabic
+ * stretching; the text must then be shaped again at the new size.
+ *
+ * Return value: true if @buffer was positioned again, false if it must be
+ * shaped again
+ *
+ * Since: REPLACEME
+ **/
+hb_bool_t
+hb_shape_reposition (hb_font_t          *font,
+		     hb_buffer_t        *buffer,
+		     const hb_feature_t *features,
+		     unsigned int        num_features)
+{
+  if (unlikely (!buffer->len))
+    return true;
+
+  if (unlikely (hb_object_is_immutable (buffer) ||
+		buffer->content_type != HB_BUFFER_CONTENT_TYPE_GLYPHS ||
+		!font->data.ot))
+    return false;
+
+  hb_bool_t res;
+  hb_shape_plan_t *created;
+  {
+    hb_face_use_t use (font->face);
+    hb_shape_plan_t *shape_plan = _hb_shape_plan_get_cached (font, &buffer->props,
+							     features, num_features,
+							     nullptr, &created);
+    res = likely (!hb_object_is_inert (shape_plan)) &&
+	  shape_plan->key.shaper_func == _hb_ot_shape &&
+	  _hb_ot_shape_reposition (shape_plan, font, buffer, features, num_features);
+  }
+  hb_shape_plan_destroy (created);
+
+  return res;
+}
+
+/**
+ * hb_shape_batch:
+ * @font: an #hb_font_t to use for shaping
+ * @items: (array length=num_items): the buffers to shape, with their
+ *    features
+ * @num_items: the length of @items array
+ * @shaper_list: (array zero-terminated=1) (allow-none): a %NULL-terminated
+ *    array of shapers to use or %NULL
+ *
+ * Shapes each buffer in @items as hb_shape_full() would.  Consecutive items
+ * with the same segment properties and features share a shape plan, so for
+ * many short runs this saves most of the per-call setup.
+ *
+ * Return value: false if all shapers failed for any item, true otherwise
+ *
+ * Since: REPLACEME
+ **/
+hb_bool_t
+hb_shape_batch (hb_font_t                   *font,
+		const hb_shape_batch_item_t *items,
+		unsigned int                 num_items,
+		const char * const          *shaper_list)
+{
+  hb_face_use_t use (font->face);
+
+  /* Borrowed, as in hb_shape_full(). */
+  hb_shape_plan_t *shape_plan = nullptr;
+  hb_shape_plan_t *created = nullptr;
+  const hb_shape_batch_item_t *plan_item = nullptr;
+  hb_bool_t ret = true;
+  for (unsigned int i = 0; i < num_items; i++)
+  {
+    const hb_shape_batch_item_t *item = &items[i];
+    hb_buffer_t *buffer = item->buffer;
+    if (unlikely (!buffer->len))
+      continue;
+
+    assert (!hb_object_is_immutable (buffer));
+    assert (buffer->content_type == HB_BUFFER_CONTENT_TYPE_UNICODE);
+
+    if (!plan_item ||
+	!hb_segment_properties_equal (&plan_item->buffer->props, &buffer->props) ||
+	plan_item->num_features != item->num_features ||
+	(plan_item->features != item->features &&
+	 0 != memcmp (plan_item->features, item->features,
+		      item->num_features * sizeof (item->features[0]))))
+    {
+      hb_shape_plan_destroy (created);
+      shape_plan = _hb_shape_plan_get_cached (font, &buffer->props,
+					      item->features, item->num_features,
+					      shaper_list, &created);
+      plan_item = item;
+    }
+
+    if (likely (!hb_object_is_inert (shape_plan) &&
+		_hb_shape_plan_execute (shape_plan, font, buffer,
+					item->features, item->num_features)))
+      buffer->content_type = HB_BUFFER_CONTENT_TYPE_GLYPHS;
+    else
+      ret = false;
+  }
+  hb_shape_plan_destroy (created);
+
+  return ret;
+}
+
+
+/*
+ * Incremental shaping.
+ */
+
+/* Sets @dst up to shape @text[@start:@end): same settings, and the text
+ * around the range as context. */
+static void
+_hb_shape_load_range (hb_buffer_t *dst, hb_buffer_t *text,
+		      unsigned int start, unsigned int end)
+{
+  hb_buffer_clear_contents (dst);
+  hb_buffer_set_unicode_funcs (dst, text->unicode);
+  hb_buffer_set_cluster_level (dst, text->cluster_level);
+  hb_buffer_set_replacement_codepoint (dst, text->replacement);
+  hb_buffer_set_invisible_glyph (dst, text->invisible);
+  dst->props = text->props;
+
+  unsigned int flags = text->flags;
+  if (start)
+    flags &= ~HB_BUFFER_FLAG_BOT;
+  if (end < text->len)
+    flags &= ~HB_BUFFER_FLAG_EOT;
+  hb_buffer_set_flags (dst, (hb_buffer_flags_t) flags);
+
+  hb_buffer_append (dst, text, start, end);
+
+  /* Nearest character first, continuing into @text's own context. */
+  for (unsigned int i = start; i && dst->context_len[0] < dst->CONTEXT_LENGTH;)
+    dst->context[0][dst->context_len[0]++] = text->info[--i].codepoint;
+  for (unsigned int i = 0; i < text->context_len[0] && dst->context_len[0] < dst->CONTEXT_LENGTH; i++)
+    dst->context[0][dst->context_len[0]++] = text->context[0][i];
+  for (unsigned int i = end; i < text->len && dst->context_len[1] < dst->CONTEXT_LENGTH; i++)
+    dst->context[1][dst->context_len[1]++] = text->info[i].codepoint;
+  for (unsigned int i = 0; i < text->context_len[1] && dst->context_len[1] < dst->CONTEXT_LENGTH; i++)
+    dst->context[1][dst->context_len[1]++] = text->context[1][i];
+}
+
+/* Items in logical order: @k-th item of @buffer's text.  Shaped buffers
+ * are in visual order. */
+static inline const hb_glyph_info_t &
+_hb_shape_logical_info (const hb_buffer_t *buffer, unsigned int k)
+{
+  return buffer->content_type == HB_BUFFER_CONTENT_TYPE_GLYPHS &&
+	 HB_DIRECTION_IS_BACKWARD (buffer->props.direction) ?
+	 buffer->info[buffer->len - 1 - k] : buffer->info[k];
+}
+
+/* First logical item whose cluster is >= @cluster. */
+static unsigned int
+_hb_shape_lower_bound (const hb_buffer_t *buffer, unsigned int cluster,
+		       unsigned int lo = 0)
+{
+  unsigned int hi = buffer->len;
+  while (lo < hi)
+  {
+    unsigned int mid = lo + (hi - lo) / 2;
+    if (_hb_shape_logical_info (buffer, mid).cluster < cluster)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+/* Start of the logical cluster before the one starting at @k. */
+static inline unsigned int
+_hb_shape_prev_cluster (const hb_buffer_t *buffer, unsigned int k)
+{
+  uint32_t cluster = _hb_shape_logical_info (buffer, k - 1).cluster;
+  while (k && _hb_shape_logical_info (buffer, k - 1).cluster == cluster)
+    k--;
+  return k;
+}
+
+/* Start of the logical cluster after the one starting at @k. */
+static inline unsigned int
+_hb_shape_next_cluster (const hb_buffer_t *buffer, unsigned int k)
+{
+  uint32_t cluster = _hb_shape_logical_info (buffer, k).cluster;
+  while (k < buffer->len && _hb_shape_logical_info (buffer, k).cluster == cluster)
+    k++;
+  return k;
+}
+
+/* Whether it is safe to break before the logical cluster starting at @k. */
+static inline bool
+_hb_shape_cluster_is_safe (const hb_buffer_t *buffer, unsigned int k)
+{
+  uint32_t cluster = _hb_shape_logical_info (buffer, k).cluster;
+  for (; k < buffer->len && _hb_shape_logical_info (buffer, k).cluster == cluster; k++)
+    if (hb_glyph_info_get_glyph_flags (&_hb_shape_logical_info (buffer, k)) & HB_GLYPH_FLAG_UNSAFE_TO_BREAK)
+      return false;
+  return true;
+}
+
+/* Closest safe break before the cluster starting at @k, zero if none. */
+static inline unsigned int
+_hb_shape_prev_safe (const hb_buffer_t *buffer, unsigned int k)
+{
+  do
+    k = _hb_shape_prev_cluster (buffer, k);
+  while (k && !_hb_shape_cluster_is_safe (buffer, k));
+  return k;
+}
+
+/* Closest safe break after the cluster starting at @k, length if none. */
+static inline unsigned int
+_hb_shape_next_safe (const hb_buffer_t *buffer, unsigned int k)
+{
+  do
+    k = _hb_shape_next_cluster (buffer, k);
+  while (k < buffer->len && !_hb_shape_cluster_is_safe (buffer, k));
+  return k;
+}
+
+/* Whether a cluster of shaped @buffer starts at @cluster and is safe to
+ * break before. */
+static inline bool
+_hb_shape_is_safe_at (const hb_buffer_t *buffer, uint32_t cluster)
+{
+  unsigned int k = _hb_shape_lower_bound (buffer, cluster);
+  return k < buffer->len &&
+	 _hb_shape_logical_info (buffer, k).cluster == cluster &&
+	 _hb_shape_cluster_is_safe (buffer, k);
+}
+
+/**
+ * hb_shape_incremental:
+ * @font: an #hb_font_t to use for shaping
+ * @buffer: an #hb_buffer_t previously shaped with @font and @features
+ * @text: an #hb_buffer_t holding the new, unshaped, text
+ * @start: start of the edit, in cluster values
+ * @old_end: end of the replaced text in the old text, in cluster values
+ * @new_end: end of the replacement in @text, in cluster values
+ * @features: (array length=num_features) (allow-none): an array of user
+ *    specified #hb_feature_t or %NULL
+ * @num_features: the length of @features array
+ *
+ * Updates @buffer, the shaped result of some text, to be the shaped result
+ * of @text: the same text, with the range from @start to @old_end replaced
+ * by the range from @start to @new_end.  Cluster values in both buffers
+ * must be offsets into their text, as set by hb_buffer_add_utf8() and
+ * friends, and @text must not have been shaped.
+ *
+ * Only a run of text around the edit, bounded on both sides by clusters
+ * without %HB_GLYPH_FLAG_UNSAFE_TO_BREAK, is shaped again; the rest of
+ * @buffer is kept, its cluster values shifted past the edit.  The run is
+ * widened until the reshaped text is also safe to break where the kept
+ * glyphs join it, so the result matches shaping all of @text as far as
+ * the unsafe-to-break flags are accurate.
+ *
+ * If @buffer and @text have different segment properties, or a cluster
+ * level that is not monotone, all of @text is shaped into @buffer instead.
+ * @text is not modified either way.
+ *
+ * Return value: false if all shapers failed, true otherwise
+ *
+ * Since: REPLACEME
+ **/
+hb_bool_t
+hb_shape_incremental (hb_font_t          *font,
+		      hb_buffer_t        *buffer,
+		      hb_buffer_t        *text,
+		      unsigned int        start,
+		      unsigned int        old_end,
+		      unsigned int        new_end,
+		      const hb_feature_t *features,
+		      unsigned int        num_features)
+{
+  if (unlikely (buffer->content_type != HB_BUFFER_CONTENT_TYPE_GLYPHS ||
+		text->content_type != HB_BUFFER_CONTENT_TYPE_UNICODE ||
+		!buffer->have_positions || buffer->have_output || !buffer->len ||
+		!hb_segment_properties_equal (&buffer->props, &text->props) ||
+		text->cluster_level == HB_BUFFER_CLUSTER_LEVEL_CHARACTERS ||
+		start > old_end || start > new_end))
+  {
+    _hb_shape_load_range (buffer, text, 0, text->len);
+    return hb_shape_full (font, buffer, features, num_features, nullptr);
+  }
+
+  /* Logical glyph range to reshape.  The inner bounds are the closest
+   * safe breaks past one untouched cluster either side of the edit; the
+   * outer bounds are the safe breaks after those, so that the reshaped
+   * text can confirm the inner ones are still safe to break at.  Where it
+   * does not, widen that side and try again. */
+  unsigned int inner_start = _hb_shape_lower_bound (buffer, start + 1);
+  if (inner_start)
+    inner_start = _hb_shape_prev_cluster (buffer, inner_start);
+  if (inner_start)
+    inner_start = _hb_shape_prev_safe (buffer, inner_start);
+  unsigned int inner_end = _hb_shape_lower_bound (buffer, old_end);
+  if (inner_end < buffer->len)
+    inner_end = _hb_shape_next_safe (buffer, inner_end);
+
+  unsigned int delta = new_end - old_end;
+  hb_buffer_t *window = hb_buffer_create ();
+  unsigned int gstart, gend;
+  for (;;)
+  {
+    gstart = inner_start ? _hb_shape_prev_safe (buffer, inner_start) : 0;
+    gend = inner_end < buffer->len ? _hb_shape_next_safe (buffer, inner_end) : buffer->len;
+
+    unsigned int tstart = 0, tend = text->len;
+    if (gstart)
+      tstart = _hb_shape_lower_bound (text, _hb_shape_logical_info (buffer, gstart).cluster);
+    if (gend < buffer->len)
+      tend = _hb_shape_lower_bound (text, _hb_shape_logical_info (buffer, gend).cluster + delta, tstart);
+
+    _hb_shape_load_range (window, text, tstart, tend);
+    if (unlikely (!hb_shape_full (font, window, features, num_features, nullptr) ||
+		  !window->successful || !window->have_positions))
+    {
+      hb_buffer_destroy (window);
+      _hb_shape_load_range (buffer, text, 0, text->len);
+      return hb_shape_full (font, buffer, features, num_features, nullptr);
+    }
+
+    bool start_ok = !inner_start ||
+		    _hb_shape_is_safe_at (window, _hb_shape_logical_info (buffer, inner_start).cluster);
+    bool end_ok = inner_end == buffer->len ||
+		  _hb_shape_is_safe_at (window, _hb_shape_logical_info (buffer, inner_end).cluster + delta);
+    if (start_ok && end_ok)
+      break;
+    if (!start_ok)
+      inner_start = gstart;
+    if (!end_ok)
+      inner_end = gend;
+  }
+  /* Splice. */
+  unsigned int len = buffer->len;
+  unsigned int count = gend - gstart;
+  unsigned int wlen = window->len;
+  unsigned int i = HB_DIRECTION_IS_BACKWARD (buffer->props.direction) ? len - gend : gstart;
+  if (unlikely (!buffer->ensure (len - count + wlen)))
+  {
+    hb_buffer_destroy (window);
+    return false;
+  }
+  memmove (buffer->info + i + wlen, buffer->info + i + count, (len - i - count) * sizeof (buffer->info[0]));
+  memmove (buffer->pos + i + wlen, buffer->pos + i + count, (len - i - count) * sizeof (buffer->pos[0]));
+  memcpy (buffer->info + i, window->info, wlen * sizeof (buffer->info[0]));
+  memcpy (buffer->pos + i, window->pos, wlen * sizeof (buffer->pos[0]));
+  buffer->len = len - count + wlen;
+  hb_buffer_destroy (window);
+
+  /* Glyphs after the window, in logical order. */
+  if (delta)
+  {
+    unsigned int j = HB_DIRECTION_IS_BACKWARD (buffer->props.direction) ? 0 : i + wlen;
+    unsigned int j_end = HB_DIRECTION_IS_BACKWARD (buffer->props.direction) ? i : buffer->len;
+    for (; j < j_end; j++)
+      buffer->info[j].cluster += delta;
+  }
+
+  memcpy (buffer->context, text->context, sizeof (buffer->context));
+  memcpy (buffer->context_len, text->context_len, sizeof (buffer->context_len));
+  return true;
+}
+
+
+/*
+ * Line shaping.
+ */
+
+/* Where the glyphs kept either side of a line break at @cluster end and
+ * start, in logical glyph indices: the break itself if it is safe,
+ * otherwise the closest safe breaks around it.  @at_end is whether the
+ * break is at the end of the text. */
+static void
+_hb_shape_break_bounds (const hb_buffer_t *buffer, uint32_t cluster, bool at_end,
+			unsigned int *left, unsigned int *right)
+{
+  unsigned int k = _hb_shape_lower_bound (buffer, cluster);
+  bool at_cluster = k < buffer->len && _hb_shape_logical_info (buffer, k).cluster == cluster;
+  if (at_end || (at_cluster && _hb_shape_cluster_is_safe (buffer, k)))
+  {
+    *left = *right = k;
+    return;
+  }
+  *left = k ? _hb_shape_prev_safe (buffer, k) : 0;
+  *right = k == buffer->len || (!at_cluster && _hb_shape_cluster_is_safe (buffer, k)) ?
+	   k : _hb_shape_next_safe (buffer, k);
+}
+
+static hb_buffer_t *
+_hb_shape_range (hb_font_t *font, hb_buffer_t *text,
+		 unsigned int start, unsigned int end,
+		 const hb_feature_t *features, unsigned int num_features)
+{
+  hb_buffer_t *buffer = hb_buffer_create ();
+  _hb_shape_load_range (buffer, text, start, end);
+  if (unlikely (!hb_shape_full (font, buffer, features, num_features, nullptr) ||
+		!buffer->successful))
+  {
+    hb_buffer_destroy (buffer);
+    return nullptr;
+  }
+  return buffer;
+}
+
+/**
+ * hb_shape_lines:
+ * @font: an #hb_font_t to use for shaping
+ * @buffer: an #hb_buffer_t, the shaped result of @text
+ * @text: an #hb_buffer_t holding the same text, unshaped
+ * @breaks: (array length=num_breaks): where lines break, in cluster
+ *    values, in increasing order
+ * @num_breaks: the length of @breaks array
+ * @features: (array length=num_features) (allow-none): an array of user
+ *    specified #hb_feature_t or %NULL
+ * @num_features: the length of @features array
+ * @lines: (out caller-allocates): where to store the @num_breaks + 1 lines
+ *
+ * Splits the shaped paragraph in @buffer into lines, breaking the text
+ * before each cluster value in @breaks.  Each line keeps as much of @buffer
+ * as it can, as a range of its glyphs; only where a line starts or ends at
+ * a break that is not safe to break at, as indicated by
+ * %HB_GLYPH_FLAG_UNSAFE_TO_BREAK, is the text between the break and the
+ * closest safe one shaped again, into a new buffer.
+ *
+ * Cluster values in both buffers must be offsets into their text, as set
+ * by hb_buffer_add_utf8() and friends.  The caller owns the buffers in
+ * @lines and must destroy them with hb_buffer_destroy().
+ *
+ * Return value: false if shaping any line edge failed, true otherwise
+ *
+ * Since: REPLACEME
+ **/
+hb_bool_t
+hb_shape_lines (hb_font_t          *font,
+		hb_buffer_t        *buffer,
+		hb_buffer_t        *text,
+		const unsigned int *breaks,
+		unsigned int        num_breaks,
+		const hb_feature_t *features,
+		unsigned int        num_features,
+		hb_shape_line_t    *lines)
+{
+  bool backward = HB_DIRECTION_IS_BACKWARD (buffer->props.direction);
+  unsigned int len = buffer->len;
+  hb_bool_t ret = true;
+
+  /* Kept glyphs of the current line, and where its text starts. */
+  unsigned int keep_start = 0;
+  unsigned int text_start = 0;
+  for (unsigned int i = 0; i <= num_breaks; i++)
+  {
+    hb_shape_line_t *line = &lines[i];
+    line->start_glyphs = line->end_glyphs = nullptr;
+
+    unsigned int keep_end = len, next_keep_start = len;
+    unsigned int text_end = text->len;
+    if (i < num_breaks)
+    {
+      text_end = _hb_shape_lower_bound (text, breaks[i], text_start);
+      _hb_shape_break_bounds (buffer, breaks[i], text_end == text->len,
+			      &keep_end, &next_keep_start);
+    }
+
+    if (keep_start >= keep_end)
+    {
+      /* No safe break inside the line; shape all of it, unless empty. */
+      if (text_start < text_end)
+      {
+	line->start_glyphs = _hb_shape_range (font, text, text_start, text_end, features, num_features);
+	ret = ret && line->start_glyphs;
+      }
+      keep_end = keep_start;
+    }
+    else
+    {
+      unsigned int t;
+      if (keep_start < len &&
+	  text_start < (t = _hb_shape_lower_bound (text, _hb_shape_logical_info (buffer, keep_start).cluster, text_start)))
+      {
+	line->start_glyphs = _hb_shape_range (font, text, text_start, t, features, num_features);
+	ret = ret && line->start_glyphs;
+      }
+      if (keep_end < len &&
+	  (t = _hb_shape_lower_bound (text, _hb_shape_logical_info (buffer, keep_end).cluster, text_start)) < text_end)
+      {
+	line->end_glyphs = _hb_shape_range (font, text, t, text_end, features, num_features);
+	ret = ret && line->end_glyphs;
+      }
+    }
+
+    line->start = backward ? len - keep_end : keep_start;
+    line->end = backward ? len - keep_start : keep_end;
+
+    keep_start = next_keep_start;
+    text_start = text_end;
+  }
+
+  return ret;
+}
+
+
+/*
+ * Parallel shaping.
+ */
+
+#ifndef HB_SHAPE_PARALLEL_CHUNK_LENGTH
+#define HB_SHAPE_PARALLEL_CHUNK_LENGTH 4096
+#endif
+
+/* Whether @buffer can be split after the separator at @i; not before a
+ * mark or default ignorable, which shaping would fold into its cluster. */
+static inline bool
+_hb_shape_is_paragraph_break (hb_buffer_t *buffer, unsigned int i)
+{
+  hb_codepoint_t next = buffer->info[i + 1].codepoint;
+  if (HB_UNICODE_GENERAL_CATEGORY_IS_MARK (buffer->unicode->general_category (next)) ||
+      buffer->unicode->is_default_ignorable (next))
+    return false;
+
+  switch (buffer->info[i].codepoint)
+  {
+    case 0x000Du: /* Not between CR and LF. */
+      return next != 0x000Au;
+    case 0x000Au: case 0x000Bu: case 0x000Cu:
+    case 0x0085u: case 0x2028u: case 0x2029u:
+      return true;
+    default:
+      return false;
+  }
+}
+
+struct hb_shape_parallel_t
+{
+  hb_font_t *font;
+  hb_buffer_t *text;
+  const hb_feature_t *features;
+  unsigned int num_features;
+  const char * const *shaper_list;
+  hb_vector_t<unsigned int> starts; /* One more than chunks. */
+  hb_vector_t<hb_buffer_t *> chunks;
+};
+
+static void
+_hb_shape_parallel_task (void *task_data, unsigned int index)
+{
+  hb_shape_parallel_t *c = (hb_shape_parallel_t *) task_data;
+  hb_buffer_t *chunk = c->chunks[index];
+  _hb_shape_load_range (chunk, c->text, c->starts[index], c->starts[index + 1]);
+  if (unlikely (!hb_shape_full (c->font, chunk, c->features, c->num_features, c->shaper_list)))
+    chunk->successful = false;
+}
+
+/**
+ * hb_shape_parallel:
+ * @font: an #hb_font_t to use for shaping
+ * @buffer: an #hb_buffer_t to shape
+ * @features: (array length=num_features) (allow-none): an array of user
+ *    specified #hb_feature_t or %NULL
+ * @num_features: the length of @features array
+ * @shaper_list: (array zero-terminated=1) (allow-none): a %NULL-terminated
+ *    array of shapers to use or %NULL
+ * @executor: (closure executor_data) (allow-none): runs the chunks,
+ *    or %NULL to run them one after the other.
+ * @executor_data: data to pass to @executor.
+ *
+ * Shapes @buffer as hb_shape_full() would, splitting it into chunks at
+ * paragraph and line separators and shaping those separately: all on the
+ * calling thread, or however @executor arranges.  Chunks are about 4096
+ * characters or more, so text without separators is shaped as one.  Each
+ * chunk is shaped with the text around it as context and keeps its cluster
+ * values, so features with ranges apply as usual.
+ *
+ * Return value: false if shaping any chunk failed, in which case @buffer is
+ * left as it was; true otherwise
+ *
+ * Since: REPLACEME
+ **/
+hb_bool_t
+hb_shape_parallel (hb_font_t                *font,
+		   hb_buffer_t              *buffer,
+		   const hb_feature_t       *features,
+		   unsigned int              num_features,
+		   const char * const       *shaper_list,
+		   hb_shape_executor_func_t  executor,
+		   void                     *executor_data)
+{
+  if (unlikely (!buffer->len))
+    return true;
+  assert (buffer->content_type == HB_BUFFER_CONTENT_TYPE_UNICODE);
+
+  hb_shape_parallel_t c;
+  c.font = font;
+  c.text = buffer;
+  c.features = features;
+  c.num_features = num_features;
+  c.shaper_list = shaper_list;
+  c.starts.init ();
+  c.chunks.init ();
+
+  unsigned int start = 0;
+  c.starts.push (0);
+  for (unsigned int i = 0; i < buffer->len; i++)
+    if (i + 1 - start >= HB_SHAPE_PARALLEL_CHUNK_LENGTH &&
+	i + 1 < buffer->len &&
+	_hb_shape_is_paragraph_break (buffer, i))
+      c.starts.push (start = i + 1);
+  c.starts.push (buffer->len);
+
+  unsigned int num_chunks = c.starts.length - 1;
+  hb_bool_t ret = !c.starts.in_error () && c.chunks.alloc (num_chunks);
+  for (unsigned int i = 0; ret && i < num_chunks; i++)
+  {
+    hb_buffer_t *chunk = hb_buffer_create ();
+    c.chunks.push (chunk);
+    ret = chunk->successful;
+  }
+
+  if (ret)
+  {
+    if (executor && num_chunks > 1)
+      executor (_hb_shape_parallel_task, &c, num_chunks, executor_data);
+    else
+      for (unsigned int i = 0; i < num_chunks; i++)
+	_hb_shape_parallel_task (&c, i);
+  }
+
+  /* Concatenate; backward chunks go right to left. */
+  unsigned int len = 0;
+  for (unsigned int i = 0; ret && i < num_chunks; i++)
+  {
+    ret = c.chunks[i]->successful && c.chunks[i]->content_type == HB_BUFFER_CONTENT_TYPE_GLYPHS;
+    len += c.chunks[i]->len;
+  }
+  if (ret && (ret = buffer->ensure (len)))
+  {
+    bool backward = HB_DIRECTION_IS_BACKWARD (buffer->props.direction);
+    buffer->len = len;
+    buffer->clear_positions ();
+    unsigned int j = 0;
+    for (unsigned int n = 0; n < num_chunks; n++)
+    {
+      hb_buffer_t *chunk = c.chunks[backward ? num_chunks - 1 - n : n];
+      memcpy (buffer->info + j, chunk->info, chunk->len * sizeof (buffer->info[0]));
+      memcpy (buffer->pos + j, chunk->pos, chunk->len * sizeof (buffer->pos[0]));
+      j += chunk->len;
+    }
+    buffer->content_type = HB_BUFFER_CONTENT_TYPE_GLYPHS;
+  }
+
+  for (unsigned int i = 0; i < c.chunks.length; i++)
+    hb_buffer_destroy (c.chunks[i]);
+  c.chunks.fini ();
+  c.starts.fini ();
+
+  return ret;
+}
+
+
+/*
+ * Font fallback.
+ */
+
+/* End of the unit starting at @i that must go to one font: a character
+ * with the marks and default ignorables following it, and the character
+ * after any ZWJ among those. */
+static unsigned int
+_hb_shape_fallback_unit_end (hb_buffer_t *buffer, unsigned int i)
+{
+  hb_unicode_funcs_t *unicode = buffer->unicode;
+  unsigned int len = buffer->len;
+  bool join = buffer->info[i].codepoint == 0x200Du;
+  for (i++; i < len; i++)
+  {
+    hb_codepoint_t u = buffer->info[i].codepoint;
+    if (!join &&
+	!HB_UNICODE_GENERAL_CATEGORY_IS_MARK (unicode->general_category (u)) &&
+	!unicode->is_default_ignorable (u))
+      break;
+    join = u == 0x200Du;
+  }
+  return i;
+}
+
+/**
+ * hb_shape_fallback:
+ * @fonts: (array length=num_fonts): the fonts to use, in order of
+ *    preference
+ * @num_fonts: the length of @fonts array
+ * @buffer: an #hb_buffer_t to shape
+ * @features: (array length=num_features) (allow-none): an array of user
+ *    specified #hb_feature_t or %NULL
+ * @num_features: the length of @features array
+ * @run_count: (inout) (allow-none): on input, the length of @runs; on
+ *    output, the total number of runs
+ * @runs: (out caller-allocates) (array length=run_count) (allow-none):
+ *    where to store the runs of glyphs shaped with each font
+ *
+ * Shapes @buffer with the first font in @fonts that has glyphs for each
+ * character.  The text is split into units that must be shaped with one
+ * font: a character together with the marks and default ignorables
+ * following it, and anything joined to it with ZWJ.  Each unit goes to the
+ * first font covering all of its characters, found with batched nominal
+ * glyph lookups, or to the first font if none does.  Consecutive units
+ * going to the same font are shaped together, with the rest of the text
+ * as context, and the results are put together in @buffer in visual
+ * order.
+ *
+ * The glyphs of @buffer shaped with each font are reported in @runs, in
+ * visual order.  Only as many runs as fit are stored.
+ *
+ * Return value: false if shaping any run failed, in which case @buffer is
+ * left as it was; true otherwise
+ *
+ * Since: REPLACEME
+ **/
+hb_bool_t
+hb_shape_fallback (hb_font_t * const       *fonts,
+		   unsigned int             num_fonts,
+		   hb_buffer_t             *buffer,
+		   const hb_feature_t      *features,
+		   unsigned int             num_features,
+		   unsigned int            *run_count, /* IN/OUT */
+		   hb_shape_fallback_run_t *runs /* OUT */)
+{
+  unsigned int max_runs = run_count ? *run_count : 0;
+  if (run_count)
+    *run_count = 0;
+  if (unlikely (!num_fonts || !buffer->len))
+    return true;
+  assert (buffer->content_type == HB_BUFFER_CONTENT_TYPE_UNICODE);
+
+  unsigned int len = buffer->len;
+  hb_glyph_info_t *info = buffer->info;
+
+  /* Font chosen for each character; num_fonts while undecided. */
+  hb_vector_t<unsigned int> choice;
+  hb_vector_t<bool> covered;
+  choice.init ();
+  covered.init ();
+  if (unlikely (!choice.resize (len) || !covered.resize (len)))
+  {
+    choice.fini ();
+    covered.fini ();
+    return false;
+  }
+  for (unsigned int i = 0; i < len; i++)
+    choice[i] = num_fonts;
+
+  bool undecided = true;
+  for (unsigned int k = 0; k < num_fonts && undecided; k++)
+  {
+    hb_font_t *font = fonts[k];
+    undecided = false;
+    unsigned int i = 0;
+    while (i < len)
+    {
+      if (choice[i] != num_fonts)
+      {
+	i++;
+	continue;
+      }
+      unsigned int end = i;
+      while (end < len && choice[end] == num_fonts)
+	end++;
+
+      /* Which characters of the undecided span the font covers. */
+      hb_codepoint_t glyph;
+      for (unsigned int j = i; j < end;)
+      {
+	unsigned int n = font->get_nominal_glyphs (end - j,
+						   &info[j].codepoint, sizeof (info[0]),
+						   &glyph, 0);
+	for (unsigned int l = 0; l < n; l++)
+	  covered[j + l] = true;
+	if (j + n < end)
+	  covered[j + n] = false;
+	j += n + 1;
+      }
+
+      while (i < end)
+      {
+	unsigned int unit_end = MIN (_hb_shape_fallback_unit_end (buffer, i), end);
+	bool all = true;
+	for (unsigned int j = i; j < unit_end && all; j++)
+	  all = covered[j] || buffer->unicode->is_default_ignorable (info[j].codepoint);
+	if (all || k + 1 == num_fonts)
+	  for (unsigned int j = i; j < unit_end; j++)
+	    choice[j] = all ? k : 0;
+	else
+	  undecided = true;
+	i = unit_end;
+      }
+    }
+  }
+
+  /* Runs of text going to the same font. */
+  hb_vector_t<hb_buffer_t *> shaped;
+  hb_vector_t<unsigned int> shaped_font;
+  shaped.init ();
+  shaped_font.init ();
+  hb_bool_t ret = true;
+  bool single = true;
+  for (unsigned int i = 1; i < len && single; i++)
+    single = choice[i] == choice[0];
+  if (single)
+  {
+    ret = hb_shape_full (fonts[choice[0]], buffer, features, num_features, nullptr);
+    if (ret && max_runs)
+    {
+      runs[0].start = 0;
+      runs[0].end = buffer->len;
+      runs[0].font_index = choice[0];
+    }
+    if (ret && run_count)
+      *run_count = 1;
+  }
+  else
+  {
+    for (unsigned int start = 0; ret && start < len;)
+    {
+      unsigned int end = start + 1;
+      while (end < len && choice[end] == choice[start])
+	end++;
+      hb_buffer_t *run = _hb_shape_range (fonts[choice[start]], buffer, start, end,
+					  features, num_features);
+      if (unlikely (!run))
+      {
+	ret = false;
+	break;
+      }
+      shaped.push (run);
+      if (unlikely (shaped.in_error ()))
+      {
+	hb_buffer_destroy (run);
+	ret = false;
+	break;
+      }
+      shaped_font.push (choice[start]);
+      ret = !shaped_font.in_error ();
+      start = end;
+    }
+
+    unsigned int total = 0;
+    for (unsigned int i = 0; ret && i < shaped.length; i++)
+      total += shaped[i]->len;
+    if (ret && (ret = buffer->ensure (total)))
+    {
+      bool backward = HB_DIRECTION_IS_BACKWARD (buffer->props.direction);
+      unsigned int num_runs = shaped.length;
+      buffer->len = total;
+      buffer->clear_positions ();
+      unsigned int j = 0;
+      for (unsigned int n = 0; n < num_runs; n++)
+      {
+	unsigned int r = backward ? num_runs - 1 - n : n;
+	hb_buffer_t *run = shaped[r];
+	memcpy (buffer->info + j, run->info, run->len * sizeof (buffer->info[0]));
+	memcpy (buffer->pos + j, run->pos, run->len * sizeof (buffer->pos[0]));
+	if (n < max_runs)
+	{
+	  runs[n].start = j;
+	  runs[n].end = j + run->len;
+	  runs[n].font_index = shaped_font[r];
+	}
+	j += run->len;
+      }
+      buffer->content_type = HB_BUFFER_CONTENT_TYPE_GLYPHS;
+      if (run_count)
+	*run_count = num_runs;
+    }
+  }
+
+  for (unsigned int i = 0; i < shaped.length; i++)
+    hb_buffer_destroy (shaped[i]);
+  shaped.fini ();
+  shaped_font.fini ();
+  choice.fini ();
+  covered.fini ();
+
+  return ret;
+}
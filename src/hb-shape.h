@@ -53,6 +53,142 @@ hb_shape_full (hb_font_t          *font,
 	       unsigned int        num_features,
 	       const char * const *shaper_list);
 
+HB_EXTERN hb_bool_t
+hb_shape_reposition (hb_font_t          *font,
+		     hb_buffer_t        *buffer,
+		     const hb_feature_t *features,
+		     unsigned int        num_features);
+
+/**
+ * hb_shape_batch_item_t:
+ * @buffer: an #hb_buffer_t to shape.
+ * @features: (array length=num_features) (allow-none): the features to
+ *            shape @buffer with, or %NULL.
+ * @num_features: the length of @features array.
+ *
+ * One run for hb_shape_batch() to shape.
+ *
+ * Since: REPLACEME
+ */
+typedef struct hb_shape_batch_item_t {
+  hb_buffer_t        *buffer;
+  const hb_feature_t *features;
+  unsigned int        num_features;
+} hb_shape_batch_item_t;
+
+HB_EXTERN hb_bool_t
+hb_shape_batch (hb_font_t                   *font,
+		const hb_shape_batch_item_t *items,
+		unsigned int                 num_items,
+		const char * const          *shaper_list);
+
+HB_EXTERN hb_bool_t
+hb_shape_incremental (hb_font_t          *font,
+		      hb_buffer_t        *buffer,
+		      hb_buffer_t        *text,
+		      unsigned int        start,
+		      unsigned int        old_end,
+		      unsigned int        new_end,
+		      const hb_feature_t *features,
+		      unsigned int        num_features);
+
+/**
+ * hb_shape_line_t:
+ * @start_glyphs: the reshaped start of the line, or %NULL.
+ * @start: index of the first glyph of the shaped paragraph that the line
+ *         keeps.
+ * @end: index one past the last glyph of the shaped paragraph that the
+ *       line keeps.
+ * @end_glyphs: the reshaped end of the line, or %NULL.
+ *
+ * A line of a paragraph, as returned by hb_shape_lines().  In logical
+ * order, its glyphs are those of @start_glyphs, then those of the shaped
+ * paragraph from @start to @end, then those of @end_glyphs; for backward
+ * directions each part is itself in visual order, as in any shaped buffer.
+ *
+ * Since: REPLACEME
+ */
+typedef struct hb_shape_line_t {
+  hb_buffer_t  *start_glyphs;
+  unsigned int  start;
+  unsigned int  end;
+  hb_buffer_t  *end_glyphs;
+} hb_shape_line_t;
+
+HB_EXTERN hb_bool_t
+hb_shape_lines (hb_font_t          *font,
+		hb_buffer_t        *buffer,
+		hb_buffer_t        *text,
+		const unsigned int *breaks,
+		unsigned int        num_breaks,
+		const hb_feature_t *features,
+		unsigned int        num_features,
+		hb_shape_line_t    *lines);
+
+/**
+ * hb_shape_task_func_t:
+ * @task_data: the data passed to the executor.
+ * @index: which of the tasks to run.
+ *
+ * One of the tasks an #hb_shape_executor_func_t runs.
+ *
+ * Since: REPLACEME
+ */
+typedef void (*hb_shape_task_func_t) (void         *task_data,
+				      unsigned int  index);
+
+/**
+ * hb_shape_executor_func_t:
+ * @task: the function to run.
+ * @task_data: data to pass to @task.
+ * @num_tasks: how many tasks to run.
+ * @user_data: user data passed to hb_shape_parallel().
+ *
+ * Runs @task with @task_data and each index from zero to @num_tasks - 1,
+ * in any order and on any threads, and returns once all of them are done.
+ *
+ * Since: REPLACEME
+ */
+typedef void (*hb_shape_executor_func_t) (hb_shape_task_func_t  task,
+					  void                 *task_data,
+					  unsigned int          num_tasks,
+					  void                 *user_data);
+
+HB_EXTERN hb_bool_t
+hb_shape_parallel (hb_font_t                *font,
+		   hb_buffer_t              *buffer,
+		   const hb_feature_t       *features,
+		   unsigned int              num_features,
+		   const char * const       *shaper_list,
+		   hb_shape_executor_func_t  executor,
+		   void                     *executor_data);
+
+/**
+ * hb_shape_fallback_run_t:
+ * @start: the index of the first glyph of the run in the shaped buffer.
+ * @end: the index one past the last glyph of the run.
+ * @font_index: the index into the fonts array of the font the run was
+ *              shaped with.
+ *
+ * A run of glyphs shaped with one font, as reported by hb_shape_fallback().
+ *
+ * Since: REPLACEME
+ */
+typedef struct hb_shape_fallback_run_t {
+  unsigned int start;
+  unsigned int end;
+  unsigned int font_index;
+} hb_shape_fallback_run_t;
+
+HB_EXTERN hb_bool_t
+hb_shape_fallback (hb_font_t * const       *fonts,
+		   unsigned int             num_fonts,
+		   hb_buffer_t             *buffer,
+		   const hb_feature_t      *features,
+		   unsigned int             num_features,
+		   unsigned int            *run_count, /* IN/OUT */
+		   hb_shape_fallback_run_t *runs /* OUT */);
+
 HB_EXTERN const char **
 hb_shape_list_shapers (void);
 
@@ -26,6 +26,7 @@
 
 #include "hb.hh"
 
+#include "hb-cpu.hh"
 #include "hb-open-type.hh"
 #include "hb-face.hh"
 
@@ -73,3 +74,44 @@ hb_face_t::load_upem () const
 }
 
 #endif
+
+
+hb_atomic_int_t _hb_cpu_features;
+
+void
+_hb_cpu_features_init ()
+{
+  unsigned int features = HB_CPU_INITIALIZED;
+#ifdef HB_SIMD_SSE2
+  features |= HB_CPU_SSE2;
+#endif
+#ifdef HB_CPU_X86
+  __builtin_cpu_init ();
+  if (__builtin_cpu_supports ("sse2"))   features |= HB_CPU_SSE2;
+  if (__builtin_cpu_supports ("sse4.2")) features |= HB_CPU_SSE4_2;
+  if (__builtin_cpu_supports ("avx2"))   features |= HB_CPU_AVX2;
+#endif
+#ifdef HB_SIMD_NEON
+  features |= HB_CPU_NEON;
+#endif
+
+  const char *c = getenv ("HB_CPU");
+  if (c)
+  {
+    unsigned int allowed = ~0u;
+    if (0 == strcmp (c, "none"))
+      allowed = 0;
+    else if (0 == strcmp (c, "sse2"))
+      allowed = HB_CPU_SSE2;
+    else if (0 == strcmp (c, "sse4.2"))
+      allowed = HB_CPU_SSE2 | HB_CPU_SSE4_2;
+    else if (0 == strcmp (c, "avx2"))
+      allowed = HB_CPU_SSE2 | HB_CPU_SSE4_2 | HB_CPU_AVX2;
+    else if (0 == strcmp (c, "neon"))
+      allowed = HB_CPU_NEON;
+    features &= allowed | HB_CPU_INITIALIZED;
+  }
+
+  /* Racing threads all store the same value. */
+  _hb_cpu_features.set_relaxed (features);
+}
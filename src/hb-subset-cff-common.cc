@@ -69,7 +69,10 @@ hb_plan_subset_cff_fdselect (const hb_vector_t<hb_codepoint_t> &glyphs,
     hb_codepoint_t  prev_fd = CFF_UNDEF_CODE;
     for (hb_codepoint_t i = 0; i < subset_num_glyphs; i++)
     {
-      hb_codepoint_t  fd = src.get_fd (glyphs[i]);
+      /* Empty glyphs left by retained glyph ids don't care about their
+       * font dict; continue the current range. */
+      hb_codepoint_t  fd = glyphs[i] == HB_MAP_VALUE_INVALID && prev_fd != CFF_UNDEF_CODE ?
+			   prev_fd : src.get_fd (glyphs[i]);
       set->add (fd);
 
       if (fd != prev_fd)
@@ -224,3 +227,574 @@ hb_serialize_cff_fdselect (hb_serialize_context_t *c,
 
   return_trace (true);
 }
+
+
+/*
+ * Re-subroutinizer.
+ *
+ * Works on flattened charstrings split into groups, each group being the
+ * operands of one operator followed by the operator.  The argument stack
+ * is empty between groups, so any run of whole groups can be moved into a
+ * subroutine and replaced with a call.  Hint operators, endchar and the
+ * first group of each glyph (which may carry the width) stay in place, so
+ * subroutines never affect hint counting or width detection.
+ *
+ * Runs of up to HB_CFF_SUBR_MAX_GROUPS groups are counted by hash; those
+ * that look profitable become candidates, matched greedily in order of
+ * estimated saving.
+ * Candidates that turn out not to pay for themselves are dropped and the
+ * matching redone, at most HB_CFF_SUBR_MAX_PASSES times.  The work is
+ * linear in the charstring data and memory is bounded by
+ * HB_CFF_SUBR_MAX_CANDIDATES, plus HB_CFF_SUBR_COUNT_BUCKETS bytes of
+ * counters for large fonts.
+ */
+
+#ifndef HB_CFF_SUBR_MAX_GROUPS
+#define HB_CFF_SUBR_MAX_GROUPS 4
+#endif
+#ifndef HB_CFF_SUBR_MAX_CANDIDATES
+#define HB_CFF_SUBR_MAX_CANDIDATES (1u << 18)
+#endif
+#ifndef HB_CFF_SUBR_COUNT_BUCKETS
+#define HB_CFF_SUBR_COUNT_BUCKETS (1u << 22) /* Must be a power of two. */
+#endif
+#ifndef HB_CFF_SUBR_MAX_PASSES
+#define HB_CFF_SUBR_MAX_PASSES 3
+#endif
+#define HB_CFF_SUBR_MAX_SUBRS 65535u
+
+struct cs_group_t
+{
+  unsigned int start;
+  unsigned int length;
+  bool extractable;
+};
+
+struct subr_candidate_t
+{
+  hb_codepoint_t hash;
+  unsigned int glyph;		/* Where it was first seen. */
+  unsigned int start;		/* Byte offset in that glyph. */
+  unsigned int num_groups;
+  unsigned int length;		/* In bytes. */
+  unsigned int count;		/* Estimated occurrences. */
+  unsigned int last_glyph;	/* End of the last occurrence counted. */
+  unsigned int last_end;
+  unsigned int rank;		/* Order of estimated saving. */
+  unsigned int uses;		/* Actual uses after matching. */
+  unsigned int num;		/* Subroutine number. */
+};
+
+struct subr_rank_t
+{
+  int key;
+  unsigned int candidate;
+
+  static int cmp (const void *pa, const void *pb)
+  {
+    const subr_rank_t *a = (const subr_rank_t *) pa;
+    const subr_rank_t *b = (const subr_rank_t *) pb;
+    if (a->key != b->key) return a->key > b->key ? -1 : 1;
+    return a->candidate < b->candidate ? -1 : a->candidate > b->candidate ? 1 : 0;
+  }
+};
+
+static bool
+_cs_split_groups (const str_buff_t &str, hb_vector_t<cs_group_t> &groups)
+{
+  unsigned int num_stems = 0, num_args = 0, start = 0, i = 0;
+  while (i < str.length)
+  {
+    unsigned char b = str[i];
+    if (b >= 32 || b == OpCode_shortint)
+    {
+      i += b == OpCode_shortint ? 3 : b < OpCode_TwoBytePosInt0 ? 1 : b < OpCode_fixedcs ? 2 : 5;
+      num_args++;
+      continue;
+    }
+
+    i += b == OpCode_escape ? 2 : 1;
+    bool extractable = start != 0;
+    switch (b)
+    {
+      case OpCode_hstem: case OpCode_vstem:
+      case OpCode_hstemhm: case OpCode_vstemhm:
+	num_stems += num_args / 2;
+	extractable = false;
+	break;
+      case OpCode_hintmask: case OpCode_cntrmask:
+	num_stems += num_args / 2; /* Implied vstem. */
+	i += (num_stems + 7) / 8;
+	extractable = false;
+	break;
+      case OpCode_endchar:
+	extractable = false;
+	break;
+      case OpCode_callsubr: case OpCode_callgsubr: case OpCode_return:
+	return false; /* Not flat. */
+      default:
+	break;
+    }
+    if (unlikely (i > str.length))
+      return false;
+
+    cs_group_t group = {start, i - start, extractable};
+    groups.push (group);
+    start = i;
+    num_args = 0;
+  }
+  return start == str.length && !groups.in_error ();
+}
+
+static inline hb_codepoint_t
+_cs_hash (hb_codepoint_t h, const unsigned char *p, unsigned int length)
+{
+  for (unsigned int i = 0; i < length; i++)
+    h = (h ^ p[i]) * 16777619u; /* FNV-1a */
+  return h;
+}
+
+static inline hb_codepoint_t
+_cs_hash_key (hb_codepoint_t h)
+{ return h == HB_MAP_VALUE_INVALID ? h - 1 : h; }
+
+static inline unsigned int
+_cs_subr_bias (unsigned int count)
+{ return count < 1240 ? 107 : count < 33900 ? 1131 : 32768; }
+
+static inline unsigned int
+_cs_call_size (unsigned int num, unsigned int bias)
+{
+  int v = (int) num - (int) bias;
+  return (-107 <= v && v <= 107 ? 1 : -1131 <= v && v <= 1131 ? 2 : 3) + 1;
+}
+
+struct cs_subroutinizer_t
+{
+  cs_subroutinizer_t (str_buff_vec_t &charstrings_) : charstrings (charstrings_)
+  {
+    groups.init ();
+    glyph_groups.init ();
+    candidates.init ();
+    selected.init ();
+    index = hb_map_create ();
+  }
+  ~cs_subroutinizer_t ()
+  {
+    groups.fini ();
+    glyph_groups.fini ();
+    candidates.fini ();
+    selected.fini ();
+    hb_map_destroy (index);
+  }
+
+  bool split ()
+  {
+    for (unsigned int g = 0; g < charstrings.length; g++)
+    {
+      glyph_groups.push (groups.length);
+      if (!_cs_split_groups (charstrings[g], groups))
+	return false;
+    }
+    glyph_groups.push (groups.length);
+    return !glyph_groups.in_error ();
+  }
+
+  /* Calls func (g, j, k, hash, length) for each run of k + 1 groups
+   * starting at group j of glyph g. */
+  template <typename Func>
+  void for_each_run (Func func)
+  {
+    for (unsigned int g = 0; g < charstrings.length; g++)
+    {
+      const unsigned char *data = charstrings[g].arrayZ ();
+      unsigned int end = glyph_groups[g + 1];
+      for (unsigned int j = glyph_groups[g]; j < end; j++)
+      {
+	hb_codepoint_t h = 2166136261u;
+	unsigned int length = 0;
+	for (unsigned int k = 0; k < HB_CFF_SUBR_MAX_GROUPS && j + k < end && groups[j + k].extractable; k++)
+	{
+	  const cs_group_t &group = groups[j + k];
+	  h = _cs_hash (h, data + group.start, group.length);
+	  length += group.length;
+	  func (g, j, k, _cs_hash_key (h), length);
+	}
+      }
+    }
+  }
+
+  struct bucket_counter_t
+  {
+    void operator () (unsigned int, unsigned int, unsigned int,
+		      hb_codepoint_t key, unsigned int)
+    {
+      unsigned char &count = buckets[key & (HB_CFF_SUBR_COUNT_BUCKETS - 1)];
+      if (count < 255) count++;
+    }
+    unsigned char *buckets;
+  };
+
+  struct candidate_counter_t
+  {
+    void operator () (unsigned int g, unsigned int j, unsigned int k,
+		      hb_codepoint_t key, unsigned int length)
+    {
+      unsigned int c = t->index->get (key);
+      if (c != HB_MAP_VALUE_INVALID)
+      {
+	/* Don't count overlapping occurrences. */
+	subr_candidate_t &candidate = t->candidates[c];
+	if (candidate.last_glyph != g || candidate.last_end <= j)
+	{
+	  candidate.count++;
+	  candidate.last_glyph = g;
+	  candidate.last_end = j + k + 1;
+	}
+      }
+      else if (t->candidates.length < HB_CFF_SUBR_MAX_CANDIDATES &&
+	       length > 3 &&
+	       (!buckets || buckets[key & (HB_CFF_SUBR_COUNT_BUCKETS - 1)] >= 2))
+      {
+	subr_candidate_t candidate = {key, g, t->groups[j].start, k + 1, length, 1, g, j + k + 1, 0, 0, 0};
+	t->index->set (key, t->candidates.length);
+	t->candidates.push (candidate);
+      }
+    }
+    cs_subroutinizer_t *t;
+    const unsigned char *buckets;
+  };
+
+  /* Counts the runs that occur more than once.  A first pass counts all
+   * runs into hash buckets, so the candidate table is only spent on runs
+   * that may repeat; with few runs, that pass is skipped. */
+  void count ()
+  {
+    unsigned char *buckets = nullptr;
+    if (groups.length * HB_CFF_SUBR_MAX_GROUPS > HB_CFF_SUBR_MAX_CANDIDATES)
+    {
+      buckets = (unsigned char *) calloc (HB_CFF_SUBR_COUNT_BUCKETS, 1);
+      if (buckets)
+      {
+	bucket_counter_t counter = {buckets};
+	for_each_run (counter);
+      }
+    }
+    candidate_counter_t counter = {this, buckets};
+    for_each_run (counter);
+    free (buckets);
+  }
+
+  /* Keeps the candidates expected to save space, best first. */
+  bool select ()
+  {
+    hb_vector_t<subr_rank_t> ranks;
+    ranks.init ();
+    for (unsigned int c = 0; c < candidates.length; c++)
+    {
+      const subr_candidate_t &candidate = candidates[c];
+      /* Each call costs up to three bytes; the body adds a return and an
+       * INDEX offset. */
+      int saving = (int) candidate.count * ((int) candidate.length - 3) - (int) (candidate.length + 3);
+      if (candidate.count >= 2 && saving > 0)
+      {
+	subr_rank_t rank = {saving, c};
+	ranks.push (rank);
+      }
+    }
+    ranks.qsort (subr_rank_t::cmp);
+    for (unsigned int i = 0; i < ranks.length && i < HB_CFF_SUBR_MAX_SUBRS; i++)
+    {
+      candidates[ranks[i].candidate].rank = i;
+      selected.push (ranks[i].candidate);
+    }
+    bool ret = !ranks.in_error () && !selected.in_error ();
+    ranks.fini ();
+    return ret && rebuild_index ();
+  }
+
+  bool rebuild_index ()
+  {
+    index->clear ();
+    for (unsigned int i = 0; i < selected.length; i++)
+      index->set (candidates[selected[i]].hash, selected[i]);
+    return index->successful;
+  }
+
+  /* Finds the candidate to call at group j of glyph g, if any; of those
+   * that match, the one with the best estimated saving.  Once charstrings
+   * are being rewritten, candidates are compared against their subrs. */
+  unsigned int match (unsigned int g, unsigned int j,
+		      const str_buff_vec_t *subrs = nullptr) const
+  {
+    const unsigned char *data = charstrings[g].arrayZ ();
+    unsigned int end = glyph_groups[g + 1];
+    hb_codepoint_t hashes[HB_CFF_SUBR_MAX_GROUPS];
+    unsigned int lengths[HB_CFF_SUBR_MAX_GROUPS];
+    unsigned int n = 0;
+    hb_codepoint_t h = 2166136261u;
+    unsigned int length = 0;
+    for (; n < HB_CFF_SUBR_MAX_GROUPS && j + n < end && groups[j + n].extractable; n++)
+    {
+      const cs_group_t &group = groups[j + n];
+      h = _cs_hash (h, data + group.start, group.length);
+      length += group.length;
+      hashes[n] = _cs_hash_key (h);
+      lengths[n] = length;
+    }
+    unsigned int best = HB_MAP_VALUE_INVALID;
+    while (n--)
+    {
+      unsigned int c = index->get (hashes[n]);
+      if (c == HB_MAP_VALUE_INVALID) continue;
+      const subr_candidate_t &candidate = candidates[c];
+      if (candidate.num_groups == n + 1 && candidate.length == lengths[n] &&
+	  (best == HB_MAP_VALUE_INVALID || candidate.rank < candidates[best].rank) &&
+	  0 == memcmp (data + groups[j].start,
+		       subrs ? (*subrs)[candidate.num].arrayZ ()
+			     : charstrings[candidate.glyph].arrayZ () + candidate.start,
+		       candidate.length))
+	best = c;
+    }
+    return best;
+  }
+
+  void count_uses ()
+  {
+    for (unsigned int i = 0; i < selected.length; i++)
+      candidates[selected[i]].uses = 0;
+    for (unsigned int g = 0; g < charstrings.length; g++)
+    {
+      unsigned int end = glyph_groups[g + 1];
+      for (unsigned int j = glyph_groups[g]; j < end;)
+      {
+	unsigned int c = match (g, j);
+	if (c == HB_MAP_VALUE_INVALID)
+	  j++;
+	else
+	{
+	  candidates[c].uses++;
+	  j += candidates[c].num_groups;
+	}
+      }
+    }
+  }
+
+  /* Sorts the used candidates by use count, most used first. */
+  void rank_uses (hb_vector_t<subr_rank_t> &ranks) const
+  {
+    for (unsigned int i = 0; i < selected.length; i++)
+    {
+      subr_rank_t rank = {(int) candidates[selected[i]].uses, selected[i]};
+      if (rank.key)
+	ranks.push (rank);
+    }
+    ranks.qsort (subr_rank_t::cmp);
+  }
+
+  /* Drops used candidates that do not pay for themselves.  Unused ones are
+   * kept; they may get used once others are gone.  Returns whether any
+   * candidate was dropped. */
+  bool prune ()
+  {
+    hb_vector_t<subr_rank_t> ranks;
+    ranks.init ();
+    rank_uses (ranks);
+
+    unsigned int bias = _cs_subr_bias (ranks.length);
+    bool dropped = false;
+    for (unsigned int i = 0; i < ranks.length; i++)
+    {
+      subr_candidate_t &candidate = candidates[ranks[i].candidate];
+      int saving = (int) candidate.uses * ((int) candidate.length - (int) _cs_call_size (i, bias))
+		 - (int) (candidate.length + 3);
+      if (saving <= 0)
+      {
+	candidate.uses = (unsigned int) -1; /* Mark for removal. */
+	dropped = true;
+      }
+    }
+    ranks.fini ();
+
+    unsigned int j = 0;
+    for (unsigned int i = 0; i < selected.length; i++)
+      if (candidates[selected[i]].uses != (unsigned int) -1)
+	selected[j++] = selected[i];
+    selected.resize (j);
+    return dropped;
+  }
+
+  /* Numbers the used candidates, most used first, and drops the rest. */
+  void number ()
+  {
+    hb_vector_t<subr_rank_t> ranks;
+    ranks.init ();
+    rank_uses (ranks);
+
+    selected.resize (0);
+    for (unsigned int i = 0; i < ranks.length; i++)
+    {
+      candidates[ranks[i].candidate].num = i;
+      selected.push (ranks[i].candidate);
+    }
+    ranks.fini ();
+  }
+
+  bool emit (str_buff_vec_t &subrs)
+  {
+    /* Subroutine bodies first, as the charstrings are rewritten in place. */
+    if (unlikely (!subrs.resize (selected.length)))
+      return false;
+    for (unsigned int i = 0; i < selected.length; i++)
+    {
+      const subr_candidate_t &candidate = candidates[selected[i]];
+      str_buff_t &subr = subrs[i];
+      subr.init ();
+      if (unlikely (!subr.resize (candidate.length + 1)))
+	return false;
+      memcpy (subr.arrayZ (), charstrings[candidate.glyph].arrayZ () + candidate.start, candidate.length);
+      subr[candidate.length] = OpCode_return;
+    }
+
+    unsigned int bias = _cs_subr_bias (selected.length);
+    str_buff_t buff;
+    buff.init ();
+    bool success = true;
+    for (unsigned int g = 0; success && g < charstrings.length; g++)
+    {
+      const unsigned char *data = charstrings[g].arrayZ ();
+      str_encoder_t encoder (buff);
+      encoder.reset ();
+      unsigned int end = glyph_groups[g + 1];
+      for (unsigned int j = glyph_groups[g]; j < end;)
+      {
+	unsigned int c = match (g, j, &subrs);
+	if (c == HB_MAP_VALUE_INVALID)
+	{
+	  for (unsigned int k = 0; k < groups[j].length; k++)
+	    encoder.encode_byte (data[groups[j].start + k]);
+	  j++;
+	}
+	else
+	{
+	  encoder.encode_int ((int) candidates[c].num - (int) bias);
+	  encoder.encode_op (OpCode_callgsubr);
+	  j += candidates[c].num_groups;
+	}
+      }
+      success = !encoder.is_error () && charstrings[g].resize (buff.length);
+      if (success)
+	memcpy (charstrings[g].arrayZ (), buff.arrayZ (), buff.length);
+    }
+    buff.fini ();
+    return success;
+  }
+
+  str_buff_vec_t &charstrings;
+  hb_vector_t<cs_group_t> groups;
+  hb_vector_t<unsigned int> glyph_groups; /* First group of each glyph. */
+  hb_vector_t<subr_candidate_t> candidates;
+  hb_vector_t<unsigned int> selected;
+  hb_map_t *index; /* Hash to candidate. */
+};
+
+/**
+ * hb_plan_subset_cff_subroutinize
+ * Moves operator sequences shared between flattened CFF charstrings into
+ * new global subroutines, rewriting the charstrings to call them.
+ *
+ * Return value: false on allocation failure.  If the charstrings cannot
+ * be parsed, or nothing is worth sharing, they are left flat and subrs
+ * empty.
+ **/
+bool
+hb_plan_subset_cff_subroutinize (str_buff_vec_t &charstrings, /* IN/OUT */
+				 str_buff_vec_t &subrs /* OUT */)
+{
+  subrs.resize (0);
+
+  cs_subroutinizer_t subroutinizer (charstrings);
+  if (!subroutinizer.split ())
+    return !subroutinizer.groups.in_error () && !subroutinizer.glyph_groups.in_error ();
+
+  subroutinizer.count ();
+  if (unlikely (subroutinizer.candidates.in_error () || !subroutinizer.index->successful))
+    return false;
+  if (unlikely (!subroutinizer.select ()))
+    return false;
+
+  for (unsigned int pass = 1; pass < HB_CFF_SUBR_MAX_PASSES; pass++)
+  {
+    subroutinizer.count_uses ();
+    if (!subroutinizer.prune ())
+      break;
+    if (unlikely (!subroutinizer.rebuild_index ()))
+      return false;
+  }
+  subroutinizer.count_uses ();
+  subroutinizer.number ();
+  if (unlikely (subroutinizer.selected.in_error ()))
+    return false;
+  if (!subroutinizer.selected.length)
+    return true;
+
+  return subroutinizer.rebuild_index () && subroutinizer.emit (subrs);
+}
+
+/**
+ * hb_plan_subset_cff_outline_glyphs
+ * With retained glyph ids, collects the glyphs that have outlines, in
+ * order, skipping the empty ones.
+ *
+ * Return value: false on allocation failure.
+ **/
+bool
+hb_plan_subset_cff_outline_glyphs (const hb_vector_t<hb_codepoint_t> &glyphs,
+				   hb_vector_t<hb_codepoint_t> &outline_glyphs /* OUT */)
+{
+  outline_glyphs.resize (0);
+  for (unsigned int i = 0; i < glyphs.length; i++)
+    if (glyphs[i] != HB_MAP_VALUE_INVALID)
+      outline_glyphs.push (glyphs[i]);
+  return !outline_glyphs.in_error ();
+}
+
+/**
+ * hb_plan_subset_cff_spread_charstrings
+ * Moves the charstrings of the glyphs collected by
+ * hb_plan_subset_cff_outline_glyphs() to their glyph ids, giving the
+ * empty glyphs in between a copy of @empty_charstring.
+ *
+ * Return value: false on allocation failure.
+ **/
+bool
+hb_plan_subset_cff_spread_charstrings (const hb_vector_t<hb_codepoint_t> &glyphs,
+				       const str_buff_t &empty_charstring,
+				       str_buff_vec_t &charstrings /* IN/OUT */)
+{
+  unsigned int j = charstrings.length;
+  if (unlikely (!charstrings.resize (glyphs.length)))
+    return false;
+
+  /* Back to front, so that every slot written to has been vacated. */
+  for (unsigned int i = glyphs.length; i-- > 0;)
+  {
+    if (glyphs[i] != HB_MAP_VALUE_INVALID)
+    {
+      if (unlikely (!j)) return false;
+      if (--j != i)
+      {
+	memcpy ((void *) &charstrings[i], (const void *) &charstrings[j], sizeof (charstrings[i]));
+	charstrings[j].init ();
+      }
+      continue;
+    }
+
+    for (unsigned int k = 0; k < empty_charstring.length; k++)
+      charstrings[i].push (empty_charstring[k]);
+    if (unlikely (charstrings[i].in_error ()))
+      return false;
+  }
+  return j == 0;
+}
+
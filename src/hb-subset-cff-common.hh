@@ -282,6 +282,11 @@ struct flatten_param_t
   bool	drop_hints;
 };
 
+/* With an executor, charstrings are flattened in jobs of this many glyphs. */
+#ifndef HB_SUBSET_CFF_FLATTEN_JOB_GLYPHS
+#define HB_SUBSET_CFF_FLATTEN_JOB_GLYPHS 256
+#endif
+
 template <typename ACC, typename ENV, typename OPSET>
 struct subr_flattener_t
 {
@@ -290,17 +295,71 @@ struct subr_flattener_t
 		    bool drop_hints_) : acc (acc_), glyphs (glyphs_),
 					drop_hints (drop_hints_) {}
 
-  bool flatten (str_buff_vec_t &flat_charstrings)
+  bool flatten (str_buff_vec_t &flat_charstrings,
+		hb_subset_plan_t *plan = nullptr)
   {
     if (!flat_charstrings.resize (glyphs.length))
       return false;
     for (unsigned int i = 0; i < glyphs.length; i++)
       flat_charstrings[i].init ();
-    for (unsigned int i = 0; i < glyphs.length; i++)
+
+    /* Each glyph is flattened into its own buffer, independently of the
+     * others, so ranges of glyphs can be handed out to the executor.
+     * The plan's arena is not thread-safe, so the buffers only come from
+     * it when they are all flattened here. */
+    unsigned int num_jobs = (glyphs.length + HB_SUBSET_CFF_FLATTEN_JOB_GLYPHS - 1) / HB_SUBSET_CFF_FLATTEN_JOB_GLYPHS;
+    if (!plan || !plan->executor || num_jobs < 2)
+    {
+      if (plan)
+	for (unsigned int i = 0; i < glyphs.length; i++)
+	  flat_charstrings[i].set_arena (&plan->arena);
+      return flatten_range (flat_charstrings, 0, glyphs.length);
+    }
+
+    job_t *jobs = (job_t *) calloc (num_jobs, sizeof (jobs[0]));
+    if (unlikely (!jobs))
+      return false;
+    for (unsigned int i = 0; i < num_jobs; i++)
+    {
+      jobs[i].flattener = this;
+      jobs[i].flat_charstrings = &flat_charstrings;
+      jobs[i].start = i * HB_SUBSET_CFF_FLATTEN_JOB_GLYPHS;
+      jobs[i].end = MIN (jobs[i].start + HB_SUBSET_CFF_FLATTEN_JOB_GLYPHS, glyphs.length);
+    }
+
+    plan->executor (run_job, jobs, num_jobs, plan->executor_user_data);
+
+    bool success = true;
+    for (unsigned int i = 0; i < num_jobs; i++)
+      success = success && jobs[i].result;
+    free (jobs);
+    return success;
+  }
+
+  protected:
+  struct job_t
+  {
+    subr_flattener_t *flattener;
+    str_buff_vec_t *flat_charstrings;
+    unsigned int start;
+    unsigned int end;
+    bool result;
+  };
+
+  static void run_job (void *job_data, unsigned int job_index)
+  {
+    job_t *job = &((job_t *) job_data)[job_index];
+    job->result = job->flattener->flatten_range (*job->flat_charstrings, job->start, job->end);
+  }
+
+  bool flatten_range (str_buff_vec_t &flat_charstrings,
+		      unsigned int start, unsigned int end) const
+  {
+    for (unsigned int i = start; i < end; i++)
     {
       hb_codepoint_t  glyph = glyphs[i];
-      const byte_str_t str = (*acc.charStrings)[glyph];
-      unsigned int fd = acc.fdSelect->get_fd (glyph);
+      const byte_str_t str = acc.charStringsAccel[glyph];
+      unsigned int fd = acc.get_fd (glyph);
       if (unlikely (fd >= acc.fdCount))
       	return false;
       cs_interpreter_t<ENV, OPSET, flatten_param_t> interp;
@@ -663,8 +722,8 @@ struct subr_subsetter_t
     for (unsigned int i = 0; i < glyphs.length; i++)
     {
       hb_codepoint_t  glyph = glyphs[i];
-      const byte_str_t str = (*acc.charStrings)[glyph];
-      unsigned int fd = acc.fdSelect->get_fd (glyph);
+      const byte_str_t str = acc.charStringsAccel[glyph];
+      unsigned int fd = acc.get_fd (glyph);
       if (unlikely (fd >= acc.fdCount))
       	return false;
 
@@ -689,7 +748,7 @@ struct subr_subsetter_t
       /* mark hint ops and arguments for drop */
       for (unsigned int i = 0; i < glyphs.length; i++)
       {
-	unsigned int fd = acc.fdSelect->get_fd (glyphs[i]);
+	unsigned int fd = acc.get_fd (glyphs[i]);
 	if (unlikely (fd >= acc.fdCount))
 	  return false;
 	subr_subset_param_t  param;
@@ -711,7 +770,7 @@ struct subr_subsetter_t
       closures.reset ();
       for (unsigned int i = 0; i < glyphs.length; i++)
       {
-	unsigned int fd = acc.fdSelect->get_fd (glyphs[i]);
+	unsigned int fd = acc.get_fd (glyphs[i]);
 	if (unlikely (fd >= acc.fdCount))
 	  return false;
 	subr_subset_param_t  param;
@@ -728,13 +787,16 @@ struct subr_subsetter_t
     return true;
   }
 
-  bool encode_charstrings (ACC &acc, const hb_vector_t<hb_codepoint_t> &glyphs, str_buff_vec_t &buffArray) const
+  /* These take the encoded buffers' arrays from arena, if given. */
+  bool encode_charstrings (ACC &acc, const hb_vector_t<hb_codepoint_t> &glyphs, str_buff_vec_t &buffArray,
+			   hb_arena_t *arena = nullptr) const
   {
     if (unlikely (!buffArray.resize (glyphs.length)))
       return false;
     for (unsigned int i = 0; i < glyphs.length; i++)
     {
-      unsigned int  fd = acc.fdSelect->get_fd (glyphs[i]);
+      buffArray[i].set_arena (arena);
+      unsigned int  fd = acc.get_fd (glyphs[i]);
       if (unlikely (fd >= acc.fdCount))
       	return false;
       if (unlikely (!encode_str (parsed_charstrings[i], fd, buffArray[i])))
@@ -743,12 +805,15 @@ struct subr_subsetter_t
     return true;
   }
 
-  bool encode_subrs (const parsed_cs_str_vec_t &subrs, const subr_remap_t& remap, unsigned int fd, str_buff_vec_t &buffArray) const
+  bool encode_subrs (const parsed_cs_str_vec_t &subrs, const subr_remap_t& remap, unsigned int fd, str_buff_vec_t &buffArray,
+		     hb_arena_t *arena = nullptr) const
   {
     unsigned int  count = remap.get_count ();
 
     if (unlikely (!buffArray.resize (count)))
       return false;
+    for (unsigned int i = 0; i < count; i++)
+      buffArray[i].set_arena (arena);
     for (unsigned int old_num = 0; old_num < subrs.length; old_num++)
     {
       hb_codepoint_t new_num = remap[old_num];
@@ -761,14 +826,14 @@ struct subr_subsetter_t
     return true;
   }
 
-  bool encode_globalsubrs (str_buff_vec_t &buffArray)
+  bool encode_globalsubrs (str_buff_vec_t &buffArray, hb_arena_t *arena = nullptr)
   {
-    return encode_subrs (parsed_global_subrs, remaps.global_remap, 0, buffArray);
+    return encode_subrs (parsed_global_subrs, remaps.global_remap, 0, buffArray, arena);
   }
 
-  bool encode_localsubrs (unsigned int fd, str_buff_vec_t &buffArray) const
+  bool encode_localsubrs (unsigned int fd, str_buff_vec_t &buffArray, hb_arena_t *arena = nullptr) const
   {
-    return encode_subrs (parsed_local_subrs[fd], remaps.local_remaps[fd], fd, buffArray);
+    return encode_subrs (parsed_local_subrs[fd], remaps.local_remaps[fd], fd, buffArray, arena);
   }
 
   protected:
@@ -978,6 +1043,19 @@ hb_plan_subset_cff_fdselect (const hb_vector_t<hb_codepoint_t> &glyphs,
 			    hb_vector_t<CFF::code_pair_t> &fdselect_ranges /* OUT */,
 			    CFF::remap_t &fdmap /* OUT */);
 
+HB_INTERNAL bool
+hb_plan_subset_cff_subroutinize (CFF::str_buff_vec_t &charstrings, /* IN/OUT */
+				 CFF::str_buff_vec_t &subrs /* OUT */);
+
+HB_INTERNAL bool
+hb_plan_subset_cff_outline_glyphs (const hb_vector_t<hb_codepoint_t> &glyphs,
+				   hb_vector_t<hb_codepoint_t> &outline_glyphs /* OUT */);
+
+HB_INTERNAL bool
+hb_plan_subset_cff_spread_charstrings (const hb_vector_t<hb_codepoint_t> &glyphs,
+				       const CFF::str_buff_t &empty_charstring,
+				       CFF::str_buff_vec_t &charstrings /* IN/OUT */);
+
 HB_INTERNAL bool
 hb_serialize_cff_fdselect (hb_serialize_context_t *c,
 			  unsigned int num_glyphs,
@@ -475,6 +475,8 @@ struct cff_subset_plan {
     for (glyph = 1; glyph < plan->glyphs.length; glyph++)
     {
       hb_codepoint_t  orig_glyph = plan->glyphs[glyph];
+      if (orig_glyph == HB_MAP_VALUE_INVALID)
+	orig_glyph = glyph; /* Empty glyph with a retained id. */
       code = acc.glyph_to_code (orig_glyph);
       if (code == CFF_UNDEF_CODE)
       {
@@ -530,6 +532,8 @@ struct cff_subset_plan {
     for (glyph = 1; glyph < plan->glyphs.length; glyph++)
     {
       hb_codepoint_t  orig_glyph = plan->glyphs[glyph];
+      if (orig_glyph == HB_MAP_VALUE_INVALID)
+	orig_glyph = glyph; /* Empty glyph with a retained id. */
       sid = acc.glyph_to_sid (orig_glyph);
 
       if (!acc.is_CID ())
@@ -593,16 +597,22 @@ struct cff_subset_plan {
     if ((plan->glyphs.length == 0) || (plan->glyphs[0] != 0)) return false;
 
     final_size = 0;
+    /* These die with the plan; their arrays come from its arena. */
+    subset_fdselect_ranges.set_arena (&plan->arena);
+    subset_charstrings.set_arena (&plan->arena);
+    subset_globalsubrs.set_arena (&plan->arena);
+    subset_localsubrs.set_arena (&plan->arena);
     num_glyphs = plan->glyphs.length;
     orig_fdcount = acc.fdCount;
     drop_hints = plan->drop_hints;
-    desubroutinize = plan->desubroutinize;
+    desubroutinize = plan->desubroutinize || plan->resubroutinize;
 
     /* check whether the subset renumbers any glyph IDs */
     gid_renum = false;
     for (unsigned int glyph = 0; glyph < plan->glyphs.length; glyph++)
     {
-      if (plan->glyphs[glyph] != glyph) {
+      if (plan->glyphs[glyph] != glyph &&
+	  plan->glyphs[glyph] != HB_MAP_VALUE_INVALID) {
 	gid_renum = true;
 	break;
       }
@@ -671,6 +681,18 @@ struct cff_subset_plan {
       topdict_mod.reassignSIDs (sidmap);
     }
 
+    /* With retained glyph ids, only glyphs with outlines have their
+     * charstrings processed; the others are spread in afterwards. */
+    hb_vector_t<hb_codepoint_t> outline_glyphs;
+    outline_glyphs.set_arena (&plan->arena);
+    const hb_vector_t<hb_codepoint_t> *glyphs = &plan->glyphs;
+    if (plan->retain_gids)
+    {
+      if (unlikely (!hb_plan_subset_cff_outline_glyphs (plan->glyphs, outline_glyphs)))
+	return false;
+      glyphs = &outline_glyphs;
+    }
+
     /* String INDEX */
     {
       offsets.stringIndexInfo.offset = final_size;
@@ -682,24 +704,38 @@ struct cff_subset_plan {
     {
       /* Flatten global & local subrs */
       subr_flattener_t<const OT::cff1::accelerator_subset_t, cff1_cs_interp_env_t, cff1_cs_opset_flatten_t>
-		    flattener(acc, plan->glyphs, plan->drop_hints);
-      if (!flattener.flatten (subset_charstrings))
+		    flattener(acc, *glyphs, plan->drop_hints);
+      if (!flattener.flatten (subset_charstrings, plan))
 	return false;
 
-      /* no global/local subroutines */
-      offsets.globalSubrsInfo.size = CFF1Subrs::calculate_serialized_size (1, 0, 0);
+      if (plan->resubroutinize &&
+	  !hb_plan_subset_cff_subroutinize (subset_charstrings, subset_globalsubrs))
+	return false;
+
+      if (subset_globalsubrs.length)
+      {
+	/* new global subrs; no local subrs */
+	unsigned int dataSize = subset_globalsubrs.total_size ();
+	offsets.globalSubrsInfo.offSize = calcOffSize (dataSize);
+	if (unlikely (offsets.globalSubrsInfo.offSize > 4))
+	  return false;
+	offsets.globalSubrsInfo.size = CFF1Subrs::calculate_serialized_size (offsets.globalSubrsInfo.offSize, subset_globalsubrs.length, dataSize);
+      }
+      else
+	/* no global/local subroutines */
+	offsets.globalSubrsInfo.size = CFF1Subrs::calculate_serialized_size (1, 0, 0);
     }
     else
     {
       /* Subset subrs: collect used subroutines, leaving all unused ones behind */
-      if (!subr_subsetter.subset (acc, plan->glyphs, plan->drop_hints))
+      if (!subr_subsetter.subset (acc, *glyphs, plan->drop_hints))
 	return false;
 
       /* encode charstrings, global subrs, local subrs with new subroutine numbers */
-      if (!subr_subsetter.encode_charstrings (acc, plan->glyphs, subset_charstrings))
+      if (!subr_subsetter.encode_charstrings (acc, *glyphs, subset_charstrings, &plan->arena))
 	return false;
 
-      if (!subr_subsetter.encode_globalsubrs (subset_globalsubrs))
+      if (!subr_subsetter.encode_globalsubrs (subset_globalsubrs, &plan->arena))
 	return false;
 
       /* global subrs */
@@ -717,10 +753,11 @@ struct cff_subset_plan {
       for (unsigned int fd = 0; fd < orig_fdcount; fd++)
       {
 	subset_localsubrs[fd].init ();
+	subset_localsubrs[fd].set_arena (&plan->arena);
 	offsets.localSubrsInfos[fd].init ();
 	if (fdmap.includes (fd))
 	{
-	  if (!subr_subsetter.encode_localsubrs (fd, subset_localsubrs[fd]))
+	  if (!subr_subsetter.encode_localsubrs (fd, subset_localsubrs[fd], &plan->arena))
 	    return false;
 
 	  unsigned int dataSize = subset_localsubrs[fd].total_size ();
@@ -736,6 +773,18 @@ struct cff_subset_plan {
       }
     }
 
+    if (plan->retain_gids)
+    {
+      /* A lone endchar draws nothing. */
+      str_buff_t empty_charstring;
+      empty_charstring.push (OpCode_endchar);
+      bool spread = !empty_charstring.in_error () &&
+		    hb_plan_subset_cff_spread_charstrings (plan->glyphs, empty_charstring, subset_charstrings);
+      empty_charstring.fini ();
+      if (unlikely (!spread))
+	return false;
+    }
+
     /* global subrs */
     offsets.globalSubrsInfo.offset = final_size;
     final_size += offsets.globalSubrsInfo.size;
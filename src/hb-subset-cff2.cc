@@ -268,10 +268,15 @@ struct cff2_subset_plan {
 	      hb_subset_plan_t *plan)
   {
     final_size = 0;
+    /* These die with the plan; their arrays come from its arena. */
+    subset_fdselect_ranges.set_arena (&plan->arena);
+    subset_charstrings.set_arena (&plan->arena);
+    subset_globalsubrs.set_arena (&plan->arena);
+    subset_localsubrs.set_arena (&plan->arena);
     orig_fdcount = acc.fdArray->count;
 
     drop_hints = plan->drop_hints;
-    desubroutinize = plan->desubroutinize;
+    desubroutinize = plan->desubroutinize || plan->resubroutinize;
 
     /* CFF2 header */
     final_size += OT::cff2::static_size;
@@ -283,12 +288,24 @@ struct cff2_subset_plan {
       final_size += offsets.topDictInfo.size;
     }
 
+    /* With retained glyph ids, only glyphs with outlines have their
+     * charstrings processed; the others are spread in afterwards. */
+    hb_vector_t<hb_codepoint_t> outline_glyphs;
+    outline_glyphs.set_arena (&plan->arena);
+    const hb_vector_t<hb_codepoint_t> *glyphs = &plan->glyphs;
+    if (plan->retain_gids)
+    {
+      if (unlikely (!hb_plan_subset_cff_outline_glyphs (plan->glyphs, outline_glyphs)))
+	return false;
+      glyphs = &outline_glyphs;
+    }
+
     if (desubroutinize)
     {
       /* Flatten global & local subrs */
       subr_flattener_t<const OT::cff2::accelerator_subset_t, cff2_cs_interp_env_t, cff2_cs_opset_flatten_t>
-		    flattener(acc, plan->glyphs, plan->drop_hints);
-      if (!flattener.flatten (subset_charstrings))
+		    flattener(acc, *glyphs, plan->drop_hints);
+      if (!flattener.flatten (subset_charstrings, plan))
 	return false;
 
       /* no global/local subroutines */
@@ -297,14 +314,14 @@ struct cff2_subset_plan {
     else
     {
       /* Subset subrs: collect used subroutines, leaving all unused ones behind */
-      if (!subr_subsetter.subset (acc, plan->glyphs, plan->drop_hints))
+      if (!subr_subsetter.subset (acc, *glyphs, plan->drop_hints))
 	return false;
 
       /* encode charstrings, global subrs, local subrs with new subroutine numbers */
-      if (!subr_subsetter.encode_charstrings (acc, plan->glyphs, subset_charstrings))
+      if (!subr_subsetter.encode_charstrings (acc, *glyphs, subset_charstrings, &plan->arena))
 	return false;
 
-      if (!subr_subsetter.encode_globalsubrs (subset_globalsubrs))
+      if (!subr_subsetter.encode_globalsubrs (subset_globalsubrs, &plan->arena))
 	return false;
 
       /* global subrs */
@@ -320,10 +337,11 @@ struct cff2_subset_plan {
       for (unsigned int fd = 0; fd < orig_fdcount; fd++)
       {
 	subset_localsubrs[fd].init ();
+	subset_localsubrs[fd].set_arena (&plan->arena);
 	offsets.localSubrsInfos[fd].init ();
 	if (fdmap.includes (fd))
 	{
-	  if (!subr_subsetter.encode_localsubrs (fd, subset_localsubrs[fd]))
+	  if (!subr_subsetter.encode_localsubrs (fd, subset_localsubrs[fd], &plan->arena))
 	    return false;
 
 	  unsigned int dataSize = subset_localsubrs[fd].total_size ();
@@ -337,6 +355,14 @@ struct cff2_subset_plan {
       }
     }
 
+    if (plan->retain_gids)
+    {
+      /* CFF2 charstrings need no endchar; empty ones draw nothing. */
+      str_buff_t empty_charstring;
+      if (unlikely (!hb_plan_subset_cff_spread_charstrings (plan->glyphs, empty_charstring, subset_charstrings)))
+	return false;
+    }
+
     /* global subrs */
     offsets.globalSubrsInfo.offset = final_size;
     final_size += offsets.globalSubrsInfo.size;
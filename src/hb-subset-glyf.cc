@@ -26,53 +26,39 @@
 
 #include "hb-open-type.hh"
 #include "hb-ot-glyf-table.hh"
-#include "hb-set.h"
+#include "hb-set.hh"
 #include "hb-subset-glyf.hh"
 
+/* With an executor, glyphs are copied in jobs of this many glyphs. */
+#ifndef HB_SUBSET_GLYF_JOB_GLYPHS
+#define HB_SUBSET_GLYF_JOB_GLYPHS 1024
+#endif
+
+typedef OT::glyf::accelerator_t::glyph_range_t glyph_range_t;
+
 static bool
 _calculate_glyf_and_loca_prime_size (const OT::glyf::accelerator_t &glyf,
 				     hb_vector_t<hb_codepoint_t> &glyph_ids,
 				     hb_bool_t drop_hints,
+				     const hb_set_t *omit_glyphs,
 				     bool *use_short_loca /* OUT */,
 				     unsigned int *glyf_size /* OUT */,
 				     unsigned int *loca_size /* OUT */,
-				     hb_vector_t<unsigned int> *instruction_ranges /* OUT */)
+				     glyph_range_t *ranges /* OUT */,
+				     unsigned int *dest_offsets /* OUT */)
 {
+  if (unlikely (!glyf.get_glyph_ranges (glyph_ids.as_array (), drop_hints, ranges)))
+    return false;
+  if (omit_glyphs)
+    for (unsigned int i = 0; i < glyph_ids.length; i++)
+      if (omit_glyphs->has (glyph_ids[i]))
+	memset (&ranges[i], 0, sizeof (ranges[i]));
+
   unsigned int total = 0;
   for (unsigned int i = 0; i < glyph_ids.length; i++)
   {
-    hb_codepoint_t next_glyph = glyph_ids[i];
-    if (!instruction_ranges->resize (instruction_ranges->length + 2))
-    {
-      DEBUG_MSG(SUBSET, nullptr, "Failed to resize instruction_ranges.");
-      return false;
-    }
-    unsigned int *instruction_start = &(*instruction_ranges)[instruction_ranges->length - 2];
-    *instruction_start = 0;
-    unsigned int *instruction_end = &(*instruction_ranges)[instruction_ranges->length - 1];
-    *instruction_end = 0;
-
-    unsigned int start_offset, end_offset;
-    if (unlikely (!(glyf.get_offsets (next_glyph, &start_offset, &end_offset) &&
-		    glyf.remove_padding (start_offset, &end_offset))))
-    {
-      DEBUG_MSG(SUBSET, nullptr, "Invalid gid %d", next_glyph);
-      continue;
-    }
-    if (end_offset - start_offset < OT::glyf::GlyphHeader::static_size)
-      continue; /* 0-length glyph */
-
-    if (drop_hints)
-    {
-      if (unlikely (!glyf.get_instruction_offsets (start_offset, end_offset,
-						   instruction_start, instruction_end)))
-      {
-	DEBUG_MSG(SUBSET, nullptr, "Unable to get instruction offsets for %d", next_glyph);
-	return false;
-      }
-    }
-
-    total += end_offset - start_offset - (*instruction_end - *instruction_start);
+    dest_offsets[i] = total;
+    total += ranges[i].get_stripped_length ();
     /* round2 so short loca will work */
     total += total % 2;
   }
@@ -152,76 +138,149 @@ static bool _remove_composite_instruction_flag (char *glyf_prime, unsigned int l
   return true;
 }
 
-static bool
-_write_glyf_and_loca_prime (hb_subset_plan_t              *plan,
-			    const OT::glyf::accelerator_t &glyf,
-			    const char                    *glyf_data,
-			    bool                           use_short_loca,
-			    hb_vector_t<unsigned int> &instruction_ranges,
-			    unsigned int                   glyf_prime_size,
-			    char                          *glyf_prime_data /* OUT */,
-			    unsigned int                   loca_prime_size,
-			    char                          *loca_prime_data /* OUT */)
+/* Gathers the byte slices of consecutive glyphs into as few copies as
+ * possible: slices that are adjacent in both glyf and glyf' are merged. */
+struct glyf_copier_t
 {
-  hb_vector_t<hb_codepoint_t> &glyph_ids = plan->glyphs;
-  char *glyf_prime_data_next = glyf_prime_data;
+  const char *src;
+  char *dest;
+  unsigned int length;
 
-  bool success = true;
-  for (unsigned int i = 0; i < glyph_ids.length; i++)
+  void copy (const char *src_, char *dest_, unsigned int length_)
   {
-    unsigned int start_offset, end_offset;
-    if (unlikely (!(glyf.get_offsets (glyph_ids[i], &start_offset, &end_offset) &&
-		    glyf.remove_padding (start_offset, &end_offset))))
-      end_offset = start_offset = 0;
-
-    unsigned int instruction_start = instruction_ranges[i * 2];
-    unsigned int instruction_end = instruction_ranges[i * 2 + 1];
-
-    int length = end_offset - start_offset - (instruction_end - instruction_start);
-
-    if (glyf_prime_data_next + length > glyf_prime_data + glyf_prime_size)
+    if (src_ == src + length && dest_ == dest + length)
     {
-      DEBUG_MSG(SUBSET,
-		 nullptr,
-		 "WARNING: Attempted to write an out of bounds glyph entry for gid %d (length %d)",
-		 i, length);
-      return false;
+      length += length_;
+      return;
     }
+    flush ();
+    src = src_;
+    dest = dest_;
+    length = length_;
+  }
 
-    if (instruction_start == instruction_end)
-      memcpy (glyf_prime_data_next, glyf_data + start_offset, length);
-    else
+  void flush ()
+  {
+    if (length)
+      memcpy (dest, src, length);
+    length = 0;
+  }
+};
+
+struct glyf_writer_t
+{
+  hb_subset_plan_t *plan;
+  const char *glyf_data;
+  const glyph_range_t *ranges;
+  const unsigned int *dest_offsets;
+  bool use_short_loca;
+  unsigned int glyf_prime_size;
+  char *glyf_prime_data;
+  unsigned int loca_prime_size;
+  char *loca_prime_data;
+
+  /* Copies glyphs [start, end), which only touches their own bytes of
+   * glyf' and loca'.  The bytes around each glyph's instructions go
+   * straight from glyf to glyf'; runs of simple glyphs that need no
+   * patching are copied together. */
+  bool write_range (unsigned int start, unsigned int end) const
+  {
+    bool success = true;
+    glyf_copier_t copier = {nullptr, nullptr, 0};
+    for (unsigned int i = start; i < end; i++)
     {
-      memcpy (glyf_prime_data_next, glyf_data + start_offset, instruction_start - start_offset);
-      memcpy (glyf_prime_data_next + instruction_start - start_offset, glyf_data + instruction_end, end_offset - instruction_end);
-      /* if the instructions end at the end this was a composite glyph, else simple */
-      if (instruction_end == end_offset)
+      const glyph_range_t &range = ranges[i];
+      unsigned int length = range.get_stripped_length ();
+      if (dest_offsets[i] + length > glyf_prime_size)
       {
-	if (unlikely (!_remove_composite_instruction_flag (glyf_prime_data_next, length))) return false;
+	DEBUG_MSG(SUBSET,
+		   nullptr,
+		   "WARNING: Attempted to write an out of bounds glyph entry for gid %d (length %d)",
+		   i, length);
+	return false;
       }
+
+      const char *src = glyf_data + range.start_offset;
+      char *dest = glyf_prime_data + dest_offsets[i];
+      bool is_composite = length &&
+			  (int16_t) StructAtOffset<OT::glyf::GlyphHeader> (src, 0).numberOfContours < 0;
+      if (range.instruction_start == range.instruction_end)
+	copier.copy (src, dest, length);
       else
-	/* zero instruction length, which is just before instruction_start */
-	memset (glyf_prime_data_next + instruction_start - start_offset - 2, 0, 2);
+      {
+	unsigned int head_length = range.instruction_start - range.start_offset;
+	copier.copy (src, dest, head_length);
+	copier.copy (glyf_data + range.instruction_end, dest + head_length, length - head_length);
+	copier.flush ();
+	if (is_composite)
+	{
+	  if (unlikely (!_remove_composite_instruction_flag (dest, length))) return false;
+	}
+	else
+	  /* zero instruction length, which is just before instruction_start */
+	  memset (dest + head_length - 2, 0, 2);
+      }
+      if (is_composite)
+      {
+	copier.flush ();
+	_update_components (plan, dest, length);
+      }
+
+      success = success && _write_loca_entry (i,
+					      dest_offsets[i],
+					      use_short_loca,
+					      loca_prime_data,
+					      loca_prime_size);
     }
+    copier.flush ();
+    return success;
+  }
 
-    success = success && _write_loca_entry (i,
-					    glyf_prime_data_next - glyf_prime_data,
-					    use_short_loca,
-					    loca_prime_data,
-					    loca_prime_size);
-    _update_components (plan, glyf_prime_data_next, length);
+  struct job_t
+  {
+    const glyf_writer_t *writer;
+    unsigned int start;
+    unsigned int end;
+    bool result;
+  };
 
-    // TODO: don't align to two bytes if using long loca.
-    glyf_prime_data_next += length + (length % 2); // Align to 2 bytes for short loca.
+  static void run_job (void *job_data, unsigned int job_index)
+  {
+    job_t *job = &((job_t *) job_data)[job_index];
+    job->result = job->writer->write_range (job->start, job->end);
   }
 
-  success = success && _write_loca_entry (glyph_ids.length,
-					  glyf_prime_data_next - glyf_prime_data,
-					  use_short_loca,
-					  loca_prime_data,
-					  loca_prime_size);
-  return success;
-}
+  bool write (unsigned int num_glyphs) const
+  {
+    bool success = true;
+    unsigned int num_jobs = (num_glyphs + HB_SUBSET_GLYF_JOB_GLYPHS - 1) / HB_SUBSET_GLYF_JOB_GLYPHS;
+    job_t *jobs = plan->executor && num_jobs > 1 ?
+		  (job_t *) calloc (num_jobs, sizeof (jobs[0])) : nullptr;
+    if (jobs)
+    {
+      for (unsigned int i = 0; i < num_jobs; i++)
+      {
+	jobs[i].writer = this;
+	jobs[i].start = i * HB_SUBSET_GLYF_JOB_GLYPHS;
+	jobs[i].end = MIN (jobs[i].start + HB_SUBSET_GLYF_JOB_GLYPHS, num_glyphs);
+      }
+
+      plan->executor (run_job, jobs, num_jobs, plan->executor_user_data);
+
+      for (unsigned int i = 0; i < num_jobs; i++)
+	success = success && jobs[i].result;
+      free (jobs);
+    }
+    else
+      success = write_range (0, num_glyphs);
+
+    return success && _write_loca_entry (num_glyphs,
+					 glyf_prime_size,
+					 use_short_loca,
+					 loca_prime_data,
+					 loca_prime_size);
+  }
+};
 
 static bool
 _hb_subset_glyf_and_loca (const OT::glyf::accelerator_t  &glyf,
@@ -236,33 +295,37 @@ _hb_subset_glyf_and_loca (const OT::glyf::accelerator_t  &glyf,
 
   unsigned int glyf_prime_size;
   unsigned int loca_prime_size;
-  hb_vector_t<unsigned int> instruction_ranges;
-  instruction_ranges.init ();
+  /* These live in the plan's arena, so they're freed with the rest of
+   * the subsetting temporaries. */
+  glyph_range_t *ranges = plan->arena.alloc_array<glyph_range_t> (glyphs_to_retain.length);
+  unsigned int *dest_offsets = plan->arena.alloc_array<unsigned int> (glyphs_to_retain.length);
+  if (unlikely ((!ranges || !dest_offsets) && glyphs_to_retain.length))
+  {
+    DEBUG_MSG(SUBSET, nullptr, "Failed to allocate glyph ranges.");
+    return false;
+  }
 
   if (unlikely (!_calculate_glyf_and_loca_prime_size (glyf,
 						      glyphs_to_retain,
 						      plan->drop_hints,
+						      plan->omit_outlines,
 						      use_short_loca,
 						      &glyf_prime_size,
 						      &loca_prime_size,
-						      &instruction_ranges))) {
-    instruction_ranges.fini ();
+						      ranges,
+						      dest_offsets)))
     return false;
-  }
 
   char *glyf_prime_data = (char *) calloc (1, glyf_prime_size);
   char *loca_prime_data = (char *) calloc (1, loca_prime_size);
-  if (unlikely (!_write_glyf_and_loca_prime (plan, glyf, glyf_data,
-					     *use_short_loca,
-					     instruction_ranges,
-					     glyf_prime_size, glyf_prime_data,
-					     loca_prime_size, loca_prime_data))) {
+  glyf_writer_t writer = {plan, glyf_data, ranges, dest_offsets, *use_short_loca,
+			  glyf_prime_size, glyf_prime_data,
+			  loca_prime_size, loca_prime_data};
+  if (unlikely (!writer.write (glyphs_to_retain.length))) {
     free (glyf_prime_data);
     free (loca_prime_data);
-    instruction_ranges.fini ();
     return false;
   }
-  instruction_ranges.fini ();
 
   *glyf_prime = hb_blob_create (glyf_prime_data,
 				glyf_prime_size,
@@ -308,3 +371,102 @@ hb_subset_glyf_and_loca (hb_subset_plan_t *plan,
 
   return result;
 }
+
+/**
+ * hb_merge_glyf_and_loca:
+ * Builds the glyf and loca tables of @patch, with the glyphs it leaves
+ * empty taken from @base instead.
+ *
+ * Return value: whether the tables were built.
+ **/
+bool
+hb_merge_glyf_and_loca (hb_face_t   *base,
+			hb_face_t   *patch,
+			bool        *use_short_loca, /* OUT */
+			hb_blob_t  **glyf_prime, /* OUT */
+			hb_blob_t  **loca_prime /* OUT */)
+{
+  hb_face_t *faces[2] = {patch, base};
+  hb_blob_t *glyf_blobs[2];
+  const char *glyf_data[2];
+  OT::glyf::accelerator_t glyf[2];
+  for (unsigned int i = 0; i < 2; i++)
+  {
+    glyf_blobs[i] = hb_sanitize_context_t ().reference_table<OT::glyf> (faces[i]);
+    glyf_data[i] = hb_blob_get_data (glyf_blobs[i], nullptr);
+    glyf[i].init (faces[i]);
+  }
+
+  /* Each glyph from the first face that has it. */
+  unsigned int num_glyphs = patch->get_num_glyphs ();
+  unsigned int total = 0;
+  for (unsigned int gid = 0; gid < num_glyphs; gid++)
+    for (unsigned int i = 0; i < 2; i++)
+    {
+      unsigned int start_offset, end_offset;
+      if (glyf[i].get_offsets (gid, &start_offset, &end_offset) &&
+	  start_offset < end_offset)
+      {
+	total += end_offset - start_offset;
+	total += total % 2;
+	break;
+      }
+    }
+
+  *use_short_loca = total <= 131070;
+  unsigned int glyf_prime_size = total;
+  unsigned int loca_prime_size = (num_glyphs + 1) *
+				 (*use_short_loca ? sizeof (OT::HBUINT16) : sizeof (OT::HBUINT32));
+  char *glyf_prime_data = (char *) calloc (1, glyf_prime_size);
+  char *loca_prime_data = (char *) calloc (1, loca_prime_size);
+  bool success = (glyf_prime_data || !glyf_prime_size) && loca_prime_data;
+
+  glyf_copier_t copier = {nullptr, nullptr, 0};
+  unsigned int offset = 0;
+  for (unsigned int gid = 0; success && gid < num_glyphs; gid++)
+  {
+    success = _write_loca_entry (gid, offset, *use_short_loca,
+				 loca_prime_data, loca_prime_size);
+    for (unsigned int i = 0; i < 2; i++)
+    {
+      unsigned int start_offset, end_offset;
+      if (glyf[i].get_offsets (gid, &start_offset, &end_offset) &&
+	  start_offset < end_offset)
+      {
+	copier.copy (glyf_data[i] + start_offset, glyf_prime_data + offset,
+		     end_offset - start_offset);
+	offset += end_offset - start_offset;
+	offset += offset % 2;
+	break;
+      }
+    }
+  }
+  copier.flush ();
+  success = success && _write_loca_entry (num_glyphs, offset, *use_short_loca,
+					  loca_prime_data, loca_prime_size);
+
+  for (unsigned int i = 0; i < 2; i++)
+  {
+    glyf[i].fini ();
+    hb_blob_destroy (glyf_blobs[i]);
+  }
+
+  if (unlikely (!success))
+  {
+    free (glyf_prime_data);
+    free (loca_prime_data);
+    return false;
+  }
+
+  *glyf_prime = hb_blob_create (glyf_prime_data,
+				glyf_prime_size,
+				HB_MEMORY_MODE_READONLY,
+				glyf_prime_data,
+				free);
+  *loca_prime = hb_blob_create (loca_prime_data,
+				loca_prime_size,
+				HB_MEMORY_MODE_READONLY,
+				loca_prime_data,
+				free);
+  return true;
+}
@@ -37,4 +37,11 @@ hb_subset_glyf_and_loca (hb_subset_plan_t *plan,
 			 hb_blob_t       **glyf_prime      /* OUT */,
 			 hb_blob_t       **loca_prime      /* OUT */);
 
+HB_INTERNAL bool
+hb_merge_glyf_and_loca (hb_face_t   *base,
+			hb_face_t   *patch,
+			bool        *use_short_loca, /* OUT */
+			hb_blob_t  **glyf_prime      /* OUT */,
+			hb_blob_t  **loca_prime      /* OUT */);
+
 #endif /* HB_SUBSET_GLYF_HH */
@@ -144,3 +144,71 @@ hb_subset_input_get_desubroutinize (hb_subset_input_t *subset_input)
 {
   return subset_input->desubroutinize;
 }
+
+/**
+ * hb_subset_input_set_resubroutinize:
+ * @subset_input: a subset input.
+ * @resubroutinize: whether to re-subroutinize CFF charstrings.
+ *
+ * When set, CFF charstrings are flattened as with desubroutinizing, and
+ * then sequences of operators shared between glyphs are moved into new
+ * global subroutines.  This keeps the output close to the size of the
+ * original subroutinized font.  Only applies to CFF; CFF2 charstrings are
+ * just flattened.
+ *
+ * Since: REPLACEME
+ **/
+HB_EXTERN void
+hb_subset_input_set_resubroutinize (hb_subset_input_t *subset_input,
+        hb_bool_t resubroutinize)
+{
+  subset_input->resubroutinize = resubroutinize;
+}
+
+/**
+ * hb_subset_input_get_resubroutinize:
+ * @subset_input: a subset input.
+ *
+ * Return value: whether CFF charstrings are re-subroutinized.
+ *
+ * Since: REPLACEME
+ **/
+HB_EXTERN hb_bool_t
+hb_subset_input_get_resubroutinize (hb_subset_input_t *subset_input)
+{
+  return subset_input->resubroutinize;
+}
+
+/**
+ * hb_subset_input_set_retain_gids:
+ * @subset_input: a subset input.
+ * @retain_gids: whether to keep the glyph ids of the source font.
+ *
+ * When set, every retained glyph keeps its glyph id, instead of glyphs
+ * being renumbered densely.  The glyphs in between that are not
+ * retained are left empty, up to the largest retained glyph id.  Subsets
+ * of one font taken this way agree on glyph ids, so that shaping results
+ * and glyph caches stay valid as a client is sent more of the font.
+ *
+ * Since: REPLACEME
+ **/
+HB_EXTERN void
+hb_subset_input_set_retain_gids (hb_subset_input_t *subset_input,
+				 hb_bool_t retain_gids)
+{
+  subset_input->retain_gids = retain_gids;
+}
+
+/**
+ * hb_subset_input_get_retain_gids:
+ * @subset_input: a subset input.
+ *
+ * Return value: whether glyph ids of the source font are kept.
+ *
+ * Since: REPLACEME
+ **/
+HB_EXTERN hb_bool_t
+hb_subset_input_get_retain_gids (hb_subset_input_t *subset_input)
+{
+  return subset_input->retain_gids;
+}
@@ -44,6 +44,8 @@ struct hb_subset_input_t
   bool drop_hints : 1;
   bool drop_layout : 1;
   bool desubroutinize : 1;
+  bool resubroutinize : 1;
+  bool retain_gids : 1;
   /* TODO
    *
    * features
@@ -34,22 +34,47 @@
 
 static void
 _add_gid_and_children (const OT::glyf::accelerator_t &glyf,
+		       const OT::glyf::accelerator_t::component_graph_t *graph,
 		       hb_codepoint_t gid,
-		       hb_set_t *gids_to_retain)
+		       hb_set_t *gids_to_retain,
+		       hb_vector_t<hb_codepoint_t> *queue)
 {
   if (hb_set_has (gids_to_retain, gid))
     // Already visited this gid, ignore.
     return;
 
   hb_set_add (gids_to_retain, gid);
-
-  OT::glyf::CompositeGlyphHeader::Iterator composite;
-  if (glyf.get_composite (gid, &composite))
+  queue->push (gid);
+  while (queue->length)
   {
-    do
+    gid = (*queue)[queue->length - 1];
+    queue->pop ();
+
+    if (likely (graph))
+    {
+      hb_array_t<const hb_codepoint_t> components = (*graph)[gid];
+      for (unsigned int i = 0; i < components.length; i++)
+	if (!gids_to_retain->has (components[i]))
+	{
+	  gids_to_retain->add (components[i]);
+	  queue->push (components[i]);
+	}
+      continue;
+    }
+
+    OT::glyf::CompositeGlyphHeader::Iterator composite;
+    if (glyf.get_composite (gid, &composite))
     {
-      _add_gid_and_children (glyf, (hb_codepoint_t) composite.current->glyphIndex, gids_to_retain);
-    } while (composite.move_to_next());
+      do
+      {
+	hb_codepoint_t component = composite.current->glyphIndex;
+	if (!gids_to_retain->has (component))
+	{
+	  gids_to_retain->add (component);
+	  queue->push (component);
+	}
+      } while (composite.move_to_next());
+    }
   }
 }
 
@@ -93,84 +118,170 @@ _remove_invalid_gids (hb_set_t *glyphs,
   }
 }
 
-static hb_set_t *
-_populate_gids_to_retain (hb_face_t *face,
+/* Adds the requested code points found in a cmap walk to the plan. */
+struct _retain_unicodes_sink_t
+{
+  void add (hb_codepoint_t cp, hb_codepoint_t gid)
+  {
+    if (!requested->has (cp) || plan->unicodes->has (cp))
+      return;
+    plan->unicodes->add (cp);
+    plan->codepoint_to_glyph->set (cp, gid);
+    new_gids->add (gid);
+  }
+
+  hb_subset_plan_t *plan;
+  const hb_set_t *requested;
+  hb_set_t *new_gids;
+};
+
+/* Extends the plan's glyph set with the given unicodes and glyphs.
+ * Returns false if nothing changed. */
+static bool
+_populate_gids_to_retain (hb_subset_plan_t *plan,
 			  const hb_set_t *unicodes,
-			  bool close_over_gsub,
-			  hb_set_t *unicodes_to_retain,
-			  hb_map_t *codepoint_to_glyph,
-			  hb_vector_t<hb_codepoint_t> *glyphs)
+			  const hb_set_t *glyphs,
+			  bool close_over_gsub)
 {
-  OT::cmap::accelerator_t cmap;
-  OT::glyf::accelerator_t glyf;
-  OT::cff1::accelerator_t cff;
-  cmap.init (face);
-  glyf.init (face);
-  cff.init (face);
-
-  hb_set_t *initial_gids_to_retain = hb_set_create ();
-  initial_gids_to_retain->add (0); // Not-def
-
-  hb_codepoint_t cp = HB_SET_VALUE_INVALID;
-  while (unicodes->next (&cp))
+  hb_face_t *face = plan->source;
+  hb_face_use_t use (face);
+  const OT::cmap::accelerator_t &cmap = *face->table.cmap;
+  const OT::glyf::accelerator_t &glyf = *face->table.glyf;
+  const OT::cff1::accelerator_t &cff = *face->table.cff1;
+
+  /* Initial glyphs (before composite expansion) we haven't seen yet. */
+  hb_set_t new_gids;
+  if (plan->closure_glyphs->is_empty ())
+    new_gids.add (0); // Not-def
+
+  /* Large requests, such as keeping everything, are cheaper to answer by
+   * walking the cmap segments than by looking up every code point. */
+  if (unicodes->get_population () > face->get_num_glyphs ())
   {
-    hb_codepoint_t gid;
-    if (!cmap.get_nominal_glyph (cp, &gid))
+    _retain_unicodes_sink_t sink = {plan, unicodes, &new_gids};
+    cmap.collect_mapping (sink);
+  }
+  else
+  {
+    hb_codepoint_t cp = HB_SET_VALUE_INVALID;
+    while (unicodes->next (&cp))
     {
-      DEBUG_MSG(SUBSET, nullptr, "Drop U+%04X; no gid", cp);
-      continue;
+      if (plan->unicodes->has (cp))
+	continue;
+      hb_codepoint_t gid;
+      if (!cmap.get_nominal_glyph (cp, &gid))
+      {
+	DEBUG_MSG(SUBSET, nullptr, "Drop U+%04X; no gid", cp);
+	continue;
+      }
+      plan->unicodes->add (cp);
+      plan->codepoint_to_glyph->set (cp, gid);
+      new_gids.add (gid);
     }
-    unicodes_to_retain->add (cp);
-    codepoint_to_glyph->set (cp, gid);
-    initial_gids_to_retain->add (gid);
   }
 
+  hb_codepoint_t gid = HB_SET_VALUE_INVALID;
+  while (glyphs->next (&gid))
+    new_gids.add (gid);
+
+  new_gids.subtract (plan->closure_glyphs);
+  if (new_gids.is_empty ())
+    return false;
+
   if (close_over_gsub)
-    // Add all glyphs needed for GSUB substitutions.
-    _gsub_closure (face, initial_gids_to_retain);
+  {
+    // Add all glyphs needed for GSUB substitutions; these may combine
+    // new glyphs with ones already in the plan, so close over all of them.
+    hb_set_t closure;
+    closure.set (plan->closure_glyphs);
+    closure.union_ (&new_gids);
+    _gsub_closure (face, &closure);
+    closure.subtract (plan->closure_glyphs);
+    new_gids.set (&closure);
+  }
+  plan->closure_glyphs->union_ (&new_gids);
 
   // Populate a full set of glyphs to retain by adding all referenced
   // composite glyphs.
-  hb_codepoint_t gid = HB_SET_VALUE_INVALID;
-  hb_set_t *all_gids_to_retain = hb_set_create ();
-  while (initial_gids_to_retain->next (&gid))
+  const OT::glyf::accelerator_t::component_graph_t *graph = glyf.get_component_graph ();
+  hb_vector_t<hb_codepoint_t> queue;
+  gid = HB_SET_VALUE_INVALID;
+  while (new_gids.next (&gid))
   {
-    _add_gid_and_children (glyf, gid, all_gids_to_retain);
+    _add_gid_and_children (glyf, graph, gid, plan->glyphset, &queue);
     if (cff.is_valid ())
-      _add_cff_seac_components (cff, gid, all_gids_to_retain);
+      _add_cff_seac_components (cff, gid, plan->glyphset);
   }
-  hb_set_destroy (initial_gids_to_retain);
 
-  _remove_invalid_gids (all_gids_to_retain, face->get_num_glyphs ());
-
-  glyphs->alloc (all_gids_to_retain->get_population ());
-  gid = HB_SET_VALUE_INVALID;
-  while (all_gids_to_retain->next (&gid))
-    glyphs->push (gid);
+  _remove_invalid_gids (plan->glyphset, face->get_num_glyphs ());
 
-  cff.fini ();
-  glyf.fini ();
-  cmap.fini ();
-
-  return all_gids_to_retain;
+  return true;
 }
 
 static void
-_create_old_gid_to_new_gid_map (const hb_vector_t<hb_codepoint_t> &glyphs,
+_create_old_gid_to_new_gid_map (const hb_set_t *glyphset,
+				bool retain_gids,
+				hb_vector_t<hb_codepoint_t> *glyphs,
 				hb_map_t *glyph_map)
 {
-  for (unsigned int i = 0; i < glyphs.length; i++) {
-    glyph_map->set (glyphs[i], i);
+  glyphs->resize (0);
+  glyph_map->clear ();
+  glyph_map->alloc (glyphset->get_population ());
+
+  if (retain_gids)
+  {
+    /* Every glyph stays where it is; the ones in between are holes. */
+    unsigned int num_glyphs = glyphset->is_empty () ? 0 : glyphset->get_max () + 1;
+    if (unlikely (!glyphs->resize (num_glyphs))) return;
+    for (unsigned int i = 0; i < num_glyphs; i++)
+      (*glyphs)[i] = HB_MAP_VALUE_INVALID;
+    hb_codepoint_t gid = HB_SET_VALUE_INVALID;
+    while (glyphset->next (&gid))
+    {
+      glyph_map->set (gid, gid);
+      (*glyphs)[gid] = gid;
+    }
+    return;
+  }
+
+  glyphs->alloc (glyphset->get_population ());
+  hb_codepoint_t gid = HB_SET_VALUE_INVALID;
+  while (glyphset->next (&gid))
+  {
+    glyph_map->set (gid, glyphs->length);
+    glyphs->push (gid);
   }
 }
 
+static void
+_plan_add (hb_subset_plan_t *plan,
+	   const hb_set_t *unicodes,
+	   const hb_set_t *glyphs)
+{
+  if (_populate_gids_to_retain (plan, unicodes, glyphs, !plan->drop_layout))
+    _create_old_gid_to_new_gid_map (plan->glyphset,
+				    plan->retain_gids,
+				    &plan->glyphs,
+				    plan->glyph_map);
+
+  /* Both are only read from now on, unless the plan is extended. */
+  plan->codepoint_to_glyph->freeze ();
+  plan->glyph_map->freeze ();
+}
+
 /**
  * hb_subset_plan_create:
+ * @face: font face to be subset.
+ * @input: input to use for the subsetting.
+ *
  * Computes a plan for subsetting the supplied face according
  * to a provided input. The plan describes
  * which tables and glyphs should be retained.
+ * It can be extended with hb_subset_plan_add_unicodes() and
+ * hb_subset_plan_add_glyphs(), and executed any number of times
+ * with hb_subset_plan_execute().
  *
- * Return value: New subset plan.
+ * Return value: New subset plan, or %NULL on allocation failure.
  *
  * Since: 1.7.5
  **/
@@ -179,30 +290,118 @@ hb_subset_plan_create (hb_face_t           *face,
 		       hb_subset_input_t   *input)
 {
   hb_subset_plan_t *plan = hb_object_create<hb_subset_plan_t> ();
+  if (unlikely (!plan))
+    return nullptr;
 
   plan->drop_hints = input->drop_hints;
   plan->drop_layout = input->drop_layout;
   plan->desubroutinize = input->desubroutinize;
+  plan->resubroutinize = input->resubroutinize;
+  plan->retain_gids = input->retain_gids;
   plan->unicodes = hb_set_create();
   plan->glyphs.init();
+  plan->glyphset = hb_set_create ();
+  plan->closure_glyphs = hb_set_create ();
   plan->source = hb_face_reference (face);
   plan->dest = hb_face_builder_create ();
   plan->codepoint_to_glyph = hb_map_create();
   plan->glyph_map = hb_map_create();
-  plan->glyphset = _populate_gids_to_retain (face,
-					     input->unicodes,
-					     !plan->drop_layout,
-					     plan->unicodes,
-					     plan->codepoint_to_glyph,
-					     &plan->glyphs);
-  _create_old_gid_to_new_gid_map (plan->glyphs,
-				  plan->glyph_map);
+  plan->arena.init ();
+
+  _plan_add (plan, input->unicodes, input->glyphs);
 
   return plan;
 }
 
 /**
- * hb_subset_plan_destroy:
+ * hb_subset_plan_reference: (skip)
+ * @plan: a subset plan.
+ *
+ * Return value: @plan.
+ *
+ * Since: REPLACEME
+ **/
+hb_subset_plan_t *
+hb_subset_plan_reference (hb_subset_plan_t *plan)
+{
+  return hb_object_reference (plan);
+}
+
+/**
+ * hb_subset_plan_add_unicodes:
+ * @plan: a subset plan.
+ * @unicodes: codepoints to additionally retain.
+ *
+ * Extends @plan to also retain @unicodes.  Work done for the
+ * codepoints and glyphs already in the plan is reused.
+ *
+ * Since: REPLACEME
+ **/
+void
+hb_subset_plan_add_unicodes (hb_subset_plan_t *plan,
+			     const hb_set_t   *unicodes)
+{
+  if (unlikely (!plan || hb_object_is_inert (plan))) return;
+
+  _plan_add (plan, unicodes, &Null(hb_set_t));
+}
+
+/**
+ * hb_subset_plan_add_glyphs:
+ * @plan: a subset plan.
+ * @glyphs: glyph ids to additionally retain.
+ *
+ * Extends @plan to also retain @glyphs.  Work done for the
+ * codepoints and glyphs already in the plan is reused.
+ *
+ * Since: REPLACEME
+ **/
+void
+hb_subset_plan_add_glyphs (hb_subset_plan_t *plan,
+			   const hb_set_t   *glyphs)
+{
+  if (unlikely (!plan || hb_object_is_inert (plan))) return;
+
+  _plan_add (plan, &Null(hb_set_t), glyphs);
+}
+
+/**
+ * hb_subset_plan_set_executor_func:
+ * @plan: a subset plan.
+ * @func: (closure user_data) (destroy destroy) (scope notified): executor.
+ * @user_data: data to pass to @func.
+ * @destroy: function to call when @user_data is not needed anymore.
+ *
+ * Makes hb_subset_plan_execute() subset the tables of the face
+ * concurrently, as jobs run by @func, for example on a thread pool.
+ * The resulting face is the same as when subsetting sequentially.
+ *
+ * Since: REPLACEME
+ **/
+void
+hb_subset_plan_set_executor_func (hb_subset_plan_t          *plan,
+				  hb_subset_executor_func_t  func,
+				  void                      *user_data,
+				  hb_destroy_func_t          destroy)
+{
+  if (unlikely (!plan || hb_object_is_inert (plan)))
+  {
+    if (destroy)
+      destroy (user_data);
+    return;
+  }
+
+  if (plan->executor_destroy)
+    plan->executor_destroy (plan->executor_user_data);
+
+  plan->executor = func;
+  plan->executor_user_data = user_data;
+  plan->executor_destroy = destroy;
+}
+
+/**
+ * hb_subset_plan_destroy: (skip)
+ * @plan: a subset plan.
  *
  * Since: 1.7.5
  **/
@@ -218,6 +417,10 @@ hb_subset_plan_destroy (hb_subset_plan_t *plan)
   hb_map_destroy (plan->codepoint_to_glyph);
   hb_map_destroy (plan->glyph_map);
   hb_set_destroy (plan->glyphset);
+  hb_set_destroy (plan->closure_glyphs);
+  plan->arena.fini ();
+  if (plan->executor_destroy)
+    plan->executor_destroy (plan->executor_user_data);
 
   free (plan);
 }
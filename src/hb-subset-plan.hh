@@ -33,6 +33,7 @@
 #include "hb-subset-input.hh"
 
 #include "hb-map.hh"
+#include "hb-arena.hh"
 
 struct hb_subset_plan_t
 {
@@ -41,20 +42,41 @@ struct hb_subset_plan_t
   bool drop_hints : 1;
   bool drop_layout : 1;
   bool desubroutinize : 1;
+  bool resubroutinize : 1;
+  bool retain_gids : 1;
 
   // For each cp that we'd like to retain maps to the corresponding gid.
   hb_set_t *unicodes;
 
+  // Old gid of each new gid.  With retain_gids these are the same, and
+  // the gids not retained are holes, HB_MAP_VALUE_INVALID, that the
+  // tables leave empty.
   hb_vector_t<hb_codepoint_t> glyphs;
   hb_set_t *glyphset;
+  // Retained glyphs before adding composite components; kept so that
+  // the plan can be extended incrementally.
+  hb_set_t *closure_glyphs;
 
   hb_map_t *codepoint_to_glyph;
   hb_map_t *glyph_map;
 
+  // While executing a patch, glyphs whose outlines the client already
+  // has; glyf leaves them empty.
+  const hb_set_t *omit_outlines;
+
   // Plan is only good for a specific source/dest so keep them with it
   hb_face_t *source;
   hb_face_t *dest;
 
+  // Runs per-table subsetting jobs; nullptr means one after another.
+  hb_subset_executor_func_t executor;
+  void *executor_user_data;
+  hb_destroy_func_t executor_destroy;
+
+  // Scratch memory for subsetting the tables; released after each
+  // hb_subset_plan_execute().
+  hb_arena_t arena;
+
   bool new_gid_for_codepoint (hb_codepoint_t codepoint,
 			      hb_codepoint_t *new_gid) const
   {
@@ -90,13 +112,4 @@ struct hb_subset_plan_t
   }
 };
 
-typedef struct hb_subset_plan_t hb_subset_plan_t;
-
-HB_INTERNAL hb_subset_plan_t *
-hb_subset_plan_create (hb_face_t           *face,
-                       hb_subset_input_t   *input);
-
-HB_INTERNAL void
-hb_subset_plan_destroy (hb_subset_plan_t *plan);
-
 #endif /* HB_SUBSET_PLAN_HH */
@@ -82,8 +82,10 @@ _subset2 (hb_subset_plan_t *plan)
   retry:
     hb_serialize_context_t serializer ((void *) buf, buf_size);
     hb_subset_context_t c (plan, &serializer);
+    serializer.start_serialize<TableType> ();
     result = table->subset (&c);
-    if (serializer.in_error ())
+    serializer.end_serialize ();
+    if (serializer.ran_out_of_room)
     {
       buf_size += (buf_size >> 1) + 32;
       DEBUG_MSG(SUBSET, nullptr, "OT::%c%c%c%c ran out of room; reallocating to %u bytes.", HB_UNTAG (tag), buf_size);
@@ -94,7 +96,12 @@ _subset2 (hb_subset_plan_t *plan)
       }
       goto retry;
     }
-    if (result)
+    if (unlikely (serializer.in_error ()))
+    {
+      DEBUG_MSG(SUBSET, nullptr, "OT::%c%c%c%c failed to serialize.", HB_UNTAG (tag));
+      result = false;
+    }
+    else if (result)
     {
       hb_blob_t *dest_blob = serializer.copy_blob ();
       DEBUG_MSG(SUBSET, nullptr, "OT::%c%c%c%c final subset table size: %u bytes.", HB_UNTAG (tag), dest_blob->length);
@@ -135,9 +142,9 @@ _subset (hb_subset_plan_t *plan)
 }
 
 
-static bool
-_subset_table (hb_subset_plan_t *plan,
-	       hb_tag_t          tag)
+bool
+_hb_subset_table (hb_subset_plan_t *plan,
+		  hb_tag_t          tag)
 {
   DEBUG_MSG(SUBSET, nullptr, "begin subset %c%c%c%c", HB_UNTAG (tag));
   bool result = true;
@@ -212,8 +219,8 @@ _subset_table (hb_subset_plan_t *plan,
   return result;
 }
 
-static bool
-_should_drop_table (hb_subset_plan_t *plan, hb_tag_t tag)
+bool
+_hb_subset_should_drop_table (hb_subset_plan_t *plan, hb_tag_t tag)
 {
   switch (tag) {
     case HB_TAG ('c', 'v', 'a', 'r'): /* hint table, fallthrough */
@@ -253,6 +260,144 @@ _should_drop_table (hb_subset_plan_t *plan, hb_tag_t tag)
   }
 }
 
+struct hb_subset_table_job_t
+{
+  hb_subset_plan_t *plan;
+  hb_tag_t tag;
+  bool result;
+};
+
+static void
+_hb_subset_run_table_job (void *job_data, unsigned int job_index)
+{
+  hb_subset_table_job_t *job = (hb_subset_table_job_t *) job_data + job_index;
+  job->result = _hb_subset_table (job->plan, job->tag);
+}
+
+/* Subsets each table with its own copy of the plan, writing to its own
+ * builder face, then collects the tables in order. */
+static bool
+_hb_subset_tables_parallel (hb_subset_plan_t *plan,
+			    const hb_vector_t<hb_tag_t> &tags)
+{
+  unsigned int count = tags.length;
+  hb_subset_table_job_t *jobs = (hb_subset_table_job_t *) calloc (count, sizeof (jobs[0]));
+  hb_subset_plan_t *job_plans = (hb_subset_plan_t *) calloc (count, sizeof (job_plans[0]));
+  if (unlikely (!jobs || !job_plans))
+  {
+    free (jobs);
+    free (job_plans);
+    return false;
+  }
+
+  for (unsigned int i = 0; i < count; i++)
+  {
+    /* A shallow copy; it's never destroyed as a plan, only freed. */
+    memcpy ((void *) &job_plans[i], (const void *) plan, sizeof (*plan));
+    job_plans[i].dest = hb_face_builder_create ();
+    job_plans[i].arena.init ();
+    jobs[i].plan = &job_plans[i];
+    jobs[i].tag = tags[i];
+  }
+
+  plan->executor (_hb_subset_run_table_job, jobs, count, plan->executor_user_data);
+
+  bool success = true;
+  for (unsigned int i = 0; i < count; i++)
+  {
+    success = success && jobs[i].result &&
+	      _hb_face_builder_add_tables_from (plan->dest, job_plans[i].dest);
+    hb_face_destroy (job_plans[i].dest);
+    job_plans[i].arena.fini ();
+  }
+
+  free (jobs);
+  free (job_plans);
+  return success;
+}
+
+/**
+ * hb_subset_plan_execute:
+ * @plan: a subset plan.
+ *
+ * Subsets the plan's source face according to @plan.  Can be called
+ * again after extending the plan.
+ *
+ * Return value: (transfer full): the subset face, or the empty face on
+ * failure.
+ *
+ * Since: REPLACEME
+ **/
+hb_face_t *
+hb_subset_plan_execute (hb_subset_plan_t *plan)
+{
+  if (unlikely (!plan || hb_object_is_inert (plan))) return hb_face_get_empty ();
+
+  /* Start from a fresh destination face each time. */
+  hb_face_destroy (plan->dest);
+  plan->dest = hb_face_builder_create ();
+
+  hb_face_t *source = plan->source;
+  hb_vector_t<hb_tag_t> tags;
+  hb_tag_t table_tags[32];
+  unsigned int offset = 0, count;
+  bool success = true;
+  do {
+    count = ARRAY_LENGTH (table_tags);
+    hb_face_get_table_tags (source, offset, &count, table_tags);
+    for (unsigned int i = 0; i < count; i++)
+    {
+      hb_tag_t tag = table_tags[i];
+      if (_hb_subset_should_drop_table (plan, tag))
+      {
+	DEBUG_MSG(SUBSET, nullptr, "drop %c%c%c%c", HB_UNTAG (tag));
+	continue;
+      }
+      if (plan->executor)
+	tags.push (tag);
+      else
+	success = success && _hb_subset_table (plan, tag);
+    }
+    offset += count;
+  } while (success && count == ARRAY_LENGTH (table_tags));
+
+  if (plan->executor)
+    success = !tags.in_error () && _hb_subset_tables_parallel (plan, tags);
+
+  plan->arena.fini ();
+
+  return success ? hb_face_reference (plan->dest) : hb_face_get_empty ();
+}
+
+/**
+ * hb_subset_plan_execute_patch:
+ * @plan: a subset plan that retains glyph ids.
+ * @have_glyphs: glyphs the client already has outlines for.
+ *
+ * Like hb_subset_plan_execute(), but leaves the glyphs in @have_glyphs
+ * empty in glyf, so the result only carries the outlines the client is
+ * missing.  All other tables are complete, CFF outlines included.
+ * Combine the result with what the client has using
+ * hb_subset_merge_glyphs().
+ *
+ * Return value: (transfer full): the patch face, or the empty face on
+ * failure or if @plan does not retain glyph ids.
+ *
+ * Since: REPLACEME
+ **/
+hb_face_t *
+hb_subset_plan_execute_patch (hb_subset_plan_t *plan,
+			      const hb_set_t   *have_glyphs)
+{
+  if (unlikely (!plan || hb_object_is_inert (plan) || !plan->retain_gids))
+    return hb_face_get_empty ();
+
+  plan->omit_outlines = have_glyphs;
+  hb_face_t *result = hb_subset_plan_execute (plan);
+  plan->omit_outlines = nullptr;
+  return result;
+}
+
 /**
  * hb_subset:
  * @source: font face data to be subset.
@@ -267,27 +412,99 @@ hb_subset (hb_face_t *source,
   if (unlikely (!input || !source)) return hb_face_get_empty ();
 
   hb_subset_plan_t *plan = hb_subset_plan_create (source, input);
+  hb_face_t *result = hb_subset_plan_execute (plan);
+  hb_subset_plan_destroy (plan);
+  return result;
+}
+
+static bool
+_hb_subset_merge_glyf (hb_face_t *base, hb_face_t *patch, hb_face_t *dest)
+{
+  bool use_short_loca = false;
+  hb_blob_t *glyf_prime = nullptr;
+  hb_blob_t *loca_prime = nullptr;
+  if (unlikely (!hb_merge_glyf_and_loca (base, patch, &use_short_loca,
+					 &glyf_prime, &loca_prime)))
+    return false;
 
+  bool success = hb_face_builder_add_table (dest, HB_OT_TAG_glyf, glyf_prime) &&
+		 hb_face_builder_add_table (dest, HB_OT_TAG_loca, loca_prime);
+  hb_blob_destroy (glyf_prime);
+  hb_blob_destroy (loca_prime);
+
+  hb_blob_t *head_blob = hb_sanitize_context_t ().reference_table<OT::head> (patch);
+  hb_blob_t *head_prime_blob = hb_blob_copy_writable_or_fail (head_blob);
+  hb_blob_destroy (head_blob);
+  if (unlikely (!head_prime_blob))
+    return false;
+
+  OT::head *head_prime = (OT::head *) hb_blob_get_data_writable (head_prime_blob, nullptr);
+  head_prime->indexToLocFormat.set (use_short_loca ? 0 : 1);
+  success = success && hb_face_builder_add_table (dest, HB_OT_TAG_head, head_prime_blob);
+  hb_blob_destroy (head_prime_blob);
+  return success;
+}
+
+/**
+ * hb_subset_merge_glyphs:
+ * @base: a face the client has, subset with retained glyph ids.
+ * @patch: a face from hb_subset_plan_execute_patch() on the same font,
+ * omitting the glyphs @base has.
+ *
+ * Fills the glyphs @patch leaves empty in glyf in from @base.  Every other
+ * table is taken from @patch as is, so nothing but glyf, loca and head is
+ * rebuilt.  For fonts without glyf this is just @patch.
+ *
+ * Return value: (transfer full): the merged face, or the empty face on
+ * failure.
+ *
+ * Since: REPLACEME
+ **/
+hb_face_t *
+hb_subset_merge_glyphs (hb_face_t *base, hb_face_t *patch)
+{
+  if (unlikely (!base || !patch)) return hb_face_get_empty ();
+
+  /* glyf itself is empty when the patch has no new outlines. */
+  hb_blob_t *loca_blob = hb_face_reference_table (patch, HB_OT_TAG_loca);
+  bool has_glyf = hb_blob_get_length (loca_blob);
+  hb_blob_destroy (loca_blob);
+  if (!has_glyf)
+    return hb_face_reference (patch);
+
+  /* hb_face_get_table_tags() knows no tables of builder faces, which
+   * patches are; list them from the font file the builder makes. */
+  hb_blob_t *patch_blob = hb_face_reference_blob (patch);
+  hb_face_t *patch_file = hb_face_create (patch_blob, 0);
+  hb_blob_destroy (patch_blob);
+
+  hb_face_t *dest = hb_face_builder_create ();
   hb_tag_t table_tags[32];
   unsigned int offset = 0, count;
   bool success = true;
   do {
     count = ARRAY_LENGTH (table_tags);
-    hb_face_get_table_tags (source, offset, &count, table_tags);
+    hb_face_get_table_tags (patch_file, offset, &count, table_tags);
     for (unsigned int i = 0; i < count; i++)
     {
       hb_tag_t tag = table_tags[i];
-      if (_should_drop_table (plan, tag))
-      {
-	DEBUG_MSG(SUBSET, nullptr, "drop %c%c%c%c", HB_UNTAG (tag));
+      if (tag == HB_OT_TAG_glyf || tag == HB_OT_TAG_loca || tag == HB_OT_TAG_head)
 	continue;
-      }
-      success = success && _subset_table (plan, tag);
+      hb_blob_t *blob = hb_face_reference_table (patch_file, tag);
+      success = success && hb_face_builder_add_table (dest, tag, blob);
+      hb_blob_destroy (blob);
     }
     offset += count;
   } while (success && count == ARRAY_LENGTH (table_tags));
 
-  hb_face_t *result = success ? hb_face_reference (plan->dest) : hb_face_get_empty ();
-  hb_subset_plan_destroy (plan);
-  return result;
+  success = success && _hb_subset_merge_glyf (base, patch_file, dest);
+  hb_face_destroy (patch_file);
+
+  if (unlikely (!success))
+  {
+    hb_face_destroy (dest);
+    return hb_face_get_empty ();
+  }
+  return dest;
 }
+
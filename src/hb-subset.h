@@ -72,10 +72,97 @@ hb_subset_input_set_desubroutinize (hb_subset_input_t *subset_input,
 HB_EXTERN hb_bool_t
 hb_subset_input_get_desubroutinize (hb_subset_input_t *subset_input);
 
+HB_EXTERN void
+hb_subset_input_set_resubroutinize (hb_subset_input_t *subset_input,
+        hb_bool_t resubroutinize);
+HB_EXTERN hb_bool_t
+hb_subset_input_get_resubroutinize (hb_subset_input_t *subset_input);
+
+HB_EXTERN void
+hb_subset_input_set_retain_gids (hb_subset_input_t *subset_input,
+				 hb_bool_t retain_gids);
+HB_EXTERN hb_bool_t
+hb_subset_input_get_retain_gids (hb_subset_input_t *subset_input);
+
+/*
+ * hb_subset_plan_t
+ *
+ * The glyph closure and mappings computed from an input.  Can be
+ * extended and reused for several subsets of the same face.
+ */
+
+typedef struct hb_subset_plan_t hb_subset_plan_t;
+
+HB_EXTERN hb_subset_plan_t *
+hb_subset_plan_create (hb_face_t         *face,
+		       hb_subset_input_t *input);
+
+HB_EXTERN hb_subset_plan_t *
+hb_subset_plan_reference (hb_subset_plan_t *plan);
+
+HB_EXTERN void
+hb_subset_plan_destroy (hb_subset_plan_t *plan);
+
+HB_EXTERN void
+hb_subset_plan_add_unicodes (hb_subset_plan_t *plan,
+			     const hb_set_t   *unicodes);
+
+HB_EXTERN void
+hb_subset_plan_add_glyphs (hb_subset_plan_t *plan,
+			   const hb_set_t   *glyphs);
+
+/**
+ * hb_subset_job_func_t:
+ * @job_data: data to pass back to the job.
+ * @job_index: which job to run.
+ *
+ * Since: REPLACEME
+ **/
+typedef void (*hb_subset_job_func_t) (void         *job_data,
+				      unsigned int  job_index);
+
+/**
+ * hb_subset_executor_func_t:
+ * @job: function to run.
+ * @job_data: first argument to @job.
+ * @num_jobs: number of jobs.
+ * @user_data: user data passed to hb_subset_plan_set_executor_func().
+ *
+ * Must call @job (@job_data, i) for every i in [0, @num_jobs), in any
+ * order and on any threads, and return once all of them are done.
+ *
+ * A job may call the executor again to split up its own work, as CFF
+ * desubroutinization does; the executor must not deadlock when that
+ * happens, for example by running nested jobs on the calling thread
+ * when no other thread is available.
+ *
+ * Since: REPLACEME
+ **/
+typedef void (*hb_subset_executor_func_t) (hb_subset_job_func_t  job,
+					   void                 *job_data,
+					   unsigned int          num_jobs,
+					   void                 *user_data);
+
+HB_EXTERN void
+hb_subset_plan_set_executor_func (hb_subset_plan_t          *plan,
+				  hb_subset_executor_func_t  func,
+				  void                      *user_data,
+				  hb_destroy_func_t          destroy);
+
+HB_EXTERN hb_face_t *
+hb_subset_plan_execute (hb_subset_plan_t *plan);
+
+HB_EXTERN hb_face_t *
+hb_subset_plan_execute_patch (hb_subset_plan_t *plan,
+			      const hb_set_t   *have_glyphs);
+
 /* hb_subset () */
 HB_EXTERN hb_face_t *
 hb_subset (hb_face_t *source, hb_subset_input_t *input);
 
+HB_EXTERN hb_face_t *
+hb_subset_merge_glyphs (hb_face_t *base, hb_face_t *patch);
+
 
 HB_END_DECLS
 
@@ -46,14 +46,25 @@ struct hb_subset_context_t :
 
   hb_subset_plan_t *plan;
   hb_serialize_context_t *serializer;
+  /* Old to new indices of the retained GSUB/GPOS lookups, while
+   * subsetting their features; nullptr keeps lookup indices as-is. */
+  const hb_map_t *lookup_index_map;
   unsigned int debug_depth;
 
   hb_subset_context_t (hb_subset_plan_t *plan_,
 		       hb_serialize_context_t *serializer_) :
 			plan (plan_),
 			serializer (serializer_),
+			lookup_index_map (nullptr),
 			debug_depth (0) {}
 };
 
+/* The per-table steps of hb_subset(); exposed for the subset benchmark. */
+HB_INTERNAL bool
+_hb_subset_should_drop_table (hb_subset_plan_t *plan, hb_tag_t tag);
+
+HB_INTERNAL bool
+_hb_subset_table (hb_subset_plan_t *plan, hb_tag_t tag);
+
 
 #endif /* HB_SUBSET_HH */
@@ -17,6 +17,7 @@
 #include "hb.hh"
 
 #include "hb-machinery.hh"
+#include "hb-unicode.hh"
 
 #include "ucdn.h"
 
@@ -205,11 +206,120 @@ hb_ucdn_script(hb_unicode_funcs_t *ufuncs HB_UNUSED,
     return ucdn_script_translate[ucdn_get_script(unicode)];
 }
 
+/* The canonical compositions of a character below U+2000, which covers
+ * Latin, Greek and Cyrillic, with a combining diacritical mark, by far
+ * the most asked for, keyed by mark and then first character.  Within
+ * that range the table is authoritative, and saves UCDN's searches over
+ * its composition index for the many pairs that don't compose. */
+
+#define HB_UCDN_COMPOSE_FIRST_END	0x2000u
+#define HB_UCDN_COMPOSE_MARK_START	0x0300u
+#define HB_UCDN_COMPOSE_MARK_COUNT	0x0070u
+
+struct hb_ucdn_compose_table_t
+{
+  struct pair_t
+  {
+    uint16_t first;
+    uint16_t composed;
+
+    static int cmp (const void *pa, const void *pb)
+    {
+      const pair_t *a = (const pair_t *) pa;
+      const pair_t *b = (const pair_t *) pb;
+      return (int) a->first - (int) b->first;
+    }
+  };
+
+  bool compose (hb_codepoint_t a, hb_codepoint_t b, hb_codepoint_t *ab) const
+  {
+    unsigned int mark = b - HB_UCDN_COMPOSE_MARK_START;
+    unsigned int lo = start[mark], hi = start[mark + 1];
+    while (lo < hi)
+    {
+      unsigned int mid = (lo + hi) / 2;
+      if (a < pairs[mid].first)
+	hi = mid;
+      else if (a > pairs[mid].first)
+	lo = mid + 1;
+      else
+      {
+	*ab = pairs[mid].composed;
+	return true;
+      }
+    }
+    return false;
+  }
+
+  static bool covers (hb_codepoint_t a, hb_codepoint_t b)
+  {
+    return a < HB_UCDN_COMPOSE_FIRST_END &&
+	   b - HB_UCDN_COMPOSE_MARK_START < HB_UCDN_COMPOSE_MARK_COUNT;
+  }
+
+  /* Found by decomposing every character of the BMP, since each
+   * composition is the inverse of a decomposition (though not the other
+   * way around, for composition exclusions).  Composition is stable
+   * across Unicode versions, and these all keep to the BMP.  nullptr if
+   * out of memory. */
+  static hb_ucdn_compose_table_t *create ()
+  {
+    unsigned int count[HB_UCDN_COMPOSE_MARK_COUNT] = {0};
+    collect (count, nullptr);
+
+    unsigned int num_pairs = 0;
+    for (unsigned int i = 0; i < HB_UCDN_COMPOSE_MARK_COUNT; i++)
+      num_pairs += count[i];
+    hb_ucdn_compose_table_t *table = (hb_ucdn_compose_table_t *) malloc (sizeof (hb_ucdn_compose_table_t) +
+									 num_pairs * sizeof (pair_t));
+    if (unlikely (!table))
+      return nullptr;
+
+    table->start[0] = 0;
+    for (unsigned int i = 0; i < HB_UCDN_COMPOSE_MARK_COUNT; i++)
+    {
+      table->start[i + 1] = table->start[i] + count[i];
+      count[i] = table->start[i];
+    }
+    collect (count, table->pairs);
+    for (unsigned int i = 0; i < HB_UCDN_COMPOSE_MARK_COUNT; i++)
+      qsort (&table->pairs[table->start[i]], table->start[i + 1] - table->start[i],
+	     sizeof (pair_t), pair_t::cmp);
+    return table;
+  }
+
+  /* Counts the compositions per mark in count, or if pairs is not
+   * nullptr, stores them at pairs[count[mark]++]. */
+  static void collect (unsigned int *count, pair_t *pairs)
+  {
+    for (hb_codepoint_t u = 0; u < 0x10000u; u++)
+    {
+      uint32_t a, b, ab;
+      if (!ucdn_decompose (u, &a, &b) || !b || !covers (a, b) ||
+	  !ucdn_compose (&ab, a, b) || ab != u)
+	continue;
+      unsigned int mark = b - HB_UCDN_COMPOSE_MARK_START;
+      if (pairs)
+      {
+	pairs[count[mark]].first = a;
+	pairs[count[mark]].composed = u;
+      }
+      count[mark]++;
+    }
+  }
+
+  unsigned int start[HB_UCDN_COMPOSE_MARK_COUNT + 1];
+  pair_t pairs[VAR];
+};
+
 static hb_bool_t
 hb_ucdn_compose(hb_unicode_funcs_t *ufuncs HB_UNUSED,
 		hb_codepoint_t a, hb_codepoint_t b, hb_codepoint_t *ab,
-		void *user_data HB_UNUSED)
+		void *user_data)
 {
+    const hb_ucdn_compose_table_t *table = (const hb_ucdn_compose_table_t *) user_data;
+    if (likely (table) && hb_ucdn_compose_table_t::covers (a, b))
+	return table->compose (a, b, ab);
     return ucdn_compose(ab, a, b);
 }
 
@@ -221,6 +331,27 @@ hb_ucdn_decompose(hb_unicode_funcs_t *ufuncs HB_UNUSED,
     return ucdn_decompose(ab, a, b);
 }
 
+static void
+hb_ucdn_props(unsigned int count,
+	      const hb_codepoint_t *first_unicode,
+	      unsigned int unicode_stride,
+	      hb_unicode_props_t *first_props)
+{
+    for (unsigned int i = 0; i < count; i++)
+    {
+	hb_codepoint_t u = *first_unicode;
+	hb_unicode_props_t *props = &first_props[i];
+	int category, combining, script;
+	uint32_t mirror;
+	ucdn_get_properties(u, &category, &combining, &script, &mirror);
+	props->general_category = (hb_unicode_general_category_t) category;
+	props->combining_class = (hb_unicode_combining_class_t) combining;
+	props->script = ucdn_script_translate[script];
+	props->mirroring = mirror;
+	first_unicode = &StructAtOffset<hb_codepoint_t> (first_unicode, unicode_stride);
+    }
+}
+
 
 #if HB_USE_ATEXIT
 static void free_static_ucdn_funcs ();
@@ -236,9 +367,13 @@ static struct hb_ucdn_unicode_funcs_lazy_loader_t : hb_unicode_funcs_lazy_loader
     hb_unicode_funcs_set_general_category_func (funcs, hb_ucdn_general_category, nullptr, nullptr);
     hb_unicode_funcs_set_mirroring_func (funcs, hb_ucdn_mirroring, nullptr, nullptr);
     hb_unicode_funcs_set_script_func (funcs, hb_ucdn_script, nullptr, nullptr);
-    hb_unicode_funcs_set_compose_func (funcs, hb_ucdn_compose, nullptr, nullptr);
+    hb_ucdn_compose_table_t *compose_table = hb_ucdn_compose_table_t::create ();
+    hb_unicode_funcs_set_compose_func (funcs, hb_ucdn_compose, compose_table, free);
     hb_unicode_funcs_set_decompose_func (funcs, hb_ucdn_decompose, nullptr, nullptr);
 
+    if (!hb_object_is_inert (funcs))
+      funcs->props_func = hb_ucdn_props;
+
     hb_unicode_funcs_make_immutable (funcs);
 
 #if HB_USE_ATEXIT
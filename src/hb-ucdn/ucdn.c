@@ -278,6 +278,22 @@ uint32_t ucdn_mirror(uint32_t code)
         return res->to;
 }
 
+void ucdn_get_properties(uint32_t code, int *category, int *combining,
+                         int *script, uint32_t *mirror)
+{
+    const UCDRecord *record = get_ucd_record(code);
+
+    *category = record->category;
+    *combining = record->combining;
+    *script = record->script;
+
+    /* All mirrored characters are in the BMP and Other Neutral. */
+    if (code < 0x10000 && record->bidi_class == UCDN_BIDI_CLASS_ON)
+        *mirror = ucdn_mirror(code);
+    else
+        *mirror = code;
+}
+
 uint32_t ucdn_paired_bracket(uint32_t code)
 {
     BracketPair *res = search_bp(code);
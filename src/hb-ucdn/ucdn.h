@@ -387,6 +387,20 @@ int ucdn_get_resolved_linebreak_class(uint32_t code);
  */
 int ucdn_get_mirrored(uint32_t code);
 
+/**
+ * Get general category, canonical combining class, script and mirrored
+ * codepoint of a codepoint with a single lookup.
+ *
+ * @param code Unicode codepoint
+ * @param category set according to UCDN_GENERAL_CATEGORY_*
+ * @param combining set to the canonical combining class
+ * @param script set according to UCDN_SCRIPT_*
+ * @param mirror set to the mirrored codepoint or the original codepoint
+ * if no mirrored character exists
+ */
+void ucdn_get_properties(uint32_t code, int *category, int *combining,
+                         int *script, uint32_t *mirror);
+
 /**
  * Mirror a codepoint.
  *
@@ -177,6 +177,7 @@ hb_unicode_funcs_create (hb_unicode_funcs_t *parent)
    * onto it and it's immutable.  We should not copy the destroy notifiers
    * though. */
   ufuncs->user_data = parent->user_data;
+  ufuncs->props_func = parent->props_func;
 
   return ufuncs;
 }
@@ -364,6 +365,8 @@ hb_unicode_funcs_set_##name##_func (hb_unicode_funcs_t		   *ufuncs,	\
     ufuncs->user_data.name = ufuncs->parent->user_data.name;			\
     ufuncs->destroy.name = nullptr;						\
   }										\
+										\
+  ufuncs->props_func = nullptr;							\
 }
 
 HB_UNICODE_FUNCS_IMPLEMENT_CALLBACKS
@@ -570,6 +573,9 @@ _hb_modified_combining_class[256] =
 bool
 _hb_unicode_is_emoji_Extended_Pictographic (hb_codepoint_t cp)
 {
+  /* Letters and the like come before the first range. */
+  if (cp < _hb_unicode_emoji_Extended_Pictographic_table[0].start)
+    return false;
   return hb_bsearch (&cp, _hb_unicode_emoji_Extended_Pictographic_table,
 		     ARRAY_LENGTH (_hb_unicode_emoji_Extended_Pictographic_table),
 		     sizeof (hb_unicode_range_t),
@@ -60,6 +60,25 @@ extern HB_INTERNAL const uint8_t _hb_modified_combining_class[256];
   HB_UNICODE_FUNC_IMPLEMENT (hb_script_t, script) \
   /* ^--- Add new simple callbacks here */
 
+/* Properties of a character, as looked up together by
+ * hb_unicode_funcs_t::props(). */
+struct hb_unicode_props_t
+{
+  hb_unicode_general_category_t general_category;
+  hb_unicode_combining_class_t combining_class;
+  hb_script_t script;
+  hb_codepoint_t mirroring;
+  bool default_ignorable;
+};
+
+/* Fills in props for count codepoints, unicode_stride bytes apart, from
+ * one walk of the implementation's tables per codepoint.  Does not set
+ * default_ignorable. */
+typedef void (*hb_unicode_props_func_t) (unsigned int count,
+					 const hb_codepoint_t *first_unicode,
+					 unsigned int unicode_stride,
+					 hb_unicode_props_t *first_props);
+
 struct hb_unicode_funcs_t
 {
   hb_object_header_t header;
@@ -98,6 +117,36 @@ HB_UNICODE_FUNCS_IMPLEMENT_CALLBACKS_SIMPLE
     return ret;
   }
 
+  bool has_props_func () const { return props_func; }
+
+  void props (unsigned int count,
+	      const hb_codepoint_t *first_unicode,
+	      unsigned int unicode_stride,
+	      hb_unicode_props_t *first_props)
+  {
+    if (props_func)
+      props_func (count, first_unicode, unicode_stride, first_props);
+    else
+    {
+      const hb_codepoint_t *u = first_unicode;
+      for (unsigned int i = 0; i < count; i++)
+      {
+	hb_unicode_props_t *p = &first_props[i];
+	p->general_category = general_category (*u);
+	p->combining_class = combining_class (*u);
+	p->script = script (*u);
+	p->mirroring = mirroring (*u);
+	u = (const hb_codepoint_t *) ((const char *) u + unicode_stride);
+      }
+    }
+    const hb_codepoint_t *u = first_unicode;
+    for (unsigned int i = 0; i < count; i++)
+    {
+      first_props[i].default_ignorable = is_default_ignorable (*u);
+      u = (const hb_codepoint_t *) ((const char *) u + unicode_stride);
+    }
+  }
+
   unsigned int
   modified_combining_class (hb_codepoint_t u)
   {
@@ -116,6 +165,14 @@ HB_UNICODE_FUNCS_IMPLEMENT_CALLBACKS_SIMPLE
 
     return _hb_modified_combining_class[combining_class (u)];
   }
+  /* Same, for when combining_class (u) is already known. */
+  unsigned int
+  modified_combining_class (hb_codepoint_t u, hb_unicode_combining_class_t klass)
+  {
+    if (unlikely (u == 0x1037u || u == 0x1A60u || u == 0x0FC6u || u == 0x0F39u))
+      return modified_combining_class (u);
+    return _hb_modified_combining_class[klass];
+  }
 
   static hb_bool_t
   is_variation_selector (hb_codepoint_t unicode)
@@ -259,6 +316,10 @@ HB_UNICODE_FUNCS_IMPLEMENT_CALLBACKS_SIMPLE
     HB_UNICODE_FUNCS_IMPLEMENT_CALLBACKS
 #undef HB_UNICODE_FUNC_IMPLEMENT
   } destroy;
+
+  /* Set by implementations that can look all props up together; only
+   * valid as long as none of their callbacks are overridden. */
+  hb_unicode_props_func_t props_func;
 };
 DECLARE_NULL_INSTANCE (hb_unicode_funcs_t);
 
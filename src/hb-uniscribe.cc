@@ -506,6 +506,23 @@ struct hb_uniscribe_font_data_t
   HFONT hfont;
   mutable SCRIPT_CACHE script_cache;
   double x_mult, y_mult; /* From LOGFONT space to HB space. */
+
+  /* ScriptItemizeOpenType() results for recently shaped short strings,
+   * most recent first; see itemize(). */
+  enum { MAX_ITEMIZATIONS = 4 };
+  enum { MAX_ITEMIZED_CHARS = 64 };
+  struct itemization_t
+  {
+    unsigned int chars_len;
+    WCHAR chars[MAX_ITEMIZED_CHARS];
+    BYTE bidi_level;
+    int item_count;
+    SCRIPT_ITEM items[MAX_ITEMIZED_CHARS + 1];
+    OPENTYPE_TAG script_tags[MAX_ITEMIZED_CHARS];
+  };
+  mutable hb_mutex_t itemizations_lock;
+  mutable unsigned int num_itemizations;
+  mutable itemization_t itemizations[MAX_ITEMIZATIONS];
 };
 
 static bool
@@ -529,6 +546,8 @@ _hb_uniscribe_shaper_font_data_create (hb_font_t *font)
   if (unlikely (!data))
     return nullptr;
 
+  data->itemizations_lock.init ();
+
   int font_size = font->face->get_upem (); /* Default... */
   /* No idea if the following is even a good idea. */
   if (font->y_ppem)
@@ -572,6 +591,7 @@ _hb_uniscribe_shaper_font_data_destroy (hb_uniscribe_font_data_t *data)
     DeleteObject (data->hfont);
   if (data->script_cache)
     ScriptFreeCache (&data->script_cache);
+  data->itemizations_lock.fini ();
   free (data);
 }
 
@@ -589,6 +609,105 @@ hb_uniscribe_font_get_hfont (hb_font_t *font)
   return data ? data->hfont : nullptr;
 }
 
+/**
+ * hb_uniscribe_font_free_script_cache:
+ * @font: a font.
+ *
+ * Frees the Uniscribe SCRIPT_CACHE the uniscribe shaper keeps for @font,
+ * and the itemization results it keeps alongside.  They are rebuilt as
+ * needed the next time @font is shaped with.  Must not be called while
+ * @font is being shaped with.
+ *
+ * Since: REPLACEME
+ **/
+void
+hb_uniscribe_font_free_script_cache (hb_font_t *font)
+{
+  const hb_uniscribe_font_data_t *data =  font->data.uniscribe;
+  if (!data)
+    return;
+
+  if (data->script_cache)
+    ScriptFreeCache (&data->script_cache);
+  data->script_cache = nullptr;
+
+  data->itemizations_lock.lock ();
+  data->num_itemizations = 0;
+  data->itemizations_lock.unlock ();
+}
+
+/* ScriptItemizeOpenType(), remembering results for short strings:
+ * applications tend to shape the same labels over and over. */
+static HRESULT
+itemize (hb_uniscribe_shaper_funcs_t *funcs,
+	 const hb_uniscribe_font_data_t *font_data,
+	 const WCHAR *chars,
+	 unsigned int chars_len,
+	 int max_items,
+	 const SCRIPT_CONTROL *bidi_control,
+	 const SCRIPT_STATE *bidi_state,
+	 SCRIPT_ITEM *items,
+	 OPENTYPE_TAG *script_tags,
+	 int *item_count)
+{
+  typedef hb_uniscribe_font_data_t::itemization_t itemization_t;
+  bool cacheable = chars_len <= hb_uniscribe_font_data_t::MAX_ITEMIZED_CHARS;
+
+  if (cacheable)
+  {
+    font_data->itemizations_lock.lock ();
+    for (unsigned int i = 0; i < font_data->num_itemizations; i++)
+    {
+      itemization_t &entry = font_data->itemizations[i];
+      if (entry.chars_len != chars_len ||
+	  entry.bidi_level != bidi_state->uBidiLevel ||
+	  0 != memcmp (entry.chars, chars, chars_len * sizeof (chars[0])))
+	continue;
+
+      *item_count = entry.item_count;
+      memcpy (items, entry.items, (entry.item_count + 1) * sizeof (items[0]));
+      memcpy (script_tags, entry.script_tags, entry.item_count * sizeof (script_tags[0]));
+      if (i)
+      {
+	itemization_t hit = entry;
+	memmove (&font_data->itemizations[1], &font_data->itemizations[0],
+		 i * sizeof (font_data->itemizations[0]));
+	font_data->itemizations[0] = hit;
+      }
+      font_data->itemizations_lock.unlock ();
+      return S_OK;
+    }
+    font_data->itemizations_lock.unlock ();
+  }
+
+  HRESULT hr = funcs->ScriptItemizeOpenType (chars,
+					     chars_len,
+					     max_items,
+					     bidi_control,
+					     bidi_state,
+					     items,
+					     script_tags,
+					     item_count);
+  if (FAILED (hr) || !cacheable || (unsigned int) *item_count > chars_len)
+    return hr;
+
+  font_data->itemizations_lock.lock ();
+  if (font_data->num_itemizations < hb_uniscribe_font_data_t::MAX_ITEMIZATIONS)
+    font_data->num_itemizations++;
+  memmove (&font_data->itemizations[1], &font_data->itemizations[0],
+	   (font_data->num_itemizations - 1) * sizeof (font_data->itemizations[0]));
+  itemization_t &entry = font_data->itemizations[0];
+  entry.chars_len = chars_len;
+  memcpy (entry.chars, chars, chars_len * sizeof (chars[0]));
+  entry.bidi_level = bidi_state->uBidiLevel;
+  entry.item_count = *item_count;
+  memcpy (entry.items, items, (*item_count + 1) * sizeof (items[0]));
+  memcpy (entry.script_tags, script_tags, *item_count * sizeof (script_tags[0]));
+  font_data->itemizations_lock.unlock ();
+
+  return hr;
+}
+
 
 /*
  * shaper
@@ -808,14 +927,16 @@ retry:
   bidi_state.uBidiLevel = HB_DIRECTION_IS_FORWARD (buffer->props.direction) ? 0 : 1;
   bidi_state.fOverrideDirection = 1;
 
-  hr = funcs->ScriptItemizeOpenType (pchars,
-				     chars_len,
-				     MAX_ITEMS,
-				     &bidi_control,
-				     &bidi_state,
-				     items,
-				     script_tags,
-				     &item_count);
+  hr = itemize (funcs,
+		font_data,
+		pchars,
+		chars_len,
+		MAX_ITEMS,
+		&bidi_control,
+		&bidi_state,
+		items,
+		script_tags,
+		&item_count);
   if (unlikely (FAILED (hr)))
     FAIL ("ScriptItemizeOpenType() failed: 0x%08xL", hr);
 
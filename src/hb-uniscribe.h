@@ -40,6 +40,9 @@ hb_uniscribe_font_get_logfontw (hb_font_t *font);
 HB_EXTERN HFONT
 hb_uniscribe_font_get_hfont (hb_font_t *font);
 
+HB_EXTERN void
+hb_uniscribe_font_free_script_cache (hb_font_t *font);
+
 
 HB_END_DECLS
 
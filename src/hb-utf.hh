@@ -30,6 +30,7 @@
 #include "hb.hh"
 
 #include "hb-open-type.hh"
+#include "hb-cpu.hh"
 
 
 struct hb_utf8_t
@@ -122,6 +123,68 @@ struct hb_utf8_t
     return end - 1;
   }
 
+  /* Returns the number of code units from text on that each decode to
+   * their own value, ie. the length of the ASCII run there. */
+  static unsigned int
+  simple_length (const codepoint_t *text, const codepoint_t *end)
+  {
+#ifdef HB_CPU_X86
+    /* Worth a call through the dispatcher only if the text is long enough
+     * for the wider kernels to get going. */
+    if (end - text >= 64)
+    {
+      static const hb_cpu_dispatch_t<simple_length_func_t>::version_t versions[] = {
+	{HB_CPU_AVX2,	simple_length_avx2},
+	{0,		simple_length_baseline},
+      };
+      static hb_cpu_dispatch_t<simple_length_func_t> kernel = {versions, HB_ATOMIC_INT_INIT (-1)};
+      return kernel.get () (text, end);
+    }
+#endif
+    return simple_length_baseline (text, end);
+  }
+  typedef unsigned int (*simple_length_func_t) (const codepoint_t *, const codepoint_t *);
+#ifdef HB_CPU_X86
+  __attribute__((target ("avx2")))
+  static unsigned int
+  simple_length_avx2 (const codepoint_t *text, const codepoint_t *end)
+  {
+    const codepoint_t *p = text;
+    for (; end - p >= 32; p += 32)
+    {
+      __m256i v = _mm256_loadu_si256 ((const __m256i *) p);
+      unsigned int m = _mm256_movemask_epi8 (v);
+      if (m)
+	return p - text + hb_ctz (m);
+    }
+    return p - text + simple_length_baseline (p, end);
+  }
+#endif
+  static unsigned int
+  simple_length_baseline (const codepoint_t *text, const codepoint_t *end)
+  {
+    const codepoint_t *p = text;
+#if defined(HB_SIMD_SSE2)
+    for (; end - p >= 16; p += 16)
+    {
+      __m128i v = _mm_loadu_si128 ((const __m128i *) p);
+      unsigned int m = _mm_movemask_epi8 (v);
+      if (m)
+	return p - text + hb_ctz (m);
+    }
+#elif defined(HB_SIMD_NEON)
+    for (; end - p >= 16; p += 16)
+    {
+      uint64x2_t v = vreinterpretq_u64_u8 (vld1q_u8 (p));
+      if ((vgetq_lane_u64 (v, 0) | vgetq_lane_u64 (v, 1)) & 0x8080808080808080ull)
+	break;
+    }
+#endif
+    while (p < end && *p < 0x80u)
+      p++;
+    return p - text;
+  }
+
   static unsigned int
   strlen (const codepoint_t *text)
   { return ::strlen ((const char *) text); }
@@ -247,6 +310,48 @@ struct hb_utf16_xe_t
     return text;
   }
 
+  /* Returns the number of code units from text on that each decode to
+   * their own value, ie. the length of the surrogate-free run there. */
+  static unsigned int
+  simple_length (const codepoint_t *text, const codepoint_t *end)
+  {
+    const codepoint_t *p = text + simd_simple_length (text, end);
+    while (p < end && !hb_in_range<hb_codepoint_t> (*p, 0xD800u, 0xDFFFu))
+      p++;
+    return p - text;
+  }
+  /* Native-endian text can be scanned eight code units at a time;
+   * returns a prefix of the surrogate-free run. */
+  template <typename T>
+  static unsigned int
+  simd_simple_length (const T *text HB_UNUSED, const T *end HB_UNUSED)
+  { return 0; }
+  static unsigned int
+  simd_simple_length (const uint16_t *text, const uint16_t *end)
+  {
+    const uint16_t *p = text;
+#if defined(HB_SIMD_SSE2)
+    for (; end - p >= 8; p += 8)
+    {
+      __m128i v = _mm_loadu_si128 ((const __m128i *) p);
+      __m128i s = _mm_cmpeq_epi16 (_mm_and_si128 (v, _mm_set1_epi16 ((short) 0xF800u)),
+				   _mm_set1_epi16 ((short) 0xD800u));
+      unsigned int m = _mm_movemask_epi8 (s);
+      if (m)
+	return p - text + hb_ctz (m) / 2;
+    }
+#elif defined(HB_SIMD_NEON)
+    for (; end - p >= 8; p += 8)
+    {
+      uint16x8_t v = vld1q_u16 (p);
+      uint64x2_t s = vreinterpretq_u64_u16 (vceqq_u16 (vandq_u16 (v, vdupq_n_u16 (0xF800u)),
+						       vdupq_n_u16 (0xD800u)));
+      if (vgetq_lane_u64 (s, 0) | vgetq_lane_u64 (s, 1))
+	break;
+    }
+#endif
+    return p - text;
+  }
 
   static unsigned int
   strlen (const codepoint_t *text)
@@ -315,6 +420,17 @@ struct hb_utf32_xe_t
     return text;
   }
 
+  static unsigned int
+  simple_length (const TCodepoint *text, const TCodepoint *end)
+  {
+    if (!validate)
+      return end - text;
+    const TCodepoint *p = text;
+    while (p < end && !(*p >= 0xD800u && (*p <= 0xDFFFu || *p > 0x10FFFFu)))
+      p++;
+    return p - text;
+  }
+
   static unsigned int
   strlen (const TCodepoint *text)
   {
@@ -369,6 +485,10 @@ struct hb_latin1_t
     return text;
   }
 
+  static unsigned int
+  simple_length (const codepoint_t *text, const codepoint_t *end)
+  { return end - text; }
+
   static unsigned int
   strlen (const codepoint_t *text)
   {
@@ -424,6 +544,10 @@ struct hb_ascii_t
     return text;
   }
 
+  static unsigned int
+  simple_length (const codepoint_t *text, const codepoint_t *end)
+  { return hb_utf8_t::simple_length (text, end); }
+
   static unsigned int
   strlen (const codepoint_t *text)
   {
@@ -28,6 +28,7 @@
 #define HB_VECTOR_HH
 
 #include "hb.hh"
+#include "hb-arena.hh"
 #include "hb-array.hh"
 #include "hb-null.hh"
 
@@ -46,17 +47,27 @@ struct hb_vector_t
   private:
   int allocated; /* == -1 means allocation failed. */
   Type *arrayZ_;
+  hb_arena_t *arena; /* If set, arrays come from it and are never freed. */
   public:
 
   void init ()
   {
     allocated = length = 0;
     arrayZ_ = nullptr;
+    arena = nullptr;
+  }
+
+  /* Takes arrays from arena_ from now on, until fini (); for temporaries
+   * that die with it.  Outgrown arrays are only released with arena_. */
+  void set_arena (hb_arena_t *arena_)
+  {
+    if (!arrayZ_)
+      arena = arena_;
   }
 
   void fini ()
   {
-    if (arrayZ_)
+    if (arrayZ_ && !arena)
       free (arrayZ_);
     init ();
   }
@@ -140,8 +151,14 @@ struct hb_vector_t
 
   bool in_error () const { return allocated < 0; }
 
-  /* Allocate for size but don't adjust length. */
-  bool alloc (unsigned int size)
+  /* Heap bytes held, not counting what the items point to. */
+  unsigned int get_allocated_size () const
+  { return allocated > 0 ? allocated * sizeof (Type) : 0; }
+
+  /* Allocate for size but don't adjust length.  Grows by half again as
+   * much as needed for repeated pushes; if exact, callers that know the
+   * final size get just that. */
+  bool alloc (unsigned int size, bool exact = false)
   {
     if (unlikely (allocated < 0))
       return false;
@@ -152,8 +169,11 @@ struct hb_vector_t
     /* Reallocate */
 
     unsigned int new_allocated = allocated;
-    while (size >= new_allocated)
-      new_allocated += (new_allocated >> 1) + 8;
+    if (exact)
+      new_allocated = size;
+    else
+      while (size >= new_allocated)
+	new_allocated += (new_allocated >> 1) + 8;
 
     Type *new_array = nullptr;
     bool overflows =
@@ -161,7 +181,18 @@ struct hb_vector_t
       (new_allocated < (unsigned) allocated) ||
       hb_unsigned_mul_overflows (new_allocated, sizeof (Type));
     if (likely (!overflows))
-      new_array = (Type *) realloc (arrayZ_, new_allocated * sizeof (Type));
+    {
+      if (arena)
+      {
+	new_array = arena->alloc_array<Type> (new_allocated);
+	if (likely (new_array) && allocated)
+	  memcpy (static_cast<void *> (new_array),
+		  static_cast<void *> (arrayZ_),
+		  allocated * sizeof (Type));
+      }
+      else
+	new_array = (Type *) realloc (arrayZ_, new_allocated * sizeof (Type));
+    }
 
     if (unlikely (!new_array))
     {
@@ -212,6 +243,26 @@ struct hb_vector_t
        length = size;
   }
 
+  /* Gives back the space past length; for vectors that outlive the code
+   * filling them. */
+  void shrink_to_fit ()
+  {
+    if (unlikely (allocated < 0) || (unsigned) allocated == length || arena)
+      return;
+    if (!length)
+    {
+      free (arrayZ_);
+      arrayZ_ = nullptr;
+      allocated = 0;
+      return;
+    }
+    Type *new_array = (Type *) realloc (arrayZ_, length * sizeof (Type));
+    if (unlikely (!new_array))
+      return; /* Keeping the larger array is fine. */
+    arrayZ_ = new_array;
+    allocated = length;
+  }
+
   template <typename T>
   Type *find (T v)
   {
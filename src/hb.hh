@@ -33,6 +33,8 @@
 #include "config.h"
 #endif
 
+#include "hb-config.hh"
+
 /*
  * Following added based on what AC_USE_SYSTEM_EXTENSIONS adds to
  * config.h.in.  Copied here for the convenience of those embedding
@@ -219,6 +221,18 @@ struct _hb_alignof
 # endif
 #endif
 
+
+/* Run-time custom allocator support; see hb_set_allocator_funcs().
+ * Not available together with the compile-time one above. */
+
+#if !defined(malloc) && !defined(HB_NO_ALLOCATOR_FUNCS)
+#define HB_ALLOCATOR_FUNCS 1
+#define malloc hb_malloc
+#define calloc hb_calloc
+#define realloc hb_realloc
+#define free hb_free
+#endif
+
 #if __GNUC__ >= 3
 #define HB_FUNC __PRETTY_FUNCTION__
 #elif defined(_MSC_VER)
@@ -439,6 +453,29 @@ typedef uint64_t hb_vector_size_impl_t __attribute__((vector_size (HB_VECTOR_SIZ
 typedef uint64_t hb_vector_size_impl_t;
 #endif
 
+/*
+ * Explicit SIMD kernels for hb_vector_size_t.  Unlike HB_VECTOR_SIZE
+ * above these only ever use unaligned loads and stores, so they are safe
+ * with the alignment hb_vector_t gives us.  SSE2 and NEON are baseline on
+ * x86-64 and aarch64 respectively, so no runtime detection is needed;
+ * kernels using anything wider go through hb-cpu.hh.  Define HB_NO_SIMD
+ * to disable.
+ */
+#if !defined(HB_NO_SIMD) && (defined(__GNUC__) || defined(__clang__))
+#  if defined(__SSE2__)
+#    define HB_SIMD_SSE2 1
+#    include <emmintrin.h>
+typedef __m128i hb_simd_t;
+#  elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#    define HB_SIMD_NEON 1
+#    include <arm_neon.h>
+typedef uint64x2_t hb_simd_t;
+#  endif
+#endif
+#if defined(HB_SIMD_SSE2) || defined(HB_SIMD_NEON)
+#  define HB_SIMD 1
+#endif
+
 
 /* HB_NDEBUG disables some sanity checks that are very safe to disable and
  * should be disabled in production systems.  If NDEBUG is defined, enable
@@ -560,7 +597,14 @@ template <typename T> struct hb_remove_pointer<T *> { typedef T value; };
 #include "hb-iter.hh"	// Requires: hb-null
 #include "hb-debug.hh"	// Requires: hb-atomic hb-dsalgs
 #include "hb-array.hh"	// Requires: hb-dsalgs hb-iter hb-null
-#include "hb-vector.hh"	// Requires: hb-array hb-null
+#include "hb-arena.hh"	// Requires: hb-dsalgs
+#include "hb-vector.hh"	// Requires: hb-arena hb-array hb-null
 #include "hb-object.hh"	// Requires: hb-atomic hb-mutex hb-vector
 
+
+/* Where hb-ot-tag.cc caches the OpenType tags of an interned language;
+ * see hb-common.cc. */
+HB_INTERNAL hb_atomic_ptr_t<void> *
+_hb_language_get_ot_tags (hb_language_t language);
+
 #endif /* HB_HH */
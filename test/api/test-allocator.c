@@ -0,0 +1,177 @@
+/*
+ * Copyright © 2018  Google, Inc.
+ *
+ *  This is part of HarfBuzz, a text shaping library.
+ *
+ * Permission is hereby granted, without written agreement and without
+ * license or royalty fees, to use, copy, modify, and distribute this
+ * software and its documentation for any purpose, provided that the
+ * above copyright notice and the following two paragraphs appear in
+ * all copies of this software.
+ *
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE TO ANY PARTY FOR
+ * DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES
+ * ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION, EVEN
+ * IF THE COPYRIGHT HOLDER HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * THE COPYRIGHT HOLDER SPECIFICALLY DISCLAIMS ANY WARRANTIES, INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER IS
+ * ON AN "AS IS" BASIS, AND THE COPYRIGHT HOLDER HAS NO OBLIGATION TO
+ * PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+ */
+
+#include "hb-test.h"
+
+/* Unit tests for hb_set_allocator_funcs() and hb_malloc() and friends.
+ * The functions are installed in main(), before anything else has had a
+ * chance to allocate. */
+
+
+typedef struct
+{
+  unsigned int mallocs;
+  unsigned int reallocs;
+  unsigned int frees;
+  int live;
+} counters_t;
+
+static counters_t counters;
+static hb_bool_t installed;
+
+static void *
+counting_malloc (size_t size, void *user_data)
+{
+  counters_t *c = (counters_t *) user_data;
+  void *p = malloc (size);
+  c->mallocs++;
+  if (p)
+    c->live++;
+  return p;
+}
+
+static void *
+counting_realloc (void *ptr, size_t size, void *user_data)
+{
+  counters_t *c = (counters_t *) user_data;
+  c->reallocs++;
+  if (!ptr)
+    return counting_malloc (size, user_data);
+  if (!size)
+  {
+    free (ptr);
+    c->live--;
+    return NULL;
+  }
+  return realloc (ptr, size);
+}
+
+static void
+counting_free (void *ptr, void *user_data)
+{
+  counters_t *c = (counters_t *) user_data;
+  c->frees++;
+  if (ptr)
+    c->live--;
+  free (ptr);
+}
+
+static void
+test_allocator_set (void)
+{
+  g_assert (installed);
+
+  /* Only the first call takes. */
+  g_assert (!hb_set_allocator_funcs (counting_malloc, NULL, counting_realloc, counting_free, NULL));
+}
+
+static void
+test_allocator_funcs (void)
+{
+  counters_t before = counters;
+  unsigned char *p;
+  unsigned int i;
+
+  p = (unsigned char *) hb_malloc (16);
+  g_assert (p);
+  g_assert_cmpint (counters.mallocs, ==, before.mallocs + 1);
+  g_assert_cmpint (counters.live, ==, before.live + 1);
+  memset (p, 0xAA, 16);
+
+  p = (unsigned char *) hb_realloc (p, 4096);
+  g_assert (p);
+  g_assert_cmpint (counters.reallocs, ==, before.reallocs + 1);
+  g_assert_cmpint (p[15], ==, 0xAA);
+
+  hb_free (p);
+  g_assert_cmpint (counters.frees, ==, before.frees + 1);
+  g_assert_cmpint (counters.live, ==, before.live);
+
+  /* No calloc_func was given: it is malloc_func, cleared. */
+  p = (unsigned char *) hb_calloc (3, 100);
+  g_assert (p);
+  g_assert_cmpint (counters.mallocs, ==, before.mallocs + 2);
+  for (i = 0; i < 300; i++)
+    g_assert_cmpint (p[i], ==, 0);
+  hb_free (p);
+
+  /* Overflowing sizes fail before reaching malloc_func. */
+  g_assert (!hb_calloc ((size_t) -1 / 2, 4));
+  g_assert_cmpint (counters.mallocs, ==, before.mallocs + 2);
+
+  hb_free (NULL);
+  g_assert_cmpint (counters.live, ==, before.live);
+}
+
+static void
+shape_text (const char *text)
+{
+  hb_buffer_t *buffer = hb_buffer_create ();
+  hb_font_t *font = hb_font_create (hb_face_get_empty ());
+  unsigned int len = strlen (text);
+  char *data = (char *) hb_malloc (len);
+  hb_blob_t *blob;
+
+  /* Memory handed to HarfBuzz to free comes from hb_malloc(). */
+  memcpy (data, text, len);
+  blob = hb_blob_create (data, len, HB_MEMORY_MODE_WRITABLE, data, hb_free);
+
+  hb_buffer_add_utf8 (buffer, hb_blob_get_data (blob, NULL), len, 0, len);
+  hb_buffer_guess_segment_properties (buffer);
+  hb_shape (font, buffer, NULL, 0);
+  g_assert_cmpint (hb_buffer_get_length (buffer), ==, len);
+
+  hb_blob_destroy (blob);
+  hb_font_destroy (font);
+  hb_buffer_destroy (buffer);
+}
+
+static void
+test_allocator_objects (void)
+{
+  counters_t before;
+
+  /* Once for whatever is set up lazily and kept. */
+  shape_text ("Hello");
+
+  before = counters;
+  shape_text ("Hello, world");
+  g_assert_cmpint (counters.mallocs, >, before.mallocs);
+  g_assert_cmpint (counters.frees, >, before.frees);
+  g_assert_cmpint (counters.live, ==, before.live);
+}
+
+int
+main (int argc, char **argv)
+{
+  installed = hb_set_allocator_funcs (counting_malloc, NULL, counting_realloc, counting_free, &counters);
+
+  hb_test_init (&argc, &argv);
+
+  hb_test_add (test_allocator_set);
+  hb_test_add (test_allocator_funcs);
+  hb_test_add (test_allocator_objects);
+
+  return hb_test_run();
+}
@@ -41,6 +41,11 @@
 
 #endif
 
+#ifdef HAVE_UNISTD_H
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 
 static void
 test_blob_empty (void)
@@ -323,6 +328,75 @@ test_blob_subblob (fixture_t *fixture, gconstpointer user_data)
 }
 
 
+#ifdef HAVE_UNISTD_H
+static void
+test_blob_from_fd (void)
+{
+#if GLIB_CHECK_VERSION(2,37,2)
+  char *path = g_test_build_filename (G_TEST_DIST, "fonts/Roboto-Regular.abc.ttf", NULL);
+#else
+  char *path = g_strdup ("fonts/Roboto-Regular.abc.ttf");
+#endif
+  hb_blob_t *file = hb_blob_create_from_file (path);
+  hb_blob_t *blob;
+  unsigned int file_length, length;
+  const char *file_data = hb_blob_get_data (file, &file_length);
+  const char *data;
+  int fd, fds[2];
+
+  g_assert_cmpint (file_length, >, 16);
+  fd = open (path, O_RDONLY);
+  g_assert_cmpint (fd, >=, 0);
+
+  blob = hb_blob_create_from_fd (fd, 0, (unsigned int) -1);
+  data = hb_blob_get_data (blob, &length);
+  g_assert_cmpint (length, ==, file_length);
+  g_assert (0 == memcmp (data, file_data, length));
+  hb_blob_destroy (blob);
+
+  blob = hb_blob_create_from_fd (fd, 4, 8);
+  data = hb_blob_get_data (blob, &length);
+  g_assert_cmpint (length, ==, 8);
+  g_assert (0 == memcmp (data, file_data + 4, 8));
+  hb_blob_destroy (blob);
+
+  /* Cut short at the end of the file. */
+  blob = hb_blob_create_from_fd (fd, file_length - 2, 8);
+  data = hb_blob_get_data (blob, &length);
+  g_assert_cmpint (length, ==, 2);
+  g_assert (0 == memcmp (data, file_data + file_length - 2, 2));
+  hb_blob_destroy (blob);
+
+  blob = hb_blob_create_from_fd (fd, file_length, 8);
+  g_assert_cmpint (hb_blob_get_length (blob), ==, 0);
+  hb_blob_destroy (blob);
+
+  /* The blob outlives the descriptor. */
+  blob = hb_blob_create_from_fd (fd, 0, 16);
+  close (fd);
+  data = hb_blob_get_data (blob, &length);
+  g_assert_cmpint (length, ==, 16);
+  g_assert (0 == memcmp (data, file_data, 16));
+  hb_blob_destroy (blob);
+
+  /* Pipes are read from where they are. */
+  g_assert (0 == pipe (fds));
+  g_assert_cmpint (write (fds[1], "test data", 9), ==, 9);
+  close (fds[1]);
+  blob = hb_blob_create_from_fd (fds[0], 0, (unsigned int) -1);
+  data = hb_blob_get_data (blob, &length);
+  g_assert_cmpint (length, ==, 9);
+  g_assert (0 == memcmp (data, "test data", 9));
+  hb_blob_destroy (blob);
+  close (fds[0]);
+
+  g_assert_cmpint (hb_blob_get_length (hb_blob_create_from_fd (-1, 0, (unsigned int) -1)), ==, 0);
+
+  hb_blob_destroy (file);
+  g_free (path);
+}
+#endif
+
 int
 main (int argc, char **argv)
 {
@@ -331,6 +405,9 @@ main (int argc, char **argv)
   hb_test_init (&argc, &argv);
 
   hb_test_add (test_blob_empty);
+#ifdef HAVE_UNISTD_H
+  hb_test_add (test_blob_from_fd);
+#endif
 
   for (i = 0; i < G_N_ELEMENTS (blob_names); i++)
   {
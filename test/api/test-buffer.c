@@ -359,6 +359,24 @@ test_buffer_allocation (fixture_t *fixture, gconstpointer user_data HB_UNUSED)
 
   hb_buffer_reset (b);
   g_assert (hb_buffer_allocation_successful (b));
+
+  /* Shrinking keeps what is in the buffer. */
+  hb_buffer_add_utf32 (b, utf32, G_N_ELEMENTS (utf32), 0, -1);
+  g_assert (hb_buffer_pre_allocate (b, 1000));
+  g_assert (hb_buffer_set_length (b, 3));
+  hb_buffer_shrink_to_fit (b);
+  g_assert (hb_buffer_allocation_successful (b));
+  g_assert_cmpint (hb_buffer_get_length (b), ==, 3);
+  g_assert_cmphex (hb_buffer_get_glyph_infos (b, NULL)[2].codepoint, ==, utf32[2]);
+
+  hb_buffer_clear_contents (b);
+  hb_buffer_shrink_to_fit (b);
+  g_assert_cmpint (hb_buffer_get_length (b), ==, 0);
+  hb_buffer_add_utf32 (b, utf32, G_N_ELEMENTS (utf32), 0, -1);
+  g_assert (hb_buffer_allocation_successful (b));
+  g_assert_cmpint (hb_buffer_get_length (b), ==, G_N_ELEMENTS (utf32));
+
+  hb_buffer_reset (b);
 }
 
 
@@ -856,6 +874,422 @@ test_buffer_empty (void)
   g_assert (!hb_buffer_allocation_successful (b));
 }
 
+static void
+test_buffer_pool (void)
+{
+  hb_buffer_pool_t *pool = hb_buffer_pool_create (2);
+  hb_buffer_t *a, *b, *c;
+  hb_segment_properties_t props = HB_SEGMENT_PROPERTIES_DEFAULT;
+  hb_segment_properties_t got;
+
+  g_assert (hb_buffer_pool_reference (pool) == pool);
+  hb_buffer_pool_destroy (pool);
+
+  a = hb_buffer_pool_acquire (pool);
+  b = hb_buffer_pool_acquire (pool);
+  c = hb_buffer_pool_acquire (pool);
+  g_assert (a != b && b != c && a != c);
+
+  hb_buffer_add_utf32 (a, utf32, G_N_ELEMENTS (utf32), 0, -1);
+  hb_buffer_guess_segment_properties (a);
+  hb_buffer_set_flags (a, HB_BUFFER_FLAG_BOT);
+
+  /* The pool keeps two; the third is destroyed. */
+  hb_buffer_pool_release (pool, a);
+  hb_buffer_pool_release (pool, b);
+  hb_buffer_pool_release (pool, c);
+
+  /* Most recently released first, reset. */
+  g_assert (hb_buffer_pool_acquire (pool) == b);
+  g_assert (hb_buffer_pool_acquire (pool) == a);
+  g_assert_cmpint (hb_buffer_get_length (a), ==, 0);
+  g_assert (hb_buffer_allocation_successful (a));
+  g_assert_cmpint (hb_buffer_get_content_type (a), ==, HB_BUFFER_CONTENT_TYPE_INVALID);
+  g_assert_cmpint (hb_buffer_get_flags (a), ==, HB_BUFFER_FLAG_DEFAULT);
+  hb_buffer_get_segment_properties (a, &got);
+  g_assert (hb_segment_properties_equal (&got, &props));
+
+  c = hb_buffer_pool_acquire (pool);
+  g_assert (c != a && c != b);
+
+  hb_buffer_pool_release (pool, c);
+  hb_buffer_pool_release (pool, b);
+  hb_buffer_pool_destroy (pool);
+  hb_buffer_destroy (a);
+
+  /* The empty pool keeps nothing. */
+  pool = hb_buffer_pool_get_empty ();
+  a = hb_buffer_pool_acquire (pool);
+  g_assert (a != hb_buffer_get_empty ());
+  hb_buffer_add_utf32 (a, utf32, G_N_ELEMENTS (utf32), 0, -1);
+  g_assert_cmpint (hb_buffer_get_length (a), ==, G_N_ELEMENTS (utf32));
+  hb_buffer_pool_release (pool, a);
+  hb_buffer_pool_destroy (pool);
+}
+
+static hb_buffer_t *
+create_glyph_buffer (void)
+{
+  hb_buffer_t *b = hb_buffer_create ();
+  hb_glyph_position_t *pos;
+
+  hb_buffer_add (b, 5, 0);
+  hb_buffer_add (b, 3, 1);
+  hb_buffer_add (b, 300, 3);
+  hb_buffer_set_content_type (b, HB_BUFFER_CONTENT_TYPE_GLYPHS);
+  pos = hb_buffer_get_glyph_positions (b, NULL);
+  pos[0].x_advance = 10;
+  pos[1].x_advance = 5;
+  pos[1].x_offset = -1;
+  pos[2].x_advance = 200;
+
+  return b;
+}
+
+static void
+test_buffer_get_columns (void)
+{
+  hb_buffer_t *b = create_glyph_buffer ();
+  hb_buffer_t *text = hb_buffer_create ();
+  hb_glyph_position_t *pos = hb_buffer_get_glyph_positions (b, NULL);
+  uint32_t glyphs[3];
+  struct { uint16_t cluster; int16_t x_offset; } clusters[3];
+  int32_t x_advances[3];
+  int16_t y_offsets[3];
+  hb_buffer_column_t columns[] = {
+    {HB_BUFFER_COLUMN_FIELD_CODEPOINT, HB_BUFFER_COLUMN_TYPE_32, glyphs, 0},
+    {HB_BUFFER_COLUMN_FIELD_CLUSTER, HB_BUFFER_COLUMN_TYPE_16, &clusters[0].cluster, sizeof (clusters[0])},
+    {HB_BUFFER_COLUMN_FIELD_X_OFFSET, HB_BUFFER_COLUMN_TYPE_16, &clusters[0].x_offset, sizeof (clusters[0])},
+    {HB_BUFFER_COLUMN_FIELD_X_ADVANCE, HB_BUFFER_COLUMN_TYPE_32, x_advances, 0},
+    {HB_BUFFER_COLUMN_FIELD_Y_OFFSET, HB_BUFFER_COLUMN_TYPE_16, y_offsets, sizeof (y_offsets[0])},
+  };
+
+  /* Narrowed values are clamped. */
+  pos[1].y_offset = 40000;
+  pos[2].y_offset = -40000;
+  hb_buffer_get_glyph_infos (b, NULL)[2].cluster = 70000;
+
+  g_assert_cmpint (hb_buffer_get_columns (b, 1, (unsigned int) -1, columns, G_N_ELEMENTS (columns)), ==, 2);
+  g_assert_cmpint (glyphs[0], ==, 3);
+  g_assert_cmpint (glyphs[1], ==, 300);
+  g_assert_cmpint (clusters[0].cluster, ==, 1);
+  g_assert_cmpint (clusters[1].cluster, ==, 0xFFFF);
+  g_assert_cmpint (clusters[0].x_offset, ==, -1);
+  g_assert_cmpint (clusters[1].x_offset, ==, 0);
+  g_assert_cmpint (x_advances[0], ==, 5);
+  g_assert_cmpint (x_advances[1], ==, 200);
+  g_assert_cmpint (y_offsets[0], ==, 0x7FFF);
+  g_assert_cmpint (y_offsets[1], ==, -0x8000);
+
+  g_assert_cmpint (hb_buffer_get_columns (b, 0, 1, columns, G_N_ELEMENTS (columns)), ==, 1);
+  g_assert_cmpint (glyphs[0], ==, 5);
+  g_assert_cmpint (x_advances[0], ==, 10);
+  g_assert_cmpint (hb_buffer_get_columns (b, 3, (unsigned int) -1, columns, G_N_ELEMENTS (columns)), ==, 0);
+
+  /* Before shaping, there are no positions. */
+  hb_buffer_add_utf8 (text, "ab", -1, 0, -1);
+  g_assert_cmpint (hb_buffer_get_columns (text, 0, (unsigned int) -1, columns, G_N_ELEMENTS (columns)), ==, 2);
+  g_assert_cmpint (glyphs[1], ==, 'b');
+  g_assert_cmpint (clusters[1].cluster, ==, 1);
+  g_assert_cmpint (x_advances[0], ==, 0);
+  g_assert_cmpint (x_advances[1], ==, 0);
+
+  hb_buffer_destroy (text);
+  hb_buffer_destroy (b);
+}
+
+typedef struct
+{
+  hb_font_t *fonts[2];
+  unsigned int calls;
+} segment_fonts_t;
+
+static hb_font_t *
+segment_font_func (hb_buffer_t  *buffer,
+		   unsigned int  index,
+		   hb_script_t   script HB_UNUSED,
+		   void         *user_data)
+{
+  segment_fonts_t *fonts = (segment_fonts_t *) user_data;
+  hb_codepoint_t u = hb_buffer_get_glyph_infos (buffer, NULL)[index].codepoint;
+
+  fonts->calls++;
+  /* Digits come from the second font; so would the mark, if asked. */
+  return fonts->fonts[(u >= '0' && u <= '9') || u == 0x0301];
+}
+
+static void
+check_segment (const hb_buffer_segment_t *segment,
+	       unsigned int start, unsigned int end,
+	       hb_script_t script, hb_direction_t direction,
+	       hb_font_t *font)
+{
+  g_assert_cmpint (segment->start, ==, start);
+  g_assert_cmpint (segment->end, ==, end);
+  g_assert_cmpint (segment->script, ==, script);
+  g_assert_cmpint (segment->direction, ==, direction);
+  g_assert (segment->font == font);
+}
+
+static void
+test_buffer_get_segments (void)
+{
+  /* "ab (\u03B1\u03B2) \u05D0\u05D1." */
+  static const uint32_t text[] = {'a', 'b', ' ', '(', 0x03B1, 0x03B2, ')', ' ', 0x05D0, 0x05D1, '.'};
+  static const uint8_t levels[] = {0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1};
+  hb_buffer_t *b = hb_buffer_create ();
+  hb_buffer_segment_t segments[8];
+  segment_fonts_t fonts;
+  unsigned int count;
+
+  hb_buffer_add_utf32 (b, text, G_N_ELEMENTS (text), 0, -1);
+
+  /* Common characters join the run they are in. */
+  count = G_N_ELEMENTS (segments);
+  g_assert_cmpint (hb_buffer_get_segments (b, NULL, NULL, NULL, 0, &count, segments), ==, 3);
+  g_assert_cmpint (count, ==, 3);
+  check_segment (&segments[0], 0, 4, HB_SCRIPT_LATIN, HB_DIRECTION_LTR, NULL);
+  check_segment (&segments[1], 4, 8, HB_SCRIPT_GREEK, HB_DIRECTION_LTR, NULL);
+  check_segment (&segments[2], 8, 11, HB_SCRIPT_HEBREW, HB_DIRECTION_RTL, NULL);
+
+  count = 1;
+  g_assert_cmpint (hb_buffer_get_segments (b, NULL, NULL, NULL, 1, &count, segments), ==, 3);
+  g_assert_cmpint (count, ==, 1);
+  check_segment (&segments[0], 4, 8, HB_SCRIPT_GREEK, HB_DIRECTION_LTR, NULL);
+  count = G_N_ELEMENTS (segments);
+  g_assert_cmpint (hb_buffer_get_segments (b, NULL, NULL, NULL, 3, &count, segments), ==, 3);
+  g_assert_cmpint (count, ==, 0);
+  g_assert_cmpint (hb_buffer_get_segments (b, NULL, NULL, NULL, 0, NULL, NULL), ==, 3);
+
+  /* Levels add breaks and set the direction. */
+  count = G_N_ELEMENTS (segments);
+  g_assert_cmpint (hb_buffer_get_segments (b, levels, NULL, NULL, 0, &count, segments), ==, 4);
+  check_segment (&segments[1], 4, 7, HB_SCRIPT_GREEK, HB_DIRECTION_LTR, NULL);
+  check_segment (&segments[2], 7, 8, HB_SCRIPT_GREEK, HB_DIRECTION_RTL, NULL);
+  check_segment (&segments[3], 8, 11, HB_SCRIPT_HEBREW, HB_DIRECTION_RTL, NULL);
+
+  /* Without levels, a set buffer direction wins. */
+  hb_buffer_set_direction (b, HB_DIRECTION_RTL);
+  count = G_N_ELEMENTS (segments);
+  g_assert_cmpint (hb_buffer_get_segments (b, NULL, NULL, NULL, 0, &count, segments), ==, 3);
+  check_segment (&segments[0], 0, 4, HB_SCRIPT_LATIN, HB_DIRECTION_RTL, NULL);
+
+  /* Fonts add breaks; marks keep the font before them. */
+  fonts.fonts[0] = hb_font_get_empty ();
+  fonts.fonts[1] = hb_font_create (hb_face_get_empty ());
+  fonts.calls = 0;
+  hb_buffer_reset (b);
+  hb_buffer_add_utf8 (b, "a1e\xCC\x81", -1, 0, -1);
+  count = G_N_ELEMENTS (segments);
+  g_assert_cmpint (hb_buffer_get_segments (b, NULL, segment_font_func, &fonts, 0, &count, segments), ==, 3);
+  g_assert_cmpint (fonts.calls, ==, 3);
+  check_segment (&segments[0], 0, 1, HB_SCRIPT_LATIN, HB_DIRECTION_LTR, fonts.fonts[0]);
+  check_segment (&segments[1], 1, 2, HB_SCRIPT_LATIN, HB_DIRECTION_LTR, fonts.fonts[1]);
+  check_segment (&segments[2], 2, 4, HB_SCRIPT_LATIN, HB_DIRECTION_LTR, fonts.fonts[0]);
+
+  /* Only non-empty Unicode buffers have segments. */
+  hb_buffer_clear_contents (b);
+  count = G_N_ELEMENTS (segments);
+  g_assert_cmpint (hb_buffer_get_segments (b, NULL, NULL, NULL, 0, &count, segments), ==, 0);
+  g_assert_cmpint (count, ==, 0);
+  hb_buffer_add_utf8 (b, "a", -1, 0, -1);
+  hb_buffer_set_content_type (b, HB_BUFFER_CONTENT_TYPE_GLYPHS);
+  count = G_N_ELEMENTS (segments);
+  g_assert_cmpint (hb_buffer_get_segments (b, NULL, NULL, NULL, 0, &count, segments), ==, 0);
+
+  hb_font_destroy (fonts.fonts[1]);
+  hb_buffer_destroy (b);
+}
+
+static void
+test_buffer_serialize_binary (void)
+{
+  static const char expected[] = {
+    'H', 'B', 1, 0x07, 3, 0, 0, 0,		/* Clusters, offsets, advances. */
+    0x0A, 0x00, 0x00, 0x14,			/* 5, cluster 0, advance 10. */
+    0x03, 0x02, 0x01, 0x01, 0x00, 0x0A,		/* -2, +1, offset (-1,0), 5. */
+    (char) 0xD2, 0x04, 0x04, 0x00, (char) 0x90, 0x03,	/* +297, +2, 200. */
+  };
+  hb_buffer_t *b = create_glyph_buffer ();
+  hb_buffer_t *c = hb_buffer_create ();
+  hb_glyph_info_t *info;
+  hb_glyph_position_t *pos;
+  char buf[2 * sizeof (expected)];
+  unsigned int consumed, len, i;
+  const char *end;
+
+  g_assert (hb_buffer_serialize_format_from_string ("binary", -1) == HB_BUFFER_SERIALIZE_FORMAT_BINARY);
+  g_assert_cmpstr (hb_buffer_serialize_format_to_string (HB_BUFFER_SERIALIZE_FORMAT_BINARY), ==, "binary");
+
+  g_assert_cmpint (hb_buffer_serialize_glyphs (b, 0, 3, buf, sizeof (buf), &consumed, NULL,
+					       HB_BUFFER_SERIALIZE_FORMAT_BINARY,
+					       HB_BUFFER_SERIALIZE_FLAG_DEFAULT), ==, 3);
+  g_assert_cmpint (consumed, ==, sizeof (expected));
+  g_assert (0 == memcmp (buf, expected, sizeof (expected)));
+
+  /* Records concatenate. */
+  memcpy (buf + sizeof (expected), expected, sizeof (expected));
+  g_assert (hb_buffer_deserialize_glyphs (c, buf, sizeof (buf), &end, NULL,
+					  HB_BUFFER_SERIALIZE_FORMAT_BINARY));
+  g_assert (end == buf + sizeof (buf));
+  info = hb_buffer_get_glyph_infos (c, &len);
+  pos = hb_buffer_get_glyph_positions (c, NULL);
+  g_assert_cmpint (len, ==, 6);
+  for (i = 0; i < len; i++)
+  {
+    hb_glyph_info_t *expected_info = hb_buffer_get_glyph_infos (b, NULL) + i % 3;
+    hb_glyph_position_t *expected_pos = hb_buffer_get_glyph_positions (b, NULL) + i % 3;
+    g_assert_cmpint (info[i].codepoint, ==, expected_info->codepoint);
+    g_assert_cmpint (info[i].cluster, ==, expected_info->cluster);
+    g_assert_cmpint (pos[i].x_advance, ==, expected_pos->x_advance);
+    g_assert_cmpint (pos[i].y_advance, ==, expected_pos->y_advance);
+    g_assert_cmpint (pos[i].x_offset, ==, expected_pos->x_offset);
+    g_assert_cmpint (pos[i].y_offset, ==, expected_pos->y_offset);
+  }
+
+  /* Truncated records are rejected. */
+  for (i = 1; i < sizeof (expected); i++)
+  {
+    hb_buffer_clear_contents (c);
+    g_assert (!hb_buffer_deserialize_glyphs (c, expected, i, &end, NULL,
+					     HB_BUFFER_SERIALIZE_FORMAT_BINARY));
+  }
+
+  /* So are unknown versions. */
+  memcpy (buf, expected, sizeof (expected));
+  buf[2] = 2;
+  hb_buffer_clear_contents (c);
+  g_assert (!hb_buffer_deserialize_glyphs (c, buf, sizeof (expected), &end, NULL,
+					   HB_BUFFER_SERIALIZE_FORMAT_BINARY));
+
+  hb_buffer_destroy (c);
+  hb_buffer_destroy (b);
+}
+
+static void
+test_buffer_serialize_grow (void)
+{
+  static const char first[] = "{\"g\":\"gid5\",\"cl\":0,\"dx\":0,\"dy\":0,\"ax\":10,\"ay\":0},";
+  static const char last[] = ",{\"g\":\"gid999\",\"cl\":1002,\"dx\":0,\"dy\":0,\"ax\":0,\"ay\":0}";
+  hb_buffer_t *b = create_glyph_buffer ();
+  char *buf = NULL;
+  unsigned int buf_size = 0, buf_len = 0;
+  unsigned int i;
+
+  g_assert (hb_buffer_serialize_glyphs_grow (b, 0, 3, &buf, &buf_size, &buf_len, NULL,
+					     HB_BUFFER_SERIALIZE_FORMAT_TEXT,
+					     HB_BUFFER_SERIALIZE_FLAG_DEFAULT));
+  g_assert_cmpstr (buf, ==, "gid5=0+10|gid3=1@-1,0+5|gid300=3+200");
+  g_assert_cmpuint (buf_len, ==, strlen (buf));
+  g_assert_cmpuint (buf_size, >, buf_len);
+
+  /* What is in the buffer already is kept. */
+  buf_len = 9;
+  g_assert (hb_buffer_serialize_glyphs_grow (b, 1, 2, &buf, &buf_size, &buf_len, NULL,
+					     HB_BUFFER_SERIALIZE_FORMAT_TEXT,
+					     HB_BUFFER_SERIALIZE_FLAG_NO_POSITIONS));
+  g_assert_cmpstr (buf, ==, "gid5=0+10|gid3=1");
+  g_assert_cmpuint (buf_len, ==, 16);
+
+  /* Many glyphs grow it as needed. */
+  for (i = 0; i < 1000; i++)
+    hb_buffer_add (b, i, 3 + i);
+  buf_len = 0;
+  g_assert (hb_buffer_serialize_glyphs_grow (b, 0, hb_buffer_get_length (b),
+					     &buf, &buf_size, &buf_len, NULL,
+					     HB_BUFFER_SERIALIZE_FORMAT_JSON,
+					     HB_BUFFER_SERIALIZE_FLAG_DEFAULT));
+  g_assert_cmpuint (buf_len, ==, strlen (buf));
+  g_assert_cmpuint (buf_size, >, buf_len);
+  g_assert (0 == strncmp (buf, first, strlen (first)));
+  g_assert_cmpstr (buf + buf_len - strlen (last), ==, last);
+
+  /* Invalid formats are rejected, leaving the buffer alone. */
+  buf_len = 0;
+  g_assert (!hb_buffer_serialize_glyphs_grow (b, 0, 3, &buf, &buf_size, &buf_len, NULL,
+					      HB_BUFFER_SERIALIZE_FORMAT_INVALID,
+					      HB_BUFFER_SERIALIZE_FLAG_DEFAULT));
+  g_assert_cmpuint (buf_len, ==, 0);
+
+  hb_free (buf);
+  hb_buffer_destroy (b);
+}
+
+static hb_buffer_t *
+create_cluster_buffer (hb_direction_t direction,
+		       const unsigned int *clusters,
+		       unsigned int count)
+{
+  hb_buffer_t *b = hb_buffer_create ();
+  unsigned int i;
+
+  for (i = 0; i < count; i++)
+    hb_buffer_add (b, i + 1, clusters[i]);
+  hb_buffer_set_content_type (b, HB_BUFFER_CONTENT_TYPE_GLYPHS);
+  hb_buffer_set_direction (b, direction);
+
+  return b;
+}
+
+static void
+check_cluster_map (hb_buffer_t *b,
+		   unsigned int text_length,
+		   const unsigned int *expected_starts,
+		   const unsigned int *expected_ends,
+		   const unsigned int *expected_glyph_ends)
+{
+  unsigned int starts[8], ends[8], glyph_ends[8];
+  unsigned int count, i;
+
+  count = hb_buffer_get_cluster_map (b, text_length, starts, ends, glyph_ends);
+  g_assert_cmpint (count, ==, hb_buffer_get_length (b));
+  for (i = 0; i < text_length; i++)
+  {
+    g_assert_cmpint (starts[i], ==, expected_starts[i]);
+    g_assert_cmpint (ends[i], ==, expected_ends[i]);
+  }
+  for (i = 0; i < count; i++)
+    g_assert_cmpint (glyph_ends[i], ==, expected_glyph_ends[i]);
+
+  /* Each output is optional. */
+  g_assert_cmpint (hb_buffer_get_cluster_map (b, text_length, NULL, NULL, NULL), ==, count);
+}
+
+static void
+test_buffer_get_cluster_map (void)
+{
+  static const unsigned int ltr_clusters[] = {0, 0, 2, 5};
+  static const unsigned int ltr_starts[] = {0, 0, 2, 2, 2, 3, 3};
+  static const unsigned int ltr_ends[] = {2, 2, 3, 3, 3, 4, 4};
+  static const unsigned int ltr_glyph_ends[] = {2, 2, 5, 7};
+  static const unsigned int rtl_clusters[] = {5, 2, 0, 0};
+  static const unsigned int rtl_starts[] = {2, 2, 1, 1, 1, 0, 0};
+  static const unsigned int rtl_ends[] = {4, 4, 2, 2, 2, 1, 1};
+  static const unsigned int rtl_glyph_ends[] = {7, 5, 2, 2};
+  static const unsigned int late_clusters[] = {2, 3};
+  static const unsigned int late_starts[] = {(unsigned int) -1, (unsigned int) -1, 0, 1};
+  static const unsigned int late_ends[] = {(unsigned int) -1, (unsigned int) -1, 1, 2};
+  static const unsigned int late_glyph_ends[] = {3, 4};
+  hb_buffer_t *b;
+
+  b = create_cluster_buffer (HB_DIRECTION_LTR, ltr_clusters, G_N_ELEMENTS (ltr_clusters));
+  check_cluster_map (b, 7, ltr_starts, ltr_ends, ltr_glyph_ends);
+  hb_buffer_destroy (b);
+
+  b = create_cluster_buffer (HB_DIRECTION_RTL, rtl_clusters, G_N_ELEMENTS (rtl_clusters));
+  check_cluster_map (b, 7, rtl_starts, rtl_ends, rtl_glyph_ends);
+  hb_buffer_destroy (b);
+
+  /* Text before the first cluster maps to no glyphs. */
+  b = create_cluster_buffer (HB_DIRECTION_LTR, late_clusters, G_N_ELEMENTS (late_clusters));
+  check_cluster_map (b, 4, late_starts, late_ends, late_glyph_ends);
+  hb_buffer_destroy (b);
+
+  b = hb_buffer_create ();
+  check_cluster_map (b, 2, late_starts, late_ends, NULL);
+  hb_buffer_destroy (b);
+}
+
 int
 main (int argc, char **argv)
 {
@@ -880,6 +1314,12 @@ main (int argc, char **argv)
   hb_test_add (test_buffer_utf16_conversion);
   hb_test_add (test_buffer_utf32_conversion);
   hb_test_add (test_buffer_empty);
+  hb_test_add (test_buffer_pool);
+  hb_test_add (test_buffer_serialize_binary);
+  hb_test_add (test_buffer_serialize_grow);
+  hb_test_add (test_buffer_get_columns);
+  hb_test_add (test_buffer_get_segments);
+  hb_test_add (test_buffer_get_cluster_map);
 
   return hb_test_run();
 }
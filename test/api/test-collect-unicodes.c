@@ -93,6 +93,115 @@ test_collect_unicodes (void)
   hb_face_destroy (face);
 }
 
+static void
+test_collect_unicodes_mapping (void)
+{
+  hb_face_t *face = hb_test_open_font_file ("fonts/base.ttf");
+  hb_font_t *font = hb_font_create (face);
+  hb_map_t *mapping = hb_map_create ();
+  hb_set_t *codepoints = hb_set_create ();
+  hb_set_t *expected = hb_set_create ();
+  hb_codepoint_t cp, glyph, unicodes[4];
+  unsigned int count;
+
+  hb_face_collect_nominal_glyph_mapping (face, mapping, codepoints);
+  hb_face_collect_unicodes (face, expected);
+  g_assert (hb_set_is_equal (codepoints, expected));
+  g_assert_cmpuint (hb_map_get_population (mapping), ==, 4);
+  cp = HB_SET_VALUE_INVALID;
+  while (hb_set_next (codepoints, &cp))
+  {
+    g_assert (hb_font_get_nominal_glyph (font, cp, &glyph));
+    g_assert_cmpuint (hb_map_get (mapping, cp), ==, glyph);
+  }
+  g_assert_cmpuint (hb_map_get (mapping, 'J'), ==, 2);
+  g_assert_cmpuint (hb_map_get (mapping, 'j'), ==, 2);
+
+  /* Either output is optional. */
+  hb_map_clear (mapping);
+  hb_face_collect_nominal_glyph_mapping (face, mapping, NULL);
+  g_assert_cmpuint (hb_map_get_population (mapping), ==, 4);
+  hb_set_clear (codepoints);
+  hb_face_collect_nominal_glyph_mapping (face, NULL, codepoints);
+  g_assert (hb_set_is_equal (codepoints, expected));
+
+  /* The reverse lookup, in increasing order. */
+  count = G_N_ELEMENTS (unicodes);
+  g_assert_cmpuint (hb_face_get_glyph_unicodes (face, 2, 0, &count, unicodes), ==, 2);
+  g_assert_cmpuint (count, ==, 2);
+  g_assert_cmphex (unicodes[0], ==, 'J');
+  g_assert_cmphex (unicodes[1], ==, 'j');
+  count = 1;
+  g_assert_cmpuint (hb_face_get_glyph_unicodes (face, 2, 1, &count, unicodes), ==, 2);
+  g_assert_cmpuint (count, ==, 1);
+  g_assert_cmphex (unicodes[0], ==, 'j');
+  count = G_N_ELEMENTS (unicodes);
+  g_assert_cmpuint (hb_face_get_glyph_unicodes (face, 2, 2, &count, unicodes), ==, 2);
+  g_assert_cmpuint (count, ==, 0);
+  g_assert_cmpuint (hb_face_get_glyph_unicodes (face, 2, 0, NULL, NULL), ==, 2);
+
+  count = G_N_ELEMENTS (unicodes);
+  g_assert_cmpuint (hb_face_get_glyph_unicodes (face, 7, 0, &count, unicodes), ==, 1);
+  g_assert_cmphex (unicodes[0], ==, 0x904D);
+  count = G_N_ELEMENTS (unicodes);
+  g_assert_cmpuint (hb_face_get_glyph_unicodes (face, 0, 0, &count, unicodes), ==, 0);
+  g_assert_cmpuint (count, ==, 0);
+  count = G_N_ELEMENTS (unicodes);
+  g_assert_cmpuint (hb_face_get_glyph_unicodes (hb_face_get_empty (), 2, 0, &count, unicodes), ==, 0);
+  g_assert_cmpuint (count, ==, 0);
+
+  hb_map_clear (mapping);
+  hb_set_clear (codepoints);
+  hb_face_collect_nominal_glyph_mapping (hb_face_get_empty (), mapping, codepoints);
+  g_assert_cmpuint (hb_map_get_population (mapping), ==, 0);
+  g_assert (hb_set_is_empty (codepoints));
+
+  hb_set_destroy (expected);
+  hb_set_destroy (codepoints);
+  hb_map_destroy (mapping);
+  hb_font_destroy (font);
+  hb_face_destroy (face);
+}
+
+static void
+test_collect_unicodes_coverage (void)
+{
+  hb_face_t *face = hb_test_open_font_file ("fonts/Roboto-Regular.abc.format4.ttf");
+  hb_codepoint_t unicodes[40] = {'a', 'x', 'c', 0x10061, 'b'};
+  hb_codepoint_t *all = (hb_codepoint_t *) malloc (70000 * sizeof (hb_codepoint_t));
+  uint32_t coverage[2] = {0xFFFFFFFFu, 0xFFFFFFFFu};
+  uint32_t *all_coverage = (uint32_t *) malloc ((70000 + 31) / 32 * sizeof (uint32_t));
+  unsigned int i;
+
+  g_assert_cmpuint (hb_face_get_nominal_glyphs_coverage (face, 5, unicodes, coverage), ==, 3);
+  g_assert_cmphex (coverage[0], ==, 0x15);
+  g_assert_cmphex (coverage[1], ==, 0xFFFFFFFFu);
+
+  unicodes[33] = 'c';
+  g_assert_cmpuint (hb_face_get_nominal_glyphs_coverage (face, 40, unicodes, coverage), ==, 4);
+  g_assert_cmphex (coverage[0], ==, 0x15);
+  g_assert_cmphex (coverage[1], ==, 0x2);
+
+  /* Many queries switch to the BMP bitmap, with the same answers. */
+  for (i = 0; i < 70000; i++)
+    all[i] = i;
+  g_assert_cmpuint (hb_face_get_nominal_glyphs_coverage (face, 70000, all, all_coverage), ==, 3);
+  g_assert_cmpuint (hb_face_get_nominal_glyphs_coverage (face, 70000, all, all_coverage), ==, 3);
+  g_assert_cmphex (all_coverage['a' / 32], ==, 0x7u << ('a' % 32));
+  g_assert_cmphex (all_coverage[0x10061 / 32], ==, 0);
+  g_assert_cmpuint (hb_face_get_nominal_glyphs_coverage (face, 40, unicodes, coverage), ==, 4);
+  g_assert_cmphex (coverage[0], ==, 0x15);
+  g_assert_cmphex (coverage[1], ==, 0x2);
+
+  g_assert_cmpuint (hb_face_get_nominal_glyphs_coverage (hb_face_get_empty (), 40, unicodes, coverage), ==, 0);
+  g_assert_cmphex (coverage[0], ==, 0);
+  g_assert_cmphex (coverage[1], ==, 0);
+
+  free (all_coverage);
+  free (all);
+  hb_face_destroy (face);
+}
+
 int
 main (int argc, char **argv)
 {
@@ -101,6 +210,8 @@ main (int argc, char **argv)
   hb_test_add (test_collect_unicodes);
   hb_test_add (test_collect_unicodes_format4);
   hb_test_add (test_collect_unicodes_format12);
+  hb_test_add (test_collect_unicodes_mapping);
+  hb_test_add (test_collect_unicodes_coverage);
 
   return hb_test_run();
 }
@@ -202,6 +202,9 @@ test_types_language (void)
   g_assert (HB_LANGUAGE_INVALID == hb_language_from_string ("", -1));
   g_assert (HB_LANGUAGE_INVALID == hb_language_from_string ("en", 0));
   g_assert (HB_LANGUAGE_INVALID != hb_language_from_string ("en", 1));
+  g_assert (HB_LANGUAGE_INVALID == hb_language_from_string (" en", -1));
+  g_assert (HB_LANGUAGE_INVALID == hb_language_from_string ("@en", 3));
+  g_assert (en == hb_language_from_string ("en@x", -1));
   g_assert (NULL == hb_language_to_string (HB_LANGUAGE_INVALID));
 
   /* Not sure how to test this better.  Setting env vars
@@ -0,0 +1,455 @@
+/*
+ * Copyright © 2018  Google, Inc.
+ *
+ *  This is part of HarfBuzz, a text shaping library.
+ *
+ * Permission is hereby granted, without written agreement and without
+ * license or royalty fees, to use, copy, modify, and distribute this
+ * software and its documentation for any purpose, provided that the
+ * above copyright notice and the following two paragraphs appear in
+ * all copies of this software.
+ *
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE TO ANY PARTY FOR
+ * DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES
+ * ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION, EVEN
+ * IF THE COPYRIGHT HOLDER HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * THE COPYRIGHT HOLDER SPECIFICALLY DISCLAIMS ANY WARRANTIES, INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER IS
+ * ON AN "AS IS" BASIS, AND THE COPYRIGHT HOLDER HAS NO OBLIGATION TO
+ * PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+ */
+
+#include "hb-test.h"
+
+/* Unit tests for hb-face.h */
+
+
+typedef struct
+{
+  char data[4096];
+  unsigned int length;
+  unsigned int max_writes;
+} writer_t;
+
+static hb_bool_t
+write_to_buffer (const char *data, unsigned int length, void *user_data)
+{
+  writer_t *writer = (writer_t *) user_data;
+  if (!writer->max_writes)
+    return FALSE;
+  writer->max_writes--;
+  g_assert_cmpint (writer->length + length, <=, sizeof (writer->data));
+  memcpy (writer->data + writer->length, data, length);
+  writer->length += length;
+  return TRUE;
+}
+
+/* Tables of all lengths mod four, more of them than
+ * hb_face_builder_write() asks for at once. */
+static hb_face_t *
+create_builder_face (void)
+{
+  static const char data[] = "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ";
+  hb_face_t *face = hb_face_builder_create ();
+  unsigned int i;
+
+  for (i = 0; i < 40; i++)
+  {
+    hb_blob_t *blob = hb_blob_create (data, i + 1, HB_MEMORY_MODE_READONLY, NULL, NULL);
+    g_assert (hb_face_builder_add_table (face, HB_TAG ('t','a', 'A' + i / 10, '0' + i % 10), blob));
+    hb_blob_destroy (blob);
+  }
+  return face;
+}
+
+static void
+test_face_builder_get_chunks (void)
+{
+  hb_face_t *face = create_builder_face ();
+  hb_blob_t *blob = hb_face_reference_blob (face);
+  hb_face_builder_chunk_t chunks[8];
+  unsigned int total, count, offset, length;
+  const char *data = hb_blob_get_data (blob, &length);
+  hb_face_t *reopened;
+
+  total = hb_face_builder_get_chunks (face, 0, NULL, NULL);
+  g_assert_cmpint (total, >, 40);
+
+  /* Back to back, the chunks are the compiled font. */
+  offset = 0;
+  count = 0;
+  while (offset < total)
+  {
+    unsigned int i;
+    count = G_N_ELEMENTS (chunks);
+    g_assert_cmpint (hb_face_builder_get_chunks (face, offset, &count, chunks), ==, total);
+    g_assert_cmpint (count, ==, MIN (G_N_ELEMENTS (chunks), total - offset));
+    for (i = 0; i < count; i++)
+    {
+      g_assert_cmpint (chunks[i].length, <=, length);
+      g_assert (0 == memcmp (chunks[i].data, data, chunks[i].length));
+      data += chunks[i].length;
+      length -= chunks[i].length;
+    }
+    offset += count;
+  }
+  g_assert_cmpint (length, ==, 0);
+
+  count = G_N_ELEMENTS (chunks);
+  g_assert_cmpint (hb_face_builder_get_chunks (face, total, &count, chunks), ==, total);
+  g_assert_cmpint (count, ==, 0);
+
+  /* Only builder faces have chunks. */
+  reopened = hb_face_create (blob, 0);
+  g_assert_cmpint (hb_face_get_table_tags (reopened, 0, NULL, NULL), ==, 40);
+  count = G_N_ELEMENTS (chunks);
+  g_assert_cmpint (hb_face_builder_get_chunks (reopened, 0, &count, chunks), ==, 0);
+  g_assert_cmpint (count, ==, 0);
+  g_assert_cmpint (hb_face_builder_get_chunks (hb_face_get_empty (), 0, NULL, NULL), ==, 0);
+
+  hb_face_destroy (reopened);
+  hb_blob_destroy (blob);
+  hb_face_destroy (face);
+}
+
+static void
+test_face_builder_write (void)
+{
+  hb_face_t *face = create_builder_face ();
+  hb_blob_t *blob = hb_face_reference_blob (face);
+  writer_t writer;
+  unsigned int length;
+  const char *data = hb_blob_get_data (blob, &length);
+
+  writer.length = 0;
+  writer.max_writes = (unsigned int) -1;
+  g_assert (hb_face_builder_write (face, write_to_buffer, &writer));
+  g_assert_cmpint (writer.length, ==, length);
+  g_assert (0 == memcmp (writer.data, data, length));
+
+  /* Stops when the callback fails. */
+  writer.length = 0;
+  writer.max_writes = 1;
+  g_assert (!hb_face_builder_write (face, write_to_buffer, &writer));
+  g_assert_cmpint (writer.max_writes, ==, 0);
+
+  writer.length = 0;
+  writer.max_writes = (unsigned int) -1;
+  g_assert (!hb_face_builder_write (hb_face_get_empty (), write_to_buffer, &writer));
+  g_assert_cmpint (writer.length, ==, 0);
+
+  hb_blob_destroy (blob);
+  hb_face_destroy (face);
+}
+
+static unsigned int
+get_memory_usage (hb_face_t *face, hb_tag_t tag)
+{
+  hb_face_memory_usage_t entries[64];
+  unsigned int count = G_N_ELEMENTS (entries);
+  unsigned int total = hb_face_get_memory_usage (face, 0, &count, entries);
+  unsigned int sum = 0, bytes = 0, i;
+
+  g_assert_cmpint (count, <, G_N_ELEMENTS (entries));
+  for (i = 0; i < count; i++)
+  {
+    sum += entries[i].bytes;
+    if (entries[i].tag == tag)
+      bytes = entries[i].bytes;
+  }
+  g_assert_cmpint (sum, ==, total);
+
+  /* Paging through them gives the same entries. */
+  for (i = 0; i < count; i++)
+  {
+    hb_face_memory_usage_t entry;
+    unsigned int one = 1;
+    g_assert_cmpint (hb_face_get_memory_usage (face, i, &one, &entry), ==, total);
+    g_assert_cmpint (one, ==, 1);
+    g_assert_cmpint (entry.tag, ==, entries[i].tag);
+    g_assert_cmpint (entry.bytes, ==, entries[i].bytes);
+  }
+
+  return bytes;
+}
+
+static void
+test_face_memory_usage (void)
+{
+  hb_face_t *face = hb_test_open_font_file ("fonts/Roboto-Regular.gsub.fi.ttf");
+  hb_font_t *font = hb_font_create (face);
+  hb_buffer_t *buffer = hb_buffer_create ();
+  hb_segment_properties_t props;
+  hb_shape_plan_t *shape_plan;
+  unsigned int total, font_bytes, count;
+
+  total = hb_face_get_memory_usage (face, 0, NULL, NULL);
+  g_assert_cmpint (get_memory_usage (face, HB_TAG ('f','a','c','e')), >, 0);
+  g_assert_cmpint (get_memory_usage (face, HB_TAG ('p','l','a','n')), ==, 0);
+  g_assert_cmpint (get_memory_usage (face, HB_TAG ('G','S','U','B')), ==, 0);
+  font_bytes = hb_font_get_memory_usage (font);
+  g_assert_cmpint (font_bytes, >, 0);
+
+  hb_buffer_add_utf8 (buffer, "fi", -1, 0, -1);
+  hb_buffer_guess_segment_properties (buffer);
+  hb_shape (font, buffer, NULL, 0);
+
+  /* Shaping loaded the layout tables and cached a plan. */
+  g_assert_cmpint (hb_face_get_memory_usage (face, 0, NULL, NULL), >, total);
+  g_assert_cmpint (get_memory_usage (face, HB_TAG ('G','S','U','B')), >, 0);
+  g_assert_cmpint (get_memory_usage (face, HB_TAG ('p','l','a','n')), >, 0);
+  g_assert_cmpint (hb_font_get_memory_usage (font), >=, font_bytes);
+
+  hb_buffer_get_segment_properties (buffer, &props);
+  shape_plan = hb_shape_plan_create_cached (face, &props, NULL, 0, NULL);
+  g_assert_cmpint (hb_shape_plan_get_memory_usage (shape_plan), >, 0);
+  g_assert_cmpint (hb_shape_plan_get_memory_usage (shape_plan), <, get_memory_usage (face, HB_TAG ('p','l','a','n')));
+  hb_shape_plan_destroy (shape_plan);
+
+  count = 1;
+  g_assert_cmpint (hb_face_get_memory_usage (hb_face_get_empty (), 0, &count, NULL), ==, 0);
+  g_assert_cmpint (count, ==, 0);
+  g_assert_cmpint (hb_font_get_memory_usage (hb_font_get_empty ()), ==, 0);
+  g_assert_cmpint (hb_shape_plan_get_memory_usage (hb_shape_plan_get_empty ()), ==, 0);
+
+  hb_buffer_destroy (buffer);
+  hb_font_destroy (font);
+  hb_face_destroy (face);
+}
+
+static hb_face_t *
+create_face_for_blob (hb_blob_t *blob, hb_sanitize_cache_t *cache)
+{
+  hb_face_t *face = hb_face_create (blob, 0);
+  if (cache)
+    hb_face_set_sanitize_cache (face, cache);
+  return face;
+}
+
+static unsigned int
+load_tables (hb_face_t *face, unsigned int expected_unicodes)
+{
+  hb_set_t *unicodes = hb_set_create ();
+  hb_face_collect_unicodes (face, unicodes);
+  g_assert_cmpint (hb_set_get_population (unicodes), ==, expected_unicodes);
+  hb_set_destroy (unicodes);
+  return hb_face_get_sanitize_ops (face);
+}
+
+static void
+check_sanitize_cache (hb_sanitize_cache_t *cache,
+		      unsigned int expected_tables,
+		      unsigned int expected_hits,
+		      unsigned int expected_misses)
+{
+  unsigned int hits, misses;
+  g_assert_cmpint (hb_sanitize_cache_get_stats (cache, &hits, &misses), ==, expected_tables);
+  g_assert_cmpint (hits, ==, expected_hits);
+  g_assert_cmpint (misses, ==, expected_misses);
+}
+
+static void
+test_face_sanitize_cache (void)
+{
+  hb_face_t *face = hb_test_open_font_file ("fonts/Roboto-Regular.abc.ttf");
+  hb_face_t *other_font = hb_test_open_font_file ("fonts/Roboto-Regular.ac.ttf");
+  hb_blob_t *blob = hb_face_reference_blob (face);
+  hb_blob_t *other_blob = hb_face_reference_blob (other_font);
+  hb_blob_t *copied_blob;
+  hb_sanitize_cache_t *cache = hb_sanitize_cache_create (8);
+  hb_sanitize_cache_t *small_cache = hb_sanitize_cache_create (1);
+  hb_face_t *first, *shared, *copy, *other, *strict, *uncached;
+  unsigned int length, ops;
+  const char *data;
+
+  /* Loading cmap sanitizes maxp and cmap. */
+  first = create_face_for_blob (blob, cache);
+  ops = load_tables (first, 3);
+  g_assert_cmpint (ops, >, 0);
+  check_sanitize_cache (cache, 2, 0, 2);
+
+  /* The same bytes, shared or copied, pass for free. */
+  shared = create_face_for_blob (blob, cache);
+  g_assert_cmpint (load_tables (shared, 3), ==, 0);
+  check_sanitize_cache (cache, 2, 2, 2);
+  data = hb_blob_get_data (blob, &length);
+  copied_blob = hb_blob_create (data, length, HB_MEMORY_MODE_DUPLICATE, NULL, NULL);
+  copy = create_face_for_blob (copied_blob, cache);
+  g_assert_cmpint (load_tables (copy, 3), ==, 0);
+  check_sanitize_cache (cache, 2, 4, 2);
+
+  /* Other bytes, or another budget, go through the sanitizer. */
+  other = create_face_for_blob (other_blob, cache);
+  g_assert_cmpint (load_tables (other, 2), >, 0);
+  check_sanitize_cache (cache, 4, 4, 4);
+  strict = create_face_for_blob (blob, NULL);
+  hb_face_set_sanitize_max_ops_factor (strict, 1);
+  hb_face_set_sanitize_cache (strict, cache);
+  g_assert_cmpint (load_tables (strict, 3), ==, ops);
+  check_sanitize_cache (cache, 6, 4, 6);
+
+  /* Without a cache, every face pays. */
+  uncached = create_face_for_blob (blob, NULL);
+  g_assert_cmpint (load_tables (uncached, 3), ==, ops);
+  check_sanitize_cache (cache, 6, 4, 6);
+
+  /* Full caches evict. */
+  hb_face_destroy (uncached);
+  uncached = create_face_for_blob (blob, small_cache);
+  load_tables (uncached, 3);
+  check_sanitize_cache (small_cache, 1, 0, 2);
+
+  check_sanitize_cache (hb_sanitize_cache_get_empty (), 0, 0, 0);
+  g_assert (hb_sanitize_cache_reference (cache) == cache);
+  hb_sanitize_cache_destroy (cache);
+
+  hb_face_destroy (uncached);
+  hb_face_destroy (strict);
+  hb_face_destroy (other);
+  hb_face_destroy (copy);
+  hb_face_destroy (shared);
+  hb_face_destroy (first);
+  hb_sanitize_cache_destroy (small_cache);
+  hb_sanitize_cache_destroy (cache);
+  hb_blob_destroy (copied_blob);
+  hb_blob_destroy (other_blob);
+  hb_blob_destroy (blob);
+  hb_face_destroy (other_font);
+  hb_face_destroy (face);
+}
+
+static void
+check_shape_abc (hb_face_t *face)
+{
+  hb_font_t *font = hb_font_create (face);
+  hb_buffer_t *buffer = hb_buffer_create ();
+  hb_glyph_info_t *infos;
+  unsigned int len, i;
+
+  hb_buffer_add_utf8 (buffer, "abc", -1, 0, -1);
+  hb_buffer_guess_segment_properties (buffer);
+  hb_shape (font, buffer, NULL, 0);
+
+  infos = hb_buffer_get_glyph_infos (buffer, &len);
+  g_assert_cmpuint (len, ==, 3);
+  for (i = 0; i < len; i++)
+    g_assert_cmpuint (infos[i].codepoint, ==, i + 1);
+
+  hb_buffer_destroy (buffer);
+  hb_font_destroy (font);
+}
+
+static void
+test_face_prefetch (void)
+{
+  static const hb_tag_t tags[] = {
+    HB_TAG ('c','m','a','p'),
+    HB_TAG ('h','m','t','x'),
+    HB_TAG ('G','S','U','B'),	/* Missing. */
+    HB_TAG ('g','l','y','f'),
+  };
+  hb_face_t *face = hb_test_open_font_file ("fonts/Roboto-Regular.abc.ttf");
+  hb_face_t *builder = hb_face_builder_create ();
+
+  /* Prefetching is only a hint; faces work the same after it. */
+  hb_face_prefetch_tables (face, tags, G_N_ELEMENTS (tags));
+  hb_face_prefetch_tables (face, NULL, 0);
+  hb_face_prefetch_tables (builder, tags, G_N_ELEMENTS (tags));
+  hb_face_prefetch_tables (hb_face_get_empty (), tags, G_N_ELEMENTS (tags));
+  check_shape_abc (face);
+
+  hb_face_destroy (face);
+  face = hb_test_open_font_file ("fonts/Roboto-Regular.abc.ttf");
+  hb_face_set_prefetch_on_plan (face, TRUE);
+  hb_face_set_prefetch_on_plan (builder, TRUE);
+  hb_face_set_prefetch_on_plan (hb_face_get_empty (), TRUE);
+  check_shape_abc (face);
+  hb_face_set_prefetch_on_plan (face, FALSE);
+  check_shape_abc (face);
+
+  hb_face_destroy (builder);
+  hb_face_destroy (face);
+}
+
+static unsigned int
+load_unicodes (hb_face_t *face, hb_set_t *unicodes)
+{
+  hb_set_clear (unicodes);
+  hb_face_collect_unicodes (face, unicodes);
+  return hb_face_get_sanitize_ops (face);
+}
+
+static void
+test_face_collection (void)
+{
+  hb_blob_t *blob = hb_blob_create_from_file ("../shaping/data/in-house/fonts/TTC.ttc");
+  hb_face_collection_t *collection = hb_face_collection_create (blob);
+  hb_face_t *reference = hb_face_create (blob, 0);
+  hb_face_t *face, *second, *missing;
+  hb_set_t *unicodes = hb_set_create ();
+  hb_set_t *expected = hb_set_create ();
+
+  g_assert_cmpint (hb_blob_get_length (blob), >, 0);
+  g_assert_cmpint (hb_face_collection_get_face_count (collection), ==, 2);
+  g_assert_cmpint (hb_face_count (blob), ==, 2);
+
+  /* Faces are those hb_face_create() makes... */
+  load_unicodes (reference, expected);
+  g_assert_cmpint (hb_set_get_population (expected), >, 0);
+  face = hb_face_collection_create_face (collection, 0);
+  g_assert_cmpint (hb_face_get_index (face), ==, 0);
+  g_assert_cmpint (hb_face_get_upem (face), ==, hb_face_get_upem (reference));
+  g_assert_cmpint (hb_face_get_glyph_count (face), ==, hb_face_get_glyph_count (reference));
+  g_assert_cmpint (load_unicodes (face, unicodes), >, 0);
+  g_assert (hb_set_is_equal (unicodes, expected));
+
+  /* ...but the tables both faces of this file share are checked once. */
+  second = hb_face_collection_create_face (collection, 1);
+  g_assert_cmpint (hb_face_get_index (second), ==, 1);
+  g_assert_cmpint (load_unicodes (second, unicodes), ==, 0);
+  g_assert (hb_set_is_equal (unicodes, expected));
+
+  missing = hb_face_collection_create_face (collection, 2);
+  g_assert_cmpint (hb_face_get_glyph_count (missing), ==, 0);
+  hb_face_destroy (missing);
+
+  /* Faces outlive the collection. */
+  hb_face_collection_destroy (collection);
+  hb_face_destroy (face);
+  face = hb_face_reference (second);
+  hb_face_destroy (second);
+  load_unicodes (face, unicodes);
+  g_assert (hb_set_is_equal (unicodes, expected));
+  hb_face_destroy (face);
+
+  collection = hb_face_collection_get_empty ();
+  g_assert_cmpint (hb_face_collection_get_face_count (collection), ==, 0);
+  g_assert (hb_face_collection_reference (collection) == collection);
+  face = hb_face_collection_create_face (collection, 0);
+  g_assert_cmpint (hb_face_get_glyph_count (face), ==, 0);
+  hb_face_destroy (face);
+  hb_face_collection_destroy (collection);
+
+  hb_set_destroy (expected);
+  hb_set_destroy (unicodes);
+  hb_face_destroy (reference);
+  hb_blob_destroy (blob);
+}
+
+int
+main (int argc, char **argv)
+{
+  hb_test_init (&argc, &argv);
+
+  hb_test_add (test_face_builder_get_chunks);
+  hb_test_add (test_face_builder_write);
+  hb_test_add (test_face_memory_usage);
+  hb_test_add (test_face_sanitize_cache);
+  hb_test_add (test_face_prefetch);
+  hb_test_add (test_face_collection);
+
+  return hb_test_run();
+}
@@ -430,6 +430,214 @@ test_fontfuncs_parallels (void)
   hb_font_destroy (font2);
 }
 
+static unsigned int
+glyph_extents_batch_func (hb_font_t *font HB_UNUSED,
+			  void *font_data HB_UNUSED,
+			  unsigned int count,
+			  const hb_codepoint_t *first_glyph,
+			  unsigned int glyph_stride,
+			  hb_glyph_extents_t *first_extents,
+			  unsigned int extents_stride,
+			  void *user_data)
+{
+  unsigned int i;
+  (*(unsigned int *) user_data)++;
+  for (i = 0; i < count; i++)
+  {
+    first_extents->width = *first_glyph;
+    first_glyph = (const hb_codepoint_t *) ((const char *) first_glyph + glyph_stride);
+    first_extents = (hb_glyph_extents_t *) ((char *) first_extents + extents_stride);
+  }
+  return count;
+}
+
+static void
+test_fontfuncs_extents_batch (void)
+{
+  hb_face_t *face = hb_test_open_font_file ("fonts/Roboto-Regular.abc.ttf");
+  hb_font_t *font = hb_font_create (face);
+  hb_font_t *sub_font = hb_font_create_sub_font (font);
+  hb_font_funcs_t *ffuncs = hb_font_funcs_create ();
+  struct { hb_codepoint_t glyph; unsigned int cluster; } glyphs[5] = {{0, 0}, {1, 1}, {2, 2}, {3, 3}, {1000, 4}};
+  struct { hb_glyph_extents_t extents; unsigned int padding; } extents[5];
+  hb_glyph_extents_t expected;
+  unsigned int calls = 0;
+  unsigned int i;
+
+  /* Glyph 1000 is out of range. */
+  g_assert_cmpint (hb_font_get_glyph_extents_batch (font, 5,
+						    &glyphs[0].glyph, sizeof (glyphs[0]),
+						    &extents[0].extents, sizeof (extents[0])), ==, 4);
+  for (i = 0; i < 5; i++)
+  {
+    g_assert (hb_font_get_glyph_extents (font, glyphs[i].glyph, &expected) == (i < 4));
+    g_assert_cmpint (extents[i].extents.x_bearing, ==, expected.x_bearing);
+    g_assert_cmpint (extents[i].extents.y_bearing, ==, expected.y_bearing);
+    g_assert_cmpint (extents[i].extents.width, ==, expected.width);
+    g_assert_cmpint (extents[i].extents.height, ==, expected.height);
+  }
+  g_assert_cmpint (extents[1].extents.width, !=, 0);
+
+  /* A sub-font at twice the scale scales its parent's extents. */
+  hb_font_set_scale (sub_font, 2 * hb_face_get_upem (face), 2 * hb_face_get_upem (face));
+  g_assert_cmpint (hb_font_get_glyph_extents_batch (sub_font, 4,
+						    &glyphs[0].glyph, sizeof (glyphs[0]),
+						    &extents[0].extents, sizeof (extents[0])), ==, 4);
+  for (i = 0; i < 4; i++)
+  {
+    hb_font_get_glyph_extents (font, glyphs[i].glyph, &expected);
+    g_assert_cmpint (extents[i].extents.x_bearing, ==, 2 * expected.x_bearing);
+    g_assert_cmpint (extents[i].extents.y_bearing, ==, 2 * expected.y_bearing);
+    g_assert_cmpint (extents[i].extents.width, ==, 2 * expected.width);
+    g_assert_cmpint (extents[i].extents.height, ==, 2 * expected.height);
+  }
+
+  /* A batch func is called once for all glyphs. */
+  hb_font_funcs_set_glyph_extents_batch_func (ffuncs, glyph_extents_batch_func, &calls, NULL);
+  hb_font_set_funcs (sub_font, ffuncs, NULL, NULL);
+  hb_font_set_scale (sub_font, hb_face_get_upem (face), hb_face_get_upem (face));
+  g_assert_cmpint (hb_font_get_glyph_extents_batch (sub_font, 5,
+						    &glyphs[0].glyph, sizeof (glyphs[0]),
+						    &extents[0].extents, sizeof (extents[0])), ==, 5);
+  g_assert_cmpint (calls, ==, 1);
+  for (i = 0; i < 5; i++)
+  {
+    g_assert_cmpint (extents[i].extents.x_bearing, ==, 0);
+    g_assert_cmpint (extents[i].extents.width, ==, glyphs[i].glyph);
+  }
+
+  hb_font_funcs_destroy (ffuncs);
+  hb_font_destroy (sub_font);
+  hb_font_destroy (font);
+  hb_face_destroy (face);
+}
+
+static hb_bool_t
+glyph_v_origins_func (hb_font_t *font HB_UNUSED,
+		      void *font_data HB_UNUSED,
+		      unsigned int count,
+		      const hb_codepoint_t *first_glyph,
+		      unsigned int glyph_stride,
+		      hb_position_t *first_x,
+		      unsigned int x_stride,
+		      hb_position_t *first_y,
+		      unsigned int y_stride,
+		      void *user_data)
+{
+  unsigned int i;
+  (*(unsigned int *) user_data)++;
+  for (i = 0; i < count; i++)
+  {
+    *first_x = *first_glyph;
+    *first_y = -(hb_position_t) *first_glyph;
+    first_glyph = (const hb_codepoint_t *) ((const char *) first_glyph + glyph_stride);
+    first_x = (hb_position_t *) ((char *) first_x + x_stride);
+    first_y = (hb_position_t *) ((char *) first_y + y_stride);
+  }
+  return TRUE;
+}
+
+static hb_bool_t
+glyph_v_origin_func (hb_font_t *font HB_UNUSED, void *font_data HB_UNUSED,
+		     hb_codepoint_t glyph,
+		     hb_position_t *x, hb_position_t *y,
+		     void *user_data)
+{
+  (*(unsigned int *) user_data)++;
+  *x = 2 * glyph;
+  *y = 3 * glyph;
+  return glyph != 3;
+}
+
+static void
+test_fontfuncs_v_origins (void)
+{
+  hb_face_t *face = hb_test_open_font_file ("fonts/Roboto-Regular.abc.ttf");
+  hb_font_t *font = hb_font_create (face);
+  hb_font_t *sub_font = hb_font_create_sub_font (font);
+  hb_font_funcs_t *ffuncs;
+  struct { hb_codepoint_t glyph; unsigned int cluster; } glyphs[4] = {{0, 0}, {1, 1}, {2, 2}, {3, 3}};
+  struct { hb_position_t x, y; } origins[4];
+  hb_position_t x, y;
+  unsigned int calls = 0;
+  unsigned int i, pass;
+
+  /* Twice, to also read back what the font remembers. */
+  for (pass = 0; pass < 2; pass++)
+  {
+    g_assert (hb_font_get_glyph_v_origins (font, 4,
+					   &glyphs[0].glyph, sizeof (glyphs[0]),
+					   &origins[0].x, sizeof (origins[0]),
+					   &origins[0].y, sizeof (origins[0])));
+    for (i = 0; i < 4; i++)
+    {
+      g_assert (hb_font_get_glyph_v_origin (font, glyphs[i].glyph, &x, &y));
+      g_assert_cmpint (origins[i].x, ==, x);
+      g_assert_cmpint (origins[i].y, ==, y);
+    }
+  }
+  g_assert_cmpint (origins[1].x, !=, 0);
+  g_assert_cmpint (origins[1].y, !=, 0);
+
+  /* A sub-font at twice the scale scales its parent's origins. */
+  hb_font_set_scale (sub_font, 2 * hb_face_get_upem (face), 2 * hb_face_get_upem (face));
+  g_assert (hb_font_get_glyph_v_origins (sub_font, 4,
+					 &glyphs[0].glyph, sizeof (glyphs[0]),
+					 &origins[0].x, sizeof (origins[0]),
+					 &origins[0].y, sizeof (origins[0])));
+  for (i = 0; i < 4; i++)
+  {
+    hb_font_get_glyph_v_origin (font, glyphs[i].glyph, &x, &y);
+    g_assert_cmpint (origins[i].x, ==, 2 * x);
+    g_assert_cmpint (origins[i].y, ==, 2 * y);
+  }
+
+  /* A batch func is called once for all glyphs, and for single ones. */
+  ffuncs = hb_font_funcs_create ();
+  hb_font_funcs_set_glyph_v_origins_func (ffuncs, glyph_v_origins_func, &calls, NULL);
+  hb_font_set_funcs (sub_font, ffuncs, NULL, NULL);
+  hb_font_funcs_destroy (ffuncs);
+  g_assert (hb_font_get_glyph_v_origins (sub_font, 4,
+					 &glyphs[0].glyph, sizeof (glyphs[0]),
+					 &origins[0].x, sizeof (origins[0]),
+					 &origins[0].y, sizeof (origins[0])));
+  g_assert_cmpint (calls, ==, 1);
+  for (i = 0; i < 4; i++)
+  {
+    g_assert_cmpint (origins[i].x, ==, (hb_position_t) glyphs[i].glyph);
+    g_assert_cmpint (origins[i].y, ==, -(hb_position_t) glyphs[i].glyph);
+  }
+  g_assert (hb_font_get_glyph_v_origin (sub_font, 2, &x, &y));
+  g_assert_cmpint (calls, ==, 2);
+  g_assert_cmpint (x, ==, 2);
+  g_assert_cmpint (y, ==, -2);
+
+  /* A single-glyph func serves batches, failing if any glyph fails. */
+  calls = 0;
+  ffuncs = hb_font_funcs_create ();
+  hb_font_funcs_set_glyph_v_origin_func (ffuncs, glyph_v_origin_func, &calls, NULL);
+  hb_font_set_funcs (sub_font, ffuncs, NULL, NULL);
+  hb_font_funcs_destroy (ffuncs);
+  g_assert (hb_font_get_glyph_v_origins (sub_font, 3,
+					 &glyphs[0].glyph, sizeof (glyphs[0]),
+					 &origins[0].x, sizeof (origins[0]),
+					 &origins[0].y, sizeof (origins[0])));
+  g_assert_cmpint (calls, ==, 3);
+  for (i = 0; i < 3; i++)
+  {
+    g_assert_cmpint (origins[i].x, ==, 2 * (hb_position_t) glyphs[i].glyph);
+    g_assert_cmpint (origins[i].y, ==, 3 * (hb_position_t) glyphs[i].glyph);
+  }
+  g_assert (!hb_font_get_glyph_v_origins (sub_font, 4,
+					  &glyphs[0].glyph, sizeof (glyphs[0]),
+					  &origins[0].x, sizeof (origins[0]),
+					  &origins[0].y, sizeof (origins[0])));
+
+  hb_font_destroy (sub_font);
+  hb_font_destroy (font);
+  hb_face_destroy (face);
+}
+
 static void
 test_font_empty (void)
 {
@@ -601,6 +809,111 @@ test_font_properties (void)
   hb_font_destroy (subfont);
 }
 
+static hb_position_t
+glyph_h_advance_data_func (hb_font_t *font HB_UNUSED, void *font_data,
+			   hb_codepoint_t glyph HB_UNUSED,
+			   void *user_data HB_UNUSED)
+{
+  return *(hb_position_t *) font_data;
+}
+
+static void
+destroy_advance_data (void *data)
+{
+  *(hb_position_t *) data = -1;
+}
+
+static void
+test_font_snapshot (void)
+{
+  hb_face_t *face;
+  hb_font_t *font;
+  hb_font_t *subfont;
+  hb_font_t *snapshot;
+  hb_font_t *subsnapshot;
+  hb_font_funcs_t *ffuncs;
+  hb_position_t advance, data1, data2;
+  int x_scale, y_scale;
+  unsigned int x_ppem, y_ppem;
+
+  face = hb_test_open_font_file ("fonts/Roboto-Regular.abc.ttf");
+  font = hb_font_create (face);
+  hb_font_set_scale (font, 2048, 4096);
+  hb_font_set_ppem (font, 17, 19);
+  hb_font_set_ptem (font, 42);
+  advance = hb_font_get_glyph_h_advance (font, 1);
+  g_assert_cmpint (advance, !=, 0);
+
+  snapshot = hb_font_create_snapshot (font);
+  g_assert (snapshot != font);
+  g_assert (hb_font_is_immutable (snapshot));
+  g_assert (!hb_font_is_immutable (font));
+  g_assert (hb_font_get_face (snapshot) == face);
+  g_assert (hb_font_get_parent (snapshot) == hb_font_get_empty ());
+
+  /* Changing the font afterwards leaves the snapshot alone. */
+  hb_font_set_scale (font, 1000, 1000);
+  hb_font_set_ppem (font, 10, 12);
+  hb_font_set_ptem (font, 12);
+
+  hb_font_get_scale (snapshot, &x_scale, &y_scale);
+  g_assert_cmpint (x_scale, ==, 2048);
+  g_assert_cmpint (y_scale, ==, 4096);
+  hb_font_get_ppem (snapshot, &x_ppem, &y_ppem);
+  g_assert_cmpint (x_ppem, ==, 17);
+  g_assert_cmpint (y_ppem, ==, 19);
+  g_assert_cmpint (hb_font_get_ptem (snapshot), ==, 42);
+  g_assert_cmpint (hb_font_get_glyph_h_advance (snapshot, 1), ==, advance);
+
+  /* Snapshotting a snapshot returns it. */
+  subsnapshot = hb_font_create_snapshot (snapshot);
+  g_assert (subsnapshot == snapshot);
+  hb_font_destroy (subsnapshot);
+  hb_font_destroy (snapshot);
+
+  /* The parent is snapshotted along. */
+  subfont = hb_font_create_sub_font (font);
+  subsnapshot = hb_font_create_snapshot (subfont);
+  g_assert (hb_font_is_immutable (subsnapshot));
+  g_assert (hb_font_get_parent (subsnapshot) != font);
+  g_assert (hb_font_is_immutable (hb_font_get_parent (subsnapshot)));
+  g_assert (!hb_font_is_immutable (font));
+  hb_font_get_scale (hb_font_get_parent (subsnapshot), &x_scale, &y_scale);
+  g_assert_cmpint (x_scale, ==, 1000);
+  g_assert_cmpint (y_scale, ==, 1000);
+  hb_font_destroy (subsnapshot);
+  hb_font_destroy (subfont);
+
+  /* Custom font functions get the data of the font, which outlives it
+   * while the snapshot is alive. */
+  ffuncs = hb_font_funcs_create ();
+  hb_font_funcs_set_glyph_h_advance_func (ffuncs, glyph_h_advance_data_func, NULL, NULL);
+  data1 = 8;
+  data2 = 9;
+  hb_font_set_funcs (font, ffuncs, &data1, destroy_advance_data);
+  hb_font_funcs_destroy (ffuncs);
+
+  snapshot = hb_font_create_snapshot (font);
+  g_assert (hb_font_is_immutable (snapshot));
+  g_assert_cmpint (hb_font_get_glyph_h_advance (snapshot, 1), ==, 8);
+
+  hb_font_set_funcs_data (font, &data2, destroy_advance_data);
+  g_assert_cmpint (data1, ==, 8);
+  g_assert_cmpint (hb_font_get_glyph_h_advance (font, 1), ==, 9);
+  g_assert_cmpint (hb_font_get_glyph_h_advance (snapshot, 1), ==, 8);
+
+  hb_font_destroy (font);
+  g_assert_cmpint (data1, ==, 8);
+  g_assert_cmpint (data2, ==, 9);
+  g_assert_cmpint (hb_font_get_glyph_h_advance (snapshot, 1), ==, 8);
+
+  hb_font_destroy (snapshot);
+  g_assert_cmpint (data1, ==, -1);
+  g_assert_cmpint (data2, ==, -1);
+
+  hb_face_destroy (face);
+}
+
 int
 main (int argc, char **argv)
 {
@@ -614,9 +927,12 @@ main (int argc, char **argv)
   hb_test_add (test_fontfuncs_nil);
   hb_test_add (test_fontfuncs_subclassing);
   hb_test_add (test_fontfuncs_parallels);
+  hb_test_add (test_fontfuncs_extents_batch);
+  hb_test_add (test_fontfuncs_v_origins);
 
   hb_test_add (test_font_empty);
   hb_test_add (test_font_properties);
+  hb_test_add (test_font_snapshot);
 
   return hb_test_run();
 }
@@ -0,0 +1,129 @@
+/*
+ * Copyright © 2018  Google, Inc.
+ *
+ *  This is part of HarfBuzz, a text shaping library.
+ *
+ * Permission is hereby granted, without written agreement and without
+ * license or royalty fees, to use, copy, modify, and distribute this
+ * software and its documentation for any purpose, provided that the
+ * above copyright notice and the following two paragraphs appear in
+ * all copies of this software.
+ *
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE TO ANY PARTY FOR
+ * DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES
+ * ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION, EVEN
+ * IF THE COPYRIGHT HOLDER HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * THE COPYRIGHT HOLDER SPECIFICALLY DISCLAIMS ANY WARRANTIES, INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER IS
+ * ON AN "AS IS" BASIS, AND THE COPYRIGHT HOLDER HAS NO OBLIGATION TO
+ * PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+ */
+
+#include "hb-test.h"
+
+#include "hb-ft.h"
+
+/* Unit tests for hb-ft.h */
+
+static FT_Library ft_library;
+
+static hb_font_t *
+create_ft_font (const char *font_path, int load_flags)
+{
+#if GLIB_CHECK_VERSION(2,37,2)
+  gchar *path = g_test_build_filename (G_TEST_DIST, font_path, NULL);
+#else
+  gchar *path = g_strdup (font_path);
+#endif
+  FT_Face ft_face;
+  hb_font_t *font;
+
+  if (FT_New_Face (ft_library, path, 0, &ft_face))
+    g_error ("Font %s not found.", path);
+  g_free (path);
+  if (FT_Set_Char_Size (ft_face, 0, 1000 * 64, 72, 72))
+    abort ();
+
+  font = hb_ft_font_create_referenced (ft_face);
+  hb_ft_font_set_load_flags (font, load_flags);
+  FT_Done_Face (ft_face);
+  return font;
+}
+
+static void
+check_same_metrics (hb_font_t *font, hb_font_t *ot_font, const char *text)
+{
+  for (; *text; text++)
+  {
+    hb_codepoint_t glyph, ot_glyph;
+    g_assert (hb_font_get_nominal_glyph (font, *text, &glyph));
+    g_assert (hb_font_get_nominal_glyph (ot_font, *text, &ot_glyph));
+    g_assert_cmpuint (glyph, ==, ot_glyph);
+    g_assert_cmpint (abs (hb_font_get_glyph_h_advance (font, glyph) -
+			  hb_font_get_glyph_h_advance (ot_font, glyph)), <=, 1);
+    g_assert_cmpint (abs (hb_font_get_glyph_v_advance (font, glyph) -
+			  hb_font_get_glyph_v_advance (ot_font, glyph)), <=, 1);
+  }
+}
+
+static void
+test_ft_ot_metrics (void)
+{
+  hb_font_t *font = create_ft_font ("fonts/Roboto-Regular.abc.ttf", FT_LOAD_NO_HINTING);
+  hb_font_t *ot_font = create_ft_font ("fonts/Roboto-Regular.abc.ttf", FT_LOAD_NO_HINTING);
+  hb_font_t *hinted_font = create_ft_font ("fonts/Roboto-Regular.abc.ttf", FT_LOAD_DEFAULT);
+  hb_font_t *hinted_ot_font = create_ft_font ("fonts/Roboto-Regular.abc.ttf", FT_LOAD_DEFAULT);
+  hb_font_t *ot = hb_font_create (hb_font_get_face (font));
+  hb_codepoint_t glyph;
+
+  g_assert (!hb_ft_font_get_ot_metrics (ot_font));
+  hb_ft_font_set_ot_metrics (ot_font, TRUE);
+  g_assert (hb_ft_font_get_ot_metrics (ot_font));
+  hb_ft_font_set_ot_metrics (hinted_ot_font, TRUE);
+  g_assert (hb_ft_font_get_ot_metrics (hinted_ot_font));
+
+  /* Same glyphs and advances as FreeType, hinted or not. */
+  check_same_metrics (font, ot_font, "abc");
+  check_same_metrics (hinted_font, hinted_ot_font, "abc");
+  g_assert (!hb_font_get_nominal_glyph (ot_font, 'x', &glyph));
+  g_assert (!hb_font_get_variation_glyph (ot_font, 'a', 0xFE00, &glyph));
+
+  hb_ft_font_set_ot_metrics (ot_font, FALSE);
+  g_assert (!hb_ft_font_get_ot_metrics (ot_font));
+  check_same_metrics (font, ot_font, "abc");
+
+  /* Only hb-ft fonts have the setting. */
+  hb_ft_font_set_ot_metrics (ot, TRUE);
+  g_assert (!hb_ft_font_get_ot_metrics (ot));
+  hb_font_make_immutable (font);
+  hb_ft_font_set_ot_metrics (font, TRUE);
+  g_assert (!hb_ft_font_get_ot_metrics (font));
+
+  hb_font_destroy (ot);
+  hb_font_destroy (hinted_ot_font);
+  hb_font_destroy (hinted_font);
+  hb_font_destroy (ot_font);
+  hb_font_destroy (font);
+}
+
+int
+main (int argc, char **argv)
+{
+  int ret;
+
+  if (FT_Init_FreeType (&ft_library))
+    abort ();
+
+  hb_test_init (&argc, &argv);
+
+  hb_test_add (test_ft_ot_metrics);
+
+  ret = hb_test_run ();
+
+  FT_Done_FreeType (ft_library);
+
+  return ret;
+}
@@ -0,0 +1,135 @@
+/*
+ * Copyright © 2018  Google, Inc.
+ *
+ *  This is part of HarfBuzz, a text shaping library.
+ *
+ * Permission is hereby granted, without written agreement and without
+ * license or royalty fees, to use, copy, modify, and distribute this
+ * software and its documentation for any purpose, provided that the
+ * above copyright notice and the following two paragraphs appear in
+ * all copies of this software.
+ *
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE TO ANY PARTY FOR
+ * DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES
+ * ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION, EVEN
+ * IF THE COPYRIGHT HOLDER HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * THE COPYRIGHT HOLDER SPECIFICALLY DISCLAIMS ANY WARRANTIES, INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER IS
+ * ON AN "AS IS" BASIS, AND THE COPYRIGHT HOLDER HAS NO OBLIGATION TO
+ * PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+ *
+ */
+
+#include <pthread.h>
+
+#include "hb-test.h"
+
+/* Unit tests for user data get/set racing across threads */
+
+#define NUM_KEYS 64
+
+static int num_threads = 8;
+static int num_iters = 2000;
+
+static hb_font_t *font;
+static hb_user_data_key_t keys[NUM_KEYS];
+static int values[2][NUM_KEYS];
+
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void *
+reader_func (void *data)
+{
+  int i, k;
+
+  pthread_mutex_lock (&mutex);
+  pthread_mutex_unlock (&mutex);
+
+  for (i = 0; i < num_iters; i++)
+    for (k = 0; k < NUM_KEYS; k++)
+    {
+      int *v = (int *) hb_font_get_user_data (font, &keys[k]);
+      /* Whatever the writer is up to, a key is either unset or holds one
+       * of the two values it was ever given, fully written. */
+      if (v && v != &values[0][k] && v != &values[1][k])
+      {
+	fprintf (stderr, "Key %d returned a pointer it was never set to.\n", k);
+	exit (1);
+      }
+      if (v && *v != k)
+      {
+	fprintf (stderr, "Key %d returned %d.\n", k, *v);
+	exit (1);
+      }
+    }
+
+  return 0;
+}
+
+static void *
+writer_func (void *data)
+{
+  int i, k;
+
+  pthread_mutex_lock (&mutex);
+  pthread_mutex_unlock (&mutex);
+
+  /* The first round adds keys one by one, growing the table under the
+   * readers; later rounds replace and remove set keys in place. */
+  for (i = 0; i < num_iters; i++)
+    for (k = 0; k < NUM_KEYS; k++)
+    {
+      void *v = (i % 3 == 2) ? NULL : &values[i & 1][k];
+      if (!hb_font_set_user_data (font, &keys[k], v, NULL, TRUE))
+      {
+	fprintf (stderr, "Setting key %d failed.\n", k);
+	exit (1);
+      }
+    }
+
+  return 0;
+}
+
+static void
+test_user_data_multithread (void)
+{
+  int i, k;
+  pthread_t *threads = calloc (num_threads + 1, sizeof (pthread_t));
+
+  for (k = 0; k < NUM_KEYS; k++)
+    values[0][k] = values[1][k] = k;
+
+  font = hb_font_create (hb_face_get_empty ());
+
+  pthread_mutex_lock (&mutex);
+
+  pthread_create (&threads[0], NULL, writer_func, NULL);
+  for (i = 1; i <= num_threads; i++)
+    pthread_create (&threads[i], NULL, reader_func, NULL);
+
+  /* Let them loose! */
+  pthread_mutex_unlock (&mutex);
+
+  for (i = 0; i <= num_threads; i++)
+    pthread_join (threads[i], NULL);
+
+  /* The writer's last round, num_iters - 1, left the keys set. */
+  for (k = 0; k < NUM_KEYS; k++)
+    g_assert (hb_font_get_user_data (font, &keys[k]) == &values[(num_iters - 1) & 1][k]);
+
+  hb_font_destroy (font);
+  free (threads);
+}
+
+int
+main (int argc, char **argv)
+{
+  hb_test_init (&argc, &argv);
+
+  hb_test_add (test_user_data_multithread);
+
+  return hb_test_run ();
+}
@@ -297,6 +297,53 @@ test_hb_ot_color_palette_get_colors_v1 (void)
 }
 
 
+static void
+test_hb_ot_color_palette_get_color_array (void)
+{
+  /* CPAL v0 with one palette of one half-transparent color. */
+  static const char cpal_data[] = {
+    0, 0, 0, 1, 0, 1, 0, 1,	/* Version, entries, palettes, records. */
+    0, 0, 0, 14, 0, 0,		/* Records offset, first palette index. */
+    0x40, (char) 0x80, (char) 0xFF, (char) 0x80,	/* BGRA. */
+  };
+  hb_color_t colors[2];
+  hb_face_t *face = hb_face_builder_create ();
+  hb_blob_t *blob = hb_blob_create (cpal_data, sizeof (cpal_data), HB_MEMORY_MODE_READONLY, NULL, NULL);
+  const uint32_t *array;
+  unsigned int count;
+
+  /* Same colors as hb_ot_color_palette_get_colors(), kept with the face. */
+  array = hb_ot_color_palette_get_color_array (cpal_v1, 1, HB_OT_COLOR_PALETTE_FORMAT_BGRA, &count);
+  g_assert_cmpint (count, ==, 2);
+  g_assert_cmpint (hb_ot_color_palette_get_colors (cpal_v1, 1, 0, &count, colors), ==, 2);
+  g_assert (memcmp (array, colors, sizeof (colors)) == 0);
+  g_assert (array == hb_ot_color_palette_get_color_array (cpal_v1, 1, HB_OT_COLOR_PALETTE_FORMAT_BGRA, NULL));
+
+  array = hb_ot_color_palette_get_color_array (cpal_v1, 1, HB_OT_COLOR_PALETTE_FORMAT_RGBA_PREMULTIPLIED, &count);
+  g_assert_cmpint (count, ==, 2);
+  g_assert_cmphex (array[0], ==, 0x000000FFu);
+  g_assert_cmphex (array[1], ==, 0xFFCC66FFu);
+
+  count = 1;
+  g_assert (!hb_ot_color_palette_get_color_array (cpal_v1, 3, HB_OT_COLOR_PALETTE_FORMAT_BGRA, &count));
+  g_assert_cmpint (count, ==, 0);
+  g_assert (!hb_ot_color_palette_get_color_array (empty, 0, HB_OT_COLOR_PALETTE_FORMAT_BGRA, &count));
+  g_assert_cmpint (count, ==, 0);
+
+  /* Color channels are multiplied by alpha, rounded. */
+  hb_face_builder_add_table (face, HB_TAG ('C','P','A','L'), blob);
+  array = hb_ot_color_palette_get_color_array (face, 0, HB_OT_COLOR_PALETTE_FORMAT_BGRA, &count);
+  g_assert_cmpint (count, ==, 1);
+  assert_color_rgba (array, 0, 0xFF, 0x80, 0x40, 0x80);
+  array = hb_ot_color_palette_get_color_array (face, 0, HB_OT_COLOR_PALETTE_FORMAT_RGBA_PREMULTIPLIED, &count);
+  g_assert_cmpint (count, ==, 1);
+  g_assert_cmphex (array[0], ==, 0x80402080u);
+
+  hb_blob_destroy (blob);
+  hb_face_destroy (face);
+}
+
+
 static void
 test_hb_ot_color_palette_color_get_name_id (void)
 {
@@ -400,6 +447,70 @@ test_hb_ot_color_svg (void)
 }
 
 
+static void
+check_svg_document (hb_face_t *face, hb_codepoint_t glyph,
+		    unsigned int expected_index, const char *expected_data,
+		    unsigned int expected_length)
+{
+  hb_blob_t *blob = hb_ot_color_glyph_reference_svg (face, glyph);
+  unsigned int index = 1234, length;
+  const char *data;
+
+  g_assert (hb_ot_color_glyph_get_svg_document (face, glyph, &index, &data, &length) == (expected_length != 0));
+  g_assert_cmpuint (length, ==, expected_length);
+  g_assert_cmpuint (hb_blob_get_length (blob), ==, expected_length);
+  if (expected_length)
+  {
+    g_assert_cmpuint (index, ==, expected_index);
+    g_assert (memcmp (data, hb_blob_get_data (blob, NULL), length) == 0);
+    if (expected_data)
+      g_assert (memcmp (data, expected_data, length) == 0);
+  }
+  hb_blob_destroy (blob);
+}
+
+static void
+test_hb_ot_color_svg_document (void)
+{
+  /* Four entries; the third repeats the first's document, the fourth
+   * covers only part of it. */
+  static const char svg_data[] = {
+    0, 0, 0, 0, 0, 10, 0, 0, 0, 0,	/* Version, document list offset. */
+    0, 4,
+    0, 1, 0, 2, 0, 0, 0, 50, 0, 0, 0, 5,
+    0, 3, 0, 3, 0, 0, 0, 55, 0, 0, 0, 5,
+    0, 5, 0, 6, 0, 0, 0, 50, 0, 0, 0, 5,
+    0, 7, 0, 7, 0, 0, 0, 50, 0, 0, 0, 3,
+    '<', 's', 'v', 'g', '>', '<', 's', 'v', 'G', '>',
+  };
+  hb_face_t *face = hb_face_builder_create ();
+  hb_blob_t *blob = hb_blob_create (svg_data, sizeof (svg_data), HB_MEMORY_MODE_READONLY, NULL, NULL);
+  const char *data;
+
+  check_svg_document (svg, 0, 0, NULL, 0);
+  check_svg_document (svg, 1, 0, NULL, 146);
+  check_svg_document (empty, 1, 0, NULL, 0);
+
+  hb_face_builder_add_table (face, HB_TAG ('S','V','G',' '), blob);
+  check_svg_document (face, 0, 0, NULL, 0);
+  check_svg_document (face, 1, 0, "<svg>", 5);
+  check_svg_document (face, 2, 0, "<svg>", 5);
+  check_svg_document (face, 3, 1, "<svG>", 5);
+  check_svg_document (face, 4, 0, NULL, 0);
+  check_svg_document (face, 5, 0, "<svg>", 5);
+  check_svg_document (face, 6, 0, "<svg>", 5);
+  check_svg_document (face, 7, 3, "<sv", 3);
+  check_svg_document (face, 8, 0, NULL, 0);
+
+  /* All outputs are optional. */
+  g_assert (hb_ot_color_glyph_get_svg_document (face, 3, NULL, NULL, NULL));
+  g_assert (hb_ot_color_glyph_get_svg_document (face, 3, NULL, &data, NULL));
+  g_assert (memcmp (data, "<svG>", 5) == 0);
+
+  hb_blob_destroy (blob);
+  hb_face_destroy (face);
+}
+
 static void
 test_hb_ot_color_png (void)
 {
@@ -450,6 +561,104 @@ test_hb_ot_color_png (void)
   hb_font_destroy (cbdt_font);
 }
 
+static void
+check_png_data (hb_font_t *font, hb_codepoint_t glyph, unsigned int expected_length)
+{
+  hb_blob_t *blob = hb_ot_color_glyph_reference_png (font, glyph);
+  const char *data;
+  unsigned int length;
+
+  g_assert (hb_ot_color_glyph_get_png_data (font, glyph, &data, &length) == (expected_length != 0));
+  g_assert_cmpuint (length, ==, expected_length);
+  g_assert_cmpuint (hb_blob_get_length (blob), ==, expected_length);
+  if (expected_length)
+    g_assert (memcmp (data, hb_blob_get_data (blob, NULL), length) == 0);
+  else
+    g_assert (!data);
+  hb_blob_destroy (blob);
+}
+
+static void
+test_hb_ot_color_png_data (void)
+{
+  hb_font_t *sbix_font = hb_font_create (sbix);
+  hb_font_t *cbdt_font = hb_font_create (cbdt);
+  hb_font_t *svg_font = hb_font_create (svg);
+  hb_font_t *empty_font = hb_font_create (empty);
+
+  check_png_data (sbix_font, 0, 0);
+  check_png_data (sbix_font, 1, 224);
+  check_png_data (cbdt_font, 0, 0);
+  check_png_data (cbdt_font, 1, 88);
+
+  /* The strike chosen for a ppem is cached; changing it looks again. */
+  hb_font_set_ppem (sbix_font, 20, 20);
+  hb_font_set_ppem (cbdt_font, 20, 20);
+  check_png_data (sbix_font, 1, 224);
+  check_png_data (cbdt_font, 1, 88);
+  hb_font_set_ppem (sbix_font, 300, 300);
+  hb_font_set_ppem (cbdt_font, 300, 300);
+  check_png_data (sbix_font, 1, 224);
+  check_png_data (cbdt_font, 1, 88);
+
+  check_png_data (svg_font, 1, 0);
+  check_png_data (empty_font, 1, 0);
+
+  hb_font_destroy (empty_font);
+  hb_font_destroy (svg_font);
+  hb_font_destroy (cbdt_font);
+  hb_font_destroy (sbix_font);
+}
+
+static void
+check_glyph_formats (hb_face_t *face, const hb_ot_color_glyph_format_t *expected)
+{
+  hb_font_t *font = hb_font_create (face);
+  struct { hb_codepoint_t glyph; unsigned int cluster; } glyphs[4] = {{0, 0}, {1, 1}, {2, 2}, {3, 3}};
+  struct { hb_ot_color_glyph_format_t format; unsigned int padding; } formats[4];
+  unsigned int expected_count = 0;
+  unsigned int i;
+
+  for (i = 0; i < 4; i++)
+    if (expected[i])
+      expected_count++;
+
+  g_assert_cmpuint (hb_ot_color_glyphs_get_formats (font, 4,
+						    &glyphs[0].glyph, sizeof (glyphs[0]),
+						    &formats[0].format, sizeof (formats[0])), ==, expected_count);
+  for (i = 0; i < 4; i++)
+  {
+    hb_blob_t *blob = hb_ot_color_glyph_reference_svg (face, glyphs[i].glyph);
+    const char *data;
+    unsigned int length;
+    g_assert_cmphex (formats[i].format, ==, expected[i]);
+    g_assert (!!(formats[i].format & HB_OT_COLOR_GLYPH_FORMAT_LAYERS) ==
+	      !!hb_ot_color_glyph_get_layers (face, glyphs[i].glyph, 0, NULL, NULL));
+    g_assert (!!(formats[i].format & HB_OT_COLOR_GLYPH_FORMAT_PNG) ==
+	      !!hb_ot_color_glyph_get_png_data (font, glyphs[i].glyph, &data, &length));
+    g_assert (!!(formats[i].format & HB_OT_COLOR_GLYPH_FORMAT_SVG) ==
+	      !!hb_blob_get_length (blob));
+    hb_blob_destroy (blob);
+  }
+
+  hb_font_destroy (font);
+}
+
+static void
+test_hb_ot_color_glyphs_get_formats (void)
+{
+  static const hb_ot_color_glyph_format_t none[4] = {0};
+  static const hb_ot_color_glyph_format_t layers[4] = {0, 0, HB_OT_COLOR_GLYPH_FORMAT_LAYERS, 0};
+  static const hb_ot_color_glyph_format_t png[4] = {0, HB_OT_COLOR_GLYPH_FORMAT_PNG, 0, 0};
+  static const hb_ot_color_glyph_format_t svg_only[4] = {0, HB_OT_COLOR_GLYPH_FORMAT_SVG, 0, 0};
+
+  check_glyph_formats (cpal_v1, layers);
+  check_glyph_formats (sbix, png);
+  check_glyph_formats (cbdt, png);
+  check_glyph_formats (svg, svg_only);
+  check_glyph_formats (empty, none);
+}
+
 int
 main (int argc, char **argv)
 {
@@ -473,11 +682,15 @@ main (int argc, char **argv)
   hb_test_add (test_hb_ot_color_palette_get_colors_empty);
   hb_test_add (test_hb_ot_color_palette_get_colors_v0);
   hb_test_add (test_hb_ot_color_palette_get_colors_v1);
+  hb_test_add (test_hb_ot_color_palette_get_color_array);
   hb_test_add (test_hb_ot_color_palette_color_get_name_id);
   hb_test_add (test_hb_ot_color_glyph_get_layers);
   hb_test_add (test_hb_ot_color_has_data);
   hb_test_add (test_hb_ot_color_png);
+  hb_test_add (test_hb_ot_color_png_data);
+  hb_test_add (test_hb_ot_color_glyphs_get_formats);
   hb_test_add (test_hb_ot_color_svg);
+  hb_test_add (test_hb_ot_color_svg_document);
   status = hb_test_run();
   hb_face_destroy (cpal_v0);
   hb_face_destroy (cpal_v1);
@@ -184,6 +184,55 @@ test_extents_cff2_vsindex (void)
   hb_font_destroy (font);
 }
 
+static void
+test_extents_cff2_caching (void)
+{
+  hb_face_t *face = hb_test_open_font_file ("fonts/AdobeVFPrototype.abc.otf");
+  g_assert (face);
+  hb_font_t *font = hb_font_create (face);
+  hb_face_destroy (face);
+  g_assert (font);
+  hb_ot_font_set_funcs (font);
+  hb_ot_font_set_glyph_extents_caching (font, TRUE);
+
+  /* Twice each, the second time from the cache; new coordinates must not
+   * see extents cached at the old ones. */
+  hb_glyph_extents_t  extents;
+  float coords[2] = { 600.0f, 50.0f };
+  for (unsigned int i = 0; i < 2; i++)
+  {
+    hb_font_set_var_coords_design (font, NULL, 0);
+    for (unsigned int j = 0; j < 2; j++)
+    {
+      g_assert (hb_font_get_glyph_extents (font, 1, &extents));
+      g_assert_cmpint (extents.x_bearing, ==, 46);
+      g_assert_cmpint (extents.y_bearing, ==, 487);
+      g_assert_cmpint (extents.width, ==, 455);
+      g_assert_cmpint (extents.height, ==, -500);
+    }
+
+    hb_font_set_var_coords_design (font, coords, 2);
+    for (unsigned int j = 0; j < 2; j++)
+    {
+      g_assert (hb_font_get_glyph_extents (font, 1, &extents));
+      g_assert_cmpint (extents.x_bearing, ==, 38);
+      g_assert_cmpint (extents.y_bearing, ==, 493);
+      g_assert_cmpint (extents.width, ==, 481);
+      g_assert_cmpint (extents.height, ==, -508);
+    }
+  }
+
+  /* Nor a new scale. */
+  hb_font_set_scale (font, 2000, 2000);
+  g_assert (hb_font_get_glyph_extents (font, 1, &extents));
+  g_assert_cmpint (extents.x_bearing, ==, 76);
+  g_assert_cmpint (extents.y_bearing, ==, 986);
+  g_assert_cmpint (extents.width, ==, 962);
+  g_assert_cmpint (extents.height, ==, -1016);
+
+  hb_font_destroy (font);
+}
+
 int
 main (int argc, char **argv)
 {
@@ -194,6 +243,7 @@ main (int argc, char **argv)
   hb_test_add (test_extents_cff1_seac);
   hb_test_add (test_extents_cff2);
   hb_test_add (test_extents_cff2_vsindex);
+  hb_test_add (test_extents_cff2_caching);
 
   return hb_test_run ();
 }
@@ -45,6 +45,8 @@ test_face (hb_face_t *face,
   hb_glyph_extents_t extents;
   hb_ot_font_set_funcs (font);
 
+  hb_face_prewarm (face, HB_FACE_PREWARM_ALL);
+
   set = hb_set_create ();
   hb_face_collect_unicodes (face, set);
   hb_face_collect_variation_selectors (face, set);
@@ -110,12 +112,122 @@ test_ot_face_empty (void)
   test_face (hb_face_get_empty (), 0);
 }
 
+static void
+check_same_results (hb_face_t *expected_face, hb_face_t *face, const char *text)
+{
+  hb_font_t *expected_font = hb_font_create (expected_face);
+  hb_font_t *font = hb_font_create (face);
+  hb_buffer_t *expected = hb_buffer_create ();
+  hb_buffer_t *buffer = hb_buffer_create ();
+  hb_codepoint_t g;
+  char name[64], expected_name[64];
+  unsigned int len, i;
+
+  hb_buffer_add_utf8 (expected, text, -1, 0, -1);
+  hb_buffer_guess_segment_properties (expected);
+  hb_buffer_add_utf8 (buffer, text, -1, 0, -1);
+  hb_buffer_guess_segment_properties (buffer);
+  hb_shape (expected_font, expected, NULL, 0);
+  hb_shape (font, buffer, NULL, 0);
+  g_assert_cmpint (hb_buffer_diff (buffer, expected, (hb_codepoint_t) -1, 0), ==, HB_BUFFER_DIFF_FLAG_EQUAL);
+
+  len = hb_face_get_glyph_count (face);
+  for (i = 0; i < len; i++)
+  {
+    hb_bool_t has_name = hb_font_get_glyph_name (expected_font, i, expected_name, sizeof (expected_name));
+    g_assert (hb_font_get_glyph_name (font, i, name, sizeof (name)) == has_name);
+    if (!has_name)
+      continue;
+    g_assert_cmpstr (name, ==, expected_name);
+    g_assert (hb_font_get_glyph_from_name (font, name, -1, &g));
+    g_assert_cmpint (g, ==, i);
+  }
+
+  hb_buffer_destroy (buffer);
+  hb_buffer_destroy (expected);
+  hb_font_destroy (font);
+  hb_font_destroy (expected_font);
+}
+
+static void
+test_ot_face_accelerators (void)
+{
+  static const struct {
+    const char *font;
+    const char *other_font;
+    const char *text;
+  } tests[] = {
+    {"fonts/Roboto-Regular.gsub.fi.ttf", "fonts/Roboto-Regular.gsub.fil.ttf", "fifi"},
+    {"fonts/cpal-v0.ttf", "fonts/aat-morx.ttf", "ABC"},
+  };
+  unsigned int i;
+
+  for (i = 0; i < G_N_ELEMENTS (tests); i++)
+  {
+    hb_face_t *face = hb_test_open_font_file (tests[i].font);
+    hb_face_t *attached = hb_test_open_font_file (tests[i].font);
+    hb_face_t *other = hb_test_open_font_file (tests[i].other_font);
+    hb_blob_t *blob = hb_face_serialize_accelerators (face);
+    unsigned int length = hb_blob_get_length (blob);
+    unsigned int j;
+
+    g_assert_cmpint (length, >, 0);
+
+    /* Sections are padded to eight bytes; cut into any, they do not attach. */
+    for (j = 0; j < length; j += 8)
+    {
+      hb_blob_t *truncated = hb_blob_create_sub_blob (blob, 0, j);
+      g_assert (!hb_face_attach_accelerators (attached, truncated));
+      hb_blob_destroy (truncated);
+    }
+    g_assert (!hb_face_attach_accelerators (other, blob));
+    g_assert (!hb_face_attach_accelerators (hb_face_get_empty (), blob));
+
+    g_assert (hb_face_attach_accelerators (attached, blob));
+    g_assert (!hb_face_attach_accelerators (attached, blob));
+    check_same_results (face, attached, tests[i].text);
+
+    hb_blob_destroy (blob);
+    hb_face_destroy (other);
+    hb_face_destroy (attached);
+    hb_face_destroy (face);
+  }
+}
+
+static void
+test_ot_face_trim (void)
+{
+  hb_face_t *face = hb_test_open_font_file ("fonts/Roboto-Regular.gsub.fi.ttf");
+  hb_face_t *expected = hb_test_open_font_file ("fonts/Roboto-Regular.gsub.fi.ttf");
+  unsigned int loaded, trimmed;
+
+  check_same_results (expected, face, "fifi");
+  loaded = hb_face_get_memory_usage (face, 0, NULL, NULL);
+
+  /* Unloaded, and loaded again on use. */
+  hb_face_trim (face, HB_FACE_PREWARM_ALL);
+  trimmed = hb_face_get_memory_usage (face, 0, NULL, NULL);
+  g_assert_cmpint (trimmed, <, loaded);
+  check_same_results (expected, face, "fifi");
+  g_assert_cmpint (hb_face_get_memory_usage (face, 0, NULL, NULL), >, trimmed);
+
+  hb_face_trim (face, HB_FACE_PREWARM_LAYOUT);
+  check_same_results (expected, face, "fifi");
+
+  hb_face_trim (hb_face_get_empty (), HB_FACE_PREWARM_ALL);
+
+  hb_face_destroy (expected);
+  hb_face_destroy (face);
+}
+
 int
 main (int argc, char **argv)
 {
   hb_test_init (&argc, &argv);
 
   hb_test_add (test_ot_face_empty);
+  hb_test_add (test_ot_face_accelerators);
+  hb_test_add (test_ot_face_trim);
 
   return hb_test_run();
 }
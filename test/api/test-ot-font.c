@@ -0,0 +1,267 @@
+/*
+ * Copyright © 2018  Google, Inc.
+ *
+ *  This is part of HarfBuzz, a text shaping library.
+ *
+ * Permission is hereby granted, without written agreement and without
+ * license or royalty fees, to use, copy, modify, and distribute this
+ * software and its documentation for any purpose, provided that the
+ * above copyright notice and the following two paragraphs appear in
+ * all copies of this software.
+ *
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE TO ANY PARTY FOR
+ * DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES
+ * ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION, EVEN
+ * IF THE COPYRIGHT HOLDER HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * THE COPYRIGHT HOLDER SPECIFICALLY DISCLAIMS ANY WARRANTIES, INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER IS
+ * ON AN "AS IS" BASIS, AND THE COPYRIGHT HOLDER HAS NO OBLIGATION TO
+ * PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+ */
+
+#include "hb-test.h"
+
+#include <hb-ot.h>
+
+/* Unit tests for hb-ot-font.h */
+
+static void
+test_ot_font_get_metrics (void)
+{
+  hb_face_t *face = hb_test_open_font_file ("fonts/Roboto-Regular.abc.ttf");
+  hb_font_t *font = hb_font_create (face);
+  hb_font_t *subfont;
+  hb_ot_font_metrics_t metrics;
+  hb_font_extents_t extents;
+
+  hb_ot_font_get_metrics (font, &metrics);
+  g_assert_cmpint (metrics.ascender, ==, 1900);
+  g_assert_cmpint (metrics.descender, ==, -500);
+  g_assert_cmpint (metrics.line_gap, ==, 0);
+  g_assert_cmpint (metrics.vertical_ascender, ==, 0);
+  g_assert_cmpint (metrics.vertical_descender, ==, 0);
+  g_assert_cmpint (metrics.vertical_line_gap, ==, 0);
+  g_assert_cmpint (metrics.x_height, ==, 1082);
+  g_assert_cmpint (metrics.cap_height, ==, 1456);
+  g_assert_cmpint (metrics.underline_size, ==, 100);
+  g_assert_cmpint (metrics.underline_offset, ==, -150);
+  g_assert_cmpint (metrics.strikeout_size, ==, 102);
+  g_assert_cmpint (metrics.strikeout_offset, ==, 512);
+
+  /* Metrics are scaled, and agree with the font extents. */
+  hb_font_set_scale (font, 2048 * 2, 2048 * 3);
+  hb_ot_font_get_metrics (font, &metrics);
+  hb_font_get_h_extents (font, &extents);
+  g_assert_cmpint (metrics.ascender, ==, 5700);
+  g_assert_cmpint (metrics.ascender, ==, extents.ascender);
+  g_assert_cmpint (metrics.descender, ==, -1500);
+  g_assert_cmpint (metrics.descender, ==, extents.descender);
+  g_assert_cmpint (metrics.x_height, ==, 3246);
+  g_assert_cmpint (metrics.strikeout_offset, ==, 1536);
+
+  /* They come from the face whatever the font functions. */
+  subfont = hb_font_create_sub_font (font);
+  hb_font_set_scale (subfont, 2048, 2048);
+  hb_ot_font_get_metrics (subfont, &metrics);
+  g_assert_cmpint (metrics.ascender, ==, 1900);
+  g_assert_cmpint (metrics.cap_height, ==, 1456);
+  hb_font_destroy (subfont);
+
+  hb_ot_font_get_metrics (hb_font_get_empty (), &metrics);
+  g_assert_cmpint (metrics.ascender, ==, 0);
+  g_assert_cmpint (metrics.x_height, ==, 0);
+  g_assert_cmpint (metrics.strikeout_offset, ==, 0);
+
+  hb_font_destroy (font);
+  hb_face_destroy (face);
+}
+
+static void
+test_ot_font_get_metrics_variations (void)
+{
+  hb_face_t *face = hb_test_open_font_file ("fonts/AdobeVFPrototype.abc.otf");
+  hb_font_t *font = hb_font_create (face);
+  hb_variation_t weight = {HB_OT_TAG_VAR_AXIS_WEIGHT, 900};
+  hb_ot_font_metrics_t metrics;
+
+  hb_ot_font_get_metrics (font, &metrics);
+  g_assert_cmpint (metrics.ascender, ==, 918);
+  g_assert_cmpint (metrics.x_height, ==, 474);
+  g_assert_cmpint (metrics.strikeout_offset, ==, 284);
+
+  /* MVAR deltas apply at the font's coordinates. */
+  hb_font_set_variations (font, &weight, 1);
+  hb_ot_font_get_metrics (font, &metrics);
+  g_assert_cmpint (metrics.ascender, ==, 918);
+  g_assert_cmpint (metrics.x_height, ==, 487);
+  g_assert_cmpint (metrics.cap_height, ==, 670);
+  g_assert_cmpint (metrics.strikeout_offset, ==, 292);
+
+  hb_font_set_var_coords_normalized (font, NULL, 0);
+  hb_ot_font_get_metrics (font, &metrics);
+  g_assert_cmpint (metrics.x_height, ==, 474);
+  g_assert_cmpint (metrics.strikeout_offset, ==, 284);
+
+  hb_font_destroy (font);
+  hb_face_destroy (face);
+}
+
+static void
+check_h_advances (hb_font_t *font, const hb_position_t *expected)
+{
+  hb_codepoint_t glyphs[4] = {0, 1, 2, 3};
+  hb_position_t advances[4];
+  unsigned int i;
+
+  hb_font_get_glyph_h_advances (font, 4, glyphs, sizeof (glyphs[0]), advances, sizeof (advances[0]));
+  for (i = 0; i < 4; i++)
+  {
+    g_assert_cmpint (hb_font_get_glyph_h_advance (font, glyphs[i]), ==, expected[i]);
+    g_assert_cmpint (advances[i], ==, expected[i]);
+  }
+}
+
+static void
+test_ot_font_hinted_advances (void)
+{
+  static const hb_position_t hmtx_advances[4] = {908, 1114, 1149, 1072};
+  static const hb_position_t ppem9_advances[4] = {910, 1138, 1138, 1138};
+  static const hb_position_t ppem10_advances[4] = {819, 1024, 1024, 1024};
+  static const hb_position_t small_advances[4] = {400, 500, 500, 500};
+  hb_face_t *face = hb_test_open_font_file ("fonts/Roboto-Regular.multihdmx.abc.ttf");
+  hb_font_t *font = hb_font_create (face);
+  hb_font_t *subfont;
+  hb_buffer_t *buffer;
+  hb_glyph_position_t *positions;
+  unsigned int len, i;
+
+  /* Off by default. */
+  hb_font_set_ppem (font, 9, 9);
+  check_h_advances (font, hmtx_advances);
+
+  /* The hdmx widths, in pixels, are scaled to the font scale. */
+  hb_ot_font_set_hinted_advances (font, TRUE);
+  check_h_advances (font, ppem9_advances);
+  hb_font_set_ppem (font, 10, 10);
+  check_h_advances (font, ppem10_advances);
+  hb_font_set_scale (font, 900, 900);
+  hb_font_set_ppem (font, 9, 9);
+  check_h_advances (font, small_advances);
+  hb_font_set_scale (font, 2048, 2048);
+
+  /* Shaping picks them up. */
+  hb_font_set_ppem (font, 10, 10);
+  buffer = hb_buffer_create ();
+  hb_buffer_add_utf8 (buffer, "abc", -1, 0, -1);
+  hb_buffer_guess_segment_properties (buffer);
+  hb_shape (font, buffer, NULL, 0);
+  positions = hb_buffer_get_glyph_positions (buffer, &len);
+  g_assert_cmpuint (len, ==, 3);
+  for (i = 0; i < len; i++)
+    g_assert_cmpint (positions[i].x_advance, ==, 1024);
+  hb_buffer_destroy (buffer);
+
+  /* Without a device record, or where gasp asks for no grid-fitting,
+   * there is nothing to hint with. */
+  hb_font_set_ppem (font, 11, 11);
+  check_h_advances (font, hmtx_advances);
+  hb_font_set_ppem (font, 8, 8);
+  check_h_advances (font, hmtx_advances);
+  hb_font_set_ppem (font, 0, 0);
+  check_h_advances (font, hmtx_advances);
+
+  /* Only fonts using the OpenType font functions are affected. */
+  subfont = hb_font_create_sub_font (font);
+  hb_font_set_ppem (font, 9, 9);
+  hb_font_set_ppem (subfont, 10, 10);
+  hb_ot_font_set_hinted_advances (subfont, FALSE);
+  check_h_advances (subfont, ppem9_advances);
+  hb_font_destroy (subfont);
+
+  hb_ot_font_set_hinted_advances (font, FALSE);
+  check_h_advances (font, hmtx_advances);
+
+  hb_font_destroy (font);
+  hb_face_destroy (face);
+}
+
+static void
+shape_glyphs (hb_font_t *font, const hb_codepoint_t *text, unsigned int len,
+	      hb_codepoint_t *glyphs)
+{
+  hb_buffer_t *buffer = hb_buffer_create ();
+  hb_glyph_info_t *infos;
+  unsigned int i;
+
+  hb_buffer_add_utf32 (buffer, text, len, 0, len);
+  hb_buffer_guess_segment_properties (buffer);
+  hb_shape (font, buffer, NULL, 0);
+  infos = hb_buffer_get_glyph_infos (buffer, &i);
+  g_assert_cmpuint (i, ==, len);
+  for (i = 0; i < len; i++)
+    glyphs[i] = infos[i].codepoint;
+  hb_buffer_destroy (buffer);
+}
+
+static void
+test_ot_font_cmap_caching (void)
+{
+  static const hb_codepoint_t text[4] = {0x4C2E, 0x3041, 0x4C2E, 0x41};
+  hb_face_t *face = hb_test_open_font_file ("fonts/SourceHanSans-Regular.41,3041,4C2E.otf");
+  hb_font_t *font = hb_font_create (face);
+  hb_codepoint_t expected[4], glyphs[4], glyph;
+  unsigned int i, j;
+
+  /* Off by default; the mappings to compare against. */
+  for (i = 0; i < 4; i++)
+    g_assert (hb_font_get_nominal_glyph (font, text[i], &expected[i]));
+  g_assert_cmpuint (expected[0], !=, 0);
+  g_assert_cmpuint (expected[1], !=, expected[0]);
+
+  hb_ot_font_set_cmap_caching (font, TRUE);
+
+  /* The second round comes from the cache.  Characters missing from the
+   * font must stay missing. */
+  for (j = 0; j < 2; j++)
+  {
+    for (i = 0; i < 4; i++)
+    {
+      glyph = 0;
+      g_assert (hb_font_get_nominal_glyph (font, text[i], &glyph));
+      g_assert_cmpuint (glyph, ==, expected[i]);
+    }
+    g_assert (!hb_font_get_nominal_glyph (font, 0x42, &glyph));
+
+    /* Shaping goes through the batch callback. */
+    shape_glyphs (font, text, 4, glyphs);
+    for (i = 0; i < 4; i++)
+      g_assert_cmpuint (glyphs[i], ==, expected[i]);
+  }
+
+  hb_ot_font_set_cmap_caching (font, FALSE);
+  for (i = 0; i < 4; i++)
+  {
+    glyph = 0;
+    g_assert (hb_font_get_nominal_glyph (font, text[i], &glyph));
+    g_assert_cmpuint (glyph, ==, expected[i]);
+  }
+
+  hb_font_destroy (font);
+  hb_face_destroy (face);
+}
+
+int
+main (int argc, char **argv)
+{
+  hb_test_init (&argc, &argv);
+
+  hb_test_add (test_ot_font_get_metrics);
+  hb_test_add (test_ot_font_get_metrics_variations);
+  hb_test_add (test_ot_font_hinted_advances);
+  hb_test_add (test_ot_font_cmap_caching);
+
+  return hb_test_run ();
+}
@@ -56,12 +56,74 @@ test_ot_layout_feature_get_name_ids_and_characters (void)
   hb_face_destroy (face);
 }
 
+static void
+test_ot_layout_get_ligature_carets_for_glyphs (void)
+{
+  hb_face_t *face = hb_test_open_font_file ("fonts/lcar.ttf");
+  hb_font_t *font = hb_font_create (face);
+  hb_glyph_info_t infos[3];
+  hb_codepoint_t glyphs[3] = {98, 1, 98};
+  unsigned int caret_starts[4];
+  hb_position_t caret_array[4];
+  unsigned int i;
+
+  hb_font_set_scale (font, hb_face_get_upem (face) * 2, hb_face_get_upem (face) * 4);
+
+  g_assert_cmpuint (4, ==, hb_ot_layout_get_ligature_carets_for_glyphs (font, HB_DIRECTION_RTL,
+									3, glyphs, sizeof (glyphs[0]),
+									caret_starts,
+									4, caret_array));
+  g_assert_cmpuint (0, ==, caret_starts[0]);
+  g_assert_cmpuint (2, ==, caret_starts[1]);
+  g_assert_cmpuint (2, ==, caret_starts[2]);
+  g_assert_cmpuint (4, ==, caret_starts[3]);
+  g_assert_cmpint (1130, ==, caret_array[0]);
+  g_assert_cmpint (2344, ==, caret_array[1]);
+  g_assert_cmpint (1130, ==, caret_array[2]);
+  g_assert_cmpint (2344, ==, caret_array[3]);
+
+  /* Glyphs can come from glyph infos; carets past the array are counted. */
+  memset (infos, 0, sizeof (infos));
+  for (i = 0; i < 3; i++)
+    infos[i].codepoint = glyphs[i];
+  memset (caret_array, 0, sizeof (caret_array));
+  g_assert_cmpuint (4, ==, hb_ot_layout_get_ligature_carets_for_glyphs (font, HB_DIRECTION_BTT,
+									3, &infos[0].codepoint, sizeof (infos[0]),
+									NULL,
+									3, caret_array));
+  g_assert_cmpint (2260, ==, caret_array[0]);
+  g_assert_cmpint (4688, ==, caret_array[1]);
+  g_assert_cmpint (2260, ==, caret_array[2]);
+  g_assert_cmpint (0, ==, caret_array[3]);
+
+  /* Remembered carets follow the scale. */
+  hb_font_set_scale (font, hb_face_get_upem (face), hb_face_get_upem (face));
+  g_assert_cmpuint (2, ==, hb_ot_layout_get_ligature_carets_for_glyphs (font, HB_DIRECTION_RTL,
+									1, glyphs, sizeof (glyphs[0]),
+									caret_starts,
+									4, caret_array));
+  g_assert_cmpuint (0, ==, caret_starts[0]);
+  g_assert_cmpuint (2, ==, caret_starts[1]);
+  g_assert_cmpint (565, ==, caret_array[0]);
+  g_assert_cmpint (1172, ==, caret_array[1]);
+
+  g_assert_cmpuint (0, ==, hb_ot_layout_get_ligature_carets_for_glyphs (font, HB_DIRECTION_RTL,
+									0, glyphs, sizeof (glyphs[0]),
+									caret_starts,
+									4, caret_array));
+  g_assert_cmpuint (0, ==, caret_starts[0]);
+
+  hb_font_destroy (font);
+  hb_face_destroy (face);
+}
+
 int
 main (int argc, char **argv)
 {
   g_test_init (&argc, &argv, NULL);
 
   hb_test_add (test_ot_layout_feature_get_name_ids_and_characters);
+  hb_test_add (test_ot_layout_get_ligature_carets_for_glyphs);
 
   return hb_test_run ();
 }
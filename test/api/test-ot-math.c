@@ -253,6 +253,101 @@ test_get_glyph_top_accent_attachment (void)
   cleanupFreeType();
 }
 
+typedef struct
+{
+  hb_codepoint_t glyph;
+  hb_position_t value;
+} glyph_value_t;
+
+static void
+get_glyph_values (glyph_value_t *values, const char * const *names, unsigned int count)
+{
+  unsigned int i;
+  for (i = 0; i < count; i++)
+  {
+    /* Unnamed entries get a glyph id past the font's glyphs. */
+    values[i].glyph = 60000;
+    if (names[i])
+      g_assert (hb_font_get_glyph_from_name (hb_font, names[i], -1, &values[i].glyph));
+    values[i].value = -1;
+  }
+}
+
+static void
+test_get_glyph_italics_corrections (void)
+{
+  static const char * const names[] = {"space", "A", "B", "C", NULL};
+  glyph_value_t values[5];
+  hb_position_t corrections[5];
+  unsigned int i;
+  initFreeType();
+
+  openFont("fonts/MathTestFontFull.otf");
+  get_glyph_values (values, names, 5);
+  hb_ot_math_get_glyph_italics_corrections (hb_font, 5,
+					    &values[0].glyph, sizeof (values[0]),
+					    &values[0].value, sizeof (values[0]));
+  g_assert_cmpint(values[0].value, ==, 0);
+  g_assert_cmpint(values[1].value, ==, 394);
+  g_assert_cmpint(values[2].value, ==, 300);
+  g_assert_cmpint(values[3].value, ==, 904);
+  g_assert_cmpint(values[4].value, ==, 0);
+
+  /* Zero strides repeat one glyph or overwrite one value. */
+  hb_ot_math_get_glyph_italics_corrections (hb_font, 5,
+					    &values[1].glyph, 0,
+					    corrections, sizeof (corrections[0]));
+  for (i = 0; i < 5; i++)
+    g_assert_cmpint(corrections[i], ==, 394);
+  hb_ot_math_get_glyph_italics_corrections (hb_font, 4,
+					    &values[0].glyph, sizeof (values[0]),
+					    corrections, 0);
+  g_assert_cmpint(corrections[0], ==, 904);
+  closeFont();
+
+  openFont("fonts/MathTestFontEmpty.otf");
+  get_glyph_values (values, names, 1);
+  hb_ot_math_get_glyph_italics_corrections (hb_font, 1,
+					    &values[0].glyph, sizeof (values[0]),
+					    &values[0].value, sizeof (values[0]));
+  g_assert_cmpint(values[0].value, ==, 0);
+  closeFont();
+
+  cleanupFreeType();
+}
+
+static void
+test_get_glyph_top_accent_attachments (void)
+{
+  static const char * const names[] = {"space", "D", "E", "F", NULL};
+  glyph_value_t values[5];
+  unsigned int i;
+  initFreeType();
+
+  openFont("fonts/MathTestFontFull.otf");
+  get_glyph_values (values, names, 5);
+  hb_ot_math_get_glyph_top_accent_attachments (hb_font, 5,
+					       &values[0].glyph, sizeof (values[0]),
+					       &values[0].value, sizeof (values[0]));
+  g_assert_cmpint(values[0].value, ==, 1000);
+  g_assert_cmpint(values[1].value, ==, 748);
+  g_assert_cmpint(values[2].value, ==, 692);
+  g_assert_cmpint(values[3].value, ==, 636);
+  for (i = 0; i < 5; i++)
+    g_assert_cmpint(values[i].value, ==, hb_ot_math_get_glyph_top_accent_attachment (hb_font, values[i].glyph));
+  closeFont();
+
+  openFont("fonts/MathTestFontEmpty.otf");
+  get_glyph_values (values, names, 1);
+  hb_ot_math_get_glyph_top_accent_attachments (hb_font, 1,
+					       &values[0].glyph, sizeof (values[0]),
+					       &values[0].value, sizeof (values[0]));
+  g_assert_cmpint(values[0].value, ==, 1000);
+  closeFont();
+
+  cleanupFreeType();
+}
+
 static void
 test_is_glyph_extended_shape (void)
 {
@@ -705,6 +800,8 @@ main (int argc, char **argv)
   hb_test_add (test_get_constant);
   hb_test_add (test_get_glyph_italics_correction);
   hb_test_add (test_get_glyph_top_accent_attachment);
+  hb_test_add (test_get_glyph_italics_corrections);
+  hb_test_add (test_get_glyph_top_accent_attachments);
   hb_test_add (test_is_glyph_extended_shape);
   hb_test_add (test_get_glyph_kerning);
   hb_test_add (test_get_glyph_assembly_italics_correction);
@@ -90,6 +90,33 @@ test_ot_name (void)
   g_assert_cmpstr (text, ==, "FontForge");
 }
 
+static void
+test_ot_name_get_utf8_strings (void)
+{
+  static const hb_ot_name_id_t name_ids[] = {1, 2, 3, 1000};
+  const char *strings[4];
+  unsigned int lengths[4];
+  const char *again;
+  g_assert_cmpuint (3, ==, hb_ot_name_get_utf8_strings (face, NULL, 4, name_ids, strings, lengths));
+  g_assert_cmpstr (strings[0], ==, "Test");
+  g_assert_cmpuint (4, ==, lengths[0]);
+  g_assert_cmpstr (strings[1], ==, "Regular");
+  g_assert_cmpuint (7, ==, lengths[1]);
+  g_assert_cmpstr (strings[2], ==, "FontForge : Test : 1-8-2018");
+  g_assert_cmpuint (27, ==, lengths[2]);
+  g_assert (!strings[3]);
+  g_assert_cmpuint (0, ==, lengths[3]);
+
+  /* Strings are decoded once and kept by the face. */
+  g_assert_cmpuint (1, ==, hb_ot_name_get_utf8_strings (face, hb_language_from_string ("en", -1),
+							  1, &name_ids[1], &again, NULL));
+  g_assert (again == strings[1]);
+
+  g_assert_cmpuint (0, ==, hb_ot_name_get_utf8_strings (hb_face_get_empty (), NULL, 1, name_ids, strings, lengths));
+  g_assert (!strings[0]);
+  g_assert_cmpuint (0, ==, lengths[0]);
+}
+
 int
 main (int argc, char **argv)
 {
@@ -98,6 +125,7 @@ main (int argc, char **argv)
 
   hb_test_add (test_ot_layout_feature_get_name_ids_and_characters);
   hb_test_add (test_ot_name);
+  hb_test_add (test_ot_name_get_utf8_strings);
 
   face = hb_test_open_font_file ("fonts/cv01.otf");
   status = hb_test_run ();
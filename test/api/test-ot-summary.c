@@ -0,0 +1,168 @@
+/*
+ * Copyright © 2018  Google, Inc.
+ *
+ *  This is part of HarfBuzz, a text shaping library.
+ *
+ * Permission is hereby granted, without written agreement and without
+ * license or royalty fees, to use, copy, modify, and distribute this
+ * software and its documentation for any purpose, provided that the
+ * above copyright notice and the following two paragraphs appear in
+ * all copies of this software.
+ *
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE TO ANY PARTY FOR
+ * DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES
+ * ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION, EVEN
+ * IF THE COPYRIGHT HOLDER HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * THE COPYRIGHT HOLDER SPECIFICALLY DISCLAIMS ANY WARRANTIES, INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER IS
+ * ON AN "AS IS" BASIS, AND THE COPYRIGHT HOLDER HAS NO OBLIGATION TO
+ * PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+ */
+
+#include "hb-test.h"
+
+#include <hb-ot.h>
+
+/* Unit tests for hb-ot-summary.h */
+
+static hb_ot_face_summary_t *
+create_summary (const char *font_path)
+{
+#if GLIB_CHECK_VERSION(2,37,2)
+  gchar *path = g_test_build_filename (G_TEST_DIST, font_path, NULL);
+#else
+  gchar *path = g_strdup (font_path);
+#endif
+  hb_blob_t *blob = hb_blob_create_from_file (path);
+  hb_ot_face_summary_t *summary;
+
+  if (hb_blob_get_length (blob) == 0)
+    g_error ("Font %s not found.", path);
+  g_free (path);
+
+  summary = hb_ot_face_summary_create (blob, 0);
+  hb_blob_destroy (blob);
+  return summary;
+}
+
+static void
+test_ot_face_summary (void)
+{
+  hb_ot_face_summary_t *summary = create_summary ("fonts/Roboto-Regular.gsub.fi.ttf");
+  hb_set_t *unicodes = hb_set_create ();
+  hb_tag_t scripts[2];
+  unsigned int count, length;
+
+  g_assert_cmpstr (hb_ot_face_summary_get_name (summary, HB_OT_NAME_ID_FONT_FAMILY, &length), ==, "Roboto");
+  g_assert_cmpuint (length, ==, 6);
+  g_assert_cmpstr (hb_ot_face_summary_get_name (summary, HB_OT_NAME_ID_FONT_SUBFAMILY, NULL), ==, "Regular");
+  g_assert (!hb_ot_face_summary_get_name (summary, HB_OT_NAME_ID_FULL_NAME, &length));
+  g_assert_cmpuint (length, ==, 0);
+  /* Only the names an index needs are kept. */
+  g_assert (!hb_ot_face_summary_get_name (summary, HB_OT_NAME_ID_UNIQUE_ID, NULL));
+
+  g_assert_cmpuint (hb_ot_face_summary_get_weight_class (summary), ==, 400);
+  g_assert_cmpuint (hb_ot_face_summary_get_width_class (summary), ==, 5);
+  g_assert (!hb_ot_face_summary_is_italic (summary));
+
+  count = 1;
+  g_assert_cmpuint (hb_ot_face_summary_get_axis_infos (summary, 0, &count, NULL), ==, 0);
+  g_assert_cmpuint (count, ==, 0);
+
+  hb_ot_face_summary_collect_unicodes (summary, unicodes);
+  g_assert_cmpuint (hb_set_get_population (unicodes), ==, 2);
+  g_assert (hb_set_has (unicodes, 'f'));
+  g_assert (hb_set_has (unicodes, 'i'));
+
+  count = 2;
+  g_assert_cmpuint (hb_ot_face_summary_get_script_tags (summary, 1, &count, scripts), ==, 4);
+  g_assert_cmpuint (count, ==, 2);
+  g_assert_cmpuint (scripts[0], ==, HB_TAG ('c','y','r','l'));
+  g_assert_cmpuint (scripts[1], ==, HB_TAG ('g','r','e','k'));
+  count = 2;
+  g_assert_cmpuint (hb_ot_face_summary_get_script_tags (summary, 3, &count, scripts), ==, 4);
+  g_assert_cmpuint (count, ==, 1);
+  g_assert_cmpuint (scripts[0], ==, HB_TAG ('l','a','t','n'));
+
+  g_assert (hb_ot_face_summary_reference (summary) == summary);
+  hb_ot_face_summary_destroy (summary);
+  hb_ot_face_summary_destroy (summary);
+  hb_set_destroy (unicodes);
+}
+
+static void
+test_ot_face_summary_variable (void)
+{
+  hb_ot_face_summary_t *summary = create_summary ("fonts/AdobeVFPrototype.abc.otf");
+  hb_ot_var_axis_info_t axes[2];
+  unsigned int count;
+
+  g_assert_cmpstr (hb_ot_face_summary_get_name (summary, HB_OT_NAME_ID_FULL_NAME, NULL), ==, "Adobe Variable Font Prototype");
+  g_assert_cmpstr (hb_ot_face_summary_get_name (summary, HB_OT_NAME_ID_POSTSCRIPT_NAME, NULL), ==, "AdobeVFPrototype-Default");
+  g_assert_cmpstr (hb_ot_face_summary_get_name (summary, HB_OT_NAME_ID_TYPOGRAPHIC_SUBFAMILY, NULL), ==, "Default");
+  g_assert (!hb_ot_face_summary_get_name (summary, HB_OT_NAME_ID_TYPOGRAPHIC_FAMILY, NULL));
+
+  count = 2;
+  g_assert_cmpuint (hb_ot_face_summary_get_axis_infos (summary, 0, &count, axes), ==, 2);
+  g_assert_cmpuint (count, ==, 2);
+  g_assert_cmpuint (axes[0].tag, ==, HB_OT_TAG_VAR_AXIS_WEIGHT);
+  g_assert_cmpuint (axes[0].axis_index, ==, 0);
+  g_assert_cmpuint (axes[0].name_id, ==, 259);
+  g_assert_cmpfloat (axes[0].min_value, ==, 200.f);
+  g_assert_cmpfloat (axes[0].max_value, ==, 900.f);
+  g_assert_cmpuint (axes[1].tag, ==, HB_TAG ('C','N','T','R'));
+  g_assert_cmpuint (axes[1].axis_index, ==, 1);
+  g_assert_cmpfloat (axes[1].min_value, ==, 0.f);
+  g_assert_cmpfloat (axes[1].default_value, ==, 0.f);
+  g_assert_cmpfloat (axes[1].max_value, ==, 100.f);
+
+  count = 2;
+  g_assert_cmpuint (hb_ot_face_summary_get_script_tags (summary, 0, &count, NULL), ==, 0);
+  g_assert_cmpuint (count, ==, 0);
+
+  hb_ot_face_summary_destroy (summary);
+}
+
+static void
+test_ot_face_summary_empty (void)
+{
+  hb_ot_face_summary_t *summaries[2];
+  hb_set_t *unicodes = hb_set_create ();
+  unsigned int count, i;
+
+  summaries[0] = hb_ot_face_summary_create (hb_blob_get_empty (), 0);
+  summaries[1] = hb_ot_face_summary_get_empty ();
+
+  for (i = 0; i < G_N_ELEMENTS (summaries); i++)
+  {
+    hb_ot_face_summary_t *summary = summaries[i];
+    g_assert (!hb_ot_face_summary_get_name (summary, HB_OT_NAME_ID_FONT_FAMILY, NULL));
+    g_assert_cmpuint (hb_ot_face_summary_get_weight_class (summary), ==, 0);
+    g_assert_cmpuint (hb_ot_face_summary_get_width_class (summary), ==, 0);
+    g_assert (!hb_ot_face_summary_is_italic (summary));
+    count = 1;
+    g_assert_cmpuint (hb_ot_face_summary_get_axis_infos (summary, 0, &count, NULL), ==, 0);
+    hb_ot_face_summary_collect_unicodes (summary, unicodes);
+    g_assert (hb_set_is_empty (unicodes));
+    count = 1;
+    g_assert_cmpuint (hb_ot_face_summary_get_script_tags (summary, 0, &count, NULL), ==, 0);
+    hb_ot_face_summary_destroy (summary);
+  }
+
+  hb_set_destroy (unicodes);
+}
+
+int
+main (int argc, char **argv)
+{
+  hb_test_init (&argc, &argv);
+
+  hb_test_add (test_ot_face_summary);
+  hb_test_add (test_ot_face_summary_variable);
+  hb_test_add (test_ot_face_summary_empty);
+
+  return hb_test_run ();
+}
@@ -266,6 +266,16 @@ test_set_algebra (void)
   hb_set_destroy (s);
   hb_set_destroy (o);
   hb_set_destroy (o2);
+
+  /* Empty sets combine into empty sets. */
+  s = hb_set_create ();
+  o = hb_set_create ();
+  hb_set_union (s, o);
+  test_empty (s);
+  hb_set_intersect (s, o);
+  test_empty (s);
+  hb_set_destroy (s);
+  hb_set_destroy (o);
 }
 
 static void
@@ -26,6 +26,8 @@
 
 #include "hb-test.h"
 
+#include <hb-ot.h>
+
 /* Unit tests for hb-shape.h */
 
 /*
@@ -193,6 +195,1048 @@ test_shape_list (void)
   g_assert (!strcmp (shapers[i - 1], "fallback"));
 }
 
+static hb_buffer_t *
+create_buffer (const char *text)
+{
+  hb_buffer_t *buffer = hb_buffer_create ();
+  hb_buffer_add_utf8 (buffer, text, -1, 0, -1);
+  hb_buffer_set_direction (buffer, HB_DIRECTION_LTR);
+  hb_buffer_set_script (buffer, HB_SCRIPT_LATIN);
+  hb_buffer_set_language (buffer, hb_language_from_string ("en", -1));
+  return buffer;
+}
+
+static void
+test_shape_incremental (void)
+{
+  /* Old text, the edit, and the new text. */
+  static const struct {
+    const char *old_text;
+    unsigned int start, old_end, new_end;
+    const char *new_text;
+  } edits[] = {
+    {"f i fi", 1, 2, 1, "fi fi"},	/* Joins a ligature. */
+    {"fi fi", 1, 1, 2, "f i fi"},	/* Splits one. */
+    {"fi fi", 2, 3, 2, "fifi"},
+    {"fifi", 4, 4, 6, "fifi i"},
+    {"i fi", 0, 0, 1, "fi fi"},
+    {"fi", 0, 2, 1, "i"},
+  };
+  hb_face_t *face = hb_test_open_font_file ("fonts/Roboto-Regular.gsub.fi.ttf");
+  hb_font_t *font = hb_font_create (face);
+  unsigned int i;
+
+  for (i = 0; i < G_N_ELEMENTS (edits); i++)
+  {
+    hb_buffer_t *buffer = create_buffer (edits[i].old_text);
+    hb_buffer_t *text = create_buffer (edits[i].new_text);
+    hb_buffer_t *expected = create_buffer (edits[i].new_text);
+
+    hb_shape (font, buffer, NULL, 0);
+    hb_shape (font, expected, NULL, 0);
+    g_assert (hb_shape_incremental (font, buffer, text,
+				    edits[i].start, edits[i].old_end, edits[i].new_end,
+				    NULL, 0));
+
+    g_assert_cmpint (hb_buffer_get_content_type (text), ==, HB_BUFFER_CONTENT_TYPE_UNICODE);
+    g_assert_cmpint (hb_buffer_diff (buffer, expected, (hb_codepoint_t) -1, 0), ==, HB_BUFFER_DIFF_FLAG_EQUAL);
+
+    hb_buffer_destroy (expected);
+    hb_buffer_destroy (text);
+    hb_buffer_destroy (buffer);
+  }
+
+  hb_font_destroy (font);
+  hb_face_destroy (face);
+}
+
+static unsigned int
+append_glyphs (hb_buffer_t *buffer, unsigned int start, unsigned int end,
+	       hb_codepoint_t *glyphs, unsigned int count)
+{
+  hb_glyph_info_t *infos = hb_buffer_get_glyph_infos (buffer, NULL);
+  for (; start < end; start++)
+    glyphs[count++] = infos[start].codepoint;
+  return count;
+}
+
+static void
+test_shape_lines (void)
+{
+  static const struct {
+    const char *text;
+    unsigned int breaks[2];
+    unsigned int num_breaks;
+    hb_bool_t reshaped;
+  } tests[] = {
+    {"fifi", {2}, 1, FALSE},	/* Between ligatures. */
+    {"fifi", {1, 3}, 2, TRUE},	/* Inside them. */
+    {"f i fi", {2, 5}, 2, TRUE},
+    {"fi", {0}, 1, FALSE},	/* An empty line. */
+  };
+  hb_face_t *face = hb_test_open_font_file ("fonts/Roboto-Regular.gsub.fi.ttf");
+  hb_font_t *font = hb_font_create (face);
+  unsigned int i, j;
+
+  for (i = 0; i < G_N_ELEMENTS (tests); i++)
+  {
+    hb_buffer_t *buffer = create_buffer (tests[i].text);
+    hb_buffer_t *text = create_buffer (tests[i].text);
+    hb_shape_line_t lines[3];
+
+    hb_shape (font, buffer, NULL, 0);
+    g_assert (hb_shape_lines (font, buffer, text, tests[i].breaks, tests[i].num_breaks, NULL, 0, lines));
+
+    /* Each line has the glyphs of its text shaped on its own. */
+    for (j = 0; j <= tests[i].num_breaks; j++)
+    {
+      unsigned int start = j ? tests[i].breaks[j - 1] : 0;
+      unsigned int end = j < tests[i].num_breaks ? tests[i].breaks[j] : strlen (tests[i].text);
+      char line_text[16];
+      hb_buffer_t *expected;
+      hb_codepoint_t glyphs[16];
+      hb_glyph_info_t *infos;
+      unsigned int count = 0, len, k;
+
+      memcpy (line_text, tests[i].text + start, end - start);
+      line_text[end - start] = '\0';
+      expected = create_buffer (line_text);
+      hb_shape (font, expected, NULL, 0);
+
+      if (lines[j].start_glyphs)
+	count = append_glyphs (lines[j].start_glyphs, 0, hb_buffer_get_length (lines[j].start_glyphs), glyphs, count);
+      count = append_glyphs (buffer, lines[j].start, lines[j].end, glyphs, count);
+      if (lines[j].end_glyphs)
+	count = append_glyphs (lines[j].end_glyphs, 0, hb_buffer_get_length (lines[j].end_glyphs), glyphs, count);
+
+      infos = hb_buffer_get_glyph_infos (expected, &len);
+      g_assert_cmpint (count, ==, len);
+      for (k = 0; k < len; k++)
+	g_assert_cmpint (glyphs[k], ==, infos[k].codepoint);
+      if (!tests[i].reshaped)
+	g_assert (!lines[j].start_glyphs && !lines[j].end_glyphs);
+
+      hb_buffer_destroy (lines[j].start_glyphs);
+      hb_buffer_destroy (lines[j].end_glyphs);
+      hb_buffer_destroy (expected);
+    }
+
+    hb_buffer_destroy (text);
+    hb_buffer_destroy (buffer);
+  }
+
+  hb_font_destroy (font);
+  hb_face_destroy (face);
+}
+
+static void
+test_shape_batch (void)
+{
+  static const hb_feature_t no_liga[] = {{HB_TAG ('l','i','g','a'), 0, 0, (unsigned int) -1}};
+  static const struct {
+    const char *text;
+    hb_direction_t direction;
+    const hb_feature_t *features;
+    unsigned int num_features;
+  } runs[] = {
+    {"fifi", HB_DIRECTION_LTR, NULL, 0},
+    {"fi fi", HB_DIRECTION_LTR, NULL, 0},	/* Shares the plan. */
+    {"fifi", HB_DIRECTION_LTR, no_liga, 1},
+    {"fifi", HB_DIRECTION_RTL, no_liga, 1},
+    {"fifi", HB_DIRECTION_RTL, NULL, 0},
+  };
+  hb_face_t *face = hb_test_open_font_file ("fonts/Roboto-Regular.gsub.fi.ttf");
+  hb_font_t *font = hb_font_create (face);
+  hb_shape_batch_item_t items[G_N_ELEMENTS (runs)];
+  hb_buffer_t *expected[G_N_ELEMENTS (runs)];
+  unsigned int i;
+
+  for (i = 0; i < G_N_ELEMENTS (runs); i++)
+  {
+    items[i].buffer = create_buffer (runs[i].text);
+    hb_buffer_set_direction (items[i].buffer, runs[i].direction);
+    items[i].features = runs[i].features;
+    items[i].num_features = runs[i].num_features;
+    expected[i] = create_buffer (runs[i].text);
+    hb_buffer_set_direction (expected[i], runs[i].direction);
+    hb_shape (font, expected[i], runs[i].features, runs[i].num_features);
+  }
+
+  g_assert (hb_shape_batch (font, items, G_N_ELEMENTS (items), NULL));
+  for (i = 0; i < G_N_ELEMENTS (runs); i++)
+  {
+    g_assert_cmpint (hb_buffer_get_content_type (items[i].buffer), ==, HB_BUFFER_CONTENT_TYPE_GLYPHS);
+    g_assert_cmpint (hb_buffer_diff (items[i].buffer, expected[i], (hb_codepoint_t) -1, 0), ==, HB_BUFFER_DIFF_FLAG_EQUAL);
+    hb_buffer_destroy (expected[i]);
+    hb_buffer_destroy (items[i].buffer);
+  }
+
+  g_assert (hb_shape_batch (font, NULL, 0, NULL));
+
+  hb_font_destroy (font);
+  hb_face_destroy (face);
+}
+
+typedef struct
+{
+  unsigned int calls;
+  unsigned int tasks;
+} executor_t;
+
+static void
+reverse_executor (hb_shape_task_func_t  task,
+		  void                 *task_data,
+		  unsigned int          num_tasks,
+		  void                 *user_data)
+{
+  executor_t *executor = (executor_t *) user_data;
+  executor->calls++;
+  executor->tasks += num_tasks;
+  while (num_tasks--)
+    task (task_data, num_tasks);
+}
+
+static void
+test_shape_parallel (void)
+{
+  /* Lines of six characters; a feature range that crosses chunks. */
+  hb_feature_t no_liga = {HB_TAG ('l','i','g','a'), 0, 4000, 5000};
+  hb_face_t *face = hb_test_open_font_file ("fonts/Roboto-Regular.gsub.fi.ttf");
+  hb_font_t *font = hb_font_create (face);
+  executor_t executor = {0, 0};
+  char text[3 * 4096 + 1];
+  unsigned int i;
+
+  for (i = 0; i + 6 <= sizeof (text) - 1; i += 6)
+    memcpy (text + i, "fi fi\n", 6);
+  text[i] = '\0';
+
+  for (i = 0; i < 2; i++)
+  {
+    hb_buffer_t *buffer = create_buffer (text);
+    hb_buffer_t *expected = create_buffer (text);
+
+    hb_shape (font, expected, &no_liga, 1);
+    g_assert (hb_shape_parallel (font, buffer, &no_liga, 1, NULL,
+				 i ? reverse_executor : NULL, &executor));
+    g_assert_cmpint (hb_buffer_diff (buffer, expected, (hb_codepoint_t) -1, 0), ==, HB_BUFFER_DIFF_FLAG_EQUAL);
+
+    hb_buffer_destroy (expected);
+    hb_buffer_destroy (buffer);
+  }
+  /* Split into chunks of at least 4096 characters. */
+  g_assert_cmpint (executor.calls, ==, 1);
+  g_assert_cmpint (executor.tasks, >=, 2);
+  g_assert_cmpint (executor.tasks, <=, 3);
+
+  hb_font_destroy (font);
+  hb_face_destroy (face);
+}
+
+static hb_codepoint_t
+shape_teh (hb_font_t *font,
+	   const uint32_t *text, unsigned int text_length, unsigned int offset,
+	   const uint32_t *pre_context, unsigned int pre_context_length,
+	   const uint32_t *post_context, unsigned int post_context_length)
+{
+  hb_buffer_t *buffer = hb_buffer_create ();
+  hb_codepoint_t glyph;
+
+  hb_buffer_add_utf32 (buffer, text, text_length, offset, 1);
+  if (pre_context || post_context)
+    hb_buffer_set_context (buffer,
+			   pre_context, pre_context_length,
+			   post_context, post_context_length);
+  hb_buffer_guess_segment_properties (buffer);
+  hb_shape (font, buffer, NULL, 0);
+  g_assert_cmpint (hb_buffer_get_length (buffer), ==, 1);
+  glyph = hb_buffer_get_glyph_infos (buffer, NULL)[0].codepoint;
+
+  hb_buffer_destroy (buffer);
+  return glyph;
+}
+
+static void
+test_shape_context (void)
+{
+  static const uint32_t teh[] = {0x062A, 0x062A, 0x062A};
+  static const uint32_t pre_context[] = {0x0020, 0x062A, 0x064E};
+  static const uint32_t space[] = {0x0020};
+  hb_face_t *face = hb_test_open_font_file ("../shaping/data/in-house/fonts/df768b9c257e0c9c35786c47cae15c46571d56be.ttf");
+  hb_font_t *font = hb_font_create (face);
+  hb_codepoint_t isolated, medial;
+
+  /* The font only has a medial form for teh. */
+  isolated = shape_teh (font, teh, 1, 0, NULL, 0, NULL, 0);
+  medial = shape_teh (font, teh, 3, 1, NULL, 0, NULL, 0);
+  g_assert_cmpint (medial, !=, isolated);
+
+  /* Context set separately works like context from the text. */
+  g_assert_cmpint (shape_teh (font, teh, 1, 0, teh, 1, teh, 1), ==, medial);
+  g_assert_cmpint (shape_teh (font, teh, 1, 0, NULL, 0, teh, 1), ==, isolated);
+  g_assert_cmpint (shape_teh (font, teh, 1, 0, teh, 1, NULL, 0), ==, isolated);
+
+  /* Joining looks through marks in the context, not through spaces. */
+  g_assert_cmpint (shape_teh (font, teh, 1, 0, pre_context, 3, teh, 1), ==, medial);
+  g_assert_cmpint (shape_teh (font, teh, 1, 0, pre_context, 3, space, 1), ==, isolated);
+
+  /* Setting the context replaces the one from the text. */
+  g_assert_cmpint (shape_teh (font, teh, 3, 1, space, 1, NULL, 0), ==, isolated);
+  g_assert_cmpint (shape_teh (font, teh, 3, 1, teh, 1, teh, 1), ==, medial);
+
+  hb_font_destroy (font);
+  hb_face_destroy (face);
+}
+
+static void
+check_fallback_run (hb_buffer_t *buffer,
+		    const hb_shape_fallback_run_t *run,
+		    unsigned int start, unsigned int end,
+		    unsigned int font_index,
+		    hb_font_t *font, hb_codepoint_t u)
+{
+  hb_glyph_info_t *info = hb_buffer_get_glyph_infos (buffer, NULL);
+  hb_codepoint_t glyph = 0;
+
+  g_assert_cmpint (run->start, ==, start);
+  g_assert_cmpint (run->end, ==, end);
+  g_assert_cmpint (run->font_index, ==, font_index);
+  hb_font_get_nominal_glyph (font, u, &glyph);
+  g_assert_cmpint (info[start].codepoint, ==, glyph);
+}
+
+static void
+test_shape_fallback (void)
+{
+  hb_face_t *face_ac = hb_test_open_font_file ("fonts/Roboto-Regular.ac.ttf");
+  hb_face_t *face_b = hb_test_open_font_file ("fonts/Roboto-Regular.b.ttf");
+  hb_font_t *fonts[2];
+  hb_buffer_t *buffer = hb_buffer_create ();
+  hb_shape_fallback_run_t runs[4];
+  hb_glyph_info_t *info;
+  unsigned int count, len;
+
+  fonts[0] = hb_font_create (face_ac);
+  fonts[1] = hb_font_create (face_b);
+
+  /* Each character goes to the first font that has it. */
+  hb_buffer_add_utf8 (buffer, "abcb", -1, 0, -1);
+  hb_buffer_guess_segment_properties (buffer);
+  count = G_N_ELEMENTS (runs);
+  g_assert (hb_shape_fallback (fonts, 2, buffer, NULL, 0, &count, runs));
+  g_assert_cmpint (count, ==, 4);
+  info = hb_buffer_get_glyph_infos (buffer, &len);
+  g_assert_cmpint (len, ==, 4);
+  g_assert_cmpint (info[3].cluster, ==, 3);
+  check_fallback_run (buffer, &runs[0], 0, 1, 0, fonts[0], 'a');
+  check_fallback_run (buffer, &runs[1], 1, 2, 1, fonts[1], 'b');
+  check_fallback_run (buffer, &runs[2], 2, 3, 0, fonts[0], 'c');
+  check_fallback_run (buffer, &runs[3], 3, 4, 1, fonts[1], 'b');
+  g_assert_cmpint (hb_buffer_get_glyph_positions (buffer, NULL)[1].x_advance, >, 0);
+
+  /* Only as many runs as fit are stored. */
+  hb_buffer_clear_contents (buffer);
+  hb_buffer_add_utf8 (buffer, "abcb", -1, 0, -1);
+  hb_buffer_guess_segment_properties (buffer);
+  count = 1;
+  g_assert (hb_shape_fallback (fonts, 2, buffer, NULL, 0, &count, runs));
+  g_assert_cmpint (count, ==, 4);
+  check_fallback_run (buffer, &runs[0], 0, 1, 0, fonts[0], 'a');
+  hb_buffer_clear_contents (buffer);
+  hb_buffer_add_utf8 (buffer, "abcb", -1, 0, -1);
+  hb_buffer_guess_segment_properties (buffer);
+  g_assert (hb_shape_fallback (fonts, 2, buffer, NULL, 0, NULL, NULL));
+  g_assert_cmpint (hb_buffer_get_length (buffer), ==, 4);
+
+  /* Runs are in visual order. */
+  hb_buffer_clear_contents (buffer);
+  hb_buffer_add_utf8 (buffer, "ab", -1, 0, -1);
+  hb_buffer_guess_segment_properties (buffer);
+  hb_buffer_set_direction (buffer, HB_DIRECTION_RTL);
+  count = G_N_ELEMENTS (runs);
+  g_assert (hb_shape_fallback (fonts, 2, buffer, NULL, 0, &count, runs));
+  g_assert_cmpint (count, ==, 2);
+  check_fallback_run (buffer, &runs[0], 0, 1, 1, fonts[1], 'b');
+  check_fallback_run (buffer, &runs[1], 1, 2, 0, fonts[0], 'a');
+  g_assert_cmpint (hb_buffer_get_glyph_infos (buffer, NULL)[0].cluster, ==, 1);
+
+  /* A character no font has, or a mark the base's font lacks, goes to the
+   * first font. */
+  hb_buffer_clear_contents (buffer);
+  hb_buffer_add_utf8 (buffer, "xb\xCC\x81" "a", -1, 0, -1);
+  hb_buffer_guess_segment_properties (buffer);
+  count = G_N_ELEMENTS (runs);
+  g_assert (hb_shape_fallback (fonts, 2, buffer, NULL, 0, &count, runs));
+  g_assert_cmpint (count, ==, 1);
+  g_assert_cmpint (runs[0].font_index, ==, 0);
+  info = hb_buffer_get_glyph_infos (buffer, &len);
+  g_assert_cmpint (len, ==, 4);
+  g_assert_cmpint (info[0].codepoint, ==, 0);
+  g_assert_cmpint (info[1].codepoint, ==, 0);
+
+  /* With one font, it is plain shaping. */
+  hb_buffer_clear_contents (buffer);
+  hb_buffer_add_utf8 (buffer, "ab", -1, 0, -1);
+  hb_buffer_guess_segment_properties (buffer);
+  count = G_N_ELEMENTS (runs);
+  g_assert (hb_shape_fallback (fonts + 1, 1, buffer, NULL, 0, &count, runs));
+  g_assert_cmpint (count, ==, 1);
+  check_fallback_run (buffer, &runs[0], 0, 2, 0, fonts[1], 'a');
+
+  /* Nothing to do without fonts or text. */
+  count = G_N_ELEMENTS (runs);
+  g_assert (hb_shape_fallback (fonts, 0, buffer, NULL, 0, &count, runs));
+  g_assert_cmpint (count, ==, 0);
+  hb_buffer_clear_contents (buffer);
+  count = G_N_ELEMENTS (runs);
+  g_assert (hb_shape_fallback (fonts, 2, buffer, NULL, 0, &count, runs));
+  g_assert_cmpint (count, ==, 0);
+
+  hb_buffer_destroy (buffer);
+  hb_font_destroy (fonts[1]);
+  hb_font_destroy (fonts[0]);
+  hb_face_destroy (face_b);
+  hb_face_destroy (face_ac);
+}
+
+static void
+set_flag (void *user_data)
+{
+  *(hb_bool_t *) user_data = TRUE;
+}
+
+typedef struct
+{
+  hb_buffer_t *buffer;
+  hb_font_t *font;
+  hb_buffer_trace_event_t events[64];
+  unsigned int indices[64];
+  unsigned int count;
+} trace_t;
+
+static void
+trace_func (hb_buffer_t             *buffer,
+	    hb_font_t               *font,
+	    hb_buffer_trace_event_t  event,
+	    unsigned int             index,
+	    uint64_t                 elapsed_ns HB_UNUSED,
+	    void                    *user_data)
+{
+  trace_t *trace = (trace_t *) user_data;
+
+  g_assert (buffer == trace->buffer);
+  g_assert (font == trace->font);
+  g_assert_cmpint (trace->count, <, G_N_ELEMENTS (trace->events));
+  trace->events[trace->count] = event;
+  trace->indices[trace->count] = index;
+  trace->count++;
+}
+
+static void
+check_trace (const trace_t *trace,
+	     const hb_buffer_trace_event_t *events,
+	     const unsigned int *indices,
+	     unsigned int count)
+{
+  unsigned int i;
+
+  g_assert_cmpint (trace->count, ==, count);
+  for (i = 0; i < count; i++)
+  {
+    g_assert_cmpint (trace->events[i], ==, events[i]);
+    g_assert_cmpint (trace->indices[i], ==, indices[i]);
+  }
+}
+
+static void
+test_shape_trace (void)
+{
+  static const hb_buffer_trace_event_t ot_events[] = {
+    HB_BUFFER_TRACE_EVENT_NORMALIZE,
+    HB_BUFFER_TRACE_EVENT_GSUB_STAGE,
+    HB_BUFFER_TRACE_EVENT_GSUB_LOOKUP,
+    HB_BUFFER_TRACE_EVENT_GSUB_STAGE,
+    HB_BUFFER_TRACE_EVENT_GPOS_STAGE,
+  };
+  static const unsigned int ot_indices[] = {0, 0, 0, 1, 0};
+  static const hb_buffer_trace_event_t aat_events[] = {
+    HB_BUFFER_TRACE_EVENT_NORMALIZE,
+    HB_BUFFER_TRACE_EVENT_MORX_SUBTABLE,
+    HB_BUFFER_TRACE_EVENT_MORX,
+    HB_BUFFER_TRACE_EVENT_FALLBACK_POSITION,
+    HB_BUFFER_TRACE_EVENT_FALLBACK_POSITION,
+  };
+  static const unsigned int aat_indices[] = {0, 0, 0, 0, 0};
+  hb_face_t *face = hb_test_open_font_file ("fonts/Roboto-Regular.gsub.fi.ttf");
+  hb_face_t *aat_face = hb_test_open_font_file ("fonts/aat-morx.ttf");
+  hb_font_t *font = hb_font_create (face);
+  hb_font_t *aat_font = hb_font_create (aat_face);
+  hb_buffer_t *buffer = hb_buffer_create ();
+  trace_t trace;
+  hb_bool_t freed = FALSE;
+
+  memset (&trace, 0, sizeof (trace));
+  trace.buffer = buffer;
+  trace.font = font;
+  hb_buffer_set_trace_func (buffer, trace_func, &trace, NULL);
+  hb_buffer_add_utf8 (buffer, "fi", -1, 0, -1);
+  hb_buffer_guess_segment_properties (buffer);
+  hb_shape (font, buffer, NULL, 0);
+  check_trace (&trace, ot_events, ot_indices, G_N_ELEMENTS (ot_events));
+
+  /* AAT fonts report morx subtables, and fallback positioning. */
+  trace.font = aat_font;
+  trace.count = 0;
+  hb_buffer_clear_contents (buffer);
+  hb_buffer_add_utf8 (buffer, "fi", -1, 0, -1);
+  hb_buffer_guess_segment_properties (buffer);
+  hb_shape (aat_font, buffer, NULL, 0);
+  check_trace (&trace, aat_events, aat_indices, G_N_ELEMENTS (aat_events));
+
+  /* Replacing or unsetting the func destroys the user data. */
+  hb_buffer_set_trace_func (buffer, trace_func, &freed, set_flag);
+  g_assert (!freed);
+  hb_buffer_set_trace_func (buffer, NULL, NULL, NULL);
+  g_assert (freed);
+  trace.count = 0;
+  hb_buffer_clear_contents (buffer);
+  hb_buffer_add_utf8 (buffer, "fi", -1, 0, -1);
+  hb_buffer_guess_segment_properties (buffer);
+  hb_shape (font, buffer, NULL, 0);
+  g_assert_cmpint (trace.count, ==, 0);
+
+  hb_buffer_destroy (buffer);
+  hb_font_destroy (aat_font);
+  hb_font_destroy (font);
+  hb_face_destroy (aat_face);
+  hb_face_destroy (face);
+}
+
+static unsigned int
+shape_with_plan (hb_shape_plan_t *shape_plan, hb_face_t *face,
+		 const hb_segment_properties_t *props,
+		 hb_codepoint_t *glyphs, unsigned int max_glyphs)
+{
+  hb_font_t *font = hb_font_create (face);
+  hb_buffer_t *buffer = hb_buffer_create ();
+  hb_glyph_info_t *infos;
+  unsigned int len, i;
+
+  hb_buffer_add_utf8 (buffer, "fi", -1, 0, -1);
+  hb_buffer_set_segment_properties (buffer, props);
+  g_assert (hb_shape_plan_execute (shape_plan, font, buffer, NULL, 0));
+
+  infos = hb_buffer_get_glyph_infos (buffer, &len);
+  g_assert_cmpint (len, <=, max_glyphs);
+  for (i = 0; i < len; i++)
+    glyphs[i] = infos[i].codepoint;
+
+  hb_buffer_destroy (buffer);
+  hb_font_destroy (font);
+  return len;
+}
+
+static void
+test_shape_plan_serialize (void)
+{
+  hb_face_t *face = hb_test_open_font_file ("fonts/Roboto-Regular.gsub.fi.ttf");
+  hb_face_t *reopened = hb_test_open_font_file ("fonts/Roboto-Regular.gsub.fi.ttf");
+  hb_face_t *other = hb_test_open_font_file ("fonts/Roboto-Regular.abc.ttf");
+  hb_segment_properties_t props = HB_SEGMENT_PROPERTIES_DEFAULT;
+  hb_shape_plan_t *shape_plan, *restored;
+  hb_codepoint_t expected[8], glyphs[8];
+  unsigned int expected_len, len, length, i;
+  const char *data;
+  hb_blob_t *blob;
+
+  props.direction = HB_DIRECTION_LTR;
+  props.script = HB_SCRIPT_LATIN;
+  props.language = hb_language_from_string ("en", -1);
+  shape_plan = hb_shape_plan_create_cached (face, &props, NULL, 0, NULL);
+  expected_len = shape_with_plan (shape_plan, face, &props, expected, 8);
+  g_assert_cmpint (expected_len, ==, 1);
+
+  blob = hb_shape_plan_serialize (shape_plan);
+  data = hb_blob_get_data (blob, &length);
+  g_assert_cmpint (length, >, 0);
+
+  restored = hb_shape_plan_deserialize (reopened, blob);
+  g_assert (restored != hb_shape_plan_get_empty ());
+  g_assert_cmpstr (hb_shape_plan_get_shaper (restored), ==, "ot");
+  len = shape_with_plan (restored, reopened, &props, glyphs, 8);
+  g_assert_cmpint (len, ==, expected_len);
+  g_assert_cmpint (glyphs[0], ==, expected[0]);
+  hb_shape_plan_destroy (restored);
+
+  g_assert (hb_shape_plan_deserialize (other, blob) == hb_shape_plan_get_empty ());
+  g_assert (hb_shape_plan_deserialize (NULL, blob) == hb_shape_plan_get_empty ());
+
+  for (i = 0; i < length; i++)
+  {
+    hb_blob_t *truncated = hb_blob_create_sub_blob (blob, 0, i);
+    g_assert (hb_shape_plan_deserialize (other, truncated) == hb_shape_plan_get_empty ());
+    g_assert (hb_shape_plan_deserialize (reopened, truncated) == hb_shape_plan_get_empty ());
+    hb_blob_destroy (truncated);
+  }
+
+  /* Corrupt blobs may or may not be rejected, but must not be trusted. */
+  for (i = 0; i < length; i++)
+  {
+    char *copy = g_memdup (data, length);
+    hb_face_t *fresh = hb_test_open_font_file ("fonts/Roboto-Regular.gsub.fi.ttf");
+    hb_blob_t *corrupt;
+    copy[i] ^= 0x5A;
+    corrupt = hb_blob_create (copy, length, HB_MEMORY_MODE_WRITABLE, copy, g_free);
+    hb_shape_plan_destroy (hb_shape_plan_deserialize (fresh, corrupt));
+    hb_face_destroy (fresh);
+    hb_blob_destroy (corrupt);
+  }
+
+  hb_blob_destroy (blob);
+  hb_shape_plan_destroy (shape_plan);
+  hb_face_destroy (other);
+  hb_face_destroy (reopened);
+  hb_face_destroy (face);
+}
+
+static unsigned int
+shape_with_cache (hb_shape_cache_t *cache, hb_font_t *font, const char *text,
+		  hb_buffer_cluster_level_t cluster_level,
+		  hb_codepoint_t *glyphs, unsigned int max_glyphs)
+{
+  hb_buffer_t *buffer = hb_buffer_create ();
+  hb_glyph_info_t *infos;
+  unsigned int len, i;
+
+  hb_buffer_add_utf8 (buffer, text, -1, 0, -1);
+  hb_buffer_set_direction (buffer, HB_DIRECTION_LTR);
+  hb_buffer_set_script (buffer, HB_SCRIPT_LATIN);
+  hb_buffer_set_language (buffer, hb_language_from_string ("en", -1));
+  hb_buffer_set_flags (buffer, HB_BUFFER_FLAG_BOT | HB_BUFFER_FLAG_EOT);
+  hb_buffer_set_cluster_level (buffer, cluster_level);
+  g_assert (hb_shape_cache_shape (cache, font, buffer, NULL, 0, NULL));
+
+  infos = hb_buffer_get_glyph_infos (buffer, &len);
+  g_assert_cmpint (len, <=, max_glyphs);
+  for (i = 0; i < len; i++)
+    glyphs[i] = infos[i].codepoint;
+
+  hb_buffer_destroy (buffer);
+  return len;
+}
+
+static void
+test_shape_cache (void)
+{
+  static hb_user_data_key_t key;
+  hb_face_t *face = hb_test_open_font_file ("fonts/Roboto-Regular.gsub.fi.ttf");
+  hb_font_t *font = hb_font_create (face);
+  hb_shape_cache_t *cache = hb_shape_cache_create (2);
+  hb_buffer_t *buffer = create_buffer ("fifi");
+  hb_buffer_t *expected = create_buffer ("fifi");
+  hb_codepoint_t glyphs[8];
+  hb_bool_t font_destroyed = FALSE;
+  unsigned int hits, misses, i;
+
+  g_assert (hb_shape_cache_reference (cache) == cache);
+  hb_shape_cache_destroy (cache);
+
+  hb_shape (font, expected, NULL, 0);
+  for (i = 0; i < 2; i++)
+  {
+    hb_buffer_clear_contents (buffer);
+    hb_buffer_add_utf8 (buffer, "fifi", -1, 0, -1);
+    hb_buffer_set_direction (buffer, HB_DIRECTION_LTR);
+    hb_buffer_set_script (buffer, HB_SCRIPT_LATIN);
+    hb_buffer_set_language (buffer, hb_language_from_string ("en", -1));
+    g_assert (hb_shape_cache_shape (cache, font, buffer, NULL, 0, NULL));
+    g_assert_cmpint (hb_buffer_diff (buffer, expected, (hb_codepoint_t) -1, 0), ==, HB_BUFFER_DIFF_FLAG_EQUAL);
+  }
+  g_assert_cmpint (hb_shape_cache_get_stats (cache, &hits, &misses), ==, 1);
+  g_assert_cmpint (hits, ==, 1);
+  g_assert_cmpint (misses, ==, 1);
+
+  /* Two runs at most, the least recently used going first. */
+  shape_with_cache (cache, font, "f", HB_BUFFER_CLUSTER_LEVEL_MONOTONE_GRAPHEMES, glyphs, G_N_ELEMENTS (glyphs));
+  shape_with_cache (cache, font, "i", HB_BUFFER_CLUSTER_LEVEL_MONOTONE_GRAPHEMES, glyphs, G_N_ELEMENTS (glyphs));
+  shape_with_cache (cache, font, "f", HB_BUFFER_CLUSTER_LEVEL_MONOTONE_GRAPHEMES, glyphs, G_N_ELEMENTS (glyphs));
+  g_assert_cmpint (hb_shape_cache_get_stats (cache, &hits, &misses), ==, 2);
+  g_assert_cmpint (hits, ==, 2);
+  g_assert_cmpint (misses, ==, 3);
+  shape_with_cache (cache, font, "fifi", HB_BUFFER_CLUSTER_LEVEL_MONOTONE_GRAPHEMES, glyphs, G_N_ELEMENTS (glyphs));
+  g_assert_cmpint (hb_shape_cache_get_stats (cache, &hits, &misses), ==, 2);
+  g_assert_cmpint (misses, ==, 4);
+
+  /* The runs keep the font alive until cleared. */
+  g_assert (hb_font_set_user_data (font, &key, &font_destroyed, set_flag, FALSE));
+  hb_font_destroy (font);
+  g_assert (!font_destroyed);
+  hb_shape_cache_clear (cache);
+  g_assert (font_destroyed);
+  g_assert_cmpint (hb_shape_cache_get_stats (cache, &hits, &misses), ==, 0);
+  g_assert_cmpint (hits, ==, 2);
+  g_assert_cmpint (misses, ==, 4);
+  hb_shape_cache_destroy (cache);
+
+  /* The empty cache shapes, keeping nothing. */
+  font = hb_font_create (face);
+  cache = hb_shape_cache_get_empty ();
+  g_assert_cmpint (shape_with_cache (cache, font, "fi", HB_BUFFER_CLUSTER_LEVEL_MONOTONE_GRAPHEMES, glyphs, G_N_ELEMENTS (glyphs)), ==, 1);
+  g_assert_cmpint (hb_shape_cache_get_stats (cache, NULL, NULL), ==, 0);
+  hb_shape_cache_clear (cache);
+  hb_shape_cache_destroy (cache);
+
+  hb_buffer_destroy (expected);
+  hb_buffer_destroy (buffer);
+  hb_font_destroy (font);
+  hb_face_destroy (face);
+}
+
+static void
+test_shape_cache_serialize (void)
+{
+  hb_face_t *face = hb_test_open_font_file ("fonts/Roboto-Regular.gsub.fi.ttf");
+  hb_face_t *reopened = hb_test_open_font_file ("fonts/Roboto-Regular.gsub.fi.ttf");
+  hb_face_t *other = hb_test_open_font_file ("fonts/Roboto-Regular.abc.ttf");
+  hb_font_t *font = hb_font_create (face);
+  hb_font_t *reopened_font = hb_font_create (reopened);
+  hb_font_t *other_font = hb_font_create (other);
+  hb_shape_cache_t *cache = hb_shape_cache_create (16);
+  hb_shape_cache_t *loaded;
+  hb_codepoint_t expected[2][8], glyphs[8];
+  unsigned int expected_len[2], len, length, hits, misses, i;
+  hb_blob_t *blob;
+
+  expected_len[0] = shape_with_cache (cache, font, "fi", HB_BUFFER_CLUSTER_LEVEL_DEFAULT, expected[0], 8);
+  expected_len[1] = shape_with_cache (cache, font, "if", HB_BUFFER_CLUSTER_LEVEL_CHARACTERS, expected[1], 8);
+  g_assert_cmpint (expected_len[0], ==, 1);
+  g_assert_cmpint (expected_len[1], ==, 2);
+
+  blob = hb_shape_cache_serialize (cache, face);
+  hb_blob_get_data (blob, &length);
+  g_assert_cmpint (length, >, 0);
+
+  loaded = hb_shape_cache_create (16);
+  g_assert_cmpint (hb_shape_cache_deserialize (loaded, other_font, blob), ==, 0);
+  g_assert_cmpint (hb_shape_cache_get_stats (loaded, NULL, NULL), ==, 0);
+
+  g_assert_cmpint (hb_shape_cache_deserialize (loaded, reopened_font, blob), ==, 2);
+  len = shape_with_cache (loaded, reopened_font, "fi", HB_BUFFER_CLUSTER_LEVEL_DEFAULT, glyphs, 8);
+  g_assert_cmpint (len, ==, expected_len[0]);
+  g_assert_cmpint (glyphs[0], ==, expected[0][0]);
+  len = shape_with_cache (loaded, reopened_font, "if", HB_BUFFER_CLUSTER_LEVEL_CHARACTERS, glyphs, 8);
+  g_assert_cmpint (len, ==, expected_len[1]);
+  g_assert_cmpint (glyphs[0], ==, expected[1][0]);
+  g_assert_cmpint (glyphs[1], ==, expected[1][1]);
+  g_assert_cmpint (hb_shape_cache_get_stats (loaded, &hits, &misses), ==, 2);
+  g_assert_cmpint (hits, ==, 2);
+  g_assert_cmpint (misses, ==, 0);
+  hb_shape_cache_destroy (loaded);
+
+  for (i = 0; i < length; i++)
+  {
+    hb_blob_t *truncated = hb_blob_create_sub_blob (blob, 0, i);
+    loaded = hb_shape_cache_create (16);
+    g_assert_cmpint (hb_shape_cache_deserialize (loaded, reopened_font, truncated), <, 2);
+    hb_shape_cache_destroy (loaded);
+    hb_blob_destroy (truncated);
+  }
+
+  hb_blob_destroy (blob);
+  hb_shape_cache_destroy (cache);
+  hb_font_destroy (other_font);
+  hb_font_destroy (reopened_font);
+  hb_font_destroy (font);
+  hb_face_destroy (other);
+  hb_face_destroy (reopened);
+  hb_face_destroy (face);
+}
+
+static hb_shape_plan_t *
+create_cached_plan (hb_face_t *face, hb_script_t script)
+{
+  hb_segment_properties_t props = HB_SEGMENT_PROPERTIES_DEFAULT;
+  props.direction = HB_DIRECTION_LTR;
+  props.script = script;
+  props.language = hb_language_from_string ("en", -1);
+  return hb_shape_plan_create_cached (face, &props, NULL, 0, NULL);
+}
+
+static void
+test_shape_plan_cache (void)
+{
+  hb_face_t *face = hb_test_open_font_file ("fonts/Roboto-Regular.gsub.fi.ttf");
+  hb_shape_plan_t *latin, *greek, *cyrillic, *plan;
+  unsigned int hits, misses;
+
+  g_assert_cmpint (hb_face_get_shape_plan_cache_stats (face, &hits, &misses), ==, 0);
+  g_assert_cmpint (hits, ==, 0);
+  g_assert_cmpint (misses, ==, 0);
+
+  hb_face_set_shape_plan_cache_size (face, 2);
+
+  latin = create_cached_plan (face, HB_SCRIPT_LATIN);
+  greek = create_cached_plan (face, HB_SCRIPT_GREEK);
+  g_assert (latin != greek);
+  g_assert_cmpint (hb_face_get_shape_plan_cache_stats (face, &hits, &misses), ==, 2);
+  g_assert_cmpint (hits, ==, 0);
+  g_assert_cmpint (misses, ==, 2);
+
+  plan = create_cached_plan (face, HB_SCRIPT_LATIN);
+  g_assert (plan == latin);
+  hb_shape_plan_destroy (plan);
+  g_assert_cmpint (hb_face_get_shape_plan_cache_stats (face, &hits, &misses), ==, 2);
+  g_assert_cmpint (hits, ==, 1);
+  g_assert_cmpint (misses, ==, 2);
+
+  /* Full; Greek is the least recently used and makes room. */
+  cyrillic = create_cached_plan (face, HB_SCRIPT_CYRILLIC);
+  g_assert_cmpint (hb_face_get_shape_plan_cache_stats (face, &hits, &misses), ==, 2);
+  g_assert_cmpint (misses, ==, 3);
+
+  plan = create_cached_plan (face, HB_SCRIPT_LATIN);
+  g_assert (plan == latin);
+  hb_shape_plan_destroy (plan);
+  plan = create_cached_plan (face, HB_SCRIPT_GREEK);
+  g_assert (plan != greek);
+  hb_shape_plan_destroy (plan);
+  g_assert_cmpint (hb_face_get_shape_plan_cache_stats (face, &hits, &misses), ==, 2);
+  g_assert_cmpint (hits, ==, 2);
+  g_assert_cmpint (misses, ==, 4);
+
+  /* Zero turns the cache off. */
+  hb_face_set_shape_plan_cache_size (face, 0);
+  plan = create_cached_plan (face, HB_SCRIPT_LATIN);
+  g_assert (plan != latin);
+  hb_shape_plan_destroy (plan);
+  g_assert_cmpint (hb_face_get_shape_plan_cache_stats (face, NULL, NULL), ==, 0);
+
+  hb_face_set_shape_plan_cache_size (hb_face_get_empty (), 2);
+  g_assert_cmpint (hb_face_get_shape_plan_cache_stats (hb_face_get_empty (), &hits, &misses), ==, 0);
+  g_assert_cmpint (hits, ==, 0);
+  g_assert_cmpint (misses, ==, 0);
+
+  hb_shape_plan_destroy (cyrillic);
+  hb_shape_plan_destroy (greek);
+  hb_shape_plan_destroy (latin);
+  hb_face_destroy (face);
+}
+
+static void
+execute_plan (hb_shape_plan_t *shape_plan, hb_font_t *font, const char *text)
+{
+  hb_buffer_t *buffer = hb_buffer_create ();
+  hb_segment_properties_t props = HB_SEGMENT_PROPERTIES_DEFAULT;
+
+  props.direction = HB_DIRECTION_LTR;
+  props.script = HB_SCRIPT_LATIN;
+  props.language = hb_language_from_string ("en", -1);
+  hb_buffer_add_utf8 (buffer, text, -1, 0, -1);
+  hb_buffer_set_segment_properties (buffer, &props);
+  g_assert (hb_shape_plan_execute (shape_plan, font, buffer, NULL, 0));
+  hb_buffer_destroy (buffer);
+}
+
+static void
+test_shape_plan_lookup_stats (void)
+{
+  hb_face_t *face = hb_test_open_font_file ("fonts/Roboto-Regular.gsub.fi.ttf");
+  hb_font_t *font = hb_font_create (face);
+  hb_shape_plan_t *plan = create_cached_plan (face, HB_SCRIPT_LATIN);
+  hb_shape_plan_lookup_stats_t stats[4];
+  unsigned int count;
+
+  count = 4;
+  g_assert_cmpint (hb_shape_plan_get_lookup_stats (plan, 0, &count, stats), ==, 0);
+  g_assert_cmpint (count, ==, 0);
+
+  /* The ligature applies to "fi"; "ab" has no glyph it covers. */
+  g_assert (hb_shape_plan_set_lookup_profiling (plan, TRUE));
+  execute_plan (plan, font, "fi");
+  execute_plan (plan, font, "ab");
+  count = 4;
+  g_assert_cmpint (hb_shape_plan_get_lookup_stats (plan, 0, &count, stats), ==, 1);
+  g_assert_cmpint (count, ==, 1);
+  g_assert_cmphex (stats[0].table_tag, ==, HB_OT_TAG_GSUB);
+  g_assert_cmpint (stats[0].lookup_index, ==, 0);
+  g_assert_cmpint (stats[0].positions, ==, 1);
+  g_assert_cmpint (stats[0].digest_rejects, ==, 1);
+  g_assert_cmpint (stats[0].subtable_attempts, ==, 1);
+  g_assert_cmpint (stats[0].applications, ==, 1);
+  count = 4;
+  g_assert_cmpint (hb_shape_plan_get_lookup_stats (plan, 1, &count, stats), ==, 1);
+  g_assert_cmpint (count, ==, 0);
+  g_assert_cmpint (hb_shape_plan_get_lookup_stats (plan, 0, NULL, NULL), ==, 1);
+
+  /* Counts add up until reset. */
+  execute_plan (plan, font, "fi");
+  count = 1;
+  hb_shape_plan_get_lookup_stats (plan, 0, &count, stats);
+  g_assert_cmpint (stats[0].applications, ==, 2);
+  hb_shape_plan_reset_lookup_stats (plan);
+  hb_shape_plan_get_lookup_stats (plan, 0, &count, stats);
+  g_assert_cmpint (stats[0].positions, ==, 0);
+  g_assert_cmpint (stats[0].applications, ==, 0);
+  g_assert_cmpint (stats[0].elapsed_ns, ==, 0);
+
+  /* Turned off, nothing more is counted, but what was is kept. */
+  execute_plan (plan, font, "fi");
+  g_assert (hb_shape_plan_set_lookup_profiling (plan, FALSE));
+  execute_plan (plan, font, "fi");
+  g_assert_cmpint (hb_shape_plan_get_lookup_stats (plan, 0, &count, stats), ==, 1);
+  g_assert_cmpint (stats[0].applications, ==, 1);
+
+  g_assert (!hb_shape_plan_set_lookup_profiling (hb_shape_plan_get_empty (), TRUE));
+  count = 4;
+  g_assert_cmpint (hb_shape_plan_get_lookup_stats (hb_shape_plan_get_empty (), 0, &count, stats), ==, 0);
+  g_assert_cmpint (count, ==, 0);
+
+  hb_shape_plan_destroy (plan);
+  hb_font_destroy (font);
+  hb_face_destroy (face);
+}
+
+static unsigned int
+shape_with_budget (hb_font_t *font, hb_buffer_t *buffer, const char *text,
+		   unsigned int max_ops, hb_bool_t *exhausted)
+{
+  hb_buffer_clear_contents (buffer);
+  hb_buffer_set_max_ops (buffer, max_ops);
+  hb_buffer_add_utf8 (buffer, text, -1, 0, -1);
+  hb_buffer_guess_segment_properties (buffer);
+  hb_shape (font, buffer, NULL, 0);
+  return hb_buffer_get_ops_used (buffer, exhausted);
+}
+
+static void
+test_shape_max_ops (void)
+{
+  hb_face_t *face = hb_test_open_font_file ("fonts/Roboto-Regular.gsub.fi.ttf");
+  hb_face_t *aat_face = hb_test_open_font_file ("fonts/aat-morx.ttf");
+  hb_font_t *font = hb_font_create (face);
+  hb_font_t *aat_font = hb_font_create (aat_face);
+  hb_buffer_t *buffer = hb_buffer_create ();
+  hb_bool_t exhausted;
+
+  g_assert_cmpint (hb_buffer_get_max_ops (buffer), ==, 0);
+  hb_buffer_set_max_ops (buffer, 5);
+  g_assert_cmpint (hb_buffer_get_max_ops (buffer), ==, 5);
+
+  /* Without a budget, lookups are not counted. */
+  g_assert_cmpint (shape_with_budget (font, buffer, "fi", 0, &exhausted), ==, 0);
+  g_assert (!exhausted);
+  g_assert_cmpint (hb_buffer_get_length (buffer), ==, 1);
+
+  /* The one ligature lookup fits a budget of one. */
+  g_assert_cmpint (shape_with_budget (font, buffer, "fi", 1, &exhausted), ==, 1);
+  g_assert (!exhausted);
+  g_assert_cmpint (hb_buffer_get_length (buffer), ==, 1);
+  g_assert_cmpint (shape_with_budget (font, buffer, "fi", 100, NULL), ==, 1);
+
+  /* Each state machine transition costs one operation. */
+  g_assert_cmpint (shape_with_budget (aat_font, buffer, "abcdef", 100, &exhausted), ==, 7);
+  g_assert (!exhausted);
+  g_assert_cmpint (shape_with_budget (aat_font, buffer, "abcdef", 3, &exhausted), ==, 3);
+  g_assert (exhausted);
+  g_assert_cmpint (hb_buffer_get_length (buffer), ==, 6);
+
+  /* Clearing forgets what was spent, not the budget; resetting both. */
+  hb_buffer_clear_contents (buffer);
+  g_assert_cmpint (hb_buffer_get_ops_used (buffer, &exhausted), ==, 0);
+  g_assert (!exhausted);
+  g_assert_cmpint (hb_buffer_get_max_ops (buffer), ==, 3);
+  hb_buffer_reset (buffer);
+  g_assert_cmpint (hb_buffer_get_max_ops (buffer), ==, 0);
+
+  hb_buffer_set_max_ops (hb_buffer_get_empty (), 5);
+  g_assert_cmpint (hb_buffer_get_max_ops (hb_buffer_get_empty ()), ==, 0);
+  g_assert_cmpint (hb_buffer_get_ops_used (hb_buffer_get_empty (), &exhausted), ==, 0);
+  g_assert (!exhausted);
+
+  hb_buffer_destroy (buffer);
+  hb_font_destroy (aat_font);
+  hb_font_destroy (font);
+  hb_face_destroy (aat_face);
+  hb_face_destroy (face);
+}
+
+static hb_buffer_t *
+shape_text (hb_font_t *font, const char *text)
+{
+  hb_buffer_t *buffer = hb_buffer_create ();
+  hb_buffer_add_utf8 (buffer, text, -1, 0, -1);
+  hb_buffer_guess_segment_properties (buffer);
+  hb_shape (font, buffer, NULL, 0);
+  return buffer;
+}
+
+static void
+check_same_positions (hb_buffer_t *buffer, hb_buffer_t *expected)
+{
+  unsigned int len, expected_len, i;
+  hb_glyph_info_t *info = hb_buffer_get_glyph_infos (buffer, &len);
+  hb_glyph_info_t *expected_info = hb_buffer_get_glyph_infos (expected, &expected_len);
+  hb_glyph_position_t *pos = hb_buffer_get_glyph_positions (buffer, NULL);
+  hb_glyph_position_t *expected_pos = hb_buffer_get_glyph_positions (expected, NULL);
+
+  g_assert_cmpint (len, ==, expected_len);
+  for (i = 0; i < len; i++)
+  {
+    g_assert_cmpint (info[i].codepoint, ==, expected_info[i].codepoint);
+    g_assert_cmpint (info[i].cluster, ==, expected_info[i].cluster);
+    g_assert_cmpint (pos[i].x_advance, ==, expected_pos[i].x_advance);
+    g_assert_cmpint (pos[i].y_advance, ==, expected_pos[i].y_advance);
+    g_assert_cmpint (pos[i].x_offset, ==, expected_pos[i].x_offset);
+    g_assert_cmpint (pos[i].y_offset, ==, expected_pos[i].y_offset);
+  }
+}
+
+static void
+test_shape_reposition (void)
+{
+  hb_face_t *face = hb_test_open_font_file ("fonts/Roboto-Regular.gsub.fi.ttf");
+  hb_face_t *aat_face = hb_test_open_font_file ("fonts/aat-morx.ttf");
+  hb_font_t *font = hb_font_create (face);
+  hb_font_t *aat_font = hb_font_create (aat_face);
+  hb_buffer_t *buffer, *expected;
+  unsigned int upem = hb_face_get_upem (face);
+
+  /* Positioning at a new scale matches shaping again at it. */
+  buffer = shape_text (font, "fifa");
+  g_assert_cmpint (hb_buffer_get_length (buffer), ==, 3);
+  hb_font_set_scale (font, 3 * upem, 3 * upem);
+  g_assert (hb_shape_reposition (font, buffer, NULL, 0));
+  expected = shape_text (font, "fifa");
+  check_same_positions (buffer, expected);
+  g_assert_cmpint (hb_buffer_get_glyph_positions (buffer, NULL)[0].x_advance, !=, 0);
+  hb_buffer_destroy (expected);
+
+  hb_font_set_scale (font, upem / 2, upem / 2);
+  g_assert (hb_shape_reposition (font, buffer, NULL, 0));
+  expected = shape_text (font, "fifa");
+  check_same_positions (buffer, expected);
+  hb_buffer_destroy (expected);
+  hb_buffer_destroy (buffer);
+
+  /* Glyphs morx chose must be shaped again. */
+  buffer = shape_text (aat_font, "abc");
+  g_assert (!hb_shape_reposition (aat_font, buffer, NULL, 0));
+  hb_buffer_destroy (buffer);
+
+  /* So must unshaped text; empty buffers need nothing. */
+  buffer = hb_buffer_create ();
+  g_assert (hb_shape_reposition (font, buffer, NULL, 0));
+  hb_buffer_add_utf8 (buffer, "fi", -1, 0, -1);
+  hb_buffer_guess_segment_properties (buffer);
+  g_assert (!hb_shape_reposition (font, buffer, NULL, 0));
+  hb_buffer_destroy (buffer);
+
+  hb_font_destroy (aat_font);
+  hb_font_destroy (font);
+  hb_face_destroy (aat_face);
+  hb_face_destroy (face);
+}
+
 int
 main (int argc, char **argv)
 {
@@ -203,6 +1247,20 @@ main (int argc, char **argv)
   /* TODO test fallback shaper */
   /* TODO test shaper_full */
   hb_test_add (test_shape_list);
+  hb_test_add (test_shape_incremental);
+  hb_test_add (test_shape_lines);
+  hb_test_add (test_shape_batch);
+  hb_test_add (test_shape_parallel);
+  hb_test_add (test_shape_context);
+  hb_test_add (test_shape_fallback);
+  hb_test_add (test_shape_trace);
+  hb_test_add (test_shape_plan_serialize);
+  hb_test_add (test_shape_cache);
+  hb_test_add (test_shape_cache_serialize);
+  hb_test_add (test_shape_plan_cache);
+  hb_test_add (test_shape_plan_lookup_stats);
+  hb_test_add (test_shape_max_ops);
+  hb_test_add (test_shape_reposition);
 
   return hb_test_run();
 }
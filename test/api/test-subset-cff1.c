@@ -138,6 +138,120 @@ test_subset_cff1_desubr_strip_hints (void)
   hb_face_destroy (face_ac);
 }
 
+static hb_face_t *
+create_subset_a_z (hb_face_t *face, hb_bool_t desubr, hb_bool_t resubr)
+{
+  hb_set_t *codepoints = hb_set_create ();
+  hb_subset_input_t *input;
+  hb_face_t *subset;
+  hb_blob_t *blob;
+  hb_set_add_range (codepoints, 'a', 'z');
+  input = hb_subset_test_create_input (codepoints);
+  hb_subset_input_set_desubroutinize (input, desubr);
+  hb_subset_input_set_resubroutinize (input, resubr);
+  g_assert (hb_subset_input_get_resubroutinize (input) == resubr);
+  subset = hb_subset_test_create_subset (face, input);
+  hb_set_destroy (codepoints);
+
+  /* As a font file, so that it can be subset again. */
+  blob = hb_face_reference_blob (subset);
+  hb_face_destroy (subset);
+  subset = hb_face_create (blob, 0);
+  hb_blob_destroy (blob);
+  return subset;
+}
+
+static void
+test_subset_cff1_resubr (void)
+{
+  hb_face_t *face = hb_test_open_font_file ("fonts/SourceSansPro-Regular.a-z.otf");
+  hb_face_t *face_desubr = create_subset_a_z (face, true, false);
+  hb_face_t *face_resubr = create_subset_a_z (face, false, true);
+  hb_face_t *face_resubr_desubr;
+  hb_blob_t *desubr_cff, *resubr_cff;
+
+  /* Shared sequences became subroutines... */
+  desubr_cff = hb_face_reference_table (face_desubr, HB_TAG ('C','F','F',' '));
+  resubr_cff = hb_face_reference_table (face_resubr, HB_TAG ('C','F','F',' '));
+  g_assert_cmpint (hb_blob_get_length (resubr_cff), >, 0);
+  g_assert_cmpint (hb_blob_get_length (resubr_cff), <, hb_blob_get_length (desubr_cff));
+  hb_blob_destroy (desubr_cff);
+  hb_blob_destroy (resubr_cff);
+
+  /* ...that inline back to the same charstrings. */
+  face_resubr_desubr = create_subset_a_z (face_resubr, true, false);
+  hb_subset_test_check (face_desubr, face_resubr_desubr, HB_TAG ('C','F','F',' '));
+
+  hb_face_destroy (face_resubr_desubr);
+  hb_face_destroy (face_resubr);
+  hb_face_destroy (face_desubr);
+  hb_face_destroy (face);
+}
+
+typedef struct
+{
+  unsigned int calls;
+  unsigned int jobs;
+  hb_bool_t destroyed;
+} executor_t;
+
+static void
+reverse_executor (hb_subset_job_func_t  job,
+		  void                 *job_data,
+		  unsigned int          num_jobs,
+		  void                 *user_data)
+{
+  executor_t *executor = (executor_t *) user_data;
+  executor->calls++;
+  executor->jobs += num_jobs;
+  while (num_jobs--)
+    job (job_data, num_jobs);
+}
+
+static void
+destroy_executor (void *user_data)
+{
+  ((executor_t *) user_data)->destroyed = TRUE;
+}
+
+static void
+test_subset_cff1_executor (void)
+{
+  hb_face_t *face_abc = hb_test_open_font_file ("fonts/SourceSansPro-Regular.abc.otf");
+  hb_face_t *face_ac = hb_test_open_font_file ("fonts/SourceSansPro-Regular.ac.nosubrs.otf");
+
+  hb_set_t *codepoints = hb_set_create ();
+  hb_subset_input_t *input;
+  hb_subset_plan_t *plan;
+  hb_face_t *face_abc_subset, *expected;
+  executor_t executor = {0, 0, FALSE};
+  hb_set_add (codepoints, 'a');
+  hb_set_add (codepoints, 'c');
+  input = hb_subset_test_create_input (codepoints);
+  hb_subset_input_set_desubroutinize (input, true);
+  plan = hb_subset_plan_create (face_abc, input);
+  hb_subset_plan_set_executor_func (plan, reverse_executor, &executor, destroy_executor);
+  face_abc_subset = hb_subset_plan_execute (plan);
+  g_assert_cmpint (executor.calls, ==, 1);
+  g_assert_cmpint (executor.jobs, >, 1);
+  hb_subset_plan_destroy (plan);
+  g_assert (executor.destroyed);
+
+  /* Tables come out as when subset one after the other. */
+  expected = hb_subset_test_create_subset (face_abc, input);
+  hb_set_destroy (codepoints);
+
+  hb_subset_test_check (face_ac, face_abc_subset, HB_TAG ('C','F','F',' '));
+  hb_subset_test_check (expected, face_abc_subset, HB_TAG ('c','m','a','p'));
+  hb_subset_test_check (expected, face_abc_subset, HB_TAG ('h','m','t','x'));
+  hb_subset_test_check (expected, face_abc_subset, HB_TAG ('m','a','x','p'));
+
+  hb_face_destroy (expected);
+  hb_face_destroy (face_abc_subset);
+  hb_face_destroy (face_abc);
+  hb_face_destroy (face_ac);
+}
+
 static void
 test_subset_cff1_j (void)
 {
@@ -300,6 +414,8 @@ main (int argc, char **argv)
   hb_test_add (test_subset_cff1_strip_hints);
   hb_test_add (test_subset_cff1_desubr);
   hb_test_add (test_subset_cff1_desubr_strip_hints);
+  hb_test_add (test_subset_cff1_resubr);
+  hb_test_add (test_subset_cff1_executor);
   hb_test_add (test_subset_cff1_j);
   hb_test_add (test_subset_cff1_j_strip_hints);
   hb_test_add (test_subset_cff1_j_desubr);
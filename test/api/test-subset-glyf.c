@@ -259,6 +259,187 @@ test_subset_glyf_strip_hints_invalid (void)
 
 // TODO(grieger): test for long loca generation.
 
+static hb_face_t *
+create_retain_gids_subset (hb_face_t *source, const hb_set_t *codepoints)
+{
+  hb_subset_input_t *input = hb_subset_test_create_input (codepoints);
+  hb_subset_input_set_retain_gids (input, true);
+  return hb_subset_test_create_subset (source, input);
+}
+
+static void
+test_subset_glyf_merge_patch (void)
+{
+  hb_face_t *face_abc = hb_test_open_font_file ("fonts/Roboto-Regular.abc.ttf");
+
+  hb_set_t *codepoints = hb_set_create ();
+  hb_set_add (codepoints, 97);
+  hb_set_add (codepoints, 99);
+  hb_face_t *face_ac_subset = create_retain_gids_subset (face_abc, codepoints);
+  hb_set_add (codepoints, 98);
+  hb_face_t *face_abc_subset = create_retain_gids_subset (face_abc, codepoints);
+
+  /* The client has a and c; the patch brings b. */
+  hb_subset_input_t *input = hb_subset_test_create_input (codepoints);
+  hb_subset_input_set_retain_gids (input, true);
+  hb_subset_plan_t *plan = hb_subset_plan_create (face_abc, input);
+  hb_subset_input_destroy (input);
+  hb_set_t *have_glyphs = hb_set_create ();
+  hb_set_add (have_glyphs, 0);
+  hb_set_add (have_glyphs, 1);
+  hb_set_add (have_glyphs, 3);
+  hb_face_t *patch = hb_subset_plan_execute_patch (plan, have_glyphs);
+  hb_set_destroy (have_glyphs);
+  hb_subset_plan_destroy (plan);
+  hb_set_destroy (codepoints);
+
+  hb_face_t *merged = hb_subset_merge_glyphs (face_ac_subset, patch);
+  g_assert_cmpuint (hb_face_get_glyph_count (merged), ==, 4);
+  hb_subset_test_check (face_abc_subset, merged, HB_TAG ('g','l','y','f'));
+  hb_subset_test_check (face_abc_subset, merged, HB_TAG ('l','o','c','a'));
+  hb_subset_test_check (face_abc_subset, merged, HB_TAG ('h','m','t','x'));
+  hb_subset_test_check (face_abc_subset, merged, HB_TAG ('c','m','a','p'));
+  check_maxp_num_glyphs (merged, 4, true);
+
+  hb_face_destroy (merged);
+  hb_face_destroy (patch);
+  hb_face_destroy (face_abc_subset);
+  hb_face_destroy (face_ac_subset);
+  hb_face_destroy (face_abc);
+}
+
+static void
+test_subset_glyf_plan (void)
+{
+  hb_face_t *face_abc = hb_test_open_font_file ("fonts/Roboto-Regular.abc.ttf");
+  hb_face_t *face_ac = hb_test_open_font_file ("fonts/Roboto-Regular.ac.ttf");
+  hb_set_t *codepoints = hb_set_create ();
+  hb_set_t *glyphs = hb_set_create ();
+  hb_subset_input_t *input;
+  hb_subset_plan_t *plan, *by_glyph;
+  hb_face_t *face_a_subset, *face_ac_subset, *face_ac_by_glyph;
+
+  hb_set_add (codepoints, 97);
+  input = hb_subset_test_create_input (codepoints);
+  plan = hb_subset_plan_create (face_abc, input);
+  by_glyph = hb_subset_plan_create (face_abc, input);
+  hb_subset_input_destroy (input);
+  g_assert (hb_subset_plan_reference (plan) == plan);
+  hb_subset_plan_destroy (plan);
+
+  face_a_subset = hb_subset_plan_execute (plan);
+  check_maxp_num_glyphs (face_a_subset, 2, true);
+
+  /* Extended, the same plan subsets to more. */
+  hb_set_clear (codepoints);
+  hb_set_add (codepoints, 99);
+  hb_subset_plan_add_unicodes (plan, codepoints);
+  face_ac_subset = hb_subset_plan_execute (plan);
+  hb_subset_test_check (face_ac, face_ac_subset, HB_TAG ('g','l','y','f'));
+  hb_subset_test_check (face_ac, face_ac_subset, HB_TAG ('l','o','c','a'));
+  check_maxp_num_glyphs (face_ac_subset, 3, true);
+
+  /* Glyph 3 is c. */
+  hb_set_add (glyphs, 3);
+  hb_subset_plan_add_glyphs (by_glyph, glyphs);
+  face_ac_by_glyph = hb_subset_plan_execute (by_glyph);
+  hb_subset_test_check (face_ac, face_ac_by_glyph, HB_TAG ('g','l','y','f'));
+  hb_subset_test_check (face_ac, face_ac_by_glyph, HB_TAG ('l','o','c','a'));
+  check_maxp_num_glyphs (face_ac_by_glyph, 3, true);
+
+  hb_face_destroy (face_ac_by_glyph);
+  hb_face_destroy (face_ac_subset);
+  hb_face_destroy (face_a_subset);
+  hb_subset_plan_destroy (by_glyph);
+  hb_subset_plan_destroy (plan);
+  hb_set_destroy (glyphs);
+  hb_set_destroy (codepoints);
+  hb_face_destroy (face_ac);
+  hb_face_destroy (face_abc);
+}
+
+static void
+check_retained_glyphs (hb_face_t *source, hb_face_t *subset,
+		       const bool *outlines, const bool *advances,
+		       unsigned int count)
+{
+  hb_font_t *source_font = hb_font_create (source);
+  hb_font_t *subset_font = hb_font_create (subset);
+  unsigned int gid;
+
+  check_maxp_num_glyphs (subset, count, true);
+  for (gid = 0; gid < count; gid++)
+  {
+    hb_glyph_extents_t source_extents, subset_extents;
+    hb_font_get_glyph_extents (source_font, gid, &source_extents);
+    hb_font_get_glyph_extents (subset_font, gid, &subset_extents);
+    g_assert_cmpint (subset_extents.width, ==, outlines[gid] ? source_extents.width : 0);
+    g_assert_cmpint (subset_extents.height, ==, outlines[gid] ? source_extents.height : 0);
+    g_assert_cmpint (hb_font_get_glyph_h_advance (subset_font, gid), ==,
+		     advances[gid] ? hb_font_get_glyph_h_advance (source_font, gid) : 0);
+  }
+
+  hb_font_destroy (subset_font);
+  hb_font_destroy (source_font);
+}
+
+static void
+test_subset_glyf_retain_gids (void)
+{
+  /* Glyphs 1, 2 and 3 are a, b and c. */
+  static const bool a_only[] = {true, true};
+  static const bool a_and_c[] = {true, true, false, true};
+  static const bool c_only[] = {true, false, false, true};
+  hb_face_t *face_abc = hb_test_open_font_file ("fonts/Roboto-Regular.abc.ttf");
+  hb_set_t *codepoints = hb_set_create ();
+  hb_set_t *have_glyphs = hb_set_create ();
+  hb_subset_input_t *input;
+  hb_subset_plan_t *plan;
+  hb_face_t *face_a, *face_ac, *patch;
+  hb_font_t *font;
+  hb_codepoint_t glyph;
+
+  hb_set_add (codepoints, 'a');
+  input = hb_subset_test_create_input (codepoints);
+  g_assert (!hb_subset_input_get_retain_gids (input));
+  hb_subset_input_set_retain_gids (input, true);
+  g_assert (hb_subset_input_get_retain_gids (input));
+  face_a = hb_subset (face_abc, input);
+  check_retained_glyphs (face_abc, face_a, a_only, a_only, 2);
+
+  /* Glyphs keep their ids; the ones in between are empty. */
+  hb_set_add (codepoints, 'c');
+  hb_set_union (hb_subset_input_unicode_set (input), codepoints);
+  face_ac = hb_subset (face_abc, input);
+  check_retained_glyphs (face_abc, face_ac, a_and_c, a_and_c, 4);
+  font = hb_font_create (face_ac);
+  g_assert (hb_font_get_nominal_glyph (font, 'c', &glyph));
+  g_assert_cmpuint (glyph, ==, 3);
+  hb_font_destroy (font);
+
+  /* A patch leaves out the outlines the client has, but not their
+   * metrics. */
+  plan = hb_subset_plan_create (face_abc, input);
+  hb_set_add (have_glyphs, 1);
+  patch = hb_subset_plan_execute_patch (plan, have_glyphs);
+  check_retained_glyphs (face_abc, patch, c_only, a_and_c, 4);
+  hb_face_destroy (patch);
+  hb_subset_plan_destroy (plan);
+
+  /* Patches need retained glyph ids. */
+  hb_subset_input_set_retain_gids (input, false);
+  plan = hb_subset_plan_create (face_abc, input);
+  g_assert (hb_subset_plan_execute_patch (plan, have_glyphs) == hb_face_get_empty ());
+  hb_subset_plan_destroy (plan);
+
+  hb_subset_input_destroy (input);
+  hb_face_destroy (face_ac);
+  hb_face_destroy (face_a);
+  hb_set_destroy (have_glyphs);
+  hb_set_destroy (codepoints);
+  hb_face_destroy (face_abc);
+}
+
 int
 main (int argc, char **argv)
 {
@@ -272,6 +453,9 @@ main (int argc, char **argv)
   hb_test_add (test_subset_glyf_with_components);
   hb_test_add (test_subset_glyf_with_gsub);
   hb_test_add (test_subset_glyf_without_gsub);
+  hb_test_add (test_subset_glyf_merge_patch);
+  hb_test_add (test_subset_glyf_plan);
+  hb_test_add (test_subset_glyf_retain_gids);
 
   return hb_test_run();
 }
@@ -0,0 +1,89 @@
+/*
+ * Copyright © 2018  Google, Inc.
+ *
+ *  This is part of HarfBuzz, a text shaping library.
+ *
+ * Permission is hereby granted, without written agreement and without
+ * license or royalty fees, to use, copy, modify, and distribute this
+ * software and its documentation for any purpose, provided that the
+ * above copyright notice and the following two paragraphs appear in
+ * all copies of this software.
+ *
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE TO ANY PARTY FOR
+ * DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES
+ * ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION, EVEN
+ * IF THE COPYRIGHT HOLDER HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * THE COPYRIGHT HOLDER SPECIFICALLY DISCLAIMS ANY WARRANTIES, INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER IS
+ * ON AN "AS IS" BASIS, AND THE COPYRIGHT HOLDER HAS NO OBLIGATION TO
+ * PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+ */
+
+#include "hb-test.h"
+
+#include "hb-uniscribe.h"
+
+/* Unit tests for hb-uniscribe.h */
+
+static const char *uniscribe_shapers[] = {"uniscribe", NULL};
+
+static void
+check_shape_abc (hb_font_t *font)
+{
+  hb_buffer_t *buffer = hb_buffer_create ();
+  hb_glyph_info_t *infos;
+  unsigned int len, i;
+
+  hb_buffer_add_utf8 (buffer, "abcabc", -1, 0, -1);
+  hb_buffer_guess_segment_properties (buffer);
+  g_assert (hb_shape_full (font, buffer, NULL, 0, uniscribe_shapers));
+
+  infos = hb_buffer_get_glyph_infos (buffer, &len);
+  g_assert_cmpuint (len, ==, 6);
+  for (i = 0; i < len; i++)
+  {
+    g_assert_cmpuint (infos[i].codepoint, ==, i % 3 + 1);
+    g_assert_cmpuint (infos[i].cluster, ==, i);
+  }
+
+  hb_buffer_destroy (buffer);
+}
+
+static void
+test_uniscribe_free_script_cache (void)
+{
+  hb_face_t *face = hb_test_open_font_file ("fonts/Roboto-Regular.abc.ttf");
+  hb_font_t *font = hb_font_create (face);
+
+  /* Nothing to free before the font is shaped with. */
+  hb_uniscribe_font_free_script_cache (font);
+  hb_uniscribe_font_free_script_cache (hb_font_get_empty ());
+
+  /* Shaping the same text again goes through the itemization cache. */
+  check_shape_abc (font);
+  check_shape_abc (font);
+  g_assert (hb_uniscribe_font_get_hfont (font) != NULL);
+
+  /* The caches are rebuilt after being freed. */
+  hb_uniscribe_font_free_script_cache (font);
+  check_shape_abc (font);
+  hb_uniscribe_font_free_script_cache (font);
+  hb_uniscribe_font_free_script_cache (font);
+  check_shape_abc (font);
+
+  hb_font_destroy (font);
+  hb_face_destroy (face);
+}
+
+int
+main (int argc, char **argv)
+{
+  hb_test_init (&argc, &argv);
+
+  hb_test_add (test_uniscribe_free_script_cache);
+
+  return hb_test_run ();
+}
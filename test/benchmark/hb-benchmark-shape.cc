@@ -0,0 +1,437 @@
+/*
+ * Copyright © 2018  Google, Inc.
+ *
+ *  This is part of HarfBuzz, a text shaping library.
+ *
+ * Permission is hereby granted, without written agreement and without
+ * license or royalty fees, to use, copy, modify, and distribute this
+ * software and its documentation for any purpose, provided that the
+ * above copyright notice and the following two paragraphs appear in
+ * all copies of this software.
+ *
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE TO ANY PARTY FOR
+ * DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES
+ * ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION, EVEN
+ * IF THE COPYRIGHT HOLDER HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * THE COPYRIGHT HOLDER SPECIFICALLY DISCLAIMS ANY WARRANTIES, INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER IS
+ * ON AN "AS IS" BASIS, AND THE COPYRIGHT HOLDER HAS NO OBLIGATION TO
+ * PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+ */
+
+/*
+ * Shaping benchmark.
+ *
+ * Reads the test cases of test/shaping/data/{name}/tests/{name}.tests files
+ * (each line is font:options:unicodes:expected) and shapes them repeatedly,
+ * reporting ns/glyph for every script found in the corpus, for every shaper,
+ * at every requested thread count.  ns/glyph is CPU time per glyph: wall
+ * time times number of threads, divided by glyphs shaped, so contention
+ * shows up as the number growing with the thread count.
+ *
+ * Usage:
+ *   hb-benchmark-shape [--threads=1,2,4] [--shapers=ot,fallback]
+ *                      [--min-time=MSEC] FILE.tests...
+ */
+
+#include "hb-benchmark.hh"
+
+#include <pthread.h>
+
+
+#define MAX_THREADS 64
+#define MAX_FEATURES 32
+
+struct font_entry_t
+{
+  char *key; /* Path, face index, size and variations. */
+  hb_font_t *font;
+};
+
+struct bench_case_t
+{
+  hb_font_t *font;
+  hb_codepoint_t *text;
+  unsigned int text_len;
+  hb_feature_t features[MAX_FEATURES];
+  unsigned int num_features;
+  hb_segment_properties_t props;
+};
+
+static font_entry_t *fonts;
+static unsigned int num_fonts;
+static bench_case_t *cases;
+static unsigned int num_cases;
+
+
+static hb_font_t *
+get_font (const char *path, unsigned int face_index,
+	  int font_size, const char *variations)
+{
+  char key[1024];
+  snprintf (key, sizeof (key), "%s|%u|%d|%s", path, face_index, font_size, variations);
+  for (unsigned int i = 0; i < num_fonts; i++)
+    if (0 == strcmp (fonts[i].key, key))
+      return fonts[i].font;
+
+  hb_blob_t *blob = hb_blob_create_from_file (path);
+  if (!hb_blob_get_length (blob))
+  {
+    hb_blob_destroy (blob);
+    return nullptr;
+  }
+  hb_face_t *face = hb_face_create (blob, face_index);
+  hb_blob_destroy (blob);
+  hb_font_t *font = hb_font_create (face);
+  hb_face_destroy (face);
+
+  if (font_size)
+    hb_font_set_scale (font, font_size, font_size);
+
+  hb_variation_t vars[MAX_FEATURES];
+  unsigned int num_vars = 0;
+  for (const char *p = variations; *p && num_vars < MAX_FEATURES; )
+  {
+    const char *end = strchr (p, ',');
+    int len = end ? end - p : -1;
+    if (hb_variation_from_string (p, len, &vars[num_vars]))
+      num_vars++;
+    if (!end)
+      break;
+    p = end + 1;
+  }
+  if (num_vars)
+    hb_font_set_variations (font, vars, num_vars);
+  hb_font_make_immutable (font);
+
+  fonts = (font_entry_t *) realloc (fonts, (num_fonts + 1) * sizeof (fonts[0]));
+  fonts[num_fonts].key = strdup (key);
+  fonts[num_fonts].font = font;
+  num_fonts++;
+  return font;
+}
+
+/* Returns false if the line isn't a usable test case. */
+static bool
+parse_case (const char *tests_dir, char *line, bench_case_t *c)
+{
+  char *fields[4];
+  for (unsigned int i = 0; i < 4; i++)
+  {
+    fields[i] = line;
+    line = strchr (line, ':');
+    if (!line)
+    {
+      if (i < 2)
+	return false;
+      for (i++; i < 4; i++)
+	fields[i] = (char *) "";
+      break;
+    }
+    *line++ = '\0';
+  }
+
+  memset (c, 0, sizeof (*c));
+  unsigned int face_index = 0;
+  int font_size = 0;
+  const char *variations = "";
+  for (char *opt = strtok (fields[1], " "); opt; opt = strtok (nullptr, " "))
+  {
+    char *value = strchr (opt, '=');
+    if (value)
+      *value++ = '\0';
+    else
+      value = (char *) "";
+
+    if (0 == strcmp (opt, "--direction"))
+      c->props.direction = hb_direction_from_string (value, -1);
+    else if (0 == strcmp (opt, "--script"))
+      c->props.script = hb_script_from_string (value, -1);
+    else if (0 == strcmp (opt, "--language"))
+      c->props.language = hb_language_from_string (value, -1);
+    else if (0 == strcmp (opt, "--face-index"))
+      face_index = atoi (value);
+    else if (0 == strcmp (opt, "--font-size"))
+      font_size = atoi (value);
+    else if (0 == strcmp (opt, "--variations"))
+      variations = value;
+    else if (0 == strcmp (opt, "--features"))
+    {
+      for (char *p = value; *p && c->num_features < MAX_FEATURES; )
+      {
+	char *end = strchr (p, ',');
+	int len = end ? end - p : -1;
+	if (hb_feature_from_string (p, len, &c->features[c->num_features]))
+	  c->num_features++;
+	if (!end)
+	  break;
+	p = end + 1;
+      }
+    }
+  }
+
+  char path[1024];
+  snprintf (path, sizeof (path), "%s/%s", tests_dir, fields[0]);
+  c->font = get_font (path, face_index, font_size, variations);
+  if (!c->font)
+    return false;
+
+  for (char *p = fields[2]; *p; )
+  {
+    if (p[0] == 'U' && p[1] == '+')
+      p += 2;
+    char *end;
+    unsigned long u = strtoul (p, &end, 16);
+    if (end == p)
+      break;
+    c->text = (hb_codepoint_t *) realloc (c->text, (c->text_len + 1) * sizeof (c->text[0]));
+    c->text[c->text_len++] = u;
+    p = *end == ',' ? end + 1 : end;
+  }
+  if (!c->text_len)
+    return false;
+
+  /* Fill in whatever the options didn't specify. */
+  hb_buffer_t *buffer = hb_buffer_create ();
+  hb_buffer_add_codepoints (buffer, c->text, c->text_len, 0, -1);
+  hb_buffer_set_segment_properties (buffer, &c->props);
+  hb_buffer_guess_segment_properties (buffer);
+  hb_buffer_get_segment_properties (buffer, &c->props);
+  hb_buffer_destroy (buffer);
+
+  return true;
+}
+
+static void
+load_tests (const char *tests_path)
+{
+  char *data = hb_benchmark_read_file (tests_path);
+  if (!data)
+  {
+    fprintf (stderr, "Failed to read %s\n", tests_path);
+    return;
+  }
+
+  char tests_dir[1024];
+  snprintf (tests_dir, sizeof (tests_dir), "%s", tests_path);
+  char *slash = strrchr (tests_dir, '/');
+  if (slash)
+    *slash = '\0';
+  else
+    strcpy (tests_dir, ".");
+
+  for (char *line = data; line; )
+  {
+    char *next = strchr (line, '\n');
+    if (next)
+      *next++ = '\0';
+
+    if (line[0] && line[0] != '#')
+    {
+      cases = (bench_case_t *) realloc (cases, (num_cases + 1) * sizeof (cases[0]));
+      if (parse_case (tests_dir, line, &cases[num_cases]))
+	num_cases++;
+    }
+
+    line = next;
+  }
+
+  free (data);
+}
+
+
+/*
+ * Running.
+ */
+
+struct run_t
+{
+  const bench_case_t **cases;
+  unsigned int num_cases;
+  const char *shaper_list[2];
+  unsigned int iterations;
+};
+
+static void *
+run_thread (void *arg)
+{
+  const run_t *run = (const run_t *) arg;
+  hb_buffer_t *buffer = hb_buffer_create ();
+  for (unsigned int n = 0; n < run->iterations; n++)
+    for (unsigned int i = 0; i < run->num_cases; i++)
+    {
+      const bench_case_t *c = run->cases[i];
+      hb_buffer_clear_contents (buffer);
+      hb_buffer_add_codepoints (buffer, c->text, c->text_len, 0, -1);
+      hb_buffer_set_segment_properties (buffer, &c->props);
+      hb_shape_full (c->font, buffer, c->features, c->num_features, run->shaper_list);
+    }
+  hb_buffer_destroy (buffer);
+  return nullptr;
+}
+
+/* Returns wall time, in nanoseconds. */
+static unsigned long long
+run_threads (run_t *run, unsigned int num_threads)
+{
+  pthread_t threads[MAX_THREADS];
+  unsigned long long start = hb_benchmark_now_ns ();
+  for (unsigned int i = 0; i < num_threads; i++)
+    pthread_create (&threads[i], nullptr, run_thread, run);
+  for (unsigned int i = 0; i < num_threads; i++)
+    pthread_join (threads[i], nullptr);
+  return hb_benchmark_now_ns () - start;
+}
+
+static void
+bench (const char *script_name,
+       const bench_case_t **group, unsigned int group_len,
+       const char *shaper,
+       const unsigned int *thread_counts, unsigned int num_thread_counts,
+       unsigned long long min_time_ns)
+{
+  run_t run;
+  run.cases = group;
+  run.num_cases = group_len;
+  run.shaper_list[0] = shaper;
+  run.shaper_list[1] = nullptr;
+
+  /* Warm up caches and shape plans, count glyphs per iteration, and pick
+   * an iteration count. */
+  unsigned long long glyphs_per_iteration = 0;
+  unsigned long long start = hb_benchmark_now_ns ();
+  hb_buffer_t *buffer = hb_buffer_create ();
+  for (unsigned int i = 0; i < group_len; i++)
+  {
+    const bench_case_t *c = group[i];
+    hb_buffer_clear_contents (buffer);
+    hb_buffer_add_codepoints (buffer, c->text, c->text_len, 0, -1);
+    hb_buffer_set_segment_properties (buffer, &c->props);
+    hb_shape_full (c->font, buffer, c->features, c->num_features, run.shaper_list);
+    glyphs_per_iteration += hb_buffer_get_length (buffer);
+  }
+  hb_buffer_destroy (buffer);
+  unsigned long long once = hb_benchmark_now_ns () - start;
+  run.iterations = once ? (min_time_ns + once - 1) / once : 1000;
+  if (!run.iterations)
+    run.iterations = 1;
+
+  for (unsigned int t = 0; t < num_thread_counts; t++)
+  {
+    unsigned int num_threads = thread_counts[t];
+    unsigned long long wall = run_threads (&run, num_threads);
+    unsigned long long glyphs = glyphs_per_iteration * run.iterations * num_threads;
+    printf ("%-6s %-10s %3u %12llu %10.1f\n",
+	    script_name, shaper, num_threads, glyphs,
+	    glyphs ? (double) wall * num_threads / glyphs : 0.);
+  }
+}
+
+int
+main (int argc, char **argv)
+{
+  unsigned int thread_counts[MAX_THREADS] = {1, 2, 4};
+  unsigned int num_thread_counts = 3;
+  const char *shapers_option = nullptr;
+  unsigned long long min_time_ns = 50 * 1000000ull;
+
+  int i;
+  for (i = 1; i < argc && 0 == strncmp (argv[i], "--", 2); i++)
+  {
+    if (0 == strncmp (argv[i], "--threads=", 10))
+      num_thread_counts = hb_benchmark_parse_uint_list (argv[i] + 10, thread_counts, MAX_THREADS);
+    else if (0 == strncmp (argv[i], "--shapers=", 10))
+      shapers_option = argv[i] + 10;
+    else if (0 == strncmp (argv[i], "--min-time=", 11))
+      min_time_ns = strtoull (argv[i] + 11, nullptr, 10) * 1000000ull;
+    else
+    {
+      fprintf (stderr, "Unknown option %s\n", argv[i]);
+      return 1;
+    }
+  }
+  if (i == argc)
+  {
+    fprintf (stderr, "Usage: %s [--threads=1,2,4] [--shapers=ot,fallback] [--min-time=MSEC] FILE.tests...\n", argv[0]);
+    return 1;
+  }
+  for (unsigned int t = 0; t < num_thread_counts; t++)
+    if (thread_counts[t] > MAX_THREADS)
+      thread_counts[t] = MAX_THREADS;
+
+  for (; i < argc; i++)
+    load_tests (argv[i]);
+  if (!num_cases)
+  {
+    fprintf (stderr, "No test cases loaded\n");
+    return 1;
+  }
+
+  const char *shapers[16];
+  unsigned int num_shapers = 0;
+  char *shapers_copy = nullptr;
+  if (shapers_option)
+  {
+    shapers_copy = strdup (shapers_option);
+    for (char *s = strtok (shapers_copy, ","); s && num_shapers < 16; s = strtok (nullptr, ","))
+      shapers[num_shapers++] = s;
+  }
+  else
+  {
+    for (const char **s = hb_shape_list_shapers (); *s && num_shapers < 16; s++)
+      shapers[num_shapers++] = *s;
+  }
+
+  /* Group cases by script. */
+  const bench_case_t **group = (const bench_case_t **) malloc (num_cases * sizeof (group[0]));
+  hb_script_t *scripts = (hb_script_t *) malloc (num_cases * sizeof (scripts[0]));
+  unsigned int num_scripts = 0;
+  for (unsigned int j = 0; j < num_cases; j++)
+  {
+    unsigned int k;
+    for (k = 0; k < num_scripts; k++)
+      if (scripts[k] == cases[j].props.script)
+	break;
+    if (k == num_scripts)
+      scripts[num_scripts++] = cases[j].props.script;
+  }
+
+  printf ("%-6s %-10s %3s %12s %10s\n", "script", "shaper", "thr", "glyphs", "ns/glyph");
+  for (unsigned int k = 0; k <= num_scripts; k++)
+  {
+    char script_name[5] = "all";
+    unsigned int group_len = 0;
+    for (unsigned int j = 0; j < num_cases; j++)
+      if (k == num_scripts || cases[j].props.script == scripts[k])
+	group[group_len++] = &cases[j];
+    if (k < num_scripts && scripts[k] == HB_SCRIPT_INVALID)
+      strcpy (script_name, "none");
+    else if (k < num_scripts)
+    {
+      hb_tag_to_string (hb_script_to_iso15924_tag (scripts[k]), script_name);
+      script_name[4] = '\0';
+    }
+
+    for (unsigned int s = 0; s < num_shapers; s++)
+      bench (script_name, group, group_len, shapers[s],
+	     thread_counts, num_thread_counts, min_time_ns);
+  }
+
+  free (scripts);
+  free (group);
+  free (shapers_copy);
+  for (unsigned int j = 0; j < num_cases; j++)
+    free (cases[j].text);
+  free (cases);
+  for (unsigned int j = 0; j < num_fonts; j++)
+  {
+    hb_font_destroy (fonts[j].font);
+    free (fonts[j].key);
+  }
+  free (fonts);
+
+  return 0;
+}
@@ -0,0 +1,292 @@
+/*
+ * Copyright © 2018  Google, Inc.
+ *
+ *  This is part of HarfBuzz, a text shaping library.
+ *
+ * Permission is hereby granted, without written agreement and without
+ * license or royalty fees, to use, copy, modify, and distribute this
+ * software and its documentation for any purpose, provided that the
+ * above copyright notice and the following two paragraphs appear in
+ * all copies of this software.
+ *
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE TO ANY PARTY FOR
+ * DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES
+ * ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION, EVEN
+ * IF THE COPYRIGHT HOLDER HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * THE COPYRIGHT HOLDER SPECIFICALLY DISCLAIMS ANY WARRANTIES, INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER IS
+ * ON AN "AS IS" BASIS, AND THE COPYRIGHT HOLDER HAS NO OBLIGATION TO
+ * PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+ */
+
+/*
+ * Subsetting benchmark.
+ *
+ * For every font and every requested subset size, picks that many
+ * codepoints spread evenly over the font's cmap and runs the steps of
+ * hb_subset() one at a time: hb_subset_plan_create() followed by each
+ * table.  Reports time and bytes allocated for each step, averaged over
+ * the iterations.
+ *
+ * This uses library internals, so it must be linked against the static
+ * libraries.
+ *
+ * Usage:
+ *   hb-benchmark-subset [--sizes=10,100,1000] [--iterations=N]
+ *                       [--drop-layout] [--drop-hints] [--desubroutinize]
+ *                       [--resubroutinize] [--retain-gids] FONT...
+ */
+
+#include "hb-benchmark.hh"
+
+#include "hb-subset.hh"
+#include "hb-subset-plan.hh"
+
+
+/*
+ * Allocation accounting.  Counts bytes HarfBuzz requests, through
+ * hb_set_allocator_funcs().
+ */
+
+/* hb.hh routes these to hb_malloc() and friends; we want the C library's. */
+#undef malloc
+#undef calloc
+#undef realloc
+#undef free
+
+static bool have_alloc_stats;
+static unsigned long long allocated_bytes;
+
+static void *
+counting_malloc (size_t size, void *user_data HB_UNUSED)
+{
+  allocated_bytes += size;
+  return malloc (size);
+}
+
+static void *
+counting_calloc (size_t nmemb, size_t size, void *user_data HB_UNUSED)
+{
+  allocated_bytes += (unsigned long long) nmemb * size;
+  return calloc (nmemb, size);
+}
+
+static void *
+counting_realloc (void *ptr, size_t size, void *user_data HB_UNUSED)
+{
+  allocated_bytes += size;
+  return realloc (ptr, size);
+}
+
+static void
+counting_free (void *ptr, void *user_data HB_UNUSED)
+{
+  free (ptr);
+}
+
+
+#define MAX_SIZES 16
+#define MAX_STEPS 64
+
+struct step_t
+{
+  char name[16];
+  unsigned long long ns;
+  unsigned long long bytes;
+};
+
+static step_t steps[MAX_STEPS];
+static unsigned int num_steps;
+
+static step_t *
+get_step (const char *name)
+{
+  for (unsigned int i = 0; i < num_steps; i++)
+    if (0 == strcmp (steps[i].name, name))
+      return &steps[i];
+  if (num_steps == MAX_STEPS)
+    return &steps[MAX_STEPS - 1];
+  step_t *step = &steps[num_steps++];
+  snprintf (step->name, sizeof (step->name), "%s", name);
+  step->ns = step->bytes = 0;
+  return step;
+}
+
+struct step_timer_t
+{
+  step_timer_t (const char *name) :
+    step (get_step (name)),
+    start_bytes (allocated_bytes),
+    start_ns (hb_benchmark_now_ns ()) {}
+  ~step_timer_t ()
+  {
+    step->ns += hb_benchmark_now_ns () - start_ns;
+    step->bytes += allocated_bytes - start_bytes;
+  }
+
+  step_t *step;
+  unsigned long long start_bytes;
+  unsigned long long start_ns;
+};
+
+/* Mirrors hb_subset(), timing each step. */
+static bool
+subset_once (hb_face_t *face, hb_subset_input_t *input)
+{
+  step_timer_t total ("total");
+
+  hb_subset_plan_t *plan;
+  {
+    step_timer_t t ("plan");
+    plan = hb_subset_plan_create (face, input);
+  }
+
+  hb_tag_t table_tags[32];
+  unsigned int offset = 0, count;
+  bool success = true;
+  do {
+    count = ARRAY_LENGTH (table_tags);
+    hb_face_get_table_tags (face, offset, &count, table_tags);
+    for (unsigned int i = 0; i < count; i++)
+    {
+      hb_tag_t tag = table_tags[i];
+      if (_hb_subset_should_drop_table (plan, tag))
+	continue;
+
+      char name[5];
+      hb_tag_to_string (tag, name);
+      name[4] = '\0';
+      step_timer_t t (name);
+      success = success && _hb_subset_table (plan, tag);
+    }
+    offset += count;
+  } while (success && count == ARRAY_LENGTH (table_tags));
+
+  {
+    step_timer_t t ("plan-destroy");
+    hb_subset_plan_destroy (plan);
+  }
+  return success;
+}
+
+static void
+bench_font (const char *path, const unsigned int *sizes, unsigned int num_sizes,
+	    unsigned int iterations, hb_subset_input_t *template_input)
+{
+  hb_blob_t *blob = hb_blob_create_from_file (path);
+  hb_face_t *face = hb_face_create (blob, 0);
+  hb_blob_destroy (blob);
+
+  hb_set_t *unicodes = hb_set_create ();
+  hb_face_collect_unicodes (face, unicodes);
+  unsigned int num_unicodes = hb_set_get_population (unicodes);
+  if (!num_unicodes)
+  {
+    fprintf (stderr, "%s: no cmap, skipping\n", path);
+    hb_set_destroy (unicodes);
+    hb_face_destroy (face);
+    return;
+  }
+
+  const char *font_name = strrchr (path, '/');
+  font_name = font_name ? font_name + 1 : path;
+
+  unsigned int last_size = 0;
+  for (unsigned int s = 0; s < num_sizes; s++)
+  {
+    unsigned int size = sizes[s] < num_unicodes ? sizes[s] : num_unicodes;
+    if (size == last_size)
+      continue;
+    last_size = size;
+
+    hb_subset_input_t *input = hb_subset_input_create_or_fail ();
+    hb_subset_input_set_drop_hints (input, hb_subset_input_get_drop_hints (template_input));
+    hb_subset_input_set_drop_layout (input, hb_subset_input_get_drop_layout (template_input));
+    hb_subset_input_set_desubroutinize (input, hb_subset_input_get_desubroutinize (template_input));
+    hb_subset_input_set_resubroutinize (input, hb_subset_input_get_resubroutinize (template_input));
+    hb_subset_input_set_retain_gids (input, hb_subset_input_get_retain_gids (template_input));
+
+    /* Every (num_unicodes / size)th codepoint. */
+    hb_set_t *input_unicodes = hb_subset_input_unicode_set (input);
+    hb_codepoint_t u = HB_SET_VALUE_INVALID;
+    unsigned int i = 0, picked = 0;
+    while (hb_set_next (unicodes, &u) && picked < size)
+      if ((unsigned long long) i++ * size / num_unicodes == picked)
+      {
+	hb_set_add (input_unicodes, u);
+	picked++;
+      }
+
+    num_steps = 0;
+    /* Warm up the source face's lazy tables. */
+    bool success = subset_once (face, input);
+    num_steps = 0;
+    for (unsigned int n = 0; n < iterations; n++)
+      success = subset_once (face, input) && success;
+    hb_subset_input_destroy (input);
+
+    printf ("%s: %u codepoints%s\n", font_name, picked, success ? "" : " (FAILED)");
+    for (unsigned int j = 0; j < num_steps; j++)
+    {
+      printf ("  %-14s %12.1f us", steps[j].name, steps[j].ns / 1000. / iterations);
+      if (have_alloc_stats)
+	printf (" %12llu bytes", steps[j].bytes / iterations);
+      printf ("\n");
+    }
+  }
+
+  hb_set_destroy (unicodes);
+  hb_face_destroy (face);
+}
+
+int
+main (int argc, char **argv)
+{
+  have_alloc_stats = hb_set_allocator_funcs (counting_malloc, counting_calloc,
+					     counting_realloc, counting_free,
+					     nullptr);
+
+  unsigned int sizes[MAX_SIZES] = {10, 100, 1000, 10000};
+  unsigned int num_sizes = 4;
+  unsigned int iterations = 10;
+  hb_subset_input_t *input = hb_subset_input_create_or_fail ();
+  hb_subset_input_set_drop_layout (input, false);
+
+  int i;
+  for (i = 1; i < argc && 0 == strncmp (argv[i], "--", 2); i++)
+  {
+    if (0 == strncmp (argv[i], "--sizes=", 8))
+      num_sizes = hb_benchmark_parse_uint_list (argv[i] + 8, sizes, MAX_SIZES);
+    else if (0 == strncmp (argv[i], "--iterations=", 13))
+      iterations = atoi (argv[i] + 13);
+    else if (0 == strcmp (argv[i], "--drop-layout"))
+      hb_subset_input_set_drop_layout (input, true);
+    else if (0 == strcmp (argv[i], "--drop-hints"))
+      hb_subset_input_set_drop_hints (input, true);
+    else if (0 == strcmp (argv[i], "--desubroutinize"))
+      hb_subset_input_set_desubroutinize (input, true);
+    else if (0 == strcmp (argv[i], "--resubroutinize"))
+      hb_subset_input_set_resubroutinize (input, true);
+    else if (0 == strcmp (argv[i], "--retain-gids"))
+      hb_subset_input_set_retain_gids (input, true);
+    else
+    {
+      fprintf (stderr, "Unknown option %s\n", argv[i]);
+      return 1;
+    }
+  }
+  if (i == argc || !iterations)
+  {
+    fprintf (stderr, "Usage: %s [--sizes=10,100,1000] [--iterations=N] [--drop-layout] [--drop-hints] [--desubroutinize] [--resubroutinize] [--retain-gids] FONT...\n", argv[0]);
+    return 1;
+  }
+
+  for (; i < argc; i++)
+    bench_font (argv[i], sizes, num_sizes, iterations, input);
+
+  hb_subset_input_destroy (input);
+  return 0;
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright © 2018  Google, Inc.
+ *
+ *  This is part of HarfBuzz, a text shaping library.
+ *
+ * Permission is hereby granted, without written agreement and without
+ * license or royalty fees, to use, copy, modify, and distribute this
+ * software and its documentation for any purpose, provided that the
+ * above copyright notice and the following two paragraphs appear in
+ * all copies of this software.
+ *
+ * IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE TO ANY PARTY FOR
+ * DIRECT, INDIRECT, SPECIAL, INCIDENTAL, OR CONSEQUENTIAL DAMAGES
+ * ARISING OUT OF THE USE OF THIS SOFTWARE AND ITS DOCUMENTATION, EVEN
+ * IF THE COPYRIGHT HOLDER HAS BEEN ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ *
+ * THE COPYRIGHT HOLDER SPECIFICALLY DISCLAIMS ANY WARRANTIES, INCLUDING,
+ * BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS FOR A PARTICULAR PURPOSE.  THE SOFTWARE PROVIDED HEREUNDER IS
+ * ON AN "AS IS" BASIS, AND THE COPYRIGHT HOLDER HAS NO OBLIGATION TO
+ * PROVIDE MAINTENANCE, SUPPORT, UPDATES, ENHANCEMENTS, OR MODIFICATIONS.
+ */
+
+#ifndef HB_BENCHMARK_HH
+#define HB_BENCHMARK_HH
+
+#include <hb.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+
+/* Monotonic clock, in nanoseconds. */
+static inline unsigned long long
+hb_benchmark_now_ns (void)
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return (unsigned long long) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/* Parses a comma-separated list of positive integers, as in "1,2,4".
+ * Returns the number of values written to out. */
+static inline unsigned int
+hb_benchmark_parse_uint_list (const char *s, unsigned int *out, unsigned int max_out)
+{
+  unsigned int n = 0;
+  while (*s && n < max_out)
+  {
+    char *end;
+    unsigned long v = strtoul (s, &end, 10);
+    if (end == s)
+      break;
+    if (v)
+      out[n++] = v;
+    s = *end == ',' ? end + 1 : end;
+  }
+  return n;
+}
+
+/* Reads a whole file into a newly-allocated, NUL-terminated string. */
+static inline char *
+hb_benchmark_read_file (const char *path)
+{
+  FILE *f = fopen (path, "rb");
+  if (!f)
+    return nullptr;
+  fseek (f, 0, SEEK_END);
+  long size = ftell (f);
+  fseek (f, 0, SEEK_SET);
+  char *data = size >= 0 ? (char *) malloc (size + 1) : nullptr;
+  if (data && fread (data, 1, size, f) != (size_t) size)
+  {
+    free (data);
+    data = nullptr;
+  }
+  if (data)
+    data[size] = '\0';
+  fclose (f);
+  return data;
+}
+
+#endif /* HB_BENCHMARK_HH */
@@ -1,23 +1,33 @@
 #include "hb-fuzzer.hh"
 
+#include <chrono>
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
 
+/* With HB_FUZZER_PERF set in the environment, reports how long each
+ * input took on stderr, as "perf: FILE MILLISECONDS"; see
+ * run-fuzzer-perf-tests.py. */
 int main(int argc, char **argv) {
-  hb_blob_t *blob = hb_blob_create_from_file (argv[1]);
-  unsigned int len;
-  const char *font_data = hb_blob_get_data (blob, &len);
-  if (len == 0)
-  {
-    printf ("Font not found.\n");
-    exit (1);
-  }
+  bool perf = getenv ("HB_FUZZER_PERF");
 
   for (int i = 1; i < argc; i++) {
+    hb_blob_t *blob = hb_blob_create_from_file (argv[i]);
+    unsigned int len;
+    const char *font_data = hb_blob_get_data (blob, &len);
+    if (len == 0)
+    {
+      printf ("Font not found.\n");
+      exit (1);
+    }
+
     printf ("%s\n", argv[i]);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now ();
     LLVMFuzzerTestOneInput((const uint8_t *) font_data, len);
-  }
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now () - start;
+    if (perf)
+      fprintf (stderr, "perf: %s %.3f\n", argv[i], elapsed.count ());
 
-  hb_blob_destroy (blob);
+    hb_blob_destroy (blob);
+  }
 }
@@ -0,0 +1,77 @@
+#!/usr/bin/env python
+
+# Usage: run-fuzzer-perf-tests.py [--save DIR] FUZZER [INPUT_DIR...]
+#
+# Runs FUZZER, hb-shape-fuzzer or hb-subset-fuzzer, on every file of the
+# INPUT_DIRs, fonts/ by default, and fails if any takes longer than
+# HB_FUZZER_PERF_LIMIT_MS milliseconds, 1000 by default.  With --save,
+# slow inputs are also copied into DIR, named by their SHA-1 like most
+# files of fonts/, so a fuzzing corpus can be sifted for inputs to keep
+# as regression tests.
+
+from __future__ import print_function, division, absolute_import
+
+import sys, os, subprocess, hashlib, shutil
+
+args = sys.argv[1:]
+save_dir = None
+if len (args) > 1 and args[0] == '--save':
+	save_dir = args[1]
+	args = args[2:]
+
+if not args or not os.path.exists (args[0]):
+	print ("""Please provide the fuzzer binary as the first argument to the tool""")
+	sys.exit (1)
+
+fuzzer = args[0]
+srcdir = os.environ.get ("srcdir", ".")
+input_dirs = args[1:] or [os.path.join (srcdir, "fonts")]
+limit = float (os.environ.get ("HB_FUZZER_PERF_LIMIT_MS", "1000"))
+
+env = dict (os.environ)
+env['HB_FUZZER_PERF'] = '1'
+
+print ('fuzzer:', fuzzer)
+print ('limit: %g ms' % limit)
+fails = 0
+slowest = []
+
+for parent_path in input_dirs:
+	for file in sorted (os.listdir (parent_path)):
+		path = os.path.join (parent_path, file)
+
+		p = subprocess.Popen ([fuzzer, path], env=env,
+				      stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+		_, err = p.communicate ()
+		if p.returncode != 0:
+			print ('failure on %s' % path)
+			fails = fails + 1
+			continue
+
+		ms = None
+		for line in err.decode ("utf-8").splitlines ():
+			if line.startswith ('perf: '):
+				ms = float (line.rsplit (' ', 1)[1])
+		if ms is None:
+			print ('no timing for %s' % path)
+			fails = fails + 1
+			continue
+		slowest.append ((ms, path))
+
+		if ms <= limit:
+			continue
+
+		print ('slow input %s: %.1f ms' % (path, ms))
+		fails = fails + 1
+		if save_dir:
+			with open (path, 'rb') as f:
+				name = hashlib.sha1 (f.read ()).hexdigest ()
+			shutil.copyfile (path, os.path.join (save_dir, name))
+
+slowest.sort (reverse=True)
+for ms, path in slowest[:5]:
+	print ('%10.1f ms  %s' % (ms, path))
+
+if fails:
+	print ("%i fuzzer performance tests failed." % fails)
+	sys.exit (1)
@@ -107,7 +107,7 @@ struct output_buffer_t
     g_string_set_size (gs, 0);
     format.serialize_buffer_of_glyphs (buffer, line_no, text, text_len, font,
 				       output_format, format_flags, gs);
-    fprintf (options.fp, "%s", gs->str);
+    fwrite (gs->str, 1, gs->len, options.fp);
   }
   void finish (hb_buffer_t *buffer, const font_options_t *font_opts)
   {
@@ -157,18 +157,41 @@ struct output_buffer_t
 int
 main (int argc, char **argv)
 {
+  /* In batch mode, each line of standard input holds the arguments of one
+   * run, starting with a program name.  The line may start with "@ID ",
+   * in which case the output is preceded by "@ID " too, so that clients
+   * can pipeline requests.  Faces and fonts stay loaded across runs. */
   if (argc == 2 && !strcmp (argv[1], "--batch"))
   {
+    font_options_t::set_font_cache_enabled (true);
     unsigned int ret = 0;
     char buf[4092];
     while (fgets (buf, sizeof (buf), stdin))
     {
       size_t l = strlen (buf);
       if (l && buf[l - 1] == '\n') buf[l - 1] = '\0';
+      char *p = buf, *e;
+      if (*p == '@')
+      {
+	const char *id = p + 1;
+	p = strchr (p, ' ');
+	if (p)
+	{
+	  *p++ = '\0';
+	  while (*p == ' ')
+	    p++;
+	}
+	printf ("@%s ", id);
+	if (!p || !*p)
+	{
+	  printf ("\n");
+	  fflush (stdout);
+	  continue;
+	}
+      }
       main_font_text_t<shape_consumer_t<output_buffer_t>, FONT_SIZE_UPEM, 0> driver;
       char *args[32];
       argc = 0;
-      char *p = buf, *e;
       args[argc++] = p;
       while ((e = strchr (p, ' ')) && argc < (int) (int) ARRAY_LENGTH (args))
       {
@@ -183,6 +206,7 @@ main (int argc, char **argv)
       if (ret)
         break;
     }
+    font_options_t::set_font_cache_enabled (false);
     return ret;
   }
   main_font_text_t<shape_consumer_t<output_buffer_t>, FONT_SIZE_UPEM, 0> driver;
@@ -34,6 +34,11 @@
  * Command line interface to the harfbuzz font subsetter.
  */
 
+/* In --batch mode, plans of recent requests, keyed by face, flags and
+ * retained codepoints and glyphs; see subset_consumer_t::get_plan(). */
+static GHashTable *plan_cache;
+#define PLAN_CACHE_SIZE 32
+
 struct subset_consumer_t
 {
   subset_consumer_t (option_parser_t *parser)
@@ -61,49 +66,91 @@ struct subset_consumer_t
     } while ((c = g_utf8_find_next_char(c, text + text_len)) != nullptr);
   }
 
-  hb_bool_t
-  write_file (const char *output_file, hb_blob_t *blob) {
-    unsigned int data_length;
-    const char* data = hb_blob_get_data (blob, &data_length);
+  static hb_bool_t
+  write_chunk (const char *data, unsigned int length, void *user_data) {
+    return fwrite (data, 1, length, (FILE *) user_data) == length;
+  }
 
+  hb_bool_t
+  write_file (const char *output_file, hb_face_t *face) {
     FILE *fp_out = fopen(output_file, "wb");
     if (fp_out == nullptr) {
       fprintf(stderr, "Unable to open output file\n");
       return false;
     }
-    int bytes_written = fwrite(data, 1, data_length, fp_out);
+
+    /* Stream the compiled font to the file, to avoid copying the tables
+     * into one contiguous buffer first. */
+    bool ret = hb_face_builder_write (face, write_chunk, fp_out);
 
     fclose (fp_out);
 
-    if (bytes_written == -1) {
+    if (!ret) {
       fprintf(stderr, "Unable to write output file\n");
       return false;
     }
-    if ((unsigned int) bytes_written != data_length) {
-      fprintf(stderr, "Expected %u bytes written, got %d\n", data_length,
-              bytes_written);
-      return false;
-    }
     return true;
   }
 
+  static void
+  append_set (GString *s, hb_set_t *set)
+  {
+    hb_codepoint_t first = HB_SET_VALUE_INVALID, last = HB_SET_VALUE_INVALID;
+    while (hb_set_next_range (set, &first, &last))
+      g_string_append_printf (s, "%u-%u,", first, last);
+    g_string_append_c (s, ';');
+  }
+
+  /* Returns a new reference to a plan for input, reusing the plan of
+   * an equal earlier request in batch mode. */
+  hb_subset_plan_t *
+  get_plan (hb_face_t *face)
+  {
+    if (!plan_cache)
+      return hb_subset_plan_create (face, input);
+
+    GString *s = g_string_new (nullptr);
+    g_string_append_printf (s, "%p;%d%d%d%d%d;", (void *) face,
+			    subset_options.keep_layout, subset_options.drop_hints,
+			    subset_options.desubroutinize, subset_options.resubroutinize,
+			    subset_options.retain_gids);
+    append_set (s, hb_subset_input_unicode_set (input));
+    append_set (s, hb_subset_input_glyph_set (input));
+    char *key = g_string_free (s, FALSE);
+
+    hb_subset_plan_t *plan = (hb_subset_plan_t *) g_hash_table_lookup (plan_cache, key);
+    if (plan)
+    {
+      g_free (key);
+      return hb_subset_plan_reference (plan);
+    }
+
+    plan = hb_subset_plan_create (face, input);
+    if (g_hash_table_size (plan_cache) >= PLAN_CACHE_SIZE)
+      g_hash_table_remove_all (plan_cache);
+    g_hash_table_insert (plan_cache, key, hb_subset_plan_reference (plan));
+    return plan;
+  }
+
   void finish (const font_options_t *font_opts)
   {
     hb_subset_input_set_drop_layout (input, !subset_options.keep_layout);
     hb_subset_input_set_drop_hints (input, subset_options.drop_hints);
     hb_subset_input_set_desubroutinize (input, subset_options.desubroutinize);
+    hb_subset_input_set_resubroutinize (input, subset_options.resubroutinize);
+    hb_subset_input_set_retain_gids (input, subset_options.retain_gids);
 
     hb_face_t *face = hb_font_get_face (font);
 
-    hb_face_t *new_face = hb_subset (face, input);
-    hb_blob_t *result = hb_face_reference_blob (new_face);
+    hb_subset_plan_t *plan = get_plan (face);
+    hb_face_t *new_face = hb_subset_plan_execute (plan);
+    hb_subset_plan_destroy (plan);
 
-    failed = !hb_blob_get_length (result);
+    failed = !hb_face_builder_get_chunks (new_face, 0, nullptr, nullptr);
     if (!failed)
-      write_file (options.output_file, result);
+      write_file (options.output_file, new_face);
 
     hb_subset_input_destroy (input);
-    hb_blob_destroy (result);
     hb_face_destroy (new_face);
     hb_font_destroy (font);
   }
@@ -121,6 +168,68 @@ struct subset_consumer_t
 int
 main (int argc, char **argv)
 {
+  /* In batch mode, each line of standard input holds the arguments of one
+   * run, starting with a program name, as with hb-shape --batch.  The line
+   * may start with "@ID ", in which case "@ID " and the run's status, 0
+   * for success, are printed when it is done.  Faces and the plans of
+   * recent requests stay loaded across runs. */
+  if (argc == 2 && !strcmp (argv[1], "--batch"))
+  {
+    font_options_t::set_font_cache_enabled (true);
+    plan_cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+					(GDestroyNotify) hb_subset_plan_destroy);
+    unsigned int ret = 0;
+    char buf[4092];
+    while (fgets (buf, sizeof (buf), stdin))
+    {
+      size_t l = strlen (buf);
+      if (l && buf[l - 1] == '\n') buf[l - 1] = '\0';
+      char *p = buf, *e;
+      const char *id = nullptr;
+      if (*p == '@')
+      {
+	id = p + 1;
+	p = strchr (p, ' ');
+	if (p)
+	{
+	  *p++ = '\0';
+	  while (*p == ' ')
+	    p++;
+	}
+	if (!p || !*p)
+	{
+	  printf ("@%s 1\n", id);
+	  fflush (stdout);
+	  continue;
+	}
+      }
+      main_font_text_t<subset_consumer_t, 10, 0> driver;
+      char *args[32];
+      argc = 0;
+      args[argc++] = p;
+      while ((e = strchr (p, ' ')) && argc < (int) ARRAY_LENGTH (args))
+      {
+	*e++ = '\0';
+	while (*e == ' ')
+	  e++;
+	args[argc++] = p = e;
+      }
+      int status = driver.main (argc, args);
+      if (id)
+	printf ("@%s %d\n", id, status);
+      else
+	ret |= status;
+      fflush (stdout);
+
+      if (ret)
+	break;
+    }
+    g_hash_table_destroy (plan_cache);
+    plan_cache = nullptr;
+    font_options_t::set_font_cache_enabled (false);
+    return ret;
+  }
+
   main_font_text_t<subset_consumer_t, 10, 0> driver;
   return driver.main (argc, argv);
 }
@@ -35,6 +35,65 @@
 int
 main (int argc, char **argv)
 {
+  /* In batch mode, each line of standard input holds the arguments of one
+   * run, starting with a program name, as with hb-shape --batch; runs
+   * should write to files with -o.  The line may start with "@ID ", in
+   * which case "@ID " and the run's status, 0 for success, are printed
+   * when it is done.  Fonts, and the glyphs cairo rendered with them, stay
+   * loaded across runs. */
+  if (argc == 2 && !strcmp (argv[1], "--batch"))
+  {
+    font_options_t::set_font_cache_enabled (true);
+    unsigned int ret = 0;
+    char buf[4092];
+    while (fgets (buf, sizeof (buf), stdin))
+    {
+      size_t l = strlen (buf);
+      if (l && buf[l - 1] == '\n') buf[l - 1] = '\0';
+      char *p = buf, *e;
+      const char *id = nullptr;
+      if (*p == '@')
+      {
+	id = p + 1;
+	p = strchr (p, ' ');
+	if (p)
+	{
+	  *p++ = '\0';
+	  while (*p == ' ')
+	    p++;
+	}
+	if (!p || !*p)
+	{
+	  printf ("@%s 1\n", id);
+	  fflush (stdout);
+	  continue;
+	}
+      }
+      main_font_text_t<shape_consumer_t<view_cairo_t>, DEFAULT_FONT_SIZE, SUBPIXEL_BITS> driver;
+      char *args[32];
+      argc = 0;
+      args[argc++] = p;
+      while ((e = strchr (p, ' ')) && argc < (int) ARRAY_LENGTH (args))
+      {
+	*e++ = '\0';
+	while (*e == ' ')
+	  e++;
+	args[argc++] = p = e;
+      }
+      int status = driver.main (argc, args);
+      if (id)
+	printf ("@%s %d\n", id, status);
+      else
+	ret |= status;
+      fflush (stdout);
+
+      if (ret)
+	break;
+    }
+    font_options_t::set_font_cache_enabled (false);
+    return ret;
+  }
+
   main_font_text_t<shape_consumer_t<view_cairo_t>, DEFAULT_FONT_SIZE, SUBPIXEL_BITS> driver;
   return driver.main (argc, argv);
 }
@@ -72,11 +72,22 @@ void free_ft_library ()
 }
 #endif
 
+/* Fonts keep the scaled font made for them, and with it cairo's cache of
+ * rendered glyphs, for later renders; see hb-view --batch. */
+static hb_user_data_key_t scaled_font_key;
+
 cairo_scaled_font_t *
 helper_cairo_create_scaled_font (const font_options_t *font_opts)
 {
   hb_font_t *font = hb_font_reference (font_opts->get_font ());
 
+  cairo_scaled_font_t *cached = (cairo_scaled_font_t *) hb_font_get_user_data (font, &scaled_font_key);
+  if (cached)
+  {
+    hb_font_destroy (font);
+    return cairo_scaled_font_reference (cached);
+  }
+
   cairo_font_face_t *cairo_face;
   /* We cannot use the FT_Face from hb_font_t, as doing so will confuse hb_font_t because
    * cairo will reset the face size.  As such, create new face...
@@ -148,6 +159,19 @@ helper_cairo_create_scaled_font (const font_options_t *font_opts)
   cairo_font_options_destroy (font_options);
   cairo_font_face_destroy (cairo_face);
 
+  /* The font outlives the scaled font it keeps; otherwise the scaled font
+   * keeps the font, whose blob its FT_Face uses, alive. */
+  if (hb_font_set_user_data (font,
+			     &scaled_font_key,
+			     cairo_scaled_font_reference (scaled_font),
+			     (hb_destroy_func_t) cairo_scaled_font_destroy,
+			     false))
+  {
+    hb_font_destroy (font);
+    return scaled_font;
+  }
+  cairo_scaled_font_destroy (scaled_font);
+
   static cairo_user_data_key_t key;
   if (cairo_scaled_font_set_user_data (scaled_font,
 				       &key,
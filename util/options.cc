@@ -419,6 +419,9 @@ shape_options_t::add_options (option_parser_t *parser)
     {"normalize-glyphs",0, 0, G_OPTION_ARG_NONE,	&this->normalize_glyphs,	"Rearrange glyph clusters in nominal order",	nullptr},
     {"verify",		0, 0, G_OPTION_ARG_NONE,	&this->verify,			"Perform sanity checks on shaping results",	nullptr},
     {"num-iterations", 'n', 0, G_OPTION_ARG_INT,		&this->num_iterations,		"Run shaper N times (default: 1)",	"N"},
+    {"num-threads",	0, 0, G_OPTION_ARG_INT,		&this->num_threads,		"With --benchmark, shape on N threads at once (default: 1)",	"N"},
+    {"benchmark",	0, 0, G_OPTION_ARG_NONE,	&this->benchmark,		"Report shaping speed instead of shaping results",	nullptr},
+    {"per-thread-fonts",0, 0, G_OPTION_ARG_NONE,	&this->per_thread_fonts,	"With --benchmark, give each thread its own font on the shared face",	nullptr},
     {nullptr}
   };
   parser->add_group (entries,
@@ -637,54 +640,45 @@ output_options_t::add_options (option_parser_t *parser)
 
 
 
-hb_font_t *
-font_options_t::get_font () const
-{
-  if (font)
-    return font;
-
-  /* Create the blob */
-  if (!font_file)
-    fail (true, "No font file set");
-
-  const char *font_path = font_file;
+static GHashTable *face_cache; /* "index:path" to hb_face_t. */
+static GHashTable *font_cache; /* All font options to hb_font_t. */
 
-  if (0 == strcmp (font_path, "-"))
+void
+font_options_t::set_font_cache_enabled (bool enabled)
+{
+  if (enabled && !font_cache)
   {
-#if defined(_WIN32) || defined(__CYGWIN__)
-    setmode (fileno (stdin), O_BINARY);
-    font_path = "STDIN";
-#else
-    font_path = "/dev/stdin";
-#endif
+    face_cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+					(GDestroyNotify) hb_face_destroy);
+    font_cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+					(GDestroyNotify) hb_font_destroy);
   }
+  else if (!enabled && font_cache)
+  {
+    g_hash_table_destroy (font_cache);
+    g_hash_table_destroy (face_cache);
+    font_cache = face_cache = nullptr;
+  }
+}
 
-  blob = hb_blob_create_from_file (font_path);
-
-  if (blob == hb_blob_get_empty ())
-    fail (false, "Couldn't read or find %s, or it was empty.", font_path);
-
-  /* Create the face */
-  hb_face_t *face = hb_face_create (blob, face_index);
-  hb_blob_destroy (blob);
-
-
-  font = hb_font_create (face);
+hb_font_t *
+font_options_t::create_font (hb_face_t *face) const
+{
+  hb_font_t *new_font = hb_font_create (face);
 
   if (font_size_x == FONT_SIZE_UPEM)
     font_size_x = hb_face_get_upem (face);
   if (font_size_y == FONT_SIZE_UPEM)
     font_size_y = hb_face_get_upem (face);
 
-  hb_font_set_ppem (font, x_ppem, y_ppem);
-  hb_font_set_ptem (font, ptem);
+  hb_font_set_ppem (new_font, x_ppem, y_ppem);
+  hb_font_set_ptem (new_font, ptem);
 
   int scale_x = (int) scalbnf (font_size_x, subpixel_bits);
   int scale_y = (int) scalbnf (font_size_y, subpixel_bits);
-  hb_font_set_scale (font, scale_x, scale_y);
-  hb_face_destroy (face);
+  hb_font_set_scale (new_font, scale_x, scale_y);
 
-  hb_font_set_variations (font, variations, num_variations);
+  hb_font_set_variations (new_font, variations, num_variations);
 
   void (*set_font_funcs) (hb_font_t *) = nullptr;
   if (!font_funcs)
@@ -716,11 +710,106 @@ font_options_t::get_font () const
       //free (p);
     }
   }
-  set_font_funcs (font);
+  set_font_funcs (new_font);
 #ifdef HAVE_FREETYPE
-  hb_ft_font_set_load_flags (font, ft_load_flags);
+  hb_ft_font_set_load_flags (new_font, ft_load_flags);
 #endif
 
+  return new_font;
+}
+
+hb_font_t *
+font_options_t::get_font () const
+{
+  if (font)
+    return font;
+
+  /* Create the blob */
+  if (!font_file)
+    fail (true, "No font file set");
+
+  const char *font_path = font_file;
+
+  if (0 == strcmp (font_path, "-"))
+  {
+#if defined(_WIN32) || defined(__CYGWIN__)
+    setmode (fileno (stdin), O_BINARY);
+    font_path = "STDIN";
+#else
+    font_path = "/dev/stdin";
+#endif
+  }
+
+  /* Standard input is not a file we can read again. */
+  bool cached = font_cache && 0 != strcmp (font_file, "-");
+  char *face_key = nullptr;
+  char *font_key = nullptr;
+  if (cached)
+  {
+    face_key = g_strdup_printf ("%d:%s", face_index, font_path);
+
+    GString *s = g_string_new (face_key);
+    g_string_append_printf (s, "\n%g,%g,%d,%d,%g,%u,%s,%d\n",
+			    font_size_x, font_size_y, x_ppem, y_ppem, ptem,
+			    subpixel_bits, font_funcs ? font_funcs : "",
+			    ft_load_flags);
+    for (unsigned int i = 0; i < num_variations; i++)
+    {
+      char buf[128];
+      hb_variation_to_string (&variations[i], buf, sizeof (buf));
+      g_string_append (s, buf);
+      g_string_append_c (s, ',');
+    }
+    font_key = g_string_free (s, FALSE);
+
+    hb_font_t *cached_font = (hb_font_t *) g_hash_table_lookup (font_cache, font_key);
+    if (cached_font)
+    {
+      g_free (face_key);
+      g_free (font_key);
+
+      font = hb_font_reference (cached_font);
+      hb_face_t *face = hb_font_get_face (font);
+      blob = hb_face_reference_blob (face);
+      hb_blob_destroy (blob); /* The face keeps it alive. */
+      if (font_size_x == FONT_SIZE_UPEM)
+	font_size_x = hb_face_get_upem (face);
+      if (font_size_y == FONT_SIZE_UPEM)
+	font_size_y = hb_face_get_upem (face);
+      return font;
+    }
+  }
+
+  hb_face_t *face = cached ? (hb_face_t *) g_hash_table_lookup (face_cache, face_key) : nullptr;
+  if (face)
+  {
+    hb_face_reference (face);
+    blob = hb_face_reference_blob (face);
+    hb_blob_destroy (blob); /* The face keeps it alive. */
+    g_free (face_key);
+  }
+  else
+  {
+    blob = hb_blob_create_from_file (font_path);
+
+    if (blob == hb_blob_get_empty ())
+      fail (false, "Couldn't read or find %s, or it was empty.", font_path);
+
+    /* Create the face */
+    face = hb_face_create (blob, face_index);
+    hb_blob_destroy (blob);
+
+    if (cached)
+      g_hash_table_insert (face_cache, face_key, hb_face_reference (face));
+  }
+
+
+  font = create_font (face);
+  hb_face_destroy (face);
+
+  if (cached)
+    g_hash_table_insert (font_cache, font_key, hb_font_reference (font));
+
   return font;
 }
 
@@ -897,7 +986,10 @@ format_options_t::serialize_glyphs (hb_buffer_t *buffer,
 				    hb_buffer_serialize_flags_t flags,
 				    GString     *gs)
 {
-  g_string_append_c (gs, '[');
+  /* Binary records delimit themselves, and may contain NUL bytes. */
+  bool binary = output_format == HB_BUFFER_SERIALIZE_FORMAT_BINARY;
+  if (!binary)
+    g_string_append_c (gs, '[');
   unsigned int num_glyphs = hb_buffer_get_length (buffer);
   unsigned int start = 0;
 
@@ -910,9 +1002,10 @@ format_options_t::serialize_glyphs (hb_buffer_t *buffer,
 					 font, output_format, flags);
     if (!consumed)
       break;
-    g_string_append (gs, buf);
+    g_string_append_len (gs, buf, consumed);
   }
-  g_string_append_c (gs, ']');
+  if (!binary)
+    g_string_append_c (gs, ']');
 }
 void
 format_options_t::serialize_line_no (unsigned int  line_no,
@@ -965,6 +1058,11 @@ format_options_t::serialize_buffer_of_glyphs (hb_buffer_t  *buffer,
 					      hb_buffer_serialize_flags_t format_flags,
 					      GString      *gs)
 {
+  if (output_format == HB_BUFFER_SERIALIZE_FORMAT_BINARY)
+  {
+    serialize_glyphs (buffer, font, output_format, format_flags, gs);
+    return;
+  }
   serialize_line_no (line_no, gs);
   serialize_glyphs (buffer, font, output_format, format_flags, gs);
   g_string_append_c (gs, '\n');
@@ -978,6 +1076,8 @@ subset_options_t::add_options (option_parser_t *parser)
     {"layout", 0, 0, G_OPTION_ARG_NONE,  &this->keep_layout,   "Keep OpenType Layout tables",   nullptr},
     {"no-hinting", 0, 0, G_OPTION_ARG_NONE,  &this->drop_hints,   "Whether to drop hints",   nullptr},
     {"desubroutinize", 0, 0, G_OPTION_ARG_NONE,  &this->desubroutinize,   "Remove CFF/CFF2 use of subroutines",   nullptr},
+    {"resubroutinize", 0, 0, G_OPTION_ARG_NONE,  &this->resubroutinize,   "Rebuild CFF subroutines from the subset glyphs",   nullptr},
+    {"retain-gids", 0, 0, G_OPTION_ARG_NONE,  &this->retain_gids,   "Keep the glyph ids of the source font",   nullptr},
 
     {nullptr}
   };
@@ -158,6 +158,9 @@ struct shape_options_t : option_group_t
     normalize_glyphs = false;
     verify = false;
     num_iterations = 1;
+    num_threads = 1;
+    benchmark = false;
+    per_thread_fonts = false;
 
     add_options (parser);
   }
@@ -440,6 +443,9 @@ struct shape_options_t : option_group_t
   hb_bool_t normalize_glyphs;
   hb_bool_t verify;
   unsigned int num_iterations;
+  unsigned int num_threads;
+  hb_bool_t benchmark;
+  hb_bool_t per_thread_fonts;
 };
 
 
@@ -478,6 +484,13 @@ struct font_options_t : option_group_t
   void add_options (option_parser_t *parser);
 
   hb_font_t *get_font () const;
+  /* Returns a new font on face, set up as get_font() sets up its own. */
+  hb_font_t *create_font (hb_face_t *face) const;
+
+  /* While enabled, get_font() of all font options shares faces and
+   * fonts with equal options, instead of loading them afresh; for
+   * hb-shape --batch.  Font files are assumed not to change meanwhile. */
+  static void set_font_cache_enabled (bool enabled);
 
   char *font_file;
   mutable hb_blob_t *blob;
@@ -673,6 +686,8 @@ struct subset_options_t : option_group_t
     keep_layout = false;
     drop_hints = false;
     desubroutinize = false;
+    resubroutinize = false;
+    retain_gids = false;
 
     add_options (parser);
   }
@@ -682,6 +697,8 @@ struct subset_options_t : option_group_t
   hb_bool_t keep_layout;
   hb_bool_t drop_hints;
   hb_bool_t desubroutinize;
+  hb_bool_t resubroutinize;
+  hb_bool_t retain_gids;
 };
 
 /* fallback implementation for scalbn()/scalbnf() for pre-2013 MSVC */
@@ -39,7 +39,10 @@ struct shape_consumer_t
 		    shaper (parser),
 		    output (parser),
 		    font (nullptr),
-		    buffer (nullptr) {}
+		    buffer (nullptr),
+		    bench_lines (nullptr),
+		    bench_text_before (nullptr),
+		    bench_text_after (nullptr) {}
 
   void init (hb_buffer_t  *buffer_,
 	     const font_options_t *font_opts)
@@ -55,6 +58,17 @@ struct shape_consumer_t
 		     const char   *text_before,
 		     const char   *text_after)
   {
+    if (shaper.benchmark)
+    {
+      /* Shaped in finish(). */
+      if (!bench_lines)
+	bench_lines = g_ptr_array_new_with_free_func (g_free);
+      g_ptr_array_add (bench_lines, g_strndup (text, text_len));
+      bench_text_before = text_before;
+      bench_text_after = text_after;
+      return;
+    }
+
     output.new_line ();
 
     for (unsigned int n = shaper.num_iterations; n; n--)
@@ -79,6 +93,12 @@ struct shape_consumer_t
   }
   void finish (const font_options_t *font_opts)
   {
+    if (bench_lines)
+    {
+      run_benchmark (font_opts);
+      g_ptr_array_free (bench_lines, TRUE);
+      bench_lines = nullptr;
+    }
     output.finish (buffer, font_opts);
     hb_font_destroy (font);
     font = nullptr;
@@ -90,11 +110,133 @@ struct shape_consumer_t
   bool failed;
 
   protected:
+
+  /*
+   * --benchmark: shapes every line num_iterations times on each of
+   * num_threads threads at once, and reports throughput, the spread of
+   * per-line latencies, and how the face's shape plan cache fared.
+   */
+
+  struct bench_thread_t
+  {
+    shape_consumer_t *consumer;
+    hb_font_t *font;
+    double *latencies; /* Per line, in microseconds per shaping. */
+    unsigned long long glyphs;
+    bool failed;
+  };
+
+  static gpointer
+  bench_thread_func (gpointer data)
+  {
+    bench_thread_t *thread = (bench_thread_t *) data;
+    shape_consumer_t *consumer = thread->consumer;
+    shape_options_t &shaper = consumer->shaper;
+    unsigned int iterations = MAX (shaper.num_iterations, 1u);
+    hb_buffer_t *buffer = hb_buffer_create ();
+
+    for (unsigned int l = 0; l < consumer->bench_lines->len; l++)
+    {
+      const char *text = (const char *) g_ptr_array_index (consumer->bench_lines, l);
+      unsigned int text_len = strlen (text);
+      gint64 start = g_get_monotonic_time ();
+      for (unsigned int n = iterations; n; n--)
+      {
+	shaper.populate_buffer (buffer, text, text_len,
+				consumer->bench_text_before,
+				consumer->bench_text_after);
+	if (!shaper.shape (thread->font, buffer))
+	  thread->failed = true;
+	thread->glyphs += hb_buffer_get_length (buffer);
+      }
+      thread->latencies[l] = (g_get_monotonic_time () - start) / (double) iterations;
+    }
+
+    hb_buffer_destroy (buffer);
+    return nullptr;
+  }
+
+  static int
+  cmp_double (const void *pa, const void *pb)
+  {
+    double a = * (const double *) pa;
+    double b = * (const double *) pb;
+    return a < b ? -1 : a > b ? 1 : 0;
+  }
+
+  void run_benchmark (const font_options_t *font_opts)
+  {
+    unsigned int num_threads = MAX (shaper.num_threads, 1u);
+    unsigned int num_lines = bench_lines->len;
+    hb_face_t *face = hb_font_get_face (font);
+
+    bench_thread_t *threads = (bench_thread_t *) calloc (num_threads, sizeof (threads[0]));
+    double *latencies = (double *) calloc ((size_t) num_threads * num_lines, sizeof (latencies[0]));
+    GThread **handles = (GThread **) calloc (num_threads, sizeof (handles[0]));
+    if (!threads || !latencies || !handles)
+      fail (false, "Out of memory");
+
+    for (unsigned int i = 0; i < num_threads; i++)
+    {
+      threads[i].consumer = this;
+      threads[i].font = shaper.per_thread_fonts ?
+			font_opts->create_font (face) :
+			hb_font_reference (font);
+      threads[i].latencies = latencies + (size_t) i * num_lines;
+    }
+
+    unsigned int hits0 = 0, misses0 = 0;
+    hb_face_get_shape_plan_cache_stats (face, &hits0, &misses0);
+
+    gint64 start = g_get_monotonic_time ();
+    for (unsigned int i = 0; i < num_threads; i++)
+      handles[i] = g_thread_new ("shape", bench_thread_func, &threads[i]);
+    for (unsigned int i = 0; i < num_threads; i++)
+      g_thread_join (handles[i]);
+    double seconds = (g_get_monotonic_time () - start) / 1e6;
+
+    unsigned int hits = 0, misses = 0;
+    hb_face_get_shape_plan_cache_stats (face, &hits, &misses);
+    hits -= hits0;
+    misses -= misses0;
+
+    unsigned long long glyphs = 0;
+    for (unsigned int i = 0; i < num_threads; i++)
+    {
+      glyphs += threads[i].glyphs;
+      failed = failed || threads[i].failed;
+      hb_font_destroy (threads[i].font);
+    }
+
+    unsigned int num_latencies = num_threads * num_lines;
+    qsort (latencies, num_latencies, sizeof (latencies[0]), cmp_double);
+
+    printf ("threads: %u (%s fonts); lines: %u; iterations: %u\n",
+	    num_threads, shaper.per_thread_fonts ? "per-thread" : "shared",
+	    num_lines, MAX (shaper.num_iterations, 1u));
+    printf ("glyphs/sec: %.0f\n", seconds > 0 ? glyphs / seconds : 0.);
+    if (num_latencies)
+      printf ("line latency: p50 %.2f us, p99 %.2f us\n",
+	      latencies[num_latencies / 2],
+	      latencies[(num_latencies - 1) * 99 / 100]);
+    printf ("shape plan cache: %u hits, %u misses (%.1f%% hit rate)\n",
+	    hits, misses,
+	    hits + misses ? 100. * hits / (hits + misses) : 0.);
+
+    free (handles);
+    free (latencies);
+    free (threads);
+  }
+
   shape_options_t shaper;
   output_t output;
 
   hb_font_t *font;
   hb_buffer_t *buffer;
+
+  GPtrArray *bench_lines;
+  const char *bench_text_before;
+  const char *bench_text_after;
 };
 
 